@@ -0,0 +1,46 @@
+/* packet-ber-profile.h
+ * Per-type profiler and memory accounting for the BER engine and the
+ * dissectors built on it
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef PACKET_BER_PROFILE_H
+#define PACKET_BER_PROFILE_H
+
+/* ber.profile preference */
+extern gboolean ber_profile_enabled;
+
+/* Open a profiled region named name (an hf abbreviation or a type name).
+ * Returns the depth to hand to ber_profile_leave(); regions left open by
+ * an exception are closed by the next leave of an enclosing region.
+ */
+guint ber_profile_enter(packet_info *pinfo, const char *name);
+void ber_profile_leave(guint depth);
+
+#define BER_PROFILE_ENTER(pinfo, name) (ber_profile_enabled ? ber_profile_enter((pinfo), (name)) : 0)
+#define BER_PROFILE_LEAVE(depth) do { if (ber_profile_enabled) ber_profile_leave(depth); } while (0)
+
+/* Memory accounting for long-lived dissector state (-z krb_mem,tree).
+ * A usage function reports the number of entries an owner holds and an
+ * estimate of the bytes behind them; it must be cheap, as the report
+ * samples every account once per frame.
+ */
+typedef void (*ber_mem_usage_func)(guint *count, guint64 *bytes);
+typedef void (*ber_mem_report_func)(const char *name, guint count, guint64 bytes, gpointer user_data);
+
+/* Per-entry overhead of a wmem_map_t item (key, value, chain pointers) */
+#define BER_MEM_MAP_ENTRY (3 * sizeof(void *))
+/* Per-element overhead of a wmem_list_t frame (data, previous, next) */
+#define BER_MEM_LIST_FRAME (3 * sizeof(void *))
+/* An empty GHashTable: the table itself and its first, smallest arrays */
+#define BER_MEM_HASH_TABLE (16 * sizeof(void *))
+
+void ber_mem_register(const char *name, ber_mem_usage_func func);
+void ber_mem_foreach(ber_mem_report_func func, gpointer user_data);
+
+#endif  /* PACKET_BER_PROFILE_H */
@@ -0,0 +1,57 @@
+/* packet-ber-schema.h
+ * Table-driven BER dissection: SEQUENCE and SEQUENCE OF types walked
+ * over their generated tables by one single-pass interpreter loop
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef PACKET_BER_SCHEMA_H
+#define PACKET_BER_SCHEMA_H
+
+typedef enum {
+    BER_SCHEMA_SEQUENCE,
+    BER_SCHEMA_SEQUENCE_OF
+} ber_schema_kind_t;
+
+/* A type is its generated table. A field keeps its generated function,
+ * or has dissect_ber_schema_field() when its type is itself a schema:
+ * those types have no function of their own.
+ */
+typedef struct _ber_schema_t {
+    ber_schema_kind_t kind;
+    const ber_sequence_t *seq;          /* SEQUENCE: up to a NULL func; SEQUENCE OF: the element */
+    const gint *ett;
+} ber_schema_t;
+
+#define BER_SCHEMA_SEQ(seq, ett)    { BER_SCHEMA_SEQUENCE, seq, &(ett) }
+#define BER_SCHEMA_SEQ_OF(seq, ett) { BER_SCHEMA_SEQUENCE_OF, seq, &(ett) }
+
+/* The schema a field's hf stands for wherever it has dissect_ber_schema_field() */
+typedef struct _ber_schema_hf_t {
+    const int *p_id;
+    const ber_schema_t *schema;
+} ber_schema_hf_t;
+
+/* Dissect one value of type schema at offset, like the generated
+ * dissect_<proto>_<Type>() would, in a single pass over the encoding.
+ * From the first element that does not line up with the table with a
+ * definite length, the rest is dissected by the loop behind
+ * dissect_ber_sequence()/dissect_ber_sequence_of(), so malformed data is
+ * reported the same way; everything is when the ber.schema preference
+ * is off.
+ */
+int dissect_ber_schema(gboolean implicit_tag, asn1_ctx_t *actx, proto_tree *tree, tvbuff_t *tvb, int offset, const ber_schema_t *schema, gint hf_id);
+
+/* The ber_callback of a field whose type is a schema: dissects the schema
+ * registered for hf_id.
+ */
+int dissect_ber_schema_field(gboolean implicit_tag, tvbuff_t *tvb, int offset, asn1_ctx_t *actx, proto_tree *tree, int hf_id);
+
+/* Register the field to schema table of a protocol, once its hf ids are */
+void ber_schema_register(const ber_schema_hf_t *fields, guint num_fields);
+
+#endif  /* PACKET_BER_SCHEMA_H */
@@ -0,0 +1,32 @@
+/* packet-ber-try.h
+ * Non-throwing BER identifier and length decoding, for heuristics and
+ * trial decryption where a bad buffer is the common case
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef PACKET_BER_TRY_H
+#define PACKET_BER_TRY_H
+
+/* Like get_ber_identifier(), but returns -1 instead of throwing when the
+ * identifier octets run past the captured data.
+ */
+int try_get_ber_identifier(tvbuff_t *tvb, int offset, gint8 *ber_class, gboolean *pc, gint32 *tag);
+
+/* Like get_ber_length(), but returns -1 instead of throwing when the
+ * length octets (or, for an indefinite length, the contents up to the
+ * EOC) run past the captured data or nest too deeply. The contents of a
+ * definite length are not checked; see try_get_ber_tl().
+ */
+int try_get_ber_length(tvbuff_t *tvb, int offset, guint32 *length, gboolean *ind);
+
+/* Identifier and length in one go; returns the offset of the contents,
+ * or -1 if the header is bad or the contents are not all captured.
+ */
+int try_get_ber_tl(tvbuff_t *tvb, int offset, gint8 *ber_class, gboolean *pc, gint32 *tag, guint32 *length);
+
+#endif  /* PACKET_BER_TRY_H */
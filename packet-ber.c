@@ -55,11 +55,15 @@
 #include <epan/uat.h>
 #include <epan/decode_as.h>
 #include <wiretap/wtap.h>
+#include <wsutil/file_util.h>
 #ifdef DEBUG_BER
 #include <wsutil/ws_printf.h> /* ws_debug_printf */
 #endif
 
 #include "packet-ber.h"
+#include "packet-ber-profile.h"
+#include "packet-ber-try.h"
+#include "packet-ber-schema.h"
 
 /*
  * Set a limit on recursion so we don't blow away the stack. Another approach
@@ -198,6 +202,301 @@ static dissector_table_t ber_syntax_dissector_table = NULL;
 
 static GHashTable *syntax_table = NULL;
 
+/* Per-type profiler (ber.profile). Each profiled call gets a node in a
+ * call tree, keyed by its name under the caller's node; on leaving, the
+ * elapsed ticks go to the node's total and, less what its children took,
+ * to its self time. Dissection runs on a single thread, so one tree is
+ * enough. The report is written at shutdown: a table sorted by self time
+ * on stderr and, with ber.profile_file set, folded stacks for
+ * flamegraph.pl.
+ */
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define BER_PROFILE_TSC 1
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define BER_PROFILE_TSC 1
+#endif
+
+#ifdef BER_PROFILE_TSC
+#define BER_PROFILE_UNIT "cycles"
+#else
+#define BER_PROFILE_UNIT "us"
+#endif
+
+#define BER_PROFILE_MAX_DEPTH (BER_MAX_NESTING * 2)
+
+typedef struct _ber_profile_node_t {
+    const char *name;
+    guint64 calls;
+    guint64 total;
+    guint64 self;
+    GHashTable *children;
+} ber_profile_node_t;
+
+typedef struct {
+    ber_profile_node_t *node;
+    guint64 start;
+    guint64 children;
+} ber_profile_frame_t;
+
+gboolean ber_profile_enabled = FALSE;
+static const char *ber_profile_filename = NULL;
+
+static ber_profile_node_t ber_profile_root;
+static ber_profile_frame_t ber_profile_stack[BER_PROFILE_MAX_DEPTH];
+static guint ber_profile_depth = 0;
+static guint32 ber_profile_frame_num = 0;
+
+static inline guint64
+ber_profile_now(void)
+{
+#ifdef BER_PROFILE_TSC
+    return __rdtsc();
+#else
+    return (guint64)g_get_monotonic_time();
+#endif
+}
+
+static void
+ber_profile_pop(guint64 now)
+{
+    ber_profile_frame_t *frame = &ber_profile_stack[--ber_profile_depth];
+    guint64 elapsed = now - frame->start;
+
+    frame->node->total += elapsed;
+    frame->node->self += elapsed - MIN(elapsed, frame->children);
+    if (ber_profile_depth > 0) {
+        ber_profile_stack[ber_profile_depth - 1].children += elapsed;
+    }
+}
+
+guint
+ber_profile_enter(packet_info *pinfo, const char *name)
+{
+    ber_profile_node_t *parent, *node;
+    guint depth;
+
+    /* whatever an exception left open belongs to an earlier frame */
+    if (pinfo && pinfo->num != ber_profile_frame_num) {
+        guint64 now = ber_profile_now();
+
+        while (ber_profile_depth > 0) {
+            ber_profile_pop(now);
+        }
+        ber_profile_frame_num = pinfo->num;
+    }
+
+    depth = ber_profile_depth;
+    if (depth == BER_PROFILE_MAX_DEPTH) {
+        return depth;
+    }
+
+    parent = depth ? ber_profile_stack[depth - 1].node : &ber_profile_root;
+    if (parent->children == NULL) {
+        parent->children = g_hash_table_new(g_str_hash, g_str_equal);
+    }
+    node = (ber_profile_node_t *)g_hash_table_lookup(parent->children, name);
+    if (node == NULL) {
+        node = g_new0(ber_profile_node_t, 1);
+        node->name = g_strdup(name);
+        g_hash_table_insert(parent->children, (gpointer)node->name, node);
+    }
+    node->calls++;
+
+    ber_profile_stack[depth].node = node;
+    ber_profile_stack[depth].children = 0;
+    ber_profile_depth++;
+    ber_profile_stack[depth].start = ber_profile_now();
+
+    return depth;
+}
+
+void
+ber_profile_leave(guint depth)
+{
+    guint64 now = ber_profile_now();
+
+    while (ber_profile_depth > depth) {
+        ber_profile_pop(now);
+    }
+}
+
+static const char *
+ber_profile_name(const char *type_name, gint hf_id)
+{
+    return (hf_id > 0) ? proto_registrar_get_abbrev(hf_id) : type_name;
+}
+
+static void
+ber_profile_flatten(ber_profile_node_t *node, GHashTable *flat)
+{
+    GHashTableIter iter;
+    gpointer value;
+    ber_profile_node_t *child, *sum;
+
+    if (node->children == NULL) {
+        return;
+    }
+    g_hash_table_iter_init(&iter, node->children);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        child = (ber_profile_node_t *)value;
+        sum = (ber_profile_node_t *)g_hash_table_lookup(flat, child->name);
+        if (sum == NULL) {
+            sum = g_new0(ber_profile_node_t, 1);
+            sum->name = child->name;
+            g_hash_table_insert(flat, (gpointer)sum->name, sum);
+        }
+        /* totals of recursive types count each level */
+        sum->calls += child->calls;
+        sum->total += child->total;
+        sum->self += child->self;
+        ber_profile_flatten(child, flat);
+    }
+}
+
+static gint
+ber_profile_cmp_self(gconstpointer a, gconstpointer b)
+{
+    const ber_profile_node_t *na = *(const ber_profile_node_t * const *)a;
+    const ber_profile_node_t *nb = *(const ber_profile_node_t * const *)b;
+
+    return (na->self < nb->self) ? 1 : (na->self > nb->self) ? -1 : 0;
+}
+
+static void
+ber_profile_write_folded(FILE *fp, ber_profile_node_t *node, GString *path)
+{
+    GHashTableIter iter;
+    gpointer value;
+    ber_profile_node_t *child;
+    gsize len;
+
+    if (node->children == NULL) {
+        return;
+    }
+    g_hash_table_iter_init(&iter, node->children);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        child = (ber_profile_node_t *)value;
+        len = path->len;
+        g_string_append_printf(path, "%s%s", len ? ";" : "", child->name);
+        fprintf(fp, "%s %" G_GUINT64_FORMAT "\n", path->str, child->self);
+        ber_profile_write_folded(fp, child, path);
+        g_string_truncate(path, len);
+    }
+}
+
+static void
+ber_profile_free(ber_profile_node_t *node)
+{
+    GHashTableIter iter;
+    gpointer value;
+    ber_profile_node_t *child;
+
+    if (node->children == NULL) {
+        return;
+    }
+    g_hash_table_iter_init(&iter, node->children);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        child = (ber_profile_node_t *)value;
+        ber_profile_free(child);
+        g_free((gpointer)child->name);
+        g_free(child);
+    }
+    g_hash_table_destroy(node->children);
+    node->children = NULL;
+}
+
+static void
+ber_profile_report(void)
+{
+    GHashTable *flat;
+    GPtrArray *rows;
+    GHashTableIter iter;
+    gpointer value;
+    GString *path;
+    FILE *fp;
+    guint i;
+
+    if (ber_profile_root.children == NULL) {
+        return;
+    }
+    ber_profile_leave(0);
+
+    flat = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
+    ber_profile_flatten(&ber_profile_root, flat);
+    rows = g_ptr_array_new();
+    g_hash_table_iter_init(&iter, flat);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        g_ptr_array_add(rows, value);
+    }
+    g_ptr_array_sort(rows, ber_profile_cmp_self);
+
+    fprintf(stderr, "BER profile (" BER_PROFILE_UNIT ")\n");
+    fprintf(stderr, "%20s %20s %12s  %s\n", "self", "total", "calls", "name");
+    for (i = 0; i < rows->len; i++) {
+        ber_profile_node_t *row = (ber_profile_node_t *)g_ptr_array_index(rows, i);
+        fprintf(stderr, "%20" G_GUINT64_FORMAT " %20" G_GUINT64_FORMAT " %12" G_GUINT64_FORMAT "  %s\n",
+                row->self, row->total, row->calls, row->name);
+    }
+    g_ptr_array_free(rows, TRUE);
+    g_hash_table_destroy(flat);
+
+    if (ber_profile_filename && ber_profile_filename[0]) {
+        fp = ws_fopen(ber_profile_filename, "w");
+        if (fp == NULL) {
+            fprintf(stderr, "BER ERROR: Could not open profile file %s\n", ber_profile_filename);
+        } else {
+            path = g_string_new("");
+            ber_profile_write_folded(fp, &ber_profile_root, path);
+            g_string_free(path, TRUE);
+            fclose(fp);
+        }
+    }
+
+    ber_profile_free(&ber_profile_root);
+}
+
+/* Memory accounts, in registration order */
+typedef struct {
+    const char *name;
+    ber_mem_usage_func func;
+} ber_mem_account_t;
+
+static GArray *ber_mem_accounts = NULL;
+
+void
+ber_mem_register(const char *name, ber_mem_usage_func func)
+{
+    ber_mem_account_t account;
+
+    if (ber_mem_accounts == NULL) {
+        ber_mem_accounts = g_array_new(FALSE, FALSE, sizeof(ber_mem_account_t));
+    }
+    account.name = name;
+    account.func = func;
+    g_array_append_val(ber_mem_accounts, account);
+}
+
+void
+ber_mem_foreach(ber_mem_report_func func, gpointer user_data)
+{
+    guint i, count;
+    guint64 bytes;
+
+    if (ber_mem_accounts == NULL) {
+        return;
+    }
+    for (i = 0; i < ber_mem_accounts->len; i++) {
+        ber_mem_account_t *account = &g_array_index(ber_mem_accounts, ber_mem_account_t, i);
+
+        count = 0;
+        bytes = 0;
+        account->func(&count, &bytes);
+        func(account->name, count, bytes, user_data);
+    }
+}
+
 static gint8    last_class;
 static gboolean last_pc;
 static gint32   last_tag;
@@ -1299,7 +1598,7 @@ dissect_ber_identifier(packet_info *pinfo _U_, proto_tree *tree, tvbuff_t *tvb,
 /* 8.1.3 Length octets */
 
 static int
-try_get_ber_length(tvbuff_t *tvb, int offset, guint32 *length, gboolean *ind, gint nest_level) {
+get_ber_length_nested(tvbuff_t *tvb, int offset, guint32 *length, gboolean *ind, gint nest_level) {
     guint8   oct, len;
     guint32  indef_len;
     guint32  tmp_length;
@@ -1343,7 +1642,7 @@ try_get_ber_length(tvbuff_t *tvb, int offset, guint32 *length, gboolean *ind, gi
                 /* not an EOC at offset */
                 s_offset = offset;
                 offset= get_ber_identifier(tvb, offset, &tclass, &tpc, &ttag);
-                offset= try_get_ber_length(tvb, offset, &indef_len, NULL, nest_level+1);
+                offset= get_ber_length_nested(tvb, offset, &indef_len, NULL, nest_level+1);
                 tmp_length += indef_len+(offset-s_offset); /* length + tag and length */
                 offset += indef_len;
                                 /* Make sure we've moved forward in the packet */
@@ -1376,7 +1675,123 @@ ws_debug_printf("get BER length %d, offset %d (remaining %d)\n", tmp_length, off
 int
 get_ber_length(tvbuff_t *tvb, int offset, guint32 *length, gboolean *ind)
 {
-    return try_get_ber_length(tvb, offset, length, ind, 1);
+    return get_ber_length_nested(tvb, offset, length, ind, 1);
+}
+
+/*
+ * Non-throwing variants (packet-ber-try.h). A wrong trial key or a
+ * heuristic looking at something that is not BER makes a bad header the
+ * usual outcome there, so these return -1 rather than unwinding through
+ * a TRY block. They do not update the last identifier/length seen.
+ */
+int
+try_get_ber_identifier(tvbuff_t *tvb, int offset, gint8 *ber_class, gboolean *pc, gint32 *tag)
+{
+    guint8 id, t;
+    gint32 tmp_tag;
+
+    if (offset < 0 || !tvb_bytes_exist(tvb, offset, 1))
+        return -1;
+    id = tvb_get_guint8(tvb, offset);
+    offset += 1;
+
+    tmp_tag = id & 0x1F;
+    if (tmp_tag == 0x1F) {
+        tmp_tag = 0;
+        do {
+            if (!tvb_bytes_exist(tvb, offset, 1))
+                return -1;
+            t = tvb_get_guint8(tvb, offset);
+            offset += 1;
+            tmp_tag <<= 7;
+            tmp_tag |= t & 0x7F;
+        } while (t & 0x80);
+    }
+
+    if (ber_class)
+        *ber_class = (id >> 6) & 0x03;
+    if (pc)
+        *pc = (id >> 5) & 0x01;
+    if (tag)
+        *tag = tmp_tag;
+
+    return offset;
+}
+
+static int
+try_get_ber_length_nested(tvbuff_t *tvb, int offset, guint32 *length, gboolean *ind, gint nest_level)
+{
+    guint8   oct, len;
+    guint32  indef_len;
+    guint32  tmp_length = 0;
+    gboolean tmp_ind = FALSE;
+    int      tmp_offset, s_offset;
+
+    if (nest_level > BER_MAX_NESTING || offset < 0 || !tvb_bytes_exist(tvb, offset, 1))
+        return -1;
+
+    oct = tvb_get_guint8(tvb, offset);
+    offset += 1;
+
+    if (!(oct & 0x80)) {
+        tmp_length = oct;
+    } else if ((len = oct & 0x7F) != 0) {
+        if (!tvb_bytes_exist(tvb, offset, len))
+            return -1;
+        while (len--) {
+            tmp_length = (tmp_length<<8) + tvb_get_guint8(tvb, offset);
+            offset++;
+        }
+    } else {
+        tmp_offset = offset;
+        for (;;) {
+            if (!tvb_bytes_exist(tvb, offset, 2))
+                return -1;
+            if (!tvb_get_guint8(tvb, offset) && !tvb_get_guint8(tvb, offset+1))
+                break;
+            s_offset = offset;
+            offset = try_get_ber_identifier(tvb, offset, NULL, NULL, NULL);
+            offset = try_get_ber_length_nested(tvb, offset, &indef_len, NULL, nest_level+1);
+            if (offset < 0 || indef_len > (guint32)(G_MAXINT32 - offset))
+                return -1;
+            tmp_length += indef_len+(offset-s_offset);
+            offset += indef_len;
+        }
+        tmp_length += 2;
+        tmp_ind = TRUE;
+        offset = tmp_offset;
+    }
+
+    if (tmp_length > (guint32)G_MAXINT32)
+        tmp_length = (guint32)G_MAXINT32;
+
+    if (length)
+        *length = tmp_length;
+    if (ind)
+        *ind = tmp_ind;
+
+    return offset;
+}
+
+int
+try_get_ber_length(tvbuff_t *tvb, int offset, guint32 *length, gboolean *ind)
+{
+    return try_get_ber_length_nested(tvb, offset, length, ind, 1);
+}
+
+int
+try_get_ber_tl(tvbuff_t *tvb, int offset, gint8 *ber_class, gboolean *pc, gint32 *tag, guint32 *length)
+{
+    guint32 tmp_length;
+
+    offset = try_get_ber_identifier(tvb, offset, ber_class, pc, tag);
+    offset = try_get_ber_length(tvb, offset, &tmp_length, NULL);
+    if (offset < 0 || !tvb_bytes_exist(tvb, offset, tmp_length))
+        return -1;
+    if (length)
+        *length = tmp_length;
+
+    return offset;
 }
 
 static void
@@ -1432,6 +1847,17 @@ proto_tree_add_debug_text("dissect BER length %d, offset %d (remaining %d)\n", t
 }
 
 static reassembly_table octet_segment_reassembly_table;
+/* segments held by octet_segment_reassembly_table, for ber_mem_register():
+ * added per segment, the data taken off again when a reassembly completes */
+static guint octet_segment_count = 0;
+static guint64 octet_segment_bytes = 0;
+
+static void
+octet_segment_mem_usage(guint *count, guint64 *bytes)
+{
+    *count = octet_segment_count;
+    *bytes = octet_segment_bytes;
+}
 
 static int
 dissect_ber_constrained_octet_string_impl(gboolean implicit_tag, asn1_ctx_t *actx, proto_tree *tree, tvbuff_t *tvb, int offset, gint32 min_len, gint32 max_len, gint hf_id, tvbuff_t **out_tvb, guint nest_level, guint encoding);
@@ -1509,10 +1935,27 @@ reassemble_octet_string(asn1_ctx_t *actx, proto_tree *tree, gint hf_id, tvbuff_t
                                         next_tvb, 0, actx->pinfo, dst_ref, NULL,
                                         tvb_reported_length(next_tvb),
                                         fragment);
+        if (!PINFO_FD_VISITED(actx->pinfo)) {
+            octet_segment_count++;
+            octet_segment_bytes += sizeof(fragment_item) + tvb_reported_length(next_tvb);
+        }
 
         firstFragment = FALSE;
     }
 
+    if (fd_head && !PINFO_FD_VISITED(actx->pinfo)) {
+        fragment_item *fd;
+
+        /* complete: the segments' data is freed, the reassembled copy is kept */
+        for (fd = fd_head->next; fd != NULL; fd = fd->next) {
+            if (octet_segment_count > 0) {
+                octet_segment_count--;
+            }
+            octet_segment_bytes -= MIN(octet_segment_bytes, (guint64)fd->len);
+        }
+        octet_segment_bytes += fd_head->datalen;
+    }
+
     if (fd_head) {
         if (fd_head->next) {
             /* not sure I really want to do this here - should be nearer the application where we can give it a better name*/
@@ -1788,9 +2231,7 @@ proto_tree_add_debug_text(tree, "OCTET STRING dissect_ber_octet_string(%s) enter
                     counter++;
                     if( currentChar == ',')
                     {
-                        char* subbuff = (char*)malloc(counter);
-                        memcpy(subbuff, &name[currentOffset], counter);
-                        subbuff[counter - 1] = '\0';
+                        char* subbuff = wmem_strndup(wmem_packet_scope(), &name[currentOffset], counter - 1);
                         proto_item *ti = proto_tree_add_item(sids, 0, tvb, currentOffset + 2, counter - 1, encoding);
                         proto_item_append_text(ti, ", Sid: %s", subbuff);
                         currentOffset = currentOffset + counter;
@@ -1799,8 +2240,7 @@ proto_tree_add_debug_text(tree, "OCTET STRING dissect_ber_octet_string(%s) enter
                 }
 
                 // add the last one
-                char* subbuff = (char*)malloc(counter);
-                memcpy(subbuff, &name[currentOffset], counter);
+                char* subbuff = wmem_strndup(wmem_packet_scope(), &name[currentOffset], counter);
                 proto_item* ti = proto_tree_add_item(sids, 0, tvb, currentOffset + 3, counter, encoding);
                 proto_item_append_text(ti, ", Sid: %s", subbuff);
             }
@@ -1825,7 +2265,15 @@ proto_tree_add_debug_text(tree, "OCTET STRING dissect_ber_octet_string(%s) enter
 
 int
 dissect_ber_octet_string(gboolean implicit_tag, asn1_ctx_t *actx, proto_tree *tree, tvbuff_t *tvb, int offset, gint hf_id, tvbuff_t **out_tvb) {
-  return dissect_ber_constrained_octet_string_impl(implicit_tag, actx, tree, tvb, offset, NO_BOUND, NO_BOUND, hf_id, out_tvb, 0, 0);
+  guint depth;
+
+  if (!ber_profile_enabled)
+    return dissect_ber_constrained_octet_string_impl(implicit_tag, actx, tree, tvb, offset, NO_BOUND, NO_BOUND, hf_id, out_tvb, 0, 0);
+
+  depth = ber_profile_enter(actx->pinfo, ber_profile_name("OCTET_STRING", hf_id));
+  offset = dissect_ber_constrained_octet_string_impl(implicit_tag, actx, tree, tvb, offset, NO_BOUND, NO_BOUND, hf_id, out_tvb, 0, 0);
+  ber_profile_leave(depth);
+  return offset;
 }
 
 int
@@ -2172,103 +2620,26 @@ dissect_ber_real(gboolean implicit_tag, asn1_ctx_t *actx, proto_tree *tree, tvbu
     return end_offset;
 
 }
-/* this function dissects a BER sequence
+/* The fields of a SEQUENCE from offset up to end_offset, matched against
+ * seq onwards; returns FALSE if an end-of-contents stopped it early.
+ * dissect_ber_schema() resumes here when the encoding stops lining up.
  */
-int
-dissect_ber_sequence(gboolean implicit_tag, asn1_ctx_t *actx, proto_tree *parent_tree, tvbuff_t *tvb, int offset, const ber_sequence_t *seq, gint hf_id, gint ett_id) {
-    gint8       classx;
-    gboolean    pcx, ind   = 0, ind_field, imp_tag = FALSE;
-    gint32      tagx;
+static gboolean
+ber_sequence_fields(asn1_ctx_t *actx, proto_tree *tree, proto_item *item, tvbuff_t *tvb, int offset, int end_offset, const ber_sequence_t *seq, gint hf_id _U_) {
+    gboolean    ind, ind_field, imp_tag = FALSE;
     int         identifier_offset;
     int         identifier_len;
-    guint32     lenx;
-    proto_tree *tree       = parent_tree;
-    proto_item *item       = NULL;
     proto_item *cause;
-    int         end_offset = 0;
     int         hoffset;
     tvbuff_t   *next_tvb;
 
-#ifdef DEBUG_BER
-{
-const char *name;
-header_field_info *hfinfo;
-if (hf_id >= 0) {
-hfinfo = proto_registrar_get_nth(hf_id);
-name = hfinfo->name;
-} else {
-name = "unnamed";
-}
-if (tvb_reported_length_remaining(tvb, offset) > 3) {
-proto_tree_add_debug_text(tree, "SEQUENCE dissect_ber_sequence(%s) entered offset:%d len:%d %02x:%02x:%02x\n", name, offset, tvb_reported_length_remaining(tvb, offset), tvb_get_guint8(tvb, offset), tvb_get_guint8(tvb, offset+1), tvb_get_guint8(tvb, offset+2));
-} else {
-proto_tree_add_debug_text(tree, "SEQUENCE dissect_ber_sequence(%s) entered\n", name);
-}
-}
-#endif
-    hoffset = offset;
-    if (!implicit_tag) {
-        offset = get_ber_identifier(tvb, offset, NULL, NULL, NULL);
-        offset = get_ber_length(tvb, offset, &lenx, NULL);
-    } else {
-        /* was implicit tag so just use the length of the tvb */
-        lenx = tvb_reported_length_remaining(tvb, offset);
-        end_offset = offset+lenx;
-    }
-    /* create subtree */
-    if (hf_id >= 0) {
-        if (parent_tree) {
-            item = proto_tree_add_item(parent_tree, hf_id, tvb, hoffset, lenx + offset - hoffset, ENC_BIG_ENDIAN);
-            tree = proto_item_add_subtree(item, ett_id);
-        }
-    }
-    offset = hoffset;
-
-    if (!implicit_tag) {
-        /* first we must read the sequence header */
-        identifier_offset = offset;
-        offset = dissect_ber_identifier(actx->pinfo, tree, tvb, offset, &classx, &pcx, &tagx);
-        identifier_len = offset - identifier_offset;
-        offset = dissect_ber_length(actx->pinfo, tree, tvb, offset, &lenx, &ind);
-        if (ind) {
-        /*  Fixed the length is correctly returned from dissect ber_length
-          end_offset = tvb_reported_length(tvb);*/
-          end_offset = offset + lenx -2;
-        } else {
-          end_offset = offset + lenx;
-        }
-
-        /* sanity check: we only handle Constructed Universal Sequences */
-        if ((classx != BER_CLASS_APP) && (classx != BER_CLASS_PRI)) {
-            if (!pcx
-             || ((classx != BER_CLASS_UNI) || (tagx != BER_UNI_TAG_SEQUENCE))) {
-                tvb_ensure_bytes_exist(tvb, hoffset, 2);
-                cause = proto_tree_add_expert_format(
-                    tree, actx->pinfo, &ei_ber_expected_sequence,
-                    tvb, identifier_offset, identifier_len,
-                    "BER Error: Sequence expected but class:%s(%d) %s tag:%d was unexpected",
-                    val_to_str_const(classx, ber_class_codes, "Unknown"),
-                    classx,
-                    tfs_get_string(pcx, &ber_pc_codes_short),
-                    tagx);
-                if (decode_unexpected) {
-                    proto_tree *unknown_tree = proto_item_add_subtree(cause, ett_ber_unknown);
-                    dissect_unknown_ber(actx->pinfo, tvb, hoffset, unknown_tree);
-                }
-                return end_offset;
-            }
-        }
-    }
-    if(offset == end_offset){
-        proto_item_append_text(item, " [0 length]");
-    }
-    /* loop over all entries until we reach the end of the sequence */
-    while (offset < end_offset) {
-        gint8    ber_class;
-        gboolean pc;
-        gint32   tag;
-        guint32  len;
-        int      eoffset, count;
+    /* loop over all entries until we reach the end of the sequence */
+    while (offset < end_offset) {
+        gint8    ber_class;
+        gboolean pc;
+        gint32   tag;
+        guint32  len;
+        int      eoffset, count;
 
         /*if (ind) {  this sequence was of indefinite length, if this is implicit indefinite impossible maybe
                     but ber dissector uses this to eat the tag length then pass into here... EOC still on there...*/
@@ -2277,7 +2648,7 @@ proto_tree_add_debug_text(tree, "SEQUENCE dissect_ber_sequence(%s) entered\n", n
                 offset = dissect_ber_identifier(actx->pinfo, tree, tvb, offset, &ber_class, &pc, &tag);
                 dissect_ber_length(actx->pinfo, tree, tvb, offset, &len, &ind);
                 proto_item_append_text(item, " 0 items");
-                return end_offset;
+                return FALSE;
                 /*
                 if (show_internal_ber_fields) {
                     proto_tree_add_expert(tree, pinfo, &ei_ber_error_seq_eoc, tvb, s_offset, offset+2, "ERROR WRONG SEQ EOC");
@@ -2527,6 +2898,101 @@ proto_tree_add_debug_text(tree, "SEQUENCE dissect_ber_sequence(%s) subdissector
             "BER Error: SEQUENCE is %d too many bytes long",
             offset - end_offset);
     }
+    return TRUE;
+}
+
+/* this function dissects a BER sequence
+ */
+static int
+dissect_ber_sequence_impl(gboolean implicit_tag, asn1_ctx_t *actx, proto_tree *parent_tree, tvbuff_t *tvb, int offset, const ber_sequence_t *seq, gint hf_id, gint ett_id) {
+    gint8       classx;
+    gboolean    pcx, ind   = 0;
+    gint32      tagx;
+    int         identifier_offset;
+    int         identifier_len;
+    guint32     lenx;
+    proto_tree *tree       = parent_tree;
+    proto_item *item       = NULL;
+    proto_item *cause;
+    int         end_offset = 0;
+    int         hoffset;
+
+#ifdef DEBUG_BER
+{
+const char *name;
+header_field_info *hfinfo;
+if (hf_id >= 0) {
+hfinfo = proto_registrar_get_nth(hf_id);
+name = hfinfo->name;
+} else {
+name = "unnamed";
+}
+if (tvb_reported_length_remaining(tvb, offset) > 3) {
+proto_tree_add_debug_text(tree, "SEQUENCE dissect_ber_sequence(%s) entered offset:%d len:%d %02x:%02x:%02x\n", name, offset, tvb_reported_length_remaining(tvb, offset), tvb_get_guint8(tvb, offset), tvb_get_guint8(tvb, offset+1), tvb_get_guint8(tvb, offset+2));
+} else {
+proto_tree_add_debug_text(tree, "SEQUENCE dissect_ber_sequence(%s) entered\n", name);
+}
+}
+#endif
+    hoffset = offset;
+    if (!implicit_tag) {
+        offset = get_ber_identifier(tvb, offset, NULL, NULL, NULL);
+        offset = get_ber_length(tvb, offset, &lenx, NULL);
+    } else {
+        /* was implicit tag so just use the length of the tvb */
+        lenx = tvb_reported_length_remaining(tvb, offset);
+        end_offset = offset+lenx;
+    }
+    /* create subtree */
+    if (hf_id >= 0) {
+        if (parent_tree) {
+            item = proto_tree_add_item(parent_tree, hf_id, tvb, hoffset, lenx + offset - hoffset, ENC_BIG_ENDIAN);
+            tree = proto_item_add_subtree(item, ett_id);
+        }
+    }
+    offset = hoffset;
+
+    if (!implicit_tag) {
+        /* first we must read the sequence header */
+        identifier_offset = offset;
+        offset = dissect_ber_identifier(actx->pinfo, tree, tvb, offset, &classx, &pcx, &tagx);
+        identifier_len = offset - identifier_offset;
+        offset = dissect_ber_length(actx->pinfo, tree, tvb, offset, &lenx, &ind);
+        if (ind) {
+        /*  Fixed the length is correctly returned from dissect ber_length
+          end_offset = tvb_reported_length(tvb);*/
+          end_offset = offset + lenx -2;
+        } else {
+          end_offset = offset + lenx;
+        }
+
+        /* sanity check: we only handle Constructed Universal Sequences */
+        if ((classx != BER_CLASS_APP) && (classx != BER_CLASS_PRI)) {
+            if (!pcx
+             || ((classx != BER_CLASS_UNI) || (tagx != BER_UNI_TAG_SEQUENCE))) {
+                tvb_ensure_bytes_exist(tvb, hoffset, 2);
+                cause = proto_tree_add_expert_format(
+                    tree, actx->pinfo, &ei_ber_expected_sequence,
+                    tvb, identifier_offset, identifier_len,
+                    "BER Error: Sequence expected but class:%s(%d) %s tag:%d was unexpected",
+                    val_to_str_const(classx, ber_class_codes, "Unknown"),
+                    classx,
+                    tfs_get_string(pcx, &ber_pc_codes_short),
+                    tagx);
+                if (decode_unexpected) {
+                    proto_tree *unknown_tree = proto_item_add_subtree(cause, ett_ber_unknown);
+                    dissect_unknown_ber(actx->pinfo, tvb, hoffset, unknown_tree);
+                }
+                return end_offset;
+            }
+        }
+    }
+    if(offset == end_offset){
+        proto_item_append_text(item, " [0 length]");
+    }
+    if (!ber_sequence_fields(actx, tree, item, tvb, offset, end_offset, seq, hf_id)) {
+        return end_offset;
+    }
     if (ind) {
         /*  need to eat this EOC
         end_offset = tvb_reported_length(tvb);*/
@@ -2538,10 +3004,24 @@ proto_tree_add_debug_text(tree, "SEQUENCE dissect_ber_sequence(%s) subdissector
     return end_offset;
 }
 
+int
+dissect_ber_sequence(gboolean implicit_tag, asn1_ctx_t *actx, proto_tree *parent_tree, tvbuff_t *tvb, int offset, const ber_sequence_t *seq, gint hf_id, gint ett_id) {
+    guint depth;
+
+    if (!ber_profile_enabled)
+        return dissect_ber_sequence_impl(implicit_tag, actx, parent_tree, tvb, offset, seq, hf_id, ett_id);
+
+    depth = ber_profile_enter(actx->pinfo, ber_profile_name("SEQUENCE", hf_id));
+    offset = dissect_ber_sequence_impl(implicit_tag, actx, parent_tree, tvb, offset, seq, hf_id, ett_id);
+    ber_profile_leave(depth);
+    return offset;
+}
+
+
 /* This function dissects a BER set
  */
-int
-dissect_ber_set(gboolean implicit_tag, asn1_ctx_t *actx, proto_tree *parent_tree, tvbuff_t *tvb, int offset, const ber_sequence_t *set, gint hf_id, gint ett_id) {
+static int
+dissect_ber_set_impl(gboolean implicit_tag, asn1_ctx_t *actx, proto_tree *parent_tree, tvbuff_t *tvb, int offset, const ber_sequence_t *set, gint hf_id, gint ett_id) {
     gint8       classx;
     gboolean    pcx, ind = 0, ind_field, imp_tag = FALSE;
     gint32      tagx;
@@ -2829,12 +3309,26 @@ proto_tree_add_debug_text(tree, "SET dissect_ber_set(%s) calling subdissector\n"
 
 }
 
+int
+dissect_ber_set(gboolean implicit_tag, asn1_ctx_t *actx, proto_tree *parent_tree, tvbuff_t *tvb, int offset, const ber_sequence_t *set, gint hf_id, gint ett_id) {
+    guint depth;
+
+    if (!ber_profile_enabled)
+        return dissect_ber_set_impl(implicit_tag, actx, parent_tree, tvb, offset, set, hf_id, ett_id);
+
+    depth = ber_profile_enter(actx->pinfo, ber_profile_name("SET", hf_id));
+    offset = dissect_ber_set_impl(implicit_tag, actx, parent_tree, tvb, offset, set, hf_id, ett_id);
+    ber_profile_leave(depth);
+    return offset;
+}
+
+
 #ifdef DEBUG_BER
 #define DEBUG_BER_CHOICE
 #endif
 
-int
-dissect_ber_choice(asn1_ctx_t *actx, proto_tree *parent_tree, tvbuff_t *tvb, int offset, const ber_choice_t *choice, gint hf_id, gint ett_id, gint *branch_taken)
+static int
+dissect_ber_choice_impl(asn1_ctx_t *actx, proto_tree *parent_tree, tvbuff_t *tvb, int offset, const ber_choice_t *choice, gint hf_id, gint ett_id, gint *branch_taken)
 {
     gint8       ber_class;
     gboolean    pc, ind, imp_tag = FALSE;
@@ -3060,6 +3554,21 @@ proto_tree_add_debug_text(tree, "CHOICE dissect_ber_choice(%s) trying again\n",
     return start_offset;
 }
 
+int
+dissect_ber_choice(asn1_ctx_t *actx, proto_tree *parent_tree, tvbuff_t *tvb, int offset, const ber_choice_t *choice, gint hf_id, gint ett_id, gint *branch_taken)
+{
+    guint depth;
+
+    if (!ber_profile_enabled)
+        return dissect_ber_choice_impl(actx, parent_tree, tvb, offset, choice, hf_id, ett_id, branch_taken);
+
+    depth = ber_profile_enter(actx->pinfo, ber_profile_name("CHOICE", hf_id));
+    offset = dissect_ber_choice_impl(actx, parent_tree, tvb, offset, choice, hf_id, ett_id, branch_taken);
+    ber_profile_leave(depth);
+    return offset;
+}
+
+
 #if 0
 /* this function dissects a BER GeneralString
  */
@@ -3363,10 +3872,136 @@ dissect_ber_object_identifier_str(gboolean implicit_tag, asn1_ctx_t *actx, proto
 #define DEBUG_BER_SQ_OF
 #endif
 
+/* The elements of a SEQUENCE OF or SET OF from offset up to end_offset;
+ * dissect_ber_schema() resumes here when the encoding stops lining up.
+ */
 static int
-dissect_ber_sq_of(gboolean implicit_tag, gint32 type, asn1_ctx_t *actx, proto_tree *parent_tree, tvbuff_t *tvb, int offset, gint32 min_len, gint32 max_len, const ber_sequence_t *seq, gint hf_id, gint ett_id) {
+ber_sq_of_items(gint32 type, asn1_ctx_t *actx, proto_tree *tree, tvbuff_t *tvb, int offset, int end_offset, const ber_sequence_t *seq) {
+    gboolean  ind_field;
+    int       identifier_offset;
+    int       identifier_len;
+    tvbuff_t *next_tvb;
+
+    /* loop over all entries until we reach the end of the sequence */
+    while (offset < end_offset) {
+        gint8       ber_class;
+        gboolean    pc;
+        gint32      tag;
+        guint32     len;
+        int         eoffset;
+        int         hoffset;
+        proto_item *cause;
+        gboolean    imp_tag;
+
+        hoffset = offset;
+        /*if (ind) {  this sequence was of indefinite length, if this is implicit indefinite impossible maybe
+          but ber dissector uses this to eat the tag length then pass into here... EOC still on there...*/
+            if ((tvb_get_guint8(tvb, offset) == 0) && (tvb_get_guint8(tvb, offset+1) == 0)) {
+                if (show_internal_ber_fields) {
+                    proto_tree_add_item(tree, hf_ber_seq_of_eoc, tvb, hoffset, end_offset-hoffset, ENC_NA);
+                }
+                return offset+2;
+            }
+        /*}*/
+        /* read header and len for next field */
+        identifier_offset = offset;
+        offset  = get_ber_identifier(tvb, offset, &ber_class, &pc, &tag);
+        identifier_len = offset - identifier_offset;
+        offset  = get_ber_length(tvb, offset, &len, &ind_field);
+        eoffset = offset + len;
+                /* Make sure we move forward */
+        if (eoffset <= hoffset)
+            THROW(ReportedBoundsError);
+
+        if ((ber_class == BER_CLASS_UNI) && (tag == BER_UNI_TAG_EOC)) {
+            /* This is a zero length sequence of*/
+            hoffset = dissect_ber_identifier(actx->pinfo, tree, tvb, hoffset, NULL, NULL, NULL);
+            dissect_ber_length(actx->pinfo, tree, tvb, hoffset, NULL, NULL);
+            return eoffset;
+        }
+        /* verify that this one is the one we want */
+        /* ahup if we are implicit then we return to the upper layer how much we have used */
+        if (seq->ber_class != BER_CLASS_ANY) {
+          if ((seq->ber_class != ber_class)
+           || (seq->tag != tag) ) {
+            if (!(seq->flags & BER_FLAGS_NOTCHKTAG)) {
+                if ( seq->ber_class == BER_CLASS_UNI) {
+                    cause = proto_tree_add_expert_format(
+                        tree, actx->pinfo, &ei_ber_sequence_field_wrong,
+                        tvb, identifier_offset, identifier_len,
+                        "BER Error: Wrong field in SEQUENCE OF: expected class:%s(%d) tag:%d(%s) but found class:%s(%d) tag:%d",
+                        val_to_str_const(seq->ber_class, ber_class_codes, "Unknown"),
+                        seq->ber_class,
+                        seq->tag,
+                        val_to_str_ext_const(seq->tag, &ber_uni_tag_codes_ext, "Unknown"),
+                        val_to_str_const(ber_class, ber_class_codes, "Unknown"),
+                        ber_class, tag);
+                } else {
+                    cause = proto_tree_add_expert_format(
+                        tree, actx->pinfo, &ei_ber_sequence_field_wrong,
+                        tvb, identifier_offset, identifier_len,
+                        "BER Error: Wrong field in SEQUENCE OF: expected class:%s(%d) tag:%d but found class:%s(%d) tag:%d",
+                        val_to_str_const(seq->ber_class, ber_class_codes, "Unknown"),
+                        seq->ber_class,
+                        seq->tag,
+                        val_to_str_const(ber_class, ber_class_codes, "Unknown"),
+                        ber_class,
+                        tag);
+                }
+                if (decode_unexpected) {
+                    proto_tree *unknown_tree = proto_item_add_subtree(cause, ett_ber_unknown);
+                    dissect_unknown_ber(actx->pinfo, tvb, hoffset, unknown_tree);
+                }
+                offset = eoffset;
+                continue;
+                /* wrong.... */
+            }
+          }
+        }
+
+        if (!(seq->flags & BER_FLAGS_NOOWNTAG) && !(seq->flags & BER_FLAGS_IMPLTAG)) {
+            /* dissect header and len for field */
+            hoffset = dissect_ber_identifier(actx->pinfo, tree, tvb, hoffset, NULL, NULL, NULL);
+            hoffset = dissect_ber_length(actx->pinfo, tree, tvb, hoffset, NULL, NULL);
+        }
+        if ((seq->flags == BER_FLAGS_IMPLTAG) && (seq->ber_class == BER_CLASS_CON)) {
+            /* Constructed sequence of with a tag */
+            /* dissect header and len for field */
+            hoffset = dissect_ber_identifier(actx->pinfo, tree, tvb, hoffset, NULL, NULL, NULL);
+            hoffset = dissect_ber_length(actx->pinfo, tree, tvb, hoffset, NULL, NULL);
+            /* Function has IMPLICIT TAG */
+        }
+
+        next_tvb = ber_tvb_new_subset_length(tvb, hoffset, eoffset-hoffset);
+
+        imp_tag = FALSE;
+        if (seq->flags == BER_FLAGS_IMPLTAG)
+            imp_tag = TRUE;
+        /* call the dissector for this field */
+        seq->func(imp_tag, next_tvb, 0, actx, tree, *seq->p_id);
+        /* hold on if we are implicit and the result is zero, i.e. the item in the sequence of
+           doesn't match the next item, thus this implicit sequence is over, return the number of bytes
+           we have eaten to allow the possible upper sequence continue... */
+        offset = eoffset;
+    }
+
+    /* if we didn't end up at exactly offset, then we ate too many bytes */
+    if (offset != end_offset) {
+        tvb_ensure_bytes_exist(tvb, offset-2, 2);
+        proto_tree_add_expert_format(
+            tree, actx->pinfo, &ei_ber_error_length, tvb, offset-2, 2,
+            "BER Error: %s OF contained %d too many bytes",
+            (type == BER_UNI_TAG_SEQUENCE) ? "SET" : "SEQUENCE",
+            offset - end_offset);
+    }
+
+    return end_offset;
+}
+
+static int
+dissect_ber_sq_of_impl(gboolean implicit_tag, gint32 type, asn1_ctx_t *actx, proto_tree *parent_tree, tvbuff_t *tvb, int offset, gint32 min_len, gint32 max_len, const ber_sequence_t *seq, gint hf_id, gint ett_id) {
     gint8              classx;
-    gboolean           pcx, ind = FALSE, ind_field;
+    gboolean           pcx, ind = FALSE;
     gint32             tagx;
     int                identifier_offset;
     int                identifier_len;
@@ -3378,7 +4013,6 @@ dissect_ber_sq_of(gboolean implicit_tag, gint32 type, asn1_ctx_t *actx, proto_tr
     int                cnt, hoffsetx, end_offset;
     gboolean           have_cnt;
     header_field_info *hfi;
-    tvbuff_t          *next_tvb;
 
 #ifdef DEBUG_BER_SQ_OF
 {
@@ -3497,123 +4131,23 @@ proto_tree_add_debug_text(tree, "SQ OF dissect_ber_sq_of(%s) entered\n", name);
         }
     }
 
-    /* loop over all entries until we reach the end of the sequence */
-    while (offset < end_offset) {
-        gint8       ber_class;
-        gboolean    pc;
-        gint32      tag;
-        guint32     len;
-        int         eoffset;
-        int         hoffset;
-        proto_item *cause;
-        gboolean    imp_tag;
-
-        hoffset = offset;
-        /*if (ind) {  this sequence was of indefinite length, if this is implicit indefinite impossible maybe
-          but ber dissector uses this to eat the tag length then pass into here... EOC still on there...*/
-            if ((tvb_get_guint8(tvb, offset) == 0) && (tvb_get_guint8(tvb, offset+1) == 0)) {
-                if (show_internal_ber_fields) {
-                    proto_tree_add_item(tree, hf_ber_seq_of_eoc, tvb, hoffset, end_offset-hoffset, ENC_NA);
-                }
-                return offset+2;
-            }
-        /*}*/
-        /* read header and len for next field */
-        identifier_offset = offset;
-        offset  = get_ber_identifier(tvb, offset, &ber_class, &pc, &tag);
-        identifier_len = offset - identifier_offset;
-        offset  = get_ber_length(tvb, offset, &len, &ind_field);
-        eoffset = offset + len;
-                /* Make sure we move forward */
-        if (eoffset <= hoffset)
-            THROW(ReportedBoundsError);
-
-        if ((ber_class == BER_CLASS_UNI) && (tag == BER_UNI_TAG_EOC)) {
-            /* This is a zero length sequence of*/
-            hoffset = dissect_ber_identifier(actx->pinfo, tree, tvb, hoffset, NULL, NULL, NULL);
-            dissect_ber_length(actx->pinfo, tree, tvb, hoffset, NULL, NULL);
-            return eoffset;
-        }
-        /* verify that this one is the one we want */
-        /* ahup if we are implicit then we return to the upper layer how much we have used */
-        if (seq->ber_class != BER_CLASS_ANY) {
-          if ((seq->ber_class != ber_class)
-           || (seq->tag != tag) ) {
-            if (!(seq->flags & BER_FLAGS_NOTCHKTAG)) {
-                if ( seq->ber_class == BER_CLASS_UNI) {
-                    cause = proto_tree_add_expert_format(
-                        tree, actx->pinfo, &ei_ber_sequence_field_wrong,
-                        tvb, identifier_offset, identifier_len,
-                        "BER Error: Wrong field in SEQUENCE OF: expected class:%s(%d) tag:%d(%s) but found class:%s(%d) tag:%d",
-                        val_to_str_const(seq->ber_class, ber_class_codes, "Unknown"),
-                        seq->ber_class,
-                        seq->tag,
-                        val_to_str_ext_const(seq->tag, &ber_uni_tag_codes_ext, "Unknown"),
-                        val_to_str_const(ber_class, ber_class_codes, "Unknown"),
-                        ber_class, tag);
-                } else {
-                    cause = proto_tree_add_expert_format(
-                        tree, actx->pinfo, &ei_ber_sequence_field_wrong,
-                        tvb, identifier_offset, identifier_len,
-                        "BER Error: Wrong field in SEQUENCE OF: expected class:%s(%d) tag:%d but found class:%s(%d) tag:%d",
-                        val_to_str_const(seq->ber_class, ber_class_codes, "Unknown"),
-                        seq->ber_class,
-                        seq->tag,
-                        val_to_str_const(ber_class, ber_class_codes, "Unknown"),
-                        ber_class,
-                        tag);
-                }
-                if (decode_unexpected) {
-                    proto_tree *unknown_tree = proto_item_add_subtree(cause, ett_ber_unknown);
-                    dissect_unknown_ber(actx->pinfo, tvb, hoffset, unknown_tree);
-                }
-                offset = eoffset;
-                continue;
-                /* wrong.... */
-            }
-          }
-        }
-
-        if (!(seq->flags & BER_FLAGS_NOOWNTAG) && !(seq->flags & BER_FLAGS_IMPLTAG)) {
-            /* dissect header and len for field */
-            hoffset = dissect_ber_identifier(actx->pinfo, tree, tvb, hoffset, NULL, NULL, NULL);
-            hoffset = dissect_ber_length(actx->pinfo, tree, tvb, hoffset, NULL, NULL);
-        }
-        if ((seq->flags == BER_FLAGS_IMPLTAG) && (seq->ber_class == BER_CLASS_CON)) {
-            /* Constructed sequence of with a tag */
-            /* dissect header and len for field */
-            hoffset = dissect_ber_identifier(actx->pinfo, tree, tvb, hoffset, NULL, NULL, NULL);
-            hoffset = dissect_ber_length(actx->pinfo, tree, tvb, hoffset, NULL, NULL);
-            /* Function has IMPLICIT TAG */
-        }
-
-        next_tvb = ber_tvb_new_subset_length(tvb, hoffset, eoffset-hoffset);
+    return ber_sq_of_items(type, actx, tree, tvb, offset, end_offset, seq);
+}
 
-        imp_tag = FALSE;
-        if (seq->flags == BER_FLAGS_IMPLTAG)
-            imp_tag = TRUE;
-        /* call the dissector for this field */
-        seq->func(imp_tag, next_tvb, 0, actx, tree, *seq->p_id);
-        /* hold on if we are implicit and the result is zero, i.e. the item in the sequence of
-           doesn't match the next item, thus this implicit sequence is over, return the number of bytes
-           we have eaten to allow the possible upper sequence continue... */
-        cnt++; /* rubbish*/
-        offset = eoffset;
-    }
+static int
+dissect_ber_sq_of(gboolean implicit_tag, gint32 type, asn1_ctx_t *actx, proto_tree *parent_tree, tvbuff_t *tvb, int offset, gint32 min_len, gint32 max_len, const ber_sequence_t *seq, gint hf_id, gint ett_id) {
+    guint depth;
 
-    /* if we didn't end up at exactly offset, then we ate too many bytes */
-    if (offset != end_offset) {
-        tvb_ensure_bytes_exist(tvb, offset-2, 2);
-        proto_tree_add_expert_format(
-            tree, actx->pinfo, &ei_ber_error_length, tvb, offset-2, 2,
-            "BER Error: %s OF contained %d too many bytes",
-            (type == BER_UNI_TAG_SEQUENCE) ? "SET" : "SEQUENCE",
-            offset - end_offset);
-    }
+    if (!ber_profile_enabled)
+        return dissect_ber_sq_of_impl(implicit_tag, type, actx, parent_tree, tvb, offset, min_len, max_len, seq, hf_id, ett_id);
 
-    return end_offset;
+    depth = ber_profile_enter(actx->pinfo, ber_profile_name((type == BER_UNI_TAG_SET) ? "SET_OF" : "SEQUENCE_OF", hf_id));
+    offset = dissect_ber_sq_of_impl(implicit_tag, type, actx, parent_tree, tvb, offset, min_len, max_len, seq, hf_id, ett_id);
+    ber_profile_leave(depth);
+    return offset;
 }
 
+
 int
 dissect_ber_constrained_sequence_of(gboolean implicit_tag, asn1_ctx_t *actx, proto_tree *parent_tree, tvbuff_t *tvb, int offset, gint32 min_len, gint32 max_len, const ber_sequence_t *seq, gint hf_id, gint ett_id) {
     return dissect_ber_sq_of(implicit_tag, BER_UNI_TAG_SEQUENCE, actx, parent_tree, tvb, offset, min_len, max_len, seq, hf_id, ett_id);
@@ -3634,6 +4168,256 @@ dissect_ber_set_of(gboolean implicit_tag, asn1_ctx_t *actx, proto_tree *parent_t
     return dissect_ber_sq_of(implicit_tag, BER_UNI_TAG_SET, actx, parent_tree, tvb, offset, NO_BOUND, NO_BOUND, seq, hf_id, ett_id);
 }
 
+/*
+ * Table-driven dissection, see packet-ber-schema.h. A SEQUENCE is walked
+ * once against its generated table with the non-throwing header decoder:
+ * each field that lines up goes straight to its function, and from the
+ * first one that does not (an unexpected tag, an indefinite length, an
+ * EXPLICIT tag around more or less than one element) the rest goes
+ * through the same loop as dissect_ber_sequence(), so malformed data is
+ * reported the same way. A SEQUENCE OF only counts its elements up front
+ * when the count is shown in the tree.
+ *
+ * Types that are only reached from tables have no generated function:
+ * their fields call dissect_ber_schema_field(), which finds the schema
+ * by the field's hf id, so with the preference off the same tables run
+ * through dissect_ber_sequence()/dissect_ber_sequence_of() unchanged.
+ */
+static gboolean ber_schema_enabled = FALSE;
+static GPtrArray *ber_schema_fields = NULL;     /* indexed by hf id */
+
+/* Header at offset with a definite length that ends by end; returns the
+ * offset of the contents, or -1.
+ */
+static int
+ber_schema_header(tvbuff_t *tvb, int offset, int end, gint8 *ber_class, gboolean *pc, gint32 *tag, int *field_end)
+{
+    guint32 len;
+    gboolean ind;
+    int contents;
+
+    contents = try_get_ber_identifier(tvb, offset, ber_class, pc, tag);
+    if (contents < 0 || contents >= end) {
+        return -1;
+    }
+    contents = try_get_ber_length(tvb, contents, &len, &ind);
+    if (contents < 0 || ind || len > (guint32)(end - contents)) {
+        return -1;
+    }
+    *field_end = contents + len;
+    return contents;
+}
+
+static gboolean
+ber_schema_check_explicit(tvbuff_t *tvb, int contents, int field_end, const ber_sequence_t *seq)
+{
+    gint8 ber_class;
+    gboolean pc;
+    gint32 tag;
+    int inner_end;
+
+    if (seq->flags & (BER_FLAGS_IMPLTAG | BER_FLAGS_NOOWNTAG)) {
+        return TRUE;
+    }
+    /* exactly one element inside the tag */
+    return ber_schema_header(tvb, contents, field_end, &ber_class, &pc, &tag, &inner_end) >= 0 &&
+        inner_end == field_end;
+}
+
+/* The SEQUENCE or SEQUENCE OF header; returns the offset of the contents, or -1 */
+static int
+ber_schema_outer(gboolean implicit_tag, tvbuff_t *tvb, int offset, int *end)
+{
+    gint8 ber_class;
+    gboolean pc;
+    gint32 tag;
+    int contents;
+
+    if (implicit_tag) {
+        *end = offset + tvb_reported_length_remaining(tvb, offset);
+        return offset;
+    }
+    contents = ber_schema_header(tvb, offset, offset + tvb_reported_length_remaining(tvb, offset),
+        &ber_class, &pc, &tag, end);
+    if (contents < 0 || !pc) {
+        return -1;
+    }
+    if (ber_class != BER_CLASS_APP && ber_class != BER_CLASS_PRI &&
+        (ber_class != BER_CLASS_UNI || tag != BER_UNI_TAG_SEQUENCE)) {
+        return -1;
+    }
+    return contents;
+}
+
+static int
+ber_schema_sequence(gboolean implicit_tag, asn1_ctx_t *actx, proto_tree *parent_tree, tvbuff_t *tvb, int offset,
+    const ber_schema_t *schema, gint hf_id)
+{
+    const ber_sequence_t *seq = schema->seq;
+    proto_tree *tree = parent_tree;
+    proto_item *item = NULL;
+    int contents, end;
+    guint depth;
+
+    contents = ber_schema_outer(implicit_tag, tvb, offset, &end);
+    if (contents < 0) {
+        return dissect_ber_sequence(implicit_tag, actx, parent_tree, tvb, offset, seq, hf_id, *schema->ett);
+    }
+
+    depth = BER_PROFILE_ENTER(actx->pinfo, ber_profile_name("SEQUENCE", hf_id));
+    if (hf_id >= 0 && parent_tree) {
+        item = proto_tree_add_item(parent_tree, hf_id, tvb, offset, end - offset, ENC_BIG_ENDIAN);
+        tree = proto_item_add_subtree(item, *schema->ett);
+    }
+    if (contents == end) {
+        proto_item_append_text(item, " [0 length]");
+    }
+    offset = contents;
+    while (offset < end) {
+        gint8 ber_class;
+        gboolean pc;
+        gint32 tag;
+        int field_contents, field_end, count;
+        tvbuff_t *next_tvb;
+
+        field_contents = ber_schema_header(tvb, offset, end, &ber_class, &pc, &tag, &field_end);
+        if (field_contents < 0) {
+            break;
+        }
+        /* skip the absent OPTIONAL ones */
+        while (seq->func != NULL && seq->ber_class != BER_CLASS_ANY && seq->tag != -1 &&
+               (seq->ber_class != ber_class || seq->tag != tag) && (seq->flags & BER_FLAGS_OPTIONAL)) {
+            seq++;
+        }
+        if (seq->func == NULL || seq->ber_class != ber_class || seq->tag != tag ||
+            !ber_schema_check_explicit(tvb, field_contents, field_end, seq)) {
+            break;
+        }
+        if (seq->flags & BER_FLAGS_NOOWNTAG) {
+            next_tvb = ber_tvb_new_subset_length(tvb, offset, field_end - offset);
+        } else {
+            next_tvb = ber_tvb_new_subset_length(tvb, field_contents, field_end - field_contents);
+        }
+        count = seq->func((seq->flags & BER_FLAGS_IMPLTAG) ? TRUE : FALSE, next_tvb, 0, actx, tree, *seq->p_id);
+        /* an OPTIONAL one that took nothing: try the field with the next entry */
+        if (field_end != field_contents && count == 0 && (seq->flags & BER_FLAGS_OPTIONAL)) {
+            seq++;
+            continue;
+        }
+        offset = field_end;
+        seq++;
+    }
+    if (offset < end) {
+        ber_sequence_fields(actx, tree, item, tvb, offset, end, seq, hf_id);
+    }
+    BER_PROFILE_LEAVE(depth);
+
+    return end;
+}
+
+static int
+ber_schema_sequence_of(gboolean implicit_tag, asn1_ctx_t *actx, proto_tree *parent_tree, tvbuff_t *tvb, int offset,
+    const ber_schema_t *schema, gint hf_id)
+{
+    const ber_sequence_t *element = schema->seq;
+    proto_tree *tree = parent_tree;
+    proto_item *item = NULL;
+    int hoffset = offset;
+    int contents, end, element_end;
+    int ret;
+    guint cnt = 0;
+    guint depth;
+    gint8 ber_class;
+    gboolean pc;
+    gint32 tag;
+
+    contents = ber_schema_outer(implicit_tag, tvb, offset, &end);
+    if (contents < 0 || !(element->flags & BER_FLAGS_NOOWNTAG) ||
+        element->ber_class == BER_CLASS_ANY || element->tag == -1) {
+        return dissect_ber_sequence_of(implicit_tag, actx, parent_tree, tvb, offset, element, hf_id, *schema->ett);
+    }
+    if (hf_id >= 0 && parent_tree && proto_registrar_get_nth(hf_id)->type != FT_NONE) {
+        for (offset = contents; offset < end; offset = element_end, cnt++) {
+            if (ber_schema_header(tvb, offset, end, &ber_class, &pc, &tag, &element_end) < 0) {
+                return dissect_ber_sequence_of(implicit_tag, actx, parent_tree, tvb, hoffset, element, hf_id, *schema->ett);
+            }
+        }
+        item = proto_tree_add_uint(parent_tree, hf_id, tvb, contents, end - contents, cnt);
+        proto_item_append_text(item, (cnt == 1) ? " item" : " items");
+    } else if (hf_id >= 0 && parent_tree) {
+        item = proto_tree_add_item(parent_tree, hf_id, tvb, contents, end - contents, ENC_BIG_ENDIAN);
+        proto_item_append_text(item, ":");
+    }
+
+    depth = BER_PROFILE_ENTER(actx->pinfo, ber_profile_name("SEQUENCE_OF", hf_id));
+    if (item != NULL) {
+        tree = proto_item_add_subtree(item, *schema->ett);
+    }
+    ret = end;
+    for (offset = contents; offset < end; offset = element_end) {
+        if (ber_schema_header(tvb, offset, end, &ber_class, &pc, &tag, &element_end) < 0 ||
+            ber_class != element->ber_class || tag != element->tag) {
+            ret = ber_sq_of_items(BER_UNI_TAG_SEQUENCE, actx, tree, tvb, offset, end, element);
+            break;
+        }
+        element->func(FALSE, ber_tvb_new_subset_length(tvb, offset, element_end - offset), 0,
+            actx, tree, *element->p_id);
+    }
+    BER_PROFILE_LEAVE(depth);
+
+    return ret;
+}
+
+void
+ber_schema_register(const ber_schema_hf_t *fields, guint num_fields)
+{
+    guint i;
+
+    if (!ber_schema_fields) {
+        ber_schema_fields = g_ptr_array_new();
+    }
+    for (i = 0; i < num_fields; i++) {
+        int hf_id = *fields[i].p_id;
+
+        DISSECTOR_ASSERT(hf_id > 0);
+        if ((guint)hf_id >= ber_schema_fields->len) {
+            g_ptr_array_set_size(ber_schema_fields, hf_id + 1);
+        }
+        /* one hf, one type */
+        DISSECTOR_ASSERT(g_ptr_array_index(ber_schema_fields, hf_id) == NULL ||
+            g_ptr_array_index(ber_schema_fields, hf_id) == fields[i].schema);
+        g_ptr_array_index(ber_schema_fields, hf_id) = (gpointer)fields[i].schema;
+    }
+}
+
+int
+dissect_ber_schema_field(gboolean implicit_tag, tvbuff_t *tvb, int offset, asn1_ctx_t *actx, proto_tree *tree, int hf_id)
+{
+    const ber_schema_t *schema;
+
+    DISSECTOR_ASSERT(ber_schema_fields && hf_id > 0 && (guint)hf_id < ber_schema_fields->len);
+    schema = (const ber_schema_t *)g_ptr_array_index(ber_schema_fields, hf_id);
+    DISSECTOR_ASSERT(schema != NULL);
+
+    return dissect_ber_schema(implicit_tag, actx, tree, tvb, offset, schema, hf_id);
+}
+
+int
+dissect_ber_schema(gboolean implicit_tag, asn1_ctx_t *actx, proto_tree *tree, tvbuff_t *tvb, int offset,
+    const ber_schema_t *schema, gint hf_id)
+{
+    if (schema->kind == BER_SCHEMA_SEQUENCE_OF) {
+        if (!ber_schema_enabled || show_internal_ber_fields) {
+            return dissect_ber_sequence_of(implicit_tag, actx, tree, tvb, offset, schema->seq, hf_id, *schema->ett);
+        }
+        return ber_schema_sequence_of(implicit_tag, actx, tree, tvb, offset, schema, hf_id);
+    }
+    if (!ber_schema_enabled || show_internal_ber_fields) {
+        return dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset, schema->seq, hf_id, *schema->ett);
+    }
+    return ber_schema_sequence(implicit_tag, actx, tree, tvb, offset, schema, hf_id);
+}
+
 int
 dissect_ber_GeneralizedTime(gboolean implicit_tag, asn1_ctx_t *actx, proto_tree *tree, tvbuff_t *tvb, int offset, gint hf_id)
 {
@@ -4361,10 +5145,22 @@ oid_has_dissector(const char *oid) {
     return(dissector_get_string_handle(ber_oid_dissector_table, oid) != NULL);
 }
 
+static void
+ber_init(void)
+{
+    octet_segment_count = 0;
+    octet_segment_bytes = 0;
+}
+
 static void
 ber_shutdown(void)
 {
+    ber_profile_report();
     g_hash_table_destroy(syntax_table);
+    if (ber_mem_accounts) {
+        g_array_free(ber_mem_accounts, TRUE);
+        ber_mem_accounts = NULL;
+    }
 }
 
 void
@@ -4654,6 +5450,23 @@ proto_register_ber(void)
                                    "Whether the dissector should warn if excessive leading zero (0) bits",
                                    &decode_warning_leading_zero_bits);
 
+    prefs_register_bool_preference(ber_module, "profile",
+                                   "Profile ASN.1 dissection",
+                                   "Whether to record time and call counts per ASN.1 type and field,"
+                                   " reported on stderr when the program exits", &ber_profile_enabled);
+    prefs_register_filename_preference(ber_module, "profile_file",
+                                   "Profile folded stacks file",
+                                   "File the profile is also written to as folded stacks"
+                                   " (input for flamegraph.pl)", &ber_profile_filename, TRUE);
+    prefs_register_bool_preference(ber_module, "schema",
+                                   "Table-driven dissection",
+                                   "Whether types converted to schemas are walked in one pass by the"
+                                   " table interpreter; off runs the same tables through the generic"
+                                   " SEQUENCE and SEQUENCE OF code. Off by default until the two are"
+                                   " shown to build the same trees; tools/ber-schema-bench.sh times"
+                                   " both and compares their output on a set of captures.",
+                                   &ber_schema_enabled);
+
     prefs_register_uat_preference(ber_module, "oid_table", "Object Identifiers",
                                   "A table that provides names for object identifiers"
                                   " and the syntax of any associated values",
@@ -4667,7 +5480,9 @@ proto_register_ber(void)
 
     reassembly_table_register(&octet_segment_reassembly_table,
                           &addresses_reassembly_table_functions);
+    ber_mem_register("ber.octet_segments", octet_segment_mem_usage);
 
+    register_init_routine(ber_init);
     register_shutdown_routine(ber_shutdown);
 
     register_decode_as(&ber_da);
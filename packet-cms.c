@@ -23,9 +23,17 @@
 #include <epan/packet.h>
 #include <epan/oids.h>
 #include <epan/asn1.h>
+#include <epan/prefs.h>
+#include <epan/to_str.h>
 #include <wsutil/wsgcrypt.h>
+#include <wsutil/file_util.h>
+#ifdef HAVE_LIBGNUTLS
+#include <wsutil/rsa.h>
+#endif
 
 #include "packet-ber.h"
+#include "packet-ber-profile.h"
+#include "packet-ber-try.h"
 #include "packet-cms.h"
 #include "packet-x509af.h"
 #include "packet-x509ce.h"
@@ -317,6 +325,8 @@ static tvbuff_t *content_tvb = NULL;
 static proto_tree *top_tree=NULL;
 static proto_tree *cap_tree=NULL;
 
+static gint ett_cms_decrypted_content = -1;
+
 #define HASH_SHA1 "1.3.14.3.2.26"
 
 #define HASH_MD5 "1.2.840.113549.2.5"
@@ -366,6 +376,473 @@ cms_verify_msg_digest(proto_item *pi, tvbuff_t *content, const char *alg, tvbuff
 
 }
 
+/* Bulk certificate extraction.
+ * Every certificate seen in a CertificateSet (this includes the KDC
+ * certificate carried in a PKINIT reply) is hashed and written out once,
+ * either as <sha256>.der in a directory or appended to a PEM bundle with
+ * a tab separated index next to it. The certificates an existing index
+ * lists are not appended again.
+ */
+#define CMS_CERT_EXPORT_OFF     0
+#define CMS_CERT_EXPORT_DIR     1
+#define CMS_CERT_EXPORT_BUNDLE  2
+
+static const enum_val_t cms_cert_export_vals[] = {
+  { "off", "Off", CMS_CERT_EXPORT_OFF },
+  { "directory", "Content-addressed directory (<sha256>.der)", CMS_CERT_EXPORT_DIR },
+  { "bundle", "PEM bundle with index (certs.pem, certs.idx)", CMS_CERT_EXPORT_BUNDLE },
+  { NULL, NULL, 0 }
+};
+
+static gint cms_cert_export_mode = CMS_CERT_EXPORT_OFF;
+static const char *cms_cert_export_dir = NULL;
+
+/* sha256 hex digest -> frame the certificate was first seen in */
+static wmem_map_t *cms_exported_certs = NULL;
+static FILE *cms_cert_bundle = NULL;
+static FILE *cms_cert_index = NULL;
+/* the bundle could not be opened; export stays off until the file is closed */
+static gboolean cms_cert_export_failed = FALSE;
+
+static void
+cms_mem_exported_certs(guint *count, guint64 *bytes)
+{
+  *count = wmem_map_size(cms_exported_certs);
+  *bytes = (guint64)*count * (BER_MEM_MAP_ENTRY + HASH_SHA2_256_LENGTH * 2 + 1);
+}
+
+static void
+cms_exported_cert_add(const char *hex, guint32 frame)
+{
+  if (!wmem_map_contains(cms_exported_certs, hex))
+    wmem_map_insert(cms_exported_certs, wmem_strdup(wmem_epan_scope(), hex), GUINT_TO_POINTER(frame));
+}
+
+/* certificates an earlier run already appended to the bundle */
+static void
+cms_cert_index_load(const char *path)
+{
+  FILE *fp;
+  char line[256];
+  char *tab;
+
+  fp = ws_fopen(path, "r");
+  if (!fp)
+    return;
+  while (fgets(line, sizeof line, fp)) {
+    tab = strchr(line, '\t');
+    if (!tab || tab - line != HASH_SHA2_256_LENGTH * 2)
+      continue;
+    *tab = '\0';
+    cms_exported_cert_add(line, 0);
+  }
+  fclose(fp);
+}
+
+static gboolean
+cms_cert_bundle_open(void)
+{
+  char *path;
+
+  if (cms_cert_bundle && cms_cert_index)
+    return TRUE;
+
+  path = g_build_filename(cms_cert_export_dir, "certs.pem", NULL);
+  cms_cert_bundle = ws_fopen(path, "ab");
+  g_free(path);
+  path = g_build_filename(cms_cert_export_dir, "certs.idx", NULL);
+  cms_cert_index_load(path);
+  cms_cert_index = ws_fopen(path, "ab");
+  g_free(path);
+
+  if (!cms_cert_bundle || !cms_cert_index) {
+    fprintf(stderr, "CMS ERROR: unable to open certificate bundle in %s\n", cms_cert_export_dir);
+    if (cms_cert_bundle) {
+      fclose(cms_cert_bundle);
+      cms_cert_bundle = NULL;
+    }
+    if (cms_cert_index) {
+      fclose(cms_cert_index);
+      cms_cert_index = NULL;
+    }
+    cms_cert_export_failed = TRUE;
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static void
+cms_export_certificate(packet_info *pinfo, tvbuff_t *tvb, int offset, int length)
+{
+  guint8 digest[HASH_SHA2_256_LENGTH];
+  const guint8 *der;
+  char *hex, *path, *b64;
+  const char *origin;
+  FILE *fp;
+  long bundle_offset;
+  size_t i, b64_len;
+  gboolean written;
+
+  if (cms_cert_export_mode == CMS_CERT_EXPORT_OFF || cms_cert_export_failed || !cms_cert_export_dir || !*cms_cert_export_dir)
+    return;
+  if (PINFO_FD_VISITED(pinfo) || length <= 0 || !tvb_bytes_exist(tvb, offset, length))
+    return;
+
+  der = tvb_get_ptr(tvb, offset, length);
+  gcry_md_hash_buffer(GCRY_MD_SHA256, digest, der, length);
+  hex = bytes_to_str(wmem_packet_scope(), digest, HASH_SHA2_256_LENGTH);
+
+  if (wmem_map_contains(cms_exported_certs, hex))
+    return;
+
+  origin = proto_is_frame_protocol(pinfo->layers, "kerberos") ? "pkinit" : "cms";
+
+  if (cms_cert_export_mode == CMS_CERT_EXPORT_DIR) {
+    char *name = g_strdup_printf("%s.der", hex);
+    path = g_build_filename(cms_cert_export_dir, name, NULL);
+    g_free(name);
+    /* content addressed: a file with this name already holds these bytes */
+    if (g_file_test(path, G_FILE_TEST_EXISTS)) {
+      cms_exported_cert_add(hex, pinfo->num);
+    } else {
+      fp = ws_fopen(path, "wb");
+      written = fp && fwrite(der, 1, length, fp) == (size_t)length;
+      if (fp && fclose(fp) != 0)
+        written = FALSE;
+      if (written)
+        cms_exported_cert_add(hex, pinfo->num);
+      else
+        fprintf(stderr, "CMS ERROR: unable to write certificate %s\n", path);
+    }
+    g_free(path);
+    return;
+  }
+
+  if (!cms_cert_bundle_open())
+    return;
+  /* a certificate an earlier run indexed */
+  if (wmem_map_contains(cms_exported_certs, hex))
+    return;
+
+  bundle_offset = ftell(cms_cert_bundle);
+  b64 = g_base64_encode(der, length);
+  b64_len = strlen(b64);
+  fputs("-----BEGIN CERTIFICATE-----\n", cms_cert_bundle);
+  for (i = 0; i < b64_len; i += 64)
+    fprintf(cms_cert_bundle, "%.64s\n", b64 + i);
+  fputs("-----END CERTIFICATE-----\n", cms_cert_bundle);
+  g_free(b64);
+
+  fprintf(cms_cert_index, "%s\t%u\t%s\t%ld\t%d\n", hex, pinfo->num, origin, bundle_offset, length);
+
+  if (ferror(cms_cert_bundle) || ferror(cms_cert_index)) {
+    fprintf(stderr, "CMS ERROR: unable to write certificate %s to the bundle in %s\n", hex, cms_cert_export_dir);
+    return;
+  }
+  cms_exported_cert_add(hex, pinfo->num);
+}
+
+static void
+cms_cert_export_cleanup(void)
+{
+  if (cms_cert_bundle) {
+    fclose(cms_cert_bundle);
+    cms_cert_bundle = NULL;
+  }
+  if (cms_cert_index) {
+    fclose(cms_cert_index);
+    cms_cert_index = NULL;
+  }
+  cms_cert_export_failed = FALSE;
+}
+
+static int
+dissect_cms_Certificate_export(gboolean implicit_tag, tvbuff_t *tvb, int offset, asn1_ctx_t *actx, proto_tree *tree, int hf_index)
+{
+  int start_offset = offset;
+
+  offset = dissect_x509af_Certificate(implicit_tag, tvb, offset, actx, tree, hf_index);
+
+  if (cms_cert_export_mode != CMS_CERT_EXPORT_OFF && offset > start_offset)
+    cms_export_certificate(actx->pinfo, tvb, start_offset, offset - start_offset);
+
+  return offset;
+}
+
+#ifdef HAVE_LIBGNUTLS
+/* Key transport decryption.
+ * Given a directory of PEM private keys (a lab setup where the PKINIT
+ * client keys are at hand), the content-encryption key of a
+ * KeyTransRecipientInfo is unwrapped and the EnvelopedData content is
+ * decrypted and dissected; for an RSA PKINIT reply that content carries the
+ * ReplyKeyPack. Each key is turned into a gcrypt S-expression once, CRT
+ * parameters included, when the directory is read. Unwrap results, failures
+ * included, are cached by the SHA-256 of the whole KeyTransRecipientInfo
+ * (recipient identifier and encryptedKey), so replayed exchanges and later
+ * passes cost no RSA operation.
+ */
+#define CMS_UNWRAP_CACHE_MAX  4096
+#define CMS_CONTENT_KEY_MAX   32
+
+typedef struct {
+  guint len;    /* 0: none of the keys unwraps it */
+  guint8 key[CMS_CONTENT_KEY_MAX];
+} cms_unwrapped_key_t;
+
+static const char *cms_private_key_dir = NULL;
+static char *cms_loaded_key_dir = NULL;
+static GPtrArray *cms_private_keys = NULL;    /* gcry_sexp_t */
+
+/* sha256 hex digest of a KeyTransRecipientInfo -> cms_unwrapped_key_t */
+static GHashTable *cms_unwrapped_keys = NULL;
+
+/* State of the EnvelopedData being dissected */
+static tvbuff_t *cms_encrypted_key = NULL;
+static guint8 cms_content_key[CMS_CONTENT_KEY_MAX];
+static guint cms_content_key_len = 0;
+static const char *cms_content_type = NULL;
+static const char *cms_content_alg = NULL;
+static tvbuff_t *cms_content_iv = NULL;
+
+static void
+cms_mem_unwrapped_keys(guint *count, guint64 *bytes)
+{
+  *count = g_hash_table_size(cms_unwrapped_keys);
+  *bytes = (guint64)*count * (BER_MEM_MAP_ENTRY + HASH_SHA2_256_LENGTH * 2 + 1 + sizeof(cms_unwrapped_key_t));
+}
+
+static void
+cms_envelope_reset(void)
+{
+  cms_encrypted_key = NULL;
+  cms_content_key_len = 0;
+  cms_content_type = NULL;
+  cms_content_alg = NULL;
+  cms_content_iv = NULL;
+}
+
+static void
+cms_private_keys_free(void)
+{
+  if (cms_private_keys) {
+    g_ptr_array_free(cms_private_keys, TRUE);
+    cms_private_keys = NULL;
+  }
+  g_free(cms_loaded_key_dir);
+  cms_loaded_key_dir = NULL;
+}
+
+/* The keys of the configured directory, read again when the preference
+ * changes. Files that do not hold a PEM RSA private key are skipped.
+ */
+static GPtrArray *
+cms_get_private_keys(void)
+{
+  GDir *dir;
+  const char *name;
+
+  if (!cms_private_key_dir || !*cms_private_key_dir)
+    return NULL;
+  if (cms_private_keys && g_strcmp0(cms_loaded_key_dir, cms_private_key_dir) == 0)
+    return cms_private_keys;
+
+  cms_private_keys_free();
+  g_hash_table_remove_all(cms_unwrapped_keys);
+  cms_loaded_key_dir = g_strdup(cms_private_key_dir);
+  cms_private_keys = g_ptr_array_new_with_free_func((GDestroyNotify)gcry_sexp_release);
+
+  dir = g_dir_open(cms_private_key_dir, 0, NULL);
+  if (!dir) {
+    fprintf(stderr, "CMS ERROR: unable to open private key directory %s\n", cms_private_key_dir);
+    return cms_private_keys;
+  }
+  while ((name = g_dir_read_name(dir)) != NULL) {
+    char *path, *err = NULL;
+    gnutls_x509_privkey_t priv_key;
+    gcry_sexp_t sexp;
+    FILE *fp;
+
+    if (!g_str_has_suffix(name, ".pem") && !g_str_has_suffix(name, ".key"))
+      continue;
+    path = g_build_filename(cms_private_key_dir, name, NULL);
+    fp = ws_fopen(path, "rb");
+    if (fp) {
+      priv_key = rsa_load_pem_key(fp, &err);
+      fclose(fp);
+      if (priv_key) {
+        sexp = rsa_privkey_to_sexp(priv_key, &err);
+        gnutls_x509_privkey_deinit(priv_key);
+        if (sexp)
+          g_ptr_array_add(cms_private_keys, sexp);
+      }
+      if (err) {
+        fprintf(stderr, "CMS: skipping %s: %s\n", path, err);
+        g_free(err);
+      }
+    }
+    g_free(path);
+  }
+  g_dir_close(dir);
+
+  return cms_private_keys;
+}
+
+/* Called with the KeyTransRecipientInfo TLV once its encryptedKey is known */
+static void
+cms_unwrap_content_key(tvbuff_t *tvb, int offset, int length)
+{
+  guint8 digest[HASH_SHA2_256_LENGTH];
+  cms_unwrapped_key_t *entry;
+  GPtrArray *keys;
+  char *hex;
+  guint i, len;
+
+  if (!cms_encrypted_key || cms_content_key_len || length <= 0 || !tvb_bytes_exist(tvb, offset, length))
+    return;
+  keys = cms_get_private_keys();
+  if (!keys || keys->len == 0)
+    return;
+
+  gcry_md_hash_buffer(GCRY_MD_SHA256, digest, tvb_get_ptr(tvb, offset, length), length);
+  hex = bytes_to_str(wmem_packet_scope(), digest, HASH_SHA2_256_LENGTH);
+
+  entry = (cms_unwrapped_key_t *)g_hash_table_lookup(cms_unwrapped_keys, hex);
+  if (!entry) {
+    entry = g_new0(cms_unwrapped_key_t, 1);
+    len = tvb_captured_length(cms_encrypted_key);
+    for (i = 0; i < keys->len && len > 0; i++) {
+      guint8 *buf = (guint8 *)tvb_memdup(wmem_packet_scope(), cms_encrypted_key, 0, len);
+      char *err = NULL;
+      size_t ret;
+
+      ret = rsa_decrypt_inplace(len, buf, (gcry_sexp_t)g_ptr_array_index(keys, i), TRUE, &err);
+      g_free(err);
+      if (ret > 0 && ret <= CMS_CONTENT_KEY_MAX) {
+        entry->len = (guint)ret;
+        memcpy(entry->key, buf, ret);
+        break;
+      }
+    }
+    if (g_hash_table_size(cms_unwrapped_keys) >= CMS_UNWRAP_CACHE_MAX)
+      g_hash_table_remove_all(cms_unwrapped_keys);
+    g_hash_table_insert(cms_unwrapped_keys, g_strdup(hex), entry);
+  }
+
+  if (entry->len) {
+    memcpy(cms_content_key, entry->key, entry->len);
+    cms_content_key_len = entry->len;
+  }
+}
+
+/* Pick the cipher OID and the IV out of a ContentEncryptionAlgorithmIdentifier */
+static void
+cms_note_content_algorithm(tvbuff_t *tvb, int offset)
+{
+  gint8 ber_class;
+  gboolean pc;
+  gint32 tag;
+  guint32 len;
+  int end;
+
+  offset = try_get_ber_tl(tvb, offset, &ber_class, &pc, &tag, &len);
+  if (offset < 0 || ber_class != BER_CLASS_UNI || tag != BER_UNI_TAG_SEQUENCE)
+    return;
+  end = offset + len;
+
+  offset = try_get_ber_tl(tvb, offset, &ber_class, &pc, &tag, &len);
+  if (offset < 0 || ber_class != BER_CLASS_UNI || tag != BER_UNI_TAG_OID || len == 0)
+    return;
+  cms_content_alg = oid_encoded2string(wmem_packet_scope(), tvb_get_ptr(tvb, offset, len), len);
+  offset += len;
+  if (offset >= end)
+    return;
+
+  offset = try_get_ber_tl(tvb, offset, &ber_class, &pc, &tag, &len);
+  if (offset < 0 || ber_class != BER_CLASS_UNI || tag != BER_UNI_TAG_OCTETSTRING || pc)
+    return;
+  cms_content_iv = tvb_new_subset_length(tvb, offset, len);
+}
+
+static void
+cms_decrypt_content(tvbuff_t *encrypted_tvb, asn1_ctx_t *actx, proto_item *item)
+{
+  gcry_cipher_hd_t cipher;
+  const char *content_type;
+  proto_tree *subtree;
+  tvbuff_t *decrypted_tvb;
+  guint8 *buf, pad;
+  guint len, i, key_len, blk_len;
+  int algo;
+
+  if (!cms_content_key_len || !cms_content_alg || !cms_content_iv || !encrypted_tvb)
+    return;
+
+  if (strcmp(cms_content_alg, "1.2.840.113549.3.7") == 0) {
+    algo = GCRY_CIPHER_3DES;
+    key_len = 24;
+  } else if (strcmp(cms_content_alg, "2.16.840.1.101.3.4.1.2") == 0) {
+    algo = GCRY_CIPHER_AES128;
+    key_len = 16;
+  } else if (strcmp(cms_content_alg, "2.16.840.1.101.3.4.1.22") == 0) {
+    algo = GCRY_CIPHER_AES192;
+    key_len = 24;
+  } else if (strcmp(cms_content_alg, "2.16.840.1.101.3.4.1.42") == 0) {
+    algo = GCRY_CIPHER_AES256;
+    key_len = 32;
+  } else {
+    return;
+  }
+
+  blk_len = (guint)gcry_cipher_get_algo_blklen(algo);
+  len = tvb_captured_length(encrypted_tvb);
+  if (cms_content_key_len != key_len || tvb_captured_length(cms_content_iv) != blk_len ||
+      len == 0 || len % blk_len != 0)
+    return;
+
+  if (gcry_cipher_open(&cipher, algo, GCRY_CIPHER_MODE_CBC, 0))
+    return;
+  buf = (guint8 *)tvb_memdup(wmem_packet_scope(), encrypted_tvb, 0, len);
+  if (gcry_cipher_setkey(cipher, cms_content_key, key_len) ||
+      gcry_cipher_setiv(cipher, tvb_get_ptr(cms_content_iv, 0, blk_len), blk_len) ||
+      gcry_cipher_decrypt(cipher, buf, len, NULL, 0)) {
+    gcry_cipher_close(cipher);
+    return;
+  }
+  gcry_cipher_close(cipher);
+
+  /* PKCS #7 padding, which also tells a wrong key from a right one */
+  pad = buf[len - 1];
+  if (pad == 0 || pad > blk_len) {
+    proto_item_append_text(item, " [decryption failed]");
+    return;
+  }
+  for (i = len - pad; i < len; i++) {
+    if (buf[i] != pad) {
+      proto_item_append_text(item, " [decryption failed]");
+      return;
+    }
+  }
+
+  decrypted_tvb = tvb_new_child_real_data(encrypted_tvb, buf, len - pad, len - pad);
+  add_new_data_source(actx->pinfo, decrypted_tvb, "Decrypted CMS content");
+  proto_item_append_text(item, " [decrypted]");
+  subtree = proto_item_add_subtree(item, ett_cms_decrypted_content);
+
+  /* the content may well be another CMS structure */
+  content_type = cms_content_type;
+  cms_envelope_reset();
+  if (content_type)
+    call_ber_oid_callback(content_type, decrypted_tvb, 0, actx->pinfo, subtree, NULL);
+}
+
+static void
+cms_key_transport_cleanup(void)
+{
+  g_hash_table_remove_all(cms_unwrapped_keys);
+  cms_envelope_reset();
+}
+#endif /* HAVE_LIBGNUTLS */
+
 
 /*--- Included file: packet-cms-fn.c ---*/
 #line 1 "./asn1/cms/packet-cms-fn.c"
@@ -745,7 +1222,7 @@ static const value_string cms_CertificateChoices_vals[] = {
 };
 
 static const ber_choice_t CertificateChoices_choice[] = {
-  {   0, &hf_cms_certificate     , BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, BER_FLAGS_NOOWNTAG, dissect_x509af_Certificate },
+  {   0, &hf_cms_certificate     , BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, BER_FLAGS_NOOWNTAG, dissect_cms_Certificate_export },
   {   1, &hf_cms_extendedCertificate, BER_CLASS_CON, 0, BER_FLAGS_IMPLTAG, dissect_cms_ExtendedCertificate },
   {   2, &hf_cms_v1AttrCert      , BER_CLASS_CON, 1, BER_FLAGS_IMPLTAG, dissect_cms_AttributeCertificateV1 },
   {   3, &hf_cms_v2AttrCert      , BER_CLASS_CON, 2, BER_FLAGS_IMPLTAG, dissect_cms_AttributeCertificateV2 },
@@ -1030,8 +1507,14 @@ dissect_cms_KeyEncryptionAlgorithmIdentifier(gboolean implicit_tag _U_, tvbuff_t
 
 static int
 dissect_cms_EncryptedKey(gboolean implicit_tag _U_, tvbuff_t *tvb _U_, int offset _U_, asn1_ctx_t *actx _U_, proto_tree *tree _U_, int hf_index _U_) {
+  tvbuff_t *encrypted_key = NULL;
+
   offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index,
-                                       NULL);
+                                       &encrypted_key);
+
+#ifdef HAVE_LIBGNUTLS
+  cms_encrypted_key = encrypted_key;
+#endif
 
   return offset;
 }
@@ -1047,9 +1530,19 @@ static const ber_sequence_t KeyTransRecipientInfo_sequence[] = {
 
 static int
 dissect_cms_KeyTransRecipientInfo(gboolean implicit_tag _U_, tvbuff_t *tvb _U_, int offset _U_, asn1_ctx_t *actx _U_, proto_tree *tree _U_, int hf_index _U_) {
+#ifdef HAVE_LIBGNUTLS
+  int start_offset = offset;
+
+  cms_encrypted_key = NULL;
+#endif
+
   offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
                                    KeyTransRecipientInfo_sequence, hf_index, ett_cms_KeyTransRecipientInfo);
 
+#ifdef HAVE_LIBGNUTLS
+  cms_unwrap_content_key(tvb, start_offset, offset - start_offset);
+#endif
+
   return offset;
 }
 
@@ -1380,6 +1873,13 @@ dissect_cms_RecipientInfos(gboolean implicit_tag _U_, tvbuff_t *tvb _U_, int off
 
 static int
 dissect_cms_ContentEncryptionAlgorithmIdentifier(gboolean implicit_tag _U_, tvbuff_t *tvb _U_, int offset _U_, asn1_ctx_t *actx _U_, proto_tree *tree _U_, int hf_index _U_) {
+#ifdef HAVE_LIBGNUTLS
+  /* object_identifier_id still holds the encryptedContentType here */
+  cms_content_type = object_identifier_id;
+  if (!implicit_tag && cms_content_key_len)
+    cms_note_content_algorithm(tvb, offset);
+#endif
+
   offset = dissect_x509af_AlgorithmIdentifier(implicit_tag, tvb, offset, actx, tree, hf_index);
 
   return offset;
@@ -1402,6 +1902,10 @@ dissect_cms_EncryptedContent(gboolean implicit_tag _U_, tvbuff_t *tvb _U_, int o
 
 	PBE_decrypt_data(object_identifier_id, encrypted_tvb, actx->pinfo, actx, item);
 
+#ifdef HAVE_LIBGNUTLS
+	cms_decrypt_content(encrypted_tvb, actx, item);
+#endif
+
 
   return offset;
 }
@@ -1416,6 +1920,13 @@ static const ber_sequence_t EncryptedContentInfo_sequence[] = {
 
 static int
 dissect_cms_EncryptedContentInfo(gboolean implicit_tag _U_, tvbuff_t *tvb _U_, int offset _U_, asn1_ctx_t *actx _U_, proto_tree *tree _U_, int hf_index _U_) {
+#ifdef HAVE_LIBGNUTLS
+  /* only this structure's own algorithm counts: what an earlier one left
+   * behind points into a packet scope that may be gone if it threw */
+  cms_content_alg = NULL;
+  cms_content_iv = NULL;
+#endif
+
   offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
                                    EncryptedContentInfo_sequence, hf_index, ett_cms_EncryptedContentInfo);
 
@@ -1447,6 +1958,10 @@ static const ber_sequence_t EnvelopedData_sequence[] = {
 
 int
 dissect_cms_EnvelopedData(gboolean implicit_tag _U_, tvbuff_t *tvb _U_, int offset _U_, asn1_ctx_t *actx _U_, proto_tree *tree _U_, int hf_index _U_) {
+#ifdef HAVE_LIBGNUTLS
+  cms_envelope_reset();
+#endif
+
   offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
                                    EnvelopedData_sequence, hf_index, ett_cms_EnvelopedData);
 
@@ -1490,6 +2005,11 @@ static const ber_sequence_t EncryptedData_sequence[] = {
 
 static int
 dissect_cms_EncryptedData(gboolean implicit_tag _U_, tvbuff_t *tvb _U_, int offset _U_, asn1_ctx_t *actx _U_, proto_tree *tree _U_, int hf_index _U_) {
+#ifdef HAVE_LIBGNUTLS
+  /* no recipients here, so no key from an earlier EnvelopedData applies */
+  cms_envelope_reset();
+#endif
+
   offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
                                    EncryptedData_sequence, hf_index, ett_cms_EncryptedData);
 
@@ -3322,8 +3842,11 @@ void proto_register_cms(void) {
 
 /*--- End of included file: packet-cms-ettarr.c ---*/
 #line 118 "./asn1/cms/packet-cms-template.c"
+    &ett_cms_decrypted_content,
   };
 
+  module_t *cms_module;
+
   /* Register protocol */
   proto_cms = proto_register_protocol(PNAME, PSNAME, PFNAME);
 
@@ -3337,6 +3860,34 @@ void proto_register_cms(void) {
   register_ber_oid_syntax(".p7m", NULL, "ContentInfo");
   register_ber_oid_syntax(".p7c", NULL, "ContentInfo");
 
+  cms_module = prefs_register_protocol(proto_cms, NULL);
+  prefs_register_enum_preference(cms_module, "cert_export_mode",
+    "Certificate extraction",
+    "Write every distinct certificate found in a CertificateSet (including the KDC"
+    " certificate of a PKINIT reply) once, keyed by its SHA-256 digest.",
+    &cms_cert_export_mode, cms_cert_export_vals, FALSE);
+  prefs_register_directory_preference(cms_module, "cert_export_dir",
+    "Certificate extraction directory",
+    "Directory the extracted certificates, or the certs.pem bundle and its certs.idx index, are written to.",
+    &cms_cert_export_dir);
+
+  cms_exported_certs = wmem_map_new(wmem_epan_scope(), g_str_hash, g_str_equal);
+  ber_mem_register("cms.exported_certs", cms_mem_exported_certs);
+  register_cleanup_routine(cms_cert_export_cleanup);
+
+#ifdef HAVE_LIBGNUTLS
+  prefs_register_directory_preference(cms_module, "private_key_dir",
+    "Key transport private keys",
+    "Directory of PEM RSA private keys (*.pem, *.key) used to unwrap the content-encryption key"
+    " of a KeyTransRecipientInfo, such as the encKeyPack of an RSA PKINIT reply, and decrypt the"
+    " enveloped content.",
+    &cms_private_key_dir);
+
+  cms_unwrapped_keys = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  ber_mem_register("cms.unwrapped_keys", cms_mem_unwrapped_keys);
+  register_cleanup_routine(cms_key_transport_cleanup);
+#endif
+
 
 }
 
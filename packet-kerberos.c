@@ -51,6 +51,7 @@
 #include <config.h>
 
 #include <stdio.h>
+#include <fcntl.h>
 
   // krb5.h needs to be included before the defines in packet-kerberos.h
 #if defined(HAVE_HEIMDAL_KERBEROS) || defined(HAVE_MIT_KERBEROS)
@@ -67,15 +68,23 @@
 #include <epan/conversation.h>
 #include <epan/asn1.h>
 #include <epan/expert.h>
+#include <epan/exported_pdu.h>
 #include <epan/prefs.h>
+#include <epan/stats_tree.h>
+#include <epan/tap.h>
+#include <epan/to_str.h>
 #include <wsutil/wsgcrypt.h>
 #include <wsutil/file_util.h>
 #include <wsutil/str_util.h>
 #include <wsutil/pint.h>
+#include <wsutil/ws_mempbrk.h>
 #include "packet-kerberos.h"
 #include "packet-netbios.h"
 #include "packet-tcp.h"
 #include "packet-ber.h"
+#include "packet-ber-profile.h"
+#include "packet-ber-try.h"
+#include "packet-ber-schema.h"
 #include "packet-pkinit.h"
 #include "packet-cms.h"
 #include "packet-windows-common.h"
@@ -114,9 +123,55 @@ typedef void (*kerberos_key_save_fn)(tvbuff_t* tvb _U_, int offset _U_, int leng
     int parent_hf_index _U_,
     int hf_index _U_);
 
+/* Columns of the exchange log (kerberos.exchange_log) */
+enum {
+    KRB_LOG_TIME,
+    KRB_LOG_REQUEST_FRAME,
+    KRB_LOG_REPLY_FRAME,
+    KRB_LOG_REQUEST_TYPE,
+    KRB_LOG_REPLY_TYPE,
+    KRB_LOG_ETYPE,
+    KRB_LOG_KDC_OPTIONS,
+    KRB_LOG_TICKET_FLAGS,
+    KRB_LOG_ERROR_CODE,
+    KRB_LOG_INT_COLS
+};
+
+enum {
+    KRB_LOG_CLIENT,
+    KRB_LOG_SERVER,
+    KRB_LOG_REALM,
+    KRB_LOG_ETYPES,
+    KRB_LOG_PA_TYPES,
+    KRB_LOG_PKINIT_CERT,
+    KRB_LOG_PAC_HASH,
+    KRB_LOG_STR_COLS
+};
+
+/* What one message contributes to the log row of its exchange */
+typedef struct {
+    wmem_strbuf_t* client;
+    wmem_strbuf_t* server;
+    gboolean client_done;
+    gboolean server_done;
+    gboolean in_req_body;   /* inside KDC-REQ-BODY, outside its tickets */
+    wmem_strbuf_t* etypes;
+    wmem_strbuf_t* pa_types;
+    guint32 etype_used;
+    guint32 kdc_options;
+    guint32 ticket_flags;
+    const char* pac_hash;
+} kerberos_log_msg_t;
+
 typedef struct {
     guint32 msg_type;
     gboolean is_win2k_pkinit;
+    kerberos_pkinit_layout_t pkinit_layout;
+    kerberos_pkinit_layout_t pkinit_layout_hint;
+    tvbuff_t* kdc_msg_tvb;      /* the KDC-REQ/KDC-REP, to read its realm ahead of the padata */
+    int kdc_msg_offset;
+    gboolean kdc_msg_implicit;
+    const char* realm;
     guint32 errorcode;
     gboolean try_nt_status;
     guint32 etype;
@@ -128,12 +183,16 @@ typedef struct {
     proto_item* key_hidden_item;
     tvbuff_t* key_tvb;
     kerberos_callbacks* callbacks;
+    kerberos_log_msg_t* log;
     guint32 ad_type;
     guint32 addr_type;
     guint32 checksum_type;
+    gboolean saw_pac;
 #ifdef HAVE_KERBEROS
     enc_key_t* last_decryption_key;
     enc_key_t* last_added_key;
+    gboolean missing_key_retried;
+    int last_decryption_usage;
 #endif
     gint save_encryption_key_parent_hf_index;
     kerberos_key_save_fn save_encryption_key_fn;
@@ -245,6 +304,22 @@ static gint hf_krb_pac_client_info_type = -1;
 static gint hf_krb_pac_client_claims_info = -1;
 static gint hf_krb_pac_device_info = -1;
 static gint hf_krb_pac_device_claims_info = -1;
+static gint hf_krb_pac_claims_set_size = -1;
+static gint hf_krb_pac_claims_compression = -1;
+static gint hf_krb_pac_claims_uncompressed_size = -1;
+static gint hf_krb_pac_claims_reserved_type = -1;
+static gint hf_krb_pac_claims_reserved_size = -1;
+static gint hf_krb_pac_claims_set = -1;
+static gint hf_krb_pac_claims_array_count = -1;
+static gint hf_krb_pac_claims_source_type = -1;
+static gint hf_krb_pac_claims_count = -1;
+static gint hf_krb_pac_claim_id = -1;
+static gint hf_krb_pac_claim_type = -1;
+static gint hf_krb_pac_claim_value_count = -1;
+static gint hf_krb_pac_claim_int64 = -1;
+static gint hf_krb_pac_claim_uint64 = -1;
+static gint hf_krb_pac_claim_string = -1;
+static gint hf_krb_pac_claim_boolean = -1;
 static gint hf_krb_pa_supported_enctypes = -1;
 static gint hf_krb_pa_supported_enctypes_des_cbc_crc = -1;
 static gint hf_krb_pa_supported_enctypes_des_cbc_md5 = -1;
@@ -259,7 +334,11 @@ static gint hf_krb_ad_ap_options = -1;
 static gint hf_krb_ad_ap_options_cbt = -1;
 static gint hf_krb_ad_target_principal = -1;
 static gint hf_krb_key_hidden_item = -1;
+static gint hf_krb_pkinit_layout = -1;
 #ifdef HAVE_KERBEROS
+static gint hf_krb_decrypted_usage = -1;
+static gint hf_krb_decrypted_origin_frame = -1;
+static gint hf_krb_decrypted_key_id = -1;
 static gint hf_kerberos_KrbFastResponse = -1;
 static gint hf_kerberos_strengthen_key = -1;
 static gint hf_kerberos_finished = -1;
@@ -501,8 +580,6 @@ static int hf_kerberos_PAC_OPTIONS_FLAGS_claims = -1;
 static int hf_kerberos_PAC_OPTIONS_FLAGS_branch_aware = -1;
 static int hf_kerberos_PAC_OPTIONS_FLAGS_forward_to_full_dc = -1;
 static int hf_kerberos_PAC_OPTIONS_FLAGS_resource_based_constrained_delegation = -1;
-
-static int isPku2u = -1;
 /*--- End of included file: packet-kerberos-hf.c ---*/
 #line 282 "./asn1/kerberos/packet-kerberos-template.c"
 
@@ -517,6 +594,11 @@ static gint ett_krb_pac_credential_info = -1;
 static gint ett_krb_pac_s4u_delegation_info = -1;
 static gint ett_krb_pac_upn_dns_info = -1;
 static gint ett_krb_pac_device_info = -1;
+static gint ett_krb_pac_client_claims_info = -1;
+static gint ett_krb_pac_device_claims_info = -1;
+static gint ett_krb_pac_claims_set = -1;
+static gint ett_krb_pac_claims_array = -1;
+static gint ett_krb_pac_claim_entry = -1;
 static gint ett_krb_pac_server_checksum = -1;
 static gint ett_krb_pac_privsvr_checksum = -1;
 static gint ett_krb_pac_client_info_type = -1;
@@ -524,6 +606,7 @@ static gint ett_krb_pa_supported_enctypes = -1;
 static gint ett_krb_ad_ap_options = -1;
 #ifdef HAVE_KERBEROS
 static gint ett_krb_pa_enc_ts_enc = -1;
+static gint ett_krb_decrypted = -1;
 static gint ett_kerberos_KrbFastFinished = -1;
 static gint ett_kerberos_KrbFastResponse = -1;
 static gint ett_kerberos_KrbFastReq = -1;
@@ -613,6 +696,11 @@ static expert_field ei_kerberos_decrypted_keytype = EI_INIT;
 static expert_field ei_kerberos_learnt_keytype = EI_INIT;
 static expert_field ei_kerberos_address = EI_INIT;
 static expert_field ei_krb_gssapi_dlglen = EI_INIT;
+static expert_field ei_krb_pac_claims_decompress = EI_INIT;
+static expert_field ei_kerberos_breaker_tripped = EI_INIT;
+static expert_field ei_kerberos_breaker_header_only = EI_INIT;
+static expert_field ei_kerberos_breaker_resumed = EI_INIT;
+static expert_field ei_kerberos_sample_header_only = EI_INIT;
 
 static dissector_handle_t krb4_handle = NULL;
 
@@ -758,18 +846,47 @@ kerberos_new_private_data(void)
 {
     kerberos_private_data_t* p;
 
+    /* the key lists are created by kerberos_key_list_append() */
     p = wmem_new0(wmem_packet_scope(), kerberos_private_data_t);
     if (p == NULL) {
         return NULL;
     }
 
-    p->decryption_keys = wmem_list_new(wmem_packet_scope());
-    p->learnt_keys = wmem_list_new(wmem_packet_scope());
-    p->missing_keys = wmem_list_new(wmem_packet_scope());
+    return p;
+}
+
+/*
+ * Private data for dissect_kerberos_gss_token(). A DCE/RPC bind with
+ * Kerberos auth carries a token in nearly every frame, so instead of
+ * allocating, each nesting level takes a slot here and clears it.
+ * Deeper nesting falls back to kerberos_new_private_data().
+ */
+#define KERBEROS_GSS_PRIVATE_POOL 4
+static kerberos_private_data_t kerberos_gss_private_pool[KERBEROS_GSS_PRIVATE_POOL];
+static guint kerberos_gss_private_used = 0;
+
+static kerberos_private_data_t*
+kerberos_gss_private_data_get(void)
+{
+    kerberos_private_data_t* p;
 
+    if (kerberos_gss_private_used == KERBEROS_GSS_PRIVATE_POOL) {
+        return kerberos_new_private_data();
+    }
+    p = &kerberos_gss_private_pool[kerberos_gss_private_used++];
+    memset(p, 0, sizeof(*p));
     return p;
 }
 
+static void
+kerberos_gss_private_data_release(kerberos_private_data_t* p)
+{
+    if (kerberos_gss_private_used > 0 &&
+        p == &kerberos_gss_private_pool[kerberos_gss_private_used - 1]) {
+        kerberos_gss_private_used--;
+    }
+}
+
 static kerberos_private_data_t*
 kerberos_get_private_data(asn1_ctx_t* actx)
 {
@@ -799,6 +916,264 @@ kerberos_is_win2k_pkinit(asn1_ctx_t* actx)
     return private_data->is_win2k_pkinit;
 }
 
+kerberos_pkinit_layout_t
+kerberos_get_pkinit_layout(asn1_ctx_t* actx)
+{
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+
+    return private_data->pkinit_layout;
+}
+
+static const value_string krb_pkinit_layout_vals[] = {
+    { KERBEROS_PKINIT_LAYOUT_UNKNOWN, "Unknown" },
+    { KERBEROS_PKINIT_LAYOUT_RFC4556, "RFC 4556" },
+    { KERBEROS_PKINIT_LAYOUT_WIN2K, "Windows 2000" },
+    { KERBEROS_PKINIT_LAYOUT_PKU2U, "PKU2U" },
+    { 0, NULL }
+};
+
+/* Last PKINIT layout seen per client address, for each realm it used.
+ * Only consulted when the PA value is too short to tell the layouts apart.
+ */
+typedef struct {
+    wmem_map_t* layouts;
+} kerberos_pkinit_client_t;
+
+static wmem_map_t* kerberos_pkinit_clients = NULL;
+
+static kerberos_pkinit_client_t*
+kerberos_pkinit_client(packet_info* pinfo, kerberos_private_data_t* private_data, gboolean create)
+{
+    kerberos_pkinit_client_t* client;
+    const address* addr;
+    char* key;
+
+    addr = kerberos_private_is_kdc_req(private_data) ? &pinfo->src : &pinfo->dst;
+    key = address_to_str(wmem_packet_scope(), addr);
+    client = (kerberos_pkinit_client_t*)wmem_map_lookup(kerberos_pkinit_clients, key);
+    if (client == NULL && create) {
+        client = wmem_new0(wmem_file_scope(), kerberos_pkinit_client_t);
+        client->layouts = wmem_map_new(wmem_file_scope(), g_str_hash, g_str_equal);
+        wmem_map_insert(kerberos_pkinit_clients, wmem_strdup(wmem_file_scope(), key), client);
+    }
+    return client;
+}
+
+static void
+kerberos_remember_pkinit_layout(packet_info* pinfo, kerberos_private_data_t* private_data)
+{
+    kerberos_pkinit_client_t* client;
+
+    if (private_data->pkinit_layout == KERBEROS_PKINIT_LAYOUT_UNKNOWN || PINFO_FD_VISITED(pinfo)) {
+        return;
+    }
+
+    client = kerberos_pkinit_client(pinfo, private_data, TRUE);
+    if (wmem_map_contains(client->layouts, private_data->realm)) {
+        /* the key already stored is kept, only the layout changes */
+        wmem_map_insert(client->layouts, private_data->realm, GUINT_TO_POINTER(private_data->pkinit_layout));
+    } else {
+        wmem_map_insert(client->layouts, wmem_strdup(wmem_file_scope(), private_data->realm),
+            GUINT_TO_POINTER(private_data->pkinit_layout));
+    }
+}
+
+/* Offset of the contents of the [tag] element between offset and end, or -1 */
+static int
+kerberos_peek_field(tvbuff_t* tvb, int offset, int end, gint32 want, int* field_end)
+{
+    gint8 ber_class;
+    gboolean pc;
+    gint32 tag;
+    guint32 len;
+    int contents;
+
+    while (offset >= 0 && offset < end) {
+        contents = try_get_ber_tl(tvb, offset, &ber_class, &pc, &tag, &len);
+        if (contents < 0 || contents > end || len > (guint32)(end - contents)) {
+            return -1;
+        }
+        if (ber_class == BER_CLASS_CON && tag == want) {
+            *field_end = contents + len;
+            return contents;
+        }
+        offset = contents + len;
+    }
+    return -1;
+}
+
+/*
+ * The realm of the KDC-REQ (req-body realm) or KDC-REP (crealm) being
+ * dissected. The padata comes first, so this reads ahead without
+ * dissecting; NULL if it is not there.
+ */
+static const char*
+kerberos_peek_msg_realm(kerberos_private_data_t* private_data)
+{
+    tvbuff_t* tvb = private_data->kdc_msg_tvb;
+    int offset = private_data->kdc_msg_offset;
+    gint8 ber_class;
+    gboolean pc;
+    gint32 tag;
+    guint32 len;
+    int end;
+
+    if (tvb == NULL) {
+        return NULL;
+    }
+    if (private_data->kdc_msg_implicit) {
+        end = offset + tvb_reported_length_remaining(tvb, offset);
+    } else {
+        offset = try_get_ber_tl(tvb, offset, &ber_class, &pc, &tag, &len);
+        if (offset < 0 || ber_class != BER_CLASS_UNI || tag != BER_UNI_TAG_SEQUENCE) {
+            return NULL;
+        }
+        end = offset + len;
+    }
+    if (kerberos_private_is_kdc_req(private_data)) {
+        offset = kerberos_peek_field(tvb, offset, end, 4, &end);
+        if (offset < 0) {
+            return NULL;
+        }
+        offset = try_get_ber_tl(tvb, offset, &ber_class, &pc, &tag, &len);
+        if (offset < 0 || ber_class != BER_CLASS_UNI || tag != BER_UNI_TAG_SEQUENCE ||
+            len > (guint32)(end - offset)) {
+            return NULL;
+        }
+        offset = kerberos_peek_field(tvb, offset, offset + len, 2, &end);
+    } else {
+        offset = kerberos_peek_field(tvb, offset, end, 3, &end);
+    }
+    if (offset < 0) {
+        return NULL;
+    }
+    offset = try_get_ber_tl(tvb, offset, &ber_class, &pc, &tag, &len);
+    if (offset < 0 || ber_class != BER_CLASS_UNI || tag != BER_UNI_TAG_GeneralString ||
+        len > (guint32)(end - offset)) {
+        return NULL;
+    }
+    return (const char*)tvb_get_string_enc(wmem_packet_scope(), tvb, offset, len, ENC_ASCII);
+}
+
+/* Step into the TLV at offset, returning the offset of its contents or -1 */
+static int
+kerberos_pkinit_enter(tvbuff_t* tvb, int offset, gint8* ber_class, gint32* tag)
+{
+    offset = try_get_ber_identifier(tvb, offset, ber_class, NULL, tag);
+    offset = try_get_ber_length(tvb, offset, NULL, NULL);
+
+    return offset;
+}
+
+/*
+ * Tell the PKINIT layouts apart from the outer tags of the PA value
+ * (offset is at the padata-value OCTET STRING):
+ *   PA-PK-AS-REQ  SEQUENCE { [0] ContentInfo | SignedData ... }
+ *   PA-PK-AS-REP  [0] SEQUENCE { [0] ContentInfo | SignedData ... } | [1] encKeyPack
+ * A ContentInfo starts with its contentType OID (RFC 4556), the bare
+ * SignedData used by PKU2U with its version INTEGER.
+ */
+static kerberos_pkinit_layout_t
+kerberos_detect_pkinit_layout(tvbuff_t* tvb, int offset, guint32 padata_type)
+{
+    kerberos_pkinit_layout_t layout = KERBEROS_PKINIT_LAYOUT_UNKNOWN;
+    gboolean step_in = TRUE;
+    gint8 ber_class;
+    gint32 tag;
+
+    if (padata_type == KERBEROS_PA_PK_AS_REP_19) {
+        return KERBEROS_PKINIT_LAYOUT_WIN2K;
+    }
+
+    offset = kerberos_pkinit_enter(tvb, offset, &ber_class, &tag);
+    if (offset >= 0 && padata_type == KERBEROS_PA_PK_AS_REP) {
+        offset = kerberos_pkinit_enter(tvb, offset, &ber_class, &tag);
+        if (offset >= 0 && ber_class == BER_CLASS_CON && tag == 1) {
+            return KERBEROS_PKINIT_LAYOUT_RFC4556;
+        }
+        step_in = (ber_class == BER_CLASS_CON && tag == 0);
+    }
+    if (offset >= 0 && step_in) {
+        offset = kerberos_pkinit_enter(tvb, offset, &ber_class, &tag);
+        offset = kerberos_pkinit_enter(tvb, offset, &ber_class, &tag);
+        if (offset >= 0 && ber_class == BER_CLASS_CON && tag == 0) {
+            offset = kerberos_pkinit_enter(tvb, offset, &ber_class, &tag);
+            if (try_get_ber_identifier(tvb, offset, &ber_class, NULL, &tag) < 0) {
+                return KERBEROS_PKINIT_LAYOUT_UNKNOWN;
+            }
+            if (ber_class == BER_CLASS_UNI && tag == BER_UNI_TAG_OID) {
+                layout = KERBEROS_PKINIT_LAYOUT_RFC4556;
+            }
+            else if (ber_class == BER_CLASS_UNI && tag == BER_UNI_TAG_INTEGER) {
+                layout = KERBEROS_PKINIT_LAYOUT_PKU2U;
+            }
+        }
+    }
+
+    return layout;
+}
+
+static void
+kerberos_resolve_pkinit_layout(asn1_ctx_t* actx, proto_tree* tree, tvbuff_t* tvb, int offset,
+    kerberos_private_data_t* private_data)
+{
+    kerberos_pkinit_client_t* client;
+    kerberos_pkinit_layout_t layout;
+    const char* realm;
+    gboolean cached = FALSE;
+    proto_item* item;
+
+    layout = kerberos_detect_pkinit_layout(tvb, offset, private_data->padata_type);
+    if (layout == KERBEROS_PKINIT_LAYOUT_UNKNOWN) {
+        client = kerberos_pkinit_client(actx->pinfo, private_data, FALSE);
+        realm = client ? kerberos_peek_msg_realm(private_data) : NULL;
+        if (realm) {
+            layout = (kerberos_pkinit_layout_t)GPOINTER_TO_UINT(wmem_map_lookup(client->layouts, realm));
+            cached = (layout != KERBEROS_PKINIT_LAYOUT_UNKNOWN);
+        }
+    }
+    if (layout == KERBEROS_PKINIT_LAYOUT_UNKNOWN) {
+        layout = private_data->pkinit_layout_hint;
+    }
+    private_data->pkinit_layout = layout;
+
+    item = proto_tree_add_uint(tree, hf_krb_pkinit_layout, tvb, offset, 0, layout);
+    proto_item_set_generated(item);
+    if (cached) {
+        proto_item_append_text(item, " (cached for this client and realm)");
+    }
+}
+
+/* Live mode: bound the state kept for long-running captures, see kerberos_live_sweep() */
+static gboolean kerberos_live_mode = FALSE;
+static guint kerberos_live_timeout = 36000;
+static guint kerberos_live_max_keys = 65536;
+/* Learnt keys left after the limit is hit, so that it is not hit again by the next key */
+#define KRB_LIVE_LOW_WATER(max) ((max) - (max) / 10)
+static void kerberos_breaker_sweep(time_t now);
+
+/* Failed messages in a row before a conversation gets header-only dissection, see dissect_kerberos_guarded() */
+static guint kerberos_breaker_threshold = 0;
+
+/* Sampled full dissection, see kerberos_sample_message() */
+#define KRB_SAMPLE_OFF       0
+#define KRB_SAMPLE_RATE      1
+#define KRB_SAMPLE_PRINCIPAL 2
+
+static const enum_val_t kerberos_sample_modes[] = {
+    { "off", "Off: dissect every message in full", KRB_SAMPLE_OFF },
+    { "rate", "One message in N", KRB_SAMPLE_RATE },
+    { "principal", "Per principal, with decaying probability", KRB_SAMPLE_PRINCIPAL },
+    { NULL, NULL, -1 }
+};
+
+static gint kerberos_sample_mode = KRB_SAMPLE_OFF;
+static guint kerberos_sample_rate = 100;
+static guint kerberos_sample_principal_first = 16;
+static gboolean kerberos_sample_errors = TRUE;
+static guint kerberos_sample_count = 0;
+static wmem_map_t* kerberos_sample_principals = NULL; /* principal -> messages seen */
+
 #ifdef HAVE_KERBEROS
 
 /* Decrypt Kerberos blobs */
@@ -829,10 +1204,54 @@ read_keytab_file_from_preferences(void)
 
     read_keytab_file(last_keytab);
 }
+
+/* Decrypted plaintexts go to the "Kerberos decrypted" Export PDUs tap.
+ * A record holds the key usage, the frame the ciphertext came from and
+ * the id of the key that opened it, then the plaintext, so the exported
+ * file dissects again (krb5_decrypted) without keys or trial decryption.
+ */
+#define KRB5_DECRYPTED_PROTO_NAME "krb5_decrypted"
+
+static int exported_pdu_tap = -1;
+
+static void
+kerberos_export_decrypted(packet_info* pinfo, kerberos_private_data_t* private_data, tvbuff_t* plain_tvb)
+{
+    exp_pdu_data_t* exp_pdu_data;
+    const char* key_id = "unknown";
+    guint key_id_len, plain_len, hdr_len;
+    guint8* buf;
+
+    if (!have_tap_listener(exported_pdu_tap)) {
+        return;
+    }
+
+    if (private_data->last_decryption_key != NULL) {
+        key_id = private_data->last_decryption_key->id_str;
+    }
+    key_id_len = (guint)MIN(strlen(key_id), G_MAXUINT8);
+    plain_len = tvb_captured_length(plain_tvb);
+    hdr_len = 4 + 4 + 1 + key_id_len;
+
+    buf = (guint8*)wmem_alloc(pinfo->pool, hdr_len + plain_len);
+    phton32(buf, (guint32)private_data->last_decryption_usage);
+    phton32(buf + 4, pinfo->num);
+    buf[8] = (guint8)key_id_len;
+    memcpy(buf + 9, key_id, key_id_len);
+    tvb_memcpy(plain_tvb, buf + hdr_len, 0, plain_len);
+
+    exp_pdu_data = export_pdu_create_common_tags(pinfo, KRB5_DECRYPTED_PROTO_NAME, EXP_PDU_TAG_PROTO_NAME);
+    exp_pdu_data->tvb_captured_length = hdr_len + plain_len;
+    exp_pdu_data->tvb_reported_length = hdr_len + plain_len;
+    exp_pdu_data->pdu_tvb = tvb_new_child_real_data(plain_tvb, buf, hdr_len + plain_len, hdr_len + plain_len);
+
+    tap_queue_packet(exported_pdu_tap, pinfo, exp_pdu_data);
+}
 #endif /* HAVE_KERBEROS */
 
 #if defined(HAVE_HEIMDAL_KERBEROS) || defined(HAVE_MIT_KERBEROS)
 enc_key_t* enc_key_list = NULL;
+static guint enc_key_list_len = 0;
 static guint kerberos_longterm_ids = 0;
 wmem_map_t* kerberos_longterm_keys = NULL;
 static wmem_map_t* kerberos_all_keys = NULL;
@@ -842,99 +1261,649 @@ static gboolean
 enc_key_list_cb(wmem_allocator_t* allocator _U_, wmem_cb_event_t event _U_, void* user_data _U_)
 {
     enc_key_list = NULL;
+    enc_key_list_len = 0;
     kerberos_longterm_ids = 0;
     /* keep the callback registered */
     return TRUE;
 }
 
-static gint enc_key_cmp_id(gconstpointer k1, gconstpointer k2)
+/* Frames whose decryption failed for want of a key, indexed by
+ * (enctype, usage, realm hint). Each frame keeps the key generation of
+ * its enctype and realm at the time it failed, so a later pass only
+ * retries the trial decryption once a key that could open it has
+ * arrived: a keytab change (any realm) or a key learnt further on in the
+ * file in the same realm, or with no realm to go by. Keys that a retried
+ * frame produces bump the generation in turn, which brings the frames
+ * depending on them along.
+ *
+ * The index is in epan scope: the redissection that a keytab change
+ * starts drops the file scope, and the index is there to spare that pass
+ * the frames nothing new can open. It belongs to the capture whose first
+ * ciphertext it was started with and is emptied when another one is read.
+ */
+static guint kerberos_key_generation = 0;
+#ifdef HAVE_MIT_KERBEROS
+static GHashTable* kerberos_keytype_generations = NULL; /* "enctype[/realm]" -> generation */
+static GHashTable* kerberos_missing_index = NULL;       /* "enctype/usage/realm" -> frame -> generation */
+static guint kerberos_missing_index_frames = 0;
+static guint8 kerberos_missing_index_capture[HASH_SHA2_256_LENGTH];
+static gboolean kerberos_missing_index_checked = FALSE;
+
+static void
+kerberos_set_keytype_generation(const char* key)
 {
-    const enc_key_t* key1 = (const enc_key_t*)k1;
-    const enc_key_t* key2 = (const enc_key_t*)k2;
+    g_hash_table_insert(kerberos_keytype_generations, g_strdup(key), GUINT_TO_POINTER(kerberos_key_generation));
+}
+#endif /* HAVE_MIT_KERBEROS */
 
-    if (key1->fd_num < key2->fd_num) {
-        return -1;
+/* realm NULL: the key may open messages of any realm */
+static void
+kerberos_bump_key_generation(int keytype, const char* realm _U_)
+{
+    kerberos_key_generation++;
+#ifdef HAVE_MIT_KERBEROS
+    {
+        char key[64];
+
+        g_snprintf(key, sizeof(key), "%d", keytype);
+        kerberos_set_keytype_generation(key);
+        if (realm == NULL) {
+            g_snprintf(key, sizeof(key), "%d/", keytype);
+            kerberos_set_keytype_generation(key);
+        } else {
+            kerberos_set_keytype_generation(wmem_strdup_printf(wmem_packet_scope(), "%d/%s", keytype, realm));
+        }
     }
-    if (key1->fd_num > key2->fd_num) {
-        return 1;
+#endif
+}
+
+#ifdef HAVE_MIT_KERBEROS
+static guint
+kerberos_keytype_generation(int keytype, const char* realm)
+{
+    char key[64];
+    guint any_realm;
+
+    if (keytype == -1) {
+        return kerberos_key_generation;
     }
+    if (realm == NULL) {
+        g_snprintf(key, sizeof(key), "%d", keytype);
+        return GPOINTER_TO_UINT(g_hash_table_lookup(kerberos_keytype_generations, key));
+    }
+    g_snprintf(key, sizeof(key), "%d/", keytype);
+    any_realm = GPOINTER_TO_UINT(g_hash_table_lookup(kerberos_keytype_generations, key));
+    return MAX(any_realm, GPOINTER_TO_UINT(g_hash_table_lookup(kerberos_keytype_generations,
+        wmem_strdup_printf(wmem_packet_scope(), "%d/%s", keytype, realm))));
+}
 
-    if (key1->id < key2->id) {
-        return -1;
+/*
+ * Called with each ciphertext until the index has been checked for this
+ * pass: the first one identifies the capture, as for the first-pass
+ * cache, and a different capture empties the index.
+ */
+static void
+kerberos_missing_index_open(packet_info* pinfo, tvbuff_t* tvb)
+{
+    gcry_md_hd_t md;
+    guint len;
+
+    if (kerberos_missing_index_checked) {
+        return;
     }
-    if (key1->id > key2->id) {
-        return 1;
+    kerberos_missing_index_checked = TRUE;
+    if (gcry_md_open(&md, GCRY_MD_SHA256, 0)) {
+        g_hash_table_remove_all(kerberos_missing_index);
+        kerberos_missing_index_frames = 0;
+        return;
+    }
+    gcry_md_write(md, &pinfo->num, sizeof(pinfo->num));
+    gcry_md_write(md, &pinfo->abs_ts.secs, sizeof(pinfo->abs_ts.secs));
+    gcry_md_write(md, &pinfo->abs_ts.nsecs, sizeof(pinfo->abs_ts.nsecs));
+    len = tvb_captured_length(tvb);
+    gcry_md_write(md, tvb_get_ptr(tvb, 0, len), len);
+    if (memcmp(kerberos_missing_index_capture, gcry_md_read(md, 0), HASH_SHA2_256_LENGTH) != 0) {
+        memcpy(kerberos_missing_index_capture, gcry_md_read(md, 0), HASH_SHA2_256_LENGTH);
+        g_hash_table_remove_all(kerberos_missing_index);
+        kerberos_missing_index_frames = 0;
     }
+    gcry_md_close(md);
+}
 
-    return 0;
+static GHashTable*
+kerberos_missing_frames(kerberos_private_data_t* private_data, int keytype, int usage, gboolean create)
+{
+    char* key;
+    GHashTable* frames;
+
+    key = wmem_strdup_printf(wmem_packet_scope(), "%d/%d/%s", keytype, usage,
+        private_data->realm ? private_data->realm : "");
+    frames = (GHashTable*)g_hash_table_lookup(kerberos_missing_index, key);
+    if (frames == NULL && create) {
+        frames = g_hash_table_new(g_direct_hash, g_direct_equal);
+        g_hash_table_insert(kerberos_missing_index, g_strdup(key), frames);
+    }
+    return frames;
 }
 
+/* TRUE if this frame missed the key for this usage and realm before and
+ * no key that could open it came since */
 static gboolean
-enc_key_content_equal(gconstpointer k1, gconstpointer k2)
+kerberos_missing_key_unchanged(packet_info* pinfo, kerberos_private_data_t* private_data,
+    int keytype, int usage)
 {
-    const enc_key_t* key1 = (const enc_key_t*)k1;
-    const enc_key_t* key2 = (const enc_key_t*)k2;
-    int cmp;
+    GHashTable* frames = kerberos_missing_frames(private_data, keytype, usage, FALSE);
+    gpointer generation;
 
-    if (key1->keytype != key2->keytype) {
+    if (frames == NULL ||
+        !g_hash_table_lookup_extended(frames, GUINT_TO_POINTER(pinfo->num), NULL, &generation)) {
         return FALSE;
     }
+    return GPOINTER_TO_UINT(generation) >= kerberos_keytype_generation(keytype, private_data->realm);
+}
 
-    if (key1->keylength != key2->keylength) {
-        return FALSE;
+static void
+kerberos_record_missing_key(packet_info* pinfo, kerberos_private_data_t* private_data,
+    int keytype, int usage)
+{
+    GHashTable* frames = kerberos_missing_frames(private_data, keytype, usage, TRUE);
+
+    if (!g_hash_table_contains(frames, GUINT_TO_POINTER(pinfo->num))) {
+        kerberos_missing_index_frames++;
     }
+    g_hash_table_insert(frames, GUINT_TO_POINTER(pinfo->num),
+        GUINT_TO_POINTER(kerberos_keytype_generation(keytype, private_data->realm)));
+}
 
-    cmp = memcmp(key1->keyvalue, key2->keyvalue, key1->keylength);
-    if (cmp != 0) {
-        return FALSE;
+static void
+kerberos_clear_missing_key(packet_info* pinfo, kerberos_private_data_t* private_data,
+    int keytype, int usage)
+{
+    GHashTable* frames = kerberos_missing_frames(private_data, keytype, usage, FALSE);
+
+    if (frames != NULL && g_hash_table_remove(frames, GUINT_TO_POINTER(pinfo->num))) {
+        kerberos_missing_index_frames--;
+        private_data->missing_key_retried = TRUE;
     }
+}
 
-    return TRUE;
+static void
+kerberos_missing_index_shutdown(void)
+{
+    g_hash_table_destroy(kerberos_missing_index);
+    g_hash_table_destroy(kerberos_keytype_generations);
+    kerberos_missing_index = NULL;
+    kerberos_keytype_generations = NULL;
 }
 
-static guint
-enc_key_content_hash(gconstpointer k)
+/*
+ * First-pass cache (kerberos.cache_dir). At file close the final
+ * decryption outcome of every (frame, key usage) is written to a sidecar
+ * file named after a fingerprint of the capture and the key sources. On
+ * reopen that file is mapped and searched in place: ciphertexts that
+ * never decrypted skip the trial decryption, the others try the key that
+ * opened them first. A record is only used if the ciphertext still hashes
+ * to what it was written for, and a "never decrypted" one only if the
+ * keys learnt up to that frame are also the same. The file names that key
+ * by a 32-bit hash, never by its bytes, and is only readable by its owner.
+ */
+#define KRB_CACHE_MAGIC "WSKRBC03"
+#define KRB_CACHE_BYTE_ORDER 0x01020304
+
+typedef struct {
+    char magic[8];
+    guint32 byte_order;
+    guint32 count;
+} kerberos_cache_header_t;
+
+/* records are sorted by frame, then usage */
+typedef struct {
+    guint32 frame;
+    gint32 usage;
+    gint32 keytype;
+    guint32 key_state;      /* kerberos_cache_key_state at the time */
+    guint32 key_id;         /* kerberos_cache_key_id() of the key that opened it */
+    guint8 decrypted;
+    guint8 pad[3];
+    guint8 cipher_hash[HASH_SHA1_LENGTH];
+} kerberos_cache_record_t;
+
+static const char* kerberos_cache_dir = "";
+static gboolean kerberos_cache_tried = FALSE;
+static gboolean kerberos_cache_dirty = FALSE;
+static char* kerberos_cache_path = NULL;
+static GMappedFile* kerberos_cache_file = NULL;
+static const kerberos_cache_record_t* kerberos_cache_records = NULL;
+static guint32 kerberos_cache_count = 0;
+static wmem_map_t* kerberos_cache_outcomes = NULL; /* frame << 32 | usage -> record */
+static guint32 kerberos_cache_key_state = 0; /* folded over the keys learnt so far */
+
+static gboolean
+kerberos_cache_enabled(void)
 {
-    const enc_key_t* key = (const enc_key_t*)k;
-    guint ret = 0;
+    return kerberos_cache_dir != NULL && *kerberos_cache_dir != '\0';
+}
 
-    ret += wmem_strong_hash((const guint8*)&key->keytype,
-        sizeof(key->keytype));
-    ret += wmem_strong_hash((const guint8*)&key->keylength,
-        sizeof(key->keylength));
-    ret += wmem_strong_hash((const guint8*)key->keyvalue,
-        key->keylength);
+/* FNV-1a over the key type and value */
+static guint32
+kerberos_cache_key_id(const enc_key_t* ek)
+{
+    const guint8* p = (const guint8*)ek->keyvalue;
+    guint32 h = 2166136261U ^ (guint32)ek->keytype;
+    int i;
 
-    return ret;
+    for (i = 0; i < MIN(ek->keylength, KRB_MAX_KEY_LENGTH); i++) {
+        h = (h ^ p[i]) * 16777619U;
+    }
+    return h;
 }
 
+/* Called for every key learnt from the capture itself */
 static void
-kerberos_key_map_insert(wmem_map_t* key_map, enc_key_t* new_key)
+kerberos_cache_learnt_key(const enc_key_t* ek)
 {
-    enc_key_t* existing = NULL;
-    enc_key_t* cur = NULL;
-    gint cmp;
+    kerberos_cache_key_state = (kerberos_cache_key_state * 31) ^ kerberos_cache_key_id(ek);
+}
 
-    existing = (enc_key_t*)wmem_map_lookup(key_map, new_key);
-    if (existing == NULL) {
-        wmem_map_insert(key_map, new_key, new_key);
-        return;
+/* Fold a file or directory name, size and modification time into md */
+static void
+kerberos_cache_fingerprint_path(gcry_md_hd_t md, const char* path)
+{
+    ws_statb64 st;
+
+    if (path == NULL) {
+        path = "";
     }
+    gcry_md_write(md, path, strlen(path) + 1);
+    if (*path != '\0' && ws_stat64(path, &st) == 0) {
+        gint64 value = (gint64)st.st_size;
+        gcry_md_write(md, &value, sizeof(value));
+        value = (gint64)st.st_mtime;
+        gcry_md_write(md, &value, sizeof(value));
+    }
+}
 
-    if (key_map != kerberos_all_keys) {
-        /*
-         * It should already be linked to the existing key...
-         */
-        return;
+/* Fold the current value of another dissector's preference into md */
+static void
+kerberos_cache_fingerprint_pref(gcry_md_hd_t md, const char* module_name, const char* pref_name, gboolean is_path)
+{
+    module_t* module = prefs_find_module(module_name);
+    pref_t* pref = module ? prefs_find_preference(module, pref_name) : NULL;
+    char* value = pref ? prefs_pref_to_str(pref, pref_current) : NULL;
+
+    if (is_path) {
+        kerberos_cache_fingerprint_path(md, value);
+    } else {
+        gcry_md_write(md, value ? value : "", value ? strlen(value) + 1 : 1);
     }
+    g_free(value);
+}
 
-    if (existing->fd_num == -1 && new_key->fd_num != -1) {
-        /*
-         * We can't reference a learnt key
-         * from a longterm key. As they have
-         * a shorter lifetime.
-         *
-         * So just let the learnt key remember the
+static void
+kerberos_cache_reset(void)
+{
+    if (kerberos_cache_file != NULL) {
+        g_mapped_file_unref(kerberos_cache_file);
+    }
+    g_free(kerberos_cache_path);
+    kerberos_cache_tried = FALSE;
+    kerberos_cache_dirty = FALSE;
+    kerberos_cache_path = NULL;
+    kerberos_cache_file = NULL;
+    kerberos_cache_records = NULL;
+    kerberos_cache_count = 0;
+    kerberos_cache_outcomes = NULL;
+    kerberos_cache_key_state = 0;
+}
+
+/*
+ * Called with the first ciphertext of the first pass. The fingerprint
+ * covers that frame (number, time and bytes) and every configured key
+ * source: the keytab and the CMS key transport directory (name, size and
+ * modification time), and the PKINIT decryption switch. Keys learnt from
+ * the capture are checked per record instead, see kerberos_cache_find().
+ */
+static void
+kerberos_cache_open(packet_info* pinfo, tvbuff_t* tvb)
+{
+    gcry_md_hd_t md;
+    const kerberos_cache_header_t* header;
+    char* name;
+    gsize size;
+    guint len;
+
+    if (kerberos_cache_tried) {
+        return;
+    }
+    kerberos_cache_tried = TRUE;
+    if (PINFO_FD_VISITED(pinfo) || !kerberos_cache_enabled()) {
+        return;
+    }
+    kerberos_cache_outcomes = wmem_map_new(wmem_file_scope(), g_int64_hash, g_int64_equal);
+
+    if (gcry_md_open(&md, GCRY_MD_SHA256, 0)) {
+        return;
+    }
+    gcry_md_write(md, &pinfo->num, sizeof(pinfo->num));
+    gcry_md_write(md, &pinfo->abs_ts.secs, sizeof(pinfo->abs_ts.secs));
+    gcry_md_write(md, &pinfo->abs_ts.nsecs, sizeof(pinfo->abs_ts.nsecs));
+    len = tvb_captured_length(tvb);
+    gcry_md_write(md, tvb_get_ptr(tvb, 0, len), len);
+    kerberos_cache_fingerprint_path(md, keytab_filename);
+    kerberos_cache_fingerprint_pref(md, "cms", "private_key_dir", TRUE);
+    gcry_md_write(md, &krb_decrypt, sizeof(krb_decrypt));
+    name = g_strdup_printf("%s.krbcache",
+        bytes_to_str(wmem_packet_scope(), gcry_md_read(md, 0), HASH_SHA2_256_LENGTH));
+    gcry_md_close(md);
+    kerberos_cache_path = g_build_filename(kerberos_cache_dir, name, NULL);
+    g_free(name);
+
+    kerberos_cache_file = g_mapped_file_new(kerberos_cache_path, FALSE, NULL);
+    if (kerberos_cache_file == NULL) {
+        kerberos_cache_dirty = TRUE;
+        return;
+    }
+    size = g_mapped_file_get_length(kerberos_cache_file);
+    header = (const kerberos_cache_header_t*)g_mapped_file_get_contents(kerberos_cache_file);
+    if (size < sizeof(*header) ||
+        memcmp(header->magic, KRB_CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->byte_order != KRB_CACHE_BYTE_ORDER ||
+        size != sizeof(*header) + (gsize)header->count * sizeof(kerberos_cache_record_t)) {
+        /* foreign or truncated; rewrite it at close */
+        g_mapped_file_unref(kerberos_cache_file);
+        kerberos_cache_file = NULL;
+        kerberos_cache_dirty = TRUE;
+        return;
+    }
+    kerberos_cache_records = (const kerberos_cache_record_t*)(header + 1);
+    kerberos_cache_count = header->count;
+}
+
+static int
+kerberos_cache_record_cmp(gconstpointer a, gconstpointer b)
+{
+    const kerberos_cache_record_t* r1 = (const kerberos_cache_record_t*)a;
+    const kerberos_cache_record_t* r2 = (const kerberos_cache_record_t*)b;
+
+    if (r1->frame != r2->frame) {
+        return (r1->frame < r2->frame) ? -1 : 1;
+    }
+    if (r1->usage != r2->usage) {
+        return (r1->usage < r2->usage) ? -1 : 1;
+    }
+    return 0;
+}
+
+static const kerberos_cache_record_t*
+kerberos_cache_lookup(guint32 frame, int usage)
+{
+    kerberos_cache_record_t key;
+
+    if (kerberos_cache_records == NULL) {
+        return NULL;
+    }
+    key.frame = frame;
+    key.usage = usage;
+    return (const kerberos_cache_record_t*)bsearch(&key, kerberos_cache_records,
+        kerberos_cache_count, sizeof(kerberos_cache_record_t), kerberos_cache_record_cmp);
+}
+
+static void
+kerberos_cache_cipher_hash(tvbuff_t* cryptotvb, guint8* digest)
+{
+    guint len;
+
+    if (kerberos_cache_outcomes == NULL) {
+        return;
+    }
+    len = tvb_captured_length(cryptotvb);
+    gcry_md_hash_buffer(GCRY_MD_SHA1, digest, tvb_get_ptr(cryptotvb, 0, len), len);
+}
+
+/*
+ * What is known about this ciphertext: from the cache file on the first
+ * pass, from the first pass itself on later ones. A file record for other
+ * bytes is ignored, and so is a "never decrypted" one written when a
+ * different set of keys had been learnt by this frame.
+ */
+static const kerberos_cache_record_t*
+kerberos_cache_find(packet_info* pinfo, int usage, const guint8* cipher_hash)
+{
+    gint64 key = ((gint64)pinfo->num << 32) | (guint32)usage;
+    const kerberos_cache_record_t* rec;
+
+    if (!PINFO_FD_VISITED(pinfo)) {
+        rec = kerberos_cache_lookup(pinfo->num, usage);
+        if (rec == NULL ||
+            memcmp(rec->cipher_hash, cipher_hash, sizeof(rec->cipher_hash)) != 0) {
+            return NULL;
+        }
+        if (!rec->decrypted && rec->key_state != kerberos_cache_key_state) {
+            return NULL;
+        }
+        return rec;
+    }
+    if (kerberos_cache_outcomes == NULL) {
+        return NULL;
+    }
+    return (const kerberos_cache_record_t*)wmem_map_lookup(kerberos_cache_outcomes, &key);
+}
+
+/* Remember the outcome of this pass; later passes overwrite earlier ones */
+static void
+kerberos_cache_note(packet_info* pinfo, int usage, const guint8* cipher_hash, const enc_key_t* ek)
+{
+    kerberos_cache_record_t* rec;
+    const kerberos_cache_record_t* cached;
+    gint64 key = ((gint64)pinfo->num << 32) | (guint32)usage;
+
+    if (kerberos_cache_outcomes == NULL) {
+        return;
+    }
+
+    rec = (kerberos_cache_record_t*)wmem_map_lookup(kerberos_cache_outcomes, &key);
+    if (rec == NULL) {
+        rec = wmem_new(wmem_file_scope(), kerberos_cache_record_t);
+        wmem_map_insert(kerberos_cache_outcomes,
+            wmem_memdup(wmem_file_scope(), &key, sizeof(key)), rec);
+    }
+    memset(rec, 0, sizeof(*rec));
+    rec->frame = pinfo->num;
+    rec->usage = usage;
+    rec->key_state = kerberos_cache_key_state;
+    memcpy(rec->cipher_hash, cipher_hash, sizeof(rec->cipher_hash));
+    if (ek != NULL) {
+        rec->decrypted = 1;
+        rec->keytype = ek->keytype;
+        rec->key_id = kerberos_cache_key_id(ek);
+    }
+
+    cached = kerberos_cache_lookup(pinfo->num, usage);
+    if (cached == NULL || memcmp(cached, rec, sizeof(*rec)) != 0) {
+        kerberos_cache_dirty = TRUE;
+    }
+}
+
+struct kerberos_cache_key_search {
+    const kerberos_cache_record_t* rec;
+    enc_key_t* ek;
+};
+
+static void
+kerberos_cache_match_key(gpointer key _U_, gpointer value, gpointer user_data)
+{
+    struct kerberos_cache_key_search* search = (struct kerberos_cache_key_search*)user_data;
+    enc_key_t* ek = (enc_key_t*)value;
+
+    if (search->ek == NULL && ek->keytype == search->rec->keytype &&
+        kerberos_cache_key_id(ek) == search->rec->key_id) {
+        search->ek = ek;
+    }
+}
+
+/* The key in key_map that rec names, if it is there (a 32-bit id may collide, the caller still checks) */
+static enc_key_t*
+kerberos_cache_key(wmem_map_t* key_map, const kerberos_cache_record_t* rec)
+{
+    struct kerberos_cache_key_search search = { rec, NULL };
+
+    wmem_map_foreach(key_map, kerberos_cache_match_key, &search);
+    return search.ek;
+}
+
+static void
+kerberos_cache_collect(gpointer key _U_, gpointer value, gpointer user_data)
+{
+    g_array_append_val((GArray*)user_data, *(kerberos_cache_record_t*)value);
+}
+
+static void
+kerberos_cache_cleanup(void)
+{
+    kerberos_cache_header_t header;
+    GArray* records;
+    char* tmp_path;
+    FILE* fp = NULL;
+    int fd;
+    gboolean ok;
+
+    if (kerberos_cache_path == NULL || !kerberos_cache_dirty ||
+        kerberos_cache_outcomes == NULL || wmem_map_size(kerberos_cache_outcomes) == 0) {
+        kerberos_cache_reset();
+        return;
+    }
+
+    records = g_array_sized_new(FALSE, FALSE, sizeof(kerberos_cache_record_t),
+        wmem_map_size(kerberos_cache_outcomes));
+    wmem_map_foreach(kerberos_cache_outcomes, kerberos_cache_collect, records);
+    g_array_sort(records, kerberos_cache_record_cmp);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, KRB_CACHE_MAGIC, sizeof(header.magic));
+    header.byte_order = KRB_CACHE_BYTE_ORDER;
+    header.count = records->len;
+
+    /* the old file may still be mapped; write aside and rename over it */
+    tmp_path = g_strdup_printf("%s.XXXXXX", kerberos_cache_path);
+    fd = g_mkstemp_full(tmp_path, O_WRONLY | O_BINARY, 0600);
+    if (fd != -1) {
+        fp = ws_fdopen(fd, "wb");
+        if (fp == NULL) {
+            ws_close(fd);
+            ws_unlink(tmp_path);
+        }
+    }
+    if (fp == NULL) {
+        fprintf(stderr, "KERBEROS ERROR: Could not write cache file %s\n", tmp_path);
+    } else {
+        ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+            (records->len == 0 ||
+             fwrite(records->data, sizeof(kerberos_cache_record_t), records->len, fp) == records->len);
+        ok = (fclose(fp) == 0) && ok;
+        if (kerberos_cache_file != NULL) {
+            g_mapped_file_unref(kerberos_cache_file);
+            kerberos_cache_file = NULL;
+            kerberos_cache_records = NULL;
+        }
+        if (!ok || ws_rename(tmp_path, kerberos_cache_path) != 0) {
+            fprintf(stderr, "KERBEROS ERROR: Could not write cache file %s\n", kerberos_cache_path);
+            ws_unlink(tmp_path);
+        }
+    }
+    g_free(tmp_path);
+    g_array_free(records, TRUE);
+    kerberos_cache_reset();
+}
+#endif /* HAVE_MIT_KERBEROS */
+
+static gint enc_key_cmp_id(gconstpointer k1, gconstpointer k2)
+{
+    const enc_key_t* key1 = (const enc_key_t*)k1;
+    const enc_key_t* key2 = (const enc_key_t*)k2;
+
+    if (key1->fd_num < key2->fd_num) {
+        return -1;
+    }
+    if (key1->fd_num > key2->fd_num) {
+        return 1;
+    }
+
+    if (key1->id < key2->id) {
+        return -1;
+    }
+    if (key1->id > key2->id) {
+        return 1;
+    }
+
+    return 0;
+}
+
+static gboolean
+enc_key_content_equal(gconstpointer k1, gconstpointer k2)
+{
+    const enc_key_t* key1 = (const enc_key_t*)k1;
+    const enc_key_t* key2 = (const enc_key_t*)k2;
+    int cmp;
+
+    if (key1->keytype != key2->keytype) {
+        return FALSE;
+    }
+
+    if (key1->keylength != key2->keylength) {
+        return FALSE;
+    }
+
+    cmp = memcmp(key1->keyvalue, key2->keyvalue, key1->keylength);
+    if (cmp != 0) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static guint
+enc_key_content_hash(gconstpointer k)
+{
+    const enc_key_t* key = (const enc_key_t*)k;
+    guint ret = 0;
+
+    ret += wmem_strong_hash((const guint8*)&key->keytype,
+        sizeof(key->keytype));
+    ret += wmem_strong_hash((const guint8*)&key->keylength,
+        sizeof(key->keylength));
+    ret += wmem_strong_hash((const guint8*)key->keyvalue,
+        key->keylength);
+
+    return ret;
+}
+
+static void
+kerberos_key_map_insert(wmem_map_t* key_map, enc_key_t* new_key)
+{
+    enc_key_t* existing = NULL;
+    enc_key_t* cur = NULL;
+    gint cmp;
+
+    existing = (enc_key_t*)wmem_map_lookup(key_map, new_key);
+    if (existing == NULL) {
+        wmem_map_insert(key_map, new_key, new_key);
+        return;
+    }
+
+    if (key_map != kerberos_all_keys) {
+        /*
+         * It should already be linked to the existing key...
+         */
+        return;
+    }
+
+    if (existing->fd_num == -1 && new_key->fd_num != -1) {
+        /*
+         * We can't reference a learnt key
+         * from a longterm key. As they have
+         * a shorter lifetime.
+         *
+         * So just let the learnt key remember the
          * match.
          */
         new_key->same_list = existing;
@@ -1039,16 +2008,20 @@ static void insert_longterm_keys_into_key_map(wmem_map_t* key_map)
 }
 
 static void
-kerberos_key_list_append(wmem_list_t* key_list, enc_key_t* new_key)
+kerberos_key_list_append(wmem_list_t** key_list, enc_key_t* new_key)
 {
     enc_key_t* existing = NULL;
 
-    existing = (enc_key_t*)wmem_list_find(key_list, new_key);
+    if (*key_list == NULL) {
+        *key_list = wmem_list_new(wmem_packet_scope());
+    }
+
+    existing = (enc_key_t*)wmem_list_find(*key_list, new_key);
     if (existing != NULL) {
         return;
     }
 
-    wmem_list_append(key_list, new_key);
+    wmem_list_append(*key_list, new_key);
 }
 
 static void
@@ -1066,15 +2039,17 @@ add_encryption_key(packet_info* pinfo,
     const char* methodl = "learnt";
     const char* methodu = "Learnt";
     proto_item* item = NULL;
+    gboolean keep;
 
     private_data->last_added_key = NULL;
+    keep = !pinfo->fd->visited || private_data->missing_key_retried;
 
     if (src1 != NULL && src2 != NULL) {
         methodl = "derived";
         methodu = "Derived";
     }
 
-    if (pinfo->fd->visited) {
+    if (!keep) {
         /*
          * We already processed this,
          * we can use a shortterm scope
@@ -1103,15 +2078,26 @@ add_encryption_key(packet_info* pinfo,
     memcpy(new_key->keyvalue, keyvalue, MIN(keylength, KRB_MAX_KEY_LENGTH));
     new_key->src1 = src1;
     new_key->src2 = src2;
+    if (kerberos_live_mode) {
+        /* until the ticket end time turns up */
+        new_key->expires = pinfo->abs_ts.secs + kerberos_live_timeout;
+    }
 
-    if (!pinfo->fd->visited) {
+    if (keep) {
         /*
-         * Only keep it if we don't processed it before.
+         * Only keep it if we don't processed it before,
+         * or if the frame only decrypted now that a missing
+         * key turned up.
          */
         new_key->next = enc_key_list;
         enc_key_list = new_key;
+        enc_key_list_len++;
         insert_longterm_keys_into_key_map(kerberos_all_keys);
         kerberos_key_map_insert(kerberos_all_keys, new_key);
+        kerberos_bump_key_generation(keytype, private_data->realm);
+#ifdef HAVE_MIT_KERBEROS
+        kerberos_cache_learnt_key(new_key);
+#endif
     }
 
     item = proto_tree_add_expert_format(key_tree, pinfo, &ei_kerberos_learnt_keytype,
@@ -1142,7 +2128,7 @@ add_encryption_key(packet_info* pinfo,
             sek->keyvalue[2] & 0xFF, sek->keyvalue[3] & 0xFF);
     }
 
-    kerberos_key_list_append(private_data->learnt_keys, new_key);
+    kerberos_key_list_append(&private_data->learnt_keys, new_key);
     private_data->last_added_key = new_key;
 }
 
@@ -1247,6 +2233,15 @@ save_KrbCredInfo_key(tvbuff_t* tvb, int offset, int length,
     save_encryption_key(tvb, offset, length, actx, tree, parent_hf_index, hf_index);
 }
 
+static void
+save_ReplyKeyPack_replyKey(tvbuff_t* tvb, int offset, int length,
+    asn1_ctx_t* actx, proto_tree* tree,
+    int parent_hf_index,
+    int hf_index)
+{
+    save_encryption_key(tvb, offset, length, actx, tree, parent_hf_index, hf_index);
+}
+
 static void
 save_KrbFastResponse_strengthen_key(tvbuff_t* tvb, int offset, int length,
     asn1_ctx_t* actx, proto_tree* tree,
@@ -1310,7 +2305,7 @@ static void used_encryption_key(proto_tree* tree, packet_info* pinfo,
             sek->keyvalue[2] & 0xFF, sek->keyvalue[3] & 0xFF);
         sek = sek->same_list;
     }
-    kerberos_key_list_append(private_data->decryption_keys, ek);
+    kerberos_key_list_append(&private_data->decryption_keys, ek);
     private_data->last_decryption_key = ek;
 }
 #endif /* HAVE_HEIMDAL_KERBEROS || HAVE_MIT_KERBEROS */
@@ -1347,7 +2342,8 @@ static void missing_encryption_key(proto_tree* tree, packet_info* pinfo,
         keymap_size,
         decryption_count);
 
-    kerberos_key_list_append(private_data->missing_keys, mek);
+    kerberos_key_list_append(&private_data->missing_keys, mek);
+    kerberos_record_missing_key(pinfo, private_data, keytype, usage);
 }
 
 #ifdef HAVE_KRB5_PAC_VERIFY
@@ -1387,7 +2383,7 @@ static void used_signing_key(proto_tree* tree, packet_info* pinfo,
             sek->keyvalue[2] & 0xFF, sek->keyvalue[3] & 0xFF);
         sek = sek->same_list;
     }
-    kerberos_key_list_append(private_data->decryption_keys, ek);
+    kerberos_key_list_append(&private_data->decryption_keys, ek);
 }
 
 static void missing_signing_key(proto_tree* tree, packet_info* pinfo,
@@ -1423,7 +2419,7 @@ static void missing_signing_key(proto_tree* tree, packet_info* pinfo,
         keymap_size,
         verify_count);
 
-    kerberos_key_list_append(private_data->missing_keys, mek);
+    kerberos_key_list_append(&private_data->missing_keys, mek);
 }
 
 #endif /* HAVE_KRB5_PAC_VERIFY */
@@ -1557,12 +2553,14 @@ read_keytab_file(const char* filename)
                 MIN(key.key.length, KRB_MAX_KEY_LENGTH));
 
             enc_key_list = new_key;
+            enc_key_list_len++;
             ret = krb5_free_keytab_entry_contents(krb5_ctx, &key);
             if (ret) {
                 fprintf(stderr, "KERBEROS ERROR: Could not release the entry: %d", ret);
                 ret = 0; /* try to continue with the next entry */
             }
             kerberos_key_map_insert(kerberos_longterm_keys, new_key);
+            kerberos_bump_key_generation(new_key->keytype, NULL);
         }
     } while (ret == 0);
 
@@ -1576,1193 +2574,1301 @@ read_keytab_file(const char* filename)
     }
 }
 
-struct decrypt_krb5_with_cb_state {
-    proto_tree* tree;
-    packet_info* pinfo;
-    kerberos_private_data_t* private_data;
-    int usage;
-    int keytype;
-    tvbuff_t* cryptotvb;
-    krb5_error_code(*decrypt_cb_fn)(
-        const krb5_keyblock* key,
-        int usage,
-        void* decrypt_cb_data);
-    void* decrypt_cb_data;
-    guint count;
-    enc_key_t* ek;
-};
+/*
+ * Prepared keys (krb5_k_create_key) for the keys we try. MIT keeps the
+ * derived Ke/Ki per usage and the cipher key schedule inside a krb5_key,
+ * so trying the same key on every ticket for a service, or on every
+ * wrap token of a session, pays for the derivation once instead of once
+ * per packet. Keyed by key content; flushed when it outgrows the limit.
+ */
+#define KRB_MAX_KEY_SCHEDULES 4096
+/* per schedule: the copy of the key plus MIT's krb5_key with a derived key or two */
+#define KRB_KEY_SCHEDULE_BYTES (4 * KRB_MAX_KEY_LENGTH)
+
+static GHashTable* kerberos_key_schedules = NULL;
 
 static void
-decrypt_krb5_with_cb_try_key(gpointer __key _U_, gpointer value, gpointer userdata)
+kerberos_key_schedule_free(gpointer data)
 {
-    struct decrypt_krb5_with_cb_state* state =
-        (struct decrypt_krb5_with_cb_state*)userdata;
-    enc_key_t* ek = (enc_key_t*)value;
-    krb5_error_code ret;
-    krb5_keytab_entry key;
-#ifdef HAVE_KRB5_C_FX_CF2_SIMPLE
-    enc_key_t* ak = state->private_data->fast_armor_key;
-    enc_key_t* sk = state->private_data->fast_strengthen_key;
-    gboolean try_with_armor_key = FALSE;
-    gboolean try_with_strengthen_key = FALSE;
-#endif
+    krb5_k_free_key(krb5_ctx, (krb5_key)data);
+}
 
-    if (state->ek != NULL) {
-        /*
-         * we're done.
-         */
-        return;
+static krb5_key
+kerberos_key_schedule(const krb5_keyblock* keyblock)
+{
+    enc_key_t lookup;
+    enc_key_t* copy;
+    krb5_key kkey = NULL;
+
+    if (keyblock->length > KRB_MAX_KEY_LENGTH) {
+        return NULL;
     }
+    lookup.keytype = keyblock->enctype;
+    lookup.keylength = keyblock->length;
+    memcpy(lookup.keyvalue, keyblock->contents, keyblock->length);
 
-#ifdef HAVE_KRB5_C_FX_CF2_SIMPLE
-    if (ak != NULL && ak != ek && ak->keytype == state->keytype && ek->fd_num == -1) {
-        switch (state->usage) {
-        case KEY_USAGE_ENC_CHALLENGE_CLIENT:
-        case KEY_USAGE_ENC_CHALLENGE_KDC:
-            if (ek->fd_num == -1) {
-                /* Challenges are based on a long term key */
-                try_with_armor_key = TRUE;
-            }
-            break;
-        }
+    if (kerberos_key_schedules == NULL) {
+        kerberos_key_schedules = g_hash_table_new_full(enc_key_content_hash,
+            enc_key_content_equal, g_free, kerberos_key_schedule_free);
+    }
+    kkey = (krb5_key)g_hash_table_lookup(kerberos_key_schedules, &lookup);
+    if (kkey != NULL) {
+        return kkey;
+    }
 
-        /*
-         * If we already have a strengthen_key
-         * we don't need to try with the armor key
-         * again
-         */
-        if (sk != NULL) {
-            try_with_armor_key = FALSE;
-        }
+    if (krb5_k_create_key(krb5_ctx, keyblock, &kkey) != 0) {
+        return NULL;
     }
-
-    if (sk != NULL && sk != ek && sk->keytype == state->keytype && sk->keytype == ek->keytype) {
-        switch (state->usage) {
-        case 3:
-            if (ek->fd_num == -1) {
-                /* AS-REP is based on a long term key */
-                try_with_strengthen_key = TRUE;
-            }
-            break;
-        case 8:
-        case 9:
-            if (ek->fd_num != -1) {
-                /* TGS-REP is not based on a long term key */
-                try_with_strengthen_key = TRUE;
-            }
-            break;
-        }
+    if (g_hash_table_size(kerberos_key_schedules) >= KRB_MAX_KEY_SCHEDULES) {
+        g_hash_table_remove_all(kerberos_key_schedules);
     }
+    copy = g_new0(enc_key_t, 1);
+    copy->keytype = lookup.keytype;
+    copy->keylength = lookup.keylength;
+    memcpy(copy->keyvalue, lookup.keyvalue, lookup.keylength);
+    g_hash_table_insert(kerberos_key_schedules, copy, kkey);
+    return kkey;
+}
 
-    if (try_with_armor_key) {
-        krb5_keyblock k1;
-        krb5_keyblock k2;
-        krb5_keyblock* k = NULL;
-        const char* p1 = NULL;
-
-        k1.magic = KV5M_KEYBLOCK;
-        k1.enctype = ak->keytype;
-        k1.length = ak->keylength;
-        k1.contents = (guint8*)ak->keyvalue;
+static void
+kerberos_key_schedules_cleanup(void)
+{
+    if (kerberos_key_schedules != NULL) {
+        g_hash_table_destroy(kerberos_key_schedules);
+        kerberos_key_schedules = NULL;
+    }
+}
 
-        k2.magic = KV5M_KEYBLOCK;
-        k2.enctype = ek->keytype;
-        k2.length = ek->keylength;
-        k2.contents = (guint8*)ek->keyvalue;
+static void
+kerberos_mem_key_schedules(guint* count, guint64* bytes)
+{
+    *count = kerberos_key_schedules ? g_hash_table_size(kerberos_key_schedules) : 0;
+    *bytes = (guint64)*count * (sizeof(enc_key_t) + KRB_KEY_SCHEDULE_BYTES + BER_MEM_MAP_ENTRY);
+}
 
-        switch (state->usage) {
-        case KEY_USAGE_ENC_CHALLENGE_CLIENT:
-            p1 = "clientchallengearmor";
-            break;
-        case KEY_USAGE_ENC_CHALLENGE_KDC:
-            p1 = "kdcchallengearmor";
-            break;
-        default:
-            /*
-             * Should never be called!
-             */
-             /*
-              * try the next one...
-              */
-            return;
-        }
+/*
+ * Built-in aes*-cts-hmac-sha1-96 (RFC 3962) and aes*-cts-hmac-sha2
+ * (RFC 8009) decryption for the trial path (kerberos.builtin_aes).
+ * Per (key, usage) the derived Ke/Ki are kept as open gcrypt handles, so
+ * a trial is one HMAC and one CTS pass with no allocation; gcrypt uses
+ * AES-NI/VAES and the SHA extensions where the CPU has them. RFC 8009
+ * MACs the ciphertext, so a wrong key is rejected before decrypting.
+ * Anything else falls through to krb5_c_decrypt().
+ * The first trial of every (key, usage) is also run through
+ * krb5_c_decrypt() and the two results compared; on any disagreement the
+ * built-in path is switched off for the session and the library is used.
+ */
+typedef struct {
+    enc_key_t key;          /* only the content is used */
+    int usage;
+    gcry_cipher_hd_t ke;
+    gcry_md_hd_t ki;
+    guint mac_len;
+    gboolean mac_ciphertext; /* RFC 8009 */
+    gboolean checked;        /* cross-checked against the library */
+} kerberos_aes_keys_t;
+
+#define KRB_AES_BLOCK 16
+#define KRB_MAX_AES_KEYS 4096
+/* per key: two gcrypt contexts, roughly an expanded AES key and an HMAC state */
+#define KRB_AES_CONTEXT_BYTES 1024
+
+static gboolean krb_builtin_aes = FALSE;
+static gboolean kerberos_aes_mismatch = FALSE;
+static GHashTable* kerberos_aes_keys = NULL;
 
-        ret = krb5_c_fx_cf2_simple(krb5_ctx,
-            &k1, p1,
-            &k2, "challengelongterm",
-            &k);
-        if (ret != 0) {
-            /*
-             * try the next one...
-             */
-            return;
-        }
+static guint
+kerberos_aes_keys_hash(gconstpointer k)
+{
+    const kerberos_aes_keys_t* keys = (const kerberos_aes_keys_t*)k;
 
-        state->count += 1;
-        ret = state->decrypt_cb_fn(k,
-            state->usage,
-            state->decrypt_cb_data);
-        if (ret == 0) {
-            add_encryption_key(state->pinfo,
-                state->private_data,
-                state->tree,
-                NULL,
-                state->cryptotvb,
-                k->enctype, k->length,
-                (const char*)k->contents,
-                p1,
-                ak, ek);
-            krb5_free_keyblock(krb5_ctx, k);
-            /*
-             * remember the key and stop traversing
-             */
-            state->ek = state->private_data->last_added_key;
-            return;
-        }
-        krb5_free_keyblock(krb5_ctx, k);
-        /*
-         * don't stop traversing...
-         * try the next one...
-         */
-        return;
-    }
+    return enc_key_content_hash(&keys->key) ^ (guint)keys->usage;
+}
 
-    if (try_with_strengthen_key) {
-        krb5_keyblock k1;
-        krb5_keyblock k2;
-        krb5_keyblock* k = NULL;
+static gboolean
+kerberos_aes_keys_equal(gconstpointer k1, gconstpointer k2)
+{
+    const kerberos_aes_keys_t* keys1 = (const kerberos_aes_keys_t*)k1;
+    const kerberos_aes_keys_t* keys2 = (const kerberos_aes_keys_t*)k2;
 
-        k1.magic = KV5M_KEYBLOCK;
-        k1.enctype = sk->keytype;
-        k1.length = sk->keylength;
-        k1.contents = (guint8*)sk->keyvalue;
+    return keys1->usage == keys2->usage &&
+        enc_key_content_equal(&keys1->key, &keys2->key);
+}
 
-        k2.magic = KV5M_KEYBLOCK;
-        k2.enctype = ek->keytype;
-        k2.length = ek->keylength;
-        k2.contents = (guint8*)ek->keyvalue;
+static void
+kerberos_aes_keys_free(gpointer data)
+{
+    kerberos_aes_keys_t* keys = (kerberos_aes_keys_t*)data;
 
-        ret = krb5_c_fx_cf2_simple(krb5_ctx,
-            &k1, "strengthenkey",
-            &k2, "replykey",
-            &k);
-        if (ret != 0) {
-            /*
-             * try the next one...
-             */
-            return;
-        }
+    gcry_cipher_close(keys->ke);
+    gcry_md_close(keys->ki);
+    g_free(keys);
+}
 
-        state->count += 1;
-        ret = state->decrypt_cb_fn(k,
-            state->usage,
-            state->decrypt_cb_data);
-        if (ret == 0) {
-            add_encryption_key(state->pinfo,
-                state->private_data,
-                state->tree,
-                NULL,
-                state->cryptotvb,
-                k->enctype, k->length,
-                (const char*)k->contents,
-                "strengthen-reply-key",
-                sk, ek);
-            krb5_free_keyblock(krb5_ctx, k);
-            /*
-             * remember the key and stop traversing
-             */
-            state->ek = state->private_data->last_added_key;
-            return;
+/* RFC 3961 n-fold, lengths in bytes */
+static void
+kerberos_aes_nfold(const guint8* in, int inlen, guint8* out, int outlen)
+{
+    int a, b, c, lcm, i, msbit;
+    guint byte = 0;
+
+    a = outlen;
+    b = inlen;
+    while (b != 0) {
+        c = b;
+        b = a % b;
+        a = c;
+    }
+    lcm = outlen * inlen / a;
+
+    memset(out, 0, outlen);
+    for (i = lcm - 1; i >= 0; i--) {
+        msbit = (((inlen << 3) - 1) +
+            (((inlen << 3) + 13) * (i / inlen)) +
+            ((inlen - (i % inlen)) << 3)) % (inlen << 3);
+        byte += (((in[((inlen - 1) - (msbit >> 3)) % inlen] << 8) |
+            in[(inlen - (msbit >> 3)) % inlen]) >> ((msbit & 7) + 1)) & 0xff;
+        byte += out[i % outlen];
+        out[i % outlen] = byte & 0xff;
+        byte >>= 8;
+    }
+    if (byte) {
+        for (i = outlen - 1; i >= 0; i--) {
+            byte += out[i];
+            out[i] = byte & 0xff;
+            byte >>= 8;
         }
-        krb5_free_keyblock(krb5_ctx, k);
-        /*
-         * don't stop traversing...
-         * try the next one...
-         */
-        return;
     }
-#endif /* HAVE_KRB5_C_FX_CF2_SIMPLE */
+}
 
-    /* shortcircuit and bail out if enctypes are not matching */
-    if ((state->keytype != -1) && (ek->keytype != state->keytype)) {
-        /*
-         * don't stop traversing...
-         * try the next one...
-         */
-        return;
-    }
+/* RFC 3961 DK() for AES: AES-encrypt n-fold(constant) until there is enough */
+static gboolean
+kerberos_aes_dk(const krb5_keyblock* base, const guint8 constant[5], guint8* out, guint outlen)
+{
+    gcry_cipher_hd_t hd;
+    guint8 block[KRB_AES_BLOCK];
+    guint done;
+    gboolean ok;
 
-    key.key.enctype = ek->keytype;
-    key.key.length = ek->keylength;
-    key.key.contents = ek->keyvalue;
-    state->count += 1;
-    ret = state->decrypt_cb_fn(&(key.key),
-        state->usage,
-        state->decrypt_cb_data);
-    if (ret != 0) {
-        /*
-         * don't stop traversing...
-         * try the next one...
-         */
-        return;
+    if (gcry_cipher_open(&hd, base->length == 32 ? GCRY_CIPHER_AES256 : GCRY_CIPHER_AES128,
+        GCRY_CIPHER_MODE_ECB, 0)) {
+        return FALSE;
     }
-
-    /*
-     * we're done, remember the key
-     */
-    state->ek = ek;
+    ok = gcry_cipher_setkey(hd, base->contents, base->length) == 0;
+    kerberos_aes_nfold(constant, 5, block, KRB_AES_BLOCK);
+    for (done = 0; ok && done < outlen; done += KRB_AES_BLOCK) {
+        ok = gcry_cipher_encrypt(hd, block, KRB_AES_BLOCK, NULL, 0) == 0;
+        memcpy(out + done, block, MIN(KRB_AES_BLOCK, outlen - done));
+    }
+    gcry_cipher_close(hd);
+    return ok;
 }
 
-static krb5_error_code
-decrypt_krb5_with_cb(proto_tree* tree,
-    packet_info* pinfo,
-    kerberos_private_data_t* private_data,
-    int usage,
-    int keytype,
-    tvbuff_t* cryptotvb,
-    krb5_error_code(*decrypt_cb_fn)(
-        const krb5_keyblock* key,
-        int usage,
-        void* decrypt_cb_data),
-    void* decrypt_cb_data)
+/* RFC 8009 KDF-HMAC-SHA2(key, label, k) */
+static gboolean
+kerberos_aes_kdf(const krb5_keyblock* base, int md_algo, const guint8 label[5], guint8* out, guint outlen)
 {
-    const char* key_map_name = NULL;
-    wmem_map_t* key_map = NULL;
-    struct decrypt_krb5_with_cb_state state = {
-            .tree = tree,
-            .pinfo = pinfo,
-            .private_data = private_data,
-            .usage = usage,
-            .cryptotvb = cryptotvb,
-            .keytype = keytype,
-            .decrypt_cb_fn = decrypt_cb_fn,
-            .decrypt_cb_data = decrypt_cb_data,
-    };
+    gcry_md_hd_t hd;
+    guint8 input[4 + 5 + 1 + 4];
+    gboolean ok;
 
-    read_keytab_file_from_preferences();
+    phton32(input, 1);
+    memcpy(input + 4, label, 5);
+    input[9] = 0;
+    phton32(input + 10, outlen * 8);
 
-    switch (usage) {
-    case KRB5_KU_USAGE_INITIATOR_SEAL:
-    case KRB5_KU_USAGE_ACCEPTOR_SEAL:
-        key_map_name = "app_session_keys";
-        key_map = kerberos_app_session_keys;
+    if (gcry_md_open(&hd, md_algo, GCRY_MD_FLAG_HMAC)) {
+        return FALSE;
+    }
+    ok = gcry_md_setkey(hd, base->contents, base->length) == 0;
+    if (ok) {
+        gcry_md_write(hd, input, sizeof(input));
+        memcpy(out, gcry_md_read(hd, 0), outlen);
+    }
+    gcry_md_close(hd);
+    return ok;
+}
+
+static kerberos_aes_keys_t*
+kerberos_aes_keys_get(const krb5_keyblock* base, int usage)
+{
+    kerberos_aes_keys_t lookup;
+    kerberos_aes_keys_t* keys;
+    guint8 constant[5];
+    guint8 ke[32];
+    guint8 ki[32];
+    guint ke_len = base->length;
+    guint ki_len;
+    int md_algo;
+    gboolean rfc8009;
+    gboolean ok;
+
+    switch (base->enctype) {
+    case ENCTYPE_AES128_CTS_HMAC_SHA1_96:
+    case ENCTYPE_AES256_CTS_HMAC_SHA1_96:
+        rfc8009 = FALSE;
+        md_algo = GCRY_MD_SHA1;
+        ki_len = base->length;
         break;
-    default:
-        key_map_name = "all_keys";
-        key_map = kerberos_all_keys;
-        insert_longterm_keys_into_key_map(key_map);
+#ifdef ENCTYPE_AES128_CTS_HMAC_SHA256_128
+    case ENCTYPE_AES128_CTS_HMAC_SHA256_128:
+        rfc8009 = TRUE;
+        md_algo = GCRY_MD_SHA256;
+        ki_len = 16;
+        break;
+    case ENCTYPE_AES256_CTS_HMAC_SHA384_192:
+        rfc8009 = TRUE;
+        md_algo = GCRY_MD_SHA384;
+        ki_len = 24;
         break;
+#endif
+    default:
+        return NULL;
+    }
+    if (base->length != 16 && base->length != 32) {
+        return NULL;
     }
 
-    wmem_map_foreach(key_map, decrypt_krb5_with_cb_try_key, &state);
-    if (state.ek != NULL) {
-        used_encryption_key(tree, pinfo, private_data,
-            state.ek, usage, cryptotvb,
-            key_map_name,
-            wmem_map_size(key_map),
-            state.count);
-        return 0;
+    memset(&lookup, 0, sizeof(lookup));
+    lookup.key.keytype = base->enctype;
+    lookup.key.keylength = base->length;
+    memcpy(lookup.key.keyvalue, base->contents, base->length);
+    lookup.usage = usage;
+    if (kerberos_aes_keys == NULL) {
+        kerberos_aes_keys = g_hash_table_new_full(kerberos_aes_keys_hash,
+            kerberos_aes_keys_equal, kerberos_aes_keys_free, NULL);
+    }
+    keys = (kerberos_aes_keys_t*)g_hash_table_lookup(kerberos_aes_keys, &lookup);
+    if (keys != NULL) {
+        return keys;
+    }
+
+    phton32(constant, usage);
+    constant[4] = 0xAA;
+    ok = rfc8009 ? kerberos_aes_kdf(base, md_algo, constant, ke, ke_len) :
+        kerberos_aes_dk(base, constant, ke, ke_len);
+    constant[4] = 0x55;
+    ok = ok && (rfc8009 ? kerberos_aes_kdf(base, md_algo, constant, ki, ki_len) :
+        kerberos_aes_dk(base, constant, ki, ki_len));
+    if (!ok) {
+        return NULL;
     }
 
-    missing_encryption_key(tree, pinfo, private_data,
-        keytype, usage, cryptotvb,
-        key_map_name,
-        wmem_map_size(key_map),
-        state.count);
-    return -1;
-}
+    keys = g_new(kerberos_aes_keys_t, 1);
+    *keys = lookup;
+    keys->mac_len = rfc8009 ? ki_len : 12;
+    keys->mac_ciphertext = rfc8009;
+    keys->checked = FALSE;
+    if (gcry_cipher_open(&keys->ke, ke_len == 32 ? GCRY_CIPHER_AES256 : GCRY_CIPHER_AES128,
+        GCRY_CIPHER_MODE_CBC, GCRY_CIPHER_CBC_CTS)) {
+        g_free(keys);
+        return NULL;
+    }
+    if (gcry_md_open(&keys->ki, md_algo, GCRY_MD_FLAG_HMAC)) {
+        gcry_cipher_close(keys->ke);
+        g_free(keys);
+        return NULL;
+    }
+    if (gcry_cipher_setkey(keys->ke, ke, ke_len) || gcry_md_setkey(keys->ki, ki, ki_len)) {
+        kerberos_aes_keys_free(keys);
+        return NULL;
+    }
 
-struct decrypt_krb5_data_state {
-    krb5_data input;
-    krb5_data output;
-};
+    if (g_hash_table_size(kerberos_aes_keys) >= KRB_MAX_AES_KEYS) {
+        g_hash_table_remove_all(kerberos_aes_keys);
+    }
+    g_hash_table_add(kerberos_aes_keys, keys);
+    return keys;
+}
 
-static krb5_error_code
-decrypt_krb5_data_cb(const krb5_keyblock* key,
-    int usage,
-    void* decrypt_cb_data)
+/*
+ * Returns FALSE if the enctype is not one handled here, otherwise TRUE
+ * with *ret set as krb5_c_decrypt() would. On success the plaintext
+ * (without the confounder) is in output and its length updated; on
+ * failure output->length is left alone for the next trial.
+ */
+static gboolean
+kerberos_aes_decrypt_keys(kerberos_aes_keys_t* keys,
+    const krb5_data* input, krb5_data* output, krb5_error_code* ret)
 {
-    struct decrypt_krb5_data_state* state =
-        (struct decrypt_krb5_data_state*)decrypt_cb_data;
-    krb5_enc_data input;
+    static const guint8 zero_iv[KRB_AES_BLOCK] = { 0 };
+    guint8* out = (guint8*)output->data;
+    guint clen;
 
-    memset(&input, 0, sizeof(input));
-    input.enctype = key->enctype;
-    input.ciphertext = state->input;
+    *ret = KRB5KRB_AP_ERR_BAD_INTEGRITY;
+    if (input->length < KRB_AES_BLOCK + keys->mac_len) {
+        return TRUE;
+    }
+    clen = input->length - keys->mac_len;
+    if (output->length < clen) {
+        return FALSE;
+    }
 
-    return krb5_c_decrypt(krb5_ctx,
-        key,
-        usage,
-        0,
-        &input,
-        &state->output);
-}
+    gcry_md_reset(keys->ki);
+    if (keys->mac_ciphertext) {
+        gcry_md_write(keys->ki, zero_iv, sizeof(zero_iv));
+        gcry_md_write(keys->ki, input->data, clen);
+        if (memcmp(gcry_md_read(keys->ki, 0), input->data + clen, keys->mac_len) != 0) {
+            return TRUE;
+        }
+    }
 
-static guint8*
-decrypt_krb5_data_private(proto_tree* tree _U_, packet_info* pinfo,
-    kerberos_private_data_t* private_data,
-    int usage, tvbuff_t* cryptotvb, int keytype,
-    int* datalen)
-{
-#define HAVE_DECRYPT_KRB5_DATA_PRIVATE 1
-    struct decrypt_krb5_data_state state;
-    krb5_error_code ret;
-    int length = tvb_captured_length(cryptotvb);
-    const guint8* cryptotext = tvb_get_ptr(cryptotvb, 0, length);
+    gcry_cipher_setiv(keys->ke, zero_iv, sizeof(zero_iv));
+    if (gcry_cipher_decrypt(keys->ke, out, clen, input->data, clen)) {
+        return FALSE;
+    }
 
-    /* don't do anything if we are not attempting to decrypt data */
-    if (!krb_decrypt || length < 1) {
-        return NULL;
+    if (!keys->mac_ciphertext) {
+        gcry_md_write(keys->ki, out, clen);
+        if (memcmp(gcry_md_read(keys->ki, 0), input->data + clen, keys->mac_len) != 0) {
+            return TRUE;
+        }
     }
 
-    /* make sure we have all the data we need */
-    if (tvb_captured_length(cryptotvb) < tvb_reported_length(cryptotvb)) {
-        return NULL;
+    memmove(out, out + KRB_AES_BLOCK, clen - KRB_AES_BLOCK);
+    output->length = clen - KRB_AES_BLOCK;
+    *ret = 0;
+    return TRUE;
+}
+
+/*
+ * Decrypts the same input with krb5_c_decrypt() and returns TRUE if it
+ * agrees with the built-in result: both reject, or both accept with the
+ * same plaintext.
+ */
+static gboolean
+kerberos_aes_cross_check(const krb5_keyblock* key, int usage,
+    const krb5_data* input, const krb5_data* output, krb5_error_code ret)
+{
+    krb5_enc_data enc;
+    krb5_data plain;
+    krb5_error_code lib_ret;
+    gboolean same;
+
+    memset(&enc, 0, sizeof(enc));
+    enc.enctype = key->enctype;
+    enc.ciphertext = *input;
+    plain.length = input->length;
+    plain.data = (char*)g_malloc(input->length);
+    lib_ret = krb5_c_decrypt(krb5_ctx, key, usage, 0, &enc, &plain);
+    if (ret == 0) {
+        same = lib_ret == 0 && plain.length == output->length &&
+            memcmp(plain.data, output->data, plain.length) == 0;
+    } else {
+        same = lib_ret != 0;
     }
+    g_free(plain.data);
+    return same;
+}
 
-    memset(&state, 0, sizeof(state));
-    state.input.length = length;
-    state.input.data = (guint8*)cryptotext;
-    state.output.data = (char*)wmem_alloc(pinfo->pool, length);
-    state.output.length = length;
+static gboolean
+kerberos_aes_decrypt(const krb5_keyblock* key, int usage,
+    const krb5_data* input, krb5_data* output, krb5_error_code* ret)
+{
+    kerberos_aes_keys_t* keys;
+    unsigned int out_len = output->length;
 
-    ret = decrypt_krb5_with_cb(tree,
-        pinfo,
-        private_data,
-        usage,
-        keytype,
-        cryptotvb,
-        decrypt_krb5_data_cb,
-        &state);
-    if (ret != 0) {
-        return NULL;
+    if (!krb_builtin_aes || kerberos_aes_mismatch) {
+        return FALSE;
+    }
+    keys = kerberos_aes_keys_get(key, usage);
+    if (keys == NULL) {
+        return FALSE;
+    }
+    if (!kerberos_aes_decrypt_keys(keys, input, output, ret)) {
+        return FALSE;
+    }
+    if (!keys->checked) {
+        keys->checked = TRUE;
+        if (!kerberos_aes_cross_check(key, usage, input, output, *ret)) {
+            kerberos_aes_mismatch = TRUE;
+            fprintf(stderr, "KERBEROS ERROR: Built-in AES disagrees with the Kerberos"
+                " library for enctype %d usage %d, using the library from now on\n",
+                key->enctype, usage);
+            output->length = out_len;
+            return FALSE;
+        }
     }
+    return TRUE;
+}
 
-    if (datalen) {
-        *datalen = state.output.length;
+static void
+kerberos_aes_keys_cleanup(void)
+{
+    if (kerberos_aes_keys != NULL) {
+        g_hash_table_destroy(kerberos_aes_keys);
+        kerberos_aes_keys = NULL;
     }
-    return (guint8*)state.output.data;
 }
 
-guint8*
-decrypt_krb5_data(proto_tree* tree _U_, packet_info* pinfo,
-    int usage,
-    tvbuff_t* cryptotvb,
-    int keytype,
-    int* datalen)
+static void
+kerberos_mem_aes_keys(guint* count, guint64* bytes)
 {
-    kerberos_private_data_t* zero_private = kerberos_new_private_data();
-    return decrypt_krb5_data_private(tree, pinfo, zero_private,
-        usage, cryptotvb, keytype,
-        datalen);
+    *count = kerberos_aes_keys ? g_hash_table_size(kerberos_aes_keys) : 0;
+    *bytes = (guint64)*count * (sizeof(kerberos_aes_keys_t) + KRB_AES_CONTEXT_BYTES + BER_MEM_MAP_ENTRY);
 }
 
-USES_APPLE_RST
+/*
+ * arcfour-hmac (RFC 4757) pre-filter for the trial path
+ * (kerberos.rc4_tag_check). The library decrypts and MACs the whole
+ * ciphertext before it can say a key is wrong. Here only the confounder
+ * and the first plaintext octet are RC4-decrypted; a key whose plaintext
+ * does not start with the tag the usage calls for is rejected, the rest
+ * go through krb5_c_decrypt() as before.
+ *
+ * K3 = HMAC-MD5(K1, checksum) is the same 16-byte message for every
+ * candidate, so with the HMAC inner/outer states kept per (key, usage)
+ * it is two MD5 blocks and one RC4 key schedule per key. Both run for
+ * KRB_RC4_LANES keys at a time, lane-major. The MD5 lane loops are
+ * branch-free with the same message word and shift in every lane, so
+ * they vectorize. The RC4 swaps go to key-dependent places, which SIMD
+ * cannot do; there the lanes are only interleaved, so the CPU overlaps
+ * their independent load/store chains instead of waiting on each one.
+ */
+#define KRB_RC4_CHECKSUM 16
+#define KRB_RC4_CONFOUNDER 8
+#define KRB_RC4_LANES 8
+#define KRB_MAX_RC4_KEYS 4096
 
-#ifdef KRB5_CRYPTO_TYPE_SIGN_ONLY
-struct decrypt_krb5_krb_cfx_dce_state {
-    const guint8* gssapi_header_ptr;
-    guint gssapi_header_len;
-    tvbuff_t* gssapi_encrypted_tvb;
-    guint8* gssapi_payload;
-    guint gssapi_payload_len;
-    const guint8* gssapi_trailer_ptr;
-    guint gssapi_trailer_len;
-    tvbuff_t* checksum_tvb;
-    guint8* checksum;
-    guint checksum_len;
-};
+typedef struct {
+    enc_key_t key;          /* only the content is used */
+    int usage;
+    guint32 istate[4];      /* MD5 state after (K1 ^ ipad) */
+    guint32 ostate[4];      /* MD5 state after (K1 ^ opad) */
+} kerberos_rc4_keys_t;
 
-static krb5_error_code
-decrypt_krb5_krb_cfx_dce_cb(const krb5_keyblock* key,
-    int usage,
-    void* decrypt_cb_data)
+static gboolean krb_rc4_tag_check = FALSE;
+static GHashTable* kerberos_rc4_keys = NULL;
+
+static guint
+kerberos_rc4_keys_hash(gconstpointer k)
 {
-    struct decrypt_krb5_krb_cfx_dce_state* state =
-        (struct decrypt_krb5_krb_cfx_dce_state*)decrypt_cb_data;
-    unsigned int k5_headerlen = 0;
-    unsigned int k5_headerofs = 0;
-    unsigned int k5_trailerlen = 0;
-    unsigned int k5_trailerofs = 0;
-    size_t _k5_blocksize = 0;
-    guint k5_blocksize;
-    krb5_crypto_iov iov[6];
-    krb5_error_code ret;
-    guint checksum_remain = state->checksum_len;
-    guint checksum_crypt_len;
+    const kerberos_rc4_keys_t* keys = (const kerberos_rc4_keys_t*)k;
 
-    memset(iov, 0, sizeof(iov));
+    return enc_key_content_hash(&keys->key) ^ (guint)keys->usage;
+}
 
-    ret = krb5_c_crypto_length(krb5_ctx,
-        key->enctype,
-        KRB5_CRYPTO_TYPE_HEADER,
-        &k5_headerlen);
-    if (ret != 0) {
-        return ret;
-    }
-    if (checksum_remain < k5_headerlen) {
-        return -1;
-    }
-    checksum_remain -= k5_headerlen;
-    k5_headerofs = checksum_remain;
-    ret = krb5_c_crypto_length(krb5_ctx,
-        key->enctype,
-        KRB5_CRYPTO_TYPE_TRAILER,
-        &k5_trailerlen);
-    if (ret != 0) {
-        return ret;
+static gboolean
+kerberos_rc4_keys_equal(gconstpointer k1, gconstpointer k2)
+{
+    const kerberos_rc4_keys_t* keys1 = (const kerberos_rc4_keys_t*)k1;
+    const kerberos_rc4_keys_t* keys2 = (const kerberos_rc4_keys_t*)k2;
+
+    return keys1->usage == keys2->usage &&
+        enc_key_content_equal(&keys1->key, &keys2->key);
+}
+
+static const guint32 kerberos_md5_k[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+};
+
+static const guint8 kerberos_md5_s[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+};
+
+#define KRB_MD5_ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+/*
+ * One MD5 block for n <= KRB_RC4_LANES lanes: state[w][lane] is updated
+ * with block[w][lane] (16 little-endian words per lane).
+ */
+static void
+kerberos_md5_lanes(guint32 state[4][KRB_RC4_LANES], const guint32 block[16][KRB_RC4_LANES], guint n)
+{
+    guint32 a[KRB_RC4_LANES], b[KRB_RC4_LANES], c[KRB_RC4_LANES], d[KRB_RC4_LANES];
+    guint32 f[KRB_RC4_LANES];
+    guint i, l, g;
+
+    for (l = 0; l < n; l++) {
+        a[l] = state[0][l];
+        b[l] = state[1][l];
+        c[l] = state[2][l];
+        d[l] = state[3][l];
+    }
+    for (i = 0; i < 64; i++) {
+        const guint32 k = kerberos_md5_k[i];
+        const guint r = kerberos_md5_s[i];
+
+        /* the round function is picked once per step, not per lane */
+        switch (i >> 4) {
+        case 0:
+            g = i;
+            for (l = 0; l < n; l++) {
+                f[l] = (b[l] & c[l]) | (~b[l] & d[l]);
+            }
+            break;
+        case 1:
+            g = (5 * i + 1) & 15;
+            for (l = 0; l < n; l++) {
+                f[l] = (d[l] & b[l]) | (~d[l] & c[l]);
+            }
+            break;
+        case 2:
+            g = (3 * i + 5) & 15;
+            for (l = 0; l < n; l++) {
+                f[l] = b[l] ^ c[l] ^ d[l];
+            }
+            break;
+        default:
+            g = (7 * i) & 15;
+            for (l = 0; l < n; l++) {
+                f[l] = c[l] ^ (b[l] | ~d[l]);
+            }
+            break;
+        }
+        for (l = 0; l < n; l++) {
+            guint32 t = a[l] + f[l] + k + block[g][l];
+
+            a[l] = d[l];
+            d[l] = c[l];
+            c[l] = b[l];
+            b[l] = b[l] + KRB_MD5_ROTL(t, r);
+        }
     }
-    if (checksum_remain < k5_trailerlen) {
-        return -1;
+    for (l = 0; l < n; l++) {
+        state[0][l] += a[l];
+        state[1][l] += b[l];
+        state[2][l] += c[l];
+        state[3][l] += d[l];
     }
-    checksum_remain -= k5_trailerlen;
-    k5_trailerofs = checksum_remain;
-    checksum_crypt_len = checksum_remain;
+}
 
-    ret = krb5_c_block_size(krb5_ctx,
-        key->enctype,
-        &_k5_blocksize);
-    if (ret != 0) {
-        return ret;
+/* The MD5 state after one 64-byte block of key ^ pad */
+static void
+kerberos_md5_pad_state(const guint8 key[16], guint8 pad, guint32 out[4])
+{
+    guint32 state[4][KRB_RC4_LANES];
+    guint32 block[16][KRB_RC4_LANES];
+    guint w;
+
+    state[0][0] = 0x67452301;
+    state[1][0] = 0xefcdab89;
+    state[2][0] = 0x98badcfe;
+    state[3][0] = 0x10325476;
+    for (w = 0; w < 16; w++) {
+        guint32 p = pad * 0x01010101U;
+
+        block[w][0] = (w < 4) ? (pletoh32(key + 4 * w) ^ p) : p;
     }
-    /*
-     * The cast is required for the Windows build in order
-     * to avoid the following warning.
-     *
-     * warning C4267: '-=': conversion from 'size_t' to 'guint',
-     * possible loss of data
-     */
-    k5_blocksize = (guint)_k5_blocksize;
-    if (checksum_remain < k5_blocksize) {
-        return -1;
+    kerberos_md5_lanes(state, block, 1);
+    for (w = 0; w < 4; w++) {
+        out[w] = state[w][0];
     }
-    checksum_remain -= k5_blocksize;
-    if (checksum_remain < 16) {
+}
+
+/* The first plaintext octet for usage, -1 if we do not know */
+static int
+kerberos_rc4_expected_tag(int usage, int* alt)
+{
+    *alt = -1;
+    switch (usage) {
+    case 1:     /* PA-ENC-TS-ENC */
+    case 4:     /* TGS-REQ authorization-data */
+    case 5:
+        return 0x30;
+    case 2:     /* EncTicketPart [APPLICATION 3] */
+        return 0x63;
+    case 3:     /* EncASRepPart [APPLICATION 25], Windows sends EncTGSRepPart */
+    case 8:     /* EncTGSRepPart [APPLICATION 26], some KDCs send EncASRepPart */
+    case 9:
+        *alt = (usage == 3) ? 0x7a : 0x79;
+        return (usage == 3) ? 0x79 : 0x7a;
+    case 7:     /* Authenticator [APPLICATION 2] */
+    case 11:
+        return 0x62;
+    case 12:    /* EncAPRepPart [APPLICATION 27] */
+        return 0x7b;
+    case 13:    /* EncKrbPrivPart [APPLICATION 28] */
+        return 0x7c;
+    case 14:    /* EncKrbCredPart [APPLICATION 29] */
+        return 0x7d;
+    default:
         return -1;
     }
+}
 
-    tvb_memcpy(state->gssapi_encrypted_tvb,
-        state->gssapi_payload,
-        0,
-        state->gssapi_payload_len);
-    tvb_memcpy(state->checksum_tvb,
-        state->checksum,
-        0,
-        state->checksum_len);
-
-    iov[0].flags = KRB5_CRYPTO_TYPE_HEADER;
-    iov[0].data.data = state->checksum + k5_headerofs;
-    iov[0].data.length = k5_headerlen;
+/* RFC 4757 maps some usages onto others before deriving K1 */
+static int
+kerberos_rc4_ms_usage(int usage)
+{
+    switch (usage) {
+    case 3:
+    case 9:
+        return 8;
+    case 23:
+        return 13;
+    default:
+        return usage;
+    }
+}
 
-    if (state->gssapi_header_ptr != NULL) {
-        iov[1].flags = KRB5_CRYPTO_TYPE_SIGN_ONLY;
-        iov[1].data.data = (guint8*)(guintptr)state->gssapi_header_ptr;
-        iov[1].data.length = state->gssapi_header_len;
+static kerberos_rc4_keys_t*
+kerberos_rc4_keys_get(const krb5_keyblock* base, int usage)
+{
+    kerberos_rc4_keys_t lookup;
+    kerberos_rc4_keys_t* keys;
+    gcry_md_hd_t hd;
+    guint8 salt[4];
+    guint8 k1[16];
+
+    memset(&lookup, 0, sizeof(lookup));
+    lookup.key.keytype = base->enctype;
+    lookup.key.keylength = base->length;
+    memcpy(lookup.key.keyvalue, base->contents, base->length);
+    lookup.usage = usage;
+    if (kerberos_rc4_keys == NULL) {
+        kerberos_rc4_keys = g_hash_table_new_full(kerberos_rc4_keys_hash,
+            kerberos_rc4_keys_equal, g_free, NULL);
+    }
+    keys = (kerberos_rc4_keys_t*)g_hash_table_lookup(kerberos_rc4_keys, &lookup);
+    if (keys != NULL) {
+        return keys;
+    }
+
+    /* K1 = HMAC-MD5(key, usage) */
+    if (gcry_md_open(&hd, GCRY_MD_MD5, GCRY_MD_FLAG_HMAC)) {
+        return NULL;
     }
-    else {
-        iov[1].flags = KRB5_CRYPTO_TYPE_EMPTY;
+    phtole32(salt, kerberos_rc4_ms_usage(usage));
+    if (gcry_md_setkey(hd, base->contents, base->length)) {
+        gcry_md_close(hd);
+        return NULL;
     }
+    gcry_md_write(hd, salt, sizeof(salt));
+    memcpy(k1, gcry_md_read(hd, 0), sizeof(k1));
+    gcry_md_close(hd);
 
-    iov[2].flags = KRB5_CRYPTO_TYPE_DATA;
-    iov[2].data.data = state->gssapi_payload;
-    iov[2].data.length = state->gssapi_payload_len;
+    if (g_hash_table_size(kerberos_rc4_keys) >= KRB_MAX_RC4_KEYS) {
+        g_hash_table_remove_all(kerberos_rc4_keys);
+    }
+    keys = g_new(kerberos_rc4_keys_t, 1);
+    *keys = lookup;
+    kerberos_md5_pad_state(k1, 0x36, keys->istate);
+    kerberos_md5_pad_state(k1, 0x5c, keys->ostate);
+    g_hash_table_add(kerberos_rc4_keys, keys);
+    return keys;
+}
 
-    if (state->gssapi_trailer_ptr != NULL) {
-        iov[3].flags = KRB5_CRYPTO_TYPE_SIGN_ONLY;
-        iov[3].data.data = (guint8*)(guintptr)state->gssapi_trailer_ptr;
-        iov[3].data.length = state->gssapi_trailer_len;
-    }
-    else {
-        iov[3].flags = KRB5_CRYPTO_TYPE_EMPTY;
-    }
-
-    iov[4].flags = KRB5_CRYPTO_TYPE_DATA;
-    iov[4].data.data = state->checksum;
-    iov[4].data.length = checksum_crypt_len;
-
-    iov[5].flags = KRB5_CRYPTO_TYPE_TRAILER;
-    iov[5].data.data = state->checksum + k5_trailerofs;
-    iov[5].data.length = k5_trailerlen;
-
-    return krb5_c_decrypt_iov(krb5_ctx,
-        key,
-        usage,
-        0,
-        iov,
-        6);
-}
-
-tvbuff_t*
-decrypt_krb5_krb_cfx_dce(proto_tree* tree,
-    packet_info* pinfo,
-    int usage,
-    int keytype,
-    tvbuff_t* gssapi_header_tvb,
-    tvbuff_t* gssapi_encrypted_tvb,
-    tvbuff_t* gssapi_trailer_tvb,
-    tvbuff_t* checksum_tvb)
+/*
+ * The first octet of the RC4 keystream after skip octets, for each of
+ * n <= KRB_RC4_LANES keys; the schedules run interleaved, s[x][lane].
+ */
+static void
+kerberos_rc4_bytes_lanes(const guint8 key[KRB_RC4_LANES][16], guint n, guint skip, guint8* out)
 {
-    struct decrypt_krb5_krb_cfx_dce_state state;
-    kerberos_private_data_t* zero_private = kerberos_new_private_data();
-    tvbuff_t* gssapi_decrypted_tvb = NULL;
-    krb5_error_code ret;
-
-    /* don't do anything if we are not attempting to decrypt data */
-    if (!krb_decrypt) {
-        return NULL;
+    guint8 s[256][KRB_RC4_LANES];
+    guint8 j[KRB_RC4_LANES];
+    guint i, l, step;
+    guint8 t;
+
+    for (i = 0; i < 256; i++) {
+        for (l = 0; l < n; l++) {
+            s[i][l] = (guint8)i;
+        }
     }
-
-    memset(&state, 0, sizeof(state));
-
-    /* make sure we have all the data we need */
-#define __CHECK_TVB_LEN(__tvb) (tvb_captured_length(__tvb) < tvb_reported_length(__tvb))
-    if (gssapi_header_tvb != NULL) {
-        if (__CHECK_TVB_LEN(gssapi_header_tvb)) {
-            return NULL;
+    memset(j, 0, sizeof(j));
+    for (i = 0; i < 256; i++) {
+        for (l = 0; l < n; l++) {
+            j[l] = (guint8)(j[l] + s[i][l] + key[l][i & 15]);
+            t = s[i][l];
+            s[i][l] = s[j[l]][l];
+            s[j[l]][l] = t;
         }
-
-        state.gssapi_header_len = tvb_captured_length(gssapi_header_tvb);
-        state.gssapi_header_ptr = tvb_get_ptr(gssapi_header_tvb,
-            0,
-            state.gssapi_header_len);
     }
-    if (gssapi_encrypted_tvb == NULL || __CHECK_TVB_LEN(gssapi_encrypted_tvb)) {
-        return NULL;
+    memset(j, 0, sizeof(j));
+    i = 0;
+    for (step = 0; step <= skip; step++) {
+        i = (i + 1) & 0xff;
+        for (l = 0; l < n; l++) {
+            j[l] = (guint8)(j[l] + s[i][l]);
+            t = s[i][l];
+            s[i][l] = s[j[l]][l];
+            s[j[l]][l] = t;
+        }
     }
-    state.gssapi_encrypted_tvb = gssapi_encrypted_tvb;
-    state.gssapi_payload_len = tvb_captured_length(gssapi_encrypted_tvb);
-    state.gssapi_payload = (guint8*)wmem_alloc0(pinfo->pool, state.gssapi_payload_len);
-    if (state.gssapi_payload == NULL) {
-        return NULL;
+    for (l = 0; l < n; l++) {
+        out[l] = s[(guint8)(s[i][l] + s[j[l]][l])][l];
     }
-    if (gssapi_trailer_tvb != NULL) {
-        if (__CHECK_TVB_LEN(gssapi_trailer_tvb)) {
-            return NULL;
-        }
+}
 
-        state.gssapi_trailer_len = tvb_captured_length(gssapi_trailer_tvb);
-        state.gssapi_trailer_ptr = tvb_get_ptr(gssapi_trailer_tvb,
-            0,
-            state.gssapi_trailer_len);
-    }
-    if (checksum_tvb == NULL || __CHECK_TVB_LEN(checksum_tvb)) {
-        return NULL;
+/*
+ * For each of the n keys (n <= KRB_RC4_LANES), whether it can decrypt
+ * ciphertext to something starting with tag or alt.
+ */
+static void
+kerberos_rc4_check_lanes(kerberos_rc4_keys_t** keys, guint n,
+    const guint8* ciphertext, int tag, int alt, gboolean* plausible)
+{
+    guint32 state[4][KRB_RC4_LANES];
+    guint32 block[16][KRB_RC4_LANES];
+    guint8 k3[KRB_RC4_LANES][16];
+    guint8 keystream[KRB_RC4_LANES];
+    guint8 first;
+    guint w, l;
+
+    /* inner: HMAC-MD5 of the 16-byte checksum, 64 + 16 octets in all */
+    for (w = 0; w < 16; w++) {
+        guint32 word = (w < 4) ? pletoh32(ciphertext + 4 * w) :
+            (w == 4) ? 0x80 : (w == 14) ? (64 + 16) * 8 : 0;
+
+        for (l = 0; l < n; l++) {
+            block[w][l] = word;
+        }
     }
-    state.checksum_tvb = checksum_tvb;
-    state.checksum_len = tvb_captured_length(checksum_tvb);
-    state.checksum = (guint8*)wmem_alloc0(pinfo->pool, state.checksum_len);
-    if (state.checksum == NULL) {
-        return NULL;
+    for (w = 0; w < 4; w++) {
+        for (l = 0; l < n; l++) {
+            state[w][l] = keys[l]->istate[w];
+        }
     }
+    kerberos_md5_lanes(state, block, n);
 
-    ret = decrypt_krb5_with_cb(tree,
-        pinfo,
-        zero_private,
-        usage,
-        keytype,
-        gssapi_encrypted_tvb,
-        decrypt_krb5_krb_cfx_dce_cb,
-        &state);
-    wmem_free(pinfo->pool, state.checksum);
-    if (ret != 0) {
-        wmem_free(pinfo->pool, state.gssapi_payload);
-        return NULL;
+    /* outer: over the inner digest */
+    for (w = 0; w < 4; w++) {
+        for (l = 0; l < n; l++) {
+            block[w][l] = state[w][l];
+            state[w][l] = keys[l]->ostate[w];
+        }
     }
+    kerberos_md5_lanes(state, block, n);
 
-    gssapi_decrypted_tvb = tvb_new_child_real_data(gssapi_encrypted_tvb,
-        state.gssapi_payload,
-        state.gssapi_payload_len,
-        state.gssapi_payload_len);
-    if (gssapi_decrypted_tvb == NULL) {
-        wmem_free(pinfo->pool, state.gssapi_payload);
-        return NULL;
+    for (l = 0; l < n; l++) {
+        for (w = 0; w < 4; w++) {
+            phtole32(k3[l] + 4 * w, state[w][l]);
+        }
+    }
+    kerberos_rc4_bytes_lanes((const guint8 (*)[16])k3, n, KRB_RC4_CONFOUNDER, keystream);
+    for (l = 0; l < n; l++) {
+        first = ciphertext[KRB_RC4_CHECKSUM + KRB_RC4_CONFOUNDER] ^ keystream[l];
+        plausible[l] = (first == tag || first == alt);
     }
-
-    return gssapi_decrypted_tvb;
 }
-#else /* NOT KRB5_CRYPTO_TYPE_SIGN_ONLY */
-#define NEED_DECRYPT_KRB5_KRB_CFX_DCE_NOOP 1
-#endif /* NOT KRB5_CRYPTO_TYPE_SIGN_ONLY */
-
-#ifdef HAVE_KRB5_PAC_VERIFY
-    /*
-     * macOS up to 10.14.5 only has a MIT shim layer on top
-     * of heimdal. It means that krb5_pac_verify() is not available
-     * in /usr/lib/libkrb5.dylib
-     *
-     * https://opensource.apple.com/tarballs/Heimdal/Heimdal-520.260.1.tar.gz
-     * https://opensource.apple.com/tarballs/MITKerberosShim/MITKerberosShim-71.200.1.tar.gz
-     */
-
-    extern krb5_error_code
-    krb5int_c_mandatory_cksumtype(krb5_context, krb5_enctype, krb5_cksumtype*);
 
-static int
-keytype_for_cksumtype(krb5_cksumtype checksum)
+/* TRUE if key certainly does not decrypt input */
+static gboolean
+kerberos_rc4_reject(const krb5_keyblock* key, int usage, const krb5_data* input)
 {
-#define _ARRAY_SIZE(X) (sizeof(X) / sizeof((X)[0]))
-    static const int keytypes[] = {
-            18,
-            17,
-            23,
-    };
-    guint i;
+    kerberos_rc4_keys_t* keys;
+    gboolean plausible;
+    int tag, alt;
 
-    for (i = 0; i < _ARRAY_SIZE(keytypes); i++) {
-        krb5_cksumtype checksumtype = 0;
-        krb5_error_code ret;
+    if (!krb_rc4_tag_check || key->enctype != ENCTYPE_ARCFOUR_HMAC ||
+        key->length != 16 || input->length < KRB_RC4_CHECKSUM + KRB_RC4_CONFOUNDER + 1) {
+        return FALSE;
+    }
+    tag = kerberos_rc4_expected_tag(usage, &alt);
+    if (tag == -1) {
+        return FALSE;
+    }
+    keys = kerberos_rc4_keys_get(key, usage);
+    if (keys == NULL) {
+        return FALSE;
+    }
+    kerberos_rc4_check_lanes(&keys, 1, (const guint8*)input->data, tag, alt, &plausible);
+    return !plausible;
+}
 
-        ret = krb5int_c_mandatory_cksumtype(krb5_ctx,
-            keytypes[i],
-            &checksumtype);
-        if (ret != 0) {
-            continue;
-        }
-        if (checksum == checksumtype) {
-            return keytypes[i];
-        }
+static void
+kerberos_rc4_keys_cleanup(void)
+{
+    if (kerberos_rc4_keys != NULL) {
+        g_hash_table_destroy(kerberos_rc4_keys);
+        kerberos_rc4_keys = NULL;
     }
+}
 
-    return -1;
+static void
+kerberos_mem_rc4_keys(guint* count, guint64* bytes)
+{
+    *count = kerberos_rc4_keys ? g_hash_table_size(kerberos_rc4_keys) : 0;
+    *bytes = (guint64)*count * (sizeof(kerberos_rc4_keys_t) + BER_MEM_MAP_ENTRY);
 }
 
-struct verify_krb5_pac_state {
-    krb5_pac pac;
-    krb5_cksumtype server_checksum;
-    guint server_count;
-    enc_key_t* server_ek;
-    krb5_cksumtype kdc_checksum;
-    guint kdc_count;
-    enc_key_t* kdc_ek;
+struct decrypt_krb5_with_cb_state {
+    proto_tree* tree;
+    packet_info* pinfo;
+    kerberos_private_data_t* private_data;
+    int usage;
+    int keytype;
+    tvbuff_t* cryptotvb;
+    krb5_error_code(*decrypt_cb_fn)(
+        const krb5_keyblock* key,
+        int usage,
+        void* decrypt_cb_data);
+    void* decrypt_cb_data;
+    guint count;
+    enc_key_t* ek;
 };
 
 static void
-verify_krb5_pac_try_key(gpointer __key _U_, gpointer value, gpointer userdata)
+decrypt_krb5_with_cb_try_key(gpointer __key _U_, gpointer value, gpointer userdata)
 {
-    struct verify_krb5_pac_state* state =
-        (struct verify_krb5_pac_state*)userdata;
+    struct decrypt_krb5_with_cb_state* state =
+        (struct decrypt_krb5_with_cb_state*)userdata;
     enc_key_t* ek = (enc_key_t*)value;
-    krb5_keyblock keyblock;
-    krb5_cksumtype checksumtype = 0;
     krb5_error_code ret;
+    krb5_keytab_entry key;
+#ifdef HAVE_KRB5_C_FX_CF2_SIMPLE
+    enc_key_t* ak = state->private_data->fast_armor_key;
+    enc_key_t* sk = state->private_data->fast_strengthen_key;
+    gboolean try_with_armor_key = FALSE;
+    gboolean try_with_strengthen_key = FALSE;
+#endif
 
-    if (state->server_checksum == 0 && state->kdc_checksum == 0) {
-        /*
-         * nothing more todo, stop traversing.
-         */
-        return;
-    }
-
-    if (state->server_ek != NULL && state->kdc_ek != NULL) {
+    if (state->ek != NULL) {
         /*
          * we're done.
          */
         return;
     }
 
-    ret = krb5int_c_mandatory_cksumtype(krb5_ctx, ek->keytype,
-        &checksumtype);
-    if (ret != 0) {
-        /*
-         * the key is not usable, keep traversing.
-         * try the next key...
-         */
-        return;
-    }
-
-    keyblock.magic = KV5M_KEYBLOCK;
-    keyblock.enctype = ek->keytype;
-    keyblock.length = ek->keylength;
-    keyblock.contents = (guint8*)ek->keyvalue;
-
-    if (checksumtype == state->server_checksum && state->server_ek == NULL) {
-        state->server_count += 1;
-        ret = krb5_pac_verify(krb5_ctx, state->pac, 0, NULL,
-            &keyblock, NULL);
-        if (ret == 0) {
-            state->server_ek = ek;
+#ifdef HAVE_KRB5_C_FX_CF2_SIMPLE
+    if (ak != NULL && ak != ek && ak->keytype == state->keytype && ek->fd_num == -1) {
+        switch (state->usage) {
+        case KEY_USAGE_ENC_CHALLENGE_CLIENT:
+        case KEY_USAGE_ENC_CHALLENGE_KDC:
+            if (ek->fd_num == -1) {
+                /* Challenges are based on a long term key */
+                try_with_armor_key = TRUE;
+            }
+            break;
         }
-    }
 
-    if (checksumtype == state->kdc_checksum && state->kdc_ek == NULL) {
-        state->kdc_count += 1;
-        ret = krb5_pac_verify(krb5_ctx, state->pac, 0, NULL,
-            NULL, &keyblock);
-        if (ret == 0) {
-            state->kdc_ek = ek;
+        /*
+         * If we already have a strengthen_key
+         * we don't need to try with the armor key
+         * again
+         */
+        if (sk != NULL) {
+            try_with_armor_key = FALSE;
         }
     }
-}
 
-static void
-verify_krb5_pac(proto_tree* tree _U_, asn1_ctx_t* actx, tvbuff_t* pactvb)
-{
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-    krb5_error_code ret;
-    krb5_data checksum_data = { 0,0,NULL };
-    int length = tvb_captured_length(pactvb);
-    const guint8* pacbuffer = NULL;
-    struct verify_krb5_pac_state state = {
-            .kdc_checksum = 0,
-    };
-
-    /* don't do anything if we are not attempting to decrypt data */
-    if (!krb_decrypt || length < 1) {
-        return;
+    if (sk != NULL && sk != ek && sk->keytype == state->keytype && sk->keytype == ek->keytype) {
+        switch (state->usage) {
+        case 3:
+            if (ek->fd_num == -1) {
+                /* AS-REP is based on a long term key */
+                try_with_strengthen_key = TRUE;
+            }
+            break;
+        case 8:
+        case 9:
+            if (ek->fd_num != -1) {
+                /* TGS-REP is not based on a long term key */
+                try_with_strengthen_key = TRUE;
+            }
+            break;
+        }
     }
 
-    /* make sure we have all the data we need */
-    if (tvb_captured_length(pactvb) < tvb_reported_length(pactvb)) {
-        return;
-    }
+    if (try_with_armor_key) {
+        krb5_keyblock k1;
+        krb5_keyblock k2;
+        krb5_keyblock* k = NULL;
+        const char* p1 = NULL;
 
-    pacbuffer = tvb_get_ptr(pactvb, 0, length);
+        k1.magic = KV5M_KEYBLOCK;
+        k1.enctype = ak->keytype;
+        k1.length = ak->keylength;
+        k1.contents = (guint8*)ak->keyvalue;
 
-    ret = krb5_pac_parse(krb5_ctx, pacbuffer, length, &state.pac);
-    if (ret != 0) {
-        proto_tree_add_expert_format(tree, actx->pinfo, &ei_kerberos_decrypted_keytype,
-            pactvb, 0, 0,
-            "Failed to parse PAC buffer %d in frame %u",
-            ret, actx->pinfo->fd->num);
-        return;
-    }
+        k2.magic = KV5M_KEYBLOCK;
+        k2.enctype = ek->keytype;
+        k2.length = ek->keylength;
+        k2.contents = (guint8*)ek->keyvalue;
 
-    ret = krb5_pac_get_buffer(krb5_ctx, state.pac, KRB5_PAC_SERVER_CHECKSUM,
-        &checksum_data);
-    if (ret == 0) {
-        state.server_checksum = pletoh32(checksum_data.data);
-        krb5_free_data_contents(krb5_ctx, &checksum_data);
-    };
-    ret = krb5_pac_get_buffer(krb5_ctx, state.pac, KRB5_PAC_PRIVSVR_CHECKSUM,
-        &checksum_data);
-    if (ret == 0) {
-        state.kdc_checksum = pletoh32(checksum_data.data);
-        krb5_free_data_contents(krb5_ctx, &checksum_data);
-    };
+        switch (state->usage) {
+        case KEY_USAGE_ENC_CHALLENGE_CLIENT:
+            p1 = "clientchallengearmor";
+            break;
+        case KEY_USAGE_ENC_CHALLENGE_KDC:
+            p1 = "kdcchallengearmor";
+            break;
+        default:
+            /*
+             * Should never be called!
+             */
+             /*
+              * try the next one...
+              */
+            return;
+        }
 
-    read_keytab_file_from_preferences();
+        ret = krb5_c_fx_cf2_simple(krb5_ctx,
+            &k1, p1,
+            &k2, "challengelongterm",
+            &k);
+        if (ret != 0) {
+            /*
+             * try the next one...
+             */
+            return;
+        }
 
-    wmem_map_foreach(kerberos_longterm_keys,
-        verify_krb5_pac_try_key,
-        &state);
-    if (state.server_ek != NULL) {
-        used_signing_key(tree, actx->pinfo, private_data,
-            state.server_ek, pactvb,
-            state.server_checksum, "Verified Server",
-            "longterm_keys",
-            wmem_map_size(kerberos_longterm_keys),
-            state.server_count);
-    }
-    else {
-        int keytype = keytype_for_cksumtype(state.server_checksum);
-        missing_signing_key(tree, actx->pinfo, private_data,
-            pactvb, state.server_checksum, keytype,
-            "Missing Server",
-            "longterm_keys",
-            wmem_map_size(kerberos_longterm_keys),
-            state.server_count);
-    }
-    if (state.kdc_ek != NULL) {
-        used_signing_key(tree, actx->pinfo, private_data,
-            state.kdc_ek, pactvb,
-            state.kdc_checksum, "Verified KDC",
-            "longterm_keys",
-            wmem_map_size(kerberos_longterm_keys),
-            state.kdc_count);
-    }
-    else {
-        int keytype = keytype_for_cksumtype(state.kdc_checksum);
-        missing_signing_key(tree, actx->pinfo, private_data,
-            pactvb, state.kdc_checksum, keytype,
-            "Missing KDC",
-            "longterm_keys",
-            wmem_map_size(kerberos_longterm_keys),
-            state.kdc_count);
+        state->count += 1;
+        ret = state->decrypt_cb_fn(k,
+            state->usage,
+            state->decrypt_cb_data);
+        if (ret == 0) {
+            add_encryption_key(state->pinfo,
+                state->private_data,
+                state->tree,
+                NULL,
+                state->cryptotvb,
+                k->enctype, k->length,
+                (const char*)k->contents,
+                p1,
+                ak, ek);
+            krb5_free_keyblock(krb5_ctx, k);
+            /*
+             * remember the key and stop traversing
+             */
+            state->ek = state->private_data->last_added_key;
+            return;
+        }
+        krb5_free_keyblock(krb5_ctx, k);
+        /*
+         * don't stop traversing...
+         * try the next one...
+         */
+        return;
     }
 
-    krb5_pac_free(krb5_ctx, state.pac);
-}
-#endif /* HAVE_KRB5_PAC_VERIFY */
-
-#elif defined(HAVE_HEIMDAL_KERBEROS)
-static krb5_context krb5_ctx;
-
-USES_APPLE_DEPRECATED_API
+    if (try_with_strengthen_key) {
+        krb5_keyblock k1;
+        krb5_keyblock k2;
+        krb5_keyblock* k = NULL;
 
-static void
-krb5_fast_key(asn1_ctx_t* actx _U_, proto_tree* tree _U_, tvbuff_t* tvb _U_,
-    enc_key_t* ek1 _U_, const char* p1 _U_,
-    enc_key_t* ek2 _U_, const char* p2 _U_,
-    const char* origin _U_)
-{
-    /* TODO: use krb5_crypto_fx_cf2() from Heimdal */
-}
-void
-read_keytab_file(const char* filename)
-{
-    krb5_keytab keytab;
-    krb5_error_code ret;
-    krb5_keytab_entry key;
-    krb5_kt_cursor cursor;
-    enc_key_t* new_key;
-    static gboolean first_time = TRUE;
+        k1.magic = KV5M_KEYBLOCK;
+        k1.enctype = sk->keytype;
+        k1.length = sk->keylength;
+        k1.contents = (guint8*)sk->keyvalue;
 
-    if (filename == NULL || filename[0] == 0) {
-        return;
-    }
+        k2.magic = KV5M_KEYBLOCK;
+        k2.enctype = ek->keytype;
+        k2.length = ek->keylength;
+        k2.contents = (guint8*)ek->keyvalue;
 
-    if (first_time) {
-        first_time = FALSE;
-        ret = krb5_init_context(&krb5_ctx);
-        if (ret) {
+        ret = krb5_c_fx_cf2_simple(krb5_ctx,
+            &k1, "strengthenkey",
+            &k2, "replykey",
+            &k);
+        if (ret != 0) {
+            /*
+             * try the next one...
+             */
             return;
         }
-    }
-
-    /* should use a file in the wireshark users dir */
-    ret = krb5_kt_resolve(krb5_ctx, filename, &keytab);
-    if (ret) {
-        fprintf(stderr, "KERBEROS ERROR: Could not open keytab file :%s\n", filename);
 
+        state->count += 1;
+        ret = state->decrypt_cb_fn(k,
+            state->usage,
+            state->decrypt_cb_data);
+        if (ret == 0) {
+            add_encryption_key(state->pinfo,
+                state->private_data,
+                state->tree,
+                NULL,
+                state->cryptotvb,
+                k->enctype, k->length,
+                (const char*)k->contents,
+                "strengthen-reply-key",
+                sk, ek);
+            krb5_free_keyblock(krb5_ctx, k);
+            /*
+             * remember the key and stop traversing
+             */
+            state->ek = state->private_data->last_added_key;
+            return;
+        }
+        krb5_free_keyblock(krb5_ctx, k);
+        /*
+         * don't stop traversing...
+         * try the next one...
+         */
         return;
     }
+#endif /* HAVE_KRB5_C_FX_CF2_SIMPLE */
 
-    ret = krb5_kt_start_seq_get(krb5_ctx, keytab, &cursor);
-    if (ret) {
-        fprintf(stderr, "KERBEROS ERROR: Could not read from keytab file :%s\n", filename);
+    /* shortcircuit and bail out if enctypes are not matching */
+    if ((state->keytype != -1) && (ek->keytype != state->keytype)) {
+        /*
+         * don't stop traversing...
+         * try the next one...
+         */
         return;
     }
 
-    do {
-        ret = krb5_kt_next_entry(krb5_ctx, keytab, &key, &cursor);
-        if (ret == 0) {
-            unsigned int i;
-            char* pos;
+    key.key.enctype = ek->keytype;
+    key.key.length = ek->keylength;
+    key.key.contents = ek->keyvalue;
+    state->count += 1;
+    ret = state->decrypt_cb_fn(&(key.key),
+        state->usage,
+        state->decrypt_cb_data);
+    if (ret != 0) {
+        /*
+         * don't stop traversing...
+         * try the next one...
+         */
+        return;
+    }
 
-            new_key = wmem_new0(wmem_epan_scope(), enc_key_t);
-            new_key->fd_num = -1;
-            new_key->id = ++kerberos_longterm_ids;
-            g_snprintf(new_key->id_str, KRB_MAX_ID_STR_LEN, "keytab.%u", new_key->id);
-            new_key->next = enc_key_list;
+    /*
+     * we're done, remember the key
+     */
+    state->ek = ek;
+}
 
-            /* generate origin string, describing where this key came from */
-            pos = new_key->key_origin;
-            pos += MIN(KRB_MAX_ORIG_LEN,
-                g_snprintf(pos, KRB_MAX_ORIG_LEN, "keytab principal "));
-            for (i = 0; i < key.principal->name.name_string.len; i++) {
-                pos += MIN(KRB_MAX_ORIG_LEN - (pos - new_key->key_origin),
-                    g_snprintf(pos, KRB_MAX_ORIG_LEN - (pos - new_key->key_origin), "%s%s", (i ? "/" : ""), key.principal->name.name_string.val[i]));
-            }
-            pos += MIN(KRB_MAX_ORIG_LEN - (pos - new_key->key_origin),
-                g_snprintf(pos, KRB_MAX_ORIG_LEN - (pos - new_key->key_origin), "@%s", key.principal->realm));
-            *pos = 0;
-            new_key->keytype = key.keyblock.keytype;
-            new_key->keylength = (int)key.keyblock.keyvalue.length;
-            memcpy(new_key->keyvalue,
-                key.keyblock.keyvalue.data,
-                MIN((guint)key.keyblock.keyvalue.length, KRB_MAX_KEY_LENGTH));
+struct decrypt_krb5_data_state {
+    krb5_data input;
+    krb5_data output;
+};
 
-            enc_key_list = new_key;
-            ret = krb5_kt_free_entry(krb5_ctx, &key);
-            if (ret) {
-                fprintf(stderr, "KERBEROS ERROR: Could not release the entry: %d", ret);
-                ret = 0; /* try to continue with the next entry */
-            }
-            kerberos_key_map_insert(kerberos_longterm_keys, new_key);
-        }
-    } while (ret == 0);
+static krb5_error_code decrypt_krb5_data_cb(const krb5_keyblock* key, int usage, void* decrypt_cb_data);
 
-    ret = krb5_kt_end_seq_get(krb5_ctx, keytab, &cursor);
-    if (ret) {
-        fprintf(stderr, "KERBEROS ERROR: Could not release the keytab cursor: %d", ret);
-    }
-    ret = krb5_kt_close(krb5_ctx, keytab);
-    if (ret) {
-        fprintf(stderr, "KERBEROS ERROR: Could not close the key table handle: %d", ret);
-    }
+static void
+kerberos_rc4_collect(gpointer key _U_, gpointer value, gpointer user_data)
+{
+    enc_key_t* ek = (enc_key_t*)value;
 
+    if (ek->keytype == ENCTYPE_ARCFOUR_HMAC && ek->keylength == 16) {
+        g_ptr_array_add((GPtrArray*)user_data, ek);
+    }
 }
-USES_APPLE_RST
 
-
-guint8*
-decrypt_krb5_data(proto_tree* tree _U_, packet_info* pinfo,
-    int usage,
-    tvbuff_t* cryptotvb,
-    int keytype,
-    int* datalen)
+/*
+ * Try the RC4 keys of key_map on an arcfour-hmac ciphertext, running the
+ * tag check KRB_RC4_LANES keys at a time and decrypting only the keys
+ * that pass. FALSE if this message is not one for the lanes.
+ */
+static gboolean
+kerberos_rc4_try_keys(wmem_map_t* key_map, struct decrypt_krb5_with_cb_state* state)
 {
-    kerberos_private_data_t* zero_private = kerberos_new_private_data();
-    krb5_error_code ret;
-    krb5_data data;
+    struct decrypt_krb5_data_state* data;
+    kerberos_rc4_keys_t lane[KRB_RC4_LANES];
+    kerberos_rc4_keys_t* lanes[KRB_RC4_LANES];
+    enc_key_t* eks[KRB_RC4_LANES];
+    gboolean plausible[KRB_RC4_LANES];
+    kerberos_rc4_keys_t* keys;
+    GPtrArray* candidates;
+    krb5_keyblock kb;
     enc_key_t* ek;
-    int length = tvb_captured_length(cryptotvb);
-    const guint8* cryptotext = tvb_get_ptr(cryptotvb, 0, length);
+    guint i, n, l;
+    int tag, alt;
 
-    /* don't do anything if we are not attempting to decrypt data */
-    if (!krb_decrypt) {
-        return NULL;
+    if (!krb_rc4_tag_check || state->keytype != ENCTYPE_ARCFOUR_HMAC ||
+        state->decrypt_cb_fn != decrypt_krb5_data_cb ||
+        state->private_data->fast_armor_key != NULL ||
+        state->private_data->fast_strengthen_key != NULL) {
+        return FALSE;
     }
-
-    /* make sure we have all the data we need */
-    if (tvb_captured_length(cryptotvb) < tvb_reported_length(cryptotvb)) {
-        return NULL;
+    tag = kerberos_rc4_expected_tag(state->usage, &alt);
+    data = (struct decrypt_krb5_data_state*)state->decrypt_cb_data;
+    if (tag == -1 || data->input.length < KRB_RC4_CHECKSUM + KRB_RC4_CONFOUNDER + 1) {
+        return FALSE;
     }
 
-    read_keytab_file_from_preferences();
-
-    for (ek = enc_key_list; ek; ek = ek->next) {
-        krb5_keytab_entry key;
-        krb5_crypto crypto;
-        guint8* cryptocopy; /* workaround for pre-0.6.1 heimdal bug */
-
-        /* shortcircuit and bail out if enctypes are not matching */
-        if ((keytype != -1) && (ek->keytype != keytype)) {
-            continue;
+    candidates = g_ptr_array_new();
+    wmem_map_foreach(key_map, kerberos_rc4_collect, candidates);
+    for (i = 0; i < candidates->len && state->ek == NULL; ) {
+        for (n = 0; n < KRB_RC4_LANES && i < candidates->len; i++) {
+            ek = (enc_key_t*)g_ptr_array_index(candidates, i);
+            kb.enctype = ek->keytype;
+            kb.length = ek->keylength;
+            kb.contents = ek->keyvalue;
+            keys = kerberos_rc4_keys_get(&kb, state->usage);
+            if (keys == NULL) {
+                decrypt_krb5_with_cb_try_key(NULL, ek, state);
+                continue;
+            }
+            /* a copy, the table may be flushed while filling the lanes */
+            lane[n] = *keys;
+            lanes[n] = &lane[n];
+            eks[n++] = ek;
         }
-
-        key.keyblock.keytype = ek->keytype;
-        key.keyblock.keyvalue.length = ek->keylength;
-        key.keyblock.keyvalue.data = ek->keyvalue;
-        ret = krb5_crypto_init(krb5_ctx, &(key.keyblock), (krb5_enctype)ENCTYPE_NULL, &crypto);
-        if (ret) {
-            return NULL;
+        if (n == 0) {
+            continue;
         }
-
-        /* pre-0.6.1 versions of Heimdal would sometimes change
-           the cryptotext data even when the decryption failed.
-           This would obviously not work since we iterate over the
-           keys. So just give it a copy of the crypto data instead.
-           This has been seen for RC4-HMAC blobs.
-        */
-        cryptocopy = (guint8*)wmem_memdup(wmem_packet_scope(), cryptotext, length);
-        ret = krb5_decrypt_ivec(krb5_ctx, crypto, usage,
-            cryptocopy, length,
-            &data,
-            NULL);
-        if ((ret == 0) && (length > 0)) {
-            char* user_data;
-
-            used_encryption_key(tree, pinfo, zero_private,
-                ek, usage, cryptotvb,
-                "enc_key_list", 0, 0);
-
-            krb5_crypto_destroy(krb5_ctx, crypto);
-            /* return a private wmem_alloced blob to the caller */
-            user_data = (char*)wmem_memdup(pinfo->pool, data.data, (guint)data.length);
-            if (datalen) {
-                *datalen = (int)data.length;
+        kerberos_rc4_check_lanes(lanes, n, (const guint8*)data->input.data, tag, alt, plausible);
+        for (l = 0; l < n && state->ek == NULL; l++) {
+            if (plausible[l]) {
+                decrypt_krb5_with_cb_try_key(NULL, eks[l], state);
+            } else {
+                state->count += 1;
             }
-            return user_data;
         }
-        krb5_crypto_destroy(krb5_ctx, crypto);
     }
-    return NULL;
+    g_ptr_array_free(candidates, TRUE);
+    return TRUE;
 }
 
-#define NEED_DECRYPT_KRB5_KRB_CFX_DCE_NOOP 1
+static krb5_error_code
+decrypt_krb5_with_cb(proto_tree* tree,
+    packet_info* pinfo,
+    kerberos_private_data_t* private_data,
+    int usage,
+    int keytype,
+    tvbuff_t* cryptotvb,
+    krb5_error_code(*decrypt_cb_fn)(
+        const krb5_keyblock* key,
+        int usage,
+        void* decrypt_cb_data),
+    void* decrypt_cb_data)
+{
+    const char* key_map_name = NULL;
+    wmem_map_t* key_map = NULL;
+    const kerberos_cache_record_t* cached;
+    guint8 cipher_hash[HASH_SHA1_LENGTH] = { 0 };
+    guint profile_depth;
+    struct decrypt_krb5_with_cb_state state = {
+            .tree = tree,
+            .pinfo = pinfo,
+            .private_data = private_data,
+            .usage = usage,
+            .cryptotvb = cryptotvb,
+            .keytype = keytype,
+            .decrypt_cb_fn = decrypt_cb_fn,
+            .decrypt_cb_data = decrypt_cb_data,
+    };
 
-#elif defined (HAVE_LIBNETTLE)
+    read_keytab_file_from_preferences();
 
-#define SERVICE_KEY_SIZE (DES3_KEY_SIZE + 2)
-#define KEYTYPE_DES3_CBC_MD5 5	/* Currently the only one supported */
+    switch (usage) {
+    case KRB5_KU_USAGE_INITIATOR_SEAL:
+    case KRB5_KU_USAGE_ACCEPTOR_SEAL:
+        key_map_name = "app_session_keys";
+        key_map = kerberos_app_session_keys;
+        break;
+    default:
+        key_map_name = "all_keys";
+        key_map = kerberos_all_keys;
+        insert_longterm_keys_into_key_map(key_map);
+        break;
+    }
 
-typedef struct _service_key_t {
-    guint16 kvno;
-    int     keytype;
-    int     length;
-    guint8* contents;
-    char    origin[KRB_MAX_ORIG_LEN + 1];
-} service_key_t;
-GSList* service_key_list = NULL;
+    kerberos_missing_index_open(pinfo, cryptotvb);
+    if (kerberos_missing_key_unchanged(pinfo, private_data, keytype, usage)) {
+        /* Nothing new to try since the last pass */
+        missing_encryption_key(tree, pinfo, private_data,
+            keytype, usage, cryptotvb,
+            key_map_name,
+            wmem_map_size(key_map),
+            0);
+        return -1;
+    }
 
+    kerberos_cache_open(pinfo, cryptotvb);
+    kerberos_cache_cipher_hash(cryptotvb, cipher_hash);
+    cached = kerberos_cache_find(pinfo, usage, cipher_hash);
+    if (cached != NULL && !cached->decrypted && !pinfo->fd->visited) {
+        /* No key ever opened this one when the capture was last read */
+        missing_encryption_key(tree, pinfo, private_data,
+            keytype, usage, cryptotvb,
+            key_map_name,
+            wmem_map_size(key_map),
+            0);
+        kerberos_cache_note(pinfo, usage, cipher_hash, NULL);
+        return -1;
+    }
+    if (cached != NULL && cached->decrypted) {
+        enc_key_t* ek = kerberos_cache_key(key_map, cached);
 
-static void
-add_encryption_key(packet_info* pinfo, int keytype, int keylength, const char* keyvalue, const char* origin)
-{
-    service_key_t* new_key;
+        if (ek != NULL) {
+            decrypt_krb5_with_cb_try_key(NULL, ek, &state);
+        }
+    }
 
-    if (pinfo->fd->visited) {
-        return;
+    if (state.ek == NULL) {
+        profile_depth = BER_PROFILE_ENTER(pinfo, "kerberos.decrypt");
+        if (!kerberos_rc4_try_keys(key_map, &state)) {
+            wmem_map_foreach(key_map, decrypt_krb5_with_cb_try_key, &state);
+        }
+        BER_PROFILE_LEAVE(profile_depth);
+    }
+    if (state.ek != NULL) {
+        kerberos_clear_missing_key(pinfo, private_data, keytype, usage);
+        kerberos_cache_note(pinfo, usage, cipher_hash, state.ek);
+        used_encryption_key(tree, pinfo, private_data,
+            state.ek, usage, cryptotvb,
+            key_map_name,
+            wmem_map_size(key_map),
+            state.count);
+        return 0;
     }
 
-    new_key = g_malloc(sizeof(service_key_t));
-    new_key->kvno = 0;
-    new_key->keytype = keytype;
-    new_key->length = keylength;
-    new_key->contents = g_memdup(keyvalue, keylength);
-    g_snprintf(new_key->origin, KRB_MAX_ORIG_LEN, "%s learnt from frame %u", origin, pinfo->num);
-    service_key_list = g_slist_append(service_key_list, (gpointer)new_key);
+    kerberos_cache_note(pinfo, usage, cipher_hash, NULL);
+    missing_encryption_key(tree, pinfo, private_data,
+        keytype, usage, cryptotvb,
+        key_map_name,
+        wmem_map_size(key_map),
+        state.count);
+    return -1;
 }
 
-static void
-save_encryption_key(tvbuff_t* tvb _U_, int offset _U_, int length _U_,
-    asn1_ctx_t* actx _U_, proto_tree* tree _U_,
-    int parent_hf_index _U_,
-    int hf_index _U_)
+static krb5_error_code
+decrypt_krb5_data_cb(const krb5_keyblock* key,
+    int usage,
+    void* decrypt_cb_data)
 {
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-    const char* parent = proto_registrar_get_name(parent_hf_index);
-    const char* element = proto_registrar_get_name(hf_index);
-    char origin[KRB_MAX_ORIG_LEN] = { 0, };
-
-    g_snprintf(origin, KRB_MAX_ORIG_LEN, "%s_%s", parent, element);
+    struct decrypt_krb5_data_state* state =
+        (struct decrypt_krb5_data_state*)decrypt_cb_data;
+    krb5_enc_data input;
+    krb5_key kkey;
+    krb5_error_code ret;
 
-    add_encryption_key(actx->pinfo,
-        private_data->key.keytype,
-        private_data->key.keylength,
-        private_data->key.keyvalue,
-        origin);
-}
+    if (kerberos_aes_decrypt(key, usage, &state->input, &state->output, &ret)) {
+        return ret;
+    }
+    if (kerberos_rc4_reject(key, usage, &state->input)) {
+        return KRB5KRB_AP_ERR_BAD_INTEGRITY;
+    }
 
-static void
-save_Authenticator_subkey(tvbuff_t* tvb, int offset, int length,
-    asn1_ctx_t* actx, proto_tree* tree,
-    int parent_hf_index,
-    int hf_index)
-{
-    save_encryption_key(tvb, offset, length, actx, tree, parent_hf_index, hf_index);
-}
-
-static void
-save_EncAPRepPart_subkey(tvbuff_t* tvb, int offset, int length,
-    asn1_ctx_t* actx, proto_tree* tree,
-    int parent_hf_index,
-    int hf_index)
-{
-    save_encryption_key(tvb, offset, length, actx, tree, parent_hf_index, hf_index);
-}
-
-static void
-save_EncKDCRepPart_key(tvbuff_t* tvb, int offset, int length,
-    asn1_ctx_t* actx, proto_tree* tree,
-    int parent_hf_index,
-    int hf_index)
-{
-    save_encryption_key(tvb, offset, length, actx, tree, parent_hf_index, hf_index);
-}
-
-static void
-save_EncTicketPart_key(tvbuff_t* tvb, int offset, int length,
-    asn1_ctx_t* actx, proto_tree* tree,
-    int parent_hf_index,
-    int hf_index)
-{
-    save_encryption_key(tvb, offset, length, actx, tree, parent_hf_index, hf_index);
-}
-
-static void
-save_KrbCredInfo_key(tvbuff_t* tvb, int offset, int length,
-    asn1_ctx_t* actx, proto_tree* tree,
-    int parent_hf_index,
-    int hf_index)
-{
-    save_encryption_key(tvb, offset, length, actx, tree, parent_hf_index, hf_index);
-}
-
-static void
-save_KrbFastResponse_strengthen_key(tvbuff_t* tvb _U_, int offset _U_, int length _U_,
-    asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_)
-{
-    save_encryption_key(tvb, offset, length, actx, tree, hf_index);
-}
-
-static void
-clear_keytab(void) {
-    GSList* ske;
-    service_key_t* sk;
-
-    for (ske = service_key_list; ske != NULL; ske = g_slist_next(ske)) {
-        sk = (service_key_t*)ske->data;
-        if (sk) {
-            g_free(sk->contents);
-            g_free(sk);
-        }
-    }
-    g_slist_free(service_key_list);
-    service_key_list = NULL;
-}
-
-static void
-read_keytab_file(const char* service_key_file)
-{
-    FILE* skf;
-    ws_statb64 st;
-    service_key_t* sk;
-    unsigned char buf[SERVICE_KEY_SIZE];
-    int newline_skip = 0, count = 0;
-
-    if (service_key_file != NULL && ws_stat64(service_key_file, &st) == 0) {
-
-        /* The service key file contains raw 192-bit (24 byte) 3DES keys.
-         * There can be zero, one (\n), or two (\r\n) characters between
-         * keys.  Trailing characters are ignored.
-         */
-
-         /* XXX We should support the standard keytab format instead */
-        if (st.st_size > SERVICE_KEY_SIZE) {
-            if ((st.st_size % (SERVICE_KEY_SIZE + 1) == 0) ||
-                (st.st_size % (SERVICE_KEY_SIZE + 1) == SERVICE_KEY_SIZE)) {
-                newline_skip = 1;
-            }
-            else if ((st.st_size % (SERVICE_KEY_SIZE + 2) == 0) ||
-                (st.st_size % (SERVICE_KEY_SIZE + 2) == SERVICE_KEY_SIZE)) {
-                newline_skip = 2;
-            }
-        }
-
-        skf = ws_fopen(service_key_file, "rb");
-        if (!skf) return;
+    memset(&input, 0, sizeof(input));
+    input.enctype = key->enctype;
+    input.ciphertext = state->input;
 
-        while (fread(buf, SERVICE_KEY_SIZE, 1, skf) == 1) {
-            sk = g_malloc(sizeof(service_key_t));
-            sk->kvno = buf[0] << 8 | buf[1];
-            sk->keytype = KEYTYPE_DES3_CBC_MD5;
-            sk->length = DES3_KEY_SIZE;
-            sk->contents = g_memdup(buf + 2, DES3_KEY_SIZE);
-            g_snprintf(sk->origin, KRB_MAX_ORIG_LEN, "3DES service key file, key #%d, offset %ld", count, ftell(skf));
-            service_key_list = g_slist_append(service_key_list, (gpointer)sk);
-            if (fseek(skf, newline_skip, SEEK_CUR) < 0) {
-                fprintf(stderr, "unable to seek...\n");
-                return;
-            }
-            count++;
-        }
-        fclose(skf);
+    kkey = kerberos_key_schedule(key);
+    if (kkey != NULL) {
+        return krb5_k_decrypt(krb5_ctx,
+            kkey,
+            usage,
+            0,
+            &input,
+            &state->output);
     }
+    return krb5_c_decrypt(krb5_ctx,
+        key,
+        usage,
+        0,
+        &input,
+        &state->output);
 }
 
-#define CONFOUNDER_PLUS_CHECKSUM 24
-
-guint8*
-decrypt_krb5_data(proto_tree* tree, packet_info* pinfo,
-    int _U_ usage,
-    tvbuff_t* cryptotvb,
-    int keytype,
+static guint8*
+decrypt_krb5_data_private(proto_tree* tree _U_, packet_info* pinfo,
+    kerberos_private_data_t* private_data,
+    int usage, tvbuff_t* cryptotvb, int keytype,
     int* datalen)
 {
-    tvbuff_t* encr_tvb;
-    guint8* decrypted_data = NULL, * plaintext = NULL;
-    guint8 cls;
-    gboolean pc;
-    guint32 tag, item_len, data_len;
-    int id_offset, offset;
-    guint8 key[DES3_KEY_SIZE];
-    guint8 initial_vector[DES_BLOCK_SIZE];
-    gcry_md_hd_t md5_handle;
-    guint8* digest;
-    guint8 zero_fill[] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
-    guint8 confounder[8];
-    gboolean ind;
-    GSList* ske;
-    service_key_t* sk;
-    struct des3_ctx ctx;
+#define HAVE_DECRYPT_KRB5_DATA_PRIVATE 1
+    struct decrypt_krb5_data_state state;
+    krb5_error_code ret;
     int length = tvb_captured_length(cryptotvb);
     const guint8* cryptotext = tvb_get_ptr(cryptotvb, 0, length);
 
-
     /* don't do anything if we are not attempting to decrypt data */
-    if (!krb_decrypt) {
+    if (!krb_decrypt || length < 1) {
         return NULL;
     }
 
@@ -2771,100 +3877,967 @@ decrypt_krb5_data(proto_tree* tree, packet_info* pinfo,
         return NULL;
     }
 
-    if (keytype != KEYTYPE_DES3_CBC_MD5 || service_key_list == NULL) {
+    memset(&state, 0, sizeof(state));
+    state.input.length = length;
+    state.input.data = (guint8*)cryptotext;
+    state.output.data = (char*)wmem_alloc(pinfo->pool, length);
+    state.output.length = length;
+
+    ret = decrypt_krb5_with_cb(tree,
+        pinfo,
+        private_data,
+        usage,
+        keytype,
+        cryptotvb,
+        decrypt_krb5_data_cb,
+        &state);
+    if (ret != 0) {
         return NULL;
     }
 
-    decrypted_data = wmem_alloc(wmem_packet_scope(), length);
-    for (ske = service_key_list; ske != NULL; ske = g_slist_next(ske)) {
-        gboolean do_continue = FALSE;
-        gboolean digest_ok;
-        sk = (service_key_t*)ske->data;
-
-        des_fix_parity(DES3_KEY_SIZE, key, sk->contents);
-
-        memset(initial_vector, 0, DES_BLOCK_SIZE);
-        des3_set_key(&ctx, key);
-        cbc_decrypt(&ctx, des3_decrypt, DES_BLOCK_SIZE, initial_vector,
-            length, decrypted_data, cryptotext);
-        encr_tvb = tvb_new_real_data(decrypted_data, length, length);
-
-        tvb_memcpy(encr_tvb, confounder, 0, 8);
-
-        /* We have to pull the decrypted data length from the decrypted
-         * content.  If the key doesn't match or we otherwise get garbage,
-         * an exception may get thrown while decoding the ASN.1 header.
-         * Catch it, just in case.
-         */
-        TRY{
-                id_offset = get_ber_identifier(encr_tvb, CONFOUNDER_PLUS_CHECKSUM, &cls, &pc, &tag);
-                offset = get_ber_length(encr_tvb, id_offset, &item_len, &ind);
-        }
-            CATCH_BOUNDS_ERRORS{
-                    tvb_free(encr_tvb);
-                    do_continue = TRUE;
-        }
-        ENDTRY;
-
-        if (do_continue) continue;
-
-        data_len = item_len + offset - CONFOUNDER_PLUS_CHECKSUM;
-        if ((int)item_len + offset > length) {
-            tvb_free(encr_tvb);
-            continue;
-        }
-
-        if (gcry_md_open(&md5_handle, GCRY_MD_MD5, 0)) {
-            return NULL;
-        }
-        gcry_md_write(md5_handle, confounder, 8);
-        gcry_md_write(md5_handle, zero_fill, 16);
-        gcry_md_write(md5_handle, decrypted_data + CONFOUNDER_PLUS_CHECKSUM, data_len);
-        digest = gcry_md_read(md5_handle, 0);
-
-        digest_ok = (tvb_memeql(encr_tvb, 8, digest, HASH_MD5_LENGTH) == 0);
-        gcry_md_close(md5_handle);
-        if (digest_ok) {
-            plaintext = (guint8*)tvb_memdup(pinfo->pool, encr_tvb, CONFOUNDER_PLUS_CHECKSUM, data_len);
-            tvb_free(encr_tvb);
-
-            if (datalen) {
-                *datalen = data_len;
-            }
-            return(plaintext);
-        }
-        tvb_free(encr_tvb);
+    if (datalen) {
+        *datalen = state.output.length;
     }
-
-    return NULL;
+    return (guint8*)state.output.data;
 }
 
-#endif	/* HAVE_MIT_KERBEROS / HAVE_HEIMDAL_KERBEROS / HAVE_LIBNETTLE */
-
-#ifdef NEED_DECRYPT_KRB5_KRB_CFX_DCE_NOOP
-tvbuff_t*
-decrypt_krb5_krb_cfx_dce(proto_tree* tree _U_,
-    packet_info* pinfo _U_,
-    int usage _U_,
-    int keytype _U_,
-    tvbuff_t* gssapi_header_tvb _U_,
-    tvbuff_t* gssapi_encrypted_tvb _U_,
-    tvbuff_t* gssapi_trailer_tvb _U_,
-    tvbuff_t* checksum_tvb _U_)
+guint8*
+decrypt_krb5_data(proto_tree* tree _U_, packet_info* pinfo,
+    int usage,
+    tvbuff_t* cryptotvb,
+    int keytype,
+    int* datalen)
 {
-    return NULL;
+    kerberos_private_data_t* zero_private = kerberos_new_private_data();
+    return decrypt_krb5_data_private(tree, pinfo, zero_private,
+        usage, cryptotvb, keytype,
+        datalen);
 }
-#endif /* NEED_DECRYPT_KRB5_KRB_CFX_DCE_NOOP */
-
-#define	INET6_ADDRLEN	16
 
-/* TCP Record Mark */
-#define	KRB_RM_RESERVED	0x80000000U
-#define	KRB_RM_RECLEN	0x7fffffffU
+USES_APPLE_RST
 
-#define KRB5_MSG_TICKET			1	/* Ticket */
-#define KRB5_MSG_AUTHENTICATOR		2	/* Authenticator */
-#define KRB5_MSG_ENC_TICKET_PART	3	/* EncTicketPart */
+#ifdef KRB5_CRYPTO_TYPE_SIGN_ONLY
+struct decrypt_krb5_krb_cfx_dce_state {
+    const guint8* gssapi_header_ptr;
+    guint gssapi_header_len;
+    tvbuff_t* gssapi_encrypted_tvb;
+    guint8* gssapi_payload;
+    guint gssapi_payload_len;
+    const guint8* gssapi_trailer_ptr;
+    guint gssapi_trailer_len;
+    tvbuff_t* checksum_tvb;
+    guint8* checksum;
+    guint checksum_len;
+};
+
+static krb5_error_code
+decrypt_krb5_krb_cfx_dce_cb(const krb5_keyblock* key,
+    int usage,
+    void* decrypt_cb_data)
+{
+    struct decrypt_krb5_krb_cfx_dce_state* state =
+        (struct decrypt_krb5_krb_cfx_dce_state*)decrypt_cb_data;
+    unsigned int k5_headerlen = 0;
+    unsigned int k5_headerofs = 0;
+    unsigned int k5_trailerlen = 0;
+    unsigned int k5_trailerofs = 0;
+    size_t _k5_blocksize = 0;
+    guint k5_blocksize;
+    krb5_crypto_iov iov[6];
+    krb5_key kkey;
+    krb5_error_code ret;
+    guint checksum_remain = state->checksum_len;
+    guint checksum_crypt_len;
+
+    memset(iov, 0, sizeof(iov));
+
+    ret = krb5_c_crypto_length(krb5_ctx,
+        key->enctype,
+        KRB5_CRYPTO_TYPE_HEADER,
+        &k5_headerlen);
+    if (ret != 0) {
+        return ret;
+    }
+    if (checksum_remain < k5_headerlen) {
+        return -1;
+    }
+    checksum_remain -= k5_headerlen;
+    k5_headerofs = checksum_remain;
+    ret = krb5_c_crypto_length(krb5_ctx,
+        key->enctype,
+        KRB5_CRYPTO_TYPE_TRAILER,
+        &k5_trailerlen);
+    if (ret != 0) {
+        return ret;
+    }
+    if (checksum_remain < k5_trailerlen) {
+        return -1;
+    }
+    checksum_remain -= k5_trailerlen;
+    k5_trailerofs = checksum_remain;
+    checksum_crypt_len = checksum_remain;
+
+    ret = krb5_c_block_size(krb5_ctx,
+        key->enctype,
+        &_k5_blocksize);
+    if (ret != 0) {
+        return ret;
+    }
+    /*
+     * The cast is required for the Windows build in order
+     * to avoid the following warning.
+     *
+     * warning C4267: '-=': conversion from 'size_t' to 'guint',
+     * possible loss of data
+     */
+    k5_blocksize = (guint)_k5_blocksize;
+    if (checksum_remain < k5_blocksize) {
+        return -1;
+    }
+    checksum_remain -= k5_blocksize;
+    if (checksum_remain < 16) {
+        return -1;
+    }
+
+    tvb_memcpy(state->gssapi_encrypted_tvb,
+        state->gssapi_payload,
+        0,
+        state->gssapi_payload_len);
+    tvb_memcpy(state->checksum_tvb,
+        state->checksum,
+        0,
+        state->checksum_len);
+
+    iov[0].flags = KRB5_CRYPTO_TYPE_HEADER;
+    iov[0].data.data = state->checksum + k5_headerofs;
+    iov[0].data.length = k5_headerlen;
+
+    if (state->gssapi_header_ptr != NULL) {
+        iov[1].flags = KRB5_CRYPTO_TYPE_SIGN_ONLY;
+        iov[1].data.data = (guint8*)(guintptr)state->gssapi_header_ptr;
+        iov[1].data.length = state->gssapi_header_len;
+    }
+    else {
+        iov[1].flags = KRB5_CRYPTO_TYPE_EMPTY;
+    }
+
+    iov[2].flags = KRB5_CRYPTO_TYPE_DATA;
+    iov[2].data.data = state->gssapi_payload;
+    iov[2].data.length = state->gssapi_payload_len;
+
+    if (state->gssapi_trailer_ptr != NULL) {
+        iov[3].flags = KRB5_CRYPTO_TYPE_SIGN_ONLY;
+        iov[3].data.data = (guint8*)(guintptr)state->gssapi_trailer_ptr;
+        iov[3].data.length = state->gssapi_trailer_len;
+    }
+    else {
+        iov[3].flags = KRB5_CRYPTO_TYPE_EMPTY;
+    }
+
+    iov[4].flags = KRB5_CRYPTO_TYPE_DATA;
+    iov[4].data.data = state->checksum;
+    iov[4].data.length = checksum_crypt_len;
+
+    iov[5].flags = KRB5_CRYPTO_TYPE_TRAILER;
+    iov[5].data.data = state->checksum + k5_trailerofs;
+    iov[5].data.length = k5_trailerlen;
+
+    kkey = kerberos_key_schedule(key);
+    if (kkey != NULL) {
+        return krb5_k_decrypt_iov(krb5_ctx,
+            kkey,
+            usage,
+            0,
+            iov,
+            6);
+    }
+    return krb5_c_decrypt_iov(krb5_ctx,
+        key,
+        usage,
+        0,
+        iov,
+        6);
+}
+
+tvbuff_t*
+decrypt_krb5_krb_cfx_dce(proto_tree* tree,
+    packet_info* pinfo,
+    int usage,
+    int keytype,
+    tvbuff_t* gssapi_header_tvb,
+    tvbuff_t* gssapi_encrypted_tvb,
+    tvbuff_t* gssapi_trailer_tvb,
+    tvbuff_t* checksum_tvb)
+{
+    struct decrypt_krb5_krb_cfx_dce_state state;
+    kerberos_private_data_t* zero_private = kerberos_new_private_data();
+    tvbuff_t* gssapi_decrypted_tvb = NULL;
+    krb5_error_code ret;
+
+    /* don't do anything if we are not attempting to decrypt data */
+    if (!krb_decrypt) {
+        return NULL;
+    }
+
+    memset(&state, 0, sizeof(state));
+
+    /* make sure we have all the data we need */
+#define __CHECK_TVB_LEN(__tvb) (tvb_captured_length(__tvb) < tvb_reported_length(__tvb))
+    if (gssapi_header_tvb != NULL) {
+        if (__CHECK_TVB_LEN(gssapi_header_tvb)) {
+            return NULL;
+        }
+
+        state.gssapi_header_len = tvb_captured_length(gssapi_header_tvb);
+        state.gssapi_header_ptr = tvb_get_ptr(gssapi_header_tvb,
+            0,
+            state.gssapi_header_len);
+    }
+    if (gssapi_encrypted_tvb == NULL || __CHECK_TVB_LEN(gssapi_encrypted_tvb)) {
+        return NULL;
+    }
+    state.gssapi_encrypted_tvb = gssapi_encrypted_tvb;
+    state.gssapi_payload_len = tvb_captured_length(gssapi_encrypted_tvb);
+    state.gssapi_payload = (guint8*)wmem_alloc0(pinfo->pool, state.gssapi_payload_len);
+    if (state.gssapi_payload == NULL) {
+        return NULL;
+    }
+    if (gssapi_trailer_tvb != NULL) {
+        if (__CHECK_TVB_LEN(gssapi_trailer_tvb)) {
+            return NULL;
+        }
+
+        state.gssapi_trailer_len = tvb_captured_length(gssapi_trailer_tvb);
+        state.gssapi_trailer_ptr = tvb_get_ptr(gssapi_trailer_tvb,
+            0,
+            state.gssapi_trailer_len);
+    }
+    if (checksum_tvb == NULL || __CHECK_TVB_LEN(checksum_tvb)) {
+        return NULL;
+    }
+    state.checksum_tvb = checksum_tvb;
+    state.checksum_len = tvb_captured_length(checksum_tvb);
+    state.checksum = (guint8*)wmem_alloc0(pinfo->pool, state.checksum_len);
+    if (state.checksum == NULL) {
+        return NULL;
+    }
+
+    ret = decrypt_krb5_with_cb(tree,
+        pinfo,
+        zero_private,
+        usage,
+        keytype,
+        gssapi_encrypted_tvb,
+        decrypt_krb5_krb_cfx_dce_cb,
+        &state);
+    wmem_free(pinfo->pool, state.checksum);
+    if (ret != 0) {
+        wmem_free(pinfo->pool, state.gssapi_payload);
+        return NULL;
+    }
+
+    gssapi_decrypted_tvb = tvb_new_child_real_data(gssapi_encrypted_tvb,
+        state.gssapi_payload,
+        state.gssapi_payload_len,
+        state.gssapi_payload_len);
+    if (gssapi_decrypted_tvb == NULL) {
+        wmem_free(pinfo->pool, state.gssapi_payload);
+        return NULL;
+    }
+    zero_private->last_decryption_usage = usage;
+    kerberos_export_decrypted(pinfo, zero_private, gssapi_decrypted_tvb);
+
+    return gssapi_decrypted_tvb;
+}
+#else /* NOT KRB5_CRYPTO_TYPE_SIGN_ONLY */
+#define NEED_DECRYPT_KRB5_KRB_CFX_DCE_NOOP 1
+#endif /* NOT KRB5_CRYPTO_TYPE_SIGN_ONLY */
+
+#ifdef HAVE_KRB5_PAC_VERIFY
+    /*
+     * macOS up to 10.14.5 only has a MIT shim layer on top
+     * of heimdal. It means that krb5_pac_verify() is not available
+     * in /usr/lib/libkrb5.dylib
+     *
+     * https://opensource.apple.com/tarballs/Heimdal/Heimdal-520.260.1.tar.gz
+     * https://opensource.apple.com/tarballs/MITKerberosShim/MITKerberosShim-71.200.1.tar.gz
+     */
+
+    extern krb5_error_code
+    krb5int_c_mandatory_cksumtype(krb5_context, krb5_enctype, krb5_cksumtype*);
+
+static int
+keytype_for_cksumtype(krb5_cksumtype checksum)
+{
+#define _ARRAY_SIZE(X) (sizeof(X) / sizeof((X)[0]))
+    static const int keytypes[] = {
+            18,
+            17,
+            23,
+    };
+    guint i;
+
+    for (i = 0; i < _ARRAY_SIZE(keytypes); i++) {
+        krb5_cksumtype checksumtype = 0;
+        krb5_error_code ret;
+
+        ret = krb5int_c_mandatory_cksumtype(krb5_ctx,
+            keytypes[i],
+            &checksumtype);
+        if (ret != 0) {
+            continue;
+        }
+        if (checksum == checksumtype) {
+            return keytypes[i];
+        }
+    }
+
+    return -1;
+}
+
+struct verify_krb5_pac_state {
+    krb5_pac pac;
+    krb5_cksumtype server_checksum;
+    guint server_count;
+    enc_key_t* server_ek;
+    krb5_cksumtype kdc_checksum;
+    guint kdc_count;
+    enc_key_t* kdc_ek;
+};
+
+static void
+verify_krb5_pac_try_key(gpointer __key _U_, gpointer value, gpointer userdata)
+{
+    struct verify_krb5_pac_state* state =
+        (struct verify_krb5_pac_state*)userdata;
+    enc_key_t* ek = (enc_key_t*)value;
+    krb5_keyblock keyblock;
+    krb5_cksumtype checksumtype = 0;
+    krb5_error_code ret;
+
+    if (state->server_checksum == 0 && state->kdc_checksum == 0) {
+        /*
+         * nothing more todo, stop traversing.
+         */
+        return;
+    }
+
+    if (state->server_ek != NULL && state->kdc_ek != NULL) {
+        /*
+         * we're done.
+         */
+        return;
+    }
+
+    ret = krb5int_c_mandatory_cksumtype(krb5_ctx, ek->keytype,
+        &checksumtype);
+    if (ret != 0) {
+        /*
+         * the key is not usable, keep traversing.
+         * try the next key...
+         */
+        return;
+    }
+
+    keyblock.magic = KV5M_KEYBLOCK;
+    keyblock.enctype = ek->keytype;
+    keyblock.length = ek->keylength;
+    keyblock.contents = (guint8*)ek->keyvalue;
+
+    if (checksumtype == state->server_checksum && state->server_ek == NULL) {
+        state->server_count += 1;
+        ret = krb5_pac_verify(krb5_ctx, state->pac, 0, NULL,
+            &keyblock, NULL);
+        if (ret == 0) {
+            state->server_ek = ek;
+        }
+    }
+
+    if (checksumtype == state->kdc_checksum && state->kdc_ek == NULL) {
+        state->kdc_count += 1;
+        ret = krb5_pac_verify(krb5_ctx, state->pac, 0, NULL,
+            NULL, &keyblock);
+        if (ret == 0) {
+            state->kdc_ek = ek;
+        }
+    }
+}
+
+static void
+verify_krb5_pac(proto_tree* tree _U_, asn1_ctx_t* actx, tvbuff_t* pactvb)
+{
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    krb5_error_code ret;
+    krb5_data checksum_data = { 0,0,NULL };
+    int length = tvb_captured_length(pactvb);
+    const guint8* pacbuffer = NULL;
+    struct verify_krb5_pac_state state = {
+            .kdc_checksum = 0,
+    };
+
+    /* don't do anything if we are not attempting to decrypt data */
+    if (!krb_decrypt || length < 1) {
+        return;
+    }
+
+    /* make sure we have all the data we need */
+    if (tvb_captured_length(pactvb) < tvb_reported_length(pactvb)) {
+        return;
+    }
+
+    pacbuffer = tvb_get_ptr(pactvb, 0, length);
+
+    ret = krb5_pac_parse(krb5_ctx, pacbuffer, length, &state.pac);
+    if (ret != 0) {
+        proto_tree_add_expert_format(tree, actx->pinfo, &ei_kerberos_decrypted_keytype,
+            pactvb, 0, 0,
+            "Failed to parse PAC buffer %d in frame %u",
+            ret, actx->pinfo->fd->num);
+        return;
+    }
+
+    ret = krb5_pac_get_buffer(krb5_ctx, state.pac, KRB5_PAC_SERVER_CHECKSUM,
+        &checksum_data);
+    if (ret == 0) {
+        state.server_checksum = pletoh32(checksum_data.data);
+        krb5_free_data_contents(krb5_ctx, &checksum_data);
+    };
+    ret = krb5_pac_get_buffer(krb5_ctx, state.pac, KRB5_PAC_PRIVSVR_CHECKSUM,
+        &checksum_data);
+    if (ret == 0) {
+        state.kdc_checksum = pletoh32(checksum_data.data);
+        krb5_free_data_contents(krb5_ctx, &checksum_data);
+    };
+
+    read_keytab_file_from_preferences();
+
+    wmem_map_foreach(kerberos_longterm_keys,
+        verify_krb5_pac_try_key,
+        &state);
+    if (state.server_ek != NULL) {
+        used_signing_key(tree, actx->pinfo, private_data,
+            state.server_ek, pactvb,
+            state.server_checksum, "Verified Server",
+            "longterm_keys",
+            wmem_map_size(kerberos_longterm_keys),
+            state.server_count);
+    }
+    else {
+        int keytype = keytype_for_cksumtype(state.server_checksum);
+        missing_signing_key(tree, actx->pinfo, private_data,
+            pactvb, state.server_checksum, keytype,
+            "Missing Server",
+            "longterm_keys",
+            wmem_map_size(kerberos_longterm_keys),
+            state.server_count);
+    }
+    if (state.kdc_ek != NULL) {
+        used_signing_key(tree, actx->pinfo, private_data,
+            state.kdc_ek, pactvb,
+            state.kdc_checksum, "Verified KDC",
+            "longterm_keys",
+            wmem_map_size(kerberos_longterm_keys),
+            state.kdc_count);
+    }
+    else {
+        int keytype = keytype_for_cksumtype(state.kdc_checksum);
+        missing_signing_key(tree, actx->pinfo, private_data,
+            pactvb, state.kdc_checksum, keytype,
+            "Missing KDC",
+            "longterm_keys",
+            wmem_map_size(kerberos_longterm_keys),
+            state.kdc_count);
+    }
+
+    krb5_pac_free(krb5_ctx, state.pac);
+}
+#endif /* HAVE_KRB5_PAC_VERIFY */
+
+#elif defined(HAVE_HEIMDAL_KERBEROS)
+static krb5_context krb5_ctx;
+
+USES_APPLE_DEPRECATED_API
+
+static void
+krb5_fast_key(asn1_ctx_t* actx _U_, proto_tree* tree _U_, tvbuff_t* tvb _U_,
+    enc_key_t* ek1 _U_, const char* p1 _U_,
+    enc_key_t* ek2 _U_, const char* p2 _U_,
+    const char* origin _U_)
+{
+    /* TODO: use krb5_crypto_fx_cf2() from Heimdal */
+}
+void
+read_keytab_file(const char* filename)
+{
+    krb5_keytab keytab;
+    krb5_error_code ret;
+    krb5_keytab_entry key;
+    krb5_kt_cursor cursor;
+    enc_key_t* new_key;
+    static gboolean first_time = TRUE;
+
+    if (filename == NULL || filename[0] == 0) {
+        return;
+    }
+
+    if (first_time) {
+        first_time = FALSE;
+        ret = krb5_init_context(&krb5_ctx);
+        if (ret) {
+            return;
+        }
+    }
+
+    /* should use a file in the wireshark users dir */
+    ret = krb5_kt_resolve(krb5_ctx, filename, &keytab);
+    if (ret) {
+        fprintf(stderr, "KERBEROS ERROR: Could not open keytab file :%s\n", filename);
+
+        return;
+    }
+
+    ret = krb5_kt_start_seq_get(krb5_ctx, keytab, &cursor);
+    if (ret) {
+        fprintf(stderr, "KERBEROS ERROR: Could not read from keytab file :%s\n", filename);
+        return;
+    }
+
+    do {
+        ret = krb5_kt_next_entry(krb5_ctx, keytab, &key, &cursor);
+        if (ret == 0) {
+            unsigned int i;
+            char* pos;
+
+            new_key = wmem_new0(wmem_epan_scope(), enc_key_t);
+            new_key->fd_num = -1;
+            new_key->id = ++kerberos_longterm_ids;
+            g_snprintf(new_key->id_str, KRB_MAX_ID_STR_LEN, "keytab.%u", new_key->id);
+            new_key->next = enc_key_list;
+
+            /* generate origin string, describing where this key came from */
+            pos = new_key->key_origin;
+            pos += MIN(KRB_MAX_ORIG_LEN,
+                g_snprintf(pos, KRB_MAX_ORIG_LEN, "keytab principal "));
+            for (i = 0; i < key.principal->name.name_string.len; i++) {
+                pos += MIN(KRB_MAX_ORIG_LEN - (pos - new_key->key_origin),
+                    g_snprintf(pos, KRB_MAX_ORIG_LEN - (pos - new_key->key_origin), "%s%s", (i ? "/" : ""), key.principal->name.name_string.val[i]));
+            }
+            pos += MIN(KRB_MAX_ORIG_LEN - (pos - new_key->key_origin),
+                g_snprintf(pos, KRB_MAX_ORIG_LEN - (pos - new_key->key_origin), "@%s", key.principal->realm));
+            *pos = 0;
+            new_key->keytype = key.keyblock.keytype;
+            new_key->keylength = (int)key.keyblock.keyvalue.length;
+            memcpy(new_key->keyvalue,
+                key.keyblock.keyvalue.data,
+                MIN((guint)key.keyblock.keyvalue.length, KRB_MAX_KEY_LENGTH));
+
+            enc_key_list = new_key;
+            enc_key_list_len++;
+            ret = krb5_kt_free_entry(krb5_ctx, &key);
+            if (ret) {
+                fprintf(stderr, "KERBEROS ERROR: Could not release the entry: %d", ret);
+                ret = 0; /* try to continue with the next entry */
+            }
+            kerberos_key_map_insert(kerberos_longterm_keys, new_key);
+            kerberos_bump_key_generation(new_key->keytype, NULL);
+        }
+    } while (ret == 0);
+
+    ret = krb5_kt_end_seq_get(krb5_ctx, keytab, &cursor);
+    if (ret) {
+        fprintf(stderr, "KERBEROS ERROR: Could not release the keytab cursor: %d", ret);
+    }
+    ret = krb5_kt_close(krb5_ctx, keytab);
+    if (ret) {
+        fprintf(stderr, "KERBEROS ERROR: Could not close the key table handle: %d", ret);
+    }
+
+}
+USES_APPLE_RST
+
+
+guint8*
+decrypt_krb5_data(proto_tree* tree _U_, packet_info* pinfo,
+    int usage,
+    tvbuff_t* cryptotvb,
+    int keytype,
+    int* datalen)
+{
+    kerberos_private_data_t* zero_private = kerberos_new_private_data();
+    krb5_error_code ret;
+    krb5_data data;
+    enc_key_t* ek;
+    int length = tvb_captured_length(cryptotvb);
+    const guint8* cryptotext = tvb_get_ptr(cryptotvb, 0, length);
+
+    /* don't do anything if we are not attempting to decrypt data */
+    if (!krb_decrypt) {
+        return NULL;
+    }
+
+    /* make sure we have all the data we need */
+    if (tvb_captured_length(cryptotvb) < tvb_reported_length(cryptotvb)) {
+        return NULL;
+    }
+
+    read_keytab_file_from_preferences();
+
+    for (ek = enc_key_list; ek; ek = ek->next) {
+        krb5_keytab_entry key;
+        krb5_crypto crypto;
+        guint8* cryptocopy; /* workaround for pre-0.6.1 heimdal bug */
+
+        /* shortcircuit and bail out if enctypes are not matching */
+        if ((keytype != -1) && (ek->keytype != keytype)) {
+            continue;
+        }
+
+        key.keyblock.keytype = ek->keytype;
+        key.keyblock.keyvalue.length = ek->keylength;
+        key.keyblock.keyvalue.data = ek->keyvalue;
+        ret = krb5_crypto_init(krb5_ctx, &(key.keyblock), (krb5_enctype)ENCTYPE_NULL, &crypto);
+        if (ret) {
+            return NULL;
+        }
+
+        /* pre-0.6.1 versions of Heimdal would sometimes change
+           the cryptotext data even when the decryption failed.
+           This would obviously not work since we iterate over the
+           keys. So just give it a copy of the crypto data instead.
+           This has been seen for RC4-HMAC blobs.
+        */
+        cryptocopy = (guint8*)wmem_memdup(wmem_packet_scope(), cryptotext, length);
+        ret = krb5_decrypt_ivec(krb5_ctx, crypto, usage,
+            cryptocopy, length,
+            &data,
+            NULL);
+        if ((ret == 0) && (length > 0)) {
+            char* user_data;
+
+            used_encryption_key(tree, pinfo, zero_private,
+                ek, usage, cryptotvb,
+                "enc_key_list", 0, 0);
+
+            krb5_crypto_destroy(krb5_ctx, crypto);
+            /* return a private wmem_alloced blob to the caller */
+            user_data = (char*)wmem_memdup(pinfo->pool, data.data, (guint)data.length);
+            if (datalen) {
+                *datalen = (int)data.length;
+            }
+            return user_data;
+        }
+        krb5_crypto_destroy(krb5_ctx, crypto);
+    }
+    return NULL;
+}
+
+#define NEED_DECRYPT_KRB5_KRB_CFX_DCE_NOOP 1
+
+#elif defined (HAVE_LIBNETTLE)
+
+#define SERVICE_KEY_SIZE (DES3_KEY_SIZE + 2)
+#define KEYTYPE_DES3_CBC_MD5 5	/* Currently the only one supported */
+
+typedef struct _service_key_t {
+    guint16 kvno;
+    int     keytype;
+    int     length;
+    guint8* contents;
+    char    origin[KRB_MAX_ORIG_LEN + 1];
+} service_key_t;
+GSList* service_key_list = NULL;
+
+
+static void
+add_encryption_key(packet_info* pinfo, int keytype, int keylength, const char* keyvalue, const char* origin)
+{
+    service_key_t* new_key;
+
+    if (pinfo->fd->visited) {
+        return;
+    }
+
+    new_key = g_malloc(sizeof(service_key_t));
+    new_key->kvno = 0;
+    new_key->keytype = keytype;
+    new_key->length = keylength;
+    new_key->contents = g_memdup(keyvalue, keylength);
+    g_snprintf(new_key->origin, KRB_MAX_ORIG_LEN, "%s learnt from frame %u", origin, pinfo->num);
+    service_key_list = g_slist_append(service_key_list, (gpointer)new_key);
+}
+
+static void
+save_encryption_key(tvbuff_t* tvb _U_, int offset _U_, int length _U_,
+    asn1_ctx_t* actx _U_, proto_tree* tree _U_,
+    int parent_hf_index _U_,
+    int hf_index _U_)
+{
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    const char* parent = proto_registrar_get_name(parent_hf_index);
+    const char* element = proto_registrar_get_name(hf_index);
+    char origin[KRB_MAX_ORIG_LEN] = { 0, };
+
+    g_snprintf(origin, KRB_MAX_ORIG_LEN, "%s_%s", parent, element);
+
+    add_encryption_key(actx->pinfo,
+        private_data->key.keytype,
+        private_data->key.keylength,
+        private_data->key.keyvalue,
+        origin);
+}
+
+static void
+save_Authenticator_subkey(tvbuff_t* tvb, int offset, int length,
+    asn1_ctx_t* actx, proto_tree* tree,
+    int parent_hf_index,
+    int hf_index)
+{
+    save_encryption_key(tvb, offset, length, actx, tree, parent_hf_index, hf_index);
+}
+
+static void
+save_EncAPRepPart_subkey(tvbuff_t* tvb, int offset, int length,
+    asn1_ctx_t* actx, proto_tree* tree,
+    int parent_hf_index,
+    int hf_index)
+{
+    save_encryption_key(tvb, offset, length, actx, tree, parent_hf_index, hf_index);
+}
+
+static void
+save_EncKDCRepPart_key(tvbuff_t* tvb, int offset, int length,
+    asn1_ctx_t* actx, proto_tree* tree,
+    int parent_hf_index,
+    int hf_index)
+{
+    save_encryption_key(tvb, offset, length, actx, tree, parent_hf_index, hf_index);
+}
+
+static void
+save_EncTicketPart_key(tvbuff_t* tvb, int offset, int length,
+    asn1_ctx_t* actx, proto_tree* tree,
+    int parent_hf_index,
+    int hf_index)
+{
+    save_encryption_key(tvb, offset, length, actx, tree, parent_hf_index, hf_index);
+}
+
+static void
+save_KrbCredInfo_key(tvbuff_t* tvb, int offset, int length,
+    asn1_ctx_t* actx, proto_tree* tree,
+    int parent_hf_index,
+    int hf_index)
+{
+    save_encryption_key(tvb, offset, length, actx, tree, parent_hf_index, hf_index);
+}
+
+static void
+save_ReplyKeyPack_replyKey(tvbuff_t* tvb, int offset, int length,
+    asn1_ctx_t* actx, proto_tree* tree,
+    int parent_hf_index,
+    int hf_index)
+{
+    save_encryption_key(tvb, offset, length, actx, tree, parent_hf_index, hf_index);
+}
+
+static void
+save_KrbFastResponse_strengthen_key(tvbuff_t* tvb _U_, int offset _U_, int length _U_,
+    asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_)
+{
+    save_encryption_key(tvb, offset, length, actx, tree, hf_index);
+}
+
+static void
+clear_keytab(void) {
+    GSList* ske;
+    service_key_t* sk;
+
+    for (ske = service_key_list; ske != NULL; ske = g_slist_next(ske)) {
+        sk = (service_key_t*)ske->data;
+        if (sk) {
+            g_free(sk->contents);
+            g_free(sk);
+        }
+    }
+    g_slist_free(service_key_list);
+    service_key_list = NULL;
+}
+
+static void
+read_keytab_file(const char* service_key_file)
+{
+    FILE* skf;
+    ws_statb64 st;
+    service_key_t* sk;
+    unsigned char buf[SERVICE_KEY_SIZE];
+    int newline_skip = 0, count = 0;
+
+    if (service_key_file != NULL && ws_stat64(service_key_file, &st) == 0) {
+
+        /* The service key file contains raw 192-bit (24 byte) 3DES keys.
+         * There can be zero, one (\n), or two (\r\n) characters between
+         * keys.  Trailing characters are ignored.
+         */
+
+         /* XXX We should support the standard keytab format instead */
+        if (st.st_size > SERVICE_KEY_SIZE) {
+            if ((st.st_size % (SERVICE_KEY_SIZE + 1) == 0) ||
+                (st.st_size % (SERVICE_KEY_SIZE + 1) == SERVICE_KEY_SIZE)) {
+                newline_skip = 1;
+            }
+            else if ((st.st_size % (SERVICE_KEY_SIZE + 2) == 0) ||
+                (st.st_size % (SERVICE_KEY_SIZE + 2) == SERVICE_KEY_SIZE)) {
+                newline_skip = 2;
+            }
+        }
+
+        skf = ws_fopen(service_key_file, "rb");
+        if (!skf) return;
+
+        while (fread(buf, SERVICE_KEY_SIZE, 1, skf) == 1) {
+            sk = g_malloc(sizeof(service_key_t));
+            sk->kvno = buf[0] << 8 | buf[1];
+            sk->keytype = KEYTYPE_DES3_CBC_MD5;
+            sk->length = DES3_KEY_SIZE;
+            sk->contents = g_memdup(buf + 2, DES3_KEY_SIZE);
+            g_snprintf(sk->origin, KRB_MAX_ORIG_LEN, "3DES service key file, key #%d, offset %ld", count, ftell(skf));
+            service_key_list = g_slist_append(service_key_list, (gpointer)sk);
+            if (fseek(skf, newline_skip, SEEK_CUR) < 0) {
+                fprintf(stderr, "unable to seek...\n");
+                return;
+            }
+            count++;
+        }
+        fclose(skf);
+    }
+}
+
+#define CONFOUNDER_PLUS_CHECKSUM 24
+
+guint8*
+decrypt_krb5_data(proto_tree* tree, packet_info* pinfo,
+    int _U_ usage,
+    tvbuff_t* cryptotvb,
+    int keytype,
+    int* datalen)
+{
+    tvbuff_t* encr_tvb;
+    guint8* decrypted_data = NULL, * plaintext = NULL;
+    guint8 cls;
+    gboolean pc;
+    guint32 tag, item_len, data_len;
+    int id_offset, offset;
+    guint8 key[DES3_KEY_SIZE];
+    guint8 initial_vector[DES_BLOCK_SIZE];
+    gcry_md_hd_t md5_handle;
+    guint8* digest;
+    guint8 zero_fill[] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    guint8 confounder[8];
+    gboolean ind;
+    GSList* ske;
+    service_key_t* sk;
+    struct des3_ctx ctx;
+    int length = tvb_captured_length(cryptotvb);
+    const guint8* cryptotext = tvb_get_ptr(cryptotvb, 0, length);
+
+
+    /* don't do anything if we are not attempting to decrypt data */
+    if (!krb_decrypt) {
+        return NULL;
+    }
+
+    /* make sure we have all the data we need */
+    if (tvb_captured_length(cryptotvb) < tvb_reported_length(cryptotvb)) {
+        return NULL;
+    }
+
+    if (keytype != KEYTYPE_DES3_CBC_MD5 || service_key_list == NULL) {
+        return NULL;
+    }
+
+    decrypted_data = wmem_alloc(wmem_packet_scope(), length);
+    for (ske = service_key_list; ske != NULL; ske = g_slist_next(ske)) {
+        gboolean digest_ok;
+        sk = (service_key_t*)ske->data;
+
+        des_fix_parity(DES3_KEY_SIZE, key, sk->contents);
+
+        memset(initial_vector, 0, DES_BLOCK_SIZE);
+        des3_set_key(&ctx, key);
+        cbc_decrypt(&ctx, des3_decrypt, DES_BLOCK_SIZE, initial_vector,
+            length, decrypted_data, cryptotext);
+        encr_tvb = tvb_new_real_data(decrypted_data, length, length);
+
+        tvb_memcpy(encr_tvb, confounder, 0, 8);
+
+        /* We have to pull the decrypted data length from the decrypted
+         * content.  If the key doesn't match we get garbage, which is the
+         * usual case here, so decode the ASN.1 header without throwing.
+         */
+        id_offset = try_get_ber_identifier(encr_tvb, CONFOUNDER_PLUS_CHECKSUM, &cls, &pc, &tag);
+        offset = try_get_ber_length(encr_tvb, id_offset, &item_len, &ind);
+        if (offset < 0) {
+            tvb_free(encr_tvb);
+            continue;
+        }
+
+        data_len = item_len + offset - CONFOUNDER_PLUS_CHECKSUM;
+        if ((int)item_len + offset > length) {
+            tvb_free(encr_tvb);
+            continue;
+        }
+
+        if (gcry_md_open(&md5_handle, GCRY_MD_MD5, 0)) {
+            return NULL;
+        }
+        gcry_md_write(md5_handle, confounder, 8);
+        gcry_md_write(md5_handle, zero_fill, 16);
+        gcry_md_write(md5_handle, decrypted_data + CONFOUNDER_PLUS_CHECKSUM, data_len);
+        digest = gcry_md_read(md5_handle, 0);
+
+        digest_ok = (tvb_memeql(encr_tvb, 8, digest, HASH_MD5_LENGTH) == 0);
+        gcry_md_close(md5_handle);
+        if (digest_ok) {
+            plaintext = (guint8*)tvb_memdup(pinfo->pool, encr_tvb, CONFOUNDER_PLUS_CHECKSUM, data_len);
+            tvb_free(encr_tvb);
+
+            if (datalen) {
+                *datalen = data_len;
+            }
+            return(plaintext);
+        }
+        tvb_free(encr_tvb);
+    }
+
+    return NULL;
+}
+
+#endif	/* HAVE_MIT_KERBEROS / HAVE_HEIMDAL_KERBEROS / HAVE_LIBNETTLE */
+
+#ifdef NEED_DECRYPT_KRB5_KRB_CFX_DCE_NOOP
+tvbuff_t*
+decrypt_krb5_krb_cfx_dce(proto_tree* tree _U_,
+    packet_info* pinfo _U_,
+    int usage _U_,
+    int keytype _U_,
+    tvbuff_t* gssapi_header_tvb _U_,
+    tvbuff_t* gssapi_encrypted_tvb _U_,
+    tvbuff_t* gssapi_trailer_tvb _U_,
+    tvbuff_t* checksum_tvb _U_)
+{
+    return NULL;
+}
+#endif /* NEED_DECRYPT_KRB5_KRB_CFX_DCE_NOOP */
+
+#define	INET6_ADDRLEN	16
+
+/* TCP Record Mark */
+#define	KRB_RM_RESERVED	0x80000000U
+#define	KRB_RM_RECLEN	0x7fffffffU
+
+#define KRB5_MSG_TICKET			1	/* Ticket */
+#define KRB5_MSG_AUTHENTICATOR		2	/* Authenticator */
+#define KRB5_MSG_ENC_TICKET_PART	3	/* EncTicketPart */
 #define KRB5_MSG_AS_REQ			10	/* AS-REQ type */
 #define KRB5_MSG_AS_REP			11	/* AS-REP type */
 #define KRB5_MSG_TGS_REQ		12	/* TGS-REQ type */
@@ -2872,1378 +4845,2923 @@ decrypt_krb5_krb_cfx_dce(proto_tree* tree _U_,
 #define KRB5_MSG_AP_REQ			14	/* AP-REQ type */
 #define KRB5_MSG_AP_REP			15	/* AP-REP type */
 
-#define KRB5_MSG_SAFE			20	/* KRB-SAFE type */
-#define KRB5_MSG_PRIV			21	/* KRB-PRIV type */
-#define KRB5_MSG_CRED			22	/* KRB-CRED type */
-#define KRB5_MSG_ENC_AS_REP_PART	25	/* EncASRepPart */
-#define KRB5_MSG_ENC_TGS_REP_PART	26	/* EncTGSRepPart */
-#define KRB5_MSG_ENC_AP_REP_PART	27	/* EncAPRepPart */
-#define KRB5_MSG_ENC_KRB_PRIV_PART	28	/* EncKrbPrivPart */
-#define KRB5_MSG_ENC_KRB_CRED_PART	29	/* EncKrbCredPart */
-#define KRB5_MSG_ERROR			30	/* KRB-ERROR type */
+#define KRB5_MSG_SAFE			20	/* KRB-SAFE type */
+#define KRB5_MSG_PRIV			21	/* KRB-PRIV type */
+#define KRB5_MSG_CRED			22	/* KRB-CRED type */
+#define KRB5_MSG_ENC_AS_REP_PART	25	/* EncASRepPart */
+#define KRB5_MSG_ENC_TGS_REP_PART	26	/* EncTGSRepPart */
+#define KRB5_MSG_ENC_AP_REP_PART	27	/* EncAPRepPart */
+#define KRB5_MSG_ENC_KRB_PRIV_PART	28	/* EncKrbPrivPart */
+#define KRB5_MSG_ENC_KRB_CRED_PART	29	/* EncKrbCredPart */
+#define KRB5_MSG_ERROR			30	/* KRB-ERROR type */
+
+#define KRB5_CHKSUM_GSSAPI		0x8003
+/*
+ * For KERB_ENCTYPE_RC4_HMAC and KERB_ENCTYPE_RC4_HMAC_EXP, see
+ *
+ *	https://tools.ietf.org/html/draft-brezak-win2k-krb-rc4-hmac-04
+ *
+ * unless it's expired.
+ */
+
+ /* Principal name-type */
+#define KRB5_NT_UNKNOWN		0
+#define KRB5_NT_PRINCIPAL	1
+#define KRB5_NT_SRV_INST	2
+#define KRB5_NT_SRV_HST		3
+#define KRB5_NT_SRV_XHST	4
+#define KRB5_NT_UID		5
+#define KRB5_NT_X500_PRINCIPAL	6
+#define KRB5_NT_SMTP_NAME	7
+#define KRB5_NT_ENTERPRISE	10
+
+/*
+ * MS specific name types, from
+ *
+ *	http://msdn.microsoft.com/library/en-us/security/security/kerb_external_name.asp
+ */
+#define KRB5_NT_MS_PRINCIPAL		-128
+#define KRB5_NT_MS_PRINCIPAL_AND_SID	-129
+#define KRB5_NT_ENT_PRINCIPAL_AND_SID	-130
+#define KRB5_NT_PRINCIPAL_AND_SID 	-131
+#define KRB5_NT_SRV_INST_AND_SID	-132
+
+ /* error table constants */
+ /* I prefixed the krb5_err.et constant names with KRB5_ET_ for these */
+#define KRB5_ET_KRB5KDC_ERR_NONE			0
+#define KRB5_ET_KRB5KDC_ERR_NAME_EXP			1
+#define KRB5_ET_KRB5KDC_ERR_SERVICE_EXP			2
+#define KRB5_ET_KRB5KDC_ERR_BAD_PVNO			3
+#define KRB5_ET_KRB5KDC_ERR_C_OLD_MAST_KVNO		4
+#define KRB5_ET_KRB5KDC_ERR_S_OLD_MAST_KVNO		5
+#define KRB5_ET_KRB5KDC_ERR_C_PRINCIPAL_UNKNOWN		6
+#define KRB5_ET_KRB5KDC_ERR_S_PRINCIPAL_UNKNOWN		7
+#define KRB5_ET_KRB5KDC_ERR_PRINCIPAL_NOT_UNIQUE	8
+#define KRB5_ET_KRB5KDC_ERR_NULL_KEY			9
+#define KRB5_ET_KRB5KDC_ERR_CANNOT_POSTDATE		10
+#define KRB5_ET_KRB5KDC_ERR_NEVER_VALID			11
+#define KRB5_ET_KRB5KDC_ERR_POLICY			12
+#define KRB5_ET_KRB5KDC_ERR_BADOPTION			13
+#define KRB5_ET_KRB5KDC_ERR_ETYPE_NOSUPP		14
+#define KRB5_ET_KRB5KDC_ERR_SUMTYPE_NOSUPP		15
+#define KRB5_ET_KRB5KDC_ERR_PADATA_TYPE_NOSUPP		16
+#define KRB5_ET_KRB5KDC_ERR_TRTYPE_NOSUPP		17
+#define KRB5_ET_KRB5KDC_ERR_CLIENT_REVOKED		18
+#define KRB5_ET_KRB5KDC_ERR_SERVICE_REVOKED		19
+#define KRB5_ET_KRB5KDC_ERR_TGT_REVOKED			20
+#define KRB5_ET_KRB5KDC_ERR_CLIENT_NOTYET		21
+#define KRB5_ET_KRB5KDC_ERR_SERVICE_NOTYET		22
+#define KRB5_ET_KRB5KDC_ERR_KEY_EXP			23
+#define KRB5_ET_KRB5KDC_ERR_PREAUTH_FAILED		24
+#define KRB5_ET_KRB5KDC_ERR_PREAUTH_REQUIRED		25
+#define KRB5_ET_KRB5KDC_ERR_SERVER_NOMATCH		26
+#define KRB5_ET_KRB5KDC_ERR_MUST_USE_USER2USER		27
+#define KRB5_ET_KRB5KDC_ERR_PATH_NOT_ACCEPTED		28
+#define KRB5_ET_KRB5KDC_ERR_SVC_UNAVAILABLE		29
+#define KRB5_ET_KRB5KRB_AP_ERR_BAD_INTEGRITY		31
+#define KRB5_ET_KRB5KRB_AP_ERR_TKT_EXPIRED		32
+#define KRB5_ET_KRB5KRB_AP_ERR_TKT_NYV			33
+#define KRB5_ET_KRB5KRB_AP_ERR_REPEAT			34
+#define KRB5_ET_KRB5KRB_AP_ERR_NOT_US			35
+#define KRB5_ET_KRB5KRB_AP_ERR_BADMATCH			36
+#define KRB5_ET_KRB5KRB_AP_ERR_SKEW			37
+#define KRB5_ET_KRB5KRB_AP_ERR_BADADDR			38
+#define KRB5_ET_KRB5KRB_AP_ERR_BADVERSION		39
+#define KRB5_ET_KRB5KRB_AP_ERR_MSG_TYPE			40
+#define KRB5_ET_KRB5KRB_AP_ERR_MODIFIED			41
+#define KRB5_ET_KRB5KRB_AP_ERR_BADORDER			42
+#define KRB5_ET_KRB5KRB_AP_ERR_ILL_CR_TKT		43
+#define KRB5_ET_KRB5KRB_AP_ERR_BADKEYVER		44
+#define KRB5_ET_KRB5KRB_AP_ERR_NOKEY			45
+#define KRB5_ET_KRB5KRB_AP_ERR_MUT_FAIL			46
+#define KRB5_ET_KRB5KRB_AP_ERR_BADDIRECTION		47
+#define KRB5_ET_KRB5KRB_AP_ERR_METHOD			48
+#define KRB5_ET_KRB5KRB_AP_ERR_BADSEQ			49
+#define KRB5_ET_KRB5KRB_AP_ERR_INAPP_CKSUM		50
+#define KRB5_ET_KRB5KDC_AP_PATH_NOT_ACCEPTED		51
+#define KRB5_ET_KRB5KRB_ERR_RESPONSE_TOO_BIG		52
+#define KRB5_ET_KRB5KRB_ERR_GENERIC			60
+#define KRB5_ET_KRB5KRB_ERR_FIELD_TOOLONG		61
+#define KRB5_ET_KDC_ERROR_CLIENT_NOT_TRUSTED		62
+#define KRB5_ET_KDC_ERROR_KDC_NOT_TRUSTED		63
+#define KRB5_ET_KDC_ERROR_INVALID_SIG			64
+#define KRB5_ET_KDC_ERR_KEY_TOO_WEAK			65
+#define KRB5_ET_KDC_ERR_CERTIFICATE_MISMATCH		66
+#define KRB5_ET_KRB_AP_ERR_NO_TGT			67
+#define KRB5_ET_KDC_ERR_WRONG_REALM			68
+#define KRB5_ET_KRB_AP_ERR_USER_TO_USER_REQUIRED	69
+#define KRB5_ET_KDC_ERR_CANT_VERIFY_CERTIFICATE		70
+#define KRB5_ET_KDC_ERR_INVALID_CERTIFICATE		71
+#define KRB5_ET_KDC_ERR_REVOKED_CERTIFICATE		72
+#define KRB5_ET_KDC_ERR_REVOCATION_STATUS_UNKNOWN	73
+#define KRB5_ET_KDC_ERR_REVOCATION_STATUS_UNAVAILABLE	74
+#define KRB5_ET_KDC_ERR_CLIENT_NAME_MISMATCH		75
+#define KRB5_ET_KDC_ERR_KDC_NAME_MISMATCH		76
+#define KRB5_ET_KDC_ERR_PREAUTH_EXPIRED			90
+#define KRB5_ET_KDC_ERR_MORE_PREAUTH_DATA_REQUIRED	91
+#define KRB5_ET_KDC_ERR_PREAUTH_BAD_AUTHENTICATION_SET	92
+#define KRB5_ET_KDC_ERR_UNKNOWN_CRITICAL_FAST_OPTIONS	93
+
+static const value_string krb5_error_codes[] = {
+        { KRB5_ET_KRB5KDC_ERR_NONE, "KRB5KDC_ERR_NONE" },
+        { KRB5_ET_KRB5KDC_ERR_NAME_EXP, "KRB5KDC_ERR_NAME_EXP" },
+        { KRB5_ET_KRB5KDC_ERR_SERVICE_EXP, "KRB5KDC_ERR_SERVICE_EXP" },
+        { KRB5_ET_KRB5KDC_ERR_BAD_PVNO, "KRB5KDC_ERR_BAD_PVNO" },
+        { KRB5_ET_KRB5KDC_ERR_C_OLD_MAST_KVNO, "KRB5KDC_ERR_C_OLD_MAST_KVNO" },
+        { KRB5_ET_KRB5KDC_ERR_S_OLD_MAST_KVNO, "KRB5KDC_ERR_S_OLD_MAST_KVNO" },
+        { KRB5_ET_KRB5KDC_ERR_C_PRINCIPAL_UNKNOWN, "KRB5KDC_ERR_C_PRINCIPAL_UNKNOWN" },
+        { KRB5_ET_KRB5KDC_ERR_S_PRINCIPAL_UNKNOWN, "KRB5KDC_ERR_S_PRINCIPAL_UNKNOWN" },
+        { KRB5_ET_KRB5KDC_ERR_PRINCIPAL_NOT_UNIQUE, "KRB5KDC_ERR_PRINCIPAL_NOT_UNIQUE" },
+        { KRB5_ET_KRB5KDC_ERR_NULL_KEY, "KRB5KDC_ERR_NULL_KEY" },
+        { KRB5_ET_KRB5KDC_ERR_CANNOT_POSTDATE, "KRB5KDC_ERR_CANNOT_POSTDATE" },
+        { KRB5_ET_KRB5KDC_ERR_NEVER_VALID, "KRB5KDC_ERR_NEVER_VALID" },
+        { KRB5_ET_KRB5KDC_ERR_POLICY, "KRB5KDC_ERR_POLICY" },
+        { KRB5_ET_KRB5KDC_ERR_BADOPTION, "KRB5KDC_ERR_BADOPTION" },
+        { KRB5_ET_KRB5KDC_ERR_ETYPE_NOSUPP, "KRB5KDC_ERR_ETYPE_NOSUPP" },
+        { KRB5_ET_KRB5KDC_ERR_SUMTYPE_NOSUPP, "KRB5KDC_ERR_SUMTYPE_NOSUPP" },
+        { KRB5_ET_KRB5KDC_ERR_PADATA_TYPE_NOSUPP, "KRB5KDC_ERR_PADATA_TYPE_NOSUPP" },
+        { KRB5_ET_KRB5KDC_ERR_TRTYPE_NOSUPP, "KRB5KDC_ERR_TRTYPE_NOSUPP" },
+        { KRB5_ET_KRB5KDC_ERR_CLIENT_REVOKED, "KRB5KDC_ERR_CLIENT_REVOKED" },
+        { KRB5_ET_KRB5KDC_ERR_SERVICE_REVOKED, "KRB5KDC_ERR_SERVICE_REVOKED" },
+        { KRB5_ET_KRB5KDC_ERR_TGT_REVOKED, "KRB5KDC_ERR_TGT_REVOKED" },
+        { KRB5_ET_KRB5KDC_ERR_CLIENT_NOTYET, "KRB5KDC_ERR_CLIENT_NOTYET" },
+        { KRB5_ET_KRB5KDC_ERR_SERVICE_NOTYET, "KRB5KDC_ERR_SERVICE_NOTYET" },
+        { KRB5_ET_KRB5KDC_ERR_KEY_EXP, "KRB5KDC_ERR_KEY_EXP" },
+        { KRB5_ET_KRB5KDC_ERR_PREAUTH_FAILED, "KRB5KDC_ERR_PREAUTH_FAILED" },
+        { KRB5_ET_KRB5KDC_ERR_PREAUTH_REQUIRED, "KRB5KDC_ERR_PREAUTH_REQUIRED" },
+        { KRB5_ET_KRB5KDC_ERR_SERVER_NOMATCH, "KRB5KDC_ERR_SERVER_NOMATCH" },
+        { KRB5_ET_KRB5KDC_ERR_MUST_USE_USER2USER, "KRB5KDC_ERR_MUST_USE_USER2USER" },
+        { KRB5_ET_KRB5KDC_ERR_PATH_NOT_ACCEPTED, "KRB5KDC_ERR_PATH_NOT_ACCEPTED" },
+        { KRB5_ET_KRB5KDC_ERR_SVC_UNAVAILABLE, "KRB5KDC_ERR_SVC_UNAVAILABLE" },
+        { KRB5_ET_KRB5KRB_AP_ERR_BAD_INTEGRITY, "KRB5KRB_AP_ERR_BAD_INTEGRITY" },
+        { KRB5_ET_KRB5KRB_AP_ERR_TKT_EXPIRED, "KRB5KRB_AP_ERR_TKT_EXPIRED" },
+        { KRB5_ET_KRB5KRB_AP_ERR_TKT_NYV, "KRB5KRB_AP_ERR_TKT_NYV" },
+        { KRB5_ET_KRB5KRB_AP_ERR_REPEAT, "KRB5KRB_AP_ERR_REPEAT" },
+        { KRB5_ET_KRB5KRB_AP_ERR_NOT_US, "KRB5KRB_AP_ERR_NOT_US" },
+        { KRB5_ET_KRB5KRB_AP_ERR_BADMATCH, "KRB5KRB_AP_ERR_BADMATCH" },
+        { KRB5_ET_KRB5KRB_AP_ERR_SKEW, "KRB5KRB_AP_ERR_SKEW" },
+        { KRB5_ET_KRB5KRB_AP_ERR_BADADDR, "KRB5KRB_AP_ERR_BADADDR" },
+        { KRB5_ET_KRB5KRB_AP_ERR_BADVERSION, "KRB5KRB_AP_ERR_BADVERSION" },
+        { KRB5_ET_KRB5KRB_AP_ERR_MSG_TYPE, "KRB5KRB_AP_ERR_MSG_TYPE" },
+        { KRB5_ET_KRB5KRB_AP_ERR_MODIFIED, "KRB5KRB_AP_ERR_MODIFIED" },
+        { KRB5_ET_KRB5KRB_AP_ERR_BADORDER, "KRB5KRB_AP_ERR_BADORDER" },
+        { KRB5_ET_KRB5KRB_AP_ERR_ILL_CR_TKT, "KRB5KRB_AP_ERR_ILL_CR_TKT" },
+        { KRB5_ET_KRB5KRB_AP_ERR_BADKEYVER, "KRB5KRB_AP_ERR_BADKEYVER" },
+        { KRB5_ET_KRB5KRB_AP_ERR_NOKEY, "KRB5KRB_AP_ERR_NOKEY" },
+        { KRB5_ET_KRB5KRB_AP_ERR_MUT_FAIL, "KRB5KRB_AP_ERR_MUT_FAIL" },
+        { KRB5_ET_KRB5KRB_AP_ERR_BADDIRECTION, "KRB5KRB_AP_ERR_BADDIRECTION" },
+        { KRB5_ET_KRB5KRB_AP_ERR_METHOD, "KRB5KRB_AP_ERR_METHOD" },
+        { KRB5_ET_KRB5KRB_AP_ERR_BADSEQ, "KRB5KRB_AP_ERR_BADSEQ" },
+        { KRB5_ET_KRB5KRB_AP_ERR_INAPP_CKSUM, "KRB5KRB_AP_ERR_INAPP_CKSUM" },
+        { KRB5_ET_KRB5KDC_AP_PATH_NOT_ACCEPTED, "KRB5KDC_AP_PATH_NOT_ACCEPTED" },
+        { KRB5_ET_KRB5KRB_ERR_RESPONSE_TOO_BIG, "KRB5KRB_ERR_RESPONSE_TOO_BIG"},
+        { KRB5_ET_KRB5KRB_ERR_GENERIC, "KRB5KRB_ERR_GENERIC" },
+        { KRB5_ET_KRB5KRB_ERR_FIELD_TOOLONG, "KRB5KRB_ERR_FIELD_TOOLONG" },
+        { KRB5_ET_KDC_ERROR_CLIENT_NOT_TRUSTED, "KDC_ERROR_CLIENT_NOT_TRUSTED" },
+        { KRB5_ET_KDC_ERROR_KDC_NOT_TRUSTED, "KDC_ERROR_KDC_NOT_TRUSTED" },
+        { KRB5_ET_KDC_ERROR_INVALID_SIG, "KDC_ERROR_INVALID_SIG" },
+        { KRB5_ET_KDC_ERR_KEY_TOO_WEAK, "KDC_ERR_KEY_TOO_WEAK" },
+        { KRB5_ET_KDC_ERR_CERTIFICATE_MISMATCH, "KDC_ERR_CERTIFICATE_MISMATCH" },
+        { KRB5_ET_KRB_AP_ERR_NO_TGT, "KRB_AP_ERR_NO_TGT" },
+        { KRB5_ET_KDC_ERR_WRONG_REALM, "KDC_ERR_WRONG_REALM" },
+        { KRB5_ET_KRB_AP_ERR_USER_TO_USER_REQUIRED, "KRB_AP_ERR_USER_TO_USER_REQUIRED" },
+        { KRB5_ET_KDC_ERR_CANT_VERIFY_CERTIFICATE, "KDC_ERR_CANT_VERIFY_CERTIFICATE" },
+        { KRB5_ET_KDC_ERR_INVALID_CERTIFICATE, "KDC_ERR_INVALID_CERTIFICATE" },
+        { KRB5_ET_KDC_ERR_REVOKED_CERTIFICATE, "KDC_ERR_REVOKED_CERTIFICATE" },
+        { KRB5_ET_KDC_ERR_REVOCATION_STATUS_UNKNOWN, "KDC_ERR_REVOCATION_STATUS_UNKNOWN" },
+        { KRB5_ET_KDC_ERR_REVOCATION_STATUS_UNAVAILABLE, "KDC_ERR_REVOCATION_STATUS_UNAVAILABLE" },
+        { KRB5_ET_KDC_ERR_CLIENT_NAME_MISMATCH, "KDC_ERR_CLIENT_NAME_MISMATCH" },
+        { KRB5_ET_KDC_ERR_KDC_NAME_MISMATCH, "KDC_ERR_KDC_NAME_MISMATCH" },
+        { KRB5_ET_KDC_ERR_PREAUTH_EXPIRED, "KDC_ERR_PREAUTH_EXPIRED" },
+        { KRB5_ET_KDC_ERR_MORE_PREAUTH_DATA_REQUIRED, "KDC_ERR_MORE_PREAUTH_DATA_REQUIRED" },
+        { KRB5_ET_KDC_ERR_PREAUTH_BAD_AUTHENTICATION_SET, "KDC_ERR_PREAUTH_BAD_AUTHENTICATION_SET" },
+        { KRB5_ET_KDC_ERR_UNKNOWN_CRITICAL_FAST_OPTIONS, "KDC_ERR_UNKNOWN_CRITICAL_FAST_OPTIONS" },
+        { 0, NULL }
+};
+
+
+#define PAC_LOGON_INFO		1
+#define PAC_CREDENTIAL_TYPE	2
+#define PAC_SERVER_CHECKSUM	6
+#define PAC_PRIVSVR_CHECKSUM	7
+#define PAC_CLIENT_INFO_TYPE	10
+#define PAC_S4U_DELEGATION_INFO	11
+#define PAC_UPN_DNS_INFO	12
+#define PAC_CLIENT_CLAIMS_INFO	13
+#define PAC_DEVICE_INFO		14
+#define PAC_DEVICE_CLAIMS_INFO	15
+static const value_string w2k_pac_types[] = {
+        { PAC_LOGON_INFO		, "Logon Info" },
+        { PAC_CREDENTIAL_TYPE		, "Credential Type" },
+        { PAC_SERVER_CHECKSUM		, "Server Checksum" },
+        { PAC_PRIVSVR_CHECKSUM		, "Privsvr Checksum" },
+        { PAC_CLIENT_INFO_TYPE		, "Client Info Type" },
+        { PAC_S4U_DELEGATION_INFO	, "S4U Delegation Info" },
+        { PAC_UPN_DNS_INFO		, "UPN DNS Info" },
+        { PAC_CLIENT_CLAIMS_INFO	, "Client Claims Info" },
+        { PAC_DEVICE_INFO		, "Device Info" },
+        { PAC_DEVICE_CLAIMS_INFO	, "Device Claims Info" },
+        { 0, NULL },
+};
+
+static const value_string krb5_msg_types[] = {
+        { KRB5_MSG_TICKET,		"Ticket" },
+        { KRB5_MSG_AUTHENTICATOR,	"Authenticator" },
+        { KRB5_MSG_ENC_TICKET_PART,	"EncTicketPart" },
+        { KRB5_MSG_TGS_REQ,		"TGS-REQ" },
+        { KRB5_MSG_TGS_REP,		"TGS-REP" },
+        { KRB5_MSG_AS_REQ,		"AS-REQ" },
+        { KRB5_MSG_AS_REP,		"AS-REP" },
+        { KRB5_MSG_AP_REQ,		"AP-REQ" },
+        { KRB5_MSG_AP_REP,		"AP-REP" },
+        { KRB5_MSG_SAFE,		"KRB-SAFE" },
+        { KRB5_MSG_PRIV,		"KRB-PRIV" },
+        { KRB5_MSG_CRED,		"KRB-CRED" },
+        { KRB5_MSG_ENC_AS_REP_PART,	"EncASRepPart" },
+        { KRB5_MSG_ENC_TGS_REP_PART,	"EncTGSRepPart" },
+        { KRB5_MSG_ENC_AP_REP_PART,	"EncAPRepPart" },
+        { KRB5_MSG_ENC_KRB_PRIV_PART,	"EncKrbPrivPart" },
+        { KRB5_MSG_ENC_KRB_CRED_PART,	"EncKrbCredPart" },
+        { KRB5_MSG_ERROR,		"KRB-ERROR" },
+        { 0, NULL },
+};
+
+#define KRB5_GSS_C_DELEG_FLAG             0x01
+#define KRB5_GSS_C_MUTUAL_FLAG            0x02
+#define KRB5_GSS_C_REPLAY_FLAG            0x04
+#define KRB5_GSS_C_SEQUENCE_FLAG          0x08
+#define KRB5_GSS_C_CONF_FLAG              0x10
+#define KRB5_GSS_C_INTEG_FLAG             0x20
+#define KRB5_GSS_C_DCE_STYLE            0x1000
+
+static const true_false_string tfs_gss_flags_deleg = {
+        "Delegate credentials to remote peer",
+        "Do NOT delegate"
+};
+static const true_false_string tfs_gss_flags_mutual = {
+        "Request that remote peer authenticates itself",
+        "Mutual authentication NOT required"
+};
+static const true_false_string tfs_gss_flags_replay = {
+        "Enable replay protection for signed or sealed messages",
+        "Do NOT enable replay protection"
+};
+static const true_false_string tfs_gss_flags_sequence = {
+        "Enable Out-of-sequence detection for sign or sealed messages",
+        "Do NOT enable out-of-sequence detection"
+};
+static const true_false_string tfs_gss_flags_conf = {
+        "Confidentiality (sealing) may be invoked",
+        "Do NOT use Confidentiality (sealing)"
+};
+static const true_false_string tfs_gss_flags_integ = {
+        "Integrity protection (signing) may be invoked",
+        "Do NOT use integrity protection"
+};
+
+static const true_false_string tfs_gss_flags_dce_style = {
+        "DCE-STYLE",
+        "Not using DCE-STYLE"
+};
+
+#ifdef HAVE_KERBEROS
+static guint8*
+decrypt_krb5_data_asn1(proto_tree* tree, asn1_ctx_t* actx,
+    int usage, tvbuff_t* cryptotvb, int* datalen)
+{
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    guint8* plaintext;
+
+#ifdef HAVE_DECRYPT_KRB5_DATA_PRIVATE
+    plaintext = decrypt_krb5_data_private(tree, actx->pinfo, private_data,
+        usage, cryptotvb,
+        private_data->etype,
+        datalen);
+#else
+    plaintext = decrypt_krb5_data(tree, actx->pinfo, usage, cryptotvb,
+        private_data->etype, datalen);
+#endif
+    if (plaintext) {
+        private_data->last_decryption_usage = usage;
+    }
+    return plaintext;
+}
+
+/* Records written by kerberos_export_decrypted() */
+static int
+dissect_kerberos_decrypted(tvbuff_t* tvb, packet_info* pinfo, proto_tree* tree, void* data _U_)
+{
+    proto_item* item;
+    proto_tree* dec_tree;
+    asn1_ctx_t asn1_ctx;
+    tvbuff_t* plain_tvb;
+    guint32 usage;
+    guint key_id_len;
+    int offset = 0;
+
+    col_set_str(pinfo->cinfo, COL_PROTOCOL, "KRB5");
+
+    item = proto_tree_add_item(tree, proto_kerberos, tvb, 0, -1, ENC_NA);
+    dec_tree = proto_item_add_subtree(item, ett_krb_decrypted);
+    proto_tree_add_item_ret_uint(dec_tree, hf_krb_decrypted_usage, tvb, offset, 4, ENC_BIG_ENDIAN, &usage);
+    offset += 4;
+    proto_tree_add_item(dec_tree, hf_krb_decrypted_origin_frame, tvb, offset, 4, ENC_BIG_ENDIAN);
+    offset += 4;
+    key_id_len = tvb_get_guint8(tvb, offset);
+    offset += 1;
+    proto_tree_add_item(dec_tree, hf_krb_decrypted_key_id, tvb, offset, key_id_len, ENC_ASCII | ENC_NA);
+    offset += key_id_len;
+
+    col_add_fstr(pinfo->cinfo, COL_INFO, "Decrypted (usage %u)", usage);
+    plain_tvb = tvb_new_subset_remaining(tvb, offset);
+    add_new_data_source(pinfo, plain_tvb, "Krb5 Decrypted");
+
+    asn1_ctx_init(&asn1_ctx, ASN1_ENC_BER, TRUE, pinfo);
+    switch (usage) {
+    case 4:
+    case 5:
+        dissect_kerberos_AuthorizationData(FALSE, plain_tvb, 0, &asn1_ctx, dec_tree, -1);
+        break;
+    case 22: /* GSS-API wrap tokens */
+    case 23:
+    case 24:
+    case 25:
+        call_data_dissector(plain_tvb, pinfo, dec_tree);
+        break;
+    default:
+        dissect_kerberos_Applications(FALSE, plain_tvb, 0, &asn1_ctx, dec_tree, -1);
+        break;
+    }
+
+    return tvb_captured_length(tvb);
+}
+
+static int
+dissect_krb5_decrypt_ticket_data(gboolean imp_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx,
+    proto_tree* tree, int hf_index _U_)
+{
+    guint8* plaintext;
+    int length;
+    tvbuff_t* next_tvb;
+
+    next_tvb = tvb_new_subset_remaining(tvb, offset);
+    length = tvb_captured_length_remaining(tvb, offset);
+
+    /* draft-ietf-krb-wg-kerberos-clarifications-05.txt :
+     * 7.5.1
+     * All Ticket encrypted parts use usage == 2
+     */
+    plaintext = decrypt_krb5_data_asn1(tree, actx, 2, next_tvb, NULL);
+
+    if (plaintext) {
+        tvbuff_t* child_tvb;
+        child_tvb = tvb_new_child_real_data(tvb, plaintext, length, length);
+
+        /* Add the decrypted data to the data source list. */
+        add_new_data_source(actx->pinfo, child_tvb, "Krb5 Ticket");
+        kerberos_export_decrypted(actx->pinfo, kerberos_get_private_data(actx), child_tvb);
+
+        offset = dissect_kerberos_Applications(FALSE, child_tvb, 0, actx, tree, /* hf_index*/ -1);
+    }
+    return offset;
+}
+
+static int
+dissect_krb5_decrypt_authenticator_data(gboolean imp_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx,
+    proto_tree* tree, int hf_index _U_)
+{
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    guint8* plaintext;
+    int length;
+    tvbuff_t* next_tvb;
+
+    next_tvb = tvb_new_subset_remaining(tvb, offset);
+    length = tvb_captured_length_remaining(tvb, offset);
+
+    /* draft-ietf-krb-wg-kerberos-clarifications-05.txt :
+     * 7.5.1
+     * Authenticators are encrypted with usage
+     * == 7 or
+     * == 11
+     *
+     * 7.  TGS-REQ PA-TGS-REQ padata AP-REQ Authenticator
+     *     (includes TGS authenticator subkey), encrypted with the
+     *     TGS session key (section 5.5.1)
+     * 11. AP-REQ Authenticator (includes application
+     *     authenticator subkey), encrypted with the application
+     *     session key (section 5.5.1)
+     */
+    if (private_data->within_PA_TGS_REQ > 0) {
+        plaintext = decrypt_krb5_data_asn1(tree, actx, 7, next_tvb, NULL);
+    }
+    else {
+        plaintext = decrypt_krb5_data_asn1(tree, actx, 11, next_tvb, NULL);
+    }
+
+    if (plaintext) {
+        tvbuff_t* child_tvb;
+        child_tvb = tvb_new_child_real_data(tvb, plaintext, length, length);
+
+        /* Add the decrypted data to the data source list. */
+        add_new_data_source(actx->pinfo, child_tvb, "Krb5 Authenticator");
+        kerberos_export_decrypted(actx->pinfo, kerberos_get_private_data(actx), child_tvb);
+
+        offset = dissect_kerberos_Applications(FALSE, child_tvb, 0, actx, tree, /* hf_index*/ -1);
+    }
+    return offset;
+}
+
+static int
+dissect_krb5_decrypt_authorization_data(gboolean imp_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx,
+    proto_tree* tree, int hf_index _U_)
+{
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    guint8* plaintext;
+    int length;
+    tvbuff_t* next_tvb;
+
+    next_tvb = tvb_new_subset_remaining(tvb, offset);
+    length = tvb_captured_length_remaining(tvb, offset);
+
+    /* draft-ietf-krb-wg-kerberos-clarifications-05.txt :
+     * 7.5.1
+     * Authenticators are encrypted with usage
+     * == 5 or
+     * == 4
+     *
+     * 4. TGS-REQ KDC-REQ-BODY AuthorizationData, encrypted with
+     *    the TGS session key (section 5.4.1)
+     * 5. TGS-REQ KDC-REQ-BODY AuthorizationData, encrypted with
+     *    the TGS authenticator subkey (section 5.4.1)
+     */
+    if (private_data->PA_TGS_REQ_subkey != NULL) {
+        plaintext = decrypt_krb5_data_asn1(tree, actx, 5, next_tvb, NULL);
+    }
+    else {
+        plaintext = decrypt_krb5_data_asn1(tree, actx, 4, next_tvb, NULL);
+    }
+
+    if (plaintext) {
+        tvbuff_t* child_tvb;
+        child_tvb = tvb_new_child_real_data(tvb, plaintext, length, length);
+
+        /* Add the decrypted data to the data source list. */
+        add_new_data_source(actx->pinfo, child_tvb, "Krb5 AuthorizationData");
+        kerberos_export_decrypted(actx->pinfo, kerberos_get_private_data(actx), child_tvb);
+
+        offset = dissect_kerberos_AuthorizationData(FALSE, child_tvb, 0, actx, tree, /* hf_index*/ -1);
+    }
+    return offset;
+}
+
+static int
+dissect_krb5_decrypt_KDC_REP_data(gboolean imp_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx,
+    proto_tree* tree, int hf_index _U_)
+{
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    guint8* plaintext = NULL;
+    int length;
+    tvbuff_t* next_tvb;
+
+    next_tvb = tvb_new_subset_remaining(tvb, offset);
+    length = tvb_captured_length_remaining(tvb, offset);
+
+    /* draft-ietf-krb-wg-kerberos-clarifications-05.txt :
+     * 7.5.1
+     * ASREP/TGSREP encryptedparts are encrypted with usage
+     * == 3 or
+     * == 8 or
+     * == 9
+     *
+     * 3. AS-REP encrypted part (includes TGS session key or
+     *    application session key), encrypted with the client key
+     *    (section 5.4.2)
+     *
+     * 8. TGS-REP encrypted part (includes application session
+     *    key), encrypted with the TGS session key (section
+     *    5.4.2)
+     * 9. TGS-REP encrypted part (includes application session
+     *    key), encrypted with the TGS authenticator subkey
+     *    (section 5.4.2)
+     *
+     * We currently don't have a way to find the TGS-REQ state
+     * in order to check if an authenticator subkey was used.
+     *
+     * But if we client used FAST and we got a strengthen_key,
+     * we're sure an authenticator subkey was used.
+     *
+     * Windows don't use an authenticator subkey without FAST,
+     * but heimdal does.
+     *
+     * For now try 8 before 9 in order to avoid overhead and false
+     * positives for the 'kerberos.missing_keytype' filter in pure
+     * windows captures.
+     */
+    switch (private_data->msg_type) {
+    case KERBEROS_APPLICATIONS_AS_REP:
+        plaintext = decrypt_krb5_data_asn1(tree, actx, 3, next_tvb, NULL);
+        break;
+    case KERBEROS_APPLICATIONS_TGS_REP:
+        if (private_data->fast_strengthen_key != NULL) {
+            plaintext = decrypt_krb5_data_asn1(tree, actx, 9, next_tvb, NULL);
+        }
+        else {
+            plaintext = decrypt_krb5_data_asn1(tree, actx, 8, next_tvb, NULL);
+            if (!plaintext) {
+                plaintext = decrypt_krb5_data_asn1(tree, actx, 9, next_tvb, NULL);
+            }
+        }
+        break;
+    }
+
+    if (plaintext) {
+        tvbuff_t* child_tvb;
+        child_tvb = tvb_new_child_real_data(tvb, plaintext, length, length);
+
+        /* Add the decrypted data to the data source list. */
+        add_new_data_source(actx->pinfo, child_tvb, "Krb5 KDC-REP");
+        kerberos_export_decrypted(actx->pinfo, kerberos_get_private_data(actx), child_tvb);
+
+        offset = dissect_kerberos_Applications(FALSE, child_tvb, 0, actx, tree, /* hf_index*/ -1);
+    }
+    return offset;
+}
+
+static int
+dissect_krb5_decrypt_PA_ENC_TIMESTAMP(gboolean imp_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx,
+    proto_tree* tree, int hf_index _U_)
+{
+    guint8* plaintext;
+    int length;
+    tvbuff_t* next_tvb;
+
+    next_tvb = tvb_new_subset_remaining(tvb, offset);
+    length = tvb_captured_length_remaining(tvb, offset);
+
+    /* draft-ietf-krb-wg-kerberos-clarifications-05.txt :
+     * 7.5.1
+     * AS-REQ PA_ENC_TIMESTAMP are encrypted with usage
+     * == 1
+     */
+    plaintext = decrypt_krb5_data_asn1(tree, actx, 1, next_tvb, NULL);
+
+    if (plaintext) {
+        tvbuff_t* child_tvb;
+        child_tvb = tvb_new_child_real_data(tvb, plaintext, length, length);
+
+        /* Add the decrypted data to the data source list. */
+        add_new_data_source(actx->pinfo, child_tvb, "Krb5 EncTimestamp");
+
+        offset = dissect_kerberos_PA_ENC_TS_ENC(FALSE, child_tvb, 0, actx, tree, /* hf_index*/ -1);
+    }
+    return offset;
+}
+
+static int
+dissect_krb5_decrypt_AP_REP_data(gboolean imp_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx,
+    proto_tree* tree, int hf_index _U_)
+{
+    guint8* plaintext;
+    int length;
+    tvbuff_t* next_tvb;
+
+    next_tvb = tvb_new_subset_remaining(tvb, offset);
+    length = tvb_captured_length_remaining(tvb, offset);
+
+    /* draft-ietf-krb-wg-kerberos-clarifications-05.txt :
+     * 7.5.1
+     * AP-REP are encrypted with usage == 12
+     */
+    plaintext = decrypt_krb5_data_asn1(tree, actx, 12, next_tvb, NULL);
+
+    if (plaintext) {
+        tvbuff_t* child_tvb;
+        child_tvb = tvb_new_child_real_data(tvb, plaintext, length, length);
+
+        /* Add the decrypted data to the data source list. */
+        add_new_data_source(actx->pinfo, child_tvb, "Krb5 AP-REP");
+        kerberos_export_decrypted(actx->pinfo, kerberos_get_private_data(actx), child_tvb);
+
+        offset = dissect_kerberos_Applications(FALSE, child_tvb, 0, actx, tree, /* hf_index*/ -1);
+    }
+    return offset;
+}
+
+static int
+dissect_krb5_decrypt_PRIV_data(gboolean imp_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx,
+    proto_tree* tree, int hf_index _U_)
+{
+    guint8* plaintext;
+    int length;
+    tvbuff_t* next_tvb;
+
+    next_tvb = tvb_new_subset_remaining(tvb, offset);
+    length = tvb_captured_length_remaining(tvb, offset);
+
+    /* RFC4120 :
+     * EncKrbPrivPart encrypted with usage
+     * == 13
+     */
+    plaintext = decrypt_krb5_data_asn1(tree, actx, 13, next_tvb, NULL);
+
+    if (plaintext) {
+        tvbuff_t* child_tvb;
+        child_tvb = tvb_new_child_real_data(tvb, plaintext, length, length);
+
+        /* Add the decrypted data to the data source list. */
+        add_new_data_source(actx->pinfo, child_tvb, "Krb5 PRIV");
+        kerberos_export_decrypted(actx->pinfo, kerberos_get_private_data(actx), child_tvb);
+
+        offset = dissect_kerberos_Applications(FALSE, child_tvb, 0, actx, tree, /* hf_index*/ -1);
+    }
+    return offset;
+}
+
+static int
+dissect_krb5_decrypt_CRED_data(gboolean imp_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx,
+    proto_tree* tree, int hf_index _U_)
+{
+    guint8* plaintext;
+    int length;
+    tvbuff_t* next_tvb;
+
+    next_tvb = tvb_new_subset_remaining(tvb, offset);
+    length = tvb_captured_length_remaining(tvb, offset);
+
+    /* RFC4120 :
+     * EncKrbCredPart encrypted with usage
+     * == 14
+     */
+    plaintext = decrypt_krb5_data_asn1(tree, actx, 14, next_tvb, NULL);
+
+    if (plaintext) {
+        tvbuff_t* child_tvb;
+        child_tvb = tvb_new_child_real_data(tvb, plaintext, length, length);
+
+        /* Add the decrypted data to the data source list. */
+        add_new_data_source(actx->pinfo, child_tvb, "Krb5 CRED");
+        kerberos_export_decrypted(actx->pinfo, kerberos_get_private_data(actx), child_tvb);
+
+        offset = dissect_kerberos_Applications(FALSE, child_tvb, 0, actx, tree, /* hf_index*/ -1);
+    }
+    return offset;
+}
+
+static int
+dissect_krb5_decrypt_KrbFastReq(gboolean imp_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx,
+    proto_tree* tree, int hf_index _U_)
+{
+    guint8* plaintext;
+    int length;
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    tvbuff_t* next_tvb;
+
+    next_tvb = tvb_new_subset_remaining(tvb, offset);
+    length = tvb_captured_length_remaining(tvb, offset);
+
+    private_data->fast_armor_key = NULL;
+    if (private_data->PA_FAST_ARMOR_AP_subkey != NULL) {
+        krb5_fast_key(actx, tree, tvb,
+            private_data->PA_FAST_ARMOR_AP_subkey,
+            "subkeyarmor",
+            private_data->PA_FAST_ARMOR_AP_key,
+            "ticketarmor",
+            "KrbFastReq_FAST_armorKey");
+        if (private_data->PA_TGS_REQ_subkey != NULL) {
+            enc_key_t* explicit_armor_key = private_data->last_added_key;
+
+            /*
+             * See [MS-KILE] 3.3.5.7.4 Compound Identity
+             */
+            krb5_fast_key(actx, tree, tvb,
+                explicit_armor_key,
+                "explicitarmor",
+                private_data->PA_TGS_REQ_subkey,
+                "tgsarmor",
+                "KrbFastReq_explicitArmorKey");
+        }
+        private_data->fast_armor_key = private_data->last_added_key;
+    }
+    else if (private_data->PA_TGS_REQ_subkey != NULL) {
+        krb5_fast_key(actx, tree, tvb,
+            private_data->PA_TGS_REQ_subkey,
+            "subkeyarmor",
+            private_data->PA_TGS_REQ_key,
+            "ticketarmor",
+            "KrbFastReq_TGS_armorKey");
+        private_data->fast_armor_key = private_data->last_added_key;
+    }
+
+    /* RFC6113 :
+     * KrbFastResponse encrypted with usage
+     * KEY_USAGE_FAST_ENC 51
+     */
+    plaintext = decrypt_krb5_data_asn1(tree, actx, KEY_USAGE_FAST_ENC,
+        next_tvb, NULL);
+
+    if (plaintext) {
+        tvbuff_t* child_tvb;
+        child_tvb = tvb_new_child_real_data(tvb, plaintext, length, length);
+
+        /* Add the decrypted data to the data source list. */
+        add_new_data_source(actx->pinfo, child_tvb, "Krb5 FastReq");
+
+        offset = dissect_kerberos_KrbFastReq(FALSE, child_tvb, 0, actx, tree, /* hf_index*/ -1);
+    }
+    return offset;
+}
+
+static int
+dissect_krb5_decrypt_KrbFastResponse(gboolean imp_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx,
+    proto_tree* tree, int hf_index _U_)
+{
+    guint8* plaintext;
+    int length;
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    tvbuff_t* next_tvb;
+
+    next_tvb = tvb_new_subset_remaining(tvb, offset);
+    length = tvb_captured_length_remaining(tvb, offset);
+
+    /*
+     * RFC6113 :
+     * KrbFastResponse encrypted with usage
+     * KEY_USAGE_FAST_REP 52
+     */
+    plaintext = decrypt_krb5_data_asn1(tree, actx, KEY_USAGE_FAST_REP,
+        next_tvb, NULL);
+
+    if (plaintext) {
+        tvbuff_t* child_tvb;
+        child_tvb = tvb_new_child_real_data(tvb, plaintext, length, length);
+
+        /* Add the decrypted data to the data source list. */
+        add_new_data_source(actx->pinfo, child_tvb, "Krb5 FastRep");
+
+        private_data->fast_armor_key = private_data->last_decryption_key;
+        offset = dissect_kerberos_KrbFastResponse(FALSE, child_tvb, 0, actx, tree, /* hf_index*/ -1);
+    }
+    return offset;
+}
+
+static int
+dissect_krb5_decrypt_EncryptedChallenge(gboolean imp_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx,
+    proto_tree* tree, int hf_index _U_)
+{
+    guint8* plaintext;
+    int length;
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    tvbuff_t* next_tvb;
+    int usage = 0;
+    const char* name = NULL;
+
+    next_tvb = tvb_new_subset_remaining(tvb, offset);
+    length = tvb_captured_length_remaining(tvb, offset);
+
+    /* RFC6113 :
+     * KEY_USAGE_ENC_CHALLENGE_CLIENT  54
+     * KEY_USAGE_ENC_CHALLENGE_KDC     55
+     */
+    if (kerberos_private_is_kdc_req(private_data)) {
+        usage = KEY_USAGE_ENC_CHALLENGE_CLIENT;
+        name = "Krb5 CHALLENGE_CLIENT";
+    }
+    else {
+        usage = KEY_USAGE_ENC_CHALLENGE_KDC;
+        name = "Krb5 CHALLENGE_KDC";
+    }
+    plaintext = decrypt_krb5_data_asn1(tree, actx, usage, next_tvb, NULL);
+
+    if (plaintext) {
+        tvbuff_t* child_tvb;
+        child_tvb = tvb_new_child_real_data(tvb, plaintext, length, length);
+
+        /* Add the decrypted data to the data source list. */
+        add_new_data_source(actx->pinfo, child_tvb, name);
+
+        offset = dissect_kerberos_PA_ENC_TS_ENC(FALSE, child_tvb, 0, actx, tree, /* hf_index*/ -1);
+    }
+    return offset;
+}
+#endif /* HAVE_KERBEROS */
+
+static const int* hf_krb_pa_supported_enctypes_fields[] = {
+        &hf_krb_pa_supported_enctypes_des_cbc_crc,
+        &hf_krb_pa_supported_enctypes_des_cbc_md5,
+        &hf_krb_pa_supported_enctypes_rc4_hmac,
+        &hf_krb_pa_supported_enctypes_aes128_cts_hmac_sha1_96,
+        &hf_krb_pa_supported_enctypes_aes256_cts_hmac_sha1_96,
+        &hf_krb_pa_supported_enctypes_fast_supported,
+        &hf_krb_pa_supported_enctypes_compound_identity_supported,
+        &hf_krb_pa_supported_enctypes_claims_supported,
+        &hf_krb_pa_supported_enctypes_resource_sid_compression_disabled,
+        NULL,
+};
+
+static const true_false_string supported_tfs = {
+        "Supported", "Not supported"
+};
+
+static int
+dissect_kerberos_PA_SUPPORTED_ENCTYPES(gboolean implicit_tag _U_, tvbuff_t* tvb _U_,
+    int offset _U_, asn1_ctx_t* actx _U_,
+    proto_tree* tree _U_, int hf_index _U_)
+{
+    actx->created_item = proto_tree_add_bitmask(tree, tvb, offset,
+        hf_krb_pa_supported_enctypes,
+        ett_krb_pa_supported_enctypes,
+        hf_krb_pa_supported_enctypes_fields,
+        ENC_LITTLE_ENDIAN);
+    offset += 4;
+
+    return offset;
+}
+
+static const int* hf_krb_ad_ap_options_fields[] = {
+        &hf_krb_ad_ap_options_cbt,
+        NULL,
+};
+
+static const true_false_string set_tfs = {
+        "Set", "Not set"
+};
+
+static int
+dissect_kerberos_AD_AP_OPTIONS(gboolean implicit_tag _U_, tvbuff_t* tvb _U_,
+    int offset _U_, asn1_ctx_t* actx _U_,
+    proto_tree* tree _U_, int hf_index _U_)
+{
+    actx->created_item = proto_tree_add_bitmask(tree, tvb, offset,
+        hf_krb_ad_ap_options,
+        ett_krb_ad_ap_options,
+        hf_krb_ad_ap_options_fields,
+        ENC_LITTLE_ENDIAN);
+    offset += 4;
+
+    return offset;
+}
+
+static int
+dissect_kerberos_AD_TARGET_PRINCIPAL(gboolean implicit_tag _U_, tvbuff_t* tvb _U_,
+    int offset _U_, asn1_ctx_t* actx _U_,
+    proto_tree* tree _U_, int hf_index _U_)
+{
+    int tp_offset, tp_len;
+    guint16 bc;
+
+    bc = tvb_reported_length_remaining(tvb, offset);
+    tp_offset = offset;
+    tp_len = bc;
+    proto_tree_add_item(tree, hf_krb_ad_target_principal, tvb,
+        tp_offset, tp_len,
+        ENC_UTF_16 | ENC_LITTLE_ENDIAN);
+
+    return offset;
+}
+
+/* Dissect a GSSAPI checksum as per RFC1964. This is NOT ASN.1 encoded.
+ */
+static int
+dissect_krb5_rfc1964_checksum(asn1_ctx_t* actx _U_, proto_tree* tree, tvbuff_t* tvb)
+{
+    int offset = 0;
+    guint32 len;
+    guint16 dlglen;
+
+    /* Length of Bnd field */
+    len = tvb_get_letohl(tvb, offset);
+    proto_tree_add_item(tree, hf_krb_gssapi_len, tvb, offset, 4, ENC_LITTLE_ENDIAN);
+    offset += 4;
+
+    /* Bnd field */
+    proto_tree_add_item(tree, hf_krb_gssapi_bnd, tvb, offset, len, ENC_NA);
+    offset += len;
+
+
+    /* flags */
+    proto_tree_add_item(tree, hf_krb_gssapi_c_flag_dce_style, tvb, offset, 4, ENC_LITTLE_ENDIAN);
+    proto_tree_add_item(tree, hf_krb_gssapi_c_flag_integ, tvb, offset, 4, ENC_LITTLE_ENDIAN);
+    proto_tree_add_item(tree, hf_krb_gssapi_c_flag_conf, tvb, offset, 4, ENC_LITTLE_ENDIAN);
+    proto_tree_add_item(tree, hf_krb_gssapi_c_flag_sequence, tvb, offset, 4, ENC_LITTLE_ENDIAN);
+    proto_tree_add_item(tree, hf_krb_gssapi_c_flag_replay, tvb, offset, 4, ENC_LITTLE_ENDIAN);
+    proto_tree_add_item(tree, hf_krb_gssapi_c_flag_mutual, tvb, offset, 4, ENC_LITTLE_ENDIAN);
+    proto_tree_add_item(tree, hf_krb_gssapi_c_flag_deleg, tvb, offset, 4, ENC_LITTLE_ENDIAN);
+    offset += 4;
+
+    /* the next fields are optional so we have to check that we have
+     * more data in our buffers */
+    if (tvb_reported_length_remaining(tvb, offset) < 2) {
+        return offset;
+    }
+    /* dlgopt identifier */
+    proto_tree_add_item(tree, hf_krb_gssapi_dlgopt, tvb, offset, 2, ENC_LITTLE_ENDIAN);
+    offset += 2;
+
+    if (tvb_reported_length_remaining(tvb, offset) < 2) {
+        return offset;
+    }
+    /* dlglen identifier */
+    dlglen = tvb_get_letohs(tvb, offset);
+    proto_tree_add_item(tree, hf_krb_gssapi_dlglen, tvb, offset, 2, ENC_LITTLE_ENDIAN);
+    offset += 2;
+
+    if (dlglen != tvb_reported_length_remaining(tvb, offset)) {
+        proto_tree_add_expert_format(tree, actx->pinfo, &ei_krb_gssapi_dlglen, tvb, 0, 0,
+            "Error: DlgLen:%d is not the same as number of bytes remaining:%d", dlglen, tvb_captured_length_remaining(tvb, offset));
+        return offset;
+    }
+
+    /* this should now be a KRB_CRED message */
+    offset = dissect_kerberos_Applications(FALSE, tvb, offset, actx, tree, /* hf_index */ -1);
+
+    return offset;
+}
+
+static int
+dissect_krb5_PA_PROV_SRV_LOCATION(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_)
+{
+    offset = dissect_ber_GeneralString(actx, tree, tvb, offset, hf_krb_provsrv_location, NULL, 0);
+
+    return offset;
+}
+
+static int
+dissect_krb5_PW_SALT(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_)
+{
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    gint length;
+    guint32 nt_status = 0;
+    guint32 reserved = 0;
+    guint32 flags = 0;
+
+    /*
+     * Microsoft stores a special 12 byte blob here
+     * [MS-KILE] 2.2.1 KERB-EXT-ERROR
+     * guint32 NT_status
+     * guint32 reserved (== 0)
+     * guint32 flags (at least 0x00000001 is set)
+     */
+    length = tvb_reported_length_remaining(tvb, offset);
+    if (length <= 0) {
+        return offset;
+    }
+    if (length != 12) {
+        goto no_error;
+    }
+
+    if (private_data->errorcode == 0) {
+        goto no_error;
+    }
+
+    if (!private_data->try_nt_status) {
+        goto no_error;
+    }
+
+    nt_status = tvb_get_letohl(tvb, offset);
+    reserved = tvb_get_letohl(tvb, offset + 4);
+    flags = tvb_get_letohl(tvb, offset + 8);
+
+    if (nt_status == 0 || reserved != 0 || flags == 0) {
+        goto no_error;
+    }
 
-#define KRB5_CHKSUM_GSSAPI		0x8003
-/*
- * For KERB_ENCTYPE_RC4_HMAC and KERB_ENCTYPE_RC4_HMAC_EXP, see
- *
- *	https://tools.ietf.org/html/draft-brezak-win2k-krb-rc4-hmac-04
- *
- * unless it's expired.
- */
+    proto_tree_add_item(tree, hf_krb_ext_error_nt_status, tvb, offset, 4,
+        ENC_LITTLE_ENDIAN);
+    col_append_fstr(actx->pinfo->cinfo, COL_INFO,
+        " NT Status: %s",
+        val_to_str(nt_status, NT_errors,
+            "Unknown error code %#x"));
+    offset += 4;
 
- /* Principal name-type */
-#define KRB5_NT_UNKNOWN		0
-#define KRB5_NT_PRINCIPAL	1
-#define KRB5_NT_SRV_INST	2
-#define KRB5_NT_SRV_HST		3
-#define KRB5_NT_SRV_XHST	4
-#define KRB5_NT_UID		5
-#define KRB5_NT_X500_PRINCIPAL	6
-#define KRB5_NT_SMTP_NAME	7
-#define KRB5_NT_ENTERPRISE	10
+    proto_tree_add_item(tree, hf_krb_ext_error_reserved, tvb, offset, 4,
+        ENC_LITTLE_ENDIAN);
+    offset += 4;
 
-/*
- * MS specific name types, from
- *
- *	http://msdn.microsoft.com/library/en-us/security/security/kerb_external_name.asp
+    proto_tree_add_item(tree, hf_krb_ext_error_flags, tvb, offset, 4,
+        ENC_LITTLE_ENDIAN);
+    offset += 4;
+
+    return offset;
+
+no_error:
+    proto_tree_add_item(tree, hf_krb_pw_salt, tvb, offset, length, ENC_NA);
+    offset += length;
+
+    return offset;
+}
+
+static int
+dissect_krb5_PAC_DREP(proto_tree* parent_tree, tvbuff_t* tvb, int offset, guint8* drep)
+{
+    proto_tree* tree;
+    guint8 val;
+
+    tree = proto_tree_add_subtree(parent_tree, tvb, offset, 16, ett_krb_pac_drep, NULL, "DREP");
+
+    val = tvb_get_guint8(tvb, offset);
+    proto_tree_add_uint(tree, hf_dcerpc_drep_byteorder, tvb, offset, 1, val >> 4);
+
+    offset++;
+
+    if (drep) {
+        *drep = val;
+    }
+
+    return offset;
+}
+
+/* This might be some sort of header that MIDL generates when creating
+ * marshalling/unmarshalling code for blobs that are not to be transported
+ * ontop of DCERPC and where the DREP fields specifying things such as
+ * endianess and similar are not available.
  */
-#define KRB5_NT_MS_PRINCIPAL		-128
-#define KRB5_NT_MS_PRINCIPAL_AND_SID	-129
-#define KRB5_NT_ENT_PRINCIPAL_AND_SID	-130
-#define KRB5_NT_PRINCIPAL_AND_SID 	-131
-#define KRB5_NT_SRV_INST_AND_SID	-132
+static int
+dissect_krb5_PAC_NDRHEADERBLOB(proto_tree* parent_tree, tvbuff_t* tvb, int offset, guint8* drep, asn1_ctx_t* actx _U_)
+{
+    proto_tree* tree;
 
- /* error table constants */
- /* I prefixed the krb5_err.et constant names with KRB5_ET_ for these */
-#define KRB5_ET_KRB5KDC_ERR_NONE			0
-#define KRB5_ET_KRB5KDC_ERR_NAME_EXP			1
-#define KRB5_ET_KRB5KDC_ERR_SERVICE_EXP			2
-#define KRB5_ET_KRB5KDC_ERR_BAD_PVNO			3
-#define KRB5_ET_KRB5KDC_ERR_C_OLD_MAST_KVNO		4
-#define KRB5_ET_KRB5KDC_ERR_S_OLD_MAST_KVNO		5
-#define KRB5_ET_KRB5KDC_ERR_C_PRINCIPAL_UNKNOWN		6
-#define KRB5_ET_KRB5KDC_ERR_S_PRINCIPAL_UNKNOWN		7
-#define KRB5_ET_KRB5KDC_ERR_PRINCIPAL_NOT_UNIQUE	8
-#define KRB5_ET_KRB5KDC_ERR_NULL_KEY			9
-#define KRB5_ET_KRB5KDC_ERR_CANNOT_POSTDATE		10
-#define KRB5_ET_KRB5KDC_ERR_NEVER_VALID			11
-#define KRB5_ET_KRB5KDC_ERR_POLICY			12
-#define KRB5_ET_KRB5KDC_ERR_BADOPTION			13
-#define KRB5_ET_KRB5KDC_ERR_ETYPE_NOSUPP		14
-#define KRB5_ET_KRB5KDC_ERR_SUMTYPE_NOSUPP		15
-#define KRB5_ET_KRB5KDC_ERR_PADATA_TYPE_NOSUPP		16
-#define KRB5_ET_KRB5KDC_ERR_TRTYPE_NOSUPP		17
-#define KRB5_ET_KRB5KDC_ERR_CLIENT_REVOKED		18
-#define KRB5_ET_KRB5KDC_ERR_SERVICE_REVOKED		19
-#define KRB5_ET_KRB5KDC_ERR_TGT_REVOKED			20
-#define KRB5_ET_KRB5KDC_ERR_CLIENT_NOTYET		21
-#define KRB5_ET_KRB5KDC_ERR_SERVICE_NOTYET		22
-#define KRB5_ET_KRB5KDC_ERR_KEY_EXP			23
-#define KRB5_ET_KRB5KDC_ERR_PREAUTH_FAILED		24
-#define KRB5_ET_KRB5KDC_ERR_PREAUTH_REQUIRED		25
-#define KRB5_ET_KRB5KDC_ERR_SERVER_NOMATCH		26
-#define KRB5_ET_KRB5KDC_ERR_MUST_USE_USER2USER		27
-#define KRB5_ET_KRB5KDC_ERR_PATH_NOT_ACCEPTED		28
-#define KRB5_ET_KRB5KDC_ERR_SVC_UNAVAILABLE		29
-#define KRB5_ET_KRB5KRB_AP_ERR_BAD_INTEGRITY		31
-#define KRB5_ET_KRB5KRB_AP_ERR_TKT_EXPIRED		32
-#define KRB5_ET_KRB5KRB_AP_ERR_TKT_NYV			33
-#define KRB5_ET_KRB5KRB_AP_ERR_REPEAT			34
-#define KRB5_ET_KRB5KRB_AP_ERR_NOT_US			35
-#define KRB5_ET_KRB5KRB_AP_ERR_BADMATCH			36
-#define KRB5_ET_KRB5KRB_AP_ERR_SKEW			37
-#define KRB5_ET_KRB5KRB_AP_ERR_BADADDR			38
-#define KRB5_ET_KRB5KRB_AP_ERR_BADVERSION		39
-#define KRB5_ET_KRB5KRB_AP_ERR_MSG_TYPE			40
-#define KRB5_ET_KRB5KRB_AP_ERR_MODIFIED			41
-#define KRB5_ET_KRB5KRB_AP_ERR_BADORDER			42
-#define KRB5_ET_KRB5KRB_AP_ERR_ILL_CR_TKT		43
-#define KRB5_ET_KRB5KRB_AP_ERR_BADKEYVER		44
-#define KRB5_ET_KRB5KRB_AP_ERR_NOKEY			45
-#define KRB5_ET_KRB5KRB_AP_ERR_MUT_FAIL			46
-#define KRB5_ET_KRB5KRB_AP_ERR_BADDIRECTION		47
-#define KRB5_ET_KRB5KRB_AP_ERR_METHOD			48
-#define KRB5_ET_KRB5KRB_AP_ERR_BADSEQ			49
-#define KRB5_ET_KRB5KRB_AP_ERR_INAPP_CKSUM		50
-#define KRB5_ET_KRB5KDC_AP_PATH_NOT_ACCEPTED		51
-#define KRB5_ET_KRB5KRB_ERR_RESPONSE_TOO_BIG		52
-#define KRB5_ET_KRB5KRB_ERR_GENERIC			60
-#define KRB5_ET_KRB5KRB_ERR_FIELD_TOOLONG		61
-#define KRB5_ET_KDC_ERROR_CLIENT_NOT_TRUSTED		62
-#define KRB5_ET_KDC_ERROR_KDC_NOT_TRUSTED		63
-#define KRB5_ET_KDC_ERROR_INVALID_SIG			64
-#define KRB5_ET_KDC_ERR_KEY_TOO_WEAK			65
-#define KRB5_ET_KDC_ERR_CERTIFICATE_MISMATCH		66
-#define KRB5_ET_KRB_AP_ERR_NO_TGT			67
-#define KRB5_ET_KDC_ERR_WRONG_REALM			68
-#define KRB5_ET_KRB_AP_ERR_USER_TO_USER_REQUIRED	69
-#define KRB5_ET_KDC_ERR_CANT_VERIFY_CERTIFICATE		70
-#define KRB5_ET_KDC_ERR_INVALID_CERTIFICATE		71
-#define KRB5_ET_KDC_ERR_REVOKED_CERTIFICATE		72
-#define KRB5_ET_KDC_ERR_REVOCATION_STATUS_UNKNOWN	73
-#define KRB5_ET_KDC_ERR_REVOCATION_STATUS_UNAVAILABLE	74
-#define KRB5_ET_KDC_ERR_CLIENT_NAME_MISMATCH		75
-#define KRB5_ET_KDC_ERR_KDC_NAME_MISMATCH		76
-#define KRB5_ET_KDC_ERR_PREAUTH_EXPIRED			90
-#define KRB5_ET_KDC_ERR_MORE_PREAUTH_DATA_REQUIRED	91
-#define KRB5_ET_KDC_ERR_PREAUTH_BAD_AUTHENTICATION_SET	92
-#define KRB5_ET_KDC_ERR_UNKNOWN_CRITICAL_FAST_OPTIONS	93
+    tree = proto_tree_add_subtree(parent_tree, tvb, offset, 16, ett_krb_pac_midl_blob, NULL, "MES header");
 
-static const value_string krb5_error_codes[] = {
-        { KRB5_ET_KRB5KDC_ERR_NONE, "KRB5KDC_ERR_NONE" },
-        { KRB5_ET_KRB5KDC_ERR_NAME_EXP, "KRB5KDC_ERR_NAME_EXP" },
-        { KRB5_ET_KRB5KDC_ERR_SERVICE_EXP, "KRB5KDC_ERR_SERVICE_EXP" },
-        { KRB5_ET_KRB5KDC_ERR_BAD_PVNO, "KRB5KDC_ERR_BAD_PVNO" },
-        { KRB5_ET_KRB5KDC_ERR_C_OLD_MAST_KVNO, "KRB5KDC_ERR_C_OLD_MAST_KVNO" },
-        { KRB5_ET_KRB5KDC_ERR_S_OLD_MAST_KVNO, "KRB5KDC_ERR_S_OLD_MAST_KVNO" },
-        { KRB5_ET_KRB5KDC_ERR_C_PRINCIPAL_UNKNOWN, "KRB5KDC_ERR_C_PRINCIPAL_UNKNOWN" },
-        { KRB5_ET_KRB5KDC_ERR_S_PRINCIPAL_UNKNOWN, "KRB5KDC_ERR_S_PRINCIPAL_UNKNOWN" },
-        { KRB5_ET_KRB5KDC_ERR_PRINCIPAL_NOT_UNIQUE, "KRB5KDC_ERR_PRINCIPAL_NOT_UNIQUE" },
-        { KRB5_ET_KRB5KDC_ERR_NULL_KEY, "KRB5KDC_ERR_NULL_KEY" },
-        { KRB5_ET_KRB5KDC_ERR_CANNOT_POSTDATE, "KRB5KDC_ERR_CANNOT_POSTDATE" },
-        { KRB5_ET_KRB5KDC_ERR_NEVER_VALID, "KRB5KDC_ERR_NEVER_VALID" },
-        { KRB5_ET_KRB5KDC_ERR_POLICY, "KRB5KDC_ERR_POLICY" },
-        { KRB5_ET_KRB5KDC_ERR_BADOPTION, "KRB5KDC_ERR_BADOPTION" },
-        { KRB5_ET_KRB5KDC_ERR_ETYPE_NOSUPP, "KRB5KDC_ERR_ETYPE_NOSUPP" },
-        { KRB5_ET_KRB5KDC_ERR_SUMTYPE_NOSUPP, "KRB5KDC_ERR_SUMTYPE_NOSUPP" },
-        { KRB5_ET_KRB5KDC_ERR_PADATA_TYPE_NOSUPP, "KRB5KDC_ERR_PADATA_TYPE_NOSUPP" },
-        { KRB5_ET_KRB5KDC_ERR_TRTYPE_NOSUPP, "KRB5KDC_ERR_TRTYPE_NOSUPP" },
-        { KRB5_ET_KRB5KDC_ERR_CLIENT_REVOKED, "KRB5KDC_ERR_CLIENT_REVOKED" },
-        { KRB5_ET_KRB5KDC_ERR_SERVICE_REVOKED, "KRB5KDC_ERR_SERVICE_REVOKED" },
-        { KRB5_ET_KRB5KDC_ERR_TGT_REVOKED, "KRB5KDC_ERR_TGT_REVOKED" },
-        { KRB5_ET_KRB5KDC_ERR_CLIENT_NOTYET, "KRB5KDC_ERR_CLIENT_NOTYET" },
-        { KRB5_ET_KRB5KDC_ERR_SERVICE_NOTYET, "KRB5KDC_ERR_SERVICE_NOTYET" },
-        { KRB5_ET_KRB5KDC_ERR_KEY_EXP, "KRB5KDC_ERR_KEY_EXP" },
-        { KRB5_ET_KRB5KDC_ERR_PREAUTH_FAILED, "KRB5KDC_ERR_PREAUTH_FAILED" },
-        { KRB5_ET_KRB5KDC_ERR_PREAUTH_REQUIRED, "KRB5KDC_ERR_PREAUTH_REQUIRED" },
-        { KRB5_ET_KRB5KDC_ERR_SERVER_NOMATCH, "KRB5KDC_ERR_SERVER_NOMATCH" },
-        { KRB5_ET_KRB5KDC_ERR_MUST_USE_USER2USER, "KRB5KDC_ERR_MUST_USE_USER2USER" },
-        { KRB5_ET_KRB5KDC_ERR_PATH_NOT_ACCEPTED, "KRB5KDC_ERR_PATH_NOT_ACCEPTED" },
-        { KRB5_ET_KRB5KDC_ERR_SVC_UNAVAILABLE, "KRB5KDC_ERR_SVC_UNAVAILABLE" },
-        { KRB5_ET_KRB5KRB_AP_ERR_BAD_INTEGRITY, "KRB5KRB_AP_ERR_BAD_INTEGRITY" },
-        { KRB5_ET_KRB5KRB_AP_ERR_TKT_EXPIRED, "KRB5KRB_AP_ERR_TKT_EXPIRED" },
-        { KRB5_ET_KRB5KRB_AP_ERR_TKT_NYV, "KRB5KRB_AP_ERR_TKT_NYV" },
-        { KRB5_ET_KRB5KRB_AP_ERR_REPEAT, "KRB5KRB_AP_ERR_REPEAT" },
-        { KRB5_ET_KRB5KRB_AP_ERR_NOT_US, "KRB5KRB_AP_ERR_NOT_US" },
-        { KRB5_ET_KRB5KRB_AP_ERR_BADMATCH, "KRB5KRB_AP_ERR_BADMATCH" },
-        { KRB5_ET_KRB5KRB_AP_ERR_SKEW, "KRB5KRB_AP_ERR_SKEW" },
-        { KRB5_ET_KRB5KRB_AP_ERR_BADADDR, "KRB5KRB_AP_ERR_BADADDR" },
-        { KRB5_ET_KRB5KRB_AP_ERR_BADVERSION, "KRB5KRB_AP_ERR_BADVERSION" },
-        { KRB5_ET_KRB5KRB_AP_ERR_MSG_TYPE, "KRB5KRB_AP_ERR_MSG_TYPE" },
-        { KRB5_ET_KRB5KRB_AP_ERR_MODIFIED, "KRB5KRB_AP_ERR_MODIFIED" },
-        { KRB5_ET_KRB5KRB_AP_ERR_BADORDER, "KRB5KRB_AP_ERR_BADORDER" },
-        { KRB5_ET_KRB5KRB_AP_ERR_ILL_CR_TKT, "KRB5KRB_AP_ERR_ILL_CR_TKT" },
-        { KRB5_ET_KRB5KRB_AP_ERR_BADKEYVER, "KRB5KRB_AP_ERR_BADKEYVER" },
-        { KRB5_ET_KRB5KRB_AP_ERR_NOKEY, "KRB5KRB_AP_ERR_NOKEY" },
-        { KRB5_ET_KRB5KRB_AP_ERR_MUT_FAIL, "KRB5KRB_AP_ERR_MUT_FAIL" },
-        { KRB5_ET_KRB5KRB_AP_ERR_BADDIRECTION, "KRB5KRB_AP_ERR_BADDIRECTION" },
-        { KRB5_ET_KRB5KRB_AP_ERR_METHOD, "KRB5KRB_AP_ERR_METHOD" },
-        { KRB5_ET_KRB5KRB_AP_ERR_BADSEQ, "KRB5KRB_AP_ERR_BADSEQ" },
-        { KRB5_ET_KRB5KRB_AP_ERR_INAPP_CKSUM, "KRB5KRB_AP_ERR_INAPP_CKSUM" },
-        { KRB5_ET_KRB5KDC_AP_PATH_NOT_ACCEPTED, "KRB5KDC_AP_PATH_NOT_ACCEPTED" },
-        { KRB5_ET_KRB5KRB_ERR_RESPONSE_TOO_BIG, "KRB5KRB_ERR_RESPONSE_TOO_BIG"},
-        { KRB5_ET_KRB5KRB_ERR_GENERIC, "KRB5KRB_ERR_GENERIC" },
-        { KRB5_ET_KRB5KRB_ERR_FIELD_TOOLONG, "KRB5KRB_ERR_FIELD_TOOLONG" },
-        { KRB5_ET_KDC_ERROR_CLIENT_NOT_TRUSTED, "KDC_ERROR_CLIENT_NOT_TRUSTED" },
-        { KRB5_ET_KDC_ERROR_KDC_NOT_TRUSTED, "KDC_ERROR_KDC_NOT_TRUSTED" },
-        { KRB5_ET_KDC_ERROR_INVALID_SIG, "KDC_ERROR_INVALID_SIG" },
-        { KRB5_ET_KDC_ERR_KEY_TOO_WEAK, "KDC_ERR_KEY_TOO_WEAK" },
-        { KRB5_ET_KDC_ERR_CERTIFICATE_MISMATCH, "KDC_ERR_CERTIFICATE_MISMATCH" },
-        { KRB5_ET_KRB_AP_ERR_NO_TGT, "KRB_AP_ERR_NO_TGT" },
-        { KRB5_ET_KDC_ERR_WRONG_REALM, "KDC_ERR_WRONG_REALM" },
-        { KRB5_ET_KRB_AP_ERR_USER_TO_USER_REQUIRED, "KRB_AP_ERR_USER_TO_USER_REQUIRED" },
-        { KRB5_ET_KDC_ERR_CANT_VERIFY_CERTIFICATE, "KDC_ERR_CANT_VERIFY_CERTIFICATE" },
-        { KRB5_ET_KDC_ERR_INVALID_CERTIFICATE, "KDC_ERR_INVALID_CERTIFICATE" },
-        { KRB5_ET_KDC_ERR_REVOKED_CERTIFICATE, "KDC_ERR_REVOKED_CERTIFICATE" },
-        { KRB5_ET_KDC_ERR_REVOCATION_STATUS_UNKNOWN, "KDC_ERR_REVOCATION_STATUS_UNKNOWN" },
-        { KRB5_ET_KDC_ERR_REVOCATION_STATUS_UNAVAILABLE, "KDC_ERR_REVOCATION_STATUS_UNAVAILABLE" },
-        { KRB5_ET_KDC_ERR_CLIENT_NAME_MISMATCH, "KDC_ERR_CLIENT_NAME_MISMATCH" },
-        { KRB5_ET_KDC_ERR_KDC_NAME_MISMATCH, "KDC_ERR_KDC_NAME_MISMATCH" },
-        { KRB5_ET_KDC_ERR_PREAUTH_EXPIRED, "KDC_ERR_PREAUTH_EXPIRED" },
-        { KRB5_ET_KDC_ERR_MORE_PREAUTH_DATA_REQUIRED, "KDC_ERR_MORE_PREAUTH_DATA_REQUIRED" },
-        { KRB5_ET_KDC_ERR_PREAUTH_BAD_AUTHENTICATION_SET, "KDC_ERR_PREAUTH_BAD_AUTHENTICATION_SET" },
-        { KRB5_ET_KDC_ERR_UNKNOWN_CRITICAL_FAST_OPTIONS, "KDC_ERR_UNKNOWN_CRITICAL_FAST_OPTIONS" },
-        { 0, NULL }
-};
+    /* modified DREP field that is used for stuff that is transporetd ontop
+       of non dcerpc
+    */
+    proto_tree_add_item(tree, hf_krb_midl_version, tvb, offset, 1, ENC_LITTLE_ENDIAN);
+    offset++;
+
+    offset = dissect_krb5_PAC_DREP(tree, tvb, offset, drep);
+
+
+    proto_tree_add_item(tree, hf_krb_midl_hdr_len, tvb, offset, 2, ENC_LITTLE_ENDIAN);
+    offset += 2;
+
+    proto_tree_add_item(tree, hf_krb_midl_fill_bytes, tvb, offset, 4, ENC_LITTLE_ENDIAN);
+    offset += 4;
 
+    /* length of blob that follows */
+    proto_tree_add_item(tree, hf_krb_midl_blob_len, tvb, offset, 8, ENC_LITTLE_ENDIAN);
+    offset += 8;
 
-#define PAC_LOGON_INFO		1
-#define PAC_CREDENTIAL_TYPE	2
-#define PAC_SERVER_CHECKSUM	6
-#define PAC_PRIVSVR_CHECKSUM	7
-#define PAC_CLIENT_INFO_TYPE	10
-#define PAC_S4U_DELEGATION_INFO	11
-#define PAC_UPN_DNS_INFO	12
-#define PAC_CLIENT_CLAIMS_INFO	13
-#define PAC_DEVICE_INFO		14
-#define PAC_DEVICE_CLAIMS_INFO	15
-static const value_string w2k_pac_types[] = {
-        { PAC_LOGON_INFO		, "Logon Info" },
-        { PAC_CREDENTIAL_TYPE		, "Credential Type" },
-        { PAC_SERVER_CHECKSUM		, "Server Checksum" },
-        { PAC_PRIVSVR_CHECKSUM		, "Privsvr Checksum" },
-        { PAC_CLIENT_INFO_TYPE		, "Client Info Type" },
-        { PAC_S4U_DELEGATION_INFO	, "S4U Delegation Info" },
-        { PAC_UPN_DNS_INFO		, "UPN DNS Info" },
-        { PAC_CLIENT_CLAIMS_INFO	, "Client Claims Info" },
-        { PAC_DEVICE_INFO		, "Device Info" },
-        { PAC_DEVICE_CLAIMS_INFO	, "Device Claims Info" },
-        { 0, NULL },
-};
+    return offset;
+}
 
-static const value_string krb5_msg_types[] = {
-        { KRB5_MSG_TICKET,		"Ticket" },
-        { KRB5_MSG_AUTHENTICATOR,	"Authenticator" },
-        { KRB5_MSG_ENC_TICKET_PART,	"EncTicketPart" },
-        { KRB5_MSG_TGS_REQ,		"TGS-REQ" },
-        { KRB5_MSG_TGS_REP,		"TGS-REP" },
-        { KRB5_MSG_AS_REQ,		"AS-REQ" },
-        { KRB5_MSG_AS_REP,		"AS-REP" },
-        { KRB5_MSG_AP_REQ,		"AP-REQ" },
-        { KRB5_MSG_AP_REP,		"AP-REP" },
-        { KRB5_MSG_SAFE,		"KRB-SAFE" },
-        { KRB5_MSG_PRIV,		"KRB-PRIV" },
-        { KRB5_MSG_CRED,		"KRB-CRED" },
-        { KRB5_MSG_ENC_AS_REP_PART,	"EncASRepPart" },
-        { KRB5_MSG_ENC_TGS_REP_PART,	"EncTGSRepPart" },
-        { KRB5_MSG_ENC_AP_REP_PART,	"EncAPRepPart" },
-        { KRB5_MSG_ENC_KRB_PRIV_PART,	"EncKrbPrivPart" },
-        { KRB5_MSG_ENC_KRB_CRED_PART,	"EncKrbCredPart" },
-        { KRB5_MSG_ERROR,		"KRB-ERROR" },
-        { 0, NULL },
-};
+static int
+dissect_krb5_PAC_LOGON_INFO(proto_tree* parent_tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx)
+{
+    proto_item* item;
+    proto_tree* tree;
+    guint8 drep[4] = { 0x10, 0x00, 0x00, 0x00 }; /* fake DREP struct */
+    static dcerpc_info di;      /* fake dcerpc_info struct */
+    static dcerpc_call_value call_data;
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
 
-#define KRB5_GSS_C_DELEG_FLAG             0x01
-#define KRB5_GSS_C_MUTUAL_FLAG            0x02
-#define KRB5_GSS_C_REPLAY_FLAG            0x04
-#define KRB5_GSS_C_SEQUENCE_FLAG          0x08
-#define KRB5_GSS_C_CONF_FLAG              0x10
-#define KRB5_GSS_C_INTEG_FLAG             0x20
-#define KRB5_GSS_C_DCE_STYLE            0x1000
+    /* the logon info carries the user and group SIDs */
+    if (private_data->log && private_data->log->pac_hash == NULL) {
+        guint8 digest[HASH_SHA2_256_LENGTH];
+        guint len = tvb_captured_length_remaining(tvb, offset);
 
-static const true_false_string tfs_gss_flags_deleg = {
-        "Delegate credentials to remote peer",
-        "Do NOT delegate"
-};
-static const true_false_string tfs_gss_flags_mutual = {
-        "Request that remote peer authenticates itself",
-        "Mutual authentication NOT required"
-};
-static const true_false_string tfs_gss_flags_replay = {
-        "Enable replay protection for signed or sealed messages",
-        "Do NOT enable replay protection"
-};
-static const true_false_string tfs_gss_flags_sequence = {
-        "Enable Out-of-sequence detection for sign or sealed messages",
-        "Do NOT enable out-of-sequence detection"
-};
-static const true_false_string tfs_gss_flags_conf = {
-        "Confidentiality (sealing) may be invoked",
-        "Do NOT use Confidentiality (sealing)"
-};
-static const true_false_string tfs_gss_flags_integ = {
-        "Integrity protection (signing) may be invoked",
-        "Do NOT use integrity protection"
-};
+        gcry_md_hash_buffer(GCRY_MD_SHA256, digest, tvb_get_ptr(tvb, offset, len), len);
+        private_data->log->pac_hash = bytes_to_str(wmem_packet_scope(), digest, HASH_SHA2_256_LENGTH);
+    }
 
-static const true_false_string tfs_gss_flags_dce_style = {
-        "DCE-STYLE",
-        "Not using DCE-STYLE"
-};
+    item = proto_tree_add_item(parent_tree, hf_krb_pac_logon_info, tvb, offset, -1, ENC_NA);
+    tree = proto_item_add_subtree(item, ett_krb_pac_logon_info);
 
-#ifdef HAVE_KERBEROS
-static guint8*
-decrypt_krb5_data_asn1(proto_tree* tree, asn1_ctx_t* actx,
-    int usage, tvbuff_t* cryptotvb, int* datalen)
+    /* skip the first 16 bytes, they are some magic created by the idl
+     * compiler   the first 4 bytes might be flags?
+     */
+    offset = dissect_krb5_PAC_NDRHEADERBLOB(tree, tvb, offset, &drep[0], actx);
+
+    /* the PAC_LOGON_INFO blob */
+    /* fake whatever state the dcerpc runtime support needs */
+    di.conformant_run = 0;
+    /* we need di->call_data->flags.NDR64 == 0 */
+    di.call_data = &call_data;
+    init_ndr_pointer_list(&di);
+    offset = dissect_ndr_pointer(tvb, offset, actx->pinfo, tree, &di, drep,
+        netlogon_dissect_PAC_LOGON_INFO, NDR_POINTER_UNIQUE,
+        "PAC_LOGON_INFO:", -1);
+
+    return offset;
+}
+
+
+static int
+dissect_krb5_PAC_CREDENTIAL_DATA(proto_tree* parent_tree, tvbuff_t* tvb, int offset, packet_info* pinfo _U_)
 {
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    proto_tree_add_item(parent_tree, hf_krb_pac_credential_data, tvb, offset, -1, ENC_NA);
 
-#ifdef HAVE_DECRYPT_KRB5_DATA_PRIVATE
-    return decrypt_krb5_data_private(tree, actx->pinfo, private_data,
-        usage, cryptotvb,
-        private_data->etype,
-        datalen);
-#else
-    return decrypt_krb5_data(tree, actx->pinfo, usage, cryptotvb,
-        private_data->etype, datalen);
-#endif
+    return offset;
 }
 
 static int
-dissect_krb5_decrypt_ticket_data(gboolean imp_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx,
-    proto_tree* tree, int hf_index _U_)
+dissect_krb5_PAC_CREDENTIAL_INFO(proto_tree* parent_tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx)
 {
-    guint8* plaintext;
-    int length;
+    proto_item* item;
+    proto_tree* tree;
+    guint8* plaintext = NULL;
+    int plainlen = 0;
+    int length = 0;
+#define KRB5_KU_OTHER_ENCRYPTED 16
+#ifdef  HAVE_KERBEROS
+    guint32 etype;
     tvbuff_t* next_tvb;
+    int usage = KRB5_KU_OTHER_ENCRYPTED;
+#endif
+
+    item = proto_tree_add_item(parent_tree, hf_krb_pac_credential_info, tvb, offset, -1, ENC_NA);
+    tree = proto_item_add_subtree(item, ett_krb_pac_credential_info);
+
+    /* version */
+    proto_tree_add_item(tree, hf_krb_pac_credential_info_version, tvb,
+        offset, 4, ENC_LITTLE_ENDIAN);
+    offset += 4;
+
+#ifdef HAVE_KERBEROS
+    /* etype */
+    etype = tvb_get_letohl(tvb, offset);
+#endif
+    proto_tree_add_item(tree, hf_krb_pac_credential_info_etype, tvb,
+        offset, 4, ENC_LITTLE_ENDIAN);
+    offset += 4;
 
+#ifdef HAVE_KERBEROS
+    /* data */
     next_tvb = tvb_new_subset_remaining(tvb, offset);
     length = tvb_captured_length_remaining(tvb, offset);
 
-    /* draft-ietf-krb-wg-kerberos-clarifications-05.txt :
-     * 7.5.1
-     * All Ticket encrypted parts use usage == 2
-     */
-    plaintext = decrypt_krb5_data_asn1(tree, actx, 2, next_tvb, NULL);
+    plaintext = decrypt_krb5_data(tree, actx->pinfo, usage, next_tvb, (int)etype, &plainlen);
+#endif
 
-    if (plaintext) {
+    if (plaintext != NULL) {
         tvbuff_t* child_tvb;
-        child_tvb = tvb_new_child_real_data(tvb, plaintext, length, length);
+        child_tvb = tvb_new_child_real_data(tvb, plaintext, plainlen, plainlen);
 
         /* Add the decrypted data to the data source list. */
-        add_new_data_source(actx->pinfo, child_tvb, "Krb5 Ticket");
+        add_new_data_source(actx->pinfo, child_tvb, "Krb5 PAC_CREDENTIAL");
 
-        offset = dissect_kerberos_Applications(FALSE, child_tvb, 0, actx, tree, /* hf_index*/ -1);
+        dissect_krb5_PAC_CREDENTIAL_DATA(tree, child_tvb, 0, actx->pinfo);
     }
-    return offset;
+
+    return offset + length;
 }
 
 static int
-dissect_krb5_decrypt_authenticator_data(gboolean imp_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx,
-    proto_tree* tree, int hf_index _U_)
+dissect_krb5_PAC_S4U_DELEGATION_INFO(proto_tree* parent_tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx)
 {
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-    guint8* plaintext;
-    int length;
-    tvbuff_t* next_tvb;
+    proto_item* item;
+    proto_tree* tree;
+    guint8 drep[4] = { 0x10, 0x00, 0x00, 0x00 }; /* fake DREP struct */
+    static dcerpc_info di;      /* fake dcerpc_info struct */
+    static dcerpc_call_value call_data;
 
-    next_tvb = tvb_new_subset_remaining(tvb, offset);
-    length = tvb_captured_length_remaining(tvb, offset);
+    item = proto_tree_add_item(parent_tree, hf_krb_pac_s4u_delegation_info, tvb, offset, -1, ENC_NA);
+    tree = proto_item_add_subtree(item, ett_krb_pac_s4u_delegation_info);
 
-    /* draft-ietf-krb-wg-kerberos-clarifications-05.txt :
-     * 7.5.1
-     * Authenticators are encrypted with usage
-     * == 7 or
-     * == 11
-     *
-     * 7.  TGS-REQ PA-TGS-REQ padata AP-REQ Authenticator
-     *     (includes TGS authenticator subkey), encrypted with the
-     *     TGS session key (section 5.5.1)
-     * 11. AP-REQ Authenticator (includes application
-     *     authenticator subkey), encrypted with the application
-     *     session key (section 5.5.1)
+    /* skip the first 16 bytes, they are some magic created by the idl
+     * compiler   the first 4 bytes might be flags?
      */
-    if (private_data->within_PA_TGS_REQ > 0) {
-        plaintext = decrypt_krb5_data_asn1(tree, actx, 7, next_tvb, NULL);
-    }
-    else {
-        plaintext = decrypt_krb5_data_asn1(tree, actx, 11, next_tvb, NULL);
-    }
+    offset = dissect_krb5_PAC_NDRHEADERBLOB(tree, tvb, offset, &drep[0], actx);
+
+
+    /* the S4U_DELEGATION_INFO blob. See [MS-PAC] */
+    /* fake whatever state the dcerpc runtime support needs */
+    di.conformant_run = 0;
+    /* we need di->call_data->flags.NDR64 == 0 */
+    di.call_data = &call_data;
+    init_ndr_pointer_list(&di);
+    offset = dissect_ndr_pointer(tvb, offset, actx->pinfo, tree, &di, drep,
+        netlogon_dissect_PAC_S4U_DELEGATION_INFO, NDR_POINTER_UNIQUE,
+        "PAC_S4U_DELEGATION_INFO:", -1);
+
+    return offset;
+}
+
+static int
+dissect_krb5_PAC_UPN_DNS_INFO(proto_tree* parent_tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx _U_)
+{
+    proto_item* item;
+    proto_tree* tree;
+    guint16 dns_offset, dns_len;
+    guint16 upn_offset, upn_len;
+
+    item = proto_tree_add_item(parent_tree, hf_krb_pac_upn_dns_info, tvb, offset, -1, ENC_NA);
+    tree = proto_item_add_subtree(item, ett_krb_pac_upn_dns_info);
+
+    /* upn */
+    upn_len = tvb_get_letohs(tvb, offset);
+    proto_tree_add_item(tree, hf_krb_pac_upn_upn_len, tvb, offset, 2, ENC_LITTLE_ENDIAN);
+    offset += 2;
+    upn_offset = tvb_get_letohs(tvb, offset);
+    proto_tree_add_item(tree, hf_krb_pac_upn_upn_offset, tvb, offset, 2, ENC_LITTLE_ENDIAN);
+    offset += 2;
+
+    /* dns */
+    dns_len = tvb_get_letohs(tvb, offset);
+    proto_tree_add_item(tree, hf_krb_pac_upn_dns_len, tvb, offset, 2, ENC_LITTLE_ENDIAN);
+    offset += 2;
+    dns_offset = tvb_get_letohs(tvb, offset);
+    proto_tree_add_item(tree, hf_krb_pac_upn_dns_offset, tvb, offset, 2, ENC_LITTLE_ENDIAN);
+    offset += 2;
 
-    if (plaintext) {
-        tvbuff_t* child_tvb;
-        child_tvb = tvb_new_child_real_data(tvb, plaintext, length, length);
+    /* flags */
+    proto_tree_add_item(tree, hf_krb_pac_upn_flags, tvb, offset, 4, ENC_LITTLE_ENDIAN);
 
-        /* Add the decrypted data to the data source list. */
-        add_new_data_source(actx->pinfo, child_tvb, "Krb5 Authenticator");
+    /* upn */
+    proto_tree_add_item(tree, hf_krb_pac_upn_upn_name, tvb, upn_offset, upn_len, ENC_UTF_16 | ENC_LITTLE_ENDIAN);
 
-        offset = dissect_kerberos_Applications(FALSE, child_tvb, 0, actx, tree, /* hf_index*/ -1);
-    }
-    return offset;
+    /* dns */
+    proto_tree_add_item(tree, hf_krb_pac_upn_dns_name, tvb, dns_offset, dns_len, ENC_UTF_16 | ENC_LITTLE_ENDIAN);
+
+    return dns_offset;
 }
 
-static int
-dissect_krb5_decrypt_authorization_data(gboolean imp_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx,
-    proto_tree* tree, int hf_index _U_)
-{
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-    guint8* plaintext;
-    int length;
-    tvbuff_t* next_tvb;
+/* MS-XCA compression formats of a CLAIMS_SET_METADATA */
+#define KRB_CLAIMS_FORMAT_NONE          0
+#define KRB_CLAIMS_FORMAT_LZNT1         2
+#define KRB_CLAIMS_FORMAT_XPRESS        3
+#define KRB_CLAIMS_FORMAT_XPRESS_HUFF   4
 
-    next_tvb = tvb_new_subset_remaining(tvb, offset);
-    length = tvb_captured_length_remaining(tvb, offset);
+/* Copy a back-reference; the source may overlap the bytes being written */
+static inline void
+kerberos_lz_copy(guint8* out, guint out_pos, guint disp, guint len)
+{
+    guint8* dst = out + out_pos;
+    const guint8* src = dst - disp;
 
-    /* draft-ietf-krb-wg-kerberos-clarifications-05.txt :
-     * 7.5.1
-     * Authenticators are encrypted with usage
-     * == 5 or
-     * == 4
-     *
-     * 4. TGS-REQ KDC-REQ-BODY AuthorizationData, encrypted with
-     *    the TGS session key (section 5.4.1)
-     * 5. TGS-REQ KDC-REQ-BODY AuthorizationData, encrypted with
-     *    the TGS authenticator subkey (section 5.4.1)
-     */
-    if (private_data->PA_TGS_REQ_subkey != NULL) {
-        plaintext = decrypt_krb5_data_asn1(tree, actx, 5, next_tvb, NULL);
+    if (disp >= len) {
+        memcpy(dst, src, len);
+        return;
     }
-    else {
-        plaintext = decrypt_krb5_data_asn1(tree, actx, 4, next_tvb, NULL);
+    while (len--) {
+        *dst++ = *src++;
     }
+}
 
-    if (plaintext) {
-        tvbuff_t* child_tvb;
-        child_tvb = tvb_new_child_real_data(tvb, plaintext, length, length);
+/* LZNT1 (MS-XCA 2.5): 4 KiB chunks, a flag byte per eight tokens and a
+ * 16-bit back-reference whose offset/length split depends on how far into
+ * the chunk the output is. Returns the number of bytes written or -1.
+ */
+static gint
+kerberos_lznt1_decompress(const guint8* in, guint in_len, guint8* out, guint out_len)
+{
+    guint in_pos = 0, out_pos = 0;
 
-        /* Add the decrypted data to the data source list. */
-        add_new_data_source(actx->pinfo, child_tvb, "Krb5 AuthorizationData");
+    while (in_pos + 2 <= in_len) {
+        guint header = pletoh16(in + in_pos);
+        guint chunk_len = (header & 0x0FFF) + 1;
+        guint chunk_start = out_pos;
+        guint chunk_end;
 
-        offset = dissect_kerberos_AuthorizationData(FALSE, child_tvb, 0, actx, tree, /* hf_index*/ -1);
+        if (header == 0) {
+            break;
+        }
+        in_pos += 2;
+        if (chunk_len > in_len - in_pos) {
+            return -1;
+        }
+        chunk_end = in_pos + chunk_len;
+
+        if (!(header & 0x8000)) {
+            if (chunk_len > out_len - out_pos) {
+                return -1;
+            }
+            memcpy(out + out_pos, in + in_pos, chunk_len);
+            out_pos += chunk_len;
+            in_pos = chunk_end;
+            continue;
+        }
+
+        while (in_pos < chunk_end) {
+            guint flags = in[in_pos++];
+            guint bit;
+
+            for (bit = 0; bit < 8 && in_pos < chunk_end; bit++, flags >>= 1) {
+                guint token, pos, shift, disp, len;
+
+                if (!(flags & 1)) {
+                    if (out_pos >= out_len) {
+                        return -1;
+                    }
+                    out[out_pos++] = in[in_pos++];
+                    continue;
+                }
+                if (in_pos + 2 > chunk_end) {
+                    return -1;
+                }
+                token = pletoh16(in + in_pos);
+                in_pos += 2;
+                pos = out_pos - chunk_start;
+                if (pos == 0 || pos > 4096) {
+                    return -1;
+                }
+                shift = (pos - 1) < 16 ? 12 : 16 - g_bit_storage(pos - 1);
+                len = (token & ((1U << shift) - 1)) + 3;
+                disp = (token >> shift) + 1;
+                if (disp > pos || len > out_len - out_pos) {
+                    return -1;
+                }
+                kerberos_lz_copy(out, out_pos, disp, len);
+                out_pos += len;
+            }
+        }
     }
-    return offset;
+
+    return (gint)out_pos;
 }
 
-static int
-dissect_krb5_decrypt_KDC_REP_data(gboolean imp_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx,
-    proto_tree* tree, int hf_index _U_)
+/* Plain LZ77 Xpress (MS-XCA 2.4): 32 flag bits at a time, 16-bit
+ * back-references, with longer lengths in shared nibbles and extra bytes.
+ */
+static gint
+kerberos_xpress_decompress(const guint8* in, guint in_len, guint8* out, guint out_len)
 {
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-    guint8* plaintext = NULL;
-    int length;
-    tvbuff_t* next_tvb;
+    guint in_pos = 0, out_pos = 0, nibble_pos = 0;
+    guint32 flags = 0;
+    guint flag_count = 0;
 
-    next_tvb = tvb_new_subset_remaining(tvb, offset);
-    length = tvb_captured_length_remaining(tvb, offset);
+    while (out_pos < out_len) {
+        guint match, disp, len;
 
-    /* draft-ietf-krb-wg-kerberos-clarifications-05.txt :
-     * 7.5.1
-     * ASREP/TGSREP encryptedparts are encrypted with usage
-     * == 3 or
-     * == 8 or
-     * == 9
-     *
-     * 3. AS-REP encrypted part (includes TGS session key or
-     *    application session key), encrypted with the client key
-     *    (section 5.4.2)
-     *
-     * 8. TGS-REP encrypted part (includes application session
-     *    key), encrypted with the TGS session key (section
-     *    5.4.2)
-     * 9. TGS-REP encrypted part (includes application session
-     *    key), encrypted with the TGS authenticator subkey
-     *    (section 5.4.2)
-     *
-     * We currently don't have a way to find the TGS-REQ state
-     * in order to check if an authenticator subkey was used.
-     *
-     * But if we client used FAST and we got a strengthen_key,
-     * we're sure an authenticator subkey was used.
-     *
-     * Windows don't use an authenticator subkey without FAST,
-     * but heimdal does.
-     *
-     * For now try 8 before 9 in order to avoid overhead and false
-     * positives for the 'kerberos.missing_keytype' filter in pure
-     * windows captures.
-     */
-    switch (private_data->msg_type) {
-    case KERBEROS_APPLICATIONS_AS_REP:
-        plaintext = decrypt_krb5_data_asn1(tree, actx, 3, next_tvb, NULL);
-        break;
-    case KERBEROS_APPLICATIONS_TGS_REP:
-        if (private_data->fast_strengthen_key != NULL) {
-            plaintext = decrypt_krb5_data_asn1(tree, actx, 9, next_tvb, NULL);
+        if (flag_count == 0) {
+            if (in_pos + 4 > in_len) {
+                return -1;
+            }
+            flags = pletoh32(in + in_pos);
+            in_pos += 4;
+            flag_count = 32;
         }
-        else {
-            plaintext = decrypt_krb5_data_asn1(tree, actx, 8, next_tvb, NULL);
-            if (!plaintext) {
-                plaintext = decrypt_krb5_data_asn1(tree, actx, 9, next_tvb, NULL);
+        flag_count--;
+
+        if (!(flags & (1U << flag_count))) {
+            if (in_pos >= in_len) {
+                return -1;
             }
+            out[out_pos++] = in[in_pos++];
+            continue;
         }
-        break;
+
+        if (in_pos + 2 > in_len) {
+            return -1;
+        }
+        match = pletoh16(in + in_pos);
+        in_pos += 2;
+        len = match & 7;
+        disp = (match >> 3) + 1;
+        if (len == 7) {
+            if (nibble_pos == 0) {
+                if (in_pos >= in_len) {
+                    return -1;
+                }
+                nibble_pos = in_pos;
+                len = in[in_pos++] & 0x0F;
+            } else {
+                len = in[nibble_pos] >> 4;
+                nibble_pos = 0;
+            }
+            if (len == 15) {
+                if (in_pos >= in_len) {
+                    return -1;
+                }
+                len = in[in_pos++];
+                if (len == 255) {
+                    if (in_pos + 2 > in_len) {
+                        return -1;
+                    }
+                    len = pletoh16(in + in_pos);
+                    in_pos += 2;
+                    if (len == 0) {
+                        if (in_pos + 4 > in_len) {
+                            return -1;
+                        }
+                        len = pletoh32(in + in_pos);
+                        in_pos += 4;
+                    }
+                    if (len < 15 + 7) {
+                        return -1;
+                    }
+                    len -= 15 + 7;
+                }
+                len += 15;
+            }
+            len += 7;
+        }
+        len += 3;
+        if (disp > out_pos || len > out_len - out_pos) {
+            return -1;
+        }
+        kerberos_lz_copy(out, out_pos, disp, len);
+        out_pos += len;
     }
 
-    if (plaintext) {
-        tvbuff_t* child_tvb;
-        child_tvb = tvb_new_child_real_data(tvb, plaintext, length, length);
+    return (gint)out_pos;
+}
 
-        /* Add the decrypted data to the data source list. */
-        add_new_data_source(actx->pinfo, child_tvb, "Krb5 KDC-REP");
+/* LZ77+Huffman Xpress (MS-XCA 2.2): per 64 KiB of output a table of 512
+ * 4-bit code lengths, then canonical codes of at most 15 bits read MSB
+ * first from 16-bit little-endian words. Symbols decode with a single
+ * lookup of the next 15 bits in a full-width table.
+ */
+#define KRB_XPRESS_HUFF_BITS 15
 
-        offset = dissect_kerberos_Applications(FALSE, child_tvb, 0, actx, tree, /* hf_index*/ -1);
+static guint16 kerberos_xpress_huff_table[1 << KRB_XPRESS_HUFF_BITS];
+
+static gboolean
+kerberos_xpress_huff_build(const guint8* packed, guint8* lengths)
+{
+    guint count[16] = { 0 };
+    guint next[16];
+    guint sym, len, entry = 0;
+
+    for (sym = 0; sym < 512; sym++) {
+        lengths[sym] = (packed[sym >> 1] >> ((sym & 1) * 4)) & 0x0F;
+        count[lengths[sym]]++;
     }
-    return offset;
+    /* symbols of the same length fill consecutive runs, shortest first */
+    for (len = 1; len <= KRB_XPRESS_HUFF_BITS; len++) {
+        next[len] = entry;
+        entry += count[len] << (KRB_XPRESS_HUFF_BITS - len);
+    }
+    if (entry != (1U << KRB_XPRESS_HUFF_BITS)) {
+        return FALSE;
+    }
+    for (sym = 0; sym < 512; sym++) {
+        guint16* p;
+        guint n;
+
+        if (lengths[sym] == 0) {
+            continue;
+        }
+        n = 1U << (KRB_XPRESS_HUFF_BITS - lengths[sym]);
+        p = kerberos_xpress_huff_table + next[lengths[sym]];
+        next[lengths[sym]] += n;
+        while (n--) {
+            *p++ = (guint16)sym;
+        }
+    }
+    return TRUE;
 }
 
-static int
-dissect_krb5_decrypt_PA_ENC_TIMESTAMP(gboolean imp_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx,
-    proto_tree* tree, int hf_index _U_)
-{
-    guint8* plaintext;
-    int length;
-    tvbuff_t* next_tvb;
+/* the bit reader runs up to two words past the data at the very end */
+#define KRB_XPRESS_WORD(in, in_len, pos) ((pos) + 2 <= (in_len) ? pletoh16((in) + (pos)) : 0)
 
-    next_tvb = tvb_new_subset_remaining(tvb, offset);
-    length = tvb_captured_length_remaining(tvb, offset);
+static gint
+kerberos_xpress_huff_decompress(const guint8* in, guint in_len, guint8* out, guint out_len)
+{
+    guint8 lengths[512];
+    guint in_pos = 0, out_pos = 0;
+    guint block_end = 0;
 
-    /* draft-ietf-krb-wg-kerberos-clarifications-05.txt :
-     * 7.5.1
-     * AS-REQ PA_ENC_TIMESTAMP are encrypted with usage
-     * == 1
-     */
-    plaintext = decrypt_krb5_data_asn1(tree, actx, 1, next_tvb, NULL);
+    while (out_pos < out_len) {
+        guint32 bits;
+        gint extra;
 
-    if (plaintext) {
-        tvbuff_t* child_tvb;
-        child_tvb = tvb_new_child_real_data(tvb, plaintext, length, length);
+        if (in_pos + 256 > in_len || !kerberos_xpress_huff_build(in + in_pos, lengths)) {
+            return -1;
+        }
+        in_pos += 256;
+        bits = (guint32)KRB_XPRESS_WORD(in, in_len, in_pos) << 16;
+        bits |= KRB_XPRESS_WORD(in, in_len, in_pos + 2);
+        in_pos += 4;
+        extra = 16;
+        /* every table covers the next 64 KiB of output from where the last
+         * one's block ended; a match running over the end shortens this one */
+        block_end = out_len - block_end > 65536 ? block_end + 65536 : out_len;
+
+        while (out_pos < block_end) {
+            guint sym, len, nbits, disp;
+
+            if (in_pos > in_len + 4) {
+                return -1;
+            }
+            sym = kerberos_xpress_huff_table[bits >> (32 - KRB_XPRESS_HUFF_BITS)];
+            nbits = lengths[sym];
+            bits <<= nbits;
+            extra -= nbits;
+            if (extra < 0) {
+                bits |= (guint32)KRB_XPRESS_WORD(in, in_len, in_pos) << -extra;
+                in_pos += 2;
+                extra += 16;
+            }
 
-        /* Add the decrypted data to the data source list. */
-        add_new_data_source(actx->pinfo, child_tvb, "Krb5 EncTimestamp");
+            if (sym < 256) {
+                out[out_pos++] = (guint8)sym;
+                continue;
+            }
 
-        offset = dissect_kerberos_PA_ENC_TS_ENC(FALSE, child_tvb, 0, actx, tree, /* hf_index*/ -1);
+            sym -= 256;
+            len = sym & 0x0F;
+            nbits = sym >> 4;
+            if (len == 15) {
+                if (in_pos >= in_len) {
+                    return -1;
+                }
+                len = in[in_pos++];
+                if (len == 255) {
+                    if (in_pos + 2 > in_len) {
+                        return -1;
+                    }
+                    len = pletoh16(in + in_pos);
+                    in_pos += 2;
+                    if (len < 15) {
+                        return -1;
+                    }
+                    len -= 15;
+                }
+                len += 15;
+            }
+            len += 3;
+
+            disp = 1U << nbits;
+            if (nbits) {
+                disp += bits >> (32 - nbits);
+                bits <<= nbits;
+                extra -= nbits;
+                if (extra < 0) {
+                    bits |= (guint32)KRB_XPRESS_WORD(in, in_len, in_pos) << -extra;
+                    in_pos += 2;
+                    extra += 16;
+                }
+            }
+            if (disp > out_pos || len > out_len - out_pos) {
+                return -1;
+            }
+            kerberos_lz_copy(out, out_pos, disp, len);
+            out_pos += len;
+        }
     }
-    return offset;
+
+    return (gint)out_pos;
 }
 
-static int
-dissect_krb5_decrypt_AP_REP_data(gboolean imp_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx,
-    proto_tree* tree, int hf_index _U_)
-{
-    guint8* plaintext;
-    int length;
-    tvbuff_t* next_tvb;
+/*
+ * PAC claims (MS-PAC 2.11 and 2.12, MS-ADTS 2.2.18). The buffer holds a
+ * type-serialized CLAIMS_SET_METADATA whose ClaimsSet, another
+ * type-serialized CLAIMS_SET, is usually compressed with one of the
+ * MS-XCA formats. The same claims ride in every ticket of a user, and so
+ * in every AP-REQ, so decompression goes through one reusable buffer and
+ * the result is kept per claims set (SHA-256 of the compressed bytes).
+ * None of this is done unless there is a tree to show the claims in.
+ */
+#define KRB_MAX_CLAIMS_SIZE     (4 * 1024 * 1024)
+#define KRB_MAX_CLAIMS_CACHE    1024
+#define KRB_MAX_CLAIMS_CACHE_BYTES (16 * 1024 * 1024)
+/* cache key: SHA-256 of the compressed bytes, uncompressed size, format */
+#define KRB_CLAIMS_KEY_LENGTH   (HASH_SHA2_256_LENGTH + 2 * sizeof(guint32))
+
+#define KRB_CLAIM_TYPE_INT64    1
+#define KRB_CLAIM_TYPE_UINT64   2
+#define KRB_CLAIM_TYPE_STRING   3
+#define KRB_CLAIM_TYPE_BOOLEAN  6
+
+static const value_string krb_pac_claims_compression_vals[] = {
+    { KRB_CLAIMS_FORMAT_NONE, "None" },
+    { KRB_CLAIMS_FORMAT_LZNT1, "LZNT1" },
+    { KRB_CLAIMS_FORMAT_XPRESS, "Xpress" },
+    { KRB_CLAIMS_FORMAT_XPRESS_HUFF, "Xpress Huffman" },
+    { 0, NULL }
+};
 
-    next_tvb = tvb_new_subset_remaining(tvb, offset);
-    length = tvb_captured_length_remaining(tvb, offset);
+static const value_string krb_pac_claims_source_vals[] = {
+    { 1, "AD" },
+    { 2, "Certificate" },
+    { 0, NULL }
+};
 
-    /* draft-ietf-krb-wg-kerberos-clarifications-05.txt :
-     * 7.5.1
-     * AP-REP are encrypted with usage == 12
-     */
-    plaintext = decrypt_krb5_data_asn1(tree, actx, 12, next_tvb, NULL);
+static const value_string krb_pac_claim_type_vals[] = {
+    { KRB_CLAIM_TYPE_INT64, "INT64" },
+    { KRB_CLAIM_TYPE_UINT64, "UINT64" },
+    { KRB_CLAIM_TYPE_STRING, "STRING" },
+    { KRB_CLAIM_TYPE_BOOLEAN, "BOOLEAN" },
+    { 0, NULL }
+};
 
-    if (plaintext) {
-        tvbuff_t* child_tvb;
-        child_tvb = tvb_new_child_real_data(tvb, plaintext, length, length);
+static guint8* kerberos_claims_buf = NULL;
+static guint kerberos_claims_buf_size = 0;
 
-        /* Add the decrypted data to the data source list. */
-        add_new_data_source(actx->pinfo, child_tvb, "Krb5 AP-REP");
+/* A claims set, empty if it failed, and its place in kerberos_claims_lru */
+typedef struct {
+    GBytes* set;
+    GList link;             /* data: the cache key */
+} kerberos_claims_entry_t;
 
-        offset = dissect_kerberos_Applications(FALSE, child_tvb, 0, actx, tree, /* hf_index*/ -1);
+/* GBytes (digest, size, format) -> kerberos_claims_entry_t, bounded by
+ * KRB_MAX_CLAIMS_CACHE entries and KRB_MAX_CLAIMS_CACHE_BYTES of claims
+ * sets; the least recently used go first */
+static GHashTable* kerberos_claims_cache = NULL;
+static GQueue kerberos_claims_lru = G_QUEUE_INIT;
+static guint64 kerberos_claims_cache_bytes = 0;
+
+static void
+kerberos_claims_entry_free(gpointer data)
+{
+    kerberos_claims_entry_t* entry = (kerberos_claims_entry_t*)data;
+
+    kerberos_claims_cache_bytes -= g_bytes_get_size(entry->set);
+    g_bytes_unref(entry->set);
+    g_free(entry);
+}
+
+/* Make room for a set of size bytes */
+static void
+kerberos_claims_evict(gsize size)
+{
+    GList* oldest;
+
+    while (g_hash_table_size(kerberos_claims_cache) >= KRB_MAX_CLAIMS_CACHE ||
+        (kerberos_claims_lru.length > 0 && kerberos_claims_cache_bytes + size > KRB_MAX_CLAIMS_CACHE_BYTES)) {
+        oldest = g_queue_pop_head_link(&kerberos_claims_lru);
+        g_hash_table_remove(kerberos_claims_cache, oldest->data);
     }
-    return offset;
 }
 
-static int
-dissect_krb5_decrypt_PRIV_data(gboolean imp_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx,
-    proto_tree* tree, int hf_index _U_)
+static void
+kerberos_claims_cleanup(void)
 {
-    guint8* plaintext;
-    int length;
-    tvbuff_t* next_tvb;
+    if (kerberos_claims_cache != NULL) {
+        g_hash_table_destroy(kerberos_claims_cache);
+        kerberos_claims_cache = NULL;
+    }
+    g_queue_init(&kerberos_claims_lru);
+    kerberos_claims_cache_bytes = 0;
+    g_free(kerberos_claims_buf);
+    kerberos_claims_buf = NULL;
+    kerberos_claims_buf_size = 0;
+}
 
-    next_tvb = tvb_new_subset_remaining(tvb, offset);
-    length = tvb_captured_length_remaining(tvb, offset);
+static void
+kerberos_mem_claims(guint* count, guint64* bytes)
+{
+    *count = kerberos_claims_cache ? g_hash_table_size(kerberos_claims_cache) : 0;
+    *bytes = kerberos_claims_cache_bytes + kerberos_claims_buf_size +
+        (guint64)*count * (BER_MEM_MAP_ENTRY + KRB_CLAIMS_KEY_LENGTH + sizeof(kerberos_claims_entry_t));
+}
 
-    /* RFC4120 :
-     * EncKrbPrivPart encrypted with usage
-     * == 13
-     */
-    plaintext = decrypt_krb5_data_asn1(tree, actx, 13, next_tvb, NULL);
+static tvbuff_t*
+kerberos_claims_uncompress(packet_info* pinfo, tvbuff_t* tvb, int offset, guint length, guint format, guint size)
+{
+    guint8 key[KRB_CLAIMS_KEY_LENGTH];
+    const guint8* in;
+    const guint8* data;
+    GBytes* lookup;
+    GBytes* set;
+    kerberos_claims_entry_t* entry;
+    gsize set_len;
+    tvbuff_t* set_tvb;
+
+    if (size == 0 || size > KRB_MAX_CLAIMS_SIZE || !tvb_bytes_exist(tvb, offset, length)) {
+        return NULL;
+    }
+    in = tvb_get_ptr(tvb, offset, length);
 
-    if (plaintext) {
-        tvbuff_t* child_tvb;
-        child_tvb = tvb_new_child_real_data(tvb, plaintext, length, length);
+    gcry_md_hash_buffer(GCRY_MD_SHA256, key, in, length);
+    phtole32(key + HASH_SHA2_256_LENGTH, size);
+    phtole32(key + HASH_SHA2_256_LENGTH + 4, format);
+
+    if (kerberos_claims_cache == NULL) {
+        kerberos_claims_cache = g_hash_table_new_full(g_bytes_hash, g_bytes_equal,
+            (GDestroyNotify)g_bytes_unref, kerberos_claims_entry_free);
+    }
+    lookup = g_bytes_new_static(key, sizeof(key));
+    entry = (kerberos_claims_entry_t*)g_hash_table_lookup(kerberos_claims_cache, lookup);
+    g_bytes_unref(lookup);
+
+    if (entry != NULL) {
+        set = entry->set;
+        g_queue_unlink(&kerberos_claims_lru, &entry->link);
+        g_queue_push_tail_link(&kerberos_claims_lru, &entry->link);
+    } else {
+        gint ret = -1;
+
+        if (kerberos_claims_buf_size < size) {
+            kerberos_claims_buf = (guint8*)g_realloc(kerberos_claims_buf, size);
+            kerberos_claims_buf_size = size;
+        }
+        switch (format) {
+        case KRB_CLAIMS_FORMAT_LZNT1:
+            ret = kerberos_lznt1_decompress(in, length, kerberos_claims_buf, size);
+            break;
+        case KRB_CLAIMS_FORMAT_XPRESS:
+            ret = kerberos_xpress_decompress(in, length, kerberos_claims_buf, size);
+            break;
+        case KRB_CLAIMS_FORMAT_XPRESS_HUFF:
+            ret = kerberos_xpress_huff_decompress(in, length, kerberos_claims_buf, size);
+            break;
+        default:
+            break;
+        }
+        set = g_bytes_new(ret == (gint)size ? kerberos_claims_buf : NULL, ret == (gint)size ? size : 0);
 
-        /* Add the decrypted data to the data source list. */
-        add_new_data_source(actx->pinfo, child_tvb, "Krb5 PRIV");
+        kerberos_claims_evict(g_bytes_get_size(set));
+        entry = g_new0(kerberos_claims_entry_t, 1);
+        entry->set = set;
+        entry->link.data = g_bytes_new(key, sizeof(key));
+        g_hash_table_insert(kerberos_claims_cache, entry->link.data, entry);
+        g_queue_push_tail_link(&kerberos_claims_lru, &entry->link);
+        kerberos_claims_cache_bytes += g_bytes_get_size(set);
+    }
 
-        offset = dissect_kerberos_Applications(FALSE, child_tvb, 0, actx, tree, /* hf_index*/ -1);
+    data = (const guint8*)g_bytes_get_data(set, &set_len);
+    if (set_len == 0) {
+        return NULL;
     }
-    return offset;
+    /* the cache may be flushed before the tree is done with the data */
+    set_tvb = tvb_new_child_real_data(tvb, (const guint8*)wmem_memdup(wmem_packet_scope(), data, set_len),
+        (guint)set_len, (gint)set_len);
+    add_new_data_source(pinfo, set_tvb, "Decompressed claims");
+
+    return set_tvb;
 }
 
+/* CLAIMS_SET and below, in the manner of the PIDL generated NDR dissectors */
 static int
-dissect_krb5_decrypt_CRED_data(gboolean imp_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx,
-    proto_tree* tree, int hf_index _U_)
+kerberos_claims_dissect_string(tvbuff_t* tvb, int offset, packet_info* pinfo, proto_tree* tree, dcerpc_info* di, guint8* drep)
 {
-    guint8* plaintext;
-    int length;
-    tvbuff_t* next_tvb;
-
-    next_tvb = tvb_new_subset_remaining(tvb, offset);
-    length = tvb_captured_length_remaining(tvb, offset);
-
-    /* RFC4120 :
-     * EncKrbCredPart encrypted with usage
-     * == 14
-     */
-    plaintext = decrypt_krb5_data_asn1(tree, actx, 14, next_tvb, NULL);
-
-    if (plaintext) {
-        tvbuff_t* child_tvb;
-        child_tvb = tvb_new_child_real_data(tvb, plaintext, length, length);
-
-        /* Add the decrypted data to the data source list. */
-        add_new_data_source(actx->pinfo, child_tvb, "Krb5 CRED");
+    return dissect_ndr_cvstring(tvb, offset, pinfo, tree, di, drep, sizeof(guint16),
+        hf_krb_pac_claim_string, FALSE, NULL);
+}
 
-        offset = dissect_kerberos_Applications(FALSE, child_tvb, 0, actx, tree, /* hf_index*/ -1);
-    }
-    return offset;
+static int
+kerberos_claims_dissect_string_ptr(tvbuff_t* tvb, int offset, packet_info* pinfo, proto_tree* tree, dcerpc_info* di, guint8* drep)
+{
+    return dissect_ndr_embedded_pointer(tvb, offset, pinfo, tree, di, drep,
+        kerberos_claims_dissect_string, NDR_POINTER_UNIQUE, "String", -1);
 }
 
 static int
-dissect_krb5_decrypt_KrbFastReq(gboolean imp_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx,
-    proto_tree* tree, int hf_index _U_)
+kerberos_claims_dissect_string_values(tvbuff_t* tvb, int offset, packet_info* pinfo, proto_tree* tree, dcerpc_info* di, guint8* drep)
 {
-    guint8* plaintext;
-    int length;
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-    tvbuff_t* next_tvb;
+    return dissect_ndr_ucarray(tvb, offset, pinfo, tree, di, drep, kerberos_claims_dissect_string_ptr);
+}
 
-    next_tvb = tvb_new_subset_remaining(tvb, offset);
-    length = tvb_captured_length_remaining(tvb, offset);
+static int
+kerberos_claims_dissect_int64(tvbuff_t* tvb, int offset, packet_info* pinfo, proto_tree* tree, dcerpc_info* di, guint8* drep)
+{
+    return dissect_ndr_uint64(tvb, offset, pinfo, tree, di, drep, hf_krb_pac_claim_int64, NULL);
+}
 
-    private_data->fast_armor_key = NULL;
-    if (private_data->PA_FAST_ARMOR_AP_subkey != NULL) {
-        krb5_fast_key(actx, tree, tvb,
-            private_data->PA_FAST_ARMOR_AP_subkey,
-            "subkeyarmor",
-            private_data->PA_FAST_ARMOR_AP_key,
-            "ticketarmor",
-            "KrbFastReq_FAST_armorKey");
-        if (private_data->PA_TGS_REQ_subkey != NULL) {
-            enc_key_t* explicit_armor_key = private_data->last_added_key;
+static int
+kerberos_claims_dissect_int64_values(tvbuff_t* tvb, int offset, packet_info* pinfo, proto_tree* tree, dcerpc_info* di, guint8* drep)
+{
+    return dissect_ndr_ucarray(tvb, offset, pinfo, tree, di, drep, kerberos_claims_dissect_int64);
+}
 
-            /*
-             * See [MS-KILE] 3.3.5.7.4 Compound Identity
-             */
-            krb5_fast_key(actx, tree, tvb,
-                explicit_armor_key,
-                "explicitarmor",
-                private_data->PA_TGS_REQ_subkey,
-                "tgsarmor",
-                "KrbFastReq_explicitArmorKey");
-        }
-        private_data->fast_armor_key = private_data->last_added_key;
-    }
-    else if (private_data->PA_TGS_REQ_subkey != NULL) {
-        krb5_fast_key(actx, tree, tvb,
-            private_data->PA_TGS_REQ_subkey,
-            "subkeyarmor",
-            private_data->PA_TGS_REQ_key,
-            "ticketarmor",
-            "KrbFastReq_TGS_armorKey");
-        private_data->fast_armor_key = private_data->last_added_key;
-    }
+static int
+kerberos_claims_dissect_uint64(tvbuff_t* tvb, int offset, packet_info* pinfo, proto_tree* tree, dcerpc_info* di, guint8* drep)
+{
+    return dissect_ndr_uint64(tvb, offset, pinfo, tree, di, drep, hf_krb_pac_claim_uint64, NULL);
+}
 
-    /* RFC6113 :
-     * KrbFastResponse encrypted with usage
-     * KEY_USAGE_FAST_ENC 51
-     */
-    plaintext = decrypt_krb5_data_asn1(tree, actx, KEY_USAGE_FAST_ENC,
-        next_tvb, NULL);
+static int
+kerberos_claims_dissect_uint64_values(tvbuff_t* tvb, int offset, packet_info* pinfo, proto_tree* tree, dcerpc_info* di, guint8* drep)
+{
+    return dissect_ndr_ucarray(tvb, offset, pinfo, tree, di, drep, kerberos_claims_dissect_uint64);
+}
 
-    if (plaintext) {
-        tvbuff_t* child_tvb;
-        child_tvb = tvb_new_child_real_data(tvb, plaintext, length, length);
+static int
+kerberos_claims_dissect_boolean(tvbuff_t* tvb, int offset, packet_info* pinfo, proto_tree* tree, dcerpc_info* di, guint8* drep)
+{
+    guint64 value;
 
-        /* Add the decrypted data to the data source list. */
-        add_new_data_source(actx->pinfo, child_tvb, "Krb5 FastReq");
+    offset = dissect_ndr_uint64(tvb, offset, pinfo, tree, di, drep, -1, &value);
+    proto_tree_add_boolean(tree, hf_krb_pac_claim_boolean, tvb, offset - 8, 8, value != 0);
 
-        offset = dissect_kerberos_KrbFastReq(FALSE, child_tvb, 0, actx, tree, /* hf_index*/ -1);
-    }
     return offset;
 }
 
 static int
-dissect_krb5_decrypt_KrbFastResponse(gboolean imp_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx,
-    proto_tree* tree, int hf_index _U_)
+kerberos_claims_dissect_boolean_values(tvbuff_t* tvb, int offset, packet_info* pinfo, proto_tree* tree, dcerpc_info* di, guint8* drep)
 {
-    guint8* plaintext;
-    int length;
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-    tvbuff_t* next_tvb;
-
-    next_tvb = tvb_new_subset_remaining(tvb, offset);
-    length = tvb_captured_length_remaining(tvb, offset);
+    return dissect_ndr_ucarray(tvb, offset, pinfo, tree, di, drep, kerberos_claims_dissect_boolean);
+}
 
-    /*
-     * RFC6113 :
-     * KrbFastResponse encrypted with usage
-     * KEY_USAGE_FAST_REP 52
-     */
-    plaintext = decrypt_krb5_data_asn1(tree, actx, KEY_USAGE_FAST_REP,
-        next_tvb, NULL);
+static int
+kerberos_claims_dissect_claim_id(tvbuff_t* tvb, int offset, packet_info* pinfo, proto_tree* tree, dcerpc_info* di, guint8* drep)
+{
+    char* id = NULL;
 
-    if (plaintext) {
-        tvbuff_t* child_tvb;
-        child_tvb = tvb_new_child_real_data(tvb, plaintext, length, length);
+    offset = dissect_ndr_cvstring(tvb, offset, pinfo, tree, di, drep, sizeof(guint16),
+        hf_krb_pac_claim_id, FALSE, &id);
+    if (id != NULL) {
+        proto_item_append_text(tree, ": %s", id);
+    }
 
-        /* Add the decrypted data to the data source list. */
-        add_new_data_source(actx->pinfo, child_tvb, "Krb5 FastRep");
+    return offset;
+}
 
-        private_data->fast_armor_key = private_data->last_decryption_key;
-        offset = dissect_kerberos_KrbFastResponse(FALSE, child_tvb, 0, actx, tree, /* hf_index*/ -1);
+static int
+kerberos_claims_dissect_CLAIM_ENTRY(tvbuff_t* tvb, int offset, packet_info* pinfo, proto_tree* parent_tree, dcerpc_info* di, guint8* drep)
+{
+    proto_item* item = NULL;
+    proto_tree* tree;
+    dcerpc_dissect_fnct_t* values_fn;
+    int old_offset;
+    guint16 type;
+
+    ALIGN_TO_4_BYTES;
+    old_offset = offset;
+    tree = proto_tree_add_subtree(parent_tree, tvb, offset, -1, ett_krb_pac_claim_entry, &item, "CLAIM_ENTRY");
+
+    offset = dissect_ndr_embedded_pointer(tvb, offset, pinfo, tree, di, drep,
+        kerberos_claims_dissect_claim_id, NDR_POINTER_UNIQUE, "Id", -1);
+    offset = dissect_ndr_uint16(tvb, offset, pinfo, tree, di, drep, hf_krb_pac_claim_type, &type);
+
+    /* the Values union: its discriminant again, then the arm */
+    ALIGN_TO_4_BYTES;
+    offset = dissect_ndr_uint16(tvb, offset, pinfo, tree, di, drep, -1, &type);
+    switch (type) {
+    case KRB_CLAIM_TYPE_INT64:
+        values_fn = kerberos_claims_dissect_int64_values;
+        break;
+    case KRB_CLAIM_TYPE_UINT64:
+        values_fn = kerberos_claims_dissect_uint64_values;
+        break;
+    case KRB_CLAIM_TYPE_STRING:
+        values_fn = kerberos_claims_dissect_string_values;
+        break;
+    case KRB_CLAIM_TYPE_BOOLEAN:
+        values_fn = kerberos_claims_dissect_boolean_values;
+        break;
+    default:
+        /* no way to tell how big the arm is */
+        proto_item_set_len(item, offset - old_offset);
+        return offset;
     }
+    offset = dissect_ndr_uint32(tvb, offset, pinfo, tree, di, drep, hf_krb_pac_claim_value_count, NULL);
+    offset = dissect_ndr_embedded_pointer(tvb, offset, pinfo, tree, di, drep,
+        values_fn, NDR_POINTER_UNIQUE, "Values", -1);
+
+    proto_item_set_len(item, offset - old_offset);
     return offset;
 }
 
 static int
-dissect_krb5_decrypt_EncryptedChallenge(gboolean imp_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx,
-    proto_tree* tree, int hf_index _U_)
+kerberos_claims_dissect_claim_entries(tvbuff_t* tvb, int offset, packet_info* pinfo, proto_tree* tree, dcerpc_info* di, guint8* drep)
 {
-    guint8* plaintext;
-    int length;
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-    tvbuff_t* next_tvb;
-    int usage = 0;
-    const char* name = NULL;
-
-    next_tvb = tvb_new_subset_remaining(tvb, offset);
-    length = tvb_captured_length_remaining(tvb, offset);
+    return dissect_ndr_ucarray(tvb, offset, pinfo, tree, di, drep, kerberos_claims_dissect_CLAIM_ENTRY);
+}
 
-    /* RFC6113 :
-     * KEY_USAGE_ENC_CHALLENGE_CLIENT  54
-     * KEY_USAGE_ENC_CHALLENGE_KDC     55
-     */
-    if (kerberos_private_is_kdc_req(private_data)) {
-        usage = KEY_USAGE_ENC_CHALLENGE_CLIENT;
-        name = "Krb5 CHALLENGE_CLIENT";
-    }
-    else {
-        usage = KEY_USAGE_ENC_CHALLENGE_KDC;
-        name = "Krb5 CHALLENGE_KDC";
-    }
-    plaintext = decrypt_krb5_data_asn1(tree, actx, usage, next_tvb, NULL);
+static int
+kerberos_claims_dissect_CLAIMS_ARRAY(tvbuff_t* tvb, int offset, packet_info* pinfo, proto_tree* parent_tree, dcerpc_info* di, guint8* drep)
+{
+    proto_item* item = NULL;
+    proto_tree* tree;
+    int old_offset;
 
-    if (plaintext) {
-        tvbuff_t* child_tvb;
-        child_tvb = tvb_new_child_real_data(tvb, plaintext, length, length);
+    ALIGN_TO_4_BYTES;
+    old_offset = offset;
+    tree = proto_tree_add_subtree(parent_tree, tvb, offset, -1, ett_krb_pac_claims_array, &item, "CLAIMS_ARRAY");
 
-        /* Add the decrypted data to the data source list. */
-        add_new_data_source(actx->pinfo, child_tvb, name);
+    offset = dissect_ndr_uint16(tvb, offset, pinfo, tree, di, drep, hf_krb_pac_claims_source_type, NULL);
+    offset = dissect_ndr_uint32(tvb, offset, pinfo, tree, di, drep, hf_krb_pac_claims_count, NULL);
+    offset = dissect_ndr_embedded_pointer(tvb, offset, pinfo, tree, di, drep,
+        kerberos_claims_dissect_claim_entries, NDR_POINTER_UNIQUE, "ClaimEntries", -1);
 
-        offset = dissect_kerberos_PA_ENC_TS_ENC(FALSE, child_tvb, 0, actx, tree, /* hf_index*/ -1);
-    }
+    proto_item_set_len(item, offset - old_offset);
     return offset;
 }
-#endif /* HAVE_KERBEROS */
-
-static const int* hf_krb_pa_supported_enctypes_fields[] = {
-        &hf_krb_pa_supported_enctypes_des_cbc_crc,
-        &hf_krb_pa_supported_enctypes_des_cbc_md5,
-        &hf_krb_pa_supported_enctypes_rc4_hmac,
-        &hf_krb_pa_supported_enctypes_aes128_cts_hmac_sha1_96,
-        &hf_krb_pa_supported_enctypes_aes256_cts_hmac_sha1_96,
-        &hf_krb_pa_supported_enctypes_fast_supported,
-        &hf_krb_pa_supported_enctypes_compound_identity_supported,
-        &hf_krb_pa_supported_enctypes_claims_supported,
-        &hf_krb_pa_supported_enctypes_resource_sid_compression_disabled,
-        NULL,
-};
 
-static const true_false_string supported_tfs = {
-        "Supported", "Not supported"
-};
+static int
+kerberos_claims_dissect_claims_arrays(tvbuff_t* tvb, int offset, packet_info* pinfo, proto_tree* tree, dcerpc_info* di, guint8* drep)
+{
+    return dissect_ndr_ucarray(tvb, offset, pinfo, tree, di, drep, kerberos_claims_dissect_CLAIMS_ARRAY);
+}
 
 static int
-dissect_kerberos_PA_SUPPORTED_ENCTYPES(gboolean implicit_tag _U_, tvbuff_t* tvb _U_,
-    int offset _U_, asn1_ctx_t* actx _U_,
-    proto_tree* tree _U_, int hf_index _U_)
+kerberos_claims_dissect_CLAIMS_SET(tvbuff_t* tvb, int offset, packet_info* pinfo, proto_tree* tree, dcerpc_info* di, guint8* drep)
 {
-    actx->created_item = proto_tree_add_bitmask(tree, tvb, offset,
-        hf_krb_pa_supported_enctypes,
-        ett_krb_pa_supported_enctypes,
-        hf_krb_pa_supported_enctypes_fields,
-        ENC_LITTLE_ENDIAN);
-    offset += 4;
+    ALIGN_TO_4_BYTES;
+    offset = dissect_ndr_uint32(tvb, offset, pinfo, tree, di, drep, hf_krb_pac_claims_array_count, NULL);
+    offset = dissect_ndr_embedded_pointer(tvb, offset, pinfo, tree, di, drep,
+        kerberos_claims_dissect_claims_arrays, NDR_POINTER_UNIQUE, "ClaimsArrays", -1);
+    offset = dissect_ndr_uint16(tvb, offset, pinfo, tree, di, drep, hf_krb_pac_claims_reserved_type, NULL);
+    offset = dissect_ndr_uint32(tvb, offset, pinfo, tree, di, drep, hf_krb_pac_claims_reserved_size, NULL);
+    /* ReservedField, a byte array nobody fills in */
+    offset = dissect_ndr_uint32(tvb, offset, pinfo, tree, di, drep, -1, NULL);
 
     return offset;
 }
 
-static const int* hf_krb_ad_ap_options_fields[] = {
-        &hf_krb_ad_ap_options_cbt,
-        NULL,
-};
+/* CLAIMS_SET_METADATA is flat enough to walk by hand; it is what has to
+ * be looked at to find and decompress the CLAIMS_SET.
+ */
+static int
+dissect_krb5_PAC_CLAIMS_SET_METADATA(proto_tree* tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx)
+{
+    guint8 drep[4] = { 0x10, 0x00, 0x00, 0x00 }; /* fake DREP struct */
+    static dcerpc_info di;      /* fake dcerpc_info struct */
+    static dcerpc_call_value call_data;
+    guint32 set_size, set_ptr, uncompressed_size;
+    guint16 format;
+    proto_item* set_item;
+    tvbuff_t* set_tvb;
+    int set_offset;
 
-static const true_false_string set_tfs = {
-        "Set", "Not set"
-};
+    offset = dissect_krb5_PAC_NDRHEADERBLOB(tree, tvb, offset, &drep[0], actx);
+
+    offset += 4;    /* referent of the top-level pointer */
+    set_size = tvb_get_letohl(tvb, offset);
+    proto_tree_add_item(tree, hf_krb_pac_claims_set_size, tvb, offset, 4, ENC_LITTLE_ENDIAN);
+    offset += 4;
+    set_ptr = tvb_get_letohl(tvb, offset);
+    offset += 4;
+    format = tvb_get_letohs(tvb, offset);
+    proto_tree_add_item(tree, hf_krb_pac_claims_compression, tvb, offset, 2, ENC_LITTLE_ENDIAN);
+    offset += 4;
+    uncompressed_size = tvb_get_letohl(tvb, offset);
+    proto_tree_add_item(tree, hf_krb_pac_claims_uncompressed_size, tvb, offset, 4, ENC_LITTLE_ENDIAN);
+    offset += 4;
+    proto_tree_add_item(tree, hf_krb_pac_claims_reserved_type, tvb, offset, 2, ENC_LITTLE_ENDIAN);
+    offset += 4;
+    proto_tree_add_item(tree, hf_krb_pac_claims_reserved_size, tvb, offset, 4, ENC_LITTLE_ENDIAN);
+    offset += 8;    /* and the ReservedField pointer */
+
+    if (set_ptr == 0) {
+        return offset;
+    }
+    offset += 4;    /* conformance, the same as the size */
+    set_offset = offset;
+    set_item = proto_tree_add_item(tree, hf_krb_pac_claims_set, tvb, offset, set_size, ENC_NA);
+    offset += set_size;
+
+    if (format == KRB_CLAIMS_FORMAT_NONE) {
+        set_tvb = tvb_new_subset_length(tvb, set_offset, set_size);
+    } else {
+        set_tvb = kerberos_claims_uncompress(actx->pinfo, tvb, set_offset, set_size, format, uncompressed_size);
+        if (set_tvb == NULL) {
+            expert_add_info(actx->pinfo, set_item, &ei_krb_pac_claims_decompress);
+            return offset;
+        }
+    }
+    tree = proto_item_add_subtree(set_item, ett_krb_pac_claims_set);
+
+    offset = dissect_krb5_PAC_NDRHEADERBLOB(tree, set_tvb, 0, &drep[0], actx);
+    di.conformant_run = 0;
+    /* we need di->call_data->flags.NDR64 == 0 */
+    di.call_data = &call_data;
+    init_ndr_pointer_list(&di);
+    dissect_ndr_pointer(set_tvb, offset, actx->pinfo, tree, &di, drep,
+        kerberos_claims_dissect_CLAIMS_SET, NDR_POINTER_UNIQUE,
+        "CLAIMS_SET:", -1);
+
+    return set_offset + set_size;
+}
 
 static int
-dissect_kerberos_AD_AP_OPTIONS(gboolean implicit_tag _U_, tvbuff_t* tvb _U_,
-    int offset _U_, asn1_ctx_t* actx _U_,
-    proto_tree* tree _U_, int hf_index _U_)
+dissect_krb5_PAC_CLIENT_CLAIMS_INFO(proto_tree* parent_tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx)
 {
-    actx->created_item = proto_tree_add_bitmask(tree, tvb, offset,
-        hf_krb_ad_ap_options,
-        ett_krb_ad_ap_options,
-        hf_krb_ad_ap_options_fields,
-        ENC_LITTLE_ENDIAN);
-    offset += 4;
+    proto_item* item;
+    proto_tree* tree;
+    int length = tvb_captured_length_remaining(tvb, offset);
+
+    if (length == 0) {
+        return offset;
+    }
 
-    return offset;
+    item = proto_tree_add_item(parent_tree, hf_krb_pac_client_claims_info, tvb, offset, -1, ENC_NA);
+    if (parent_tree == NULL) {
+        return offset;
+    }
+    tree = proto_item_add_subtree(item, ett_krb_pac_client_claims_info);
+
+    return dissect_krb5_PAC_CLAIMS_SET_METADATA(tree, tvb, offset, actx);
 }
 
 static int
-dissect_kerberos_AD_TARGET_PRINCIPAL(gboolean implicit_tag _U_, tvbuff_t* tvb _U_,
-    int offset _U_, asn1_ctx_t* actx _U_,
-    proto_tree* tree _U_, int hf_index _U_)
+dissect_krb5_PAC_DEVICE_INFO(proto_tree* parent_tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx _U_)
 {
-    int tp_offset, tp_len;
-    guint16 bc;
+    proto_item* item;
+    proto_tree* tree;
+    guint8 drep[4] = { 0x10, 0x00, 0x00, 0x00 }; /* fake DREP struct */
+    static dcerpc_info di;      /* fake dcerpc_info struct */
+    static dcerpc_call_value call_data;
 
-    bc = tvb_reported_length_remaining(tvb, offset);
-    tp_offset = offset;
-    tp_len = bc;
-    proto_tree_add_item(tree, hf_krb_ad_target_principal, tvb,
-        tp_offset, tp_len,
-        ENC_UTF_16 | ENC_LITTLE_ENDIAN);
+    item = proto_tree_add_item(parent_tree, hf_krb_pac_device_info, tvb, offset, -1, ENC_NA);
+    tree = proto_item_add_subtree(item, ett_krb_pac_device_info);
+
+    /* skip the first 16 bytes, they are some magic created by the idl
+     * compiler   the first 4 bytes might be flags?
+     */
+    offset = dissect_krb5_PAC_NDRHEADERBLOB(tree, tvb, offset, &drep[0], actx);
+
+    /* the PAC_DEVICE_INFO blob */
+    /* fake whatever state the dcerpc runtime support needs */
+    di.conformant_run = 0;
+    /* we need di->call_data->flags.NDR64 == 0 */
+    di.call_data = &call_data;
+    init_ndr_pointer_list(&di);
+    offset = dissect_ndr_pointer(tvb, offset, actx->pinfo, tree, &di, drep,
+        netlogon_dissect_PAC_DEVICE_INFO, NDR_POINTER_UNIQUE,
+        "PAC_DEVICE_INFO:", -1);
 
     return offset;
 }
 
-/* Dissect a GSSAPI checksum as per RFC1964. This is NOT ASN.1 encoded.
- */
 static int
-dissect_krb5_rfc1964_checksum(asn1_ctx_t* actx _U_, proto_tree* tree, tvbuff_t* tvb)
+dissect_krb5_PAC_DEVICE_CLAIMS_INFO(proto_tree* parent_tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx)
 {
-    int offset = 0;
-    guint32 len;
-    guint16 dlglen;
-
-    /* Length of Bnd field */
-    len = tvb_get_letohl(tvb, offset);
-    proto_tree_add_item(tree, hf_krb_gssapi_len, tvb, offset, 4, ENC_LITTLE_ENDIAN);
-    offset += 4;
-
-    /* Bnd field */
-    proto_tree_add_item(tree, hf_krb_gssapi_bnd, tvb, offset, len, ENC_NA);
-    offset += len;
-
-
-    /* flags */
-    proto_tree_add_item(tree, hf_krb_gssapi_c_flag_dce_style, tvb, offset, 4, ENC_LITTLE_ENDIAN);
-    proto_tree_add_item(tree, hf_krb_gssapi_c_flag_integ, tvb, offset, 4, ENC_LITTLE_ENDIAN);
-    proto_tree_add_item(tree, hf_krb_gssapi_c_flag_conf, tvb, offset, 4, ENC_LITTLE_ENDIAN);
-    proto_tree_add_item(tree, hf_krb_gssapi_c_flag_sequence, tvb, offset, 4, ENC_LITTLE_ENDIAN);
-    proto_tree_add_item(tree, hf_krb_gssapi_c_flag_replay, tvb, offset, 4, ENC_LITTLE_ENDIAN);
-    proto_tree_add_item(tree, hf_krb_gssapi_c_flag_mutual, tvb, offset, 4, ENC_LITTLE_ENDIAN);
-    proto_tree_add_item(tree, hf_krb_gssapi_c_flag_deleg, tvb, offset, 4, ENC_LITTLE_ENDIAN);
-    offset += 4;
+    proto_item* item;
+    proto_tree* tree;
+    int length = tvb_captured_length_remaining(tvb, offset);
 
-    /* the next fields are optional so we have to check that we have
-     * more data in our buffers */
-    if (tvb_reported_length_remaining(tvb, offset) < 2) {
+    if (length == 0) {
         return offset;
     }
-    /* dlgopt identifier */
-    proto_tree_add_item(tree, hf_krb_gssapi_dlgopt, tvb, offset, 2, ENC_LITTLE_ENDIAN);
-    offset += 2;
 
-    if (tvb_reported_length_remaining(tvb, offset) < 2) {
+    item = proto_tree_add_item(parent_tree, hf_krb_pac_device_claims_info, tvb, offset, -1, ENC_NA);
+    if (parent_tree == NULL) {
         return offset;
     }
-    /* dlglen identifier */
-    dlglen = tvb_get_letohs(tvb, offset);
-    proto_tree_add_item(tree, hf_krb_gssapi_dlglen, tvb, offset, 2, ENC_LITTLE_ENDIAN);
-    offset += 2;
+    tree = proto_item_add_subtree(item, ett_krb_pac_device_claims_info);
 
-    if (dlglen != tvb_reported_length_remaining(tvb, offset)) {
-        proto_tree_add_expert_format(tree, actx->pinfo, &ei_krb_gssapi_dlglen, tvb, 0, 0,
-            "Error: DlgLen:%d is not the same as number of bytes remaining:%d", dlglen, tvb_captured_length_remaining(tvb, offset));
-        return offset;
-    }
+    return dissect_krb5_PAC_CLAIMS_SET_METADATA(tree, tvb, offset, actx);
+}
 
-    /* this should now be a KRB_CRED message */
-    offset = dissect_kerberos_Applications(FALSE, tvb, offset, actx, tree, /* hf_index */ -1);
+static int
+dissect_krb5_PAC_SERVER_CHECKSUM(proto_tree* parent_tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx _U_)
+{
+    proto_item* item;
+    proto_tree* tree;
+
+    item = proto_tree_add_item(parent_tree, hf_krb_pac_server_checksum, tvb, offset, -1, ENC_NA);
+    tree = proto_item_add_subtree(item, ett_krb_pac_server_checksum);
+
+    /* signature type */
+    proto_tree_add_item(tree, hf_krb_pac_signature_type, tvb, offset, 4, ENC_LITTLE_ENDIAN);
+    offset += 4;
+
+    /* signature data */
+    proto_tree_add_item(tree, hf_krb_pac_signature_signature, tvb, offset, -1, ENC_NA);
 
     return offset;
 }
 
 static int
-dissect_krb5_PA_PROV_SRV_LOCATION(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_)
+dissect_krb5_PAC_PRIVSVR_CHECKSUM(proto_tree* parent_tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx _U_)
 {
-    offset = dissect_ber_GeneralString(actx, tree, tvb, offset, hf_krb_provsrv_location, NULL, 0);
+    proto_item* item;
+    proto_tree* tree;
+
+    item = proto_tree_add_item(parent_tree, hf_krb_pac_privsvr_checksum, tvb, offset, -1, ENC_NA);
+    tree = proto_item_add_subtree(item, ett_krb_pac_privsvr_checksum);
+
+    /* signature type */
+    proto_tree_add_item(tree, hf_krb_pac_signature_type, tvb, offset, 4, ENC_LITTLE_ENDIAN);
+    offset += 4;
+
+    /* signature data */
+    proto_tree_add_item(tree, hf_krb_pac_signature_signature, tvb, offset, -1, ENC_NA);
 
     return offset;
 }
 
 static int
-dissect_krb5_PW_SALT(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_)
+dissect_krb5_PAC_CLIENT_INFO_TYPE(proto_tree* parent_tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx _U_)
 {
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-    gint length;
-    guint32 nt_status = 0;
-    guint32 reserved = 0;
-    guint32 flags = 0;
+    proto_item* item;
+    proto_tree* tree;
+    guint16 namelen;
 
-    /*
-     * Microsoft stores a special 12 byte blob here
-     * [MS-KILE] 2.2.1 KERB-EXT-ERROR
-     * guint32 NT_status
-     * guint32 reserved (== 0)
-     * guint32 flags (at least 0x00000001 is set)
-     */
-    length = tvb_reported_length_remaining(tvb, offset);
-    if (length <= 0) {
-        return offset;
-    }
-    if (length != 12) {
-        goto no_error;
-    }
+    item = proto_tree_add_item(parent_tree, hf_krb_pac_client_info_type, tvb, offset, -1, ENC_NA);
+    tree = proto_item_add_subtree(item, ett_krb_pac_client_info_type);
 
-    if (private_data->errorcode == 0) {
-        goto no_error;
-    }
+    /* clientid */
+    offset = dissect_nt_64bit_time(tvb, tree, offset, hf_krb_pac_clientid);
 
-    if (!private_data->try_nt_status) {
-        goto no_error;
-    }
+    /* name length */
+    namelen = tvb_get_letohs(tvb, offset);
+    proto_tree_add_uint(tree, hf_krb_pac_namelen, tvb, offset, 2, namelen);
+    offset += 2;
 
-    nt_status = tvb_get_letohl(tvb, offset);
-    reserved = tvb_get_letohl(tvb, offset + 4);
-    flags = tvb_get_letohl(tvb, offset + 8);
+    /* client name */
+    proto_tree_add_item(tree, hf_krb_pac_clientname, tvb, offset, namelen, ENC_UTF_16 | ENC_LITTLE_ENDIAN);
+    offset += namelen;
 
-    if (nt_status == 0 || reserved != 0 || flags == 0) {
-        goto no_error;
-    }
+    return offset;
+}
 
-    proto_tree_add_item(tree, hf_krb_ext_error_nt_status, tvb, offset, 4,
-        ENC_LITTLE_ENDIAN);
-    col_append_fstr(actx->pinfo->cinfo, COL_INFO,
-        " NT Status: %s",
-        val_to_str(nt_status, NT_errors,
-            "Unknown error code %#x"));
-    offset += 4;
+static int
+dissect_krb5_AD_WIN2K_PAC_struct(proto_tree* tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx)
+{
+    guint32 pac_type;
+    guint32 pac_size;
+    guint32 pac_offset;
+    proto_item* it = NULL;
+    proto_tree* tr = NULL;
+    tvbuff_t* next_tvb;
+
+    /* type of pac data */
+    pac_type = tvb_get_letohl(tvb, offset);
+    it = proto_tree_add_uint(tree, hf_krb_w2k_pac_type, tvb, offset, 4, pac_type);
+    tr = proto_item_add_subtree(it, ett_krb_pac);
 
-    proto_tree_add_item(tree, hf_krb_ext_error_reserved, tvb, offset, 4,
-        ENC_LITTLE_ENDIAN);
     offset += 4;
 
-    proto_tree_add_item(tree, hf_krb_ext_error_flags, tvb, offset, 4,
-        ENC_LITTLE_ENDIAN);
+    /* size of pac data */
+    pac_size = tvb_get_letohl(tvb, offset);
+    proto_tree_add_uint(tr, hf_krb_w2k_pac_size, tvb, offset, 4, pac_size);
     offset += 4;
 
-    return offset;
+    /* offset to pac data */
+    pac_offset = tvb_get_letohl(tvb, offset);
+    proto_tree_add_uint(tr, hf_krb_w2k_pac_offset, tvb, offset, 4, pac_offset);
+    offset += 8;
 
-no_error:
-    proto_tree_add_item(tree, hf_krb_pw_salt, tvb, offset, length, ENC_NA);
-    offset += length;
+    next_tvb = tvb_new_subset_length_caplen(tvb, pac_offset, pac_size, pac_size);
+    switch (pac_type) {
+    case PAC_LOGON_INFO:
+        dissect_krb5_PAC_LOGON_INFO(tr, next_tvb, 0, actx);
+        break;
+    case PAC_CREDENTIAL_TYPE:
+        dissect_krb5_PAC_CREDENTIAL_INFO(tr, next_tvb, 0, actx);
+        break;
+    case PAC_SERVER_CHECKSUM:
+        dissect_krb5_PAC_SERVER_CHECKSUM(tr, next_tvb, 0, actx);
+        break;
+    case PAC_PRIVSVR_CHECKSUM:
+        dissect_krb5_PAC_PRIVSVR_CHECKSUM(tr, next_tvb, 0, actx);
+        break;
+    case PAC_CLIENT_INFO_TYPE:
+        dissect_krb5_PAC_CLIENT_INFO_TYPE(tr, next_tvb, 0, actx);
+        break;
+    case PAC_S4U_DELEGATION_INFO:
+        dissect_krb5_PAC_S4U_DELEGATION_INFO(tr, next_tvb, 0, actx);
+        break;
+    case PAC_UPN_DNS_INFO:
+        dissect_krb5_PAC_UPN_DNS_INFO(tr, next_tvb, 0, actx);
+        break;
+    case PAC_CLIENT_CLAIMS_INFO:
+        dissect_krb5_PAC_CLIENT_CLAIMS_INFO(tr, next_tvb, 0, actx);
+        break;
+    case PAC_DEVICE_INFO:
+        dissect_krb5_PAC_DEVICE_INFO(tr, next_tvb, 0, actx);
+        break;
+    case PAC_DEVICE_CLAIMS_INFO:
+        dissect_krb5_PAC_DEVICE_CLAIMS_INFO(tr, next_tvb, 0, actx);
+        break;
 
+    default:
+        break;
+    }
     return offset;
 }
 
 static int
-dissect_krb5_PAC_DREP(proto_tree* parent_tree, tvbuff_t* tvb, int offset, guint8* drep)
+dissect_krb5_AD_WIN2K_PAC(gboolean implicit_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx, proto_tree* tree, int hf_index _U_)
 {
-    proto_tree* tree;
-    guint8 val;
+    guint32 entries;
+    guint32 version;
+    guint32 i;
+    guint profile_depth = BER_PROFILE_ENTER(actx->pinfo, "kerberos.pac");
 
-    tree = proto_tree_add_subtree(parent_tree, tvb, offset, 16, ett_krb_pac_drep, NULL, "DREP");
+    kerberos_get_private_data(actx)->saw_pac = TRUE;
 
-    val = tvb_get_guint8(tvb, offset);
-    proto_tree_add_uint(tree, hf_dcerpc_drep_byteorder, tvb, offset, 1, val >> 4);
+#if defined(HAVE_MIT_KERBEROS) && defined(HAVE_KRB5_PAC_VERIFY)
+    verify_krb5_pac(tree, actx, tvb);
+#endif
+
+    /* first in the PAC structure comes the number of entries */
+    entries = tvb_get_letohl(tvb, offset);
+    proto_tree_add_uint(tree, hf_krb_w2k_pac_entries, tvb, offset, 4, entries);
+    offset += 4;
 
-    offset++;
+    /* second comes the version */
+    version = tvb_get_letohl(tvb, offset);
+    proto_tree_add_uint(tree, hf_krb_w2k_pac_version, tvb, offset, 4, version);
+    offset += 4;
 
-    if (drep) {
-        *drep = val;
+    for (i = 0; i < entries; i++) {
+        offset = dissect_krb5_AD_WIN2K_PAC_struct(tree, tvb, offset, actx);
     }
 
+    BER_PROFILE_LEAVE(profile_depth);
     return offset;
 }
 
-/* This might be some sort of header that MIDL generates when creating
- * marshalling/unmarshalling code for blobs that are not to be transported
- * ontop of DCERPC and where the DREP fields specifying things such as
- * endianess and similar are not available.
+/*
+ * Exchange log (kerberos.exchange_log). Requests (AS/TGS/AP) are held
+ * per address/port pair until the reply or KRB-ERROR on the reversed
+ * pair arrives; each exchange becomes one row. Rows are handed to a
+ * writer thread, which batches them into row groups.
+ *
+ * File layout, all integers little-endian:
+ *   "KRBLOG01", u32 column count, per column: u8 type, u8 name length, name
+ *   per row group: "RGRP", u32 row count, per column:
+ *     KRB_LOG_COL_INT: u64 value per row
+ *     KRB_LOG_COL_STR: u32 dictionary size, per entry: u32 length, bytes;
+ *                      then u32 dictionary index per row
+ * Dictionaries are per row group, so every row group decodes on its own.
  */
-static int
-dissect_krb5_PAC_NDRHEADERBLOB(proto_tree* parent_tree, tvbuff_t* tvb, int offset, guint8* drep, asn1_ctx_t* actx _U_)
-{
-    proto_tree* tree;
+#define KRB_LOG_MAGIC "KRBLOG01"
+#define KRB_LOG_ROW_GROUP 8192
 
-    tree = proto_tree_add_subtree(parent_tree, tvb, offset, 16, ett_krb_pac_midl_blob, NULL, "MES header");
-
-    /* modified DREP field that is used for stuff that is transporetd ontop
-       of non dcerpc
-    */
-    proto_tree_add_item(tree, hf_krb_midl_version, tvb, offset, 1, ENC_LITTLE_ENDIAN);
-    offset++;
+#define KRB_LOG_COL_INT 0
+#define KRB_LOG_COL_STR 1
 
-    offset = dissect_krb5_PAC_DREP(tree, tvb, offset, drep);
+typedef struct {
+    guint64 ints[KRB_LOG_INT_COLS];
+    char* strs[KRB_LOG_STR_COLS];
+} kerberos_log_row_t;
 
+static const char* const kerberos_log_int_names[KRB_LOG_INT_COLS] = {
+    "time_ns", "request_frame", "reply_frame", "request_type", "reply_type",
+    "etype", "kdc_options", "ticket_flags", "error_code"
+};
 
-    proto_tree_add_item(tree, hf_krb_midl_hdr_len, tvb, offset, 2, ENC_LITTLE_ENDIAN);
-    offset += 2;
+static const char* const kerberos_log_str_names[KRB_LOG_STR_COLS] = {
+    "client", "server", "realm", "etypes_requested", "pa_types",
+    "pkinit_cert_sha256", "pac_logon_info_sha256"
+};
 
-    proto_tree_add_item(tree, hf_krb_midl_fill_bytes, tvb, offset, 4, ENC_LITTLE_ENDIAN);
-    offset += 4;
+static const char* kerberos_log_filename = "";
+static gboolean kerberos_log_failed = FALSE;
+static GThread* kerberos_log_thread = NULL;
+static GAsyncQueue* kerberos_log_queue = NULL;
+static kerberos_log_row_t kerberos_log_eof; /* queued to stop the writer */
+static wmem_map_t* kerberos_log_pending = NULL; /* "src>dst" -> kerberos_log_row_t* */
 
-    /* length of blob that follows */
-    proto_tree_add_item(tree, hf_krb_midl_blob_len, tvb, offset, 8, ENC_LITTLE_ENDIAN);
-    offset += 8;
+static void
+kerberos_log_row_free(kerberos_log_row_t* row)
+{
+    int i;
 
-    return offset;
+    for (i = 0; i < KRB_LOG_STR_COLS; i++) {
+        g_free(row->strs[i]);
+    }
+    g_free(row);
 }
 
-static int
-dissect_krb5_PAC_LOGON_INFO(proto_tree* parent_tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx _U_)
+static void
+kerberos_log_put(GByteArray* buf, const void* data, guint len)
 {
-    proto_item* item;
-    proto_tree* tree;
-    guint8 drep[4] = { 0x10, 0x00, 0x00, 0x00 }; /* fake DREP struct */
-    static dcerpc_info di;      /* fake dcerpc_info struct */
-    static dcerpc_call_value call_data;
-
-    item = proto_tree_add_item(parent_tree, hf_krb_pac_logon_info, tvb, offset, -1, ENC_NA);
-    tree = proto_item_add_subtree(item, ett_krb_pac_logon_info);
-
-    /* skip the first 16 bytes, they are some magic created by the idl
-     * compiler   the first 4 bytes might be flags?
-     */
-    offset = dissect_krb5_PAC_NDRHEADERBLOB(tree, tvb, offset, &drep[0], actx);
-
-    /* the PAC_LOGON_INFO blob */
-    /* fake whatever state the dcerpc runtime support needs */
-    di.conformant_run = 0;
-    /* we need di->call_data->flags.NDR64 == 0 */
-    di.call_data = &call_data;
-    init_ndr_pointer_list(&di);
-    offset = dissect_ndr_pointer(tvb, offset, actx->pinfo, tree, &di, drep,
-        netlogon_dissect_PAC_LOGON_INFO, NDR_POINTER_UNIQUE,
-        "PAC_LOGON_INFO:", -1);
-
-    return offset;
+    g_byte_array_append(buf, (const guint8*)data, len);
 }
 
-
-static int
-dissect_krb5_PAC_CREDENTIAL_DATA(proto_tree* parent_tree, tvbuff_t* tvb, int offset, packet_info* pinfo _U_)
+static void
+kerberos_log_put_u32(GByteArray* buf, guint32 value)
 {
-    proto_tree_add_item(parent_tree, hf_krb_pac_credential_data, tvb, offset, -1, ENC_NA);
+    value = GUINT32_TO_LE(value);
+    kerberos_log_put(buf, &value, 4);
+}
 
-    return offset;
+static void
+kerberos_log_put_u64(GByteArray* buf, guint64 value)
+{
+    value = GUINT64_TO_LE(value);
+    kerberos_log_put(buf, &value, 8);
 }
 
-static int
-dissect_krb5_PAC_CREDENTIAL_INFO(proto_tree* parent_tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx)
+static void
+kerberos_log_write_group(FILE* fp, GPtrArray* rows)
 {
-    proto_item* item;
-    proto_tree* tree;
-    guint8* plaintext = NULL;
-    int plainlen = 0;
-    int length = 0;
-#define KRB5_KU_OTHER_ENCRYPTED 16
-#ifdef  HAVE_KERBEROS
-    guint32 etype;
-    tvbuff_t* next_tvb;
-    int usage = KRB5_KU_OTHER_ENCRYPTED;
-#endif
+    GByteArray* buf = g_byte_array_new();
+    GHashTable* dict;
+    GPtrArray* entries;
+    guint32* index;
+    guint i;
+    int col;
 
-    item = proto_tree_add_item(parent_tree, hf_krb_pac_credential_info, tvb, offset, -1, ENC_NA);
-    tree = proto_item_add_subtree(item, ett_krb_pac_credential_info);
+    kerberos_log_put(buf, "RGRP", 4);
+    kerberos_log_put_u32(buf, rows->len);
 
-    /* version */
-    proto_tree_add_item(tree, hf_krb_pac_credential_info_version, tvb,
-        offset, 4, ENC_LITTLE_ENDIAN);
-    offset += 4;
+    for (col = 0; col < KRB_LOG_INT_COLS; col++) {
+        for (i = 0; i < rows->len; i++) {
+            kerberos_log_put_u64(buf, ((kerberos_log_row_t*)g_ptr_array_index(rows, i))->ints[col]);
+        }
+    }
 
-#ifdef HAVE_KERBEROS
-    /* etype */
-    etype = tvb_get_letohl(tvb, offset);
-#endif
-    proto_tree_add_item(tree, hf_krb_pac_credential_info_etype, tvb,
-        offset, 4, ENC_LITTLE_ENDIAN);
-    offset += 4;
+    index = g_new(guint32, rows->len);
+    for (col = 0; col < KRB_LOG_STR_COLS; col++) {
+        dict = g_hash_table_new(g_str_hash, g_str_equal);
+        entries = g_ptr_array_new();
+        for (i = 0; i < rows->len; i++) {
+            const char* value = ((kerberos_log_row_t*)g_ptr_array_index(rows, i))->strs[col];
+            gpointer slot;
 
-#ifdef HAVE_KERBEROS
-    /* data */
-    next_tvb = tvb_new_subset_remaining(tvb, offset);
-    length = tvb_captured_length_remaining(tvb, offset);
+            if (value == NULL) {
+                value = "";
+            }
+            if (!g_hash_table_lookup_extended(dict, value, NULL, &slot)) {
+                slot = GUINT_TO_POINTER(entries->len);
+                g_hash_table_insert(dict, (gpointer)value, slot);
+                g_ptr_array_add(entries, (gpointer)value);
+            }
+            index[i] = GPOINTER_TO_UINT(slot);
+        }
+        kerberos_log_put_u32(buf, entries->len);
+        for (i = 0; i < entries->len; i++) {
+            const char* value = (const char*)g_ptr_array_index(entries, i);
+            guint32 len = (guint32)strlen(value);
 
-    plaintext = decrypt_krb5_data(tree, actx->pinfo, usage, next_tvb, (int)etype, &plainlen);
-#endif
+            kerberos_log_put_u32(buf, len);
+            kerberos_log_put(buf, value, len);
+        }
+        for (i = 0; i < rows->len; i++) {
+            kerberos_log_put_u32(buf, index[i]);
+        }
+        g_ptr_array_free(entries, TRUE);
+        g_hash_table_destroy(dict);
+    }
+    g_free(index);
 
-    if (plaintext != NULL) {
-        tvbuff_t* child_tvb;
-        child_tvb = tvb_new_child_real_data(tvb, plaintext, plainlen, plainlen);
+    if (fwrite(buf->data, 1, buf->len, fp) != buf->len) {
+        fprintf(stderr, "KERBEROS ERROR: Could not write the exchange log\n");
+    }
+    g_byte_array_free(buf, TRUE);
+}
 
-        /* Add the decrypted data to the data source list. */
-        add_new_data_source(actx->pinfo, child_tvb, "Krb5 PAC_CREDENTIAL");
+static gpointer
+kerberos_log_writer(gpointer data)
+{
+    FILE* fp = (FILE*)data;
+    GPtrArray* rows = g_ptr_array_new_with_free_func((GDestroyNotify)kerberos_log_row_free);
+    kerberos_log_row_t* row;
 
-        dissect_krb5_PAC_CREDENTIAL_DATA(tree, child_tvb, 0, actx->pinfo);
+    for (;;) {
+        row = (kerberos_log_row_t*)g_async_queue_pop(kerberos_log_queue);
+        if (row == &kerberos_log_eof) {
+            break;
+        }
+        g_ptr_array_add(rows, row);
+        if (rows->len == KRB_LOG_ROW_GROUP) {
+            kerberos_log_write_group(fp, rows);
+            g_ptr_array_set_size(rows, 0);
+        }
     }
+    if (rows->len > 0) {
+        kerberos_log_write_group(fp, rows);
+    }
+    g_ptr_array_free(rows, TRUE);
+    fclose(fp);
+    return NULL;
+}
 
-    return offset + length;
+static gboolean
+kerberos_log_start(void)
+{
+    GByteArray* buf;
+    FILE* fp;
+    int col;
+
+    if (kerberos_log_thread != NULL) {
+        return TRUE;
+    }
+    if (kerberos_log_failed) {
+        return FALSE;
+    }
+    fp = ws_fopen(kerberos_log_filename, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "KERBEROS ERROR: Could not open exchange log %s\n", kerberos_log_filename);
+        kerberos_log_failed = TRUE;
+        return FALSE;
+    }
+
+    buf = g_byte_array_new();
+    kerberos_log_put(buf, KRB_LOG_MAGIC, 8);
+    kerberos_log_put_u32(buf, KRB_LOG_INT_COLS + KRB_LOG_STR_COLS);
+    for (col = 0; col < KRB_LOG_INT_COLS; col++) {
+        guint8 header[2] = { KRB_LOG_COL_INT, (guint8)strlen(kerberos_log_int_names[col]) };
+        kerberos_log_put(buf, header, 2);
+        kerberos_log_put(buf, kerberos_log_int_names[col], header[1]);
+    }
+    for (col = 0; col < KRB_LOG_STR_COLS; col++) {
+        guint8 header[2] = { KRB_LOG_COL_STR, (guint8)strlen(kerberos_log_str_names[col]) };
+        kerberos_log_put(buf, header, 2);
+        kerberos_log_put(buf, kerberos_log_str_names[col], header[1]);
+    }
+    fwrite(buf->data, 1, buf->len, fp);
+    g_byte_array_free(buf, TRUE);
+
+    kerberos_log_queue = g_async_queue_new();
+    kerberos_log_thread = g_thread_new("kerberos-log", kerberos_log_writer, fp);
+    return TRUE;
 }
 
-static int
-dissect_krb5_PAC_S4U_DELEGATION_INFO(proto_tree* parent_tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx)
+static void
+kerberos_log_queue_pending(gpointer key _U_, gpointer value, gpointer user_data _U_)
 {
-    proto_item* item;
-    proto_tree* tree;
-    guint8 drep[4] = { 0x10, 0x00, 0x00, 0x00 }; /* fake DREP struct */
-    static dcerpc_info di;      /* fake dcerpc_info struct */
-    static dcerpc_call_value call_data;
+    g_async_queue_push(kerberos_log_queue, value);
+}
 
-    item = proto_tree_add_item(parent_tree, hf_krb_pac_s4u_delegation_info, tvb, offset, -1, ENC_NA);
-    tree = proto_item_add_subtree(item, ett_krb_pac_s4u_delegation_info);
+/* Unanswered requests are written as they are, then the writer drains */
+static void
+kerberos_log_cleanup(void)
+{
+    kerberos_log_failed = FALSE;
+    if (kerberos_log_thread == NULL) {
+        kerberos_log_pending = NULL;
+        return;
+    }
+    if (kerberos_log_pending != NULL) {
+        wmem_map_foreach(kerberos_log_pending, kerberos_log_queue_pending, NULL);
+        kerberos_log_pending = NULL;
+    }
+    g_async_queue_push(kerberos_log_queue, &kerberos_log_eof);
+    g_thread_join(kerberos_log_thread);
+    g_async_queue_unref(kerberos_log_queue);
+    kerberos_log_thread = NULL;
+    kerberos_log_queue = NULL;
+}
 
-    /* skip the first 16 bytes, they are some magic created by the idl
-     * compiler   the first 4 bytes might be flags?
-     */
-    offset = dissect_krb5_PAC_NDRHEADERBLOB(tree, tvb, offset, &drep[0], actx);
+static char*
+kerberos_log_strbuf(wmem_strbuf_t* buf)
+{
+    return (buf && wmem_strbuf_get_len(buf)) ? g_strdup(wmem_strbuf_get_str(buf)) : NULL;
+}
 
+static char*
+kerberos_log_pair_key(const address* src, guint32 srcport, const address* dst, guint32 dstport)
+{
+    return wmem_strdup_printf(wmem_packet_scope(), "%s:%u>%s:%u",
+        address_to_str(wmem_packet_scope(), src), srcport,
+        address_to_str(wmem_packet_scope(), dst), dstport);
+}
 
-    /* the S4U_DELEGATION_INFO blob. See [MS-PAC] */
-    /* fake whatever state the dcerpc runtime support needs */
-    di.conformant_run = 0;
-    /* we need di->call_data->flags.NDR64 == 0 */
-    di.call_data = &call_data;
-    init_ndr_pointer_list(&di);
-    offset = dissect_ndr_pointer(tvb, offset, actx->pinfo, tree, &di, drep,
-        netlogon_dissect_PAC_S4U_DELEGATION_INFO, NDR_POINTER_UNIQUE,
-        "PAC_S4U_DELEGATION_INFO:", -1);
+/* Fill in what this message knows that the row does not yet */
+static void
+kerberos_log_merge(kerberos_log_row_t* row, packet_info* pinfo, kerberos_private_data_t* private_data)
+{
+    kerberos_log_msg_t* msg = private_data->log;
+    const char* cert = pkinit_get_cert_fingerprint(pinfo);
 
-    return offset;
+    if (row->strs[KRB_LOG_CLIENT] == NULL) {
+        row->strs[KRB_LOG_CLIENT] = kerberos_log_strbuf(msg->client);
+    }
+    if (row->strs[KRB_LOG_SERVER] == NULL) {
+        row->strs[KRB_LOG_SERVER] = kerberos_log_strbuf(msg->server);
+    }
+    if (row->strs[KRB_LOG_REALM] == NULL && private_data->realm) {
+        row->strs[KRB_LOG_REALM] = g_strdup(private_data->realm);
+    }
+    if (row->strs[KRB_LOG_PKINIT_CERT] == NULL && cert) {
+        row->strs[KRB_LOG_PKINIT_CERT] = g_strdup(cert);
+    }
+    if (row->strs[KRB_LOG_PAC_HASH] == NULL && msg->pac_hash) {
+        row->strs[KRB_LOG_PAC_HASH] = g_strdup(msg->pac_hash);
+    }
+    if (msg->etype_used) {
+        row->ints[KRB_LOG_ETYPE] = msg->etype_used;
+    }
+    if (msg->ticket_flags) {
+        row->ints[KRB_LOG_TICKET_FLAGS] = msg->ticket_flags;
+    }
 }
 
-static int
-dissect_krb5_PAC_UPN_DNS_INFO(proto_tree* parent_tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx _U_)
+/* Called once per Kerberos message on the first pass */
+static void
+kerberos_log_message(packet_info* pinfo, kerberos_private_data_t* private_data)
 {
-    proto_item* item;
-    proto_tree* tree;
-    guint16 dns_offset, dns_len;
-    guint16 upn_offset, upn_len;
+    kerberos_log_msg_t* msg = private_data->log;
+    kerberos_log_row_t* row;
+    gpointer old;
+    char* key;
 
-    item = proto_tree_add_item(parent_tree, hf_krb_pac_upn_dns_info, tvb, offset, -1, ENC_NA);
-    tree = proto_item_add_subtree(item, ett_krb_pac_upn_dns_info);
+    switch (private_data->msg_type) {
+    case KRB5_MSG_AS_REQ:
+    case KRB5_MSG_TGS_REQ:
+    case KRB5_MSG_AP_REQ:
+        if (!kerberos_log_start()) {
+            return;
+        }
+        row = g_new0(kerberos_log_row_t, 1);
+        row->ints[KRB_LOG_TIME] = (guint64)pinfo->abs_ts.secs * 1000000000 + pinfo->abs_ts.nsecs;
+        row->ints[KRB_LOG_REQUEST_FRAME] = pinfo->num;
+        row->ints[KRB_LOG_REQUEST_TYPE] = private_data->msg_type;
+        row->ints[KRB_LOG_KDC_OPTIONS] = msg->kdc_options;
+        row->strs[KRB_LOG_ETYPES] = kerberos_log_strbuf(msg->etypes);
+        row->strs[KRB_LOG_PA_TYPES] = kerberos_log_strbuf(msg->pa_types);
+        kerberos_log_merge(row, pinfo, private_data);
+
+        key = kerberos_log_pair_key(&pinfo->src, pinfo->srcport, &pinfo->dst, pinfo->destport);
+        if (kerberos_log_pending == NULL) {
+            kerberos_log_pending = wmem_map_new(wmem_file_scope(), g_str_hash, g_str_equal);
+        }
+        /* a retransmission or a new request replaces an unanswered one */
+        old = wmem_map_remove(kerberos_log_pending, key);
+        if (old != NULL) {
+            g_async_queue_push(kerberos_log_queue, old);
+        }
+        wmem_map_insert(kerberos_log_pending, wmem_strdup(wmem_file_scope(), key), row);
+        break;
 
-    /* upn */
-    upn_len = tvb_get_letohs(tvb, offset);
-    proto_tree_add_item(tree, hf_krb_pac_upn_upn_len, tvb, offset, 2, ENC_LITTLE_ENDIAN);
-    offset += 2;
-    upn_offset = tvb_get_letohs(tvb, offset);
-    proto_tree_add_item(tree, hf_krb_pac_upn_upn_offset, tvb, offset, 2, ENC_LITTLE_ENDIAN);
-    offset += 2;
+    case KRB5_MSG_AS_REP:
+    case KRB5_MSG_TGS_REP:
+    case KRB5_MSG_AP_REP:
+    case KRB5_MSG_ERROR:
+        if (kerberos_log_pending == NULL) {
+            return;
+        }
+        key = kerberos_log_pair_key(&pinfo->dst, pinfo->destport, &pinfo->src, pinfo->srcport);
+        row = (kerberos_log_row_t*)wmem_map_remove(kerberos_log_pending, key);
+        if (row == NULL) {
+            return;
+        }
+        row->ints[KRB_LOG_REPLY_FRAME] = pinfo->num;
+        row->ints[KRB_LOG_REPLY_TYPE] = private_data->msg_type;
+        if (private_data->msg_type == KRB5_MSG_ERROR) {
+            row->ints[KRB_LOG_ERROR_CODE] = private_data->errorcode;
+        }
+        kerberos_log_merge(row, pinfo, private_data);
+        g_async_queue_push(kerberos_log_queue, row);
+        break;
 
-    /* dns */
-    dns_len = tvb_get_letohs(tvb, offset);
-    proto_tree_add_item(tree, hf_krb_pac_upn_dns_len, tvb, offset, 2, ENC_LITTLE_ENDIAN);
-    offset += 2;
-    dns_offset = tvb_get_letohs(tvb, offset);
-    proto_tree_add_item(tree, hf_krb_pac_upn_dns_offset, tvb, offset, 2, ENC_LITTLE_ENDIAN);
-    offset += 2;
+    default:
+        break;
+    }
+}
 
-    /* flags */
-    proto_tree_add_item(tree, hf_krb_pac_upn_flags, tvb, offset, 4, ENC_LITTLE_ENDIAN);
+static void
+kerberos_log_append_uint(wmem_strbuf_t** buf, guint32 value)
+{
+    if (*buf == NULL) {
+        *buf = wmem_strbuf_new(wmem_packet_scope(), "");
+    }
+    wmem_strbuf_append_printf(*buf, "%s%u", wmem_strbuf_get_len(*buf) ? "," : "", value);
+}
 
-    /* upn */
-    proto_tree_add_item(tree, hf_krb_pac_upn_upn_name, tvb, upn_offset, upn_len, ENC_UTF_16 | ENC_LITTLE_ENDIAN);
+static void
+kerberos_log_append_name(wmem_strbuf_t** buf, tvbuff_t* tvb)
+{
+    if (tvb == NULL) {
+        return;
+    }
+    if (*buf == NULL) {
+        *buf = wmem_strbuf_new(wmem_packet_scope(), "");
+    }
+    if (wmem_strbuf_get_len(*buf)) {
+        wmem_strbuf_append_c(*buf, '/');
+    }
+    wmem_strbuf_append(*buf, tvb_get_string_enc(wmem_packet_scope(), tvb, 0,
+        tvb_reported_length(tvb), ENC_ASCII));
+}
 
-    /* dns */
-    proto_tree_add_item(tree, hf_krb_pac_upn_dns_name, tvb, dns_offset, dns_len, ENC_UTF_16 | ENC_LITTLE_ENDIAN);
+/* The server of a KDC-REQ is the sname of its body, not that of the
+ * ticket in its PA-TGS-REQ or of an additional ticket */
+static gboolean
+kerberos_log_wants_server(kerberos_private_data_t* private_data)
+{
+    kerberos_log_msg_t* msg = private_data->log;
+
+    if (msg == NULL || msg->server_done) {
+        return FALSE;
+    }
+    if (private_data->msg_type == KRB5_MSG_AS_REQ || private_data->msg_type == KRB5_MSG_TGS_REQ) {
+        return msg->in_req_body;
+    }
+    return TRUE;
+}
 
-    return dns_offset;
+/* Called by the cipher of the message's own enc-part, with its etype just read */
+static void
+kerberos_log_enc_part(kerberos_private_data_t* private_data)
+{
+    if (private_data->log == NULL || private_data->log->etype_used ||
+        private_data->within_PA_TGS_REQ != 0 || private_data->fast_armor_within_armor_value != 0) {
+        return;
+    }
+    private_data->log->etype_used = private_data->etype;
 }
 
-static int
-dissect_krb5_PAC_CLIENT_CLAIMS_INFO(proto_tree* parent_tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx _U_)
+static guint32
+kerberos_log_bits(tvbuff_t* tvb)
 {
-    int length = tvb_captured_length_remaining(tvb, offset);
+    guint len;
+    guint32 value = 0;
+    guint i;
 
-    if (length == 0) {
-        return offset;
+    if (tvb == NULL) {
+        return 0;
+    }
+    len = MIN(tvb_captured_length(tvb), 4);
+    for (i = 0; i < len; i++) {
+        value |= (guint32)tvb_get_guint8(tvb, i) << (24 - 8 * i);
     }
+    return value;
+}
 
-    proto_tree_add_item(parent_tree, hf_krb_pac_client_claims_info, tvb, offset, -1, ENC_NA);
+/*
+ * Live mode (kerberos.live_mode). A capture that runs for days would
+ * otherwise keep every key it learnt and every unanswered request. On
+ * the first pass, at most once a minute of capture time (or whenever
+ * the key limit is exceeded), learnt keys are evicted once their ticket
+ * has ended (or live_state_timeout after they were learnt, if the end
+ * time was not seen) and beyond live_max_keys, oldest first; pending
+ * exchange log rows are written out after live_state_timeout. The UDP
+ * reply conversations are not created in live mode, replies come from
+ * port 88 and are found by port anyway.
+ */
+static time_t kerberos_live_last_sweep = 0;
+static guint kerberos_live_evicted_keys = 0;
+static guint64 kerberos_live_evicted_key_bytes = 0;
+static guint kerberos_live_evicted_exchanges = 0;
 
-    return offset;
+static void
+kerberos_mem_evicted_keys(guint* count, guint64* bytes)
+{
+    *count = kerberos_live_evicted_keys;
+    *bytes = kerberos_live_evicted_key_bytes;
 }
 
-static int
-dissect_krb5_PAC_DEVICE_INFO(proto_tree* parent_tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx _U_)
+static void
+kerberos_mem_evicted_exchanges(guint* count, guint64* bytes)
 {
-    proto_item* item;
-    proto_tree* tree;
-    guint8 drep[4] = { 0x10, 0x00, 0x00, 0x00 }; /* fake DREP struct */
-    static dcerpc_info di;      /* fake dcerpc_info struct */
-    static dcerpc_call_value call_data;
+    *count = kerberos_live_evicted_exchanges;
+    *bytes = (guint64)kerberos_live_evicted_exchanges * sizeof(kerberos_log_row_t);
+}
 
-    item = proto_tree_add_item(parent_tree, hf_krb_pac_device_info, tvb, offset, -1, ENC_NA);
-    tree = proto_item_add_subtree(item, ett_krb_pac_device_info);
+/* KerberosTime (GeneralizedTime "YYYYMMDDHHMMSSZ") at offset, or 0 */
+static time_t
+kerberos_live_parse_time(tvbuff_t* tvb, int offset)
+{
+    guint32 len;
+    int year, month, day, hour, minute, second;
+    GDateTime* dt;
+    time_t t = 0;
+    const char* str;
 
-    /* skip the first 16 bytes, they are some magic created by the idl
-     * compiler   the first 4 bytes might be flags?
-     */
-    offset = dissect_krb5_PAC_NDRHEADERBLOB(tree, tvb, offset, &drep[0], actx);
+    offset = try_get_ber_tl(tvb, offset, NULL, NULL, NULL, &len);
+    if (offset < 0 || len < 15) {
+        return 0;
+    }
+    str = (const char*)tvb_get_string_enc(wmem_packet_scope(), tvb, offset, 14, ENC_ASCII);
+    if (sscanf(str, "%4d%2d%2d%2d%2d%2d", &year, &month, &day, &hour, &minute, &second) != 6) {
+        return 0;
+    }
+    dt = g_date_time_new_utc(year, month, day, hour, minute, second);
+    if (dt != NULL) {
+        t = (time_t)g_date_time_to_unix(dt);
+        g_date_time_unref(dt);
+    }
+    return t;
+}
 
-    /* the PAC_DEVICE_INFO blob */
-    /* fake whatever state the dcerpc runtime support needs */
-    di.conformant_run = 0;
-    /* we need di->call_data->flags.NDR64 == 0 */
-    di.call_data = &call_data;
-    init_ndr_pointer_list(&di);
-    offset = dissect_ndr_pointer(tvb, offset, actx->pinfo, tree, &di, drep,
-        netlogon_dissect_PAC_DEVICE_INFO, NDR_POINTER_UNIQUE,
-        "PAC_DEVICE_INFO:", -1);
+struct kerberos_live_expired {
+    guint64 cutoff;
+    GPtrArray* keys;
+};
 
-    return offset;
+static void
+kerberos_live_collect_row(gpointer key, gpointer value, gpointer user_data)
+{
+    kerberos_log_row_t* row = (kerberos_log_row_t*)value;
+    struct kerberos_live_expired* expired = (struct kerberos_live_expired*)user_data;
+
+    if (row->ints[KRB_LOG_TIME] < expired->cutoff) {
+        g_ptr_array_add(expired->keys, key);
+    }
 }
 
-static int
-dissect_krb5_PAC_DEVICE_CLAIMS_INFO(proto_tree* parent_tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx _U_)
+/* Write out exchange log rows whose request is older than cutoff */
+static void
+kerberos_live_time_out_rows(guint64 cutoff)
 {
-    int length = tvb_captured_length_remaining(tvb, offset);
+    struct kerberos_live_expired expired = { cutoff, g_ptr_array_new() };
+    guint i;
 
-    if (length == 0) {
-        return offset;
+    wmem_map_foreach(kerberos_log_pending, kerberos_live_collect_row, &expired);
+    for (i = 0; i < expired.keys->len; i++) {
+        g_async_queue_push(kerberos_log_queue,
+            wmem_map_remove(kerberos_log_pending, g_ptr_array_index(expired.keys, i)));
+        kerberos_live_evicted_exchanges++;
     }
+    g_ptr_array_free(expired.keys, TRUE);
+}
 
-    proto_tree_add_item(parent_tree, hf_krb_pac_device_claims_info, tvb, offset, -1, ENC_NA);
+#if defined(HAVE_HEIMDAL_KERBEROS) || defined(HAVE_MIT_KERBEROS)
+static enc_key_t*
+kerberos_live_first_kept(enc_key_t* ek, GHashTable* evict)
+{
+    while (ek != NULL && g_hash_table_contains(evict, ek)) {
+        ek = ek->same_list;
+    }
+    return ek;
+}
 
-    return offset;
+/* Replace or drop the map entries whose key is going away */
+static void
+kerberos_live_unmap(wmem_map_t* key_map, GHashTable* evict)
+{
+    GHashTableIter iter;
+    gpointer value;
+    enc_key_t* head;
+    enc_key_t* kept;
+
+    g_hash_table_iter_init(&iter, evict);
+    while (g_hash_table_iter_next(&iter, &value, NULL)) {
+        head = (enc_key_t*)wmem_map_lookup(key_map, value);
+        if (head == NULL || !g_hash_table_contains(evict, head)) {
+            continue;
+        }
+        wmem_map_remove(key_map, head);
+        kept = kerberos_live_first_kept(head, evict);
+        if (kept != NULL) {
+            wmem_map_insert(key_map, kept, kept);
+        }
+    }
 }
 
-static int
-dissect_krb5_PAC_SERVER_CHECKSUM(proto_tree* parent_tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx _U_)
+/* Drop the learnt keys that have expired and all but the newest keep */
+static void
+kerberos_live_evict_keys(time_t now, guint keep)
 {
-    proto_item* item;
-    proto_tree* tree;
+    GHashTable* evict = g_hash_table_new(g_direct_hash, g_direct_equal);
+    enc_key_t** link;
+    enc_key_t* ek;
+    guint learnt = 0;
 
-    item = proto_tree_add_item(parent_tree, hf_krb_pac_server_checksum, tvb, offset, -1, ENC_NA);
-    tree = proto_item_add_subtree(item, ett_krb_pac_server_checksum);
+    /* enc_key_list is newest first */
+    for (ek = enc_key_list; ek != NULL; ek = ek->next) {
+        if (ek->fd_num == -1) {
+            continue;
+        }
+        learnt++;
+        if (learnt > keep ||
+            (ek->expires != 0 && ek->expires <= now)) {
+            g_hash_table_add(evict, ek);
+        }
+    }
+    if (g_hash_table_size(evict) == 0) {
+        g_hash_table_destroy(evict);
+        return;
+    }
 
-    /* signature type */
-    proto_tree_add_item(tree, hf_krb_pac_signature_type, tvb, offset, 4, ENC_LITTLE_ENDIAN);
-    offset += 4;
+    kerberos_live_unmap(kerberos_all_keys, evict);
+    kerberos_live_unmap(kerberos_app_session_keys, evict);
 
-    /* signature data */
-    proto_tree_add_item(tree, hf_krb_pac_signature_signature, tvb, offset, -1, ENC_NA);
+    link = &enc_key_list;
+    while ((ek = *link) != NULL) {
+        if (g_hash_table_contains(evict, ek)) {
+            *link = ek->next;
+            enc_key_list_len--;
+            continue;
+        }
+        ek->same_list = kerberos_live_first_kept(ek->same_list, evict);
+        if (ek->src1 && g_hash_table_contains(evict, ek->src1)) {
+            ek->src1 = NULL;
+        }
+        if (ek->src2 && g_hash_table_contains(evict, ek->src2)) {
+            ek->src2 = NULL;
+        }
+        link = &ek->next;
+    }
 
-    return offset;
+    kerberos_live_evicted_keys += g_hash_table_size(evict);
+    kerberos_live_evicted_key_bytes += (guint64)g_hash_table_size(evict) * sizeof(enc_key_t);
+    {
+        GHashTableIter iter;
+        gpointer key;
+
+        g_hash_table_iter_init(&iter, evict);
+        while (g_hash_table_iter_next(&iter, &key, NULL)) {
+            wmem_free(wmem_epan_scope(), key);
+        }
+    }
+    g_hash_table_destroy(evict);
 }
 
-static int
-dissect_krb5_PAC_PRIVSVR_CHECKSUM(proto_tree* parent_tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx _U_)
+/* The ticket of the key this message just learnt ends at endtime */
+static void
+kerberos_live_set_expiry(packet_info* pinfo, kerberos_private_data_t* private_data,
+    tvbuff_t* tvb, int offset)
 {
-    proto_item* item;
-    proto_tree* tree;
-
-    item = proto_tree_add_item(parent_tree, hf_krb_pac_privsvr_checksum, tvb, offset, -1, ENC_NA);
-    tree = proto_item_add_subtree(item, ett_krb_pac_privsvr_checksum);
-
-    /* signature type */
-    proto_tree_add_item(tree, hf_krb_pac_signature_type, tvb, offset, 4, ENC_LITTLE_ENDIAN);
-    offset += 4;
-
-    /* signature data */
-    proto_tree_add_item(tree, hf_krb_pac_signature_signature, tvb, offset, -1, ENC_NA);
+    enc_key_t* ek = private_data->last_added_key;
 
-    return offset;
+    if (!kerberos_live_mode || ek == NULL || ek->fd_num != (int)pinfo->num || PINFO_FD_VISITED(pinfo)) {
+        return;
+    }
+    ek->expires = kerberos_live_parse_time(tvb, offset);
 }
+#endif /* defined(HAVE_HEIMDAL_KERBEROS) || defined(HAVE_MIT_KERBEROS) */
 
-static int
-dissect_krb5_PAC_CLIENT_INFO_TYPE(proto_tree* parent_tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx _U_)
+static void
+kerberos_live_sweep(packet_info* pinfo)
 {
-    proto_item* item;
-    proto_tree* tree;
-    guint16 namelen;
+    time_t now = pinfo->abs_ts.secs;
+    gboolean over = FALSE;
 
-    item = proto_tree_add_item(parent_tree, hf_krb_pac_client_info_type, tvb, offset, -1, ENC_NA);
-    tree = proto_item_add_subtree(item, ett_krb_pac_client_info_type);
+#if defined(HAVE_HEIMDAL_KERBEROS) || defined(HAVE_MIT_KERBEROS)
+    over = enc_key_list_len > kerberos_live_max_keys + kerberos_longterm_ids;
+#endif
+    if (!over && now - kerberos_live_last_sweep < 60) {
+        return;
+    }
+    kerberos_live_last_sweep = now;
 
-    /* clientid */
-    offset = dissect_nt_64bit_time(tvb, tree, offset, hf_krb_pac_clientid);
+#if defined(HAVE_HEIMDAL_KERBEROS) || defined(HAVE_MIT_KERBEROS)
+    kerberos_live_evict_keys(now, over ? KRB_LIVE_LOW_WATER(kerberos_live_max_keys) : kerberos_live_max_keys);
+#endif
+    kerberos_breaker_sweep(now);
+    if (kerberos_log_pending != NULL && kerberos_log_queue != NULL) {
+        guint64 cutoff = (now > (time_t)kerberos_live_timeout) ?
+            (guint64)(now - kerberos_live_timeout) * 1000000000 : 0;
 
-    /* name length */
-    namelen = tvb_get_letohs(tvb, offset);
-    proto_tree_add_uint(tree, hf_krb_pac_namelen, tvb, offset, 2, namelen);
-    offset += 2;
+        kerberos_live_time_out_rows(cutoff);
+    }
+}
 
-    /* client name */
-    proto_tree_add_item(tree, hf_krb_pac_clientname, tvb, offset, namelen, ENC_UTF_16 | ENC_LITTLE_ENDIAN);
-    offset += namelen;
+/*
+ * Memory accounting (ber_mem_register) and the -z krb_mem,tree report.
+ * Byte counts are estimates: entries times the size of what each one
+ * holds, plus the map overhead.
+ */
+static guint kerberos_udp_conversations = 0;
 
-    return offset;
+static void
+kerberos_init(void)
+{
+    kerberos_udp_conversations = 0;
+    kerberos_breakers = 0;
+    kerberos_sample_count = 0;
+    kerberos_live_last_sweep = 0;
+#ifdef HAVE_MIT_KERBEROS
+    kerberos_missing_index_checked = FALSE;
+    kerberos_cache_reset();
+#endif
 }
 
-static int
-dissect_krb5_AD_WIN2K_PAC_struct(proto_tree* tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx)
+static void
+kerberos_mem_udp_conversations(guint* count, guint64* bytes)
 {
-    guint32 pac_type;
-    guint32 pac_size;
-    guint32 pac_offset;
-    proto_item* it = NULL;
-    proto_tree* tr = NULL;
-    tvbuff_t* next_tvb;
-
-    /* type of pac data */
-    pac_type = tvb_get_letohl(tvb, offset);
-    it = proto_tree_add_uint(tree, hf_krb_w2k_pac_type, tvb, offset, 4, pac_type);
-    tr = proto_item_add_subtree(it, ett_krb_pac);
+    *count = kerberos_udp_conversations;
+    *bytes = (guint64)kerberos_udp_conversations * (sizeof(conversation_t) + 2 * BER_MEM_MAP_ENTRY);
+}
 
-    offset += 4;
+static void
+kerberos_mem_pkinit_clients(guint* count, guint64* bytes)
+{
+    *count = wmem_map_size(kerberos_pkinit_clients);
+    *bytes = (guint64)*count * (sizeof(kerberos_pkinit_client_t) + BER_MEM_MAP_ENTRY);
+}
 
-    /* size of pac data */
-    pac_size = tvb_get_letohl(tvb, offset);
-    proto_tree_add_uint(tr, hf_krb_w2k_pac_size, tvb, offset, 4, pac_size);
-    offset += 4;
+#if defined(HAVE_HEIMDAL_KERBEROS) || defined(HAVE_MIT_KERBEROS)
+static void
+kerberos_mem_enc_key_list(guint* count, guint64* bytes)
+{
+    *count = enc_key_list_len;
+    *bytes = (guint64)enc_key_list_len * sizeof(enc_key_t);
+}
 
-    /* offset to pac data */
-    pac_offset = tvb_get_letohl(tvb, offset);
-    proto_tree_add_uint(tr, hf_krb_w2k_pac_offset, tvb, offset, 4, pac_offset);
-    offset += 8;
+/* the longterm keys themselves are on enc_key_list */
+static void
+kerberos_mem_longterm_keys(guint* count, guint64* bytes)
+{
+    *count = wmem_map_size(kerberos_longterm_keys);
+    *bytes = (guint64)*count * BER_MEM_MAP_ENTRY;
+}
 
-    next_tvb = tvb_new_subset_length_caplen(tvb, pac_offset, pac_size, pac_size);
-    switch (pac_type) {
-    case PAC_LOGON_INFO:
-        dissect_krb5_PAC_LOGON_INFO(tr, next_tvb, 0, actx);
-        break;
-    case PAC_CREDENTIAL_TYPE:
-        dissect_krb5_PAC_CREDENTIAL_INFO(tr, next_tvb, 0, actx);
-        break;
-    case PAC_SERVER_CHECKSUM:
-        dissect_krb5_PAC_SERVER_CHECKSUM(tr, next_tvb, 0, actx);
-        break;
-    case PAC_PRIVSVR_CHECKSUM:
-        dissect_krb5_PAC_PRIVSVR_CHECKSUM(tr, next_tvb, 0, actx);
-        break;
-    case PAC_CLIENT_INFO_TYPE:
-        dissect_krb5_PAC_CLIENT_INFO_TYPE(tr, next_tvb, 0, actx);
-        break;
-    case PAC_S4U_DELEGATION_INFO:
-        dissect_krb5_PAC_S4U_DELEGATION_INFO(tr, next_tvb, 0, actx);
-        break;
-    case PAC_UPN_DNS_INFO:
-        dissect_krb5_PAC_UPN_DNS_INFO(tr, next_tvb, 0, actx);
-        break;
-    case PAC_CLIENT_CLAIMS_INFO:
-        dissect_krb5_PAC_CLIENT_CLAIMS_INFO(tr, next_tvb, 0, actx);
-        break;
-    case PAC_DEVICE_INFO:
-        dissect_krb5_PAC_DEVICE_INFO(tr, next_tvb, 0, actx);
-        break;
-    case PAC_DEVICE_CLAIMS_INFO:
-        dissect_krb5_PAC_DEVICE_CLAIMS_INFO(tr, next_tvb, 0, actx);
-        break;
+static void
+kerberos_mem_all_keys(guint* count, guint64* bytes)
+{
+    *count = wmem_map_size(kerberos_all_keys);
+    *bytes = (guint64)*count * BER_MEM_MAP_ENTRY;
+}
 
-    default:
-        break;
-    }
-    return offset;
+static void
+kerberos_mem_app_session_keys(guint* count, guint64* bytes)
+{
+    *count = wmem_map_size(kerberos_app_session_keys);
+    *bytes = (guint64)*count * BER_MEM_MAP_ENTRY;
 }
+#endif /* defined(HAVE_HEIMDAL_KERBEROS) || defined(HAVE_MIT_KERBEROS) */
 
-static int
-dissect_krb5_AD_WIN2K_PAC(gboolean implicit_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx, proto_tree* tree, int hf_index _U_)
+#ifdef HAVE_MIT_KERBEROS
+/* counts the frames; the bytes include the per-index-key frame maps */
+static void
+kerberos_mem_missing_index(guint* count, guint64* bytes)
 {
-    guint32 entries;
-    guint32 version;
-    guint32 i;
+    *count = kerberos_missing_index_frames;
+    *bytes = (guint64)g_hash_table_size(kerberos_missing_index) * (BER_MEM_MAP_ENTRY + BER_MEM_HASH_TABLE) +
+        (guint64)kerberos_missing_index_frames * BER_MEM_MAP_ENTRY;
+}
+#endif /* HAVE_MIT_KERBEROS */
 
-#if defined(HAVE_MIT_KERBEROS) && defined(HAVE_KRB5_PAC_VERIFY)
-    verify_krb5_pac(tree, actx, tvb);
-#endif
+static const char* st_str_krb_mem_entries = "Entries";
+static const char* st_str_krb_mem_bytes = "Bytes (estimated)";
+static int st_node_krb_mem_entries = -1;
+static int st_node_krb_mem_bytes = -1;
 
-    /* first in the PAC structure comes the number of entries */
-    entries = tvb_get_letohl(tvb, offset);
-    proto_tree_add_uint(tree, hf_krb_w2k_pac_entries, tvb, offset, 4, entries);
-    offset += 4;
+static void
+krb_mem_stats_tree_init(stats_tree* st)
+{
+    st_node_krb_mem_entries = stats_tree_create_node(st, st_str_krb_mem_entries, 0, STAT_DT_INT, TRUE);
+    st_node_krb_mem_bytes = stats_tree_create_node(st, st_str_krb_mem_bytes, 0, STAT_DT_INT, TRUE);
+}
 
-    /* second comes the version */
-    version = tvb_get_letohl(tvb, offset);
-    proto_tree_add_uint(tree, hf_krb_w2k_pac_version, tvb, offset, 4, version);
-    offset += 4;
+static void
+krb_mem_stats_tree_account(const char* name, guint count, guint64 bytes, gpointer user_data)
+{
+    stats_tree* st = (stats_tree*)user_data;
 
-    for (i = 0; i < entries; i++) {
-        offset = dissect_krb5_AD_WIN2K_PAC_struct(tree, tvb, offset, actx);
-    }
+    set_stat_node(st, name, st_node_krb_mem_entries, FALSE, (gint)MIN(count, G_MAXINT));
+    set_stat_node(st, name, st_node_krb_mem_bytes, FALSE, (gint)MIN(bytes, G_MAXINT));
+}
 
-    return offset;
+/* Sampled on every frame, so the report shows the state at the end of
+ * the capture (or, from sharkd, at the time of the request). */
+static tap_packet_status
+krb_mem_stats_tree_packet(stats_tree* st, packet_info* pinfo _U_, epan_dissect_t* edt _U_, const void* p _U_)
+{
+    ber_mem_foreach(krb_mem_stats_tree_account, st);
+    return TAP_PACKET_REDRAW;
 }
 
 
@@ -4274,7 +7792,19 @@ dissect_kerberos_KerberosString(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, in
 
 static int
 dissect_kerberos_Realm(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_kerberos_KerberosString(implicit_tag, tvb, offset, actx, tree, hf_index);
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    tvbuff_t* realm_tvb = NULL;
+
+    offset = dissect_ber_restricted_string(implicit_tag, BER_UNI_TAG_GeneralString,
+        actx, tree, tvb, offset, hf_index,
+        &realm_tvb);
+
+    /* The first realm of a message names the client's realm */
+    if (realm_tvb && private_data->realm == NULL) {
+        private_data->realm = tvb_get_string_enc(wmem_packet_scope(), realm_tvb, 0,
+            tvb_reported_length(realm_tvb), ENC_ASCII);
+        kerberos_remember_pkinit_layout(actx->pinfo, private_data);
+    }
 
     return offset;
 }
@@ -4316,9 +7846,16 @@ dissect_kerberos_NAME_TYPE(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int off
 
 static int
 dissect_kerberos_SNameString(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    tvbuff_t* name_tvb = NULL;
+
     offset = dissect_ber_restricted_string(implicit_tag, BER_UNI_TAG_GeneralString,
         actx, tree, tvb, offset, hf_index,
-        NULL);
+        &name_tvb);
+
+    if (kerberos_log_wants_server(private_data)) {
+        kerberos_log_append_name(&private_data->log->server, name_tvb);
+    }
 
     return offset;
 }
@@ -4328,26 +7865,26 @@ static const ber_sequence_t SEQUENCE_OF_SNameString_sequence_of[1] = {
   { &hf_kerberos_sname_string_item, BER_CLASS_UNI, BER_UNI_TAG_GeneralString, BER_FLAGS_NOOWNTAG, dissect_kerberos_SNameString },
 };
 
-static int
-dissect_kerberos_SEQUENCE_OF_SNameString(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence_of(implicit_tag, actx, tree, tvb, offset,
-        SEQUENCE_OF_SNameString_sequence_of, hf_index, ett_kerberos_SEQUENCE_OF_SNameString);
-
-    return offset;
-}
+static const ber_schema_t kerberos_schema_SEQUENCE_OF_SNameString = BER_SCHEMA_SEQ_OF(SEQUENCE_OF_SNameString_sequence_of, ett_kerberos_SEQUENCE_OF_SNameString);
 
 
 static const ber_sequence_t SName_sequence[] = {
   { &hf_kerberos_name_type  , BER_CLASS_CON, 0, 0, dissect_kerberos_NAME_TYPE },
-  { &hf_kerberos_sname_string, BER_CLASS_CON, 1, 0, dissect_kerberos_SEQUENCE_OF_SNameString },
+  { &hf_kerberos_sname_string, BER_CLASS_CON, 1, 0, dissect_ber_schema_field },
   { NULL, 0, 0, 0, NULL }
 };
 
 static int
 dissect_kerberos_SName(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+
     offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
         SName_sequence, hf_index, ett_kerberos_SName);
 
+    if (kerberos_log_wants_server(private_data) && private_data->log->server) {
+        private_data->log->server_done = TRUE;
+    }
+
     return offset;
 }
 
@@ -4397,18 +7934,278 @@ dissect_kerberos_ENCTYPE(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offse
     offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
         &(private_data->etype));
 
+    if (private_data->log && hf_index == hf_kerberos_kDC_REQ_BODY_etype_item) {
+        kerberos_log_append_uint(&private_data->log->etypes, private_data->etype);
+    }
+
+
+
+
+    return offset;
+}
+
+
+
+static int
+dissect_kerberos_UInt32(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
+        NULL);
+
+    return offset;
+}
+
+
+
+static int
+dissect_kerberos_T_encryptedTicketData_cipher(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 309 "./asn1/kerberos/kerberos.cnf"
+#ifdef HAVE_KERBEROS
+    offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_index, dissect_krb5_decrypt_ticket_data);
+#else
+    offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index,
+        NULL);
+
+#endif
+
+
+
+    return offset;
+}
+
+
+static const ber_sequence_t EncryptedTicketData_sequence[] = {
+  { &hf_kerberos_etype      , BER_CLASS_CON, 0, 0, dissect_kerberos_ENCTYPE },
+  { &hf_kerberos_kvno       , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
+  { &hf_kerberos_encryptedTicketData_cipher, BER_CLASS_CON, 2, 0, dissect_kerberos_T_encryptedTicketData_cipher },
+  { NULL, 0, 0, 0, NULL }
+};
+
+static const ber_schema_t kerberos_schema_EncryptedTicketData = BER_SCHEMA_SEQ(EncryptedTicketData_sequence, ett_kerberos_EncryptedTicketData);
+
+
+static const ber_sequence_t Ticket_U_sequence[] = {
+  { &hf_kerberos_tkt_vno    , BER_CLASS_CON, 0, 0, dissect_kerberos_INTEGER_5 },
+  { &hf_kerberos_realm      , BER_CLASS_CON, 1, 0, dissect_kerberos_Realm },
+  { &hf_kerberos_sname      , BER_CLASS_CON, 2, 0, dissect_kerberos_SName },
+  { &hf_kerberos_ticket_enc_part, BER_CLASS_CON, 3, 0, dissect_ber_schema_field },
+  { NULL, 0, 0, 0, NULL }
+};
+
+static const ber_schema_t kerberos_schema_Ticket_U = BER_SCHEMA_SEQ(Ticket_U_sequence, ett_kerberos_Ticket_U);
+
+static int
+dissect_kerberos_Ticket_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_Ticket_U, hf_index);
+
+    return offset;
+}
+
+
+
+static int
+dissect_kerberos_Ticket(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    gboolean in_req_body = FALSE;
+
+    if (private_data->log) {
+        in_req_body = private_data->log->in_req_body;
+        private_data->log->in_req_body = FALSE;
+    }
+    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
+        hf_index, BER_CLASS_APP, 1, FALSE, dissect_kerberos_Ticket_U);
+    if (private_data->log) {
+        private_data->log->in_req_body = in_req_body;
+    }
+
+    return offset;
+}
+
+
+
+static int
+dissect_kerberos_CNameString(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    tvbuff_t* name_tvb = NULL;
+
+    offset = dissect_ber_restricted_string(implicit_tag, BER_UNI_TAG_GeneralString,
+        actx, tree, tvb, offset, hf_index,
+        &name_tvb);
+
+    if (private_data->log && !private_data->log->client_done) {
+        kerberos_log_append_name(&private_data->log->client, name_tvb);
+    }
+
+    return offset;
+}
+
+
+static const ber_sequence_t SEQUENCE_OF_CNameString_sequence_of[1] = {
+  { &hf_kerberos_cname_string_item, BER_CLASS_UNI, BER_UNI_TAG_GeneralString, BER_FLAGS_NOOWNTAG, dissect_kerberos_CNameString },
+};
+
+static const ber_schema_t kerberos_schema_SEQUENCE_OF_CNameString = BER_SCHEMA_SEQ_OF(SEQUENCE_OF_CNameString_sequence_of, ett_kerberos_SEQUENCE_OF_CNameString);
+
+
+static const ber_sequence_t CName_sequence[] = {
+  { &hf_kerberos_name_type  , BER_CLASS_CON, 0, 0, dissect_kerberos_NAME_TYPE },
+  { &hf_kerberos_cname_string, BER_CLASS_CON, 1, 0, dissect_ber_schema_field },
+  { NULL, 0, 0, 0, NULL }
+};
+
+static int
+dissect_kerberos_CName(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+
+    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
+        CName_sequence, hf_index, ett_kerberos_CName);
+
+    if (private_data->log && private_data->log->client) {
+        private_data->log->client_done = TRUE;
+    }
+
+    return offset;
+}
+
+
+static const value_string kerberos_CKSUMTYPE_vals[] = {
+  {   0, "cKSUMTYPE-NONE" },
+  {   1, "cKSUMTYPE-CRC32" },
+  {   2, "cKSUMTYPE-RSA-MD4" },
+  {   3, "cKSUMTYPE-RSA-MD4-DES" },
+  {   4, "cKSUMTYPE-DES-MAC" },
+  {   5, "cKSUMTYPE-DES-MAC-K" },
+  {   6, "cKSUMTYPE-RSA-MD4-DES-K" },
+  {   7, "cKSUMTYPE-RSA-MD5" },
+  {   8, "cKSUMTYPE-RSA-MD5-DES" },
+  {   9, "cKSUMTYPE-RSA-MD5-DES3" },
+  {  10, "cKSUMTYPE-SHA1-OTHER" },
+  {  12, "cKSUMTYPE-HMAC-SHA1-DES3-KD" },
+  {  13, "cKSUMTYPE-HMAC-SHA1-DES3" },
+  {  14, "cKSUMTYPE-SHA1" },
+  {  15, "cKSUMTYPE-HMAC-SHA1-96-AES-128" },
+  {  16, "cKSUMTYPE-HMAC-SHA1-96-AES-256" },
+  {  17, "cKSUMTYPE-CMAC-CAMELLIA128" },
+  {  18, "cKSUMTYPE-CMAC-CAMELLIA256" },
+  {  19, "cKSUMTYPE-HMAC-SHA256-128-AES128" },
+  {  20, "cKSUMTYPE-HMAC-SHA384-192-AES256" },
+  { 32771, "cKSUMTYPE-GSSAPI" },
+  { -138, "cKSUMTYPE-HMAC-MD5" },
+  { -1138, "cKSUMTYPE-HMAC-MD5-ENC" },
+  { 0, NULL }
+};
+
+
+static int
+dissect_kerberos_CKSUMTYPE(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 365 "./asn1/kerberos/kerberos.cnf"
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
+        &(private_data->checksum_type));
+
+
+
+
+    return offset;
+}
+
+
+
+static int
+dissect_kerberos_T_checksum(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 369 "./asn1/kerberos/kerberos.cnf"
+    tvbuff_t* next_tvb;
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+
+    switch (private_data->checksum_type) {
+    case KRB5_CHKSUM_GSSAPI:
+        offset = dissect_ber_octet_string(FALSE, actx, tree, tvb, offset, hf_index, &next_tvb);
+        dissect_krb5_rfc1964_checksum(actx, tree, next_tvb);
+        break;
+    default:
+        offset = dissect_ber_octet_string(FALSE, actx, tree, tvb, offset, hf_index, NULL);
+        break;
+    }
+
+
+
+    return offset;
+}
+
+
+static const ber_sequence_t Checksum_sequence[] = {
+  { &hf_kerberos_cksumtype  , BER_CLASS_CON, 0, 0, dissect_kerberos_CKSUMTYPE },
+  { &hf_kerberos_checksum   , BER_CLASS_CON, 1, 0, dissect_kerberos_T_checksum },
+  { NULL, 0, 0, 0, NULL }
+};
+
+static const ber_schema_t kerberos_schema_Checksum = BER_SCHEMA_SEQ(Checksum_sequence, ett_kerberos_Checksum);
+
+static int
+dissect_kerberos_Checksum(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_Checksum, hf_index);
+
+    return offset;
+}
+
+
+
+static int
+dissect_kerberos_Microseconds(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
+        NULL);
+
+    return offset;
+}
+
+
+
+static int
+dissect_kerberos_KerberosTime(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#if defined(HAVE_HEIMDAL_KERBEROS) || defined(HAVE_MIT_KERBEROS)
+    int time_offset = offset;
+#endif
+
+    offset = dissect_ber_GeneralizedTime(implicit_tag, actx, tree, tvb, offset, hf_index);
+
+#if defined(HAVE_HEIMDAL_KERBEROS) || defined(HAVE_MIT_KERBEROS)
+    if (hf_index == hf_kerberos_endtime && !implicit_tag) {
+        kerberos_live_set_expiry(actx->pinfo, kerberos_get_private_data(actx), tvb, time_offset);
+    }
+#endif
+
+    return offset;
+}
+
 
 
+static int
+dissect_kerberos_Int32(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
+        NULL);
 
     return offset;
 }
 
 
 
-static int
-dissect_kerberos_UInt32(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
-        NULL);
+static int
+dissect_kerberos_T_keytype(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 383 "./asn1/kerberos/kerberos.cnf"
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+
+    private_data->key_hidden_item = proto_tree_add_item(tree, hf_krb_key_hidden_item,
+        tvb, 0, 0, ENC_NA);
+    if (private_data->key_hidden_item != NULL) {
+        proto_item_set_hidden(private_data->key_hidden_item);
+    }
+
+    offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
+        &gbl_keytype);
+    private_data->key.keytype = gbl_keytype;
+
+
 
     return offset;
 }
@@ -4416,15 +8213,19 @@ dissect_kerberos_UInt32(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset
 
 
 static int
-dissect_kerberos_T_encryptedTicketData_cipher(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 309 "./asn1/kerberos/kerberos.cnf"
-#ifdef HAVE_KERBEROS
-    offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_index, dissect_krb5_decrypt_ticket_data);
-#else
+dissect_kerberos_T_keyvalue(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 396 "./asn1/kerberos/kerberos.cnf"
+    tvbuff_t* out_tvb;
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+
     offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index,
-        NULL);
+        &out_tvb);
 
-#endif
+
+    private_data->key.keylength = tvb_reported_length(out_tvb);
+    private_data->key.keyvalue = tvb_get_ptr(out_tvb, 0, private_data->key.keylength);
+    private_data->key_tree = tree;
+    private_data->key_tvb = out_tvb;
 
 
 
@@ -4432,34 +8233,36 @@ dissect_kerberos_T_encryptedTicketData_cipher(gboolean implicit_tag _U_, tvbuff_
 }
 
 
-static const ber_sequence_t EncryptedTicketData_sequence[] = {
-  { &hf_kerberos_etype      , BER_CLASS_CON, 0, 0, dissect_kerberos_ENCTYPE },
-  { &hf_kerberos_kvno       , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
-  { &hf_kerberos_encryptedTicketData_cipher, BER_CLASS_CON, 2, 0, dissect_kerberos_T_encryptedTicketData_cipher },
+static const ber_sequence_t EncryptionKey_sequence[] = {
+  { &hf_kerberos_keytype    , BER_CLASS_CON, 0, 0, dissect_kerberos_T_keytype },
+  { &hf_kerberos_keyvalue   , BER_CLASS_CON, 1, 0, dissect_kerberos_T_keyvalue },
   { NULL, 0, 0, 0, NULL }
 };
 
 static int
-dissect_kerberos_EncryptedTicketData(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+dissect_kerberos_EncryptionKey(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 407 "./asn1/kerberos/kerberos.cnf"
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+#ifdef HAVE_KERBEROS
+    int start_offset = offset;
+#endif
+
     offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        EncryptedTicketData_sequence, hf_index, ett_kerberos_EncryptedTicketData);
+        EncryptionKey_sequence, hf_index, ett_kerberos_EncryptionKey);
 
-    return offset;
-}
 
+    if (private_data->key.keytype != 0 && private_data->key.keylength > 0) {
+#ifdef HAVE_KERBEROS
+        int length = offset - start_offset;
+        private_data->last_added_key = NULL;
+        private_data->save_encryption_key_fn(tvb, start_offset, length, actx, tree,
+            private_data->save_encryption_key_parent_hf_index,
+            hf_index);
+        private_data->last_added_key = NULL;
+#endif
+    }
 
-static const ber_sequence_t Ticket_U_sequence[] = {
-  { &hf_kerberos_tkt_vno    , BER_CLASS_CON, 0, 0, dissect_kerberos_INTEGER_5 },
-  { &hf_kerberos_realm      , BER_CLASS_CON, 1, 0, dissect_kerberos_Realm },
-  { &hf_kerberos_sname      , BER_CLASS_CON, 2, 0, dissect_kerberos_SName },
-  { &hf_kerberos_ticket_enc_part, BER_CLASS_CON, 3, 0, dissect_kerberos_EncryptedTicketData },
-  { NULL, 0, 0, 0, NULL }
-};
 
-static int
-dissect_kerberos_Ticket_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        Ticket_U_sequence, hf_index, ett_kerberos_Ticket_U);
 
     return offset;
 }
@@ -4467,90 +8270,150 @@ dissect_kerberos_Ticket_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offs
 
 
 static int
-dissect_kerberos_Ticket(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
-        hf_index, BER_CLASS_APP, 1, FALSE, dissect_kerberos_Ticket_U);
+dissect_kerberos_T_authenticator_subkey(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 426 "./asn1/kerberos/kerberos.cnf"
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    gint save_encryption_key_parent_hf_index = private_data->save_encryption_key_parent_hf_index;
+    kerberos_key_save_fn saved_encryption_key_fn = private_data->save_encryption_key_fn;
+    private_data->save_encryption_key_parent_hf_index = hf_kerberos_authenticator;
+#ifdef HAVE_KERBEROS
+    private_data->save_encryption_key_fn = save_Authenticator_subkey;
+#endif
+    offset = dissect_kerberos_EncryptionKey(implicit_tag, tvb, offset, actx, tree, hf_index);
+
+    private_data->save_encryption_key_parent_hf_index = save_encryption_key_parent_hf_index;
+    private_data->save_encryption_key_fn = saved_encryption_key_fn;
+
+
 
     return offset;
 }
 
 
+static const value_string kerberos_AUTHDATA_TYPE_vals[] = {
+  { KERBEROS_AD_IF_RELEVANT, "aD-IF-RELEVANT" },
+  { KERBEROS_AD_INTENDED_FOR_SERVER, "aD-INTENDED-FOR-SERVER" },
+  { KERBEROS_AD_INTENDED_FOR_APPLICATION_CLASS, "aD-INTENDED-FOR-APPLICATION-CLASS" },
+  { KERBEROS_AD_KDC_ISSUED, "aD-KDC-ISSUED" },
+  { KERBEROS_AD_AND_OR, "aD-AND-OR" },
+  { KERBEROS_AD_MANDATORY_TICKET_EXTENSIONS, "aD-MANDATORY-TICKET-EXTENSIONS" },
+  { KERBEROS_AD_IN_TICKET_EXTENSIONS, "aD-IN-TICKET-EXTENSIONS" },
+  { KERBEROS_AD_MANDATORY_FOR_KDC, "aD-MANDATORY-FOR-KDC" },
+  { KERBEROS_AD_INITIAL_VERIFIED_CAS, "aD-INITIAL-VERIFIED-CAS" },
+  { KERBEROS_AD_OSF_DCE, "aD-OSF-DCE" },
+  { KERBEROS_AD_SESAME, "aD-SESAME" },
+  { KERBEROS_AD_OSF_DCE_PKI_CERTID, "aD-OSF-DCE-PKI-CERTID" },
+  { KERBEROS_AD_AUTHENTICATION_STRENGTH, "aD-authentication-strength" },
+  { KERBEROS_AD_FX_FAST_ARMOR, "aD-fx-fast-armor" },
+  { KERBEROS_AD_FX_FAST_USED, "aD-fx-fast-used" },
+  { KERBEROS_AD_WIN2K_PAC, "aD-WIN2K-PAC" },
+  { KERBEROS_AD_GSS_API_ETYPE_NEGOTIATION, "aD-GSS-API-ETYPE-NEGOTIATION" },
+  { KERBEROS_AD_TOKEN_RESTRICTIONS, "aD-TOKEN-RESTRICTIONS" },
+  { KERBEROS_AD_LOCAL, "aD-LOCAL" },
+  { KERBEROS_AD_AP_OPTIONS, "aD-AP-OPTIONS" },
+  { KERBEROS_AD_TARGET_PRINCIPAL, "aD-TARGET-PRINCIPAL" },
+  { KERBEROS_AD_SIGNTICKET_OLDER, "aD-SIGNTICKET-OLDER" },
+  { KERBEROS_AD_SIGNTICKET, "aD-SIGNTICKET" },
+  { 0, NULL }
+};
+
 
 static int
-dissect_kerberos_CNameString(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_restricted_string(implicit_tag, BER_UNI_TAG_GeneralString,
-        actx, tree, tvb, offset, hf_index,
-        NULL);
+dissect_kerberos_AUTHDATA_TYPE(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 495 "./asn1/kerberos/kerberos.cnf"
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
+        &(private_data->ad_type));
+
+
+
 
     return offset;
 }
 
 
-static const ber_sequence_t SEQUENCE_OF_CNameString_sequence_of[1] = {
-  { &hf_kerberos_cname_string_item, BER_CLASS_UNI, BER_UNI_TAG_GeneralString, BER_FLAGS_NOOWNTAG, dissect_kerberos_CNameString },
-};
 
 static int
-dissect_kerberos_SEQUENCE_OF_CNameString(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence_of(implicit_tag, actx, tree, tvb, offset,
-        SEQUENCE_OF_CNameString_sequence_of, hf_index, ett_kerberos_SEQUENCE_OF_CNameString);
+dissect_kerberos_T_ad_data(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 499 "./asn1/kerberos/kerberos.cnf"
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+
+    switch (private_data->ad_type) {
+    case KERBEROS_AD_WIN2K_PAC:
+        offset = dissect_ber_octet_string_wcb(implicit_tag, actx, tree, tvb, offset, hf_index, dissect_krb5_AD_WIN2K_PAC);
+        break;
+    case KERBEROS_AD_IF_RELEVANT:
+        offset = dissect_ber_octet_string_wcb(implicit_tag, actx, tree, tvb, offset, hf_index, dissect_kerberos_AD_IF_RELEVANT);
+        break;
+    case KERBEROS_AD_AUTHENTICATION_STRENGTH:
+        offset = dissect_ber_octet_string_wcb(implicit_tag, actx, tree, tvb, offset, hf_index, dissect_kerberos_PA_AUTHENTICATION_SET_ELEM);
+        break;
+    case KERBEROS_AD_GSS_API_ETYPE_NEGOTIATION:
+        offset = dissect_ber_octet_string_wcb(implicit_tag, actx, tree, tvb, offset, hf_index, dissect_kerberos_SEQUENCE_OF_ENCTYPE);
+        break;
+    case KERBEROS_AD_TOKEN_RESTRICTIONS:
+        offset = dissect_ber_octet_string_wcb(implicit_tag, actx, tree, tvb, offset, hf_index, dissect_kerberos_KERB_AD_RESTRICTION_ENTRY);
+        break;
+    case KERBEROS_AD_AP_OPTIONS:
+        offset = dissect_ber_octet_string_wcb(implicit_tag, actx, tree, tvb, offset, hf_index, dissect_kerberos_AD_AP_OPTIONS);
+        break;
+    case KERBEROS_AD_TARGET_PRINCIPAL:
+        offset = dissect_ber_octet_string_wcb(implicit_tag, actx, tree, tvb, offset, hf_index, dissect_kerberos_AD_TARGET_PRINCIPAL);
+        break;
+    default:
+        offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index, NULL);
+        break;
+    }
+
+
 
     return offset;
 }
 
 
-static const ber_sequence_t CName_sequence[] = {
-  { &hf_kerberos_name_type  , BER_CLASS_CON, 0, 0, dissect_kerberos_NAME_TYPE },
-  { &hf_kerberos_cname_string, BER_CLASS_CON, 1, 0, dissect_kerberos_SEQUENCE_OF_CNameString },
+static const ber_sequence_t AuthorizationData_item_sequence[] = {
+  { &hf_kerberos_ad_type    , BER_CLASS_CON, 0, 0, dissect_kerberos_AUTHDATA_TYPE },
+  { &hf_kerberos_ad_data    , BER_CLASS_CON, 1, 0, dissect_kerberos_T_ad_data },
   { NULL, 0, 0, 0, NULL }
 };
 
+static const ber_schema_t kerberos_schema_AuthorizationData_item = BER_SCHEMA_SEQ(AuthorizationData_item_sequence, ett_kerberos_AuthorizationData_item);
+
+
+static const ber_sequence_t AuthorizationData_sequence_of[1] = {
+  { &hf_kerberos_AuthorizationData_item, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, BER_FLAGS_NOOWNTAG, dissect_ber_schema_field },
+};
+
+static const ber_schema_t kerberos_schema_AuthorizationData = BER_SCHEMA_SEQ_OF(AuthorizationData_sequence_of, ett_kerberos_AuthorizationData);
+
 static int
-dissect_kerberos_CName(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        CName_sequence, hf_index, ett_kerberos_CName);
+dissect_kerberos_AuthorizationData(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_AuthorizationData, hf_index);
 
     return offset;
 }
 
 
-static const value_string kerberos_CKSUMTYPE_vals[] = {
-  {   0, "cKSUMTYPE-NONE" },
-  {   1, "cKSUMTYPE-CRC32" },
-  {   2, "cKSUMTYPE-RSA-MD4" },
-  {   3, "cKSUMTYPE-RSA-MD4-DES" },
-  {   4, "cKSUMTYPE-DES-MAC" },
-  {   5, "cKSUMTYPE-DES-MAC-K" },
-  {   6, "cKSUMTYPE-RSA-MD4-DES-K" },
-  {   7, "cKSUMTYPE-RSA-MD5" },
-  {   8, "cKSUMTYPE-RSA-MD5-DES" },
-  {   9, "cKSUMTYPE-RSA-MD5-DES3" },
-  {  10, "cKSUMTYPE-SHA1-OTHER" },
-  {  12, "cKSUMTYPE-HMAC-SHA1-DES3-KD" },
-  {  13, "cKSUMTYPE-HMAC-SHA1-DES3" },
-  {  14, "cKSUMTYPE-SHA1" },
-  {  15, "cKSUMTYPE-HMAC-SHA1-96-AES-128" },
-  {  16, "cKSUMTYPE-HMAC-SHA1-96-AES-256" },
-  {  17, "cKSUMTYPE-CMAC-CAMELLIA128" },
-  {  18, "cKSUMTYPE-CMAC-CAMELLIA256" },
-  {  19, "cKSUMTYPE-HMAC-SHA256-128-AES128" },
-  {  20, "cKSUMTYPE-HMAC-SHA384-192-AES256" },
-  { 32771, "cKSUMTYPE-GSSAPI" },
-  { -138, "cKSUMTYPE-HMAC-MD5" },
-  { -1138, "cKSUMTYPE-HMAC-MD5-ENC" },
-  { 0, NULL }
+static const ber_sequence_t Authenticator_U_sequence[] = {
+  { &hf_kerberos_authenticator_vno, BER_CLASS_CON, 0, 0, dissect_kerberos_INTEGER_5 },
+  { &hf_kerberos_crealm     , BER_CLASS_CON, 1, 0, dissect_kerberos_Realm },
+  { &hf_kerberos_cname      , BER_CLASS_CON, 2, 0, dissect_kerberos_CName },
+  { &hf_kerberos_cksum      , BER_CLASS_CON, 3, BER_FLAGS_OPTIONAL, dissect_kerberos_Checksum },
+  { &hf_kerberos_cusec      , BER_CLASS_CON, 4, 0, dissect_kerberos_Microseconds },
+  { &hf_kerberos_ctime      , BER_CLASS_CON, 5, 0, dissect_kerberos_KerberosTime },
+  { &hf_kerberos_authenticator_subkey, BER_CLASS_CON, 6, BER_FLAGS_OPTIONAL, dissect_kerberos_T_authenticator_subkey },
+  { &hf_kerberos_seq_number , BER_CLASS_CON, 7, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
+  { &hf_kerberos_authorization_data, BER_CLASS_CON, 8, BER_FLAGS_OPTIONAL, dissect_kerberos_AuthorizationData },
+  { NULL, 0, 0, 0, NULL }
 };
 
+static const ber_schema_t kerberos_schema_Authenticator_U = BER_SCHEMA_SEQ(Authenticator_U_sequence, ett_kerberos_Authenticator_U);
 
 static int
-dissect_kerberos_CKSUMTYPE(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 365 "./asn1/kerberos/kerberos.cnf"
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-    offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
-        &(private_data->checksum_type));
-
-
-
+dissect_kerberos_Authenticator_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_Authenticator_U, hf_index);
 
     return offset;
 }
@@ -4558,37 +8421,69 @@ dissect_kerberos_CKSUMTYPE(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int off
 
 
 static int
-dissect_kerberos_T_checksum(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 369 "./asn1/kerberos/kerberos.cnf"
-    tvbuff_t* next_tvb;
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+dissect_kerberos_Authenticator(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
+        hf_index, BER_CLASS_APP, 2, FALSE, dissect_kerberos_Authenticator_U);
 
-    switch (private_data->checksum_type) {
-    case KRB5_CHKSUM_GSSAPI:
-        offset = dissect_ber_octet_string(FALSE, actx, tree, tvb, offset, hf_index, &next_tvb);
-        dissect_krb5_rfc1964_checksum(actx, tree, next_tvb);
-        break;
-    default:
-        offset = dissect_ber_octet_string(FALSE, actx, tree, tvb, offset, hf_index, NULL);
-        break;
-    }
+    return offset;
+}
+
+
+static const int* TicketFlags_bits[] = {
+  &hf_kerberos_TicketFlags_reserved,
+  &hf_kerberos_TicketFlags_forwardable,
+  &hf_kerberos_TicketFlags_forwarded,
+  &hf_kerberos_TicketFlags_proxiable,
+  &hf_kerberos_TicketFlags_proxy,
+  &hf_kerberos_TicketFlags_may_postdate,
+  &hf_kerberos_TicketFlags_postdated,
+  &hf_kerberos_TicketFlags_invalid,
+  &hf_kerberos_TicketFlags_renewable,
+  &hf_kerberos_TicketFlags_initial,
+  &hf_kerberos_TicketFlags_pre_authent,
+  &hf_kerberos_TicketFlags_hw_authent,
+  &hf_kerberos_TicketFlags_transited_policy_checked,
+  &hf_kerberos_TicketFlags_ok_as_delegate,
+  &hf_kerberos_TicketFlags_unused,
+  &hf_kerberos_TicketFlags_enc_pa_rep,
+  &hf_kerberos_TicketFlags_anonymous,
+  NULL
+};
 
+static int
+dissect_kerberos_TicketFlags(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    tvbuff_t* bits_tvb = NULL;
+
+    offset = dissect_ber_bitstring(implicit_tag, actx, tree, tvb, offset,
+        TicketFlags_bits, 17, hf_index, ett_kerberos_TicketFlags,
+        &bits_tvb);
 
+    if (private_data->log) {
+        private_data->log->ticket_flags = kerberos_log_bits(bits_tvb);
+    }
 
     return offset;
 }
 
 
-static const ber_sequence_t Checksum_sequence[] = {
-  { &hf_kerberos_cksumtype  , BER_CLASS_CON, 0, 0, dissect_kerberos_CKSUMTYPE },
-  { &hf_kerberos_checksum   , BER_CLASS_CON, 1, 0, dissect_kerberos_T_checksum },
-  { NULL, 0, 0, 0, NULL }
-};
 
 static int
-dissect_kerberos_Checksum(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        Checksum_sequence, hf_index, ett_kerberos_Checksum);
+dissect_kerberos_T_encTicketPart_key(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 471 "./asn1/kerberos/kerberos.cnf"
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    gint save_encryption_key_parent_hf_index = private_data->save_encryption_key_parent_hf_index;
+    kerberos_key_save_fn saved_encryption_key_fn = private_data->save_encryption_key_fn;
+    private_data->save_encryption_key_parent_hf_index = hf_kerberos_encTicketPart;
+#ifdef HAVE_KERBEROS
+    private_data->save_encryption_key_fn = save_EncTicketPart_key;
+#endif
+    offset = dissect_kerberos_EncryptionKey(implicit_tag, tvb, offset, actx, tree, hf_index);
+
+    private_data->save_encryption_key_parent_hf_index = save_encryption_key_parent_hf_index;
+    private_data->save_encryption_key_fn = saved_encryption_key_fn;
+
+
 
     return offset;
 }
@@ -4596,28 +8491,45 @@ dissect_kerberos_Checksum(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offs
 
 
 static int
-dissect_kerberos_Microseconds(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
+dissect_kerberos_OCTET_STRING(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index,
         NULL);
 
     return offset;
 }
 
 
+static const ber_sequence_t TransitedEncoding_sequence[] = {
+  { &hf_kerberos_tr_type    , BER_CLASS_CON, 0, 0, dissect_kerberos_Int32 },
+  { &hf_kerberos_contents   , BER_CLASS_CON, 1, 0, dissect_kerberos_OCTET_STRING },
+  { NULL, 0, 0, 0, NULL }
+};
 
-static int
-dissect_kerberos_KerberosTime(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_GeneralizedTime(implicit_tag, actx, tree, tvb, offset, hf_index);
+static const ber_schema_t kerberos_schema_TransitedEncoding = BER_SCHEMA_SEQ(TransitedEncoding_sequence, ett_kerberos_TransitedEncoding);
 
-    return offset;
-}
 
+static const value_string kerberos_ADDR_TYPE_vals[] = {
+  { KERBEROS_ADDR_TYPE_IPV4, "iPv4" },
+  { KERBEROS_ADDR_TYPE_CHAOS, "cHAOS" },
+  { KERBEROS_ADDR_TYPE_XEROX, "xEROX" },
+  { KERBEROS_ADDR_TYPE_ISO, "iSO" },
+  { KERBEROS_ADDR_TYPE_DECNET, "dECNET" },
+  { KERBEROS_ADDR_TYPE_APPLETALK, "aPPLETALK" },
+  { KERBEROS_ADDR_TYPE_NETBIOS, "nETBIOS" },
+  { KERBEROS_ADDR_TYPE_IPV6, "iPv6" },
+  { 0, NULL }
+};
 
 
 static int
-dissect_kerberos_Int32(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+dissect_kerberos_ADDR_TYPE(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 532 "./asn1/kerberos/kerberos.cnf"
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
     offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
-        NULL);
+        &(private_data->addr_type));
+
+
+
 
     return offset;
 }
@@ -4625,142 +8537,250 @@ dissect_kerberos_Int32(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset
 
 
 static int
-dissect_kerberos_T_keytype(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 383 "./asn1/kerberos/kerberos.cnf"
+dissect_kerberos_T_address(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 254 "./asn1/kerberos/kerberos.cnf"
+    gint8 appclass;
+    gboolean pc;
+    gint32 tag;
+    guint32 len;
+    const char* address_str;
+    proto_item* it = NULL;
     kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
 
-    private_data->key_hidden_item = proto_tree_add_item(tree, hf_krb_key_hidden_item,
-        tvb, 0, 0, ENC_NA);
-    if (private_data->key_hidden_item != NULL) {
-        proto_item_set_hidden(private_data->key_hidden_item);
-    }
+    /* read header and len for the octet string */
+    offset = dissect_ber_identifier(actx->pinfo, tree, tvb, offset, &appclass, &pc, &tag);
+    offset = dissect_ber_length(actx->pinfo, tree, tvb, offset, &len, NULL);
 
-    offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
-        &gbl_keytype);
-    private_data->key.keytype = gbl_keytype;
+    switch (private_data->addr_type) {
+    case KERBEROS_ADDR_TYPE_IPV4:
+        it = proto_tree_add_item(tree, hf_krb_address_ip, tvb, offset, 4, ENC_BIG_ENDIAN);
+        address_str = tvb_ip_to_str(tvb, offset);
+        break;
+    case KERBEROS_ADDR_TYPE_NETBIOS:
+    {
+        char netbios_name[(NETBIOS_NAME_LEN - 1) * 4 + 1];
+        int netbios_name_type;
+        int netbios_name_len = (NETBIOS_NAME_LEN - 1) * 4 + 1;
 
+        netbios_name_type = process_netbios_name(tvb_get_ptr(tvb, offset, 16), netbios_name, netbios_name_len);
+        address_str = wmem_strdup_printf(wmem_packet_scope(), "%s<%02x>", netbios_name, netbios_name_type);
+        it = proto_tree_add_string_format(tree, hf_krb_address_netbios, tvb, offset, 16, netbios_name, "NetBIOS Name: %s (%s)", address_str, netbios_name_type_descr(netbios_name_type));
+    }
+    break;
+    case KERBEROS_ADDR_TYPE_IPV6:
+        it = proto_tree_add_item(tree, hf_krb_address_ipv6, tvb, offset, INET6_ADDRLEN, ENC_NA);
+        address_str = tvb_ip6_to_str(tvb, offset);
+        break;
+    default:
+        proto_tree_add_expert(tree, actx->pinfo, &ei_kerberos_address, tvb, offset, len);
+        address_str = NULL;
+        break;
+    }
 
+    /* push it up two levels in the decode pane */
+    if (it && address_str) {
+        proto_item_append_text(proto_item_get_parent(it), " %s", address_str);
+        proto_item_append_text(proto_item_get_parent_nth(it, 2), " %s", address_str);
+    }
 
-    return offset;
-}
+    offset += len;
 
 
 
-static int
-dissect_kerberos_T_keyvalue(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 396 "./asn1/kerberos/kerberos.cnf"
-    tvbuff_t* out_tvb;
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
 
-    offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index,
-        &out_tvb);
+    return offset;
+}
 
 
-    private_data->key.keylength = tvb_reported_length(out_tvb);
-    private_data->key.keyvalue = tvb_get_ptr(out_tvb, 0, private_data->key.keylength);
-    private_data->key_tree = tree;
-    private_data->key_tvb = out_tvb;
+static const ber_sequence_t HostAddress_sequence[] = {
+  { &hf_kerberos_addr_type  , BER_CLASS_CON, 0, 0, dissect_kerberos_ADDR_TYPE },
+  { &hf_kerberos_address    , BER_CLASS_CON, 1, 0, dissect_kerberos_T_address },
+  { NULL, 0, 0, 0, NULL }
+};
 
+static const ber_schema_t kerberos_schema_HostAddress = BER_SCHEMA_SEQ(HostAddress_sequence, ett_kerberos_HostAddress);
 
 
-    return offset;
-}
+static const ber_sequence_t HostAddresses_sequence_of[1] = {
+  { &hf_kerberos_HostAddresses_item, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, BER_FLAGS_NOOWNTAG, dissect_ber_schema_field },
+};
 
+static const ber_schema_t kerberos_schema_HostAddresses = BER_SCHEMA_SEQ_OF(HostAddresses_sequence_of, ett_kerberos_HostAddresses);
 
-static const ber_sequence_t EncryptionKey_sequence[] = {
-  { &hf_kerberos_keytype    , BER_CLASS_CON, 0, 0, dissect_kerberos_T_keytype },
-  { &hf_kerberos_keyvalue   , BER_CLASS_CON, 1, 0, dissect_kerberos_T_keyvalue },
+
+static const ber_sequence_t EncTicketPart_U_sequence[] = {
+  { &hf_kerberos_flags      , BER_CLASS_CON, 0, 0, dissect_kerberos_TicketFlags },
+  { &hf_kerberos_encTicketPart_key, BER_CLASS_CON, 1, 0, dissect_kerberos_T_encTicketPart_key },
+  { &hf_kerberos_crealm     , BER_CLASS_CON, 2, 0, dissect_kerberos_Realm },
+  { &hf_kerberos_cname      , BER_CLASS_CON, 3, 0, dissect_kerberos_CName },
+  { &hf_kerberos_transited  , BER_CLASS_CON, 4, 0, dissect_ber_schema_field },
+  { &hf_kerberos_authtime   , BER_CLASS_CON, 5, 0, dissect_kerberos_KerberosTime },
+  { &hf_kerberos_starttime  , BER_CLASS_CON, 6, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
+  { &hf_kerberos_endtime    , BER_CLASS_CON, 7, 0, dissect_kerberos_KerberosTime },
+  { &hf_kerberos_renew_till , BER_CLASS_CON, 8, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
+  { &hf_kerberos_caddr      , BER_CLASS_CON, 9, BER_FLAGS_OPTIONAL, dissect_ber_schema_field },
+  { &hf_kerberos_authorization_data, BER_CLASS_CON, 10, BER_FLAGS_OPTIONAL, dissect_kerberos_AuthorizationData },
   { NULL, 0, 0, 0, NULL }
 };
 
-static int
-dissect_kerberos_EncryptionKey(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 407 "./asn1/kerberos/kerberos.cnf"
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-#ifdef HAVE_KERBEROS
-    int start_offset = offset;
-#endif
+static const ber_schema_t kerberos_schema_EncTicketPart_U = BER_SCHEMA_SEQ(EncTicketPart_U_sequence, ett_kerberos_EncTicketPart_U);
 
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        EncryptionKey_sequence, hf_index, ett_kerberos_EncryptionKey);
+static int
+dissect_kerberos_EncTicketPart_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_EncTicketPart_U, hf_index);
 
+    return offset;
+}
 
-    if (private_data->key.keytype != 0 && private_data->key.keylength > 0) {
-#ifdef HAVE_KERBEROS
-        int length = offset - start_offset;
-        private_data->last_added_key = NULL;
-        private_data->save_encryption_key_fn(tvb, start_offset, length, actx, tree,
-            private_data->save_encryption_key_parent_hf_index,
-            hf_index);
-        private_data->last_added_key = NULL;
-#endif
-    }
 
 
+static int
+dissect_kerberos_EncTicketPart(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
+        hf_index, BER_CLASS_APP, 3, FALSE, dissect_kerberos_EncTicketPart_U);
 
     return offset;
 }
 
 
+static const value_string kerberos_MESSAGE_TYPE_vals[] = {
+  {  10, "krb-as-req" },
+  {  11, "krb-as-rep" },
+  {  12, "krb-tgs-req" },
+  {  13, "krb-tgs-rep" },
+  {  14, "krb-ap-req" },
+  {  15, "krb-ap-rep" },
+  {  20, "krb-safe" },
+  {  21, "krb-priv" },
+  {  22, "krb-cred" },
+  {  30, "krb-error" },
+  { 0, NULL }
+};
+
 
 static int
-dissect_kerberos_T_authenticator_subkey(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 426 "./asn1/kerberos/kerberos.cnf"
+dissect_kerberos_MESSAGE_TYPE(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 91 "./asn1/kerberos/kerberos.cnf"
     kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-    gint save_encryption_key_parent_hf_index = private_data->save_encryption_key_parent_hf_index;
-    kerberos_key_save_fn saved_encryption_key_fn = private_data->save_encryption_key_fn;
-    private_data->save_encryption_key_parent_hf_index = hf_kerberos_authenticator;
-#ifdef HAVE_KERBEROS
-    private_data->save_encryption_key_fn = save_Authenticator_subkey;
-#endif
-    offset = dissect_kerberos_EncryptionKey(implicit_tag, tvb, offset, actx, tree, hf_index);
+    guint32 msgtype;
 
-    private_data->save_encryption_key_parent_hf_index = save_encryption_key_parent_hf_index;
-    private_data->save_encryption_key_fn = saved_encryption_key_fn;
+    offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
+        &msgtype);
+
+
+
+
+#line 97 "./asn1/kerberos/kerberos.cnf"
+    if (gbl_do_col_info) {
+        col_add_str(actx->pinfo->cinfo, COL_INFO,
+            val_to_str(msgtype, krb5_msg_types,
+                "Unknown msg type %#x"));
+    }
+    gbl_do_col_info = FALSE;
 
+#if 0
+    /* append the application type to the tree */
+    proto_item_append_text(tree, " %s", val_to_str(msgtype, krb5_msg_types, "Unknown:0x%x"));
+#endif
+    if (private_data->msg_type == 0) {
+        private_data->msg_type = msgtype;
+    }
 
 
     return offset;
 }
 
 
-static const value_string kerberos_AUTHDATA_TYPE_vals[] = {
-  { KERBEROS_AD_IF_RELEVANT, "aD-IF-RELEVANT" },
-  { KERBEROS_AD_INTENDED_FOR_SERVER, "aD-INTENDED-FOR-SERVER" },
-  { KERBEROS_AD_INTENDED_FOR_APPLICATION_CLASS, "aD-INTENDED-FOR-APPLICATION-CLASS" },
-  { KERBEROS_AD_KDC_ISSUED, "aD-KDC-ISSUED" },
-  { KERBEROS_AD_AND_OR, "aD-AND-OR" },
-  { KERBEROS_AD_MANDATORY_TICKET_EXTENSIONS, "aD-MANDATORY-TICKET-EXTENSIONS" },
-  { KERBEROS_AD_IN_TICKET_EXTENSIONS, "aD-IN-TICKET-EXTENSIONS" },
-  { KERBEROS_AD_MANDATORY_FOR_KDC, "aD-MANDATORY-FOR-KDC" },
-  { KERBEROS_AD_INITIAL_VERIFIED_CAS, "aD-INITIAL-VERIFIED-CAS" },
-  { KERBEROS_AD_OSF_DCE, "aD-OSF-DCE" },
-  { KERBEROS_AD_SESAME, "aD-SESAME" },
-  { KERBEROS_AD_OSF_DCE_PKI_CERTID, "aD-OSF-DCE-PKI-CERTID" },
-  { KERBEROS_AD_AUTHENTICATION_STRENGTH, "aD-authentication-strength" },
-  { KERBEROS_AD_FX_FAST_ARMOR, "aD-fx-fast-armor" },
-  { KERBEROS_AD_FX_FAST_USED, "aD-fx-fast-used" },
-  { KERBEROS_AD_WIN2K_PAC, "aD-WIN2K-PAC" },
-  { KERBEROS_AD_GSS_API_ETYPE_NEGOTIATION, "aD-GSS-API-ETYPE-NEGOTIATION" },
-  { KERBEROS_AD_TOKEN_RESTRICTIONS, "aD-TOKEN-RESTRICTIONS" },
-  { KERBEROS_AD_LOCAL, "aD-LOCAL" },
-  { KERBEROS_AD_AP_OPTIONS, "aD-AP-OPTIONS" },
-  { KERBEROS_AD_TARGET_PRINCIPAL, "aD-TARGET-PRINCIPAL" },
-  { KERBEROS_AD_SIGNTICKET_OLDER, "aD-SIGNTICKET-OLDER" },
-  { KERBEROS_AD_SIGNTICKET, "aD-SIGNTICKET" },
+static const value_string kerberos_PADATA_TYPE_vals[] = {
+  { KERBEROS_PA_NONE, "pA-NONE" },
+  { KERBEROS_PA_TGS_REQ, "pA-TGS-REQ" },
+  { KERBEROS_PA_ENC_TIMESTAMP, "pA-ENC-TIMESTAMP" },
+  { KERBEROS_PA_PW_SALT, "pA-PW-SALT" },
+  { KERBEROS_PA_ENC_UNIX_TIME, "pA-ENC-UNIX-TIME" },
+  { KERBEROS_PA_SANDIA_SECUREID, "pA-SANDIA-SECUREID" },
+  { KERBEROS_PA_SESAME, "pA-SESAME" },
+  { KERBEROS_PA_OSF_DCE, "pA-OSF-DCE" },
+  { KERBEROS_PA_CYBERSAFE_SECUREID, "pA-CYBERSAFE-SECUREID" },
+  { KERBEROS_PA_AFS3_SALT, "pA-AFS3-SALT" },
+  { KERBEROS_PA_ETYPE_INFO, "pA-ETYPE-INFO" },
+  { KERBEROS_PA_SAM_CHALLENGE, "pA-SAM-CHALLENGE" },
+  { KERBEROS_PA_SAM_RESPONSE, "pA-SAM-RESPONSE" },
+  { KERBEROS_PA_PK_AS_REQ_19, "pA-PK-AS-REQ-19" },
+  { KERBEROS_PA_PK_AS_REP_19, "pA-PK-AS-REP-19" },
+  { KERBEROS_PA_PK_AS_REQ, "pA-PK-AS-REQ" },
+  { KERBEROS_PA_PK_AS_REP, "pA-PK-AS-REP" },
+  { KERBEROS_PA_PK_OCSP_RESPONSE, "pA-PK-OCSP-RESPONSE" },
+  { KERBEROS_PA_ETYPE_INFO2, "pA-ETYPE-INFO2" },
+  { KERBEROS_PA_USE_SPECIFIED_KVNO, "pA-USE-SPECIFIED-KVNO" },
+  { KERBEROS_PA_SAM_REDIRECT, "pA-SAM-REDIRECT" },
+  { KERBEROS_PA_GET_FROM_TYPED_DATA, "pA-GET-FROM-TYPED-DATA" },
+  { KERBEROS_TD_PADATA, "tD-PADATA" },
+  { KERBEROS_PA_SAM_ETYPE_INFO, "pA-SAM-ETYPE-INFO" },
+  { KERBEROS_PA_ALT_PRINC, "pA-ALT-PRINC" },
+  { KERBEROS_PA_SERVER_REFERRAL, "pA-SERVER-REFERRAL" },
+  { KERBEROS_PA_SAM_CHALLENGE2, "pA-SAM-CHALLENGE2" },
+  { KERBEROS_PA_SAM_RESPONSE2, "pA-SAM-RESPONSE2" },
+  { KERBEROS_PA_EXTRA_TGT, "pA-EXTRA-TGT" },
+  { KERBEROS_TD_PKINIT_CMS_CERTIFICATES, "tD-PKINIT-CMS-CERTIFICATES" },
+  { KERBEROS_TD_KRB_PRINCIPAL, "tD-KRB-PRINCIPAL" },
+  { KERBEROS_TD_KRB_REALM, "tD-KRB-REALM" },
+  { KERBEROS_TD_TRUSTED_CERTIFIERS, "tD-TRUSTED-CERTIFIERS" },
+  { KERBEROS_TD_CERTIFICATE_INDEX, "tD-CERTIFICATE-INDEX" },
+  { KERBEROS_TD_APP_DEFINED_ERROR, "tD-APP-DEFINED-ERROR" },
+  { KERBEROS_TD_REQ_NONCE, "tD-REQ-NONCE" },
+  { KERBEROS_TD_REQ_SEQ, "tD-REQ-SEQ" },
+  { KERBEROS_TD_DH_PARAMETERS, "tD-DH-PARAMETERS" },
+  { KERBEROS_TD_CMS_DIGEST_ALGORITHMS, "tD-CMS-DIGEST-ALGORITHMS" },
+  { KERBEROS_TD_CERT_DIGEST_ALGORITHMS, "tD-CERT-DIGEST-ALGORITHMS" },
+  { KERBEROS_PA_PAC_REQUEST, "pA-PAC-REQUEST" },
+  { KERBEROS_PA_FOR_USER, "pA-FOR-USER" },
+  { KERBEROS_PA_FOR_X509_USER, "pA-FOR-X509-USER" },
+  { KERBEROS_PA_FOR_CHECK_DUPS, "pA-FOR-CHECK-DUPS" },
+  { KERBEROS_PA_PK_AS_09_BINDING, "pA-PK-AS-09-BINDING" },
+  { KERBEROS_PA_FX_COOKIE, "pA-FX-COOKIE" },
+  { KERBEROS_PA_AUTHENTICATION_SET, "pA-AUTHENTICATION-SET" },
+  { KERBEROS_PA_AUTH_SET_SELECTED, "pA-AUTH-SET-SELECTED" },
+  { KERBEROS_PA_FX_FAST, "pA-FX-FAST" },
+  { KERBEROS_PA_FX_ERROR, "pA-FX-ERROR" },
+  { KERBEROS_PA_ENCRYPTED_CHALLENGE, "pA-ENCRYPTED-CHALLENGE" },
+  { KERBEROS_PA_OTP_CHALLENGE, "pA-OTP-CHALLENGE" },
+  { KERBEROS_PA_OTP_REQUEST, "pA-OTP-REQUEST" },
+  { KERBEROS_PA_OTP_CONFIRM, "pA-OTP-CONFIRM" },
+  { KERBEROS_PA_OTP_PIN_CHANGE, "pA-OTP-PIN-CHANGE" },
+  { KERBEROS_PA_EPAK_AS_REQ, "pA-EPAK-AS-REQ" },
+  { KERBEROS_PA_EPAK_AS_REP, "pA-EPAK-AS-REP" },
+  { KERBEROS_PA_PKINIT_KX, "pA-PKINIT-KX" },
+  { KERBEROS_PA_PKU2U_NAME, "pA-PKU2U-NAME" },
+  { KERBEROS_PA_REQ_ENC_PA_REP, "pA-REQ-ENC-PA-REP" },
+  { KERBEROS_PA_SUPPORTED_ETYPES, "pA-SUPPORTED-ETYPES" },
+  { KERBEROS_PA_EXTENDED_ERROR, "pA-EXTENDED-ERROR" },
+  { KERBEROS_PA_PAC_OPTIONS, "pA-PAC-OPTIONS" },
+  { KERBEROS_PA_PROV_SRV_LOCATION, "pA-PROV-SRV-LOCATION" },
   { 0, NULL }
 };
 
 
 static int
-dissect_kerberos_AUTHDATA_TYPE(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 495 "./asn1/kerberos/kerberos.cnf"
+dissect_kerberos_PADATA_TYPE(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 156 "./asn1/kerberos/kerberos.cnf"
     kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
     offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
-        &(private_data->ad_type));
+        &(private_data->padata_type));
+
+    if (private_data->log) {
+        kerberos_log_append_uint(&private_data->log->pa_types, private_data->padata_type);
+    }
 
 
 
+#line 159 "./asn1/kerberos/kerberos.cnf"
+    if (tree) {
+        proto_item_append_text(tree, " %s",
+            val_to_str(private_data->padata_type, kerberos_PADATA_TYPE_vals,
+                "Unknown:%d"));
+    }
+
 
     return offset;
 }
@@ -4768,34 +8788,115 @@ dissect_kerberos_AUTHDATA_TYPE(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int
 
 
 static int
-dissect_kerberos_T_ad_data(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 499 "./asn1/kerberos/kerberos.cnf"
+dissect_kerberos_T_padata_value(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 166 "./asn1/kerberos/kerberos.cnf"
+    proto_tree* sub_tree = tree;
     kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
 
-    switch (private_data->ad_type) {
-    case KERBEROS_AD_WIN2K_PAC:
-        offset = dissect_ber_octet_string_wcb(implicit_tag, actx, tree, tvb, offset, hf_index, dissect_krb5_AD_WIN2K_PAC);
+    if (actx->created_item) {
+        sub_tree = proto_item_add_subtree(actx->created_item, ett_kerberos_PA_DATA);
+    }
+
+    switch (private_data->padata_type) {
+    case KERBEROS_PA_TGS_REQ:
+        private_data->within_PA_TGS_REQ++;
+        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_Applications);
+        private_data->within_PA_TGS_REQ--;
         break;
-    case KERBEROS_AD_IF_RELEVANT:
-        offset = dissect_ber_octet_string_wcb(implicit_tag, actx, tree, tvb, offset, hf_index, dissect_kerberos_AD_IF_RELEVANT);
+    case KERBEROS_PA_PK_AS_REP_19:
+        private_data->is_win2k_pkinit = TRUE;
+        kerberos_resolve_pkinit_layout(actx, sub_tree, tvb, offset, private_data);
+        if (kerberos_private_is_kdc_req(private_data)) {
+            offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_pkinit_PA_PK_AS_REQ_Win2k);
+        }
+        else {
+            offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_pkinit_PA_PK_AS_REP_Win2k);
+        }
         break;
-    case KERBEROS_AD_AUTHENTICATION_STRENGTH:
-        offset = dissect_ber_octet_string_wcb(implicit_tag, actx, tree, tvb, offset, hf_index, dissect_kerberos_PA_AUTHENTICATION_SET_ELEM);
+    case KERBEROS_PA_PK_AS_REQ:
+        kerberos_resolve_pkinit_layout(actx, sub_tree, tvb, offset, private_data);
+        if (private_data->pkinit_layout == KERBEROS_PKINIT_LAYOUT_PKU2U)
+        {
+            offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_pkinit_PaPkAsReq_pku2u);
+        }
+        else
+        {
+            offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_pkinit_PaPkAsReq);
+        }
+        
         break;
-    case KERBEROS_AD_GSS_API_ETYPE_NEGOTIATION:
-        offset = dissect_ber_octet_string_wcb(implicit_tag, actx, tree, tvb, offset, hf_index, dissect_kerberos_SEQUENCE_OF_ENCTYPE);
+    case KERBEROS_PA_PK_AS_REP:
+        kerberos_resolve_pkinit_layout(actx, sub_tree, tvb, offset, private_data);
+        if (private_data->pkinit_layout == KERBEROS_PKINIT_LAYOUT_PKU2U)
+        {
+            offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_pkinit_PaPkAsRepConstructedType_pku2u);
+        }
+        else
+        {
+            offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_pkinit_PaPkAsRepConstructedType);
+        }
+
         break;
-    case KERBEROS_AD_TOKEN_RESTRICTIONS:
-        offset = dissect_ber_octet_string_wcb(implicit_tag, actx, tree, tvb, offset, hf_index, dissect_kerberos_KERB_AD_RESTRICTION_ENTRY);
+    case KERBEROS_PA_PAC_REQUEST:
+        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_PA_PAC_REQUEST);
         break;
-    case KERBEROS_AD_AP_OPTIONS:
-        offset = dissect_ber_octet_string_wcb(implicit_tag, actx, tree, tvb, offset, hf_index, dissect_kerberos_AD_AP_OPTIONS);
+    case KERBEROS_PA_FOR_USER: /* S4U2SELF */
+        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_PA_S4U2Self);
         break;
-    case KERBEROS_AD_TARGET_PRINCIPAL:
-        offset = dissect_ber_octet_string_wcb(implicit_tag, actx, tree, tvb, offset, hf_index, dissect_kerberos_AD_TARGET_PRINCIPAL);
+    case KERBEROS_PA_FOR_X509_USER:
+        if (private_data->msg_type == KRB5_MSG_AS_REQ) {
+            offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_x509af_Certificate);
+        }
+        else if (private_data->is_enc_padata) {
+            offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, NULL);
+        }
+        else {
+            offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_PA_S4U_X509_USER);
+        }
+        break;
+    case KERBEROS_PA_PROV_SRV_LOCATION:
+        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_krb5_PA_PROV_SRV_LOCATION);
+        break;
+    case KERBEROS_PA_ENC_TIMESTAMP:
+        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_PA_ENC_TIMESTAMP);
+        break;
+    case KERBEROS_PA_ETYPE_INFO:
+        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_ETYPE_INFO);
+        break;
+    case KERBEROS_PA_ETYPE_INFO2:
+        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_ETYPE_INFO2);
+        break;
+    case KERBEROS_PA_PW_SALT:
+        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_krb5_PW_SALT);
+        break;
+    case KERBEROS_PA_AUTH_SET_SELECTED:
+        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_PA_AUTHENTICATION_SET_ELEM);
+        break;
+    case KERBEROS_PA_FX_FAST:
+        if (kerberos_private_is_kdc_req(private_data)) {
+            offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_PA_FX_FAST_REQUEST);
+        }
+        else {
+            offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_PA_FX_FAST_REPLY);
+        }
+        break;
+    case KERBEROS_PA_FX_ERROR:
+        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_Applications);
+        break;
+    case KERBEROS_PA_ENCRYPTED_CHALLENGE:
+        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_EncryptedChallenge);
+        break;
+    case KERBEROS_PA_SUPPORTED_ETYPES:
+        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_PA_SUPPORTED_ENCTYPES);
+        break;
+    case KERBEROS_PA_PAC_OPTIONS:
+        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_PA_PAC_OPTIONS);
+        break;
+    case KERBEROS_PA_REQ_ENC_PA_REP:
+        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_Checksum);
         break;
     default:
-        offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index, NULL);
+        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, NULL);
         break;
     }
 
@@ -4805,114 +8906,101 @@ dissect_kerberos_T_ad_data(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int off
 }
 
 
-static const ber_sequence_t AuthorizationData_item_sequence[] = {
-  { &hf_kerberos_ad_type    , BER_CLASS_CON, 0, 0, dissect_kerberos_AUTHDATA_TYPE },
-  { &hf_kerberos_ad_data    , BER_CLASS_CON, 1, 0, dissect_kerberos_T_ad_data },
+static const ber_sequence_t PA_DATA_sequence[] = {
+  { &hf_kerberos_padata_type, BER_CLASS_CON, 1, 0, dissect_kerberos_PADATA_TYPE },
+  { &hf_kerberos_padata_value, BER_CLASS_CON, 2, 0, dissect_kerberos_T_padata_value },
   { NULL, 0, 0, 0, NULL }
 };
 
-static int
-dissect_kerberos_AuthorizationData_item(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        AuthorizationData_item_sequence, hf_index, ett_kerberos_AuthorizationData_item);
-
-    return offset;
-}
-
-
-static const ber_sequence_t AuthorizationData_sequence_of[1] = {
-  { &hf_kerberos_AuthorizationData_item, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, BER_FLAGS_NOOWNTAG, dissect_kerberos_AuthorizationData_item },
-};
+static const ber_schema_t kerberos_schema_PA_DATA = BER_SCHEMA_SEQ(PA_DATA_sequence, ett_kerberos_PA_DATA);
 
 static int
-dissect_kerberos_AuthorizationData(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence_of(implicit_tag, actx, tree, tvb, offset,
-        AuthorizationData_sequence_of, hf_index, ett_kerberos_AuthorizationData);
+dissect_kerberos_PA_DATA(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_PA_DATA, hf_index);
 
     return offset;
 }
 
 
-static const ber_sequence_t Authenticator_U_sequence[] = {
-  { &hf_kerberos_authenticator_vno, BER_CLASS_CON, 0, 0, dissect_kerberos_INTEGER_5 },
-  { &hf_kerberos_crealm     , BER_CLASS_CON, 1, 0, dissect_kerberos_Realm },
-  { &hf_kerberos_cname      , BER_CLASS_CON, 2, 0, dissect_kerberos_CName },
-  { &hf_kerberos_cksum      , BER_CLASS_CON, 3, BER_FLAGS_OPTIONAL, dissect_kerberos_Checksum },
-  { &hf_kerberos_cusec      , BER_CLASS_CON, 4, 0, dissect_kerberos_Microseconds },
-  { &hf_kerberos_ctime      , BER_CLASS_CON, 5, 0, dissect_kerberos_KerberosTime },
-  { &hf_kerberos_authenticator_subkey, BER_CLASS_CON, 6, BER_FLAGS_OPTIONAL, dissect_kerberos_T_authenticator_subkey },
-  { &hf_kerberos_seq_number , BER_CLASS_CON, 7, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
-  { &hf_kerberos_authorization_data, BER_CLASS_CON, 8, BER_FLAGS_OPTIONAL, dissect_kerberos_AuthorizationData },
-  { NULL, 0, 0, 0, NULL }
+static const ber_sequence_t SEQUENCE_OF_PA_DATA_sequence_of[1] = {
+  { &hf_kerberos_padata_item, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, BER_FLAGS_NOOWNTAG, dissect_kerberos_PA_DATA },
 };
 
-static int
-dissect_kerberos_Authenticator_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        Authenticator_U_sequence, hf_index, ett_kerberos_Authenticator_U);
-
-    return offset;
-}
-
-
+static const ber_schema_t kerberos_schema_SEQUENCE_OF_PA_DATA = BER_SCHEMA_SEQ_OF(SEQUENCE_OF_PA_DATA_sequence_of, ett_kerberos_SEQUENCE_OF_PA_DATA);
 
 static int
-dissect_kerberos_Authenticator(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
-        hf_index, BER_CLASS_APP, 2, FALSE, dissect_kerberos_Authenticator_U);
+dissect_kerberos_SEQUENCE_OF_PA_DATA(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_SEQUENCE_OF_PA_DATA, hf_index);
 
     return offset;
 }
 
 
-static const int* TicketFlags_bits[] = {
-  &hf_kerberos_TicketFlags_reserved,
-  &hf_kerberos_TicketFlags_forwardable,
-  &hf_kerberos_TicketFlags_forwarded,
-  &hf_kerberos_TicketFlags_proxiable,
-  &hf_kerberos_TicketFlags_proxy,
-  &hf_kerberos_TicketFlags_may_postdate,
-  &hf_kerberos_TicketFlags_postdated,
-  &hf_kerberos_TicketFlags_invalid,
-  &hf_kerberos_TicketFlags_renewable,
-  &hf_kerberos_TicketFlags_initial,
-  &hf_kerberos_TicketFlags_pre_authent,
-  &hf_kerberos_TicketFlags_hw_authent,
-  &hf_kerberos_TicketFlags_transited_policy_checked,
-  &hf_kerberos_TicketFlags_ok_as_delegate,
-  &hf_kerberos_TicketFlags_unused,
-  &hf_kerberos_TicketFlags_enc_pa_rep,
-  &hf_kerberos_TicketFlags_anonymous,
+static const int* KDCOptions_bits[] = {
+  &hf_kerberos_KDCOptions_reserved,
+  &hf_kerberos_KDCOptions_forwardable,
+  &hf_kerberos_KDCOptions_forwarded,
+  &hf_kerberos_KDCOptions_proxiable,
+  &hf_kerberos_KDCOptions_proxy,
+  &hf_kerberos_KDCOptions_allow_postdate,
+  &hf_kerberos_KDCOptions_postdated,
+  &hf_kerberos_KDCOptions_unused7,
+  &hf_kerberos_KDCOptions_renewable,
+  &hf_kerberos_KDCOptions_unused9,
+  &hf_kerberos_KDCOptions_unused10,
+  &hf_kerberos_KDCOptions_opt_hardware_auth,
+  &hf_kerberos_KDCOptions_unused12,
+  &hf_kerberos_KDCOptions_unused13,
+  &hf_kerberos_KDCOptions_constrained_delegation,
+  &hf_kerberos_KDCOptions_canonicalize,
+  &hf_kerberos_KDCOptions_request_anonymous,
+  &hf_kerberos_KDCOptions_unused17,
+  &hf_kerberos_KDCOptions_unused18,
+  &hf_kerberos_KDCOptions_unused19,
+  &hf_kerberos_KDCOptions_unused20,
+  &hf_kerberos_KDCOptions_unused21,
+  &hf_kerberos_KDCOptions_unused22,
+  &hf_kerberos_KDCOptions_unused23,
+  &hf_kerberos_KDCOptions_unused24,
+  &hf_kerberos_KDCOptions_unused25,
+  &hf_kerberos_KDCOptions_disable_transited_check,
+  &hf_kerberos_KDCOptions_renewable_ok,
+  &hf_kerberos_KDCOptions_enc_tkt_in_skey,
+  &hf_kerberos_KDCOptions_unused29,
+  &hf_kerberos_KDCOptions_renew,
+  &hf_kerberos_KDCOptions_validate,
   NULL
 };
 
 static int
-dissect_kerberos_TicketFlags(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+dissect_kerberos_KDCOptions(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    tvbuff_t* bits_tvb = NULL;
+
     offset = dissect_ber_bitstring(implicit_tag, actx, tree, tvb, offset,
-        TicketFlags_bits, 17, hf_index, ett_kerberos_TicketFlags,
-        NULL);
+        KDCOptions_bits, 32, hf_index, ett_kerberos_KDCOptions,
+        &bits_tvb);
+
+    if (private_data->log) {
+        private_data->log->kdc_options = kerberos_log_bits(bits_tvb);
+    }
 
     return offset;
 }
 
 
+static const ber_sequence_t SEQUENCE_OF_ENCTYPE_sequence_of[1] = {
+  { &hf_kerberos_kDC_REQ_BODY_etype_item, BER_CLASS_UNI, BER_UNI_TAG_INTEGER, BER_FLAGS_NOOWNTAG, dissect_kerberos_ENCTYPE },
+};
 
-static int
-dissect_kerberos_T_encTicketPart_key(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 471 "./asn1/kerberos/kerberos.cnf"
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-    gint save_encryption_key_parent_hf_index = private_data->save_encryption_key_parent_hf_index;
-    kerberos_key_save_fn saved_encryption_key_fn = private_data->save_encryption_key_fn;
-    private_data->save_encryption_key_parent_hf_index = hf_kerberos_encTicketPart;
-#ifdef HAVE_KERBEROS
-    private_data->save_encryption_key_fn = save_EncTicketPart_key;
-#endif
-    offset = dissect_kerberos_EncryptionKey(implicit_tag, tvb, offset, actx, tree, hf_index);
-
-    private_data->save_encryption_key_parent_hf_index = save_encryption_key_parent_hf_index;
-    private_data->save_encryption_key_fn = saved_encryption_key_fn;
-
+static const ber_schema_t kerberos_schema_SEQUENCE_OF_ENCTYPE = BER_SCHEMA_SEQ_OF(SEQUENCE_OF_ENCTYPE_sequence_of, ett_kerberos_SEQUENCE_OF_ENCTYPE);
 
+static int
+dissect_kerberos_SEQUENCE_OF_ENCTYPE(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_SEQUENCE_OF_ENCTYPE, hf_index);
 
     return offset;
 }
@@ -4920,105 +9008,92 @@ dissect_kerberos_T_encTicketPart_key(gboolean implicit_tag _U_, tvbuff_t* tvb _U
 
 
 static int
-dissect_kerberos_OCTET_STRING(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+dissect_kerberos_T_encryptedAuthorizationData_cipher(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 316 "./asn1/kerberos/kerberos.cnf"
+#ifdef HAVE_KERBEROS
+    offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_index, dissect_krb5_decrypt_authorization_data);
+#else
     offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index,
         NULL);
 
-    return offset;
-}
-
+#endif
 
-static const ber_sequence_t TransitedEncoding_sequence[] = {
-  { &hf_kerberos_tr_type    , BER_CLASS_CON, 0, 0, dissect_kerberos_Int32 },
-  { &hf_kerberos_contents   , BER_CLASS_CON, 1, 0, dissect_kerberos_OCTET_STRING },
-  { NULL, 0, 0, 0, NULL }
-};
 
-static int
-dissect_kerberos_TransitedEncoding(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        TransitedEncoding_sequence, hf_index, ett_kerberos_TransitedEncoding);
 
     return offset;
 }
 
 
-static const value_string kerberos_ADDR_TYPE_vals[] = {
-  { KERBEROS_ADDR_TYPE_IPV4, "iPv4" },
-  { KERBEROS_ADDR_TYPE_CHAOS, "cHAOS" },
-  { KERBEROS_ADDR_TYPE_XEROX, "xEROX" },
-  { KERBEROS_ADDR_TYPE_ISO, "iSO" },
-  { KERBEROS_ADDR_TYPE_DECNET, "dECNET" },
-  { KERBEROS_ADDR_TYPE_APPLETALK, "aPPLETALK" },
-  { KERBEROS_ADDR_TYPE_NETBIOS, "nETBIOS" },
-  { KERBEROS_ADDR_TYPE_IPV6, "iPv6" },
-  { 0, NULL }
+static const ber_sequence_t EncryptedAuthorizationData_sequence[] = {
+  { &hf_kerberos_etype      , BER_CLASS_CON, 0, 0, dissect_kerberos_ENCTYPE },
+  { &hf_kerberos_kvno       , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
+  { &hf_kerberos_encryptedAuthorizationData_cipher, BER_CLASS_CON, 2, 0, dissect_kerberos_T_encryptedAuthorizationData_cipher },
+  { NULL, 0, 0, 0, NULL }
 };
 
-
-static int
-dissect_kerberos_ADDR_TYPE(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 532 "./asn1/kerberos/kerberos.cnf"
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-    offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
-        &(private_data->addr_type));
-
+static const ber_schema_t kerberos_schema_EncryptedAuthorizationData = BER_SCHEMA_SEQ(EncryptedAuthorizationData_sequence, ett_kerberos_EncryptedAuthorizationData);
 
 
+static const ber_sequence_t SEQUENCE_OF_Ticket_sequence_of[1] = {
+  { &hf_kerberos_additional_tickets_item, BER_CLASS_APP, 1, BER_FLAGS_NOOWNTAG, dissect_kerberos_Ticket },
+};
 
-    return offset;
-}
+static const ber_schema_t kerberos_schema_SEQUENCE_OF_Ticket = BER_SCHEMA_SEQ_OF(SEQUENCE_OF_Ticket_sequence_of, ett_kerberos_SEQUENCE_OF_Ticket);
 
 
+static const ber_sequence_t KDC_REQ_BODY_sequence[] = {
+  { &hf_kerberos_kdc_options, BER_CLASS_CON, 0, 0, dissect_kerberos_KDCOptions },
+  { &hf_kerberos_cname      , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_CName },
+  { &hf_kerberos_realm      , BER_CLASS_CON, 2, 0, dissect_kerberos_Realm },
+  { &hf_kerberos_sname      , BER_CLASS_CON, 3, BER_FLAGS_OPTIONAL, dissect_kerberos_SName },
+  { &hf_kerberos_from       , BER_CLASS_CON, 4, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
+  { &hf_kerberos_till       , BER_CLASS_CON, 5, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
+  { &hf_kerberos_rtime      , BER_CLASS_CON, 6, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
+  { &hf_kerberos_nonce      , BER_CLASS_CON, 7, 0, dissect_kerberos_UInt32 },
+  { &hf_kerberos_kDC_REQ_BODY_etype, BER_CLASS_CON, 8, 0, dissect_kerberos_SEQUENCE_OF_ENCTYPE },
+  { &hf_kerberos_addresses  , BER_CLASS_CON, 9, BER_FLAGS_OPTIONAL, dissect_ber_schema_field },
+  { &hf_kerberos_enc_authorization_data, BER_CLASS_CON, 10, BER_FLAGS_OPTIONAL, dissect_ber_schema_field },
+  { &hf_kerberos_additional_tickets, BER_CLASS_CON, 11, BER_FLAGS_OPTIONAL, dissect_ber_schema_field },
+  { NULL, 0, 0, 0, NULL }
+};
 
 static int
-dissect_kerberos_T_address(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 254 "./asn1/kerberos/kerberos.cnf"
-    gint8 appclass;
-    gboolean pc;
-    gint32 tag;
-    guint32 len;
-    const char* address_str;
-    proto_item* it = NULL;
+dissect_kerberos_KDC_REQ_BODY(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 536 "./asn1/kerberos/kerberos.cnf"
     kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    conversation_t* conversation;
 
-    /* read header and len for the octet string */
-    offset = dissect_ber_identifier(actx->pinfo, tree, tvb, offset, &appclass, &pc, &tag);
-    offset = dissect_ber_length(actx->pinfo, tree, tvb, offset, &len, NULL);
-
-    switch (private_data->addr_type) {
-    case KERBEROS_ADDR_TYPE_IPV4:
-        it = proto_tree_add_item(tree, hf_krb_address_ip, tvb, offset, 4, ENC_BIG_ENDIAN);
-        address_str = tvb_ip_to_str(tvb, offset);
-        break;
-    case KERBEROS_ADDR_TYPE_NETBIOS:
-    {
-        char netbios_name[(NETBIOS_NAME_LEN - 1) * 4 + 1];
-        int netbios_name_type;
-        int netbios_name_len = (NETBIOS_NAME_LEN - 1) * 4 + 1;
-
-        netbios_name_type = process_netbios_name(tvb_get_ptr(tvb, offset, 16), netbios_name, netbios_name_len);
-        address_str = wmem_strdup_printf(wmem_packet_scope(), "%s<%02x>", netbios_name, netbios_name_type);
-        it = proto_tree_add_string_format(tree, hf_krb_address_netbios, tvb, offset, 16, netbios_name, "NetBIOS Name: %s (%s)", address_str, netbios_name_type_descr(netbios_name_type));
-    }
-    break;
-    case KERBEROS_ADDR_TYPE_IPV6:
-        it = proto_tree_add_item(tree, hf_krb_address_ipv6, tvb, offset, INET6_ADDRLEN, ENC_NA);
-        address_str = tvb_ip6_to_str(tvb, offset);
-        break;
-    default:
-        proto_tree_add_expert(tree, actx->pinfo, &ei_kerberos_address, tvb, offset, len);
-        address_str = NULL;
-        break;
+    /*
+     * UDP replies to KDC_REQs are sent from the server back to the client's
+     * source port, similar to the way TFTP works.  Set up a conversation
+     * accordingly.
+     *
+     * Ref: Section 7.2.1 of
+     * http://www.ietf.org/internet-drafts/draft-ietf-krb-wg-kerberos-clarifications-07.txt
+     *
+     * Live mode skips this, as the conversations are never freed: a reply
+     * from a KDC port other than 88 is then not dissected as Kerberos
+     * (see the live_mode preference).
+     */
+    if (!kerberos_live_mode && actx->pinfo->destport == UDP_PORT_KERBEROS && actx->pinfo->ptype == PT_UDP) {
+        conversation = find_conversation(actx->pinfo->num, &actx->pinfo->src, &actx->pinfo->dst, ENDPOINT_UDP,
+            actx->pinfo->srcport, 0, NO_PORT_B);
+        if (conversation == NULL) {
+            conversation = conversation_new(actx->pinfo->num, &actx->pinfo->src, &actx->pinfo->dst, ENDPOINT_UDP,
+                actx->pinfo->srcport, 0, NO_PORT2);
+            conversation_set_dissector(conversation, kerberos_handle_udp);
+            kerberos_udp_conversations++;
+        }
     }
 
-    /* push it up two levels in the decode pane */
-    if (it && address_str) {
-        proto_item_append_text(proto_item_get_parent(it), " %s", address_str);
-        proto_item_append_text(proto_item_get_parent_nth(it, 2), " %s", address_str);
+    if (private_data->log) {
+        private_data->log->in_req_body = TRUE;
+    }
+    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
+        KDC_REQ_BODY_sequence, hf_index, ett_kerberos_KDC_REQ_BODY);
+    if (private_data->log) {
+        private_data->log->in_req_body = FALSE;
     }
-
-    offset += len;
 
 
 
@@ -5027,405 +9102,254 @@ dissect_kerberos_T_address(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int off
 }
 
 
-static const ber_sequence_t HostAddress_sequence[] = {
-  { &hf_kerberos_addr_type  , BER_CLASS_CON, 0, 0, dissect_kerberos_ADDR_TYPE },
-  { &hf_kerberos_address    , BER_CLASS_CON, 1, 0, dissect_kerberos_T_address },
+static const ber_sequence_t KDC_REQ_sequence[] = {
+  { &hf_kerberos_pvno       , BER_CLASS_CON, 1, 0, dissect_kerberos_INTEGER_5 },
+  { &hf_kerberos_msg_type   , BER_CLASS_CON, 2, 0, dissect_kerberos_MESSAGE_TYPE },
+  { &hf_kerberos_padata     , BER_CLASS_CON, 3, BER_FLAGS_OPTIONAL, dissect_kerberos_SEQUENCE_OF_PA_DATA },
+  { &hf_kerberos_req_body   , BER_CLASS_CON, 4, 0, dissect_kerberos_KDC_REQ_BODY },
   { NULL, 0, 0, 0, NULL }
 };
 
+static const ber_schema_t kerberos_schema_KDC_REQ = BER_SCHEMA_SEQ(KDC_REQ_sequence, ett_kerberos_KDC_REQ);
+
 static int
-dissect_kerberos_HostAddress(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        HostAddress_sequence, hf_index, ett_kerberos_HostAddress);
+dissect_kerberos_KDC_REQ(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+
+    private_data->kdc_msg_tvb = tvb;
+    private_data->kdc_msg_offset = offset;
+    private_data->kdc_msg_implicit = implicit_tag;
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_KDC_REQ, hf_index);
+    private_data->kdc_msg_tvb = NULL;
 
     return offset;
 }
 
 
-static const ber_sequence_t HostAddresses_sequence_of[1] = {
-  { &hf_kerberos_HostAddresses_item, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, BER_FLAGS_NOOWNTAG, dissect_kerberos_HostAddress },
-};
 
 static int
-dissect_kerberos_HostAddresses(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence_of(implicit_tag, actx, tree, tvb, offset,
-        HostAddresses_sequence_of, hf_index, ett_kerberos_HostAddresses);
+dissect_kerberos_AS_REQ(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
+        hf_index, BER_CLASS_APP, 10, FALSE, dissect_kerberos_KDC_REQ);
+
+    return offset;
+}
+
+static int
+dissect_kerberos_T_encryptedKDCREPData_cipher(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 330 "./asn1/kerberos/kerberos.cnf"
+    kerberos_log_enc_part(kerberos_get_private_data(actx));
+#ifdef HAVE_KERBEROS
+    offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_index, dissect_krb5_decrypt_KDC_REP_data);
+#else
+    offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index,
+        NULL);
+
+#endif
+
+
 
     return offset;
 }
 
 
-static const ber_sequence_t EncTicketPart_U_sequence[] = {
-  { &hf_kerberos_flags      , BER_CLASS_CON, 0, 0, dissect_kerberos_TicketFlags },
-  { &hf_kerberos_encTicketPart_key, BER_CLASS_CON, 1, 0, dissect_kerberos_T_encTicketPart_key },
-  { &hf_kerberos_crealm     , BER_CLASS_CON, 2, 0, dissect_kerberos_Realm },
-  { &hf_kerberos_cname      , BER_CLASS_CON, 3, 0, dissect_kerberos_CName },
-  { &hf_kerberos_transited  , BER_CLASS_CON, 4, 0, dissect_kerberos_TransitedEncoding },
-  { &hf_kerberos_authtime   , BER_CLASS_CON, 5, 0, dissect_kerberos_KerberosTime },
-  { &hf_kerberos_starttime  , BER_CLASS_CON, 6, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
-  { &hf_kerberos_endtime    , BER_CLASS_CON, 7, 0, dissect_kerberos_KerberosTime },
-  { &hf_kerberos_renew_till , BER_CLASS_CON, 8, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
-  { &hf_kerberos_caddr      , BER_CLASS_CON, 9, BER_FLAGS_OPTIONAL, dissect_kerberos_HostAddresses },
-  { &hf_kerberos_authorization_data, BER_CLASS_CON, 10, BER_FLAGS_OPTIONAL, dissect_kerberos_AuthorizationData },
+static const ber_sequence_t EncryptedKDCREPData_sequence[] = {
+  { &hf_kerberos_etype      , BER_CLASS_CON, 0, 0, dissect_kerberos_ENCTYPE },
+  { &hf_kerberos_kvno       , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
+  { &hf_kerberos_encryptedKDCREPData_cipher, BER_CLASS_CON, 2, 0, dissect_kerberos_T_encryptedKDCREPData_cipher },
   { NULL, 0, 0, 0, NULL }
 };
 
-static int
-dissect_kerberos_EncTicketPart_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        EncTicketPart_U_sequence, hf_index, ett_kerberos_EncTicketPart_U);
+static const ber_schema_t kerberos_schema_EncryptedKDCREPData = BER_SCHEMA_SEQ(EncryptedKDCREPData_sequence, ett_kerberos_EncryptedKDCREPData);
 
-    return offset;
-}
 
+static const ber_sequence_t KDC_REP_sequence[] = {
+  { &hf_kerberos_pvno       , BER_CLASS_CON, 0, 0, dissect_kerberos_INTEGER_5 },
+  { &hf_kerberos_msg_type   , BER_CLASS_CON, 1, 0, dissect_kerberos_MESSAGE_TYPE },
+  { &hf_kerberos_padata     , BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_kerberos_SEQUENCE_OF_PA_DATA },
+  { &hf_kerberos_crealm     , BER_CLASS_CON, 3, 0, dissect_kerberos_Realm },
+  { &hf_kerberos_cname      , BER_CLASS_CON, 4, 0, dissect_kerberos_CName },
+  { &hf_kerberos_ticket     , BER_CLASS_CON, 5, 0, dissect_kerberos_Ticket },
+  { &hf_kerberos_kDC_REP_enc_part, BER_CLASS_CON, 6, 0, dissect_ber_schema_field },
+  { NULL, 0, 0, 0, NULL }
+};
 
+static const ber_schema_t kerberos_schema_KDC_REP = BER_SCHEMA_SEQ(KDC_REP_sequence, ett_kerberos_KDC_REP);
 
 static int
-dissect_kerberos_EncTicketPart(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
-        hf_index, BER_CLASS_APP, 3, FALSE, dissect_kerberos_EncTicketPart_U);
+dissect_kerberos_KDC_REP(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+
+    private_data->kdc_msg_tvb = tvb;
+    private_data->kdc_msg_offset = offset;
+    private_data->kdc_msg_implicit = implicit_tag;
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_KDC_REP, hf_index);
+    private_data->kdc_msg_tvb = NULL;
 
     return offset;
 }
 
 
-static const value_string kerberos_MESSAGE_TYPE_vals[] = {
-  {  10, "krb-as-req" },
-  {  11, "krb-as-rep" },
-  {  12, "krb-tgs-req" },
-  {  13, "krb-tgs-rep" },
-  {  14, "krb-ap-req" },
-  {  15, "krb-ap-rep" },
-  {  20, "krb-safe" },
-  {  21, "krb-priv" },
-  {  22, "krb-cred" },
-  {  30, "krb-error" },
-  { 0, NULL }
-};
-
 
 static int
-dissect_kerberos_MESSAGE_TYPE(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 91 "./asn1/kerberos/kerberos.cnf"
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-    guint32 msgtype;
+dissect_kerberos_AS_REP(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
+        hf_index, BER_CLASS_APP, 11, FALSE, dissect_kerberos_KDC_REP);
 
-    offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
-        &msgtype);
+    return offset;
+}
 
 
 
+static int
+dissect_kerberos_TGS_REQ(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
+        hf_index, BER_CLASS_APP, 12, FALSE, dissect_kerberos_KDC_REQ);
+
+    return offset;
+}
 
-#line 97 "./asn1/kerberos/kerberos.cnf"
-    if (gbl_do_col_info) {
-        col_add_str(actx->pinfo->cinfo, COL_INFO,
-            val_to_str(msgtype, krb5_msg_types,
-                "Unknown msg type %#x"));
-    }
-    gbl_do_col_info = FALSE;
 
-#if 0
-    /* append the application type to the tree */
-    proto_item_append_text(tree, " %s", val_to_str(msgtype, krb5_msg_types, "Unknown:0x%x"));
-#endif
-    if (private_data->msg_type == 0) {
-        private_data->msg_type = msgtype;
-    }
 
+static int
+dissect_kerberos_TGS_REP(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
+        hf_index, BER_CLASS_APP, 13, FALSE, dissect_kerberos_KDC_REP);
 
     return offset;
 }
 
 
-static const value_string kerberos_PADATA_TYPE_vals[] = {
-  { KERBEROS_PA_NONE, "pA-NONE" },
-  { KERBEROS_PA_TGS_REQ, "pA-TGS-REQ" },
-  { KERBEROS_PA_ENC_TIMESTAMP, "pA-ENC-TIMESTAMP" },
-  { KERBEROS_PA_PW_SALT, "pA-PW-SALT" },
-  { KERBEROS_PA_ENC_UNIX_TIME, "pA-ENC-UNIX-TIME" },
-  { KERBEROS_PA_SANDIA_SECUREID, "pA-SANDIA-SECUREID" },
-  { KERBEROS_PA_SESAME, "pA-SESAME" },
-  { KERBEROS_PA_OSF_DCE, "pA-OSF-DCE" },
-  { KERBEROS_PA_CYBERSAFE_SECUREID, "pA-CYBERSAFE-SECUREID" },
-  { KERBEROS_PA_AFS3_SALT, "pA-AFS3-SALT" },
-  { KERBEROS_PA_ETYPE_INFO, "pA-ETYPE-INFO" },
-  { KERBEROS_PA_SAM_CHALLENGE, "pA-SAM-CHALLENGE" },
-  { KERBEROS_PA_SAM_RESPONSE, "pA-SAM-RESPONSE" },
-  { KERBEROS_PA_PK_AS_REQ_19, "pA-PK-AS-REQ-19" },
-  { KERBEROS_PA_PK_AS_REP_19, "pA-PK-AS-REP-19" },
-  { KERBEROS_PA_PK_AS_REQ, "pA-PK-AS-REQ" },
-  { KERBEROS_PA_PK_AS_REP, "pA-PK-AS-REP" },
-  { KERBEROS_PA_PK_OCSP_RESPONSE, "pA-PK-OCSP-RESPONSE" },
-  { KERBEROS_PA_ETYPE_INFO2, "pA-ETYPE-INFO2" },
-  { KERBEROS_PA_USE_SPECIFIED_KVNO, "pA-USE-SPECIFIED-KVNO" },
-  { KERBEROS_PA_SAM_REDIRECT, "pA-SAM-REDIRECT" },
-  { KERBEROS_PA_GET_FROM_TYPED_DATA, "pA-GET-FROM-TYPED-DATA" },
-  { KERBEROS_TD_PADATA, "tD-PADATA" },
-  { KERBEROS_PA_SAM_ETYPE_INFO, "pA-SAM-ETYPE-INFO" },
-  { KERBEROS_PA_ALT_PRINC, "pA-ALT-PRINC" },
-  { KERBEROS_PA_SERVER_REFERRAL, "pA-SERVER-REFERRAL" },
-  { KERBEROS_PA_SAM_CHALLENGE2, "pA-SAM-CHALLENGE2" },
-  { KERBEROS_PA_SAM_RESPONSE2, "pA-SAM-RESPONSE2" },
-  { KERBEROS_PA_EXTRA_TGT, "pA-EXTRA-TGT" },
-  { KERBEROS_TD_PKINIT_CMS_CERTIFICATES, "tD-PKINIT-CMS-CERTIFICATES" },
-  { KERBEROS_TD_KRB_PRINCIPAL, "tD-KRB-PRINCIPAL" },
-  { KERBEROS_TD_KRB_REALM, "tD-KRB-REALM" },
-  { KERBEROS_TD_TRUSTED_CERTIFIERS, "tD-TRUSTED-CERTIFIERS" },
-  { KERBEROS_TD_CERTIFICATE_INDEX, "tD-CERTIFICATE-INDEX" },
-  { KERBEROS_TD_APP_DEFINED_ERROR, "tD-APP-DEFINED-ERROR" },
-  { KERBEROS_TD_REQ_NONCE, "tD-REQ-NONCE" },
-  { KERBEROS_TD_REQ_SEQ, "tD-REQ-SEQ" },
-  { KERBEROS_TD_DH_PARAMETERS, "tD-DH-PARAMETERS" },
-  { KERBEROS_TD_CMS_DIGEST_ALGORITHMS, "tD-CMS-DIGEST-ALGORITHMS" },
-  { KERBEROS_TD_CERT_DIGEST_ALGORITHMS, "tD-CERT-DIGEST-ALGORITHMS" },
-  { KERBEROS_PA_PAC_REQUEST, "pA-PAC-REQUEST" },
-  { KERBEROS_PA_FOR_USER, "pA-FOR-USER" },
-  { KERBEROS_PA_FOR_X509_USER, "pA-FOR-X509-USER" },
-  { KERBEROS_PA_FOR_CHECK_DUPS, "pA-FOR-CHECK-DUPS" },
-  { KERBEROS_PA_PK_AS_09_BINDING, "pA-PK-AS-09-BINDING" },
-  { KERBEROS_PA_FX_COOKIE, "pA-FX-COOKIE" },
-  { KERBEROS_PA_AUTHENTICATION_SET, "pA-AUTHENTICATION-SET" },
-  { KERBEROS_PA_AUTH_SET_SELECTED, "pA-AUTH-SET-SELECTED" },
-  { KERBEROS_PA_FX_FAST, "pA-FX-FAST" },
-  { KERBEROS_PA_FX_ERROR, "pA-FX-ERROR" },
-  { KERBEROS_PA_ENCRYPTED_CHALLENGE, "pA-ENCRYPTED-CHALLENGE" },
-  { KERBEROS_PA_OTP_CHALLENGE, "pA-OTP-CHALLENGE" },
-  { KERBEROS_PA_OTP_REQUEST, "pA-OTP-REQUEST" },
-  { KERBEROS_PA_OTP_CONFIRM, "pA-OTP-CONFIRM" },
-  { KERBEROS_PA_OTP_PIN_CHANGE, "pA-OTP-PIN-CHANGE" },
-  { KERBEROS_PA_EPAK_AS_REQ, "pA-EPAK-AS-REQ" },
-  { KERBEROS_PA_EPAK_AS_REP, "pA-EPAK-AS-REP" },
-  { KERBEROS_PA_PKINIT_KX, "pA-PKINIT-KX" },
-  { KERBEROS_PA_PKU2U_NAME, "pA-PKU2U-NAME" },
-  { KERBEROS_PA_REQ_ENC_PA_REP, "pA-REQ-ENC-PA-REP" },
-  { KERBEROS_PA_SUPPORTED_ETYPES, "pA-SUPPORTED-ETYPES" },
-  { KERBEROS_PA_EXTENDED_ERROR, "pA-EXTENDED-ERROR" },
-  { KERBEROS_PA_PAC_OPTIONS, "pA-PAC-OPTIONS" },
-  { KERBEROS_PA_PROV_SRV_LOCATION, "pA-PROV-SRV-LOCATION" },
-  { 0, NULL }
+static const int* APOptions_bits[] = {
+  &hf_kerberos_APOptions_reserved,
+  &hf_kerberos_APOptions_use_session_key,
+  &hf_kerberos_APOptions_mutual_required,
+  NULL
 };
 
-
 static int
-dissect_kerberos_PADATA_TYPE(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 156 "./asn1/kerberos/kerberos.cnf"
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-    offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
-        &(private_data->padata_type));
+dissect_kerberos_APOptions(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_bitstring(implicit_tag, actx, tree, tvb, offset,
+        APOptions_bits, 3, hf_index, ett_kerberos_APOptions,
+        NULL);
 
+    return offset;
+}
 
 
-#line 159 "./asn1/kerberos/kerberos.cnf"
-    if (tree) {
-        proto_item_append_text(tree, " %s",
-            val_to_str(private_data->padata_type, kerberos_PADATA_TYPE_vals,
-                "Unknown:%d"));
-    }
+
+static int
+dissect_kerberos_T_encryptedAuthenticator_cipher(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 323 "./asn1/kerberos/kerberos.cnf"
+    kerberos_log_enc_part(kerberos_get_private_data(actx));
+#ifdef HAVE_KERBEROS
+    offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_index, dissect_krb5_decrypt_authenticator_data);
+#else
+    offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index,
+        NULL);
+
+#endif
+
 
 
     return offset;
 }
 
 
+static const ber_sequence_t EncryptedAuthenticator_sequence[] = {
+  { &hf_kerberos_etype      , BER_CLASS_CON, 0, 0, dissect_kerberos_ENCTYPE },
+  { &hf_kerberos_kvno       , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
+  { &hf_kerberos_encryptedAuthenticator_cipher, BER_CLASS_CON, 2, 0, dissect_kerberos_T_encryptedAuthenticator_cipher },
+  { NULL, 0, 0, 0, NULL }
+};
 
-static int
-dissect_kerberos_T_padata_value(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 166 "./asn1/kerberos/kerberos.cnf"
-    proto_tree* sub_tree = tree;
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-
-    if (actx->created_item) {
-        sub_tree = proto_item_add_subtree(actx->created_item, ett_kerberos_PA_DATA);
-    }
+static const ber_schema_t kerberos_schema_EncryptedAuthenticator = BER_SCHEMA_SEQ(EncryptedAuthenticator_sequence, ett_kerberos_EncryptedAuthenticator);
 
-    switch (private_data->padata_type) {
-    case KERBEROS_PA_TGS_REQ:
-        private_data->within_PA_TGS_REQ++;
-        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_Applications);
-        private_data->within_PA_TGS_REQ--;
-        break;
-    case KERBEROS_PA_PK_AS_REP_19:
-        private_data->is_win2k_pkinit = TRUE;
-        if (kerberos_private_is_kdc_req(private_data)) {
-            offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_pkinit_PA_PK_AS_REQ_Win2k);
-        }
-        else {
-            offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_pkinit_PA_PK_AS_REP_Win2k);
-        }
-        break;
-    case KERBEROS_PA_PK_AS_REQ:
-        if (isPku2u == 0)
-        {
-            offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_pkinit_PaPkAsReq_pku2u);
-        }
-        else
-        {
-            offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_pkinit_PaPkAsReq);
-        }
-        
-        break;
-    case KERBEROS_PA_PK_AS_REP:
-        if (isPku2u == 0)
-        {
-            offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_pkinit_PaPkAsRepConstructedType_pku2u);
-        }
-        else
-        {
-            offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_pkinit_PaPkAsRepConstructedType);
-        }
 
-        break;
-    case KERBEROS_PA_PAC_REQUEST:
-        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_PA_PAC_REQUEST);
-        break;
-    case KERBEROS_PA_FOR_USER: /* S4U2SELF */
-        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_PA_S4U2Self);
-        break;
-    case KERBEROS_PA_FOR_X509_USER:
-        if (private_data->msg_type == KRB5_MSG_AS_REQ) {
-            offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_x509af_Certificate);
-        }
-        else if (private_data->is_enc_padata) {
-            offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, NULL);
-        }
-        else {
-            offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_PA_S4U_X509_USER);
-        }
-        break;
-    case KERBEROS_PA_PROV_SRV_LOCATION:
-        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_krb5_PA_PROV_SRV_LOCATION);
-        break;
-    case KERBEROS_PA_ENC_TIMESTAMP:
-        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_PA_ENC_TIMESTAMP);
-        break;
-    case KERBEROS_PA_ETYPE_INFO:
-        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_ETYPE_INFO);
-        break;
-    case KERBEROS_PA_ETYPE_INFO2:
-        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_ETYPE_INFO2);
-        break;
-    case KERBEROS_PA_PW_SALT:
-        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_krb5_PW_SALT);
-        break;
-    case KERBEROS_PA_AUTH_SET_SELECTED:
-        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_PA_AUTHENTICATION_SET_ELEM);
-        break;
-    case KERBEROS_PA_FX_FAST:
-        if (kerberos_private_is_kdc_req(private_data)) {
-            offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_PA_FX_FAST_REQUEST);
-        }
-        else {
-            offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_PA_FX_FAST_REPLY);
-        }
-        break;
-    case KERBEROS_PA_FX_ERROR:
-        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_Applications);
-        break;
-    case KERBEROS_PA_ENCRYPTED_CHALLENGE:
-        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_EncryptedChallenge);
-        break;
-    case KERBEROS_PA_SUPPORTED_ETYPES:
-        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_PA_SUPPORTED_ENCTYPES);
-        break;
-    case KERBEROS_PA_PAC_OPTIONS:
-        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_PA_PAC_OPTIONS);
-        break;
-    case KERBEROS_PA_REQ_ENC_PA_REP:
-        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, dissect_kerberos_Checksum);
-        break;
-    default:
-        offset = dissect_ber_octet_string_wcb(FALSE, actx, sub_tree, tvb, offset, hf_index, NULL);
-        break;
-    }
+static const ber_sequence_t AP_REQ_U_sequence[] = {
+  { &hf_kerberos_pvno       , BER_CLASS_CON, 0, 0, dissect_kerberos_INTEGER_5 },
+  { &hf_kerberos_msg_type   , BER_CLASS_CON, 1, 0, dissect_kerberos_MESSAGE_TYPE },
+  { &hf_kerberos_ap_options , BER_CLASS_CON, 2, 0, dissect_kerberos_APOptions },
+  { &hf_kerberos_ticket     , BER_CLASS_CON, 3, 0, dissect_kerberos_Ticket },
+  { &hf_kerberos_authenticator_enc_part, BER_CLASS_CON, 4, 0, dissect_ber_schema_field },
+  { NULL, 0, 0, 0, NULL }
+};
 
+static const ber_schema_t kerberos_schema_AP_REQ_U = BER_SCHEMA_SEQ(AP_REQ_U_sequence, ett_kerberos_AP_REQ_U);
 
+static int
+dissect_kerberos_AP_REQ_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_AP_REQ_U, hf_index);
 
     return offset;
 }
 
 
-static const ber_sequence_t PA_DATA_sequence[] = {
-  { &hf_kerberos_padata_type, BER_CLASS_CON, 1, 0, dissect_kerberos_PADATA_TYPE },
-  { &hf_kerberos_padata_value, BER_CLASS_CON, 2, 0, dissect_kerberos_T_padata_value },
-  { NULL, 0, 0, 0, NULL }
-};
 
 static int
-dissect_kerberos_PA_DATA(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        PA_DATA_sequence, hf_index, ett_kerberos_PA_DATA);
+dissect_kerberos_AP_REQ(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
+        hf_index, BER_CLASS_APP, 14, FALSE, dissect_kerberos_AP_REQ_U);
 
     return offset;
 }
 
 
-static const ber_sequence_t SEQUENCE_OF_PA_DATA_sequence_of[1] = {
-  { &hf_kerberos_padata_item, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, BER_FLAGS_NOOWNTAG, dissect_kerberos_PA_DATA },
-};
 
 static int
-dissect_kerberos_SEQUENCE_OF_PA_DATA(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence_of(implicit_tag, actx, tree, tvb, offset,
-        SEQUENCE_OF_PA_DATA_sequence_of, hf_index, ett_kerberos_SEQUENCE_OF_PA_DATA);
+dissect_kerberos_T_encryptedAPREPData_cipher(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 344 "./asn1/kerberos/kerberos.cnf"
+    kerberos_log_enc_part(kerberos_get_private_data(actx));
+#ifdef HAVE_KERBEROS
+    offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_index, dissect_krb5_decrypt_AP_REP_data);
+#else
+    offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index,
+        NULL);
+
+#endif
+
+
 
     return offset;
 }
 
 
-static const int* KDCOptions_bits[] = {
-  &hf_kerberos_KDCOptions_reserved,
-  &hf_kerberos_KDCOptions_forwardable,
-  &hf_kerberos_KDCOptions_forwarded,
-  &hf_kerberos_KDCOptions_proxiable,
-  &hf_kerberos_KDCOptions_proxy,
-  &hf_kerberos_KDCOptions_allow_postdate,
-  &hf_kerberos_KDCOptions_postdated,
-  &hf_kerberos_KDCOptions_unused7,
-  &hf_kerberos_KDCOptions_renewable,
-  &hf_kerberos_KDCOptions_unused9,
-  &hf_kerberos_KDCOptions_unused10,
-  &hf_kerberos_KDCOptions_opt_hardware_auth,
-  &hf_kerberos_KDCOptions_unused12,
-  &hf_kerberos_KDCOptions_unused13,
-  &hf_kerberos_KDCOptions_constrained_delegation,
-  &hf_kerberos_KDCOptions_canonicalize,
-  &hf_kerberos_KDCOptions_request_anonymous,
-  &hf_kerberos_KDCOptions_unused17,
-  &hf_kerberos_KDCOptions_unused18,
-  &hf_kerberos_KDCOptions_unused19,
-  &hf_kerberos_KDCOptions_unused20,
-  &hf_kerberos_KDCOptions_unused21,
-  &hf_kerberos_KDCOptions_unused22,
-  &hf_kerberos_KDCOptions_unused23,
-  &hf_kerberos_KDCOptions_unused24,
-  &hf_kerberos_KDCOptions_unused25,
-  &hf_kerberos_KDCOptions_disable_transited_check,
-  &hf_kerberos_KDCOptions_renewable_ok,
-  &hf_kerberos_KDCOptions_enc_tkt_in_skey,
-  &hf_kerberos_KDCOptions_unused29,
-  &hf_kerberos_KDCOptions_renew,
-  &hf_kerberos_KDCOptions_validate,
-  NULL
+static const ber_sequence_t EncryptedAPREPData_sequence[] = {
+  { &hf_kerberos_etype      , BER_CLASS_CON, 0, 0, dissect_kerberos_ENCTYPE },
+  { &hf_kerberos_kvno       , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
+  { &hf_kerberos_encryptedAPREPData_cipher, BER_CLASS_CON, 2, 0, dissect_kerberos_T_encryptedAPREPData_cipher },
+  { NULL, 0, 0, 0, NULL }
+};
+
+static const ber_schema_t kerberos_schema_EncryptedAPREPData = BER_SCHEMA_SEQ(EncryptedAPREPData_sequence, ett_kerberos_EncryptedAPREPData);
+
+
+static const ber_sequence_t AP_REP_U_sequence[] = {
+  { &hf_kerberos_pvno       , BER_CLASS_CON, 0, 0, dissect_kerberos_INTEGER_5 },
+  { &hf_kerberos_msg_type   , BER_CLASS_CON, 1, 0, dissect_kerberos_MESSAGE_TYPE },
+  { &hf_kerberos_aP_REP_enc_part, BER_CLASS_CON, 2, 0, dissect_ber_schema_field },
+  { NULL, 0, 0, 0, NULL }
 };
 
+static const ber_schema_t kerberos_schema_AP_REP_U = BER_SCHEMA_SEQ(AP_REP_U_sequence, ett_kerberos_AP_REP_U);
+
 static int
-dissect_kerberos_KDCOptions(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_bitstring(implicit_tag, actx, tree, tvb, offset,
-        KDCOptions_bits, 32, hf_index, ett_kerberos_KDCOptions,
-        NULL);
+dissect_kerberos_AP_REP_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_AP_REP_U, hf_index);
 
     return offset;
 }
 
 
-static const ber_sequence_t SEQUENCE_OF_ENCTYPE_sequence_of[1] = {
-  { &hf_kerberos_kDC_REQ_BODY_etype_item, BER_CLASS_UNI, BER_UNI_TAG_INTEGER, BER_FLAGS_NOOWNTAG, dissect_kerberos_ENCTYPE },
-};
 
 static int
-dissect_kerberos_SEQUENCE_OF_ENCTYPE(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence_of(implicit_tag, actx, tree, tvb, offset,
-        SEQUENCE_OF_ENCTYPE_sequence_of, hf_index, ett_kerberos_SEQUENCE_OF_ENCTYPE);
+dissect_kerberos_AP_REP(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
+        hf_index, BER_CLASS_APP, 15, FALSE, dissect_kerberos_AP_REP_U);
 
     return offset;
 }
@@ -5433,15 +9357,14 @@ dissect_kerberos_SEQUENCE_OF_ENCTYPE(gboolean implicit_tag _U_, tvbuff_t* tvb _U
 
 
 static int
-dissect_kerberos_T_encryptedAuthorizationData_cipher(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 316 "./asn1/kerberos/kerberos.cnf"
-#ifdef HAVE_KERBEROS
-    offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_index, dissect_krb5_decrypt_authorization_data);
-#else
-    offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index,
-        NULL);
-
-#endif
+dissect_kerberos_T_kRB_SAFE_BODY_user_data(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 559 "./asn1/kerberos/kerberos.cnf"
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    tvbuff_t* new_tvb;
+    offset = dissect_ber_octet_string(FALSE, actx, tree, tvb, offset, hf_index, &new_tvb);
+    if (new_tvb) {
+        call_kerberos_callbacks(actx->pinfo, tree, new_tvb, KRB_CBTAG_SAFE_USER_DATA, private_data->callbacks);
+    }
 
 
 
@@ -5449,77 +9372,60 @@ dissect_kerberos_T_encryptedAuthorizationData_cipher(gboolean implicit_tag _U_,
 }
 
 
-static const ber_sequence_t EncryptedAuthorizationData_sequence[] = {
-  { &hf_kerberos_etype      , BER_CLASS_CON, 0, 0, dissect_kerberos_ENCTYPE },
-  { &hf_kerberos_kvno       , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
-  { &hf_kerberos_encryptedAuthorizationData_cipher, BER_CLASS_CON, 2, 0, dissect_kerberos_T_encryptedAuthorizationData_cipher },
+static const ber_sequence_t KRB_SAFE_BODY_sequence[] = {
+  { &hf_kerberos_kRB_SAFE_BODY_user_data, BER_CLASS_CON, 0, 0, dissect_kerberos_T_kRB_SAFE_BODY_user_data },
+  { &hf_kerberos_timestamp  , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
+  { &hf_kerberos_usec       , BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_kerberos_Microseconds },
+  { &hf_kerberos_seq_number , BER_CLASS_CON, 3, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
+  { &hf_kerberos_s_address  , BER_CLASS_CON, 4, BER_FLAGS_OPTIONAL, dissect_ber_schema_field },
+  { &hf_kerberos_r_address  , BER_CLASS_CON, 5, BER_FLAGS_OPTIONAL, dissect_ber_schema_field },
   { NULL, 0, 0, 0, NULL }
 };
 
+static const ber_schema_t kerberos_schema_KRB_SAFE_BODY = BER_SCHEMA_SEQ(KRB_SAFE_BODY_sequence, ett_kerberos_KRB_SAFE_BODY);
+
+
+static const ber_sequence_t KRB_SAFE_U_sequence[] = {
+  { &hf_kerberos_pvno       , BER_CLASS_CON, 0, 0, dissect_kerberos_INTEGER_5 },
+  { &hf_kerberos_msg_type   , BER_CLASS_CON, 1, 0, dissect_kerberos_MESSAGE_TYPE },
+  { &hf_kerberos_safe_body  , BER_CLASS_CON, 2, 0, dissect_ber_schema_field },
+  { &hf_kerberos_cksum      , BER_CLASS_CON, 3, 0, dissect_kerberos_Checksum },
+  { NULL, 0, 0, 0, NULL }
+};
+
+static const ber_schema_t kerberos_schema_KRB_SAFE_U = BER_SCHEMA_SEQ(KRB_SAFE_U_sequence, ett_kerberos_KRB_SAFE_U);
+
 static int
-dissect_kerberos_EncryptedAuthorizationData(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        EncryptedAuthorizationData_sequence, hf_index, ett_kerberos_EncryptedAuthorizationData);
+dissect_kerberos_KRB_SAFE_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_KRB_SAFE_U, hf_index);
 
     return offset;
 }
 
 
-static const ber_sequence_t SEQUENCE_OF_Ticket_sequence_of[1] = {
-  { &hf_kerberos_additional_tickets_item, BER_CLASS_APP, 1, BER_FLAGS_NOOWNTAG, dissect_kerberos_Ticket },
-};
 
 static int
-dissect_kerberos_SEQUENCE_OF_Ticket(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence_of(implicit_tag, actx, tree, tvb, offset,
-        SEQUENCE_OF_Ticket_sequence_of, hf_index, ett_kerberos_SEQUENCE_OF_Ticket);
+dissect_kerberos_KRB_SAFE(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
+        hf_index, BER_CLASS_APP, 20, FALSE, dissect_kerberos_KRB_SAFE_U);
 
     return offset;
 }
 
 
-static const ber_sequence_t KDC_REQ_BODY_sequence[] = {
-  { &hf_kerberos_kdc_options, BER_CLASS_CON, 0, 0, dissect_kerberos_KDCOptions },
-  { &hf_kerberos_cname      , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_CName },
-  { &hf_kerberos_realm      , BER_CLASS_CON, 2, 0, dissect_kerberos_Realm },
-  { &hf_kerberos_sname      , BER_CLASS_CON, 3, BER_FLAGS_OPTIONAL, dissect_kerberos_SName },
-  { &hf_kerberos_from       , BER_CLASS_CON, 4, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
-  { &hf_kerberos_till       , BER_CLASS_CON, 5, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
-  { &hf_kerberos_rtime      , BER_CLASS_CON, 6, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
-  { &hf_kerberos_nonce      , BER_CLASS_CON, 7, 0, dissect_kerberos_UInt32 },
-  { &hf_kerberos_kDC_REQ_BODY_etype, BER_CLASS_CON, 8, 0, dissect_kerberos_SEQUENCE_OF_ENCTYPE },
-  { &hf_kerberos_addresses  , BER_CLASS_CON, 9, BER_FLAGS_OPTIONAL, dissect_kerberos_HostAddresses },
-  { &hf_kerberos_enc_authorization_data, BER_CLASS_CON, 10, BER_FLAGS_OPTIONAL, dissect_kerberos_EncryptedAuthorizationData },
-  { &hf_kerberos_additional_tickets, BER_CLASS_CON, 11, BER_FLAGS_OPTIONAL, dissect_kerberos_SEQUENCE_OF_Ticket },
-  { NULL, 0, 0, 0, NULL }
-};
 
 static int
-dissect_kerberos_KDC_REQ_BODY(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 536 "./asn1/kerberos/kerberos.cnf"
-    conversation_t* conversation;
-
-    /*
-     * UDP replies to KDC_REQs are sent from the server back to the client's
-     * source port, similar to the way TFTP works.  Set up a conversation
-     * accordingly.
-     *
-     * Ref: Section 7.2.1 of
-     * http://www.ietf.org/internet-drafts/draft-ietf-krb-wg-kerberos-clarifications-07.txt
-     */
-    if (actx->pinfo->destport == UDP_PORT_KERBEROS && actx->pinfo->ptype == PT_UDP) {
-        conversation = find_conversation(actx->pinfo->num, &actx->pinfo->src, &actx->pinfo->dst, ENDPOINT_UDP,
-            actx->pinfo->srcport, 0, NO_PORT_B);
-        if (conversation == NULL) {
-            conversation = conversation_new(actx->pinfo->num, &actx->pinfo->src, &actx->pinfo->dst, ENDPOINT_UDP,
-                actx->pinfo->srcport, 0, NO_PORT2);
-            conversation_set_dissector(conversation, kerberos_handle_udp);
-        }
-    }
-
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        KDC_REQ_BODY_sequence, hf_index, ett_kerberos_KDC_REQ_BODY);
+dissect_kerberos_T_encryptedKrbPrivData_cipher(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 351 "./asn1/kerberos/kerberos.cnf"
+    kerberos_log_enc_part(kerberos_get_private_data(actx));
+#ifdef HAVE_KERBEROS
+    offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_index, dissect_krb5_decrypt_PRIV_data);
+#else
+    offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index,
+        NULL);
 
+#endif
 
 
 
@@ -5527,18 +9433,29 @@ dissect_kerberos_KDC_REQ_BODY(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int
 }
 
 
-static const ber_sequence_t KDC_REQ_sequence[] = {
-  { &hf_kerberos_pvno       , BER_CLASS_CON, 1, 0, dissect_kerberos_INTEGER_5 },
-  { &hf_kerberos_msg_type   , BER_CLASS_CON, 2, 0, dissect_kerberos_MESSAGE_TYPE },
-  { &hf_kerberos_padata     , BER_CLASS_CON, 3, BER_FLAGS_OPTIONAL, dissect_kerberos_SEQUENCE_OF_PA_DATA },
-  { &hf_kerberos_req_body   , BER_CLASS_CON, 4, 0, dissect_kerberos_KDC_REQ_BODY },
+static const ber_sequence_t EncryptedKrbPrivData_sequence[] = {
+  { &hf_kerberos_etype      , BER_CLASS_CON, 0, 0, dissect_kerberos_ENCTYPE },
+  { &hf_kerberos_kvno       , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
+  { &hf_kerberos_encryptedKrbPrivData_cipher, BER_CLASS_CON, 2, 0, dissect_kerberos_T_encryptedKrbPrivData_cipher },
+  { NULL, 0, 0, 0, NULL }
+};
+
+static const ber_schema_t kerberos_schema_EncryptedKrbPrivData = BER_SCHEMA_SEQ(EncryptedKrbPrivData_sequence, ett_kerberos_EncryptedKrbPrivData);
+
+
+static const ber_sequence_t KRB_PRIV_U_sequence[] = {
+  { &hf_kerberos_pvno       , BER_CLASS_CON, 0, 0, dissect_kerberos_INTEGER_5 },
+  { &hf_kerberos_msg_type   , BER_CLASS_CON, 1, 0, dissect_kerberos_MESSAGE_TYPE },
+  { &hf_kerberos_kRB_PRIV_enc_part, BER_CLASS_CON, 3, 0, dissect_ber_schema_field },
   { NULL, 0, 0, 0, NULL }
 };
 
+static const ber_schema_t kerberos_schema_KRB_PRIV_U = BER_SCHEMA_SEQ(KRB_PRIV_U_sequence, ett_kerberos_KRB_PRIV_U);
+
 static int
-dissect_kerberos_KDC_REQ(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        KDC_REQ_sequence, hf_index, ett_kerberos_KDC_REQ);
+dissect_kerberos_KRB_PRIV_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_KRB_PRIV_U, hf_index);
 
     return offset;
 }
@@ -5546,18 +9463,21 @@ dissect_kerberos_KDC_REQ(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offse
 
 
 static int
-dissect_kerberos_AS_REQ(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+dissect_kerberos_KRB_PRIV(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
     offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
-        hf_index, BER_CLASS_APP, 10, FALSE, dissect_kerberos_KDC_REQ);
+        hf_index, BER_CLASS_APP, 21, FALSE, dissect_kerberos_KRB_PRIV_U);
 
     return offset;
 }
 
+
+
 static int
-dissect_kerberos_T_encryptedKDCREPData_cipher(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 330 "./asn1/kerberos/kerberos.cnf"
+dissect_kerberos_T_encryptedKrbCredData_cipher(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 358 "./asn1/kerberos/kerberos.cnf"
+    kerberos_log_enc_part(kerberos_get_private_data(actx));
 #ifdef HAVE_KERBEROS
-    offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_index, dissect_krb5_decrypt_KDC_REP_data);
+    offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_index, dissect_krb5_decrypt_CRED_data);
 #else
     offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index,
         NULL);
@@ -5570,84 +9490,124 @@ dissect_kerberos_T_encryptedKDCREPData_cipher(gboolean implicit_tag _U_, tvbuff_
 }
 
 
-static const ber_sequence_t EncryptedKDCREPData_sequence[] = {
+static const ber_sequence_t EncryptedKrbCredData_sequence[] = {
   { &hf_kerberos_etype      , BER_CLASS_CON, 0, 0, dissect_kerberos_ENCTYPE },
   { &hf_kerberos_kvno       , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
-  { &hf_kerberos_encryptedKDCREPData_cipher, BER_CLASS_CON, 2, 0, dissect_kerberos_T_encryptedKDCREPData_cipher },
+  { &hf_kerberos_encryptedKrbCredData_cipher, BER_CLASS_CON, 2, 0, dissect_kerberos_T_encryptedKrbCredData_cipher },
   { NULL, 0, 0, 0, NULL }
 };
 
-static int
-dissect_kerberos_EncryptedKDCREPData(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        EncryptedKDCREPData_sequence, hf_index, ett_kerberos_EncryptedKDCREPData);
-
-    return offset;
-}
+static const ber_schema_t kerberos_schema_EncryptedKrbCredData = BER_SCHEMA_SEQ(EncryptedKrbCredData_sequence, ett_kerberos_EncryptedKrbCredData);
 
 
-static const ber_sequence_t KDC_REP_sequence[] = {
+static const ber_sequence_t KRB_CRED_U_sequence[] = {
   { &hf_kerberos_pvno       , BER_CLASS_CON, 0, 0, dissect_kerberos_INTEGER_5 },
   { &hf_kerberos_msg_type   , BER_CLASS_CON, 1, 0, dissect_kerberos_MESSAGE_TYPE },
-  { &hf_kerberos_padata     , BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_kerberos_SEQUENCE_OF_PA_DATA },
-  { &hf_kerberos_crealm     , BER_CLASS_CON, 3, 0, dissect_kerberos_Realm },
-  { &hf_kerberos_cname      , BER_CLASS_CON, 4, 0, dissect_kerberos_CName },
-  { &hf_kerberos_ticket     , BER_CLASS_CON, 5, 0, dissect_kerberos_Ticket },
-  { &hf_kerberos_kDC_REP_enc_part, BER_CLASS_CON, 6, 0, dissect_kerberos_EncryptedKDCREPData },
+  { &hf_kerberos_tickets    , BER_CLASS_CON, 2, 0, dissect_ber_schema_field },
+  { &hf_kerberos_kRB_CRED_enc_part, BER_CLASS_CON, 3, 0, dissect_ber_schema_field },
   { NULL, 0, 0, 0, NULL }
 };
 
+static const ber_schema_t kerberos_schema_KRB_CRED_U = BER_SCHEMA_SEQ(KRB_CRED_U_sequence, ett_kerberos_KRB_CRED_U);
+
 static int
-dissect_kerberos_KDC_REP(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        KDC_REP_sequence, hf_index, ett_kerberos_KDC_REP);
+dissect_kerberos_KRB_CRED_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_KRB_CRED_U, hf_index);
+
+    return offset;
+}
+
+
+
+static int
+dissect_kerberos_KRB_CRED(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
+        hf_index, BER_CLASS_APP, 22, FALSE, dissect_kerberos_KRB_CRED_U);
 
     return offset;
 }
 
 
 
-static int
-dissect_kerberos_AS_REP(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
-        hf_index, BER_CLASS_APP, 11, FALSE, dissect_kerberos_KDC_REP);
+static int
+dissect_kerberos_T_encKDCRepPart_key(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 450 "./asn1/kerberos/kerberos.cnf"
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    gint save_encryption_key_parent_hf_index = private_data->save_encryption_key_parent_hf_index;
+    kerberos_key_save_fn saved_encryption_key_fn = private_data->save_encryption_key_fn;
+    switch (private_data->msg_type) {
+    case KERBEROS_APPLICATIONS_AS_REP:
+        private_data->save_encryption_key_parent_hf_index = hf_kerberos_encASRepPart;
+        break;
+    case KERBEROS_APPLICATIONS_TGS_REP:
+        private_data->save_encryption_key_parent_hf_index = hf_kerberos_encTGSRepPart;
+        break;
+    default:
+        private_data->save_encryption_key_parent_hf_index = -1;
+    }
+#ifdef HAVE_KERBEROS
+    private_data->save_encryption_key_fn = save_EncKDCRepPart_key;
+#endif
+    offset = dissect_kerberos_EncryptionKey(implicit_tag, tvb, offset, actx, tree, hf_index);
+
+    private_data->save_encryption_key_parent_hf_index = save_encryption_key_parent_hf_index;
+    private_data->save_encryption_key_fn = saved_encryption_key_fn;
+
+
 
     return offset;
 }
 
 
+static const value_string kerberos_LR_TYPE_vals[] = {
+  {   0, "lR-NONE" },
+  {   1, "lR-INITIAL-TGT" },
+  {   2, "lR-INITIAL" },
+  {   3, "lR-ISSUE-USE-TGT" },
+  {   4, "lR-RENEWAL" },
+  {   5, "lR-REQUEST" },
+  {   6, "lR-PW-EXPTIME" },
+  {   7, "lR-ACCT-EXPTIME" },
+  { 0, NULL }
+};
+
 
 static int
-dissect_kerberos_TGS_REQ(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
-        hf_index, BER_CLASS_APP, 12, FALSE, dissect_kerberos_KDC_REQ);
+dissect_kerberos_LR_TYPE(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
+        NULL);
 
     return offset;
 }
 
 
+static const ber_sequence_t LastReq_item_sequence[] = {
+  { &hf_kerberos_lr_type    , BER_CLASS_CON, 0, 0, dissect_kerberos_LR_TYPE },
+  { &hf_kerberos_lr_value   , BER_CLASS_CON, 1, 0, dissect_kerberos_KerberosTime },
+  { NULL, 0, 0, 0, NULL }
+};
 
-static int
-dissect_kerberos_TGS_REP(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
-        hf_index, BER_CLASS_APP, 13, FALSE, dissect_kerberos_KDC_REP);
+static const ber_schema_t kerberos_schema_LastReq_item = BER_SCHEMA_SEQ(LastReq_item_sequence, ett_kerberos_LastReq_item);
 
-    return offset;
-}
 
+static const ber_sequence_t LastReq_sequence_of[1] = {
+  { &hf_kerberos_LastReq_item, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, BER_FLAGS_NOOWNTAG, dissect_ber_schema_field },
+};
 
-static const int* APOptions_bits[] = {
-  &hf_kerberos_APOptions_reserved,
-  &hf_kerberos_APOptions_use_session_key,
-  &hf_kerberos_APOptions_mutual_required,
-  NULL
+static const ber_schema_t kerberos_schema_LastReq = BER_SCHEMA_SEQ_OF(LastReq_sequence_of, ett_kerberos_LastReq);
+
+
+static const ber_sequence_t METHOD_DATA_sequence_of[1] = {
+  { &hf_kerberos_METHOD_DATA_item, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, BER_FLAGS_NOOWNTAG, dissect_kerberos_PA_DATA },
 };
 
+static const ber_schema_t kerberos_schema_METHOD_DATA = BER_SCHEMA_SEQ_OF(METHOD_DATA_sequence_of, ett_kerberos_METHOD_DATA);
+
 static int
-dissect_kerberos_APOptions(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_bitstring(implicit_tag, actx, tree, tvb, offset,
-        APOptions_bits, 3, hf_index, ett_kerberos_APOptions,
-        NULL);
+dissect_kerberos_METHOD_DATA(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_METHOD_DATA, hf_index);
 
     return offset;
 }
@@ -5655,51 +9615,55 @@ dissect_kerberos_APOptions(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int off
 
 
 static int
-dissect_kerberos_T_encryptedAuthenticator_cipher(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 323 "./asn1/kerberos/kerberos.cnf"
-#ifdef HAVE_KERBEROS
-    offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_index, dissect_krb5_decrypt_authenticator_data);
-#else
-    offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index,
-        NULL);
+dissect_kerberos_T_encrypted_pa_data(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 575 "./asn1/kerberos/kerberos.cnf"
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    private_data->is_enc_padata = TRUE;
 
-#endif
 
+    offset = dissect_kerberos_METHOD_DATA(implicit_tag, tvb, offset, actx, tree, hf_index);
+
+#line 579 "./asn1/kerberos/kerberos.cnf"
+    private_data->is_enc_padata = FALSE;
 
 
     return offset;
 }
 
 
-static const ber_sequence_t EncryptedAuthenticator_sequence[] = {
-  { &hf_kerberos_etype      , BER_CLASS_CON, 0, 0, dissect_kerberos_ENCTYPE },
-  { &hf_kerberos_kvno       , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
-  { &hf_kerberos_encryptedAuthenticator_cipher, BER_CLASS_CON, 2, 0, dissect_kerberos_T_encryptedAuthenticator_cipher },
+static const ber_sequence_t EncKDCRepPart_sequence[] = {
+  { &hf_kerberos_encKDCRepPart_key, BER_CLASS_CON, 0, 0, dissect_kerberos_T_encKDCRepPart_key },
+  { &hf_kerberos_last_req   , BER_CLASS_CON, 1, 0, dissect_ber_schema_field },
+  { &hf_kerberos_nonce      , BER_CLASS_CON, 2, 0, dissect_kerberos_UInt32 },
+  { &hf_kerberos_key_expiration, BER_CLASS_CON, 3, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
+  { &hf_kerberos_flags      , BER_CLASS_CON, 4, 0, dissect_kerberos_TicketFlags },
+  { &hf_kerberos_authtime   , BER_CLASS_CON, 5, 0, dissect_kerberos_KerberosTime },
+  { &hf_kerberos_starttime  , BER_CLASS_CON, 6, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
+  { &hf_kerberos_endtime    , BER_CLASS_CON, 7, 0, dissect_kerberos_KerberosTime },
+  { &hf_kerberos_renew_till , BER_CLASS_CON, 8, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
+  { &hf_kerberos_srealm     , BER_CLASS_CON, 9, 0, dissect_kerberos_Realm },
+  { &hf_kerberos_sname      , BER_CLASS_CON, 10, 0, dissect_kerberos_SName },
+  { &hf_kerberos_caddr      , BER_CLASS_CON, 11, BER_FLAGS_OPTIONAL, dissect_ber_schema_field },
+  { &hf_kerberos_encrypted_pa_data, BER_CLASS_CON, 12, BER_FLAGS_OPTIONAL, dissect_kerberos_T_encrypted_pa_data },
   { NULL, 0, 0, 0, NULL }
 };
 
+static const ber_schema_t kerberos_schema_EncKDCRepPart = BER_SCHEMA_SEQ(EncKDCRepPart_sequence, ett_kerberos_EncKDCRepPart);
+
 static int
-dissect_kerberos_EncryptedAuthenticator(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        EncryptedAuthenticator_sequence, hf_index, ett_kerberos_EncryptedAuthenticator);
+dissect_kerberos_EncKDCRepPart(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_EncKDCRepPart, hf_index);
 
     return offset;
 }
 
 
-static const ber_sequence_t AP_REQ_U_sequence[] = {
-  { &hf_kerberos_pvno       , BER_CLASS_CON, 0, 0, dissect_kerberos_INTEGER_5 },
-  { &hf_kerberos_msg_type   , BER_CLASS_CON, 1, 0, dissect_kerberos_MESSAGE_TYPE },
-  { &hf_kerberos_ap_options , BER_CLASS_CON, 2, 0, dissect_kerberos_APOptions },
-  { &hf_kerberos_ticket     , BER_CLASS_CON, 3, 0, dissect_kerberos_Ticket },
-  { &hf_kerberos_authenticator_enc_part, BER_CLASS_CON, 4, 0, dissect_kerberos_EncryptedAuthenticator },
-  { NULL, 0, 0, 0, NULL }
-};
 
 static int
-dissect_kerberos_AP_REQ_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        AP_REQ_U_sequence, hf_index, ett_kerberos_AP_REQ_U);
+dissect_kerberos_EncASRepPart(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
+        hf_index, BER_CLASS_APP, 25, FALSE, dissect_kerberos_EncKDCRepPart);
 
     return offset;
 }
@@ -5707,9 +9671,9 @@ dissect_kerberos_AP_REQ_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offs
 
 
 static int
-dissect_kerberos_AP_REQ(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+dissect_kerberos_EncTGSRepPart(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
     offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
-        hf_index, BER_CLASS_APP, 14, FALSE, dissect_kerberos_AP_REQ_U);
+        hf_index, BER_CLASS_APP, 26, FALSE, dissect_kerberos_EncKDCRepPart);
 
     return offset;
 }
@@ -5717,49 +9681,40 @@ dissect_kerberos_AP_REQ(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset
 
 
 static int
-dissect_kerberos_T_encryptedAPREPData_cipher(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 344 "./asn1/kerberos/kerberos.cnf"
+dissect_kerberos_T_encAPRepPart_subkey(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 438 "./asn1/kerberos/kerberos.cnf"
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    gint save_encryption_key_parent_hf_index = private_data->save_encryption_key_parent_hf_index;
+    kerberos_key_save_fn saved_encryption_key_fn = private_data->save_encryption_key_fn;
+    private_data->save_encryption_key_parent_hf_index = hf_kerberos_encAPRepPart;
 #ifdef HAVE_KERBEROS
-    offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_index, dissect_krb5_decrypt_AP_REP_data);
-#else
-    offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index,
-        NULL);
-
+    private_data->save_encryption_key_fn = save_EncAPRepPart_subkey;
 #endif
+    offset = dissect_kerberos_EncryptionKey(implicit_tag, tvb, offset, actx, tree, hf_index);
 
+    private_data->save_encryption_key_parent_hf_index = save_encryption_key_parent_hf_index;
+    private_data->save_encryption_key_fn = saved_encryption_key_fn;
 
 
-    return offset;
-}
-
-
-static const ber_sequence_t EncryptedAPREPData_sequence[] = {
-  { &hf_kerberos_etype      , BER_CLASS_CON, 0, 0, dissect_kerberos_ENCTYPE },
-  { &hf_kerberos_kvno       , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
-  { &hf_kerberos_encryptedAPREPData_cipher, BER_CLASS_CON, 2, 0, dissect_kerberos_T_encryptedAPREPData_cipher },
-  { NULL, 0, 0, 0, NULL }
-};
-
-static int
-dissect_kerberos_EncryptedAPREPData(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        EncryptedAPREPData_sequence, hf_index, ett_kerberos_EncryptedAPREPData);
 
     return offset;
 }
 
 
-static const ber_sequence_t AP_REP_U_sequence[] = {
-  { &hf_kerberos_pvno       , BER_CLASS_CON, 0, 0, dissect_kerberos_INTEGER_5 },
-  { &hf_kerberos_msg_type   , BER_CLASS_CON, 1, 0, dissect_kerberos_MESSAGE_TYPE },
-  { &hf_kerberos_aP_REP_enc_part, BER_CLASS_CON, 2, 0, dissect_kerberos_EncryptedAPREPData },
+static const ber_sequence_t EncAPRepPart_U_sequence[] = {
+  { &hf_kerberos_ctime      , BER_CLASS_CON, 0, 0, dissect_kerberos_KerberosTime },
+  { &hf_kerberos_cusec      , BER_CLASS_CON, 1, 0, dissect_kerberos_Microseconds },
+  { &hf_kerberos_encAPRepPart_subkey, BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_kerberos_T_encAPRepPart_subkey },
+  { &hf_kerberos_seq_number , BER_CLASS_CON, 3, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
   { NULL, 0, 0, 0, NULL }
 };
 
+static const ber_schema_t kerberos_schema_EncAPRepPart_U = BER_SCHEMA_SEQ(EncAPRepPart_U_sequence, ett_kerberos_EncAPRepPart_U);
+
 static int
-dissect_kerberos_AP_REP_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        AP_REP_U_sequence, hf_index, ett_kerberos_AP_REP_U);
+dissect_kerberos_EncAPRepPart_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_EncAPRepPart_U, hf_index);
 
     return offset;
 }
@@ -5767,9 +9722,9 @@ dissect_kerberos_AP_REP_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offs
 
 
 static int
-dissect_kerberos_AP_REP(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+dissect_kerberos_EncAPRepPart(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
     offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
-        hf_index, BER_CLASS_APP, 15, FALSE, dissect_kerberos_AP_REP_U);
+        hf_index, BER_CLASS_APP, 27, FALSE, dissect_kerberos_EncAPRepPart_U);
 
     return offset;
 }
@@ -5777,13 +9732,13 @@ dissect_kerberos_AP_REP(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset
 
 
 static int
-dissect_kerberos_T_kRB_SAFE_BODY_user_data(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 559 "./asn1/kerberos/kerberos.cnf"
+dissect_kerberos_T_encKrbPrivPart_user_data(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 567 "./asn1/kerberos/kerberos.cnf"
     kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
     tvbuff_t* new_tvb;
     offset = dissect_ber_octet_string(FALSE, actx, tree, tvb, offset, hf_index, &new_tvb);
     if (new_tvb) {
-        call_kerberos_callbacks(actx->pinfo, tree, new_tvb, KRB_CBTAG_SAFE_USER_DATA, private_data->callbacks);
+        call_kerberos_callbacks(actx->pinfo, tree, new_tvb, KRB_CBTAG_PRIV_USER_DATA, private_data->callbacks);
     }
 
 
@@ -5792,37 +9747,22 @@ dissect_kerberos_T_kRB_SAFE_BODY_user_data(gboolean implicit_tag _U_, tvbuff_t*
 }
 
 
-static const ber_sequence_t KRB_SAFE_BODY_sequence[] = {
-  { &hf_kerberos_kRB_SAFE_BODY_user_data, BER_CLASS_CON, 0, 0, dissect_kerberos_T_kRB_SAFE_BODY_user_data },
+static const ber_sequence_t EncKrbPrivPart_sequence[] = {
+  { &hf_kerberos_encKrbPrivPart_user_data, BER_CLASS_CON, 0, 0, dissect_kerberos_T_encKrbPrivPart_user_data },
   { &hf_kerberos_timestamp  , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
   { &hf_kerberos_usec       , BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_kerberos_Microseconds },
   { &hf_kerberos_seq_number , BER_CLASS_CON, 3, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
-  { &hf_kerberos_s_address  , BER_CLASS_CON, 4, BER_FLAGS_OPTIONAL, dissect_kerberos_HostAddress },
-  { &hf_kerberos_r_address  , BER_CLASS_CON, 5, BER_FLAGS_OPTIONAL, dissect_kerberos_HostAddress },
+  { &hf_kerberos_s_address  , BER_CLASS_CON, 4, 0, dissect_ber_schema_field },
+  { &hf_kerberos_r_address  , BER_CLASS_CON, 5, BER_FLAGS_OPTIONAL, dissect_ber_schema_field },
   { NULL, 0, 0, 0, NULL }
 };
 
-static int
-dissect_kerberos_KRB_SAFE_BODY(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        KRB_SAFE_BODY_sequence, hf_index, ett_kerberos_KRB_SAFE_BODY);
-
-    return offset;
-}
-
-
-static const ber_sequence_t KRB_SAFE_U_sequence[] = {
-  { &hf_kerberos_pvno       , BER_CLASS_CON, 0, 0, dissect_kerberos_INTEGER_5 },
-  { &hf_kerberos_msg_type   , BER_CLASS_CON, 1, 0, dissect_kerberos_MESSAGE_TYPE },
-  { &hf_kerberos_safe_body  , BER_CLASS_CON, 2, 0, dissect_kerberos_KRB_SAFE_BODY },
-  { &hf_kerberos_cksum      , BER_CLASS_CON, 3, 0, dissect_kerberos_Checksum },
-  { NULL, 0, 0, 0, NULL }
-};
+static const ber_schema_t kerberos_schema_EncKrbPrivPart = BER_SCHEMA_SEQ(EncKrbPrivPart_sequence, ett_kerberos_EncKrbPrivPart);
 
 static int
-dissect_kerberos_KRB_SAFE_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        KRB_SAFE_U_sequence, hf_index, ett_kerberos_KRB_SAFE_U);
+dissect_kerberos_EncKrbPrivPart(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_EncKrbPrivPart, hf_index);
 
     return offset;
 }
@@ -5830,9 +9770,9 @@ dissect_kerberos_KRB_SAFE_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int of
 
 
 static int
-dissect_kerberos_KRB_SAFE(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+dissect_kerberos_ENC_KRB_PRIV_PART(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
     offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
-        hf_index, BER_CLASS_APP, 20, FALSE, dissect_kerberos_KRB_SAFE_U);
+        hf_index, BER_CLASS_APP, 28, FALSE, dissect_kerberos_EncKrbPrivPart);
 
     return offset;
 }
@@ -5840,15 +9780,19 @@ dissect_kerberos_KRB_SAFE(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offs
 
 
 static int
-dissect_kerberos_T_encryptedKrbPrivData_cipher(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 351 "./asn1/kerberos/kerberos.cnf"
+dissect_kerberos_T_krbCredInfo_key(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 483 "./asn1/kerberos/kerberos.cnf"
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    gint save_encryption_key_parent_hf_index = private_data->save_encryption_key_parent_hf_index;
+    kerberos_key_save_fn saved_encryption_key_fn = private_data->save_encryption_key_fn;
+    private_data->save_encryption_key_parent_hf_index = hf_kerberos_ticket_info_item;
 #ifdef HAVE_KERBEROS
-    offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_index, dissect_krb5_decrypt_PRIV_data);
-#else
-    offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index,
-        NULL);
-
+    private_data->save_encryption_key_fn = save_KrbCredInfo_key;
 #endif
+    offset = dissect_kerberos_EncryptionKey(implicit_tag, tvb, offset, actx, tree, hf_index);
+
+    private_data->save_encryption_key_parent_hf_index = save_encryption_key_parent_hf_index;
+    private_data->save_encryption_key_fn = saved_encryption_key_fn;
 
 
 
@@ -5856,94 +9800,63 @@ dissect_kerberos_T_encryptedKrbPrivData_cipher(gboolean implicit_tag _U_, tvbuff
 }
 
 
-static const ber_sequence_t EncryptedKrbPrivData_sequence[] = {
-  { &hf_kerberos_etype      , BER_CLASS_CON, 0, 0, dissect_kerberos_ENCTYPE },
-  { &hf_kerberos_kvno       , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
-  { &hf_kerberos_encryptedKrbPrivData_cipher, BER_CLASS_CON, 2, 0, dissect_kerberos_T_encryptedKrbPrivData_cipher },
-  { NULL, 0, 0, 0, NULL }
+static const ber_sequence_t SEQUENCE_OF_KerberosString_sequence_of[1] = {
+  { &hf_kerberos_name_string_item, BER_CLASS_UNI, BER_UNI_TAG_GeneralString, BER_FLAGS_NOOWNTAG, dissect_kerberos_KerberosString },
 };
 
-static int
-dissect_kerberos_EncryptedKrbPrivData(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        EncryptedKrbPrivData_sequence, hf_index, ett_kerberos_EncryptedKrbPrivData);
-
-    return offset;
-}
+static const ber_schema_t kerberos_schema_SEQUENCE_OF_KerberosString = BER_SCHEMA_SEQ_OF(SEQUENCE_OF_KerberosString_sequence_of, ett_kerberos_SEQUENCE_OF_KerberosString);
 
 
-static const ber_sequence_t KRB_PRIV_U_sequence[] = {
-  { &hf_kerberos_pvno       , BER_CLASS_CON, 0, 0, dissect_kerberos_INTEGER_5 },
-  { &hf_kerberos_msg_type   , BER_CLASS_CON, 1, 0, dissect_kerberos_MESSAGE_TYPE },
-  { &hf_kerberos_kRB_PRIV_enc_part, BER_CLASS_CON, 3, 0, dissect_kerberos_EncryptedKrbPrivData },
+static const ber_sequence_t PrincipalName_sequence[] = {
+  { &hf_kerberos_name_type  , BER_CLASS_CON, 0, 0, dissect_kerberos_NAME_TYPE },
+  { &hf_kerberos_name_string, BER_CLASS_CON, 1, 0, dissect_ber_schema_field },
   { NULL, 0, 0, 0, NULL }
 };
 
-static int
-dissect_kerberos_KRB_PRIV_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        KRB_PRIV_U_sequence, hf_index, ett_kerberos_KRB_PRIV_U);
-
-    return offset;
-}
-
-
-
-static int
-dissect_kerberos_KRB_PRIV(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
-        hf_index, BER_CLASS_APP, 21, FALSE, dissect_kerberos_KRB_PRIV_U);
-
-    return offset;
-}
-
-
-
-static int
-dissect_kerberos_T_encryptedKrbCredData_cipher(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 358 "./asn1/kerberos/kerberos.cnf"
-#ifdef HAVE_KERBEROS
-    offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_index, dissect_krb5_decrypt_CRED_data);
-#else
-    offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index,
-        NULL);
-
-#endif
+static const ber_schema_t kerberos_schema_PrincipalName = BER_SCHEMA_SEQ(PrincipalName_sequence, ett_kerberos_PrincipalName);
 
 
+static const ber_sequence_t KrbCredInfo_sequence[] = {
+  { &hf_kerberos_krbCredInfo_key, BER_CLASS_CON, 0, 0, dissect_kerberos_T_krbCredInfo_key },
+  { &hf_kerberos_prealm     , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_Realm },
+  { &hf_kerberos_pname      , BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_ber_schema_field },
+  { &hf_kerberos_flags      , BER_CLASS_CON, 3, BER_FLAGS_OPTIONAL, dissect_kerberos_TicketFlags },
+  { &hf_kerberos_authtime   , BER_CLASS_CON, 4, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
+  { &hf_kerberos_starttime  , BER_CLASS_CON, 5, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
+  { &hf_kerberos_endtime    , BER_CLASS_CON, 6, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
+  { &hf_kerberos_renew_till , BER_CLASS_CON, 7, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
+  { &hf_kerberos_srealm     , BER_CLASS_CON, 8, BER_FLAGS_OPTIONAL, dissect_kerberos_Realm },
+  { &hf_kerberos_sname      , BER_CLASS_CON, 9, BER_FLAGS_OPTIONAL, dissect_kerberos_SName },
+  { &hf_kerberos_caddr      , BER_CLASS_CON, 10, BER_FLAGS_OPTIONAL, dissect_ber_schema_field },
+  { NULL, 0, 0, 0, NULL }
+};
 
-    return offset;
-}
+static const ber_schema_t kerberos_schema_KrbCredInfo = BER_SCHEMA_SEQ(KrbCredInfo_sequence, ett_kerberos_KrbCredInfo);
 
 
-static const ber_sequence_t EncryptedKrbCredData_sequence[] = {
-  { &hf_kerberos_etype      , BER_CLASS_CON, 0, 0, dissect_kerberos_ENCTYPE },
-  { &hf_kerberos_kvno       , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
-  { &hf_kerberos_encryptedKrbCredData_cipher, BER_CLASS_CON, 2, 0, dissect_kerberos_T_encryptedKrbCredData_cipher },
-  { NULL, 0, 0, 0, NULL }
+static const ber_sequence_t SEQUENCE_OF_KrbCredInfo_sequence_of[1] = {
+  { &hf_kerberos_ticket_info_item, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, BER_FLAGS_NOOWNTAG, dissect_ber_schema_field },
 };
 
-static int
-dissect_kerberos_EncryptedKrbCredData(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        EncryptedKrbCredData_sequence, hf_index, ett_kerberos_EncryptedKrbCredData);
-
-    return offset;
-}
+static const ber_schema_t kerberos_schema_SEQUENCE_OF_KrbCredInfo = BER_SCHEMA_SEQ_OF(SEQUENCE_OF_KrbCredInfo_sequence_of, ett_kerberos_SEQUENCE_OF_KrbCredInfo);
 
 
-static const ber_sequence_t KRB_CRED_U_sequence[] = {
-  { &hf_kerberos_pvno       , BER_CLASS_CON, 0, 0, dissect_kerberos_INTEGER_5 },
-  { &hf_kerberos_msg_type   , BER_CLASS_CON, 1, 0, dissect_kerberos_MESSAGE_TYPE },
-  { &hf_kerberos_tickets    , BER_CLASS_CON, 2, 0, dissect_kerberos_SEQUENCE_OF_Ticket },
-  { &hf_kerberos_kRB_CRED_enc_part, BER_CLASS_CON, 3, 0, dissect_kerberos_EncryptedKrbCredData },
+static const ber_sequence_t EncKrbCredPart_U_sequence[] = {
+  { &hf_kerberos_ticket_info, BER_CLASS_CON, 0, 0, dissect_ber_schema_field },
+  { &hf_kerberos_nonce      , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
+  { &hf_kerberos_timestamp  , BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
+  { &hf_kerberos_usec       , BER_CLASS_CON, 3, BER_FLAGS_OPTIONAL, dissect_kerberos_Microseconds },
+  { &hf_kerberos_s_address  , BER_CLASS_CON, 4, BER_FLAGS_OPTIONAL, dissect_ber_schema_field },
+  { &hf_kerberos_r_address  , BER_CLASS_CON, 5, BER_FLAGS_OPTIONAL, dissect_ber_schema_field },
   { NULL, 0, 0, 0, NULL }
 };
 
+static const ber_schema_t kerberos_schema_EncKrbCredPart_U = BER_SCHEMA_SEQ(EncKrbCredPart_U_sequence, ett_kerberos_EncKrbCredPart_U);
+
 static int
-dissect_kerberos_KRB_CRED_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        KRB_CRED_U_sequence, hf_index, ett_kerberos_KRB_CRED_U);
+dissect_kerberos_EncKrbCredPart_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_EncKrbCredPart_U, hf_index);
 
     return offset;
 }
@@ -5951,103 +9864,173 @@ dissect_kerberos_KRB_CRED_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int of
 
 
 static int
-dissect_kerberos_KRB_CRED(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+dissect_kerberos_EncKrbCredPart(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
     offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
-        hf_index, BER_CLASS_APP, 22, FALSE, dissect_kerberos_KRB_CRED_U);
+        hf_index, BER_CLASS_APP, 29, FALSE, dissect_kerberos_EncKrbCredPart_U);
 
     return offset;
 }
 
 
+static const value_string kerberos_ERROR_CODE_vals[] = {
+  {   0, "eRR-NONE" },
+  {   1, "eRR-NAME-EXP" },
+  {   2, "eRR-SERVICE-EXP" },
+  {   3, "eRR-BAD-PVNO" },
+  {   4, "eRR-C-OLD-MAST-KVNO" },
+  {   5, "eRR-S-OLD-MAST-KVNO" },
+  {   6, "eRR-C-PRINCIPAL-UNKNOWN" },
+  {   7, "eRR-S-PRINCIPAL-UNKNOWN" },
+  {   8, "eRR-PRINCIPAL-NOT-UNIQUE" },
+  {   9, "eRR-NULL-KEY" },
+  {  10, "eRR-CANNOT-POSTDATE" },
+  {  11, "eRR-NEVER-VALID" },
+  {  12, "eRR-POLICY" },
+  {  13, "eRR-BADOPTION" },
+  {  14, "eRR-ETYPE-NOSUPP" },
+  {  15, "eRR-SUMTYPE-NOSUPP" },
+  {  16, "eRR-PADATA-TYPE-NOSUPP" },
+  {  17, "eRR-TRTYPE-NOSUPP" },
+  {  18, "eRR-CLIENT-REVOKED" },
+  {  19, "eRR-SERVICE-REVOKED" },
+  {  20, "eRR-TGT-REVOKED" },
+  {  21, "eRR-CLIENT-NOTYET" },
+  {  22, "eRR-SERVICE-NOTYET" },
+  {  23, "eRR-KEY-EXP" },
+  {  24, "eRR-PREAUTH-FAILED" },
+  {  25, "eRR-PREAUTH-REQUIRED" },
+  {  26, "eRR-SERVER-NOMATCH" },
+  {  27, "eRR-MUST-USE-USER2USER" },
+  {  28, "eRR-PATH-NOT-ACCEPTED" },
+  {  29, "eRR-SVC-UNAVAILABLE" },
+  {  31, "eRR-BAD-INTEGRITY" },
+  {  32, "eRR-TKT-EXPIRED" },
+  {  33, "eRR-TKT-NYV" },
+  {  34, "eRR-REPEAT" },
+  {  35, "eRR-NOT-US" },
+  {  36, "eRR-BADMATCH" },
+  {  37, "eRR-SKEW" },
+  {  38, "eRR-BADADDR" },
+  {  39, "eRR-BADVERSION" },
+  {  40, "eRR-MSG-TYPE" },
+  {  41, "eRR-MODIFIED" },
+  {  42, "eRR-BADORDER" },
+  {  43, "eRR-ILL-CR-TKT" },
+  {  44, "eRR-BADKEYVER" },
+  {  45, "eRR-NOKEY" },
+  {  46, "eRR-MUT-FAIL" },
+  {  47, "eRR-BADDIRECTION" },
+  {  48, "eRR-METHOD" },
+  {  49, "eRR-BADSEQ" },
+  {  50, "eRR-INAPP-CKSUM" },
+  {  51, "pATH-NOT-ACCEPTED" },
+  {  52, "eRR-RESPONSE-TOO-BIG" },
+  {  60, "eRR-GENERIC" },
+  {  61, "eRR-FIELD-TOOLONG" },
+  {  62, "eRROR-CLIENT-NOT-TRUSTED" },
+  {  63, "eRROR-KDC-NOT-TRUSTED" },
+  {  64, "eRROR-INVALID-SIG" },
+  {  65, "eRR-KEY-TOO-WEAK" },
+  {  66, "eRR-CERTIFICATE-MISMATCH" },
+  {  67, "eRR-NO-TGT" },
+  {  68, "eRR-WRONG-REALM" },
+  {  69, "eRR-USER-TO-USER-REQUIRED" },
+  {  70, "eRR-CANT-VERIFY-CERTIFICATE" },
+  {  71, "eRR-INVALID-CERTIFICATE" },
+  {  72, "eRR-REVOKED-CERTIFICATE" },
+  {  73, "eRR-REVOCATION-STATUS-UNKNOWN" },
+  {  74, "eRR-REVOCATION-STATUS-UNAVAILABLE" },
+  {  75, "eRR-CLIENT-NAME-MISMATCH" },
+  {  76, "eRR-KDC-NAME-MISMATCH" },
+  { 0, NULL }
+};
+
 
 static int
-dissect_kerberos_T_encKDCRepPart_key(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 450 "./asn1/kerberos/kerberos.cnf"
+dissect_kerberos_ERROR_CODE(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 113 "./asn1/kerberos/kerberos.cnf"
     kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-    gint save_encryption_key_parent_hf_index = private_data->save_encryption_key_parent_hf_index;
-    kerberos_key_save_fn saved_encryption_key_fn = private_data->save_encryption_key_fn;
-    switch (private_data->msg_type) {
-    case KERBEROS_APPLICATIONS_AS_REP:
-        private_data->save_encryption_key_parent_hf_index = hf_kerberos_encASRepPart;
-        break;
-    case KERBEROS_APPLICATIONS_TGS_REP:
-        private_data->save_encryption_key_parent_hf_index = hf_kerberos_encTGSRepPart;
-        break;
-    default:
-        private_data->save_encryption_key_parent_hf_index = -1;
-    }
-#ifdef HAVE_KERBEROS
-    private_data->save_encryption_key_fn = save_EncKDCRepPart_key;
-#endif
-    offset = dissect_kerberos_EncryptionKey(implicit_tag, tvb, offset, actx, tree, hf_index);
-
-    private_data->save_encryption_key_parent_hf_index = save_encryption_key_parent_hf_index;
-    private_data->save_encryption_key_fn = saved_encryption_key_fn;
-
-
+    offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
+        &private_data->errorcode);
 
-    return offset;
-}
 
 
-static const value_string kerberos_LR_TYPE_vals[] = {
-  {   0, "lR-NONE" },
-  {   1, "lR-INITIAL-TGT" },
-  {   2, "lR-INITIAL" },
-  {   3, "lR-ISSUE-USE-TGT" },
-  {   4, "lR-RENEWAL" },
-  {   5, "lR-REQUEST" },
-  {   6, "lR-PW-EXPTIME" },
-  {   7, "lR-ACCT-EXPTIME" },
-  { 0, NULL }
-};
 
+#line 117 "./asn1/kerberos/kerberos.cnf"
+    if (private_data->errorcode) {
+        col_add_fstr(actx->pinfo->cinfo, COL_INFO,
+            "KRB Error: %s",
+            val_to_str(private_data->errorcode, krb5_error_codes,
+                "Unknown error code %#x"));
+    }
 
-static int
-dissect_kerberos_LR_TYPE(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
-        NULL);
 
     return offset;
 }
 
 
-static const ber_sequence_t LastReq_item_sequence[] = {
-  { &hf_kerberos_lr_type    , BER_CLASS_CON, 0, 0, dissect_kerberos_LR_TYPE },
-  { &hf_kerberos_lr_value   , BER_CLASS_CON, 1, 0, dissect_kerberos_KerberosTime },
-  { NULL, 0, 0, 0, NULL }
-};
 
 static int
-dissect_kerberos_LastReq_item(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        LastReq_item_sequence, hf_index, ett_kerberos_LastReq_item);
+dissect_kerberos_T_e_data(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 126 "./asn1/kerberos/kerberos.cnf"
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
 
-    return offset;
-}
+    switch (private_data->errorcode) {
+    case KRB5_ET_KRB5KDC_ERR_BADOPTION:
+    case KRB5_ET_KRB5KDC_ERR_CLIENT_REVOKED:
+    case KRB5_ET_KRB5KDC_ERR_KEY_EXP:
+    case KRB5_ET_KRB5KDC_ERR_POLICY:
+        /* ms windows kdc sends e-data of this type containing a "salt"
+         * that contains the nt_status code for these error codes.
+         */
+        private_data->try_nt_status = TRUE;
+        offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_kerberos_e_data, dissect_kerberos_PA_DATA);
+        break;
+    case KRB5_ET_KRB5KDC_ERR_PREAUTH_REQUIRED:
+    case KRB5_ET_KRB5KDC_ERR_PREAUTH_FAILED:
+    case KRB5_ET_KRB5KDC_ERR_ETYPE_NOSUPP:
+    case KRB5_ET_KDC_ERR_WRONG_REALM:
+    case KRB5_ET_KDC_ERR_PREAUTH_EXPIRED:
+    case KRB5_ET_KDC_ERR_MORE_PREAUTH_DATA_REQUIRED:
+    case KRB5_ET_KDC_ERR_PREAUTH_BAD_AUTHENTICATION_SET:
+    case KRB5_ET_KDC_ERR_UNKNOWN_CRITICAL_FAST_OPTIONS:
+        offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_kerberos_e_data, dissect_kerberos_SEQUENCE_OF_PA_DATA);
+        break;
+    default:
+        offset = dissect_ber_octet_string(FALSE, actx, tree, tvb, offset, hf_kerberos_e_data, NULL);
+        break;
+    }
 
 
-static const ber_sequence_t LastReq_sequence_of[1] = {
-  { &hf_kerberos_LastReq_item, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, BER_FLAGS_NOOWNTAG, dissect_kerberos_LastReq_item },
-};
 
-static int
-dissect_kerberos_LastReq(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence_of(implicit_tag, actx, tree, tvb, offset,
-        LastReq_sequence_of, hf_index, ett_kerberos_LastReq);
 
     return offset;
 }
 
 
-static const ber_sequence_t METHOD_DATA_sequence_of[1] = {
-  { &hf_kerberos_METHOD_DATA_item, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, BER_FLAGS_NOOWNTAG, dissect_kerberos_PA_DATA },
+static const ber_sequence_t KRB_ERROR_U_sequence[] = {
+  { &hf_kerberos_pvno       , BER_CLASS_CON, 0, 0, dissect_kerberos_INTEGER_5 },
+  { &hf_kerberos_msg_type   , BER_CLASS_CON, 1, 0, dissect_kerberos_MESSAGE_TYPE },
+  { &hf_kerberos_ctime      , BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
+  { &hf_kerberos_cusec      , BER_CLASS_CON, 3, BER_FLAGS_OPTIONAL, dissect_kerberos_Microseconds },
+  { &hf_kerberos_stime      , BER_CLASS_CON, 4, 0, dissect_kerberos_KerberosTime },
+  { &hf_kerberos_susec      , BER_CLASS_CON, 5, 0, dissect_kerberos_Microseconds },
+  { &hf_kerberos_error_code , BER_CLASS_CON, 6, 0, dissect_kerberos_ERROR_CODE },
+  { &hf_kerberos_crealm     , BER_CLASS_CON, 7, BER_FLAGS_OPTIONAL, dissect_kerberos_Realm },
+  { &hf_kerberos_cname      , BER_CLASS_CON, 8, BER_FLAGS_OPTIONAL, dissect_kerberos_CName },
+  { &hf_kerberos_realm      , BER_CLASS_CON, 9, 0, dissect_kerberos_Realm },
+  { &hf_kerberos_sname      , BER_CLASS_CON, 10, 0, dissect_kerberos_SName },
+  { &hf_kerberos_e_text     , BER_CLASS_CON, 11, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosString },
+  { &hf_kerberos_e_data     , BER_CLASS_CON, 12, BER_FLAGS_OPTIONAL, dissect_kerberos_T_e_data },
+  { &hf_kerberos_e_checksum , BER_CLASS_CON, 13, BER_FLAGS_OPTIONAL, dissect_kerberos_Checksum },
+  { NULL, 0, 0, 0, NULL }
 };
 
 static int
-dissect_kerberos_METHOD_DATA(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence_of(implicit_tag, actx, tree, tvb, offset,
-        METHOD_DATA_sequence_of, hf_index, ett_kerberos_METHOD_DATA);
+dissect_kerberos_KRB_ERROR_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
+        KRB_ERROR_U_sequence, hf_index, ett_kerberos_KRB_ERROR_U);
+    pkinit_exchange_krb_error(actx->pinfo, tree, tvb, kerberos_get_private_data(actx)->errorcode);
 
     return offset;
 }
@@ -6055,83 +10038,68 @@ dissect_kerberos_METHOD_DATA(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int o
 
 
 static int
-dissect_kerberos_T_encrypted_pa_data(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 575 "./asn1/kerberos/kerberos.cnf"
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-    private_data->is_enc_padata = TRUE;
-
-
-    offset = dissect_kerberos_METHOD_DATA(implicit_tag, tvb, offset, actx, tree, hf_index);
-
-#line 579 "./asn1/kerberos/kerberos.cnf"
-    private_data->is_enc_padata = FALSE;
-
+dissect_kerberos_KRB_ERROR(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
+        hf_index, BER_CLASS_APP, 30, FALSE, dissect_kerberos_KRB_ERROR_U);
 
     return offset;
 }
 
 
-static const ber_sequence_t EncKDCRepPart_sequence[] = {
-  { &hf_kerberos_encKDCRepPart_key, BER_CLASS_CON, 0, 0, dissect_kerberos_T_encKDCRepPart_key },
-  { &hf_kerberos_last_req   , BER_CLASS_CON, 1, 0, dissect_kerberos_LastReq },
-  { &hf_kerberos_nonce      , BER_CLASS_CON, 2, 0, dissect_kerberos_UInt32 },
-  { &hf_kerberos_key_expiration, BER_CLASS_CON, 3, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
-  { &hf_kerberos_flags      , BER_CLASS_CON, 4, 0, dissect_kerberos_TicketFlags },
-  { &hf_kerberos_authtime   , BER_CLASS_CON, 5, 0, dissect_kerberos_KerberosTime },
-  { &hf_kerberos_starttime  , BER_CLASS_CON, 6, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
-  { &hf_kerberos_endtime    , BER_CLASS_CON, 7, 0, dissect_kerberos_KerberosTime },
-  { &hf_kerberos_renew_till , BER_CLASS_CON, 8, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
-  { &hf_kerberos_srealm     , BER_CLASS_CON, 9, 0, dissect_kerberos_Realm },
-  { &hf_kerberos_sname      , BER_CLASS_CON, 10, 0, dissect_kerberos_SName },
-  { &hf_kerberos_caddr      , BER_CLASS_CON, 11, BER_FLAGS_OPTIONAL, dissect_kerberos_HostAddresses },
-  { &hf_kerberos_encrypted_pa_data, BER_CLASS_CON, 12, BER_FLAGS_OPTIONAL, dissect_kerberos_T_encrypted_pa_data },
-  { NULL, 0, 0, 0, NULL }
+static const ber_choice_t Applications_choice[] = {
+  { KERBEROS_APPLICATIONS_TICKET, &hf_kerberos_ticket     , BER_CLASS_APP, 1, BER_FLAGS_NOOWNTAG, dissect_kerberos_Ticket },
+  { KERBEROS_APPLICATIONS_AUTHENTICATOR, &hf_kerberos_authenticator, BER_CLASS_APP, 2, BER_FLAGS_NOOWNTAG, dissect_kerberos_Authenticator },
+  { KERBEROS_APPLICATIONS_ENCTICKETPART, &hf_kerberos_encTicketPart, BER_CLASS_APP, 3, BER_FLAGS_NOOWNTAG, dissect_kerberos_EncTicketPart },
+  { KERBEROS_APPLICATIONS_AS_REQ, &hf_kerberos_as_req     , BER_CLASS_APP, 10, BER_FLAGS_NOOWNTAG, dissect_kerberos_AS_REQ },
+  { KERBEROS_APPLICATIONS_AS_REP, &hf_kerberos_as_rep     , BER_CLASS_APP, 11, BER_FLAGS_NOOWNTAG, dissect_kerberos_AS_REP },
+  { KERBEROS_APPLICATIONS_TGS_REQ, &hf_kerberos_tgs_req    , BER_CLASS_APP, 12, BER_FLAGS_NOOWNTAG, dissect_kerberos_TGS_REQ },
+  { KERBEROS_APPLICATIONS_TGS_REP, &hf_kerberos_tgs_rep    , BER_CLASS_APP, 13, BER_FLAGS_NOOWNTAG, dissect_kerberos_TGS_REP },
+  { KERBEROS_APPLICATIONS_AP_REQ, &hf_kerberos_ap_req     , BER_CLASS_APP, 14, BER_FLAGS_NOOWNTAG, dissect_kerberos_AP_REQ },
+  { KERBEROS_APPLICATIONS_AP_REP, &hf_kerberos_ap_rep     , BER_CLASS_APP, 15, BER_FLAGS_NOOWNTAG, dissect_kerberos_AP_REP },
+  { KERBEROS_APPLICATIONS_KRB_SAFE, &hf_kerberos_krb_safe   , BER_CLASS_APP, 20, BER_FLAGS_NOOWNTAG, dissect_kerberos_KRB_SAFE },
+  { KERBEROS_APPLICATIONS_KRB_PRIV, &hf_kerberos_krb_priv   , BER_CLASS_APP, 21, BER_FLAGS_NOOWNTAG, dissect_kerberos_KRB_PRIV },
+  { KERBEROS_APPLICATIONS_KRB_CRED, &hf_kerberos_krb_cred   , BER_CLASS_APP, 22, BER_FLAGS_NOOWNTAG, dissect_kerberos_KRB_CRED },
+  { KERBEROS_APPLICATIONS_ENCASREPPART, &hf_kerberos_encASRepPart, BER_CLASS_APP, 25, BER_FLAGS_NOOWNTAG, dissect_kerberos_EncASRepPart },
+  { KERBEROS_APPLICATIONS_ENCTGSREPPART, &hf_kerberos_encTGSRepPart, BER_CLASS_APP, 26, BER_FLAGS_NOOWNTAG, dissect_kerberos_EncTGSRepPart },
+  { KERBEROS_APPLICATIONS_ENCAPREPPART, &hf_kerberos_encAPRepPart, BER_CLASS_APP, 27, BER_FLAGS_NOOWNTAG, dissect_kerberos_EncAPRepPart },
+  { KERBEROS_APPLICATIONS_ENCKRBPRIVPART, &hf_kerberos_encKrbPrivPart, BER_CLASS_APP, 28, BER_FLAGS_NOOWNTAG, dissect_kerberos_ENC_KRB_PRIV_PART },
+  { KERBEROS_APPLICATIONS_ENCKRBCREDPART, &hf_kerberos_encKrbCredPart, BER_CLASS_APP, 29, BER_FLAGS_NOOWNTAG, dissect_kerberos_EncKrbCredPart },
+  { KERBEROS_APPLICATIONS_KRB_ERROR, &hf_kerberos_krb_error  , BER_CLASS_APP, 30, BER_FLAGS_NOOWNTAG, dissect_kerberos_KRB_ERROR },
+  { 0, NULL, 0, 0, 0, NULL }
 };
 
 static int
-dissect_kerberos_EncKDCRepPart(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        EncKDCRepPart_sequence, hf_index, ett_kerberos_EncKDCRepPart);
-
-    return offset;
-}
-
-
-
-static int
-dissect_kerberos_EncASRepPart(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
-        hf_index, BER_CLASS_APP, 25, FALSE, dissect_kerberos_EncKDCRepPart);
+dissect_kerberos_Applications(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_choice(actx, tree, tvb, offset,
+        Applications_choice, hf_index, ett_kerberos_Applications,
+        NULL);
 
     return offset;
 }
 
+int
+dissect_kerberos_Applications_pku2u(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
 
-
-static int
-dissect_kerberos_EncTGSRepPart(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
-        hf_index, BER_CLASS_APP, 26, FALSE, dissect_kerberos_EncKDCRepPart);
+    /* Carried in NEGOEX: PKU2U unless the PA value says otherwise */
+    private_data->pkinit_layout_hint = KERBEROS_PKINIT_LAYOUT_PKU2U;
+    offset = dissect_ber_choice(actx, tree, tvb, offset,
+        Applications_choice, hf_index, ett_kerberos_Applications,
+        NULL);
 
     return offset;
 }
 
-
-
 static int
-dissect_kerberos_T_encAPRepPart_subkey(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 438 "./asn1/kerberos/kerberos.cnf"
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-    gint save_encryption_key_parent_hf_index = private_data->save_encryption_key_parent_hf_index;
-    kerberos_key_save_fn saved_encryption_key_fn = private_data->save_encryption_key_fn;
-    private_data->save_encryption_key_parent_hf_index = hf_kerberos_encAPRepPart;
+dissect_kerberos_T_pA_ENC_TIMESTAMP_cipher(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 337 "./asn1/kerberos/kerberos.cnf"
 #ifdef HAVE_KERBEROS
-    private_data->save_encryption_key_fn = save_EncAPRepPart_subkey;
-#endif
-    offset = dissect_kerberos_EncryptionKey(implicit_tag, tvb, offset, actx, tree, hf_index);
+    offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_index, dissect_krb5_decrypt_PA_ENC_TIMESTAMP);
+#else
+    offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index,
+        NULL);
 
-    private_data->save_encryption_key_parent_hf_index = save_encryption_key_parent_hf_index;
-    private_data->save_encryption_key_fn = saved_encryption_key_fn;
+#endif
 
 
 
@@ -6139,74 +10107,68 @@ dissect_kerberos_T_encAPRepPart_subkey(gboolean implicit_tag _U_, tvbuff_t* tvb
 }
 
 
-static const ber_sequence_t EncAPRepPart_U_sequence[] = {
-  { &hf_kerberos_ctime      , BER_CLASS_CON, 0, 0, dissect_kerberos_KerberosTime },
-  { &hf_kerberos_cusec      , BER_CLASS_CON, 1, 0, dissect_kerberos_Microseconds },
-  { &hf_kerberos_encAPRepPart_subkey, BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_kerberos_T_encAPRepPart_subkey },
-  { &hf_kerberos_seq_number , BER_CLASS_CON, 3, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
+static const ber_sequence_t PA_ENC_TIMESTAMP_sequence[] = {
+  { &hf_kerberos_etype      , BER_CLASS_CON, 0, 0, dissect_kerberos_ENCTYPE },
+  { &hf_kerberos_kvno       , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
+  { &hf_kerberos_pA_ENC_TIMESTAMP_cipher, BER_CLASS_CON, 2, 0, dissect_kerberos_T_pA_ENC_TIMESTAMP_cipher },
   { NULL, 0, 0, 0, NULL }
 };
 
+static const ber_schema_t kerberos_schema_PA_ENC_TIMESTAMP = BER_SCHEMA_SEQ(PA_ENC_TIMESTAMP_sequence, ett_kerberos_PA_ENC_TIMESTAMP);
+
 static int
-dissect_kerberos_EncAPRepPart_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        EncAPRepPart_U_sequence, hf_index, ett_kerberos_EncAPRepPart_U);
+dissect_kerberos_PA_ENC_TIMESTAMP(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_PA_ENC_TIMESTAMP, hf_index);
 
     return offset;
 }
 
 
+static const ber_sequence_t ETYPE_INFO_ENTRY_sequence[] = {
+  { &hf_kerberos_etype      , BER_CLASS_CON, 0, 0, dissect_kerberos_ENCTYPE },
+  { &hf_kerberos_info_salt  , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_OCTET_STRING },
+  { NULL, 0, 0, 0, NULL }
+};
 
-static int
-dissect_kerberos_EncAPRepPart(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
-        hf_index, BER_CLASS_APP, 27, FALSE, dissect_kerberos_EncAPRepPart_U);
+static const ber_schema_t kerberos_schema_ETYPE_INFO_ENTRY = BER_SCHEMA_SEQ(ETYPE_INFO_ENTRY_sequence, ett_kerberos_ETYPE_INFO_ENTRY);
 
-    return offset;
-}
 
+static const ber_sequence_t ETYPE_INFO_sequence_of[1] = {
+  { &hf_kerberos_ETYPE_INFO_item, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, BER_FLAGS_NOOWNTAG, dissect_ber_schema_field },
+};
 
+static const ber_schema_t kerberos_schema_ETYPE_INFO = BER_SCHEMA_SEQ_OF(ETYPE_INFO_sequence_of, ett_kerberos_ETYPE_INFO);
 
 static int
-dissect_kerberos_T_encKrbPrivPart_user_data(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 567 "./asn1/kerberos/kerberos.cnf"
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-    tvbuff_t* new_tvb;
-    offset = dissect_ber_octet_string(FALSE, actx, tree, tvb, offset, hf_index, &new_tvb);
-    if (new_tvb) {
-        call_kerberos_callbacks(actx->pinfo, tree, new_tvb, KRB_CBTAG_PRIV_USER_DATA, private_data->callbacks);
-    }
-
-
+dissect_kerberos_ETYPE_INFO(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_ETYPE_INFO, hf_index);
 
     return offset;
 }
 
 
-static const ber_sequence_t EncKrbPrivPart_sequence[] = {
-  { &hf_kerberos_encKrbPrivPart_user_data, BER_CLASS_CON, 0, 0, dissect_kerberos_T_encKrbPrivPart_user_data },
-  { &hf_kerberos_timestamp  , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
-  { &hf_kerberos_usec       , BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_kerberos_Microseconds },
-  { &hf_kerberos_seq_number , BER_CLASS_CON, 3, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
-  { &hf_kerberos_s_address  , BER_CLASS_CON, 4, 0, dissect_kerberos_HostAddress },
-  { &hf_kerberos_r_address  , BER_CLASS_CON, 5, BER_FLAGS_OPTIONAL, dissect_kerberos_HostAddress },
+static const ber_sequence_t ETYPE_INFO2_ENTRY_sequence[] = {
+  { &hf_kerberos_etype      , BER_CLASS_CON, 0, 0, dissect_kerberos_ENCTYPE },
+  { &hf_kerberos_info2_salt , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosString },
+  { &hf_kerberos_s2kparams  , BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_kerberos_OCTET_STRING },
   { NULL, 0, 0, 0, NULL }
 };
 
-static int
-dissect_kerberos_EncKrbPrivPart(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        EncKrbPrivPart_sequence, hf_index, ett_kerberos_EncKrbPrivPart);
+static const ber_schema_t kerberos_schema_ETYPE_INFO2_ENTRY = BER_SCHEMA_SEQ(ETYPE_INFO2_ENTRY_sequence, ett_kerberos_ETYPE_INFO2_ENTRY);
 
-    return offset;
-}
 
+static const ber_sequence_t ETYPE_INFO2_sequence_of[1] = {
+  { &hf_kerberos_ETYPE_INFO2_item, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, BER_FLAGS_NOOWNTAG, dissect_ber_schema_field },
+};
 
+static const ber_schema_t kerberos_schema_ETYPE_INFO2 = BER_SCHEMA_SEQ_OF(ETYPE_INFO2_sequence_of, ett_kerberos_ETYPE_INFO2);
 
 static int
-dissect_kerberos_ENC_KRB_PRIV_PART(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
-        hf_index, BER_CLASS_APP, 28, FALSE, dissect_kerberos_EncKrbPrivPart);
+dissect_kerberos_ETYPE_INFO2(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_ETYPE_INFO2, hf_index);
 
     return offset;
 }
@@ -6214,105 +10176,63 @@ dissect_kerberos_ENC_KRB_PRIV_PART(gboolean implicit_tag _U_, tvbuff_t* tvb _U_,
 
 
 static int
-dissect_kerberos_T_krbCredInfo_key(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 483 "./asn1/kerberos/kerberos.cnf"
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-    gint save_encryption_key_parent_hf_index = private_data->save_encryption_key_parent_hf_index;
-    kerberos_key_save_fn saved_encryption_key_fn = private_data->save_encryption_key_fn;
-    private_data->save_encryption_key_parent_hf_index = hf_kerberos_ticket_info_item;
-#ifdef HAVE_KERBEROS
-    private_data->save_encryption_key_fn = save_KrbCredInfo_key;
-#endif
-    offset = dissect_kerberos_EncryptionKey(implicit_tag, tvb, offset, actx, tree, hf_index);
-
-    private_data->save_encryption_key_parent_hf_index = save_encryption_key_parent_hf_index;
-    private_data->save_encryption_key_fn = saved_encryption_key_fn;
-
-
+dissect_kerberos_AD_IF_RELEVANT(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_kerberos_AuthorizationData(implicit_tag, tvb, offset, actx, tree, hf_index);
 
     return offset;
 }
 
 
-static const ber_sequence_t SEQUENCE_OF_KerberosString_sequence_of[1] = {
-  { &hf_kerberos_name_string_item, BER_CLASS_UNI, BER_UNI_TAG_GeneralString, BER_FLAGS_NOOWNTAG, dissect_kerberos_KerberosString },
-};
 
 static int
-dissect_kerberos_SEQUENCE_OF_KerberosString(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence_of(implicit_tag, actx, tree, tvb, offset,
-        SEQUENCE_OF_KerberosString_sequence_of, hf_index, ett_kerberos_SEQUENCE_OF_KerberosString);
+dissect_kerberos_BOOLEAN(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_boolean(implicit_tag, actx, tree, tvb, offset, hf_index, NULL);
 
     return offset;
 }
 
 
-static const ber_sequence_t PrincipalName_sequence[] = {
-  { &hf_kerberos_name_type  , BER_CLASS_CON, 0, 0, dissect_kerberos_NAME_TYPE },
-  { &hf_kerberos_name_string, BER_CLASS_CON, 1, 0, dissect_kerberos_SEQUENCE_OF_KerberosString },
+static const ber_sequence_t PA_PAC_REQUEST_sequence[] = {
+  { &hf_kerberos_include_pac, BER_CLASS_CON, 0, 0, dissect_kerberos_BOOLEAN },
   { NULL, 0, 0, 0, NULL }
 };
 
-static int
-dissect_kerberos_PrincipalName(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        PrincipalName_sequence, hf_index, ett_kerberos_PrincipalName);
-
-    return offset;
-}
-
-
-static const ber_sequence_t KrbCredInfo_sequence[] = {
-  { &hf_kerberos_krbCredInfo_key, BER_CLASS_CON, 0, 0, dissect_kerberos_T_krbCredInfo_key },
-  { &hf_kerberos_prealm     , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_Realm },
-  { &hf_kerberos_pname      , BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_kerberos_PrincipalName },
-  { &hf_kerberos_flags      , BER_CLASS_CON, 3, BER_FLAGS_OPTIONAL, dissect_kerberos_TicketFlags },
-  { &hf_kerberos_authtime   , BER_CLASS_CON, 4, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
-  { &hf_kerberos_starttime  , BER_CLASS_CON, 5, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
-  { &hf_kerberos_endtime    , BER_CLASS_CON, 6, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
-  { &hf_kerberos_renew_till , BER_CLASS_CON, 7, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
-  { &hf_kerberos_srealm     , BER_CLASS_CON, 8, BER_FLAGS_OPTIONAL, dissect_kerberos_Realm },
-  { &hf_kerberos_sname      , BER_CLASS_CON, 9, BER_FLAGS_OPTIONAL, dissect_kerberos_SName },
-  { &hf_kerberos_caddr      , BER_CLASS_CON, 10, BER_FLAGS_OPTIONAL, dissect_kerberos_HostAddresses },
-  { NULL, 0, 0, 0, NULL }
-};
+static const ber_schema_t kerberos_schema_PA_PAC_REQUEST = BER_SCHEMA_SEQ(PA_PAC_REQUEST_sequence, ett_kerberos_PA_PAC_REQUEST);
 
 static int
-dissect_kerberos_KrbCredInfo(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        KrbCredInfo_sequence, hf_index, ett_kerberos_KrbCredInfo);
+dissect_kerberos_PA_PAC_REQUEST(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_PA_PAC_REQUEST, hf_index);
 
     return offset;
 }
 
 
-static const ber_sequence_t SEQUENCE_OF_KrbCredInfo_sequence_of[1] = {
-  { &hf_kerberos_ticket_info_item, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, BER_FLAGS_NOOWNTAG, dissect_kerberos_KrbCredInfo },
-};
 
 static int
-dissect_kerberos_SEQUENCE_OF_KrbCredInfo(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence_of(implicit_tag, actx, tree, tvb, offset,
-        SEQUENCE_OF_KrbCredInfo_sequence_of, hf_index, ett_kerberos_SEQUENCE_OF_KrbCredInfo);
+dissect_kerberos_GeneralString(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_restricted_string(implicit_tag, BER_UNI_TAG_GeneralString,
+        actx, tree, tvb, offset, hf_index,
+        NULL);
 
     return offset;
 }
 
 
-static const ber_sequence_t EncKrbCredPart_U_sequence[] = {
-  { &hf_kerberos_ticket_info, BER_CLASS_CON, 0, 0, dissect_kerberos_SEQUENCE_OF_KrbCredInfo },
-  { &hf_kerberos_nonce      , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
-  { &hf_kerberos_timestamp  , BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
-  { &hf_kerberos_usec       , BER_CLASS_CON, 3, BER_FLAGS_OPTIONAL, dissect_kerberos_Microseconds },
-  { &hf_kerberos_s_address  , BER_CLASS_CON, 4, BER_FLAGS_OPTIONAL, dissect_kerberos_HostAddress },
-  { &hf_kerberos_r_address  , BER_CLASS_CON, 5, BER_FLAGS_OPTIONAL, dissect_kerberos_HostAddress },
+static const ber_sequence_t PA_S4U2Self_sequence[] = {
+  { &hf_kerberos_name       , BER_CLASS_CON, 0, 0, dissect_ber_schema_field },
+  { &hf_kerberos_realm      , BER_CLASS_CON, 1, 0, dissect_kerberos_Realm },
+  { &hf_kerberos_cksum      , BER_CLASS_CON, 2, 0, dissect_kerberos_Checksum },
+  { &hf_kerberos_auth       , BER_CLASS_CON, 3, 0, dissect_kerberos_GeneralString },
   { NULL, 0, 0, 0, NULL }
 };
 
+static const ber_schema_t kerberos_schema_PA_S4U2Self = BER_SCHEMA_SEQ(PA_S4U2Self_sequence, ett_kerberos_PA_S4U2Self);
+
 static int
-dissect_kerberos_EncKrbCredPart_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        EncKrbCredPart_U_sequence, hf_index, ett_kerberos_EncKrbCredPart_U);
+dissect_kerberos_PA_S4U2Self(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_PA_S4U2Self, hf_index);
 
     return offset;
 }
@@ -6320,172 +10240,102 @@ dissect_kerberos_EncKrbCredPart_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_,
 
 
 static int
-dissect_kerberos_EncKrbCredPart(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
-        hf_index, BER_CLASS_APP, 29, FALSE, dissect_kerberos_EncKrbCredPart_U);
+dissect_kerberos_T_subject_certificate(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 529 "./asn1/kerberos/kerberos.cnf"
+    offset = dissect_ber_octet_string_wcb(implicit_tag, actx, tree, tvb, offset, hf_index, dissect_x509af_Certificate);
 
-    return offset;
-}
 
 
-static const value_string kerberos_ERROR_CODE_vals[] = {
-  {   0, "eRR-NONE" },
-  {   1, "eRR-NAME-EXP" },
-  {   2, "eRR-SERVICE-EXP" },
-  {   3, "eRR-BAD-PVNO" },
-  {   4, "eRR-C-OLD-MAST-KVNO" },
-  {   5, "eRR-S-OLD-MAST-KVNO" },
-  {   6, "eRR-C-PRINCIPAL-UNKNOWN" },
-  {   7, "eRR-S-PRINCIPAL-UNKNOWN" },
-  {   8, "eRR-PRINCIPAL-NOT-UNIQUE" },
-  {   9, "eRR-NULL-KEY" },
-  {  10, "eRR-CANNOT-POSTDATE" },
-  {  11, "eRR-NEVER-VALID" },
-  {  12, "eRR-POLICY" },
-  {  13, "eRR-BADOPTION" },
-  {  14, "eRR-ETYPE-NOSUPP" },
-  {  15, "eRR-SUMTYPE-NOSUPP" },
-  {  16, "eRR-PADATA-TYPE-NOSUPP" },
-  {  17, "eRR-TRTYPE-NOSUPP" },
-  {  18, "eRR-CLIENT-REVOKED" },
-  {  19, "eRR-SERVICE-REVOKED" },
-  {  20, "eRR-TGT-REVOKED" },
-  {  21, "eRR-CLIENT-NOTYET" },
-  {  22, "eRR-SERVICE-NOTYET" },
-  {  23, "eRR-KEY-EXP" },
-  {  24, "eRR-PREAUTH-FAILED" },
-  {  25, "eRR-PREAUTH-REQUIRED" },
-  {  26, "eRR-SERVER-NOMATCH" },
-  {  27, "eRR-MUST-USE-USER2USER" },
-  {  28, "eRR-PATH-NOT-ACCEPTED" },
-  {  29, "eRR-SVC-UNAVAILABLE" },
-  {  31, "eRR-BAD-INTEGRITY" },
-  {  32, "eRR-TKT-EXPIRED" },
-  {  33, "eRR-TKT-NYV" },
-  {  34, "eRR-REPEAT" },
-  {  35, "eRR-NOT-US" },
-  {  36, "eRR-BADMATCH" },
-  {  37, "eRR-SKEW" },
-  {  38, "eRR-BADADDR" },
-  {  39, "eRR-BADVERSION" },
-  {  40, "eRR-MSG-TYPE" },
-  {  41, "eRR-MODIFIED" },
-  {  42, "eRR-BADORDER" },
-  {  43, "eRR-ILL-CR-TKT" },
-  {  44, "eRR-BADKEYVER" },
-  {  45, "eRR-NOKEY" },
-  {  46, "eRR-MUT-FAIL" },
-  {  47, "eRR-BADDIRECTION" },
-  {  48, "eRR-METHOD" },
-  {  49, "eRR-BADSEQ" },
-  {  50, "eRR-INAPP-CKSUM" },
-  {  51, "pATH-NOT-ACCEPTED" },
-  {  52, "eRR-RESPONSE-TOO-BIG" },
-  {  60, "eRR-GENERIC" },
-  {  61, "eRR-FIELD-TOOLONG" },
-  {  62, "eRROR-CLIENT-NOT-TRUSTED" },
-  {  63, "eRROR-KDC-NOT-TRUSTED" },
-  {  64, "eRROR-INVALID-SIG" },
-  {  65, "eRR-KEY-TOO-WEAK" },
-  {  66, "eRR-CERTIFICATE-MISMATCH" },
-  {  67, "eRR-NO-TGT" },
-  {  68, "eRR-WRONG-REALM" },
-  {  69, "eRR-USER-TO-USER-REQUIRED" },
-  {  70, "eRR-CANT-VERIFY-CERTIFICATE" },
-  {  71, "eRR-INVALID-CERTIFICATE" },
-  {  72, "eRR-REVOKED-CERTIFICATE" },
-  {  73, "eRR-REVOCATION-STATUS-UNKNOWN" },
-  {  74, "eRR-REVOCATION-STATUS-UNAVAILABLE" },
-  {  75, "eRR-CLIENT-NAME-MISMATCH" },
-  {  76, "eRR-KDC-NAME-MISMATCH" },
-  { 0, NULL }
-};
+    return offset;
+}
+
 
 
 static int
-dissect_kerberos_ERROR_CODE(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 113 "./asn1/kerberos/kerberos.cnf"
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-    offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
-        &private_data->errorcode);
+dissect_kerberos_BIT_STRING(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_bitstring(implicit_tag, actx, tree, tvb, offset,
+        NULL, 0, hf_index, -1,
+        NULL);
+
+    return offset;
+}
+
 
+static const ber_sequence_t S4UUserID_sequence[] = {
+  { &hf_kerberos_nonce      , BER_CLASS_CON, 0, 0, dissect_kerberos_UInt32 },
+  { &hf_kerberos_cname_01   , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_ber_schema_field },
+  { &hf_kerberos_crealm     , BER_CLASS_CON, 2, 0, dissect_kerberos_Realm },
+  { &hf_kerberos_subject_certificate, BER_CLASS_CON, 3, BER_FLAGS_OPTIONAL, dissect_kerberos_T_subject_certificate },
+  { &hf_kerberos_options    , BER_CLASS_CON, 4, BER_FLAGS_OPTIONAL, dissect_kerberos_BIT_STRING },
+  { NULL, 0, 0, 0, NULL }
+};
 
+static const ber_schema_t kerberos_schema_S4UUserID = BER_SCHEMA_SEQ(S4UUserID_sequence, ett_kerberos_S4UUserID);
 
 
-#line 117 "./asn1/kerberos/kerberos.cnf"
-    if (private_data->errorcode) {
-        col_add_fstr(actx->pinfo->cinfo, COL_INFO,
-            "KRB Error: %s",
-            val_to_str(private_data->errorcode, krb5_error_codes,
-                "Unknown error code %#x"));
-    }
+static const ber_sequence_t PA_S4U_X509_USER_sequence[] = {
+  { &hf_kerberos_user_id    , BER_CLASS_CON, 0, 0, dissect_ber_schema_field },
+  { &hf_kerberos_checksum_01, BER_CLASS_CON, 1, 0, dissect_kerberos_Checksum },
+  { NULL, 0, 0, 0, NULL }
+};
 
+static const ber_schema_t kerberos_schema_PA_S4U_X509_USER = BER_SCHEMA_SEQ(PA_S4U_X509_USER_sequence, ett_kerberos_PA_S4U_X509_USER);
+
+static int
+dissect_kerberos_PA_S4U_X509_USER(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_PA_S4U_X509_USER, hf_index);
 
     return offset;
 }
 
 
+static const int* PAC_OPTIONS_FLAGS_bits[] = {
+  &hf_kerberos_PAC_OPTIONS_FLAGS_claims,
+  &hf_kerberos_PAC_OPTIONS_FLAGS_branch_aware,
+  &hf_kerberos_PAC_OPTIONS_FLAGS_forward_to_full_dc,
+  &hf_kerberos_PAC_OPTIONS_FLAGS_resource_based_constrained_delegation,
+  NULL
+};
 
 static int
-dissect_kerberos_T_e_data(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 126 "./asn1/kerberos/kerberos.cnf"
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+dissect_kerberos_PAC_OPTIONS_FLAGS(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_bitstring(implicit_tag, actx, tree, tvb, offset,
+        PAC_OPTIONS_FLAGS_bits, 4, hf_index, ett_kerberos_PAC_OPTIONS_FLAGS,
+        NULL);
 
-    switch (private_data->errorcode) {
-    case KRB5_ET_KRB5KDC_ERR_BADOPTION:
-    case KRB5_ET_KRB5KDC_ERR_CLIENT_REVOKED:
-    case KRB5_ET_KRB5KDC_ERR_KEY_EXP:
-    case KRB5_ET_KRB5KDC_ERR_POLICY:
-        /* ms windows kdc sends e-data of this type containing a "salt"
-         * that contains the nt_status code for these error codes.
-         */
-        private_data->try_nt_status = TRUE;
-        offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_kerberos_e_data, dissect_kerberos_PA_DATA);
-        break;
-    case KRB5_ET_KRB5KDC_ERR_PREAUTH_REQUIRED:
-    case KRB5_ET_KRB5KDC_ERR_PREAUTH_FAILED:
-    case KRB5_ET_KRB5KDC_ERR_ETYPE_NOSUPP:
-    case KRB5_ET_KDC_ERR_WRONG_REALM:
-    case KRB5_ET_KDC_ERR_PREAUTH_EXPIRED:
-    case KRB5_ET_KDC_ERR_MORE_PREAUTH_DATA_REQUIRED:
-    case KRB5_ET_KDC_ERR_PREAUTH_BAD_AUTHENTICATION_SET:
-    case KRB5_ET_KDC_ERR_UNKNOWN_CRITICAL_FAST_OPTIONS:
-        offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_kerberos_e_data, dissect_kerberos_SEQUENCE_OF_PA_DATA);
-        break;
-    default:
-        offset = dissect_ber_octet_string(FALSE, actx, tree, tvb, offset, hf_kerberos_e_data, NULL);
-        break;
-    }
+    return offset;
+}
 
 
+static const ber_sequence_t PA_PAC_OPTIONS_sequence[] = {
+  { &hf_kerberos_flags_01   , BER_CLASS_CON, 0, 0, dissect_kerberos_PAC_OPTIONS_FLAGS },
+  { NULL, 0, 0, 0, NULL }
+};
+
+static const ber_schema_t kerberos_schema_PA_PAC_OPTIONS = BER_SCHEMA_SEQ(PA_PAC_OPTIONS_sequence, ett_kerberos_PA_PAC_OPTIONS);
 
+static int
+dissect_kerberos_PA_PAC_OPTIONS(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_PA_PAC_OPTIONS, hf_index);
 
     return offset;
 }
 
 
-static const ber_sequence_t KRB_ERROR_U_sequence[] = {
-  { &hf_kerberos_pvno       , BER_CLASS_CON, 0, 0, dissect_kerberos_INTEGER_5 },
-  { &hf_kerberos_msg_type   , BER_CLASS_CON, 1, 0, dissect_kerberos_MESSAGE_TYPE },
-  { &hf_kerberos_ctime      , BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosTime },
-  { &hf_kerberos_cusec      , BER_CLASS_CON, 3, BER_FLAGS_OPTIONAL, dissect_kerberos_Microseconds },
-  { &hf_kerberos_stime      , BER_CLASS_CON, 4, 0, dissect_kerberos_KerberosTime },
-  { &hf_kerberos_susec      , BER_CLASS_CON, 5, 0, dissect_kerberos_Microseconds },
-  { &hf_kerberos_error_code , BER_CLASS_CON, 6, 0, dissect_kerberos_ERROR_CODE },
-  { &hf_kerberos_crealm     , BER_CLASS_CON, 7, BER_FLAGS_OPTIONAL, dissect_kerberos_Realm },
-  { &hf_kerberos_cname      , BER_CLASS_CON, 8, BER_FLAGS_OPTIONAL, dissect_kerberos_CName },
-  { &hf_kerberos_realm      , BER_CLASS_CON, 9, 0, dissect_kerberos_Realm },
-  { &hf_kerberos_sname      , BER_CLASS_CON, 10, 0, dissect_kerberos_SName },
-  { &hf_kerberos_e_text     , BER_CLASS_CON, 11, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosString },
-  { &hf_kerberos_e_data     , BER_CLASS_CON, 12, BER_FLAGS_OPTIONAL, dissect_kerberos_T_e_data },
-  { &hf_kerberos_e_checksum , BER_CLASS_CON, 13, BER_FLAGS_OPTIONAL, dissect_kerberos_Checksum },
+static const ber_sequence_t KERB_AD_RESTRICTION_ENTRY_U_sequence[] = {
+  { &hf_kerberos_restriction_type, BER_CLASS_CON, 0, 0, dissect_kerberos_Int32 },
+  { &hf_kerberos_restriction, BER_CLASS_CON, 1, 0, dissect_kerberos_OCTET_STRING },
   { NULL, 0, 0, 0, NULL }
 };
 
+static const ber_schema_t kerberos_schema_KERB_AD_RESTRICTION_ENTRY_U = BER_SCHEMA_SEQ(KERB_AD_RESTRICTION_ENTRY_U_sequence, ett_kerberos_KERB_AD_RESTRICTION_ENTRY_U);
+
 static int
-dissect_kerberos_KRB_ERROR_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        KRB_ERROR_U_sequence, hf_index, ett_kerberos_KRB_ERROR_U);
+dissect_kerberos_KERB_AD_RESTRICTION_ENTRY_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_KERB_AD_RESTRICTION_ENTRY_U, hf_index);
 
     return offset;
 }
@@ -6493,66 +10343,112 @@ dissect_kerberos_KRB_ERROR_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int o
 
 
 static int
-dissect_kerberos_KRB_ERROR(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+dissect_kerberos_KERB_AD_RESTRICTION_ENTRY(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
     offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
-        hf_index, BER_CLASS_APP, 30, FALSE, dissect_kerberos_KRB_ERROR_U);
+        hf_index, BER_CLASS_UNI, 16, FALSE, dissect_kerberos_KERB_AD_RESTRICTION_ENTRY_U);
 
     return offset;
 }
 
 
-static const ber_choice_t Applications_choice[] = {
-  { KERBEROS_APPLICATIONS_TICKET, &hf_kerberos_ticket     , BER_CLASS_APP, 1, BER_FLAGS_NOOWNTAG, dissect_kerberos_Ticket },
-  { KERBEROS_APPLICATIONS_AUTHENTICATOR, &hf_kerberos_authenticator, BER_CLASS_APP, 2, BER_FLAGS_NOOWNTAG, dissect_kerberos_Authenticator },
-  { KERBEROS_APPLICATIONS_ENCTICKETPART, &hf_kerberos_encTicketPart, BER_CLASS_APP, 3, BER_FLAGS_NOOWNTAG, dissect_kerberos_EncTicketPart },
-  { KERBEROS_APPLICATIONS_AS_REQ, &hf_kerberos_as_req     , BER_CLASS_APP, 10, BER_FLAGS_NOOWNTAG, dissect_kerberos_AS_REQ },
-  { KERBEROS_APPLICATIONS_AS_REP, &hf_kerberos_as_rep     , BER_CLASS_APP, 11, BER_FLAGS_NOOWNTAG, dissect_kerberos_AS_REP },
-  { KERBEROS_APPLICATIONS_TGS_REQ, &hf_kerberos_tgs_req    , BER_CLASS_APP, 12, BER_FLAGS_NOOWNTAG, dissect_kerberos_TGS_REQ },
-  { KERBEROS_APPLICATIONS_TGS_REP, &hf_kerberos_tgs_rep    , BER_CLASS_APP, 13, BER_FLAGS_NOOWNTAG, dissect_kerberos_TGS_REP },
-  { KERBEROS_APPLICATIONS_AP_REQ, &hf_kerberos_ap_req     , BER_CLASS_APP, 14, BER_FLAGS_NOOWNTAG, dissect_kerberos_AP_REQ },
-  { KERBEROS_APPLICATIONS_AP_REP, &hf_kerberos_ap_rep     , BER_CLASS_APP, 15, BER_FLAGS_NOOWNTAG, dissect_kerberos_AP_REP },
-  { KERBEROS_APPLICATIONS_KRB_SAFE, &hf_kerberos_krb_safe   , BER_CLASS_APP, 20, BER_FLAGS_NOOWNTAG, dissect_kerberos_KRB_SAFE },
-  { KERBEROS_APPLICATIONS_KRB_PRIV, &hf_kerberos_krb_priv   , BER_CLASS_APP, 21, BER_FLAGS_NOOWNTAG, dissect_kerberos_KRB_PRIV },
-  { KERBEROS_APPLICATIONS_KRB_CRED, &hf_kerberos_krb_cred   , BER_CLASS_APP, 22, BER_FLAGS_NOOWNTAG, dissect_kerberos_KRB_CRED },
-  { KERBEROS_APPLICATIONS_ENCASREPPART, &hf_kerberos_encASRepPart, BER_CLASS_APP, 25, BER_FLAGS_NOOWNTAG, dissect_kerberos_EncASRepPart },
-  { KERBEROS_APPLICATIONS_ENCTGSREPPART, &hf_kerberos_encTGSRepPart, BER_CLASS_APP, 26, BER_FLAGS_NOOWNTAG, dissect_kerberos_EncTGSRepPart },
-  { KERBEROS_APPLICATIONS_ENCAPREPPART, &hf_kerberos_encAPRepPart, BER_CLASS_APP, 27, BER_FLAGS_NOOWNTAG, dissect_kerberos_EncAPRepPart },
-  { KERBEROS_APPLICATIONS_ENCKRBPRIVPART, &hf_kerberos_encKrbPrivPart, BER_CLASS_APP, 28, BER_FLAGS_NOOWNTAG, dissect_kerberos_ENC_KRB_PRIV_PART },
-  { KERBEROS_APPLICATIONS_ENCKRBCREDPART, &hf_kerberos_encKrbCredPart, BER_CLASS_APP, 29, BER_FLAGS_NOOWNTAG, dissect_kerberos_EncKrbCredPart },
-  { KERBEROS_APPLICATIONS_KRB_ERROR, &hf_kerberos_krb_error  , BER_CLASS_APP, 30, BER_FLAGS_NOOWNTAG, dissect_kerberos_KRB_ERROR },
-  { 0, NULL, 0, 0, 0, NULL }
+static const ber_sequence_t ChangePasswdData_sequence[] = {
+  { &hf_kerberos_newpasswd  , BER_CLASS_CON, 0, 0, dissect_kerberos_OCTET_STRING },
+  { &hf_kerberos_targname   , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_ber_schema_field },
+  { &hf_kerberos_targrealm  , BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_kerberos_Realm },
+  { NULL, 0, 0, 0, NULL }
+};
+
+int
+dissect_kerberos_ChangePasswdData(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
+        ChangePasswdData_sequence, hf_index, ett_kerberos_ChangePasswdData);
+
+    return offset;
+}
+
+
+static const ber_sequence_t PA_AUTHENTICATION_SET_ELEM_sequence[] = {
+  { &hf_kerberos_pa_type    , BER_CLASS_CON, 0, 0, dissect_kerberos_PADATA_TYPE },
+  { &hf_kerberos_pa_hint    , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_OCTET_STRING },
+  { &hf_kerberos_pa_value   , BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_kerberos_OCTET_STRING },
+  { NULL, 0, 0, 0, NULL }
 };
 
+static const ber_schema_t kerberos_schema_PA_AUTHENTICATION_SET_ELEM = BER_SCHEMA_SEQ(PA_AUTHENTICATION_SET_ELEM_sequence, ett_kerberos_PA_AUTHENTICATION_SET_ELEM);
+
 static int
-dissect_kerberos_Applications(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    isPku2u = -1;
-    offset = dissect_ber_choice(actx, tree, tvb, offset,
-        Applications_choice, hf_index, ett_kerberos_Applications,
-        NULL);
+dissect_kerberos_PA_AUTHENTICATION_SET_ELEM(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_PA_AUTHENTICATION_SET_ELEM, hf_index);
 
     return offset;
 }
 
-int
-dissect_kerberos_Applications_pku2u(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    isPku2u = 0;
-    offset = dissect_ber_choice(actx, tree, tvb, offset,
-        Applications_choice, hf_index, ett_kerberos_Applications,
-        NULL);
+
+static const value_string kerberos_KrbFastArmorTypes_vals[] = {
+  { KERBEROS_FX_FAST_RESERVED, "fX-FAST-reserved" },
+  { KERBEROS_FX_FAST_ARMOR_AP_REQUEST, "fX-FAST-ARMOR-AP-REQUEST" },
+  { 0, NULL }
+};
+
+
+static int
+dissect_kerberos_KrbFastArmorTypes(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 606 "./asn1/kerberos/kerberos.cnf"
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
+        &(private_data->fast_type));
+
+
+
 
     return offset;
 }
 
+
+
 static int
-dissect_kerberos_T_pA_ENC_TIMESTAMP_cipher(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 337 "./asn1/kerberos/kerberos.cnf"
+dissect_kerberos_T_armor_value(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 610 "./asn1/kerberos/kerberos.cnf"
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+
+    switch (private_data->fast_type) {
+    case KERBEROS_FX_FAST_ARMOR_AP_REQUEST:
+        private_data->fast_armor_within_armor_value++;
+        offset = dissect_ber_octet_string_wcb(implicit_tag, actx, tree, tvb, offset, hf_index, dissect_kerberos_Applications);
+        private_data->fast_armor_within_armor_value--;
+        break;
+    default:
+        offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index, NULL);
+        break;
+    }
+
+
+    return offset;
+}
+
+
+static const ber_sequence_t KrbFastArmor_sequence[] = {
+  { &hf_kerberos_armor_type , BER_CLASS_CON, 0, 0, dissect_kerberos_KrbFastArmorTypes },
+  { &hf_kerberos_armor_value, BER_CLASS_CON, 1, 0, dissect_kerberos_T_armor_value },
+  { NULL, 0, 0, 0, NULL }
+};
+
+static const ber_schema_t kerberos_schema_KrbFastArmor = BER_SCHEMA_SEQ(KrbFastArmor_sequence, ett_kerberos_KrbFastArmor);
+
+
+
+static int
+dissect_kerberos_T_encryptedKrbFastReq_cipher(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 582 "./asn1/kerberos/kerberos.cnf"
 #ifdef HAVE_KERBEROS
-    offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_index, dissect_krb5_decrypt_PA_ENC_TIMESTAMP);
+    offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_index, dissect_krb5_decrypt_KrbFastReq);
 #else
     offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index,
         NULL);
 
 #endif
+    return offset;
 
 
 
@@ -6560,74 +10456,88 @@ dissect_kerberos_T_pA_ENC_TIMESTAMP_cipher(gboolean implicit_tag _U_, tvbuff_t*
 }
 
 
-static const ber_sequence_t PA_ENC_TIMESTAMP_sequence[] = {
+static const ber_sequence_t EncryptedKrbFastReq_sequence[] = {
   { &hf_kerberos_etype      , BER_CLASS_CON, 0, 0, dissect_kerberos_ENCTYPE },
   { &hf_kerberos_kvno       , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
-  { &hf_kerberos_pA_ENC_TIMESTAMP_cipher, BER_CLASS_CON, 2, 0, dissect_kerberos_T_pA_ENC_TIMESTAMP_cipher },
+  { &hf_kerberos_encryptedKrbFastReq_cipher, BER_CLASS_CON, 2, 0, dissect_kerberos_T_encryptedKrbFastReq_cipher },
   { NULL, 0, 0, 0, NULL }
 };
 
-static int
-dissect_kerberos_PA_ENC_TIMESTAMP(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        PA_ENC_TIMESTAMP_sequence, hf_index, ett_kerberos_PA_ENC_TIMESTAMP);
-
-    return offset;
-}
+static const ber_schema_t kerberos_schema_EncryptedKrbFastReq = BER_SCHEMA_SEQ(EncryptedKrbFastReq_sequence, ett_kerberos_EncryptedKrbFastReq);
 
 
-static const ber_sequence_t ETYPE_INFO_ENTRY_sequence[] = {
-  { &hf_kerberos_etype      , BER_CLASS_CON, 0, 0, dissect_kerberos_ENCTYPE },
-  { &hf_kerberos_info_salt  , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_OCTET_STRING },
+static const ber_sequence_t KrbFastArmoredReq_sequence[] = {
+  { &hf_kerberos_armor      , BER_CLASS_CON, 0, BER_FLAGS_OPTIONAL, dissect_ber_schema_field },
+  { &hf_kerberos_req_checksum, BER_CLASS_CON, 1, 0, dissect_kerberos_Checksum },
+  { &hf_kerberos_enc_fast_req, BER_CLASS_CON, 2, 0, dissect_ber_schema_field },
   { NULL, 0, 0, 0, NULL }
 };
 
+static const ber_schema_t kerberos_schema_KrbFastArmoredReq = BER_SCHEMA_SEQ(KrbFastArmoredReq_sequence, ett_kerberos_KrbFastArmoredReq);
+
+
+static const ber_choice_t PA_FX_FAST_REQUEST_choice[] = {
+  {   0, &hf_kerberos_armored_data_request, BER_CLASS_CON, 0, 0, dissect_ber_schema_field },
+  { 0, NULL, 0, 0, 0, NULL }
+};
+
 static int
-dissect_kerberos_ETYPE_INFO_ENTRY(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        ETYPE_INFO_ENTRY_sequence, hf_index, ett_kerberos_ETYPE_INFO_ENTRY);
+dissect_kerberos_PA_FX_FAST_REQUEST(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_choice(actx, tree, tvb, offset,
+        PA_FX_FAST_REQUEST_choice, hf_index, ett_kerberos_PA_FX_FAST_REQUEST,
+        NULL);
 
     return offset;
 }
 
 
-static const ber_sequence_t ETYPE_INFO_sequence_of[1] = {
-  { &hf_kerberos_ETYPE_INFO_item, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, BER_FLAGS_NOOWNTAG, dissect_kerberos_ETYPE_INFO_ENTRY },
-};
 
-static int
-dissect_kerberos_ETYPE_INFO(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence_of(implicit_tag, actx, tree, tvb, offset,
-        ETYPE_INFO_sequence_of, hf_index, ett_kerberos_ETYPE_INFO);
+static int
+dissect_kerberos_T_encryptedKrbFastResponse_cipher(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 590 "./asn1/kerberos/kerberos.cnf"
+#ifdef HAVE_KERBEROS
+    offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_index, dissect_krb5_decrypt_KrbFastResponse);
+#else
+    offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index,
+        NULL);
+
+#endif
+    return offset;
+
+
 
     return offset;
 }
 
 
-static const ber_sequence_t ETYPE_INFO2_ENTRY_sequence[] = {
+static const ber_sequence_t EncryptedKrbFastResponse_sequence[] = {
   { &hf_kerberos_etype      , BER_CLASS_CON, 0, 0, dissect_kerberos_ENCTYPE },
-  { &hf_kerberos_info2_salt , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_KerberosString },
-  { &hf_kerberos_s2kparams  , BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_kerberos_OCTET_STRING },
+  { &hf_kerberos_kvno       , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
+  { &hf_kerberos_encryptedKrbFastResponse_cipher, BER_CLASS_CON, 2, 0, dissect_kerberos_T_encryptedKrbFastResponse_cipher },
   { NULL, 0, 0, 0, NULL }
 };
 
-static int
-dissect_kerberos_ETYPE_INFO2_ENTRY(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        ETYPE_INFO2_ENTRY_sequence, hf_index, ett_kerberos_ETYPE_INFO2_ENTRY);
+static const ber_schema_t kerberos_schema_EncryptedKrbFastResponse = BER_SCHEMA_SEQ(EncryptedKrbFastResponse_sequence, ett_kerberos_EncryptedKrbFastResponse);
 
-    return offset;
-}
 
+static const ber_sequence_t KrbFastArmoredRep_sequence[] = {
+  { &hf_kerberos_enc_fast_rep, BER_CLASS_CON, 0, 0, dissect_ber_schema_field },
+  { NULL, 0, 0, 0, NULL }
+};
+
+static const ber_schema_t kerberos_schema_KrbFastArmoredRep = BER_SCHEMA_SEQ(KrbFastArmoredRep_sequence, ett_kerberos_KrbFastArmoredRep);
 
-static const ber_sequence_t ETYPE_INFO2_sequence_of[1] = {
-  { &hf_kerberos_ETYPE_INFO2_item, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, BER_FLAGS_NOOWNTAG, dissect_kerberos_ETYPE_INFO2_ENTRY },
+
+static const ber_choice_t PA_FX_FAST_REPLY_choice[] = {
+  {   0, &hf_kerberos_armored_data_reply, BER_CLASS_CON, 0, 0, dissect_ber_schema_field },
+  { 0, NULL, 0, 0, 0, NULL }
 };
 
 static int
-dissect_kerberos_ETYPE_INFO2(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence_of(implicit_tag, actx, tree, tvb, offset,
-        ETYPE_INFO2_sequence_of, hf_index, ett_kerberos_ETYPE_INFO2);
+dissect_kerberos_PA_FX_FAST_REPLY(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_choice(actx, tree, tvb, offset,
+        PA_FX_FAST_REPLY_choice, hf_index, ett_kerberos_PA_FX_FAST_REPLY,
+        NULL);
 
     return offset;
 }
@@ -6635,656 +10545,1653 @@ dissect_kerberos_ETYPE_INFO2(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int o
 
 
 static int
-dissect_kerberos_AD_IF_RELEVANT(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_kerberos_AuthorizationData(implicit_tag, tvb, offset, actx, tree, hf_index);
+dissect_kerberos_T_encryptedChallenge_cipher(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 598 "./asn1/kerberos/kerberos.cnf"
+#ifdef HAVE_KERBEROS
+    offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_index, dissect_krb5_decrypt_EncryptedChallenge);
+#else
+    offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index,
+        NULL);
 
+#endif
     return offset;
-}
 
 
 
-static int
-dissect_kerberos_BOOLEAN(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_boolean(implicit_tag, actx, tree, tvb, offset, hf_index, NULL);
-
     return offset;
 }
 
 
-static const ber_sequence_t PA_PAC_REQUEST_sequence[] = {
-  { &hf_kerberos_include_pac, BER_CLASS_CON, 0, 0, dissect_kerberos_BOOLEAN },
+static const ber_sequence_t EncryptedChallenge_sequence[] = {
+  { &hf_kerberos_etype      , BER_CLASS_CON, 0, 0, dissect_kerberos_ENCTYPE },
+  { &hf_kerberos_kvno       , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
+  { &hf_kerberos_encryptedChallenge_cipher, BER_CLASS_CON, 2, 0, dissect_kerberos_T_encryptedChallenge_cipher },
   { NULL, 0, 0, 0, NULL }
 };
 
+static const ber_schema_t kerberos_schema_EncryptedChallenge = BER_SCHEMA_SEQ(EncryptedChallenge_sequence, ett_kerberos_EncryptedChallenge);
+
 static int
-dissect_kerberos_PA_PAC_REQUEST(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        PA_PAC_REQUEST_sequence, hf_index, ett_kerberos_PA_PAC_REQUEST);
+dissect_kerberos_EncryptedChallenge(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_EncryptedChallenge, hf_index);
 
     return offset;
 }
 
 
+/*--- End of included file: packet-kerberos-fn.c ---*/
+#line 3822 "./asn1/kerberos/packet-kerberos-template.c"
+
+#ifdef HAVE_KERBEROS
+static const ber_sequence_t PA_ENC_TS_ENC_sequence[] = {
+        { &hf_krb_patimestamp, BER_CLASS_CON, 0, 0, dissect_kerberos_KerberosTime },
+        { &hf_krb_pausec     , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_Microseconds },
+        { NULL, 0, 0, 0, NULL }
+};
 
 static int
-dissect_kerberos_GeneralString(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_restricted_string(implicit_tag, BER_UNI_TAG_GeneralString,
-        actx, tree, tvb, offset, hf_index,
-        NULL);
+dissect_kerberos_PA_ENC_TS_ENC(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
+        PA_ENC_TS_ENC_sequence, hf_index, ett_krb_pa_enc_ts_enc);
+    return offset;
+}
+
+static int
+dissect_kerberos_T_strengthen_key(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+#line 491 "./asn1/kerberos/kerberos.cnf"
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    gint save_encryption_key_parent_hf_index = private_data->save_encryption_key_parent_hf_index;
+    kerberos_key_save_fn saved_encryption_key_fn = private_data->save_encryption_key_fn;
+    private_data->save_encryption_key_parent_hf_index = hf_kerberos_KrbFastResponse;
+#ifdef HAVE_KERBEROS
+    private_data->save_encryption_key_fn = save_KrbFastResponse_strengthen_key;
+#endif
+    offset = dissect_kerberos_EncryptionKey(implicit_tag, tvb, offset, actx, tree, hf_index);
 
+    private_data->save_encryption_key_parent_hf_index = save_encryption_key_parent_hf_index;
+    private_data->save_encryption_key_fn = saved_encryption_key_fn;
     return offset;
 }
 
+static const ber_sequence_t KrbFastFinished_sequence[] = {
+  { &hf_kerberos_timestamp  , BER_CLASS_CON, 0, 0, dissect_kerberos_KerberosTime },
+  { &hf_kerberos_usec       , BER_CLASS_CON, 1, 0, dissect_kerberos_Microseconds },
+  { &hf_kerberos_crealm     , BER_CLASS_CON, 2, 0, dissect_kerberos_Realm },
+  { &hf_kerberos_cname_01   , BER_CLASS_CON, 3, 0, dissect_ber_schema_field },
+  { &hf_kerberos_ticket_checksum, BER_CLASS_CON, 4, 0, dissect_kerberos_Checksum },
+  { NULL, 0, 0, 0, NULL }
+};
+
+static const ber_schema_t kerberos_schema_KrbFastFinished = BER_SCHEMA_SEQ(KrbFastFinished_sequence, ett_kerberos_KrbFastFinished);
 
-static const ber_sequence_t PA_S4U2Self_sequence[] = {
-  { &hf_kerberos_name       , BER_CLASS_CON, 0, 0, dissect_kerberos_PrincipalName },
-  { &hf_kerberos_realm      , BER_CLASS_CON, 1, 0, dissect_kerberos_Realm },
-  { &hf_kerberos_cksum      , BER_CLASS_CON, 2, 0, dissect_kerberos_Checksum },
-  { &hf_kerberos_auth       , BER_CLASS_CON, 3, 0, dissect_kerberos_GeneralString },
+static const ber_sequence_t KrbFastResponse_sequence[] = {
+  { &hf_kerberos_padata     , BER_CLASS_CON, 0, 0, dissect_kerberos_SEQUENCE_OF_PA_DATA },
+  { &hf_kerberos_strengthen_key, BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_T_strengthen_key },
+  { &hf_kerberos_finished   , BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_ber_schema_field },
+  { &hf_kerberos_nonce      , BER_CLASS_CON, 3, 0, dissect_kerberos_UInt32 },
   { NULL, 0, 0, 0, NULL }
 };
 
+static const ber_schema_t kerberos_schema_KrbFastResponse = BER_SCHEMA_SEQ(KrbFastResponse_sequence, ett_kerberos_KrbFastResponse);
+
 static int
-dissect_kerberos_PA_S4U2Self(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        PA_S4U2Self_sequence, hf_index, ett_kerberos_PA_S4U2Self);
+dissect_kerberos_KrbFastResponse(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_KrbFastResponse, hf_index);
 
     return offset;
 }
 
+static const ber_sequence_t KrbFastReq_sequence[] = {
+  { &hf_kerberos_fast_options, BER_CLASS_CON, 0, 0, dissect_kerberos_FastOptions },
+  { &hf_kerberos_padata     , BER_CLASS_CON, 1, 0, dissect_kerberos_SEQUENCE_OF_PA_DATA },
+  { &hf_kerberos_req_body   , BER_CLASS_CON, 2, 0, dissect_kerberos_KDC_REQ_BODY },
+  { NULL, 0, 0, 0, NULL }
+};
 
+static const ber_schema_t kerberos_schema_KrbFastReq = BER_SCHEMA_SEQ(KrbFastReq_sequence, ett_kerberos_KrbFastReq);
 
 static int
-dissect_kerberos_T_subject_certificate(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 529 "./asn1/kerberos/kerberos.cnf"
-    offset = dissect_ber_octet_string_wcb(implicit_tag, actx, tree, tvb, offset, hf_index, dissect_x509af_Certificate);
-
-
+dissect_kerberos_KrbFastReq(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_schema(implicit_tag, actx, tree, tvb, offset,
+        &kerberos_schema_KrbFastReq, hf_index);
 
     return offset;
 }
 
-
+static const int* FastOptions_bits[] = {
+  &hf_kerberos_FastOptions_reserved,
+  &hf_kerberos_FastOptions_hide_client_names,
+  &hf_kerberos_FastOptions_spare_bit2,
+  &hf_kerberos_FastOptions_spare_bit3,
+  &hf_kerberos_FastOptions_spare_bit4,
+  &hf_kerberos_FastOptions_spare_bit5,
+  &hf_kerberos_FastOptions_spare_bit6,
+  &hf_kerberos_FastOptions_spare_bit7,
+  &hf_kerberos_FastOptions_spare_bit8,
+  &hf_kerberos_FastOptions_spare_bit9,
+  &hf_kerberos_FastOptions_spare_bit10,
+  &hf_kerberos_FastOptions_spare_bit11,
+  &hf_kerberos_FastOptions_spare_bit12,
+  &hf_kerberos_FastOptions_spare_bit13,
+  &hf_kerberos_FastOptions_spare_bit14,
+  &hf_kerberos_FastOptions_spare_bit15,
+  &hf_kerberos_FastOptions_kdc_follow_referrals,
+  NULL
+};
 
 static int
-dissect_kerberos_BIT_STRING(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+dissect_kerberos_FastOptions(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
     offset = dissect_ber_bitstring(implicit_tag, actx, tree, tvb, offset,
-        NULL, 0, hf_index, -1,
+        FastOptions_bits, 17, hf_index, ett_kerberos_FastOptions,
         NULL);
 
     return offset;
 }
 
+#endif /* HAVE_KERBEROS */
 
-static const ber_sequence_t S4UUserID_sequence[] = {
-  { &hf_kerberos_nonce      , BER_CLASS_CON, 0, 0, dissect_kerberos_UInt32 },
-  { &hf_kerberos_cname_01   , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_PrincipalName },
-  { &hf_kerberos_crealm     , BER_CLASS_CON, 2, 0, dissect_kerberos_Realm },
-  { &hf_kerberos_subject_certificate, BER_CLASS_CON, 3, BER_FLAGS_OPTIONAL, dissect_kerberos_T_subject_certificate },
-  { &hf_kerberos_options    , BER_CLASS_CON, 4, BER_FLAGS_OPTIONAL, dissect_kerberos_BIT_STRING },
-  { NULL, 0, 0, 0, NULL }
+/* The type behind each field that dissect_ber_schema_field() stands for */
+static const ber_schema_hf_t kerberos_schema_fields[] = {
+    { &hf_kerberos_sname_string, &kerberos_schema_SEQUENCE_OF_SNameString },
+    { &hf_kerberos_ticket_enc_part, &kerberos_schema_EncryptedTicketData },
+    { &hf_kerberos_cname_string, &kerberos_schema_SEQUENCE_OF_CNameString },
+    { &hf_kerberos_AuthorizationData_item, &kerberos_schema_AuthorizationData_item },
+    { &hf_kerberos_transited, &kerberos_schema_TransitedEncoding },
+    { &hf_kerberos_HostAddresses_item, &kerberos_schema_HostAddress },
+    { &hf_kerberos_s_address, &kerberos_schema_HostAddress },
+    { &hf_kerberos_r_address, &kerberos_schema_HostAddress },
+    { &hf_kerberos_caddr, &kerberos_schema_HostAddresses },
+    { &hf_kerberos_addresses, &kerberos_schema_HostAddresses },
+    { &hf_kerberos_enc_authorization_data, &kerberos_schema_EncryptedAuthorizationData },
+    { &hf_kerberos_additional_tickets, &kerberos_schema_SEQUENCE_OF_Ticket },
+    { &hf_kerberos_tickets, &kerberos_schema_SEQUENCE_OF_Ticket },
+    { &hf_kerberos_kDC_REP_enc_part, &kerberos_schema_EncryptedKDCREPData },
+    { &hf_kerberos_authenticator_enc_part, &kerberos_schema_EncryptedAuthenticator },
+    { &hf_kerberos_aP_REP_enc_part, &kerberos_schema_EncryptedAPREPData },
+    { &hf_kerberos_safe_body, &kerberos_schema_KRB_SAFE_BODY },
+    { &hf_kerberos_kRB_PRIV_enc_part, &kerberos_schema_EncryptedKrbPrivData },
+    { &hf_kerberos_kRB_CRED_enc_part, &kerberos_schema_EncryptedKrbCredData },
+    { &hf_kerberos_LastReq_item, &kerberos_schema_LastReq_item },
+    { &hf_kerberos_last_req, &kerberos_schema_LastReq },
+    { &hf_kerberos_name_string, &kerberos_schema_SEQUENCE_OF_KerberosString },
+    { &hf_kerberos_pname, &kerberos_schema_PrincipalName },
+    { &hf_kerberos_name, &kerberos_schema_PrincipalName },
+    { &hf_kerberos_cname_01, &kerberos_schema_PrincipalName },
+    { &hf_kerberos_targname, &kerberos_schema_PrincipalName },
+    { &hf_kerberos_ticket_info_item, &kerberos_schema_KrbCredInfo },
+    { &hf_kerberos_ticket_info, &kerberos_schema_SEQUENCE_OF_KrbCredInfo },
+    { &hf_kerberos_ETYPE_INFO_item, &kerberos_schema_ETYPE_INFO_ENTRY },
+    { &hf_kerberos_ETYPE_INFO2_item, &kerberos_schema_ETYPE_INFO2_ENTRY },
+    { &hf_kerberos_user_id, &kerberos_schema_S4UUserID },
+    { &hf_kerberos_armor, &kerberos_schema_KrbFastArmor },
+    { &hf_kerberos_enc_fast_req, &kerberos_schema_EncryptedKrbFastReq },
+    { &hf_kerberos_enc_fast_rep, &kerberos_schema_EncryptedKrbFastResponse },
+#ifdef HAVE_KERBEROS
+    { &hf_kerberos_finished, &kerberos_schema_KrbFastFinished },
+#endif
 };
 
-static int
-dissect_kerberos_S4UUserID(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        S4UUserID_sequence, hf_index, ett_kerberos_S4UUserID);
+/* Make wrappers around exported functions for now */
+int
+dissect_krb5_Checksum(proto_tree* tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx _U_)
+{
+    return dissect_kerberos_Checksum(FALSE, tvb, offset, actx, tree, hf_kerberos_cksum);
 
-    return offset;
 }
 
+int
+dissect_krb5_ctime(proto_tree* tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx _U_)
+{
+    return dissect_kerberos_KerberosTime(FALSE, tvb, offset, actx, tree, hf_kerberos_ctime);
+}
 
-static const ber_sequence_t PA_S4U_X509_USER_sequence[] = {
-  { &hf_kerberos_user_id    , BER_CLASS_CON, 0, 0, dissect_kerberos_S4UUserID },
-  { &hf_kerberos_checksum_01, BER_CLASS_CON, 1, 0, dissect_kerberos_Checksum },
-  { NULL, 0, 0, 0, NULL }
-};
+/* The replyKey of a PKINIT ReplyKeyPack (RFC 4556 3.2.3.2), reached once
+ * the encKeyPack has been decrypted; it protects the enc-part of the
+ * AS-REP, so it is learnt like the key of an EncKDCRepPart.
+ */
+int
+dissect_krb5_reply_key(proto_tree* tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx, int parent_hf_index, int hf_index)
+{
+    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
+    gint save_encryption_key_parent_hf_index = private_data->save_encryption_key_parent_hf_index;
+    kerberos_key_save_fn saved_encryption_key_fn = private_data->save_encryption_key_fn;
+    private_data->save_encryption_key_parent_hf_index = parent_hf_index;
+#ifdef HAVE_KERBEROS
+    private_data->save_encryption_key_fn = save_ReplyKeyPack_replyKey;
+#endif
+    offset = dissect_kerberos_EncryptionKey(FALSE, tvb, offset, actx, tree, hf_index);
 
-static int
-dissect_kerberos_PA_S4U_X509_USER(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        PA_S4U_X509_USER_sequence, hf_index, ett_kerberos_PA_S4U_X509_USER);
+    private_data->save_encryption_key_parent_hf_index = save_encryption_key_parent_hf_index;
+    private_data->save_encryption_key_fn = saved_encryption_key_fn;
 
     return offset;
 }
 
 
-static const int* PAC_OPTIONS_FLAGS_bits[] = {
-  &hf_kerberos_PAC_OPTIONS_FLAGS_claims,
-  &hf_kerberos_PAC_OPTIONS_FLAGS_branch_aware,
-  &hf_kerberos_PAC_OPTIONS_FLAGS_forward_to_full_dc,
-  &hf_kerberos_PAC_OPTIONS_FLAGS_resource_based_constrained_delegation,
-  NULL
+int
+dissect_krb5_cname(proto_tree* tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx _U_)
+{
+    return dissect_ber_schema(FALSE, actx, tree, tvb, offset, &kerberos_schema_PrincipalName, hf_kerberos_cname);
+}
+int
+dissect_krb5_realm(proto_tree* tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx _U_)
+{
+    return dissect_kerberos_Realm(FALSE, tvb, offset, actx, tree, hf_kerberos_realm);
+}
+
+struct kerberos_display_key_state {
+    proto_tree* tree;
+    packet_info* pinfo;
+    expert_field* expindex;
+    const char* name;
+    tvbuff_t* tvb;
+    gint start;
+    gint length;
 };
 
-static int
-dissect_kerberos_PAC_OPTIONS_FLAGS(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_bitstring(implicit_tag, actx, tree, tvb, offset,
-        PAC_OPTIONS_FLAGS_bits, 4, hf_index, ett_kerberos_PAC_OPTIONS_FLAGS,
-        NULL);
+static void
+#ifdef HAVE_KERBEROS
+kerberos_display_key(gpointer data, gpointer userdata)
+#else
+kerberos_display_key(gpointer data _U_, gpointer userdata _U_)
+#endif
+{
+#ifdef HAVE_KERBEROS
+    struct kerberos_display_key_state* state =
+        (struct kerberos_display_key_state*)userdata;
+    const enc_key_t* ek = (const enc_key_t*)data;
+    proto_item* item = NULL;
+    enc_key_t* sek = NULL;
 
-    return offset;
+    item = proto_tree_add_expert_format(state->tree,
+        state->pinfo,
+        state->expindex,
+        state->tvb,
+        state->start,
+        state->length,
+        "%s %s keytype %d (id=%s same=%u) (%02x%02x%02x%02x...)",
+        state->name,
+        ek->key_origin, ek->keytype,
+        ek->id_str, ek->num_same,
+        ek->keyvalue[0] & 0xFF, ek->keyvalue[1] & 0xFF,
+        ek->keyvalue[2] & 0xFF, ek->keyvalue[3] & 0xFF);
+    if (ek->src1 != NULL) {
+        sek = ek->src1;
+        expert_add_info_format(state->pinfo,
+            item,
+            state->expindex,
+            "SRC1 %s keytype %d (id=%s same=%u) (%02x%02x%02x%02x...)",
+            sek->key_origin, sek->keytype,
+            sek->id_str, sek->num_same,
+            sek->keyvalue[0] & 0xFF, sek->keyvalue[1] & 0xFF,
+            sek->keyvalue[2] & 0xFF, sek->keyvalue[3] & 0xFF);
+    }
+    if (ek->src2 != NULL) {
+        sek = ek->src2;
+        expert_add_info_format(state->pinfo,
+            item,
+            state->expindex,
+            "SRC2 %s keytype %d (id=%s same=%u) (%02x%02x%02x%02x...)",
+            sek->key_origin, sek->keytype,
+            sek->id_str, sek->num_same,
+            sek->keyvalue[0] & 0xFF, sek->keyvalue[1] & 0xFF,
+            sek->keyvalue[2] & 0xFF, sek->keyvalue[3] & 0xFF);
+    }
+    sek = ek->same_list;
+    while (sek != NULL) {
+        expert_add_info_format(state->pinfo,
+            item,
+            state->expindex,
+            "%s %s keytype %d (id=%s same=%u) (%02x%02x%02x%02x...)",
+            state->name,
+            sek->key_origin, sek->keytype,
+            sek->id_str, sek->num_same,
+            sek->keyvalue[0] & 0xFF, sek->keyvalue[1] & 0xFF,
+            sek->keyvalue[2] & 0xFF, sek->keyvalue[3] & 0xFF);
+        sek = sek->same_list;
+    }
+#endif /* HAVE_KERBEROS */
 }
 
-
-static const ber_sequence_t PA_PAC_OPTIONS_sequence[] = {
-  { &hf_kerberos_flags_01   , BER_CLASS_CON, 0, 0, dissect_kerberos_PAC_OPTIONS_FLAGS },
-  { NULL, 0, 0, 0, NULL }
-};
-
+/*
+ * Tree-less walks over the outer message structures, for the shard plan
+ * and sampling. Anything unexpected gives -1, or "?" for the strings.
+ */
+/* Open the TLV at offset, which must be ber_class/tag and end by end;
+ * returns the offset of its contents and sets *tlv_end, or -1.
+ */
 static int
-dissect_kerberos_PA_PAC_OPTIONS(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        PA_PAC_OPTIONS_sequence, hf_index, ett_kerberos_PA_PAC_OPTIONS);
+kerberos_outer_open(tvbuff_t* tvb, int offset, int end, gint8 want_class, gint32 want_tag, int* tlv_end)
+{
+    gint8 ber_class;
+    gboolean pc;
+    gint32 tag;
+    guint32 len;
+    int contents;
 
-    return offset;
+    if (offset < 0 || offset >= end) {
+        return -1;
+    }
+    contents = try_get_ber_tl(tvb, offset, &ber_class, &pc, &tag, &len);
+    if (contents < 0 || len > (guint32)(end - contents) || ber_class != want_class || tag != want_tag) {
+        return -1;
+    }
+    *tlv_end = contents + len;
+    return contents;
 }
 
-
-static const ber_sequence_t KERB_AD_RESTRICTION_ENTRY_U_sequence[] = {
-  { &hf_kerberos_restriction_type, BER_CLASS_CON, 0, 0, dissect_kerberos_Int32 },
-  { &hf_kerberos_restriction, BER_CLASS_CON, 1, 0, dissect_kerberos_OCTET_STRING },
-  { NULL, 0, 0, 0, NULL }
-};
-
+/* The [tag] field among the SEQUENCE contents from offset to end;
+ * returns the offset of the element it wraps and sets *field_end, or -1.
+ */
 static int
-dissect_kerberos_KERB_AD_RESTRICTION_ENTRY_U(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        KERB_AD_RESTRICTION_ENTRY_U_sequence, hf_index, ett_kerberos_KERB_AD_RESTRICTION_ENTRY_U);
+kerberos_outer_field(tvbuff_t* tvb, int offset, int end, gint32 want_tag, int* field_end)
+{
+    gint8 ber_class;
+    gboolean pc;
+    gint32 tag;
+    guint32 len;
+    int contents;
 
-    return offset;
+    if (offset < 0) {
+        return -1;
+    }
+    while (offset < end) {
+        contents = try_get_ber_tl(tvb, offset, &ber_class, &pc, &tag, &len);
+        if (contents < 0 || len > (guint32)(end - contents)) {
+            return -1;
+        }
+        if (ber_class == BER_CLASS_CON && tag == want_tag) {
+            *field_end = contents + len;
+            return contents;
+        }
+        offset = contents + len;
+    }
+    return -1;
 }
 
+/* A GeneralString field, or "?" */
+static const char*
+kerberos_outer_string(tvbuff_t* tvb, int offset, int end, gint32 want_tag)
+{
+    int field_end, string_end;
 
-
-static int
-dissect_kerberos_KERB_AD_RESTRICTION_ENTRY(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_tagged_type(implicit_tag, actx, tree, tvb, offset,
-        hf_index, BER_CLASS_UNI, 16, FALSE, dissect_kerberos_KERB_AD_RESTRICTION_ENTRY_U);
-
-    return offset;
+    offset = kerberos_outer_field(tvb, offset, end, want_tag, &field_end);
+    offset = kerberos_outer_open(tvb, offset, field_end, BER_CLASS_UNI, BER_UNI_TAG_GeneralString, &string_end);
+    if (offset < 0) {
+        return "?";
+    }
+    return tvb_get_string_enc(wmem_packet_scope(), tvb, offset, string_end - offset, ENC_ASCII);
 }
 
-
-static const ber_sequence_t ChangePasswdData_sequence[] = {
-  { &hf_kerberos_newpasswd  , BER_CLASS_CON, 0, 0, dissect_kerberos_OCTET_STRING },
-  { &hf_kerberos_targname   , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_PrincipalName },
-  { &hf_kerberos_targrealm  , BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_kerberos_Realm },
-  { NULL, 0, 0, 0, NULL }
-};
-
-int
-dissect_kerberos_ChangePasswdData(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        ChangePasswdData_sequence, hf_index, ett_kerberos_ChangePasswdData);
-
-    return offset;
+/* A PrincipalName field as "a/b", or "?" */
+static const char*
+kerberos_outer_principal(tvbuff_t* tvb, int offset, int end, gint32 want_tag)
+{
+    wmem_strbuf_t* name;
+    int field_end, seq_end, strings_end, string_end;
+    int contents;
+
+    offset = kerberos_outer_field(tvb, offset, end, want_tag, &field_end);
+    offset = kerberos_outer_open(tvb, offset, field_end, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, &seq_end);
+    offset = kerberos_outer_field(tvb, offset, seq_end, 1, &field_end);
+    offset = kerberos_outer_open(tvb, offset, field_end, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, &strings_end);
+    if (offset < 0) {
+        return "?";
+    }
+    name = wmem_strbuf_new(wmem_packet_scope(), "");
+    while (offset < strings_end) {
+        contents = kerberos_outer_open(tvb, offset, strings_end, BER_CLASS_UNI, BER_UNI_TAG_GeneralString, &string_end);
+        if (contents < 0) {
+            break;
+        }
+        if (wmem_strbuf_get_len(name)) {
+            wmem_strbuf_append_c(name, '/');
+        }
+        wmem_strbuf_append(name, tvb_get_string_enc(wmem_packet_scope(), tvb, contents,
+            string_end - contents, ENC_ASCII));
+        offset = string_end;
+    }
+    return wmem_strbuf_get_str(name);
 }
 
-
-static const ber_sequence_t PA_AUTHENTICATION_SET_ELEM_sequence[] = {
-  { &hf_kerberos_pa_type    , BER_CLASS_CON, 0, 0, dissect_kerberos_PADATA_TYPE },
-  { &hf_kerberos_pa_hint    , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_OCTET_STRING },
-  { &hf_kerberos_pa_value   , BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_kerberos_OCTET_STRING },
-  { NULL, 0, 0, 0, NULL }
+/*
+ * Shard plan (kerberos.shard_plan): a pre-pass for spreading a large
+ * capture over several machines without breaking decryption. While it
+ * is set, each message is read only down to its outer structures, with
+ * no decryption and no tree below the message type, and the dissector
+ * notes which earlier frames it needs keys from:
+ *   - a presented ticket (AP-REQ, PA-TGS-REQ, additional tickets) needs
+ *     the AS-REP, TGS-REP or KRB-CRED that issued it, matched on a digest
+ *     of the ticket's cipher;
+ *   - a reply or KRB-ERROR needs its request, matched on the address/port
+ *     pair as for the exchange log;
+ *   - KRB-SAFE, KRB-PRIV and KRB-CRED need the last AP exchange on their
+ *     connection.
+ * A message reassembled from several TCP segments stands for all of its
+ * frames, first segment to last, wherever it is needed.
+ * When the file is closed the capture is cut into shards of about
+ * shard_size frames, each boundary moved forward until no reassembled
+ * message straddles it, and the plan is written as text, one item per
+ * line:
+ *   shard <n> <first>-<last> preload <frames>
+ *       the frames of other shards that shard n needs, directly or not;
+ *       with them added (editcap -r takes the ranges as written) the shard
+ *       decrypts on its own. The last shard's range is open-ended.
+ *   key <n> <frames> ticket|exchange|connection <what>
+ *       the cross-shard dependencies behind the preload list
+ *   external <n> <sname@realm>
+ *       tickets used in shard n but issued before the capture started;
+ *       their keys have to come from the keytab
+ *   connection <tuple> <frames>
+ *       the last AP exchange on each connection and what it needs, for
+ *       whatever application traffic on that connection ends up in a
+ *       later shard
+ */
+enum {
+    KRB_SHARD_TICKET,
+    KRB_SHARD_EXCHANGE,
+    KRB_SHARD_CONNECTION
 };
 
-static int
-dissect_kerberos_PA_AUTHENTICATION_SET_ELEM(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        PA_AUTHENTICATION_SET_ELEM_sequence, hf_index, ett_kerberos_PA_AUTHENTICATION_SET_ELEM);
-
-    return offset;
-}
+static const char* const kerberos_shard_kinds[] = { "ticket", "exchange", "connection" };
 
+typedef struct {
+    guint32 frame;          /* 0: not in the capture */
+    guint kind;
+    const char* what;
+} kerberos_shard_need_t;
 
-static const value_string kerberos_KrbFastArmorTypes_vals[] = {
-  { KERBEROS_FX_FAST_RESERVED, "fX-FAST-reserved" },
-  { KERBEROS_FX_FAST_ARMOR_AP_REQUEST, "fX-FAST-ARMOR-AP-REQUEST" },
-  { 0, NULL }
-};
+/* A frame's needs are contiguous in kerberos_shard_needs: they are only
+ * ever added to the latest frame */
+typedef struct {
+    guint32 frame;
+    guint first_need;
+    guint num_needs;
+} kerberos_shard_msg_t;
 
+typedef struct {
+    guint64 digest;
+    guint32 frame;
+    const char* what;
+} kerberos_shard_ticket_t;
 
-static int
-dissect_kerberos_KrbFastArmorTypes(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 606 "./asn1/kerberos/kerberos.cnf"
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-    offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
-        &(private_data->fast_type));
+/* The frames of a message reassembled from several TCP segments */
+typedef struct {
+    guint32 first;
+    guint32 last;
+} kerberos_shard_span_t;
+
+static const char* kerberos_shard_filename = "";
+static guint kerberos_shard_size = 1000000;
+static guint32 kerberos_shard_last_frame = 0;
+static GArray* kerberos_shard_msgs = NULL;            /* kerberos_shard_msg_t, by frame */
+static GArray* kerberos_shard_needs = NULL;           /* kerberos_shard_need_t */
+static GHashTable* kerberos_shard_tickets = NULL;     /* digest -> kerberos_shard_ticket_t* */
+static GHashTable* kerberos_shard_requests = NULL;    /* "src>dst" -> request frame */
+static GHashTable* kerberos_shard_connections = NULL; /* tuple -> last AP-REQ/AP-REP frame */
+static GStringChunk* kerberos_shard_strings = NULL;
+static GHashTable* kerberos_shard_interned = NULL;    /* the strings in kerberos_shard_strings */
+static guint64 kerberos_shard_string_bytes = 0;
+static GArray* kerberos_shard_spans = NULL;           /* kerberos_shard_span_t, by last frame */
+static guint32 kerberos_shard_max_span = 0;           /* longest span, in frames */
+/* First segment of the TCP message being dissected, 0 if it was not reassembled */
+static guint32 kerberos_shard_pdu_first = 0;
 
+static void
+kerberos_mem_shards(guint* count, guint64* bytes)
+{
+    guint msgs = kerberos_shard_msgs ? kerberos_shard_msgs->len : 0;
+    guint needs = kerberos_shard_needs ? kerberos_shard_needs->len : 0;
+    guint tickets = kerberos_shard_tickets ? g_hash_table_size(kerberos_shard_tickets) : 0;
+    guint pairs = kerberos_shard_requests ?
+        g_hash_table_size(kerberos_shard_requests) + g_hash_table_size(kerberos_shard_connections) : 0;
+    guint strings = kerberos_shard_interned ? g_hash_table_size(kerberos_shard_interned) : 0;
+    guint spans = kerberos_shard_spans ? kerberos_shard_spans->len : 0;
+
+    *count = msgs + needs + tickets + pairs + strings + spans;
+    *bytes = (guint64)msgs * sizeof(kerberos_shard_msg_t) +
+        (guint64)needs * sizeof(kerberos_shard_need_t) +
+        (guint64)tickets * (sizeof(kerberos_shard_ticket_t) + BER_MEM_MAP_ENTRY) +
+        (guint64)pairs * BER_MEM_MAP_ENTRY +
+        (guint64)strings * BER_MEM_MAP_ENTRY + kerberos_shard_string_bytes +
+        (guint64)spans * sizeof(kerberos_shard_span_t);
+}
+
+/* g_string_chunk_insert_const(), but counting what the chunk holds */
+static const char*
+kerberos_shard_intern(const char* str)
+{
+    char* interned = (char*)g_hash_table_lookup(kerberos_shard_interned, str);
 
+    if (interned == NULL) {
+        interned = g_string_chunk_insert(kerberos_shard_strings, str);
+        g_hash_table_add(kerberos_shard_interned, interned);
+        kerberos_shard_string_bytes += strlen(str) + 1;
+    }
+    return interned;
+}
 
+/* Note that the message ending in this frame started in an earlier one */
+static void
+kerberos_shard_span(packet_info* pinfo, guint32 first)
+{
+    kerberos_shard_span_t* span = NULL;
+    guint len = kerberos_shard_spans->len;
 
-    return offset;
+    if (len > 0) {
+        span = &g_array_index(kerberos_shard_spans, kerberos_shard_span_t, len - 1);
+    }
+    /* several messages ending in one frame share an entry */
+    if (span == NULL || span->last != pinfo->num) {
+        g_array_set_size(kerberos_shard_spans, len + 1);
+        span = &g_array_index(kerberos_shard_spans, kerberos_shard_span_t, len);
+        span->first = first;
+        span->last = pinfo->num;
+    } else {
+        span->first = MIN(span->first, first);
+    }
+    kerberos_shard_max_span = MAX(kerberos_shard_max_span, span->last - span->first);
 }
 
+/* Note that this frame needs the keys of an earlier one */
+static void
+kerberos_shard_need(packet_info* pinfo, guint32 frame, guint kind, const char* what)
+{
+    kerberos_shard_msg_t* msg = NULL;
+    kerberos_shard_need_t need;
+    guint len = kerberos_shard_msgs->len;
 
+    if (frame == pinfo->num) {
+        return;
+    }
+    if (len > 0) {
+        msg = &g_array_index(kerberos_shard_msgs, kerberos_shard_msg_t, len - 1);
+    }
+    /* several messages in one frame share an entry */
+    if (msg == NULL || msg->frame != pinfo->num) {
+        g_array_set_size(kerberos_shard_msgs, len + 1);
+        msg = &g_array_index(kerberos_shard_msgs, kerberos_shard_msg_t, len);
+        msg->frame = pinfo->num;
+        msg->first_need = kerberos_shard_needs->len;
+    }
+    need.frame = frame;
+    need.kind = kind;
+    need.what = what;
+    g_array_append_val(kerberos_shard_needs, need);
+    msg->num_needs++;
+}
 
-static int
-dissect_kerberos_T_armor_value(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 610 "./asn1/kerberos/kerberos.cnf"
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-
-    switch (private_data->fast_type) {
-    case KERBEROS_FX_FAST_ARMOR_AP_REQUEST:
-        private_data->fast_armor_within_armor_value++;
-        offset = dissect_ber_octet_string_wcb(implicit_tag, actx, tree, tvb, offset, hf_index, dissect_kerberos_Applications);
-        private_data->fast_armor_within_armor_value--;
-        break;
-    default:
-        offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index, NULL);
-        break;
+/* The Ticket at offset: a digest of its cipher and "sname@realm" */
+static gboolean
+kerberos_shard_ticket(tvbuff_t* tvb, int offset, int end, guint64* digest, const char** what)
+{
+    guint8 hash[HASH_SHA2_256_LENGTH];
+    int ticket_end, seq, seq_end, enc, enc_end, cipher, cipher_end;
+
+    offset = kerberos_outer_open(tvb, offset, end, BER_CLASS_APP, KRB5_MSG_TICKET, &ticket_end);
+    seq = kerberos_outer_open(tvb, offset, ticket_end, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, &seq_end);
+    enc = kerberos_outer_field(tvb, seq, seq_end, 3, &enc_end);
+    enc = kerberos_outer_open(tvb, enc, enc_end, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, &enc_end);
+    cipher = kerberos_outer_field(tvb, enc, enc_end, 2, &cipher_end);
+    cipher = kerberos_outer_open(tvb, cipher, cipher_end, BER_CLASS_UNI, BER_UNI_TAG_OCTETSTRING, &cipher_end);
+    if (cipher < 0) {
+        return FALSE;
     }
+    gcry_md_hash_buffer(GCRY_MD_SHA256, hash, tvb_get_ptr(tvb, cipher, cipher_end - cipher), cipher_end - cipher);
+    memcpy(digest, hash, sizeof(*digest));
+    *what = wmem_strdup_printf(wmem_packet_scope(), "%s@%s",
+        kerberos_outer_principal(tvb, seq, seq_end, 2), kerberos_outer_string(tvb, seq, seq_end, 1));
+    return TRUE;
+}
 
+static void
+kerberos_shard_issued(packet_info* pinfo, tvbuff_t* tvb, int offset, int end, const char* client)
+{
+    kerberos_shard_ticket_t* ticket;
+    guint64 digest;
+    const char* what;
 
-    return offset;
+    if (!kerberos_shard_ticket(tvb, offset, end, &digest, &what)) {
+        return;
+    }
+    ticket = g_new(kerberos_shard_ticket_t, 1);
+    ticket->digest = digest;
+    ticket->frame = pinfo->num;
+    ticket->what = kerberos_shard_intern(client ?
+        wmem_strdup_printf(wmem_packet_scope(), "%s for %s", what, client) : what);
+    g_hash_table_replace(kerberos_shard_tickets, &ticket->digest, ticket);
 }
 
+static void
+kerberos_shard_presented(packet_info* pinfo, tvbuff_t* tvb, int offset, int end)
+{
+    kerberos_shard_ticket_t* ticket;
+    guint64 digest;
+    const char* what;
 
-static const ber_sequence_t KrbFastArmor_sequence[] = {
-  { &hf_kerberos_armor_type , BER_CLASS_CON, 0, 0, dissect_kerberos_KrbFastArmorTypes },
-  { &hf_kerberos_armor_value, BER_CLASS_CON, 1, 0, dissect_kerberos_T_armor_value },
-  { NULL, 0, 0, 0, NULL }
-};
+    if (!kerberos_shard_ticket(tvb, offset, end, &digest, &what)) {
+        return;
+    }
+    ticket = (kerberos_shard_ticket_t*)g_hash_table_lookup(kerberos_shard_tickets, &digest);
+    if (ticket != NULL) {
+        kerberos_shard_need(pinfo, ticket->frame, KRB_SHARD_TICKET, ticket->what);
+    } else {
+        kerberos_shard_need(pinfo, 0, KRB_SHARD_TICKET, kerberos_shard_intern(what));
+    }
+}
 
-static int
-dissect_kerberos_KrbFastArmor(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        KrbFastArmor_sequence, hf_index, ett_kerberos_KrbFastArmor);
+/* Each Ticket of a SEQUENCE OF Ticket field */
+static void
+kerberos_shard_tickets_in(packet_info* pinfo, tvbuff_t* tvb, int offset, int end, gint32 want_tag, gboolean issued)
+{
+    gint8 ber_class;
+    gboolean pc;
+    gint32 tag;
+    guint32 len;
+    int field_end, seq_end, contents;
 
-    return offset;
+    offset = kerberos_outer_field(tvb, offset, end, want_tag, &field_end);
+    offset = kerberos_outer_open(tvb, offset, field_end, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, &seq_end);
+    while (offset >= 0 && offset < seq_end) {
+        contents = try_get_ber_tl(tvb, offset, &ber_class, &pc, &tag, &len);
+        if (contents < 0 || len > (guint32)(seq_end - contents)) {
+            return;
+        }
+        if (issued) {
+            kerberos_shard_issued(pinfo, tvb, offset, contents + len, NULL);
+        } else {
+            kerberos_shard_presented(pinfo, tvb, offset, contents + len);
+        }
+        offset = contents + len;
+    }
 }
 
+/* The ticket of the AP-REQ at offset */
+static void
+kerberos_shard_ap_req(packet_info* pinfo, tvbuff_t* tvb, int offset, int end)
+{
+    int ap_end, seq_end, field_end;
 
+    offset = kerberos_outer_open(tvb, offset, end, BER_CLASS_APP, KRB5_MSG_AP_REQ, &ap_end);
+    offset = kerberos_outer_open(tvb, offset, ap_end, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, &seq_end);
+    offset = kerberos_outer_field(tvb, offset, seq_end, 3, &field_end);
+    if (offset >= 0) {
+        kerberos_shard_presented(pinfo, tvb, offset, field_end);
+    }
+}
 
-static int
-dissect_kerberos_T_encryptedKrbFastReq_cipher(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 582 "./asn1/kerberos/kerberos.cnf"
-#ifdef HAVE_KERBEROS
-    offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_index, dissect_krb5_decrypt_KrbFastReq);
-#else
-    offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index,
-        NULL);
-
-#endif
-    return offset;
+/* The AP-REQ in a PA-TGS-REQ among the padata */
+static void
+kerberos_shard_padata(packet_info* pinfo, tvbuff_t* tvb, int offset, int end)
+{
+    int field_end, seq_end, pa, pa_end, type, type_end, value, value_end;
 
+    offset = kerberos_outer_field(tvb, offset, end, 3, &field_end);
+    offset = kerberos_outer_open(tvb, offset, field_end, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, &seq_end);
+    while (offset >= 0 && offset < seq_end) {
+        pa = kerberos_outer_open(tvb, offset, seq_end, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, &pa_end);
+        if (pa < 0) {
+            return;
+        }
+        type = kerberos_outer_field(tvb, pa, pa_end, 1, &type_end);
+        type = kerberos_outer_open(tvb, type, type_end, BER_CLASS_UNI, BER_UNI_TAG_INTEGER, &type_end);
+        if (type >= 0 && type_end - type == 1 && tvb_get_guint8(tvb, type) == KERBEROS_PA_TGS_REQ) {
+            value = kerberos_outer_field(tvb, pa, pa_end, 2, &value_end);
+            value = kerberos_outer_open(tvb, value, value_end, BER_CLASS_UNI, BER_UNI_TAG_OCTETSTRING, &value_end);
+            kerberos_shard_ap_req(pinfo, tvb, value, value_end);
+        }
+        offset = pa_end;
+    }
+}
 
+static const char*
+kerberos_shard_connection(packet_info* pinfo)
+{
+    char* fwd = kerberos_log_pair_key(&pinfo->src, pinfo->srcport, &pinfo->dst, pinfo->destport);
+    char* rev = kerberos_log_pair_key(&pinfo->dst, pinfo->destport, &pinfo->src, pinfo->srcport);
 
-    return offset;
+    return kerberos_shard_intern(strcmp(fwd, rev) < 0 ? fwd : rev);
 }
 
+static void
+kerberos_shard_message(tvbuff_t* tvb, packet_info* pinfo, int offset)
+{
+    gint8 ber_class;
+    gboolean pc;
+    gint32 msg_type;
+    guint32 len;
+    int contents, end, seq, seq_end, body, body_end, field, field_end;
+    const char* key;
+    gpointer frame;
+    guint32 pdu_first = kerberos_shard_pdu_first;
+
+    /* one message per TCP PDU */
+    kerberos_shard_pdu_first = 0;
+    contents = try_get_ber_tl(tvb, offset, &ber_class, &pc, &msg_type, &len);
+    if (contents < 0 || ber_class != BER_CLASS_APP) {
+        return;
+    }
+    end = contents + len;
+    seq = kerberos_outer_open(tvb, contents, end, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, &seq_end);
+    if (seq < 0) {
+        return;
+    }
+    if (kerberos_shard_msgs == NULL) {
+        kerberos_shard_msgs = g_array_new(FALSE, TRUE, sizeof(kerberos_shard_msg_t));
+        kerberos_shard_needs = g_array_new(FALSE, FALSE, sizeof(kerberos_shard_need_t));
+        kerberos_shard_tickets = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, g_free);
+        kerberos_shard_requests = g_hash_table_new(g_str_hash, g_str_equal);
+        kerberos_shard_connections = g_hash_table_new(g_str_hash, g_str_equal);
+        kerberos_shard_strings = g_string_chunk_new(4096);
+        kerberos_shard_interned = g_hash_table_new(g_str_hash, g_str_equal);
+        kerberos_shard_spans = g_array_new(FALSE, FALSE, sizeof(kerberos_shard_span_t));
+    }
+    kerberos_shard_last_frame = MAX(kerberos_shard_last_frame, pinfo->num);
+    if (pdu_first != 0 && pdu_first < pinfo->num) {
+        kerberos_shard_span(pinfo, pdu_first);
+    }
+
+    switch (msg_type) {
+    case KRB5_MSG_AS_REQ:
+    case KRB5_MSG_TGS_REQ:
+    case KRB5_MSG_AP_REQ:
+        key = kerberos_shard_intern(kerberos_log_pair_key(&pinfo->src, pinfo->srcport, &pinfo->dst, pinfo->destport));
+        g_hash_table_insert(kerberos_shard_requests, (gpointer)key, GUINT_TO_POINTER(pinfo->num));
+        break;
 
-static const ber_sequence_t EncryptedKrbFastReq_sequence[] = {
-  { &hf_kerberos_etype      , BER_CLASS_CON, 0, 0, dissect_kerberos_ENCTYPE },
-  { &hf_kerberos_kvno       , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
-  { &hf_kerberos_encryptedKrbFastReq_cipher, BER_CLASS_CON, 2, 0, dissect_kerberos_T_encryptedKrbFastReq_cipher },
-  { NULL, 0, 0, 0, NULL }
-};
+    case KRB5_MSG_AS_REP:
+    case KRB5_MSG_TGS_REP:
+    case KRB5_MSG_AP_REP:
+    case KRB5_MSG_ERROR:
+        key = kerberos_shard_intern(kerberos_log_pair_key(&pinfo->dst, pinfo->destport, &pinfo->src, pinfo->srcport));
+        frame = g_hash_table_lookup(kerberos_shard_requests, key);
+        if (frame != NULL) {
+            kerberos_shard_need(pinfo, GPOINTER_TO_UINT(frame), KRB_SHARD_EXCHANGE, key);
+            /* answered; the key stays in kerberos_shard_strings */
+            g_hash_table_remove(kerberos_shard_requests, key);
+        }
+        break;
 
-static int
-dissect_kerberos_EncryptedKrbFastReq(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        EncryptedKrbFastReq_sequence, hf_index, ett_kerberos_EncryptedKrbFastReq);
+    case KRB5_MSG_SAFE:
+    case KRB5_MSG_PRIV:
+    case KRB5_MSG_CRED:
+        key = kerberos_shard_connection(pinfo);
+        frame = g_hash_table_lookup(kerberos_shard_connections, key);
+        if (frame != NULL) {
+            kerberos_shard_need(pinfo, GPOINTER_TO_UINT(frame), KRB_SHARD_CONNECTION, key);
+        }
+        break;
 
-    return offset;
-}
+    default:
+        break;
+    }
 
+    switch (msg_type) {
+    case KRB5_MSG_AS_REQ:
+    case KRB5_MSG_TGS_REQ:
+        kerberos_shard_padata(pinfo, tvb, seq, seq_end);
+        body = kerberos_outer_field(tvb, seq, seq_end, 4, &body_end);
+        body = kerberos_outer_open(tvb, body, body_end, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, &body_end);
+        /* additional-tickets, for user-to-user and S4U2Proxy */
+        if (body >= 0) {
+            kerberos_shard_tickets_in(pinfo, tvb, body, body_end, 11, FALSE);
+        }
+        break;
 
-static const ber_sequence_t KrbFastArmoredReq_sequence[] = {
-  { &hf_kerberos_armor      , BER_CLASS_CON, 0, BER_FLAGS_OPTIONAL, dissect_kerberos_KrbFastArmor },
-  { &hf_kerberos_req_checksum, BER_CLASS_CON, 1, 0, dissect_kerberos_Checksum },
-  { &hf_kerberos_enc_fast_req, BER_CLASS_CON, 2, 0, dissect_kerberos_EncryptedKrbFastReq },
-  { NULL, 0, 0, 0, NULL }
-};
+    case KRB5_MSG_AS_REP:
+    case KRB5_MSG_TGS_REP:
+        field = kerberos_outer_field(tvb, seq, seq_end, 5, &field_end);
+        if (field >= 0) {
+            kerberos_shard_issued(pinfo, tvb, field, field_end,
+                wmem_strdup_printf(wmem_packet_scope(), "%s@%s",
+                    kerberos_outer_principal(tvb, seq, seq_end, 4), kerberos_outer_string(tvb, seq, seq_end, 3)));
+        }
+        break;
 
-static int
-dissect_kerberos_KrbFastArmoredReq(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        KrbFastArmoredReq_sequence, hf_index, ett_kerberos_KrbFastArmoredReq);
+    case KRB5_MSG_AP_REQ:
+        kerberos_shard_ap_req(pinfo, tvb, offset, end);
+        /* fall through */
+    case KRB5_MSG_AP_REP:
+        /* later traffic on the connection needs this exchange */
+        g_hash_table_insert(kerberos_shard_connections, (gpointer)kerberos_shard_connection(pinfo),
+            GUINT_TO_POINTER(pinfo->num));
+        break;
 
-    return offset;
+    case KRB5_MSG_CRED:
+        kerberos_shard_tickets_in(pinfo, tvb, seq, seq_end, 2, TRUE);
+        break;
+
+    default:
+        break;
+    }
 }
 
+static gint
+kerberos_shard_cmp_msg(gconstpointer a, gconstpointer b)
+{
+    guint32 fa = ((const kerberos_shard_msg_t*)a)->frame;
+    guint32 fb = ((const kerberos_shard_msg_t*)b)->frame;
 
-static const ber_choice_t PA_FX_FAST_REQUEST_choice[] = {
-  {   0, &hf_kerberos_armored_data_request, BER_CLASS_CON, 0, 0, dissect_kerberos_KrbFastArmoredReq },
-  { 0, NULL, 0, 0, 0, NULL }
-};
+    return fa < fb ? -1 : fa > fb;
+}
 
-static int
-dissect_kerberos_PA_FX_FAST_REQUEST(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_choice(actx, tree, tvb, offset,
-        PA_FX_FAST_REQUEST_choice, hf_index, ett_kerberos_PA_FX_FAST_REQUEST,
-        NULL);
+static gint
+kerberos_shard_cmp_span(gconstpointer a, gconstpointer b)
+{
+    guint32 fa = ((const kerberos_shard_span_t*)a)->last;
+    guint32 fb = ((const kerberos_shard_span_t*)b)->last;
 
-    return offset;
+    return fa < fb ? -1 : fa > fb;
 }
 
+static gint
+kerberos_shard_cmp_frame(gconstpointer a, gconstpointer b)
+{
+    guint32 fa = GPOINTER_TO_UINT(a);
+    guint32 fb = GPOINTER_TO_UINT(b);
 
+    return fa < fb ? -1 : fa > fb;
+}
 
-static int
-dissect_kerberos_T_encryptedKrbFastResponse_cipher(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 590 "./asn1/kerberos/kerberos.cnf"
-#ifdef HAVE_KERBEROS
-    offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_index, dissect_krb5_decrypt_KrbFastResponse);
-#else
-    offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index,
-        NULL);
+/* The index of the first entry at or after frame */
+static guint
+kerberos_shard_find(guint32 frame)
+{
+    guint lo = 0, hi = kerberos_shard_msgs->len;
 
-#endif
-    return offset;
+    while (lo < hi) {
+        guint mid = lo + (hi - lo) / 2;
 
+        if (g_array_index(kerberos_shard_msgs, kerberos_shard_msg_t, mid).frame < frame) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* The index of the first span ending at or after frame */
+static guint
+kerberos_shard_find_span(guint32 frame)
+{
+    guint lo = 0, hi = kerberos_shard_spans->len;
 
+    while (lo < hi) {
+        guint mid = lo + (hi - lo) / 2;
 
-    return offset;
+        if (g_array_index(kerberos_shard_spans, kerberos_shard_span_t, mid).last < frame) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
 }
 
+/* The first segment of the message ending in frame */
+static guint32
+kerberos_shard_span_first(guint32 frame)
+{
+    guint idx = kerberos_shard_find_span(frame);
 
-static const ber_sequence_t EncryptedKrbFastResponse_sequence[] = {
-  { &hf_kerberos_etype      , BER_CLASS_CON, 0, 0, dissect_kerberos_ENCTYPE },
-  { &hf_kerberos_kvno       , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
-  { &hf_kerberos_encryptedKrbFastResponse_cipher, BER_CLASS_CON, 2, 0, dissect_kerberos_T_encryptedKrbFastResponse_cipher },
-  { NULL, 0, 0, 0, NULL }
-};
+    if (idx < kerberos_shard_spans->len &&
+        g_array_index(kerberos_shard_spans, kerberos_shard_span_t, idx).last == frame) {
+        return g_array_index(kerberos_shard_spans, kerberos_shard_span_t, idx).first;
+    }
+    return frame;
+}
 
-static int
-dissect_kerberos_EncryptedKrbFastResponse(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        EncryptedKrbFastResponse_sequence, hf_index, ett_kerberos_EncryptedKrbFastResponse);
+/* The end of a shard that would end at last, moved past any message
+ * reassembled across it */
+static guint32
+kerberos_shard_boundary(guint32 last)
+{
+    guint idx = kerberos_shard_find_span(last + 1);
 
-    return offset;
+    for (; idx < kerberos_shard_spans->len; idx++) {
+        kerberos_shard_span_t* span = &g_array_index(kerberos_shard_spans, kerberos_shard_span_t, idx);
+
+        /* spans are sorted by their end, so none later can start by last */
+        if (span->last > last + kerberos_shard_max_span) {
+            break;
+        }
+        if (span->first <= last) {
+            last = span->last;
+        }
+    }
+    return last;
 }
 
+static void
+kerberos_shard_closure_add(guint32 frame, guint32 first, guint32 last, GHashTable* closure, GArray* stack)
+{
+    if (frame == 0 || (first && frame >= first && (last == 0 || frame <= last)) ||
+        g_hash_table_contains(closure, GUINT_TO_POINTER(frame))) {
+        return;
+    }
+    g_hash_table_add(closure, GUINT_TO_POINTER(frame));
+    g_array_append_val(stack, frame);
+}
 
-static const ber_sequence_t KrbFastArmoredRep_sequence[] = {
-  { &hf_kerberos_enc_fast_rep, BER_CLASS_CON, 0, 0, dissect_kerberos_EncryptedKrbFastResponse },
-  { NULL, 0, 0, 0, NULL }
-};
+/* Add frame and everything it needs, with all their segments, except
+ * what is in first..last (last 0: to the end), to closure.
+ */
+static void
+kerberos_shard_closure(guint32 frame, guint32 first, guint32 last, GHashTable* closure, GArray* stack)
+{
+    kerberos_shard_msg_t* msg;
+    guint32 segment;
+    guint idx, i;
+
+    kerberos_shard_closure_add(frame, first, last, closure, stack);
+    while (stack->len > 0) {
+        frame = g_array_index(stack, guint32, stack->len - 1);
+        g_array_set_size(stack, stack->len - 1);
+        /* a segment may end another message too, so it is followed like one */
+        for (segment = kerberos_shard_span_first(frame); segment < frame; segment++) {
+            kerberos_shard_closure_add(segment, first, last, closure, stack);
+        }
+        idx = kerberos_shard_find(frame);
+        if (idx == kerberos_shard_msgs->len) {
+            continue;
+        }
+        msg = &g_array_index(kerberos_shard_msgs, kerberos_shard_msg_t, idx);
+        if (msg->frame != frame) {
+            continue;
+        }
+        for (i = 0; i < msg->num_needs; i++) {
+            kerberos_shard_closure_add(g_array_index(kerberos_shard_needs, kerberos_shard_need_t, msg->first_need + i).frame,
+                first, last, closure, stack);
+        }
+    }
+}
 
-static int
-dissect_kerberos_KrbFastArmoredRep(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        KrbFastArmoredRep_sequence, hf_index, ett_kerberos_KrbFastArmoredRep);
+/* " 12-13 230" */
+static void
+kerberos_shard_put_ranges(FILE* fp, GHashTable* frames)
+{
+    GList* list = g_list_sort(g_hash_table_get_keys(frames), kerberos_shard_cmp_frame);
+    GList* l = list;
 
-    return offset;
+    while (l != NULL) {
+        guint32 start = GPOINTER_TO_UINT(l->data);
+        guint32 end = start;
+
+        while (l->next != NULL && GPOINTER_TO_UINT(l->next->data) == end + 1) {
+            l = l->next;
+            end++;
+        }
+        if (start == end) {
+            fprintf(fp, " %u", start);
+        } else {
+            fprintf(fp, " %u-%u", start, end);
+        }
+        l = l->next;
+    }
+    g_list_free(list);
 }
 
+static void
+kerberos_shard_write(FILE* fp)
+{
+    guint32 size = MAX(kerberos_shard_size, 1);
+    GHashTable* closure = g_hash_table_new(g_direct_hash, g_direct_equal);
+    GHashTable* direct = g_hash_table_new(g_direct_hash, g_direct_equal);
+    GHashTable* external = g_hash_table_new(g_direct_hash, g_direct_equal);
+    GArray* stack = g_array_new(FALSE, FALSE, sizeof(guint32));
+    GString* keys = g_string_new(NULL);
+    GList* tuples;
+    GList* l;
+    guint32 shard;
+    guint32 first, last;
+    guint idx, i;
+
+    g_array_sort(kerberos_shard_msgs, kerberos_shard_cmp_msg);
+    g_array_sort(kerberos_shard_spans, kerberos_shard_cmp_span);
+    fprintf(fp, "# Kerberos shard plan, about %u frames per shard\n", size);
+    for (shard = 0, first = 1; first <= kerberos_shard_last_frame; shard++, first = last + 1) {
+        last = first - 1 + size;
+        last = last < kerberos_shard_last_frame ? kerberos_shard_boundary(last) : 0;
+        if (last >= kerberos_shard_last_frame) {
+            last = 0;
+        }
 
-static const ber_choice_t PA_FX_FAST_REPLY_choice[] = {
-  {   0, &hf_kerberos_armored_data_reply, BER_CLASS_CON, 0, 0, dissect_kerberos_KrbFastArmoredRep },
-  { 0, NULL, 0, 0, 0, NULL }
-};
+        g_string_truncate(keys, 0);
+        for (idx = kerberos_shard_find(first); idx < kerberos_shard_msgs->len; idx++) {
+            kerberos_shard_msg_t* msg = &g_array_index(kerberos_shard_msgs, kerberos_shard_msg_t, idx);
 
-static int
-dissect_kerberos_PA_FX_FAST_REPLY(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_choice(actx, tree, tvb, offset,
-        PA_FX_FAST_REPLY_choice, hf_index, ett_kerberos_PA_FX_FAST_REPLY,
-        NULL);
+            if (last && msg->frame > last) {
+                break;
+            }
+            for (i = 0; i < msg->num_needs; i++) {
+                kerberos_shard_need_t* need = &g_array_index(kerberos_shard_needs, kerberos_shard_need_t, msg->first_need + i);
+
+                if (need->frame == 0) {
+                    /* interned, so one per ticket */
+                    if (!g_hash_table_contains(external, need->what)) {
+                        g_hash_table_add(external, (gpointer)need->what);
+                        g_string_append_printf(keys, "external %u %s\n", shard, need->what);
+                    }
+                } else if (need->frame < first) {
+                    if (!g_hash_table_contains(direct, GUINT_TO_POINTER(need->frame))) {
+                        guint32 need_first = kerberos_shard_span_first(need->frame);
+
+                        g_hash_table_add(direct, GUINT_TO_POINTER(need->frame));
+                        if (need_first == need->frame) {
+                            g_string_append_printf(keys, "key %u %u %s %s\n", shard, need->frame,
+                                kerberos_shard_kinds[need->kind], need->what);
+                        } else {
+                            g_string_append_printf(keys, "key %u %u-%u %s %s\n", shard, need_first, need->frame,
+                                kerberos_shard_kinds[need->kind], need->what);
+                        }
+                    }
+                    kerberos_shard_closure(need->frame, first, last, closure, stack);
+                }
+            }
+        }
+        if (last) {
+            fprintf(fp, "shard %u %u-%u preload", shard, first, last);
+        } else {
+            fprintf(fp, "shard %u %u- preload", shard, first);
+        }
+        kerberos_shard_put_ranges(fp, closure);
+        fprintf(fp, "\n%s", keys->str);
+        g_hash_table_remove_all(closure);
+        g_hash_table_remove_all(direct);
+        g_hash_table_remove_all(external);
+        if (last == 0) {
+            break;
+        }
+    }
 
-    return offset;
+    tuples = g_list_sort(g_hash_table_get_keys(kerberos_shard_connections), (GCompareFunc)strcmp);
+    for (l = tuples; l != NULL; l = l->next) {
+        kerberos_shard_closure(GPOINTER_TO_UINT(g_hash_table_lookup(kerberos_shard_connections, l->data)),
+            0, 0, closure, stack);
+        fprintf(fp, "connection %s", (const char*)l->data);
+        kerberos_shard_put_ranges(fp, closure);
+        fprintf(fp, "\n");
+        g_hash_table_remove_all(closure);
+    }
+    g_list_free(tuples);
+
+    g_string_free(keys, TRUE);
+    g_array_free(stack, TRUE);
+    g_hash_table_destroy(external);
+    g_hash_table_destroy(direct);
+    g_hash_table_destroy(closure);
 }
 
+/* The plan covers what was read since the last cleanup */
+static void
+kerberos_shard_cleanup(void)
+{
+    FILE* fp;
 
+    if (kerberos_shard_msgs == NULL) {
+        return;
+    }
+    if (*kerberos_shard_filename) {
+        fp = ws_fopen(kerberos_shard_filename, "w");
+        if (fp == NULL) {
+            fprintf(stderr, "KERBEROS ERROR: Could not open shard plan %s\n", kerberos_shard_filename);
+        } else {
+            kerberos_shard_write(fp);
+            fclose(fp);
+        }
+    }
+    g_array_free(kerberos_shard_msgs, TRUE);
+    g_array_free(kerberos_shard_needs, TRUE);
+    g_hash_table_destroy(kerberos_shard_tickets);
+    g_hash_table_destroy(kerberos_shard_requests);
+    g_hash_table_destroy(kerberos_shard_connections);
+    g_string_chunk_free(kerberos_shard_strings);
+    g_hash_table_destroy(kerberos_shard_interned);
+    g_array_free(kerberos_shard_spans, TRUE);
+    kerberos_shard_msgs = NULL;
+    kerberos_shard_needs = NULL;
+    kerberos_shard_tickets = NULL;
+    kerberos_shard_requests = NULL;
+    kerberos_shard_connections = NULL;
+    kerberos_shard_strings = NULL;
+    kerberos_shard_interned = NULL;
+    kerberos_shard_spans = NULL;
+    kerberos_shard_string_bytes = 0;
+    kerberos_shard_max_span = 0;
+    kerberos_shard_last_frame = 0;
+}
+
+/* The pre-pass in place of a full dissection: see the comment above */
+static gint
+kerberos_shard_prepass(tvbuff_t* tvb, packet_info* pinfo, proto_item* item, int offset)
+{
+    gint8 ber_class;
+    gboolean pc;
+    gint32 tag;
+    guint32 len;
+    int contents;
 
-static int
-dissect_kerberos_T_encryptedChallenge_cipher(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 598 "./asn1/kerberos/kerberos.cnf"
-#ifdef HAVE_KERBEROS
-    offset = dissect_ber_octet_string_wcb(FALSE, actx, tree, tvb, offset, hf_index, dissect_krb5_decrypt_EncryptedChallenge);
-#else
-    offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index,
-        NULL);
+    if (!PINFO_FD_VISITED(pinfo)) {
+        kerberos_shard_message(tvb, pinfo, offset);
+    }
+    contents = try_get_ber_tl(tvb, offset, &ber_class, &pc, &tag, &len);
+    if (contents < 0 || ber_class != BER_CLASS_APP) {
+        return tvb_captured_length(tvb);
+    }
+    if (gbl_do_col_info) {
+        col_add_str(pinfo->cinfo, COL_INFO, val_to_str(tag, kerberos_MESSAGE_TYPE_vals, "Unknown (%d)"));
+    }
+    proto_item_append_text(item, ", %s", val_to_str(tag, kerberos_MESSAGE_TYPE_vals, "Unknown (%d)"));
+    proto_item_set_len(item, contents + len);
+    return contents + len;
+}
 
-#endif
-    return offset;
+/*
+ * Sampling (kerberos.sample_mode), for monitoring links too busy for a
+ * full dissection of every message. Each message on the UDP and TCP
+ * entry points gets the header walk below: message type, realm, client
+ * (or service) principal, error code and etypes, which the
+ * kerberos_sample tap reports exactly. Only the sampled messages are
+ * dissected in full, with trial decryption, PKINIT and PAC: one in
+ * sample_rate, or per principal all of the first sample_principal_first
+ * (k) and then the i-th on its own with probability k/i (Bernoulli
+ * sampling with a decaying probability; nothing already taken is given
+ * up, unlike a reservoir), plus every KRB-ERROR if sample_errors is set.
+ * When decryption is on, AS-REPs, TGS-REQs, TGS-REPs and AP-REPs are
+ * always dissected in full: they carry the keys the messages after them
+ * need, the TGS-REQ in the subkey of its PA-TGS-REQ authenticator, which
+ * the TGS-REP is encrypted with. Each sampled message carries the weight
+ * 1/p of its inclusion probability, in KRB_SAMPLE_WEIGHT_ONE fixed point,
+ * so the -z krb_sample,tree estimates are Horvitz-Thompson totals. The
+ * decryption counts among them are still biased low where the key comes
+ * from a message that may be left out, such as the subkey of an
+ * application AP-REQ authenticator. The decision is kept per frame so
+ * later passes match. A sampled message that the circuit breaker cuts
+ * down to its header does not count as dissected.
+ */
+#define KRB_SAMPLE_MAX_ETYPES 16
+#define KRB_SAMPLE_WEIGHT_ONE 1000
 
+/* p_add_proto_data() key; the circuit breaker uses the plain offset */
+#define KRB_SAMPLE_KEY(tvb) ((guint)tvb_raw_offset(tvb) | 0x80000000U)
 
+typedef struct {
+    gint32 msg_type;            /* -1: not a Kerberos message */
+    const char* realm;
+    const char* principal;
+    gboolean have_error;
+    gint32 error_code;
+    guint num_etypes;
+    gint32 etypes[KRB_SAMPLE_MAX_ETYPES];
+    guint weight;               /* 1/p in KRB_SAMPLE_WEIGHT_ONE units; 0: header only */
+    /* filled in after the full dissection; the tap reads them once the
+     * frame is done */
+    gboolean deep;
+    gboolean decrypted;
+    gboolean missing_key;
+    gboolean pkinit_cert;
+    gboolean pac;
+} kerberos_sample_t;
+
+static int kerberos_sample_tap = -1;
 
-    return offset;
+static void
+kerberos_mem_sample_principals(guint* count, guint64* bytes)
+{
+    *count = wmem_map_size(kerberos_sample_principals);
+    *bytes = (guint64)*count * (sizeof(guint) + BER_MEM_MAP_ENTRY);
 }
 
+/* The INTEGER at offset, if it fits in 32 bits; *int_end is set if there
+ * is an INTEGER at all
+ */
+static gboolean
+kerberos_sample_int(tvbuff_t* tvb, int offset, int end, gint32* value, int* int_end)
+{
+    offset = kerberos_outer_open(tvb, offset, end, BER_CLASS_UNI, BER_UNI_TAG_INTEGER, int_end);
+    if (offset < 0 || *int_end == offset || *int_end - offset > 4) {
+        return FALSE;
+    }
+    *value = (gint8)tvb_get_guint8(tvb, offset);
+    for (offset++; offset < *int_end; offset++) {
+        *value = (gint32)(((guint32)*value << 8) | tvb_get_guint8(tvb, offset));
+    }
+    return TRUE;
+}
 
-static const ber_sequence_t EncryptedChallenge_sequence[] = {
-  { &hf_kerberos_etype      , BER_CLASS_CON, 0, 0, dissect_kerberos_ENCTYPE },
-  { &hf_kerberos_kvno       , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_UInt32 },
-  { &hf_kerberos_encryptedChallenge_cipher, BER_CLASS_CON, 2, 0, dissect_kerberos_T_encryptedChallenge_cipher },
-  { NULL, 0, 0, 0, NULL }
-};
+static gboolean
+kerberos_sample_int_field(tvbuff_t* tvb, int offset, int end, gint32 want_tag, gint32* value)
+{
+    int field_end, int_end;
 
-static int
-dissect_kerberos_EncryptedChallenge(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        EncryptedChallenge_sequence, hf_index, ett_kerberos_EncryptedChallenge);
+    offset = kerberos_outer_field(tvb, offset, end, want_tag, &field_end);
+    return offset >= 0 && kerberos_sample_int(tvb, offset, field_end, value, &int_end);
+}
 
-    return offset;
+static void
+kerberos_sample_add_etype(kerberos_sample_t* sample, gint32 etype)
+{
+    if (sample->num_etypes < KRB_SAMPLE_MAX_ETYPES) {
+        sample->etypes[sample->num_etypes++] = etype;
+    }
 }
 
+/* The etype of the EncryptedData in field want_tag */
+static void
+kerberos_sample_enc_etype(kerberos_sample_t* sample, tvbuff_t* tvb, int offset, int end, gint32 want_tag)
+{
+    int field_end, enc_end;
+    gint32 etype;
 
-/*--- End of included file: packet-kerberos-fn.c ---*/
-#line 3822 "./asn1/kerberos/packet-kerberos-template.c"
+    offset = kerberos_outer_field(tvb, offset, end, want_tag, &field_end);
+    offset = kerberos_outer_open(tvb, offset, field_end, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, &enc_end);
+    if (offset >= 0 && kerberos_sample_int_field(tvb, offset, enc_end, 0, &etype)) {
+        kerberos_sample_add_etype(sample, etype);
+    }
+}
 
-#ifdef HAVE_KERBEROS
-static const ber_sequence_t PA_ENC_TS_ENC_sequence[] = {
-        { &hf_krb_patimestamp, BER_CLASS_CON, 0, 0, dissect_kerberos_KerberosTime },
-        { &hf_krb_pausec     , BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_Microseconds },
-        { NULL, 0, 0, 0, NULL }
-};
+/* "name@realm" for the PrincipalName in field name_tag, or NULL */
+static const char*
+kerberos_sample_principal(tvbuff_t* tvb, int offset, int end, gint32 name_tag, const char* realm)
+{
+    int field_end;
 
-static int
-dissect_kerberos_PA_ENC_TS_ENC(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        PA_ENC_TS_ENC_sequence, hf_index, ett_krb_pa_enc_ts_enc);
-    return offset;
+    if (kerberos_outer_field(tvb, offset, end, name_tag, &field_end) < 0) {
+        return NULL;
+    }
+    return wmem_strdup_printf(wmem_packet_scope(), "%s@%s",
+        kerberos_outer_principal(tvb, offset, end, name_tag), realm);
 }
 
-static int
-dissect_kerberos_T_strengthen_key(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-#line 491 "./asn1/kerberos/kerberos.cnf"
-    kerberos_private_data_t* private_data = kerberos_get_private_data(actx);
-    gint save_encryption_key_parent_hf_index = private_data->save_encryption_key_parent_hf_index;
-    kerberos_key_save_fn saved_encryption_key_fn = private_data->save_encryption_key_fn;
-    private_data->save_encryption_key_parent_hf_index = hf_kerberos_KrbFastResponse;
-#ifdef HAVE_KERBEROS
-    private_data->save_encryption_key_fn = save_KrbFastResponse_strengthen_key;
-#endif
-    offset = dissect_kerberos_EncryptionKey(implicit_tag, tvb, offset, actx, tree, hf_index);
+static void
+kerberos_sample_walk(kerberos_sample_t* sample, tvbuff_t* tvb, int offset)
+{
+    gint8 ber_class;
+    gboolean pc;
+    gint32 tag;
+    guint32 len;
+    int contents, seq, seq_end, body, body_end, field, field_end;
+    gint32 etype;
 
-    private_data->save_encryption_key_parent_hf_index = save_encryption_key_parent_hf_index;
-    private_data->save_encryption_key_fn = saved_encryption_key_fn;
-    return offset;
-}
+    sample->msg_type = -1;
+    contents = try_get_ber_tl(tvb, offset, &ber_class, &pc, &tag, &len);
+    if (contents < 0 || ber_class != BER_CLASS_APP) {
+        return;
+    }
+    sample->msg_type = tag;
+    seq = kerberos_outer_open(tvb, contents, contents + len, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, &seq_end);
+    if (seq < 0) {
+        return;
+    }
 
-static const ber_sequence_t KrbFastFinished_sequence[] = {
-  { &hf_kerberos_timestamp  , BER_CLASS_CON, 0, 0, dissect_kerberos_KerberosTime },
-  { &hf_kerberos_usec       , BER_CLASS_CON, 1, 0, dissect_kerberos_Microseconds },
-  { &hf_kerberos_crealm     , BER_CLASS_CON, 2, 0, dissect_kerberos_Realm },
-  { &hf_kerberos_cname_01   , BER_CLASS_CON, 3, 0, dissect_kerberos_PrincipalName },
-  { &hf_kerberos_ticket_checksum, BER_CLASS_CON, 4, 0, dissect_kerberos_Checksum },
-  { NULL, 0, 0, 0, NULL }
-};
+    switch (tag) {
+    case KRB5_MSG_AS_REQ:
+    case KRB5_MSG_TGS_REQ:
+        body = kerberos_outer_field(tvb, seq, seq_end, 4, &body_end);
+        body = kerberos_outer_open(tvb, body, body_end, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, &body_end);
+        if (body < 0) {
+            break;
+        }
+        sample->realm = kerberos_outer_string(tvb, body, body_end, 2);
+        sample->principal = kerberos_sample_principal(tvb, body, body_end, 1, sample->realm);
+        if (sample->principal == NULL) {
+            sample->principal = kerberos_sample_principal(tvb, body, body_end, 3, sample->realm);
+        }
+        field = kerberos_outer_field(tvb, body, body_end, 8, &field_end);
+        field = kerberos_outer_open(tvb, field, field_end, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, &field_end);
+        while (field >= 0 && field < field_end) {
+            int int_end = -1;
 
-static int
-dissect_kerberos_KrbFastFinished(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        KrbFastFinished_sequence, hf_index, ett_kerberos_KrbFastFinished);
+            if (kerberos_sample_int(tvb, field, field_end, &etype, &int_end)) {
+                kerberos_sample_add_etype(sample, etype);
+            }
+            field = int_end;
+        }
+        break;
 
-    return offset;
-}
+    case KRB5_MSG_AS_REP:
+    case KRB5_MSG_TGS_REP:
+        sample->realm = kerberos_outer_string(tvb, seq, seq_end, 3);
+        sample->principal = kerberos_sample_principal(tvb, seq, seq_end, 4, sample->realm);
+        kerberos_sample_enc_etype(sample, tvb, seq, seq_end, 6);
+        break;
 
-static const ber_sequence_t KrbFastResponse_sequence[] = {
-  { &hf_kerberos_padata     , BER_CLASS_CON, 0, 0, dissect_kerberos_SEQUENCE_OF_PA_DATA },
-  { &hf_kerberos_strengthen_key, BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_kerberos_T_strengthen_key },
-  { &hf_kerberos_finished   , BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_kerberos_KrbFastFinished },
-  { &hf_kerberos_nonce      , BER_CLASS_CON, 3, 0, dissect_kerberos_UInt32 },
-  { NULL, 0, 0, 0, NULL }
-};
+    case KRB5_MSG_AP_REQ:
+        field = kerberos_outer_field(tvb, seq, seq_end, 3, &field_end);
+        field = kerberos_outer_open(tvb, field, field_end, BER_CLASS_APP, KRB5_MSG_TICKET, &field_end);
+        field = kerberos_outer_open(tvb, field, field_end, BER_CLASS_UNI, BER_UNI_TAG_SEQUENCE, &field_end);
+        if (field < 0) {
+            break;
+        }
+        sample->realm = kerberos_outer_string(tvb, field, field_end, 1);
+        sample->principal = kerberos_sample_principal(tvb, field, field_end, 2, sample->realm);
+        kerberos_sample_enc_etype(sample, tvb, field, field_end, 3);
+        break;
 
-static int
-dissect_kerberos_KrbFastResponse(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        KrbFastResponse_sequence, hf_index, ett_kerberos_KrbFastResponse);
+    case KRB5_MSG_ERROR:
+        sample->realm = kerberos_outer_string(tvb, seq, seq_end, 9);
+        sample->have_error = kerberos_sample_int_field(tvb, seq, seq_end, 6, &sample->error_code);
+        sample->principal = kerberos_sample_principal(tvb, seq, seq_end, 8,
+            kerberos_outer_string(tvb, seq, seq_end, 7));
+        if (sample->principal == NULL) {
+            sample->principal = kerberos_sample_principal(tvb, seq, seq_end, 10, sample->realm);
+        }
+        break;
 
-    return offset;
+    default:
+        break;
+    }
 }
 
-static const ber_sequence_t KrbFastReq_sequence[] = {
-  { &hf_kerberos_fast_options, BER_CLASS_CON, 0, 0, dissect_kerberos_FastOptions },
-  { &hf_kerberos_padata     , BER_CLASS_CON, 1, 0, dissect_kerberos_SEQUENCE_OF_PA_DATA },
-  { &hf_kerberos_req_body   , BER_CLASS_CON, 2, 0, dissect_kerberos_KDC_REQ_BODY },
-  { NULL, 0, 0, 0, NULL }
-};
+/* Messages whose keys the later messages need to decrypt */
+static gboolean
+kerberos_sample_carries_keys(const kerberos_sample_t* sample)
+{
+#ifdef HAVE_KERBEROS
+    if (!krb_decrypt) {
+        return FALSE;
+    }
+    switch (sample->msg_type) {
+    case KRB5_MSG_AS_REP:
+    case KRB5_MSG_TGS_REQ:
+    case KRB5_MSG_TGS_REP:
+    case KRB5_MSG_AP_REP:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+#else
+    return FALSE;
+#endif
+}
+
+/* The weight of this message if it is to be dissected in full, or 0 */
+static guint
+kerberos_sample_decide(kerberos_sample_t* sample, packet_info* pinfo)
+{
+    guint* seen;
+    guint32 hash;
+
+    if (sample->msg_type < 0) {
+        return KRB_SAMPLE_WEIGHT_ONE;   /* what the full dissection makes of it */
+    }
+    if (sample->msg_type == KRB5_MSG_ERROR && kerberos_sample_errors) {
+        return KRB_SAMPLE_WEIGHT_ONE;
+    }
+    if (kerberos_sample_carries_keys(sample)) {
+        return KRB_SAMPLE_WEIGHT_ONE;
+    }
+    switch (kerberos_sample_mode) {
+    case KRB_SAMPLE_RATE:
+        if (kerberos_sample_rate <= 1) {
+            return KRB_SAMPLE_WEIGHT_ONE;
+        }
+        return (kerberos_sample_count++ % kerberos_sample_rate) == 0 ?
+            kerberos_sample_rate * KRB_SAMPLE_WEIGHT_ONE : 0;
 
-static int
-dissect_kerberos_KrbFastReq(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
-        KrbFastReq_sequence, hf_index, ett_kerberos_KrbFastReq);
+    case KRB_SAMPLE_PRINCIPAL:
+        if (kerberos_sample_principal_first == 0) {
+            return KRB_SAMPLE_WEIGHT_ONE;
+        }
+        if (sample->principal == NULL) {
+            sample->principal = "?";
+        }
+        seen = (guint*)wmem_map_lookup(kerberos_sample_principals, sample->principal);
+        if (seen == NULL) {
+            seen = wmem_new0(wmem_file_scope(), guint);
+            wmem_map_insert(kerberos_sample_principals, wmem_strdup(wmem_file_scope(), sample->principal), seen);
+        }
+        (*seen)++;
+        if (*seen <= kerberos_sample_principal_first) {
+            return KRB_SAMPLE_WEIGHT_ONE;
+        }
+        /* keep the i-th with probability k/i; a hash of the frame number
+         * stands in for the random draw, so runs repeat */
+        hash = pinfo->num * 2654435761U;
+        hash ^= hash >> 16;
+        if (hash % *seen >= kerberos_sample_principal_first) {
+            return 0;
+        }
+        return (guint)(((guint64)*seen * KRB_SAMPLE_WEIGHT_ONE + kerberos_sample_principal_first / 2) /
+            kerberos_sample_principal_first);
 
-    return offset;
+    default:
+        return KRB_SAMPLE_WEIGHT_ONE;
+    }
 }
 
-static const int* FastOptions_bits[] = {
-  &hf_kerberos_FastOptions_reserved,
-  &hf_kerberos_FastOptions_hide_client_names,
-  &hf_kerberos_FastOptions_spare_bit2,
-  &hf_kerberos_FastOptions_spare_bit3,
-  &hf_kerberos_FastOptions_spare_bit4,
-  &hf_kerberos_FastOptions_spare_bit5,
-  &hf_kerberos_FastOptions_spare_bit6,
-  &hf_kerberos_FastOptions_spare_bit7,
-  &hf_kerberos_FastOptions_spare_bit8,
-  &hf_kerberos_FastOptions_spare_bit9,
-  &hf_kerberos_FastOptions_spare_bit10,
-  &hf_kerberos_FastOptions_spare_bit11,
-  &hf_kerberos_FastOptions_spare_bit12,
-  &hf_kerberos_FastOptions_spare_bit13,
-  &hf_kerberos_FastOptions_spare_bit14,
-  &hf_kerberos_FastOptions_spare_bit15,
-  &hf_kerberos_FastOptions_kdc_follow_referrals,
-  NULL
-};
-
-static int
-dissect_kerberos_FastOptions(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_bitstring(implicit_tag, actx, tree, tvb, offset,
-        FastOptions_bits, 17, hf_index, ett_kerberos_FastOptions,
-        NULL);
+/* Header walk and decision for one message; the sample is queued to the
+ * tap right away, so that a message that throws is still counted.
+ */
+static kerberos_sample_t*
+kerberos_sample_message(tvbuff_t* tvb, packet_info* pinfo, int offset)
+{
+    kerberos_sample_t* sample = wmem_new0(wmem_packet_scope(), kerberos_sample_t);
 
-    return offset;
+    kerberos_sample_walk(sample, tvb, offset);
+    if (!PINFO_FD_VISITED(pinfo)) {
+        sample->weight = kerberos_sample_decide(sample, pinfo);
+        p_add_proto_data(wmem_file_scope(), pinfo, proto_kerberos, KRB_SAMPLE_KEY(tvb),
+            GUINT_TO_POINTER(sample->weight));
+    } else {
+        sample->weight = GPOINTER_TO_UINT(p_get_proto_data(wmem_file_scope(), pinfo, proto_kerberos,
+            KRB_SAMPLE_KEY(tvb)));
+    }
+    tap_queue_packet(kerberos_sample_tap, pinfo, sample);
+    return sample;
 }
 
-#endif /* HAVE_KERBEROS */
-
-/* Make wrappers around exported functions for now */
-int
-dissect_krb5_Checksum(proto_tree* tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx _U_)
+/* What the full dissection found */
+static void
+kerberos_sample_deep(kerberos_sample_t* sample, packet_info* pinfo, kerberos_private_data_t* private_data)
 {
-    return dissect_kerberos_Checksum(FALSE, tvb, offset, actx, tree, hf_kerberos_cksum);
+    if (sample == NULL) {
+        return;
+    }
+    sample->deep = TRUE;
+    sample->decrypted = private_data->decryption_keys != NULL;
+    sample->missing_key = private_data->missing_keys != NULL && private_data->decryption_keys == NULL;
+    sample->pkinit_cert = pkinit_get_cert_fingerprint(pinfo) != NULL;
+    sample->pac = private_data->saw_pac;
+}
+
+/* -z krb_sample,tree */
+static int st_node_krb_sample_msgs = -1;
+static int st_node_krb_sample_realms = -1;
+static int st_node_krb_sample_errors = -1;
+static int st_node_krb_sample_etypes = -1;
+static int st_node_krb_sample_sampled = -1;
+static int st_node_krb_sample_estimated = -1;
+static const gchar* st_str_krb_sample_msgs = "Messages (exact)";
+static const gchar* st_str_krb_sample_realms = "Realms (exact)";
+static const gchar* st_str_krb_sample_errors = "Error codes (exact)";
+static const gchar* st_str_krb_sample_etypes = "Etypes (exact)";
+static const gchar* st_str_krb_sample_sampled = "Fully dissected (sampled)";
+static const gchar* st_str_krb_sample_estimated = "Fully dissected (estimated totals)";
+
+/* The estimated totals in KRB_SAMPLE_WEIGHT_ONE units, rounded only for display */
+enum {
+    KRB_SAMPLE_EST_ALL,
+    KRB_SAMPLE_EST_DECRYPTED,
+    KRB_SAMPLE_EST_MISSING_KEY,
+    KRB_SAMPLE_EST_PKINIT_CERT,
+    KRB_SAMPLE_EST_PAC,
+    KRB_SAMPLE_EST_COUNT
+};
+static guint64 krb_sample_estimated[KRB_SAMPLE_EST_COUNT];
 
+static void
+krb_sample_stats_tree_init(stats_tree* st)
+{
+    st_node_krb_sample_msgs = stats_tree_create_node(st, st_str_krb_sample_msgs, 0, STAT_DT_INT, TRUE);
+    st_node_krb_sample_realms = stats_tree_create_node(st, st_str_krb_sample_realms, 0, STAT_DT_INT, TRUE);
+    st_node_krb_sample_errors = stats_tree_create_node(st, st_str_krb_sample_errors, 0, STAT_DT_INT, TRUE);
+    st_node_krb_sample_etypes = stats_tree_create_node(st, st_str_krb_sample_etypes, 0, STAT_DT_INT, TRUE);
+    st_node_krb_sample_sampled = stats_tree_create_node(st, st_str_krb_sample_sampled, 0, STAT_DT_INT, TRUE);
+    st_node_krb_sample_estimated = stats_tree_create_node(st, st_str_krb_sample_estimated, 0, STAT_DT_INT, TRUE);
+    memset(krb_sample_estimated, 0, sizeof(krb_sample_estimated));
 }
 
-int
-dissect_krb5_ctime(proto_tree* tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx _U_)
+/* Count one sampled message, or add its weight when estimated is given */
+static void
+krb_sample_stats_tree_add(stats_tree* st, const gchar* name, int parent_id, guint64* estimated, guint weight)
 {
-    return dissect_kerberos_KerberosTime(FALSE, tvb, offset, actx, tree, hf_kerberos_ctime);
+    if (estimated == NULL) {
+        tick_stat_node(st, name, parent_id, FALSE);
+        return;
+    }
+    *estimated += weight;
+    set_stat_node(st, name, parent_id, FALSE,
+        (gint)MIN((*estimated + KRB_SAMPLE_WEIGHT_ONE / 2) / KRB_SAMPLE_WEIGHT_ONE, G_MAXINT));
 }
 
-
-int
-dissect_krb5_cname(proto_tree* tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx _U_)
+static void
+krb_sample_stats_tree_deep(stats_tree* st, const kerberos_sample_t* sample, const gchar* parent, int parent_id, guint64* estimated)
 {
-    return dissect_kerberos_PrincipalName(FALSE, tvb, offset, actx, tree, hf_kerberos_cname);
+    krb_sample_stats_tree_add(st, parent, 0,
+        estimated ? &estimated[KRB_SAMPLE_EST_ALL] : NULL, sample->weight);
+    if (sample->decrypted) {
+        krb_sample_stats_tree_add(st, "Decrypted", parent_id,
+            estimated ? &estimated[KRB_SAMPLE_EST_DECRYPTED] : NULL, sample->weight);
+    }
+    if (sample->missing_key) {
+        krb_sample_stats_tree_add(st, "Missing key", parent_id,
+            estimated ? &estimated[KRB_SAMPLE_EST_MISSING_KEY] : NULL, sample->weight);
+    }
+    if (sample->pkinit_cert) {
+        krb_sample_stats_tree_add(st, "PKINIT certificate", parent_id,
+            estimated ? &estimated[KRB_SAMPLE_EST_PKINIT_CERT] : NULL, sample->weight);
+    }
+    if (sample->pac) {
+        krb_sample_stats_tree_add(st, "PAC", parent_id,
+            estimated ? &estimated[KRB_SAMPLE_EST_PAC] : NULL, sample->weight);
+    }
 }
-int
-dissect_krb5_realm(proto_tree* tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx _U_)
+
+static tap_packet_status
+krb_sample_stats_tree_packet(stats_tree* st, packet_info* pinfo _U_, epan_dissect_t* edt _U_, const void* p)
 {
-    return dissect_kerberos_Realm(FALSE, tvb, offset, actx, tree, hf_kerberos_realm);
-}
+    const kerberos_sample_t* sample = (const kerberos_sample_t*)p;
+    guint i;
 
-struct kerberos_display_key_state {
-    proto_tree* tree;
-    packet_info* pinfo;
-    expert_field* expindex;
-    const char* name;
-    tvbuff_t* tvb;
-    gint start;
-    gint length;
-};
+    if (sample->msg_type < 0) {
+        return TAP_PACKET_DONT_REDRAW;
+    }
+    tick_stat_node(st, st_str_krb_sample_msgs, 0, FALSE);
+    tick_stat_node(st, val_to_str(sample->msg_type, kerberos_MESSAGE_TYPE_vals, "Unknown (%d)"),
+        st_node_krb_sample_msgs, FALSE);
+    if (sample->realm) {
+        tick_stat_node(st, st_str_krb_sample_realms, 0, FALSE);
+        tick_stat_node(st, sample->realm, st_node_krb_sample_realms, FALSE);
+    }
+    if (sample->have_error) {
+        tick_stat_node(st, st_str_krb_sample_errors, 0, FALSE);
+        tick_stat_node(st, val_to_str(sample->error_code, kerberos_ERROR_CODE_vals, "Unknown (%d)"),
+            st_node_krb_sample_errors, FALSE);
+    }
+    for (i = 0; i < sample->num_etypes; i++) {
+        tick_stat_node(st, st_str_krb_sample_etypes, 0, FALSE);
+        tick_stat_node(st, val_to_str(sample->etypes[i], kerberos_ENCTYPE_vals, "Unknown (%d)"),
+            st_node_krb_sample_etypes, FALSE);
+    }
+    if (sample->deep) {
+        krb_sample_stats_tree_deep(st, sample, st_str_krb_sample_sampled, st_node_krb_sample_sampled, NULL);
+        krb_sample_stats_tree_deep(st, sample, st_str_krb_sample_estimated, st_node_krb_sample_estimated,
+            krb_sample_estimated);
+    }
 
-static void
-#ifdef HAVE_KERBEROS
-kerberos_display_key(gpointer data, gpointer userdata)
-#else
-kerberos_display_key(gpointer data _U_, gpointer userdata _U_)
-#endif
+    return TAP_PACKET_REDRAW;
+}
+
+/*
+ * Dissect the Kerberos message at offset, after the record mark or tag
+ * checks; private_data may be NULL to have one allocated.
+ */
+static gint
+dissect_kerberos_pdu(tvbuff_t* tvb, packet_info* pinfo, proto_item* item, proto_tree* kerberos_tree,
+    int start_offset, kerberos_private_data_t* private_data, kerberos_callbacks* cb)
 {
-#ifdef HAVE_KERBEROS
-    struct kerberos_display_key_state* state =
-        (struct kerberos_display_key_state*)userdata;
-    const enc_key_t* ek = (const enc_key_t*)data;
-    proto_item* item = NULL;
-    enc_key_t* sek = NULL;
+    int offset = start_offset;
+    asn1_ctx_t asn1_ctx;
 
-    item = proto_tree_add_expert_format(state->tree,
-        state->pinfo,
-        state->expindex,
-        state->tvb,
-        state->start,
-        state->length,
-        "%s %s keytype %d (id=%s same=%u) (%02x%02x%02x%02x...)",
-        state->name,
-        ek->key_origin, ek->keytype,
-        ek->id_str, ek->num_same,
-        ek->keyvalue[0] & 0xFF, ek->keyvalue[1] & 0xFF,
-        ek->keyvalue[2] & 0xFF, ek->keyvalue[3] & 0xFF);
-    if (ek->src1 != NULL) {
-        sek = ek->src1;
-        expert_add_info_format(state->pinfo,
-            item,
-            state->expindex,
-            "SRC1 %s keytype %d (id=%s same=%u) (%02x%02x%02x%02x...)",
-            sek->key_origin, sek->keytype,
-            sek->id_str, sek->num_same,
-            sek->keyvalue[0] & 0xFF, sek->keyvalue[1] & 0xFF,
-            sek->keyvalue[2] & 0xFF, sek->keyvalue[3] & 0xFF);
+    if (*kerberos_shard_filename) {
+        return kerberos_shard_prepass(tvb, pinfo, item, start_offset);
     }
-    if (ek->src2 != NULL) {
-        sek = ek->src2;
-        expert_add_info_format(state->pinfo,
-            item,
-            state->expindex,
-            "SRC2 %s keytype %d (id=%s same=%u) (%02x%02x%02x%02x...)",
-            sek->key_origin, sek->keytype,
-            sek->id_str, sek->num_same,
-            sek->keyvalue[0] & 0xFF, sek->keyvalue[1] & 0xFF,
-            sek->keyvalue[2] & 0xFF, sek->keyvalue[3] & 0xFF);
+
+    asn1_ctx_init(&asn1_ctx, ASN1_ENC_BER, TRUE, pinfo);
+    asn1_ctx.private_data = private_data;
+    private_data = kerberos_get_private_data(&asn1_ctx);
+    private_data->callbacks = cb;
+    if (*kerberos_log_filename && !PINFO_FD_VISITED(pinfo)) {
+        private_data->log = wmem_new0(wmem_packet_scope(), kerberos_log_msg_t);
     }
-    sek = ek->same_list;
-    while (sek != NULL) {
-        expert_add_info_format(state->pinfo,
-            item,
-            state->expindex,
-            "%s %s keytype %d (id=%s same=%u) (%02x%02x%02x%02x...)",
-            state->name,
-            sek->key_origin, sek->keytype,
-            sek->id_str, sek->num_same,
-            sek->keyvalue[0] & 0xFF, sek->keyvalue[1] & 0xFF,
-            sek->keyvalue[2] & 0xFF, sek->keyvalue[3] & 0xFF);
-        sek = sek->same_list;
+    if (kerberos_live_mode && !PINFO_FD_VISITED(pinfo)) {
+        kerberos_live_sweep(pinfo);
     }
-#endif /* HAVE_KERBEROS */
+
+    offset = dissect_kerberos_Applications(FALSE, tvb, offset, &asn1_ctx , kerberos_tree, /* hf_index */ -1);
+
+    if (private_data->log) {
+        kerberos_log_message(pinfo, private_data);
+    }
+
+    if (kerberos_tree != NULL && private_data->learnt_keys != NULL) {
+        struct kerberos_display_key_state display_state = {
+                .tree = kerberos_tree,
+                .pinfo = pinfo,
+                .expindex = &ei_kerberos_learnt_keytype,
+                .name = "Provides",
+                .tvb = tvb,
+        };
+
+        wmem_list_foreach(private_data->learnt_keys,
+            kerberos_display_key,
+            &display_state);
+    }
+
+    if (kerberos_tree != NULL && private_data->missing_keys != NULL) {
+        struct kerberos_display_key_state display_state = {
+                .tree = kerberos_tree,
+                .pinfo = pinfo,
+                .expindex = &ei_kerberos_missing_keytype,
+                .name = "Missing",
+                .tvb = tvb,
+        };
+
+        wmem_list_foreach(private_data->missing_keys,
+            kerberos_display_key,
+            &display_state);
+    }
+
+    if (kerberos_tree != NULL && private_data->decryption_keys != NULL) {
+        struct kerberos_display_key_state display_state = {
+                .tree = kerberos_tree,
+                .pinfo = pinfo,
+                .expindex = &ei_kerberos_decrypted_keytype,
+                .name = "Used",
+                .tvb = tvb,
+        };
+
+        wmem_list_foreach(private_data->decryption_keys,
+            kerberos_display_key,
+            &display_state);
+    }
+
+    proto_item_set_len(item, offset);
+    return offset;
 }
 
 static gint
 dissect_kerberos_common(tvbuff_t* tvb, packet_info* pinfo, proto_tree* tree,
     gboolean dci, gboolean do_col_protocol, gboolean have_rm,
-    kerberos_callbacks* cb)
+    kerberos_private_data_t* private_data, kerberos_callbacks* cb)
 {
     volatile int offset = 0;
     proto_tree* volatile kerberos_tree = NULL;
     proto_item* volatile item = NULL;
-    kerberos_private_data_t* private_data = NULL;
-    asn1_ctx_t asn1_ctx;
 
     /* TCP record mark and length */
     guint32 krb_rm = 0;
@@ -7325,8 +12232,8 @@ dissect_kerberos_common(tvbuff_t* tvb, packet_info* pinfo, proto_tree* tree,
         gboolean tmp_pc;
         gint32 tmp_tag;
 
-        get_ber_identifier(tvb, offset, &tmp_class, &tmp_pc, &tmp_tag);
-        if (tmp_class != BER_CLASS_APP) {
+        if (try_get_ber_identifier(tvb, offset, &tmp_class, &tmp_pc, &tmp_tag) < 0 ||
+            tmp_class != BER_CLASS_APP) {
             return 0;
         }
         switch (tmp_tag) {
@@ -7357,65 +12264,352 @@ dissect_kerberos_common(tvbuff_t* tvb, packet_info* pinfo, proto_tree* tree,
         if (gbl_do_col_info) {
             col_clear(pinfo->cinfo, COL_INFO);
         }
-        if (tree) {
-            item = proto_tree_add_item(tree, proto_kerberos, tvb, 0, -1, ENC_NA);
-            kerberos_tree = proto_item_add_subtree(item, ett_kerberos);
+        if (tree) {
+            item = proto_tree_add_item(tree, proto_kerberos, tvb, 0, -1, ENC_NA);
+            kerberos_tree = proto_item_add_subtree(item, ett_kerberos);
+        }
+    }
+    return dissect_kerberos_pdu(tvb, pinfo, item, kerberos_tree, offset, private_data, cb);
+}
+
+/*
+ * Circuit breaker for port 88 conversations. Broken clients and traffic
+ * that is not Kerberos at all can send every message down the slowest
+ * paths: exceptions and trailing garbage. After kerberos_breaker_threshold
+ * such failures in a row the conversation gets header-only dissection and
+ * no trial decryption. An OID nobody registered is not a failure (a vendor
+ * certificate extension in well-formed PKINIT goes through
+ * dissect_unknown_ber() too), nor is a missing key (the missing-key index
+ * already keeps those from being retried for nothing), so a well-formed
+ * message always closes the breaker.
+ *
+ * A message whose header looks right (APPLICATION tag, SEQUENCE and pvno
+ * 5 covering the whole PDU) is dissected in full again; if that fails
+ * too, the next header-only run is twice as long, up to
+ * KRB_BREAKER_MAX_BACKOFF messages. A key learnt elsewhere ends the
+ * run early. The decision is kept per frame so later passes match.
+ * Live mode does not set up conversations just for this; there the
+ * breaker is kept by endpoint pair and dropped once it has been idle for
+ * kerberos_live_timeout seconds.
+ */
+typedef struct {
+    guint failures;         /* failed messages in a row */
+    gboolean open;          /* header-only */
+    guint skip;             /* header-only messages left before the next probe */
+    guint backoff;          /* length of the next header-only run */
+#if defined(HAVE_HEIMDAL_KERBEROS) || defined(HAVE_MIT_KERBEROS)
+    guint key_generation;   /* kerberos_key_generation when it opened */
+#endif
+    time_t last_seen;       /* live mode, kerberos_breaker_pairs only */
+} kerberos_breaker_t;
+
+#define KRB_BREAKER_MAX_BACKOFF 64
+
+/* Per-frame outcomes, stored with p_add_proto_data() */
+#define KRB_BREAKER_FULL        1
+#define KRB_BREAKER_TRIPPED     2   /* full, and this failure opened the breaker */
+#define KRB_BREAKER_RESUMED     3   /* full, and this success closed it */
+#define KRB_BREAKER_HEADER_ONLY 4
+
+static guint kerberos_breakers = 0;
+static wmem_map_t* kerberos_breaker_pairs = NULL; /* live mode: endpoint pair -> breaker */
+
+static void
+kerberos_mem_breakers(guint* count, guint64* bytes)
+{
+    *count = kerberos_breakers;
+    *bytes = (guint64)kerberos_breakers * (sizeof(kerberos_breaker_t) + BER_MEM_MAP_ENTRY);
+}
+
+static kerberos_breaker_t*
+kerberos_breaker_new(void)
+{
+    kerberos_breaker_t* breaker = wmem_new0(wmem_file_scope(), kerberos_breaker_t);
+
+    breaker->backoff = kerberos_breaker_threshold;
+    kerberos_breakers++;
+    return breaker;
+}
+
+/* The same for both directions */
+static char*
+kerberos_breaker_pair_key(packet_info* pinfo)
+{
+    int cmp = cmp_address(&pinfo->src, &pinfo->dst);
+
+    if (cmp < 0 || (cmp == 0 && pinfo->srcport <= pinfo->destport)) {
+        return kerberos_log_pair_key(&pinfo->src, pinfo->srcport, &pinfo->dst, pinfo->destport);
+    }
+    return kerberos_log_pair_key(&pinfo->dst, pinfo->destport, &pinfo->src, pinfo->srcport);
+}
+
+static kerberos_breaker_t*
+kerberos_breaker_get_pair(packet_info* pinfo)
+{
+    char* key = kerberos_breaker_pair_key(pinfo);
+    kerberos_breaker_t* breaker;
+
+    breaker = (kerberos_breaker_t*)wmem_map_lookup(kerberos_breaker_pairs, key);
+    if (breaker == NULL) {
+        breaker = kerberos_breaker_new();
+        wmem_map_insert(kerberos_breaker_pairs, wmem_strdup(wmem_file_scope(), key), breaker);
+    }
+    breaker->last_seen = pinfo->abs_ts.secs;
+    return breaker;
+}
+
+static void
+kerberos_breaker_collect_idle(gpointer key, gpointer value, gpointer user_data)
+{
+    GPtrArray* idle = (GPtrArray*)user_data;
+    kerberos_breaker_t* breaker = (kerberos_breaker_t*)value;
+    time_t now = *(time_t*)g_ptr_array_index(idle, 0);
+
+    if (now - breaker->last_seen >= (time_t)kerberos_live_timeout) {
+        g_ptr_array_add(idle, key);
+    }
+}
+
+/* Called from kerberos_live_sweep() */
+static void
+kerberos_breaker_sweep(time_t now)
+{
+    GPtrArray* idle;
+    guint i;
+
+    if (kerberos_breaker_pairs == NULL || wmem_map_size(kerberos_breaker_pairs) == 0) {
+        return;
+    }
+    /* the first slot carries the time */
+    idle = g_ptr_array_new();
+    g_ptr_array_add(idle, &now);
+    wmem_map_foreach(kerberos_breaker_pairs, kerberos_breaker_collect_idle, idle);
+    for (i = 1; i < idle->len; i++) {
+        char* key = (char*)g_ptr_array_index(idle, i);
+
+        wmem_free(wmem_file_scope(), wmem_map_remove(kerberos_breaker_pairs, key));
+        wmem_free(wmem_file_scope(), key);
+        kerberos_breakers--;
+    }
+    g_ptr_array_free(idle, TRUE);
+}
+
+static kerberos_breaker_t*
+kerberos_breaker_get(packet_info* pinfo)
+{
+    conversation_t* conversation;
+    kerberos_breaker_t* breaker;
+
+    if (kerberos_live_mode) {
+        conversation = find_conversation_pinfo(pinfo, 0);
+        if (conversation == NULL) {
+            return kerberos_breaker_get_pair(pinfo);
+        }
+    } else {
+        conversation = find_or_create_conversation(pinfo);
+    }
+    breaker = (kerberos_breaker_t*)conversation_get_proto_data(conversation, proto_kerberos);
+    if (breaker == NULL) {
+        breaker = kerberos_breaker_new();
+        conversation_add_proto_data(conversation, proto_kerberos, breaker);
+    }
+    return breaker;
+}
+
+/* A header that is worth a full dissection: see the comment above */
+static gboolean
+kerberos_breaker_probe(tvbuff_t* tvb, int offset)
+{
+    gint8 ber_class;
+    gboolean pc;
+    gint32 tag;
+    guint32 len, seq_len;
+    int contents, seq_contents;
+    guint8 pvno_tag;
+
+    contents = try_get_ber_tl(tvb, offset, &ber_class, &pc, &tag, &len);
+    if (contents < 0 || ber_class != BER_CLASS_APP || !pc ||
+        (guint32)contents + len != tvb_reported_length(tvb)) {
+        return FALSE;
+    }
+    switch (tag) {
+    case KRB5_MSG_AS_REQ:
+    case KRB5_MSG_TGS_REQ:
+        pvno_tag = 0xa1;
+        break;
+    case KRB5_MSG_AS_REP:
+    case KRB5_MSG_TGS_REP:
+    case KRB5_MSG_AP_REQ:
+    case KRB5_MSG_AP_REP:
+    case KRB5_MSG_SAFE:
+    case KRB5_MSG_PRIV:
+    case KRB5_MSG_CRED:
+    case KRB5_MSG_ERROR:
+        pvno_tag = 0xa0;
+        break;
+    default:
+        return FALSE;
+    }
+    seq_contents = try_get_ber_tl(tvb, contents, &ber_class, &pc, &tag, &seq_len);
+    if (seq_contents < 0 || ber_class != BER_CLASS_UNI || tag != BER_UNI_TAG_SEQUENCE ||
+        (guint32)seq_contents + seq_len != (guint32)contents + len || seq_len < 5) {
+        return FALSE;
+    }
+    /* [0] or [1] INTEGER 5 */
+    return tvb_get_guint8(tvb, seq_contents) == pvno_tag &&
+        tvb_get_ntoh24(tvb, seq_contents + 1) == 0x030201 &&
+        tvb_get_guint8(tvb, seq_contents + 4) == 5;
+}
+
+/* Header-only or full for this message, on the first pass */
+static guint
+kerberos_breaker_decide(kerberos_breaker_t* breaker, tvbuff_t* tvb, int offset)
+{
+    if (breaker == NULL || !breaker->open) {
+        return KRB_BREAKER_FULL;
+    }
+#if defined(HAVE_HEIMDAL_KERBEROS) || defined(HAVE_MIT_KERBEROS)
+    if (breaker->key_generation != kerberos_key_generation) {
+        breaker->skip = 0;
+    }
+#endif
+    if (breaker->skip > 0) {
+        breaker->skip--;
+        return KRB_BREAKER_HEADER_ONLY;
+    }
+    return kerberos_breaker_probe(tvb, offset) ? KRB_BREAKER_FULL : KRB_BREAKER_HEADER_ONLY;
+}
+
+/* Account for a fully dissected message; returns its outcome */
+static guint
+kerberos_breaker_result(kerberos_breaker_t* breaker, gboolean failed)
+{
+    if (breaker == NULL) {
+        return KRB_BREAKER_FULL;
+    }
+    if (!failed) {
+        breaker->failures = 0;
+        if (breaker->open) {
+            breaker->open = FALSE;
+            breaker->backoff = kerberos_breaker_threshold;
+            return KRB_BREAKER_RESUMED;
         }
+        return KRB_BREAKER_FULL;
     }
-    asn1_ctx_init(&asn1_ctx, ASN1_ENC_BER, TRUE, pinfo);
-    asn1_ctx.private_data = NULL;
-    private_data = kerberos_get_private_data(&asn1_ctx);
-    private_data->callbacks = cb;
+    if (breaker->open) {
+        /* the probe let it through, but it failed all the same */
+        breaker->backoff = MIN(breaker->backoff * 2, KRB_BREAKER_MAX_BACKOFF);
+    } else if (++breaker->failures < kerberos_breaker_threshold) {
+        return KRB_BREAKER_FULL;
+    }
+    breaker->open = TRUE;
+    breaker->skip = breaker->backoff;
+#if defined(HAVE_HEIMDAL_KERBEROS) || defined(HAVE_MIT_KERBEROS)
+    breaker->key_generation = kerberos_key_generation;
+#endif
+    return breaker->failures >= kerberos_breaker_threshold ? KRB_BREAKER_TRIPPED : KRB_BREAKER_FULL;
+}
 
-    TRY{
-            offset = dissect_kerberos_Applications(FALSE, tvb, offset, &asn1_ctx , kerberos_tree, /* hf_index */ -1);
-    } CATCH_BOUNDS_ERRORS{
-            RETHROW;
-    } ENDTRY;
+/* Did a message that did not throw fail all the same: nothing dissected, or trailing garbage? */
+static gboolean
+kerberos_breaker_failed(tvbuff_t* tvb, gint offset)
+{
+    return offset <= 0 || (guint)offset < tvb_reported_length(tvb);
+}
 
-    if (kerberos_tree != NULL) {
-        struct kerberos_display_key_state display_state = {
-                .tree = kerberos_tree,
-                .pinfo = pinfo,
-                .expindex = &ei_kerberos_learnt_keytype,
-                .name = "Provides",
-                .tvb = tvb,
-        };
+static gint
+dissect_kerberos_header_only(tvbuff_t* tvb, packet_info* pinfo, proto_tree* tree, gboolean have_rm, expert_field* why)
+{
+    proto_item* item;
+    proto_tree* kerberos_tree;
+    int offset = 0;
+    gint8 ber_class;
+    gboolean pc;
+    gint32 tag;
 
-        wmem_list_foreach(private_data->learnt_keys,
-            kerberos_display_key,
-            &display_state);
+    col_set_str(pinfo->cinfo, COL_PROTOCOL, "KRB5");
+    item = proto_tree_add_item(tree, proto_kerberos, tvb, 0, -1, ENC_NA);
+    kerberos_tree = proto_item_add_subtree(item, ett_kerberos);
+    if (have_rm) {
+        show_krb_recordmark(kerberos_tree, tvb, offset, tvb_get_ntohl(tvb, offset));
+        offset += 4;
     }
+    if (try_get_ber_identifier(tvb, offset, &ber_class, &pc, &tag) >= 0 && ber_class == BER_CLASS_APP) {
+        col_add_str(pinfo->cinfo, COL_INFO, val_to_str(tag, kerberos_MESSAGE_TYPE_vals, "Unknown (%d)"));
+        proto_item_append_text(item, ", %s", val_to_str(tag, kerberos_MESSAGE_TYPE_vals, "Unknown (%d)"));
+    } else {
+        col_set_str(pinfo->cinfo, COL_INFO, "Not Kerberos");
+    }
+    expert_add_info(pinfo, item, why);
 
-    if (kerberos_tree != NULL) {
-        struct kerberos_display_key_state display_state = {
-                .tree = kerberos_tree,
-                .pinfo = pinfo,
-                .expindex = &ei_kerberos_missing_keytype,
-                .name = "Missing",
-                .tvb = tvb,
-        };
+    return tvb_captured_length(tvb);
+}
 
-        wmem_list_foreach(private_data->missing_keys,
-            kerberos_display_key,
-            &display_state);
+/*
+ * The UDP and TCP entry points: dissect_kerberos_common() behind the
+ * sampling and the circuit breaker.
+ */
+static gint
+dissect_kerberos_guarded(tvbuff_t* tvb, packet_info* pinfo, proto_tree* tree, gboolean have_rm)
+{
+    kerberos_breaker_t* breaker = NULL;
+    kerberos_private_data_t* private_data;
+    kerberos_sample_t* sample = NULL;
+    guint outcome;
+    volatile gint offset = 0;
+    guint key = (guint)tvb_raw_offset(tvb);
+
+    if (kerberos_sample_mode != KRB_SAMPLE_OFF) {
+        sample = kerberos_sample_message(tvb, pinfo, have_rm ? 4 : 0);
+        if (sample->weight == 0) {
+            return dissect_kerberos_header_only(tvb, pinfo, tree, have_rm, &ei_kerberos_sample_header_only);
+        }
     }
 
-    if (kerberos_tree != NULL) {
-        struct kerberos_display_key_state display_state = {
-                .tree = kerberos_tree,
-                .pinfo = pinfo,
-                .expindex = &ei_kerberos_decrypted_keytype,
-                .name = "Used",
-                .tvb = tvb,
-        };
+    private_data = kerberos_new_private_data();
+    if (kerberos_breaker_threshold == 0) {
+        offset = dissect_kerberos_common(tvb, pinfo, tree, TRUE, TRUE, have_rm, private_data, NULL);
+        kerberos_sample_deep(sample, pinfo, private_data);
+        return offset;
+    }
 
-        wmem_list_foreach(private_data->decryption_keys,
-            kerberos_display_key,
-            &display_state);
+    if (!PINFO_FD_VISITED(pinfo)) {
+        breaker = kerberos_breaker_get(pinfo);
+        outcome = kerberos_breaker_decide(breaker, tvb, have_rm ? 4 : 0);
+    } else {
+        outcome = GPOINTER_TO_UINT(p_get_proto_data(wmem_file_scope(), pinfo, proto_kerberos, key));
+    }
+    if (outcome == KRB_BREAKER_HEADER_ONLY) {
+        if (!PINFO_FD_VISITED(pinfo)) {
+            p_add_proto_data(wmem_file_scope(), pinfo, proto_kerberos, key, GUINT_TO_POINTER(outcome));
+        }
+        return dissect_kerberos_header_only(tvb, pinfo, tree, have_rm, &ei_kerberos_breaker_header_only);
+    }
+
+    TRY {
+        offset = dissect_kerberos_common(tvb, pinfo, tree, TRUE, TRUE, have_rm, private_data, NULL);
+    } CATCH_ALL {
+        if (!PINFO_FD_VISITED(pinfo)) {
+            outcome = kerberos_breaker_result(breaker, TRUE);
+            p_add_proto_data(wmem_file_scope(), pinfo, proto_kerberos, key, GUINT_TO_POINTER(outcome));
+        }
+        RETHROW;
+    } ENDTRY;
+
+    if (!PINFO_FD_VISITED(pinfo)) {
+        outcome = kerberos_breaker_result(breaker,
+            kerberos_breaker_failed(tvb, offset));
+        p_add_proto_data(wmem_file_scope(), pinfo, proto_kerberos, key, GUINT_TO_POINTER(outcome));
+    }
+    kerberos_sample_deep(sample, pinfo, private_data);
+    if (outcome == KRB_BREAKER_TRIPPED) {
+        proto_tree_add_expert_format(tree, pinfo, &ei_kerberos_breaker_tripped, tvb, 0, 0,
+            "%u failed Kerberos messages in a row: header-only dissection for this conversation"
+            " until a well-formed message turns up", kerberos_breaker_threshold);
+    } else if (outcome == KRB_BREAKER_RESUMED) {
+        proto_tree_add_expert(tree, pinfo, &ei_kerberos_breaker_resumed, tvb, 0, 0);
     }
 
-    proto_item_set_len(item, offset);
     return offset;
 }
 
@@ -7441,7 +12635,269 @@ show_krb_recordmark(proto_tree* tree, tvbuff_t* tvb, gint start, guint32 krb_rm)
 gint
 dissect_kerberos_main(tvbuff_t* tvb, packet_info* pinfo, proto_tree* tree, int do_col_info, kerberos_callbacks* cb)
 {
-    return (dissect_kerberos_common(tvb, pinfo, tree, do_col_info, FALSE, FALSE, cb));
+    return (dissect_kerberos_common(tvb, pinfo, tree, do_col_info, FALSE, FALSE, NULL, cb));
+}
+
+gint
+dissect_kerberos_gss_token(tvbuff_t* tvb, packet_info* pinfo, proto_tree* tree, kerberos_callbacks* cb)
+{
+    volatile gint offset = 0;
+    proto_tree* kerberos_tree = NULL;
+    proto_item* item = NULL;
+    kerberos_private_data_t* volatile private_data;
+
+    gbl_do_col_info = FALSE;
+
+    if (tree) {
+        item = proto_tree_add_item(tree, proto_kerberos, tvb, 0, -1, ENC_NA);
+        kerberos_tree = proto_item_add_subtree(item, ett_kerberos);
+    }
+
+    private_data = kerberos_gss_private_data_get();
+    TRY{
+            offset = dissect_kerberos_pdu(tvb, pinfo, item, kerberos_tree, 0, private_data, cb);
+    } FINALLY{
+            kerberos_gss_private_data_release(private_data);
+    } ENDTRY;
+
+    return offset;
+}
+
+/*
+ * Token scanner: a heuristic for any TCP or UDP payload that picks out
+ * the GSS-API Kerberos tokens carried by SMB2 session setups, LDAP SASL
+ * binds, HTTP Negotiate headers, DCE/RPC auth trailers and NEGOEX,
+ * without dissecting those protocols first. It is disabled by default;
+ * together with "Try heuristic sub-dissectors first" it lets a run that
+ * only wants the keys skip the protocol stacks.
+ *
+ * Candidates are found with ws_mempbrk (SSE4.2 where the CPU has it):
+ * 0x60 for an InitialContextToken, 'N' for "NEGOEXTS" and "Negotiate ",
+ * 'K' for "Kerberos ". Every candidate is checked with the non-throwing
+ * BER header decoder before it goes to dissect_kerberos_gss_token().
+ * Tokens split across segments are not found.
+ */
+static ws_mempbrk_pattern kerberos_scan_pattern;
+
+/* 1.2.840.113554.1.2.2, and the 1.2.840.48018.1.2.2 Windows sends */
+static const guint8 kerberos_scan_oid_krb5[] = { 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x12, 0x01, 0x02, 0x02 };
+static const guint8 kerberos_scan_oid_ms_krb5[] = { 0x2a, 0x86, 0x48, 0x82, 0xf7, 0x12, 0x01, 0x02, 0x02 };
+
+#define KRB_SCAN_MIN_BASE64     16  /* shorter Negotiate blobs are not worth decoding */
+#define KRB_SCAN_NEGOEX_HEADER  40
+
+static guint kerberos_scan_tvb(tvbuff_t* tvb, packet_info* pinfo, proto_tree* tree, gboolean base64);
+
+/*
+ * Is there an AP-REQ, AP-REP or KRB-ERROR at offset that ends by end?
+ */
+static gboolean
+kerberos_scan_is_message(tvbuff_t* tvb, int offset, int end, int* msg_end)
+{
+    gint8 ber_class;
+    gboolean pc;
+    gint32 tag;
+    guint32 len;
+    int contents;
+
+    contents = try_get_ber_tl(tvb, offset, &ber_class, &pc, &tag, &len);
+    if (contents < 0 || ber_class != BER_CLASS_APP || !pc) {
+        return FALSE;
+    }
+    if (tag != KRB5_MSG_AP_REQ && tag != KRB5_MSG_AP_REP && tag != KRB5_MSG_ERROR) {
+        return FALSE;
+    }
+    if (contents > end || len > (guint32)(end - contents)) {
+        return FALSE;
+    }
+    *msg_end = contents + len;
+    return TRUE;
+}
+
+static void
+kerberos_scan_hand_off(tvbuff_t* tvb, packet_info* pinfo, proto_tree* tree, int offset, int end, guint* found)
+{
+    tvbuff_t* token_tvb = tvb_new_subset_length(tvb, offset, end - offset);
+
+    (*found)++;
+    TRY {
+        dissect_kerberos_gss_token(token_tvb, pinfo, tree, NULL);
+    } CATCH_NONFATAL_ERRORS {
+        show_exception(token_tvb, pinfo, tree, EXCEPT_CODE, GET_MESSAGE);
+    } ENDTRY;
+}
+
+/*
+ * An InitialContextToken with a Kerberos mech and token id (RFC 1964
+ * section 1.1); returns the offset after it, or -1.
+ */
+static int
+kerberos_scan_gss(tvbuff_t* tvb, packet_info* pinfo, proto_tree* tree, int offset, guint* found)
+{
+    gint8 ber_class;
+    gboolean pc;
+    gint32 tag;
+    guint32 len;
+    int contents, end, msg_end;
+
+    contents = try_get_ber_tl(tvb, offset, &ber_class, &pc, &tag, &len);
+    if (contents < 0 || ber_class != BER_CLASS_APP || !pc || tag != 0) {
+        return -1;
+    }
+    end = contents + len;
+    /* OBJECT IDENTIFIER, then the two octet TOK_ID */
+    if (len < 2 + sizeof(kerberos_scan_oid_krb5) + 2 ||
+        tvb_get_guint8(tvb, contents) != 0x06 ||
+        tvb_get_guint8(tvb, contents + 1) != sizeof(kerberos_scan_oid_krb5)) {
+        return -1;
+    }
+    if (tvb_memeql(tvb, contents + 2, kerberos_scan_oid_krb5, sizeof(kerberos_scan_oid_krb5)) != 0 &&
+        tvb_memeql(tvb, contents + 2, kerberos_scan_oid_ms_krb5, sizeof(kerberos_scan_oid_ms_krb5)) != 0) {
+        return -1;
+    }
+    contents += 2 + sizeof(kerberos_scan_oid_krb5) + 2;
+    if (!kerberos_scan_is_message(tvb, contents, end, &msg_end)) {
+        return -1;
+    }
+
+    kerberos_scan_hand_off(tvb, pinfo, tree, contents, msg_end, found);
+    return end;
+}
+
+/*
+ * A NEGOEX exchange message. An exchange that is a GSS token is found
+ * by the scan going on through the message; only a bare Kerberos
+ * message is handed over from here.
+ */
+static int
+kerberos_scan_negoex(tvbuff_t* tvb, packet_info* pinfo, proto_tree* tree, int offset, guint* found)
+{
+    guint32 message_type, message_len, exchange_offset, exchange_len;
+    int msg_end;
+
+    if (!tvb_bytes_exist(tvb, offset, KRB_SCAN_NEGOEX_HEADER + 16 + 8) ||
+        tvb_strneql(tvb, offset, "NEGOEXTS", 8) != 0) {
+        return -1;
+    }
+    /* INITIATOR_META_DATA, ACCEPTOR_META_DATA, CHALLENGE and AP_REQUEST */
+    message_type = tvb_get_letohl(tvb, offset + 8);
+    if (message_type < 2 || message_type > 5) {
+        return offset + 8;
+    }
+    message_len = tvb_get_letohl(tvb, offset + 20);
+    exchange_offset = tvb_get_letohl(tvb, offset + KRB_SCAN_NEGOEX_HEADER + 16);
+    exchange_len = tvb_get_letohs(tvb, offset + KRB_SCAN_NEGOEX_HEADER + 16 + 4);
+    if (exchange_len == 0 || exchange_offset > message_len || exchange_len > message_len - exchange_offset ||
+        !tvb_bytes_exist(tvb, offset + exchange_offset, exchange_len)) {
+        return offset + 8;
+    }
+    offset += exchange_offset;
+    if (tvb_get_guint8(tvb, offset) == 0x60 ||
+        !kerberos_scan_is_message(tvb, offset, offset + exchange_len, &msg_end)) {
+        return offset;
+    }
+
+    kerberos_scan_hand_off(tvb, pinfo, tree, offset, msg_end, found);
+    return msg_end;
+}
+
+/*
+ * "Negotiate <base64>" or "Kerberos <base64>" from an HTTP (or SIP, RTSP)
+ * authentication header; the decoded blob is scanned in turn.
+ */
+static int
+kerberos_scan_base64(tvbuff_t* tvb, packet_info* pinfo, proto_tree* tree, int offset, guint* found)
+{
+    int start, end, length;
+    guint n;
+    gchar* blob;
+    gsize blob_len;
+    tvbuff_t* blob_tvb;
+
+    if (tvb_strneql(tvb, offset, "Negotiate ", 10) == 0) {
+        start = offset + 10;
+    } else if (tvb_strneql(tvb, offset, "Kerberos ", 9) == 0) {
+        start = offset + 9;
+    } else {
+        return -1;
+    }
+
+    length = tvb_captured_length(tvb);
+    for (end = start; end < length; end++) {
+        guint8 c = tvb_get_guint8(tvb, end);
+
+        if (!g_ascii_isalnum(c) && c != '+' && c != '/' && c != '=') {
+            break;
+        }
+    }
+    if (end - start < KRB_SCAN_MIN_BASE64) {
+        return end;
+    }
+
+    blob = (gchar*)tvb_get_string_enc(wmem_packet_scope(), tvb, start, end - start, ENC_ASCII);
+    g_base64_decode_inplace(blob, &blob_len);
+    if (blob_len == 0) {
+        return end;
+    }
+    blob_tvb = tvb_new_child_real_data(tvb, (const guint8*)blob, (guint)blob_len, (gint)blob_len);
+    n = kerberos_scan_tvb(blob_tvb, pinfo, tree, FALSE);
+    if (n > 0) {
+        add_new_data_source(pinfo, blob_tvb, "Decoded Negotiate token");
+        *found += n;
+    }
+    return end;
+}
+
+static guint
+kerberos_scan_tvb(tvbuff_t* tvb, packet_info* pinfo, proto_tree* tree, gboolean base64)
+{
+    int offset = 0;
+    int length = tvb_captured_length(tvb);
+    guint found = 0;
+
+    while (offset < length) {
+        guchar needle;
+        int next = -1;
+
+        offset = tvb_ws_mempbrk_pattern_guint8(tvb, offset, -1, &kerberos_scan_pattern, &needle);
+        if (offset < 0) {
+            break;
+        }
+        switch (needle) {
+        case 0x60:
+            next = kerberos_scan_gss(tvb, pinfo, tree, offset, &found);
+            break;
+        case 'N':
+            next = kerberos_scan_negoex(tvb, pinfo, tree, offset, &found);
+            if (next < 0 && base64) {
+                next = kerberos_scan_base64(tvb, pinfo, tree, offset, &found);
+            }
+            break;
+        case 'K':
+            if (base64) {
+                next = kerberos_scan_base64(tvb, pinfo, tree, offset, &found);
+            }
+            break;
+        }
+        offset = next > offset ? next : offset + 1;
+    }
+
+    return found;
+}
+
+static gboolean
+dissect_kerberos_scan_heur(tvbuff_t* tvb, packet_info* pinfo, proto_tree* tree, void* data _U_)
+{
+    guint found;
+
+    found = kerberos_scan_tvb(tvb, pinfo, tree, TRUE);
+    if (found == 0) {
+        return FALSE;
+    }
+
+    col_set_str(pinfo->cinfo, COL_PROTOCOL, "KRB5");
+    col_add_fstr(pinfo->cinfo, COL_INFO, "%u embedded Kerberos token%s", found, plurality(found, "", "s"));
+    return TRUE;
 }
 
 guint32
@@ -7473,7 +12929,7 @@ dissect_kerberos_udp(tvbuff_t* tvb, packet_info* pinfo, proto_tree* tree, void*
     }
 
 
-    return dissect_kerberos_common(tvb, pinfo, tree, TRUE, TRUE, FALSE, NULL);
+    return dissect_kerberos_guarded(tvb, pinfo, tree, FALSE);
 }
 
 gint
@@ -7500,17 +12956,43 @@ kerberos_prefs_apply_cb(void) {
 #endif
 }
 
+/* The frame the TCP segments of this reassembled message started in, or 0 */
+static guint32
+kerberos_tcp_pdu_first(packet_info* pinfo, struct tcpinfo* tcpinfo)
+{
+    conversation_t* conv;
+    struct tcp_analysis* tcpd;
+    struct tcp_multisegment_pdu* msp;
+
+    if (tcpinfo == NULL || !tcpinfo->is_reassembled) {
+        return 0;
+    }
+    conv = find_conversation_pinfo(pinfo, 0);
+    tcpd = conv ? get_tcp_conversation_data(conv, pinfo) : NULL;
+    if (tcpd == NULL || tcpd->fwd == NULL || tcpd->fwd->multisegment_pdus == NULL) {
+        return 0;
+    }
+    msp = (struct tcp_multisegment_pdu*)wmem_tree_lookup32_le(tcpd->fwd->multisegment_pdus, tcpinfo->seq);
+    if (msp == NULL || tcpinfo->seq >= msp->nxtpdu) {
+        return 0;
+    }
+    return msp->first_frame;
+}
+
 static int
-dissect_kerberos_tcp_pdu(tvbuff_t* tvb, packet_info* pinfo, proto_tree* tree, void* data _U_)
+dissect_kerberos_tcp_pdu(tvbuff_t* tvb, packet_info* pinfo, proto_tree* tree, void* data)
 {
     pinfo->fragmented = TRUE;
-    if (dissect_kerberos_common(tvb, pinfo, tree, TRUE, TRUE, TRUE, NULL) < 0) {
+    kerberos_shard_pdu_first = (*kerberos_shard_filename && !PINFO_FD_VISITED(pinfo)) ?
+        kerberos_tcp_pdu_first(pinfo, (struct tcpinfo*)data) : 0;
+    if (dissect_kerberos_guarded(tvb, pinfo, tree, TRUE) < 0) {
         /*
          * The dissector failed to recognize this as a valid
          * Kerberos message.  Mark it as a continuation packet.
          */
         col_set_str(pinfo->cinfo, COL_INFO, "Continuation");
     }
+    kerberos_shard_pdu_first = 0;
 
     return tvb_captured_length(tvb);
 }
@@ -7697,6 +13179,54 @@ void proto_register_kerberos(void) {
     { &hf_krb_pac_device_claims_info, {
             "PAC_DEVICE_CLAIMS_INFO", "kerberos.pac_device_claims_info", FT_BYTES, BASE_NONE,
             NULL, 0, "PAC_DEVICE_CLAIMS_INFO structure", HFILL }},
+    { &hf_krb_pac_claims_set_size, {
+            "Claims Set Size", "kerberos.pac.claims.set_size", FT_UINT32, BASE_DEC,
+            NULL, 0, NULL, HFILL }},
+    { &hf_krb_pac_claims_compression, {
+            "Compression Format", "kerberos.pac.claims.compression", FT_UINT16, BASE_DEC,
+            VALS(krb_pac_claims_compression_vals), 0, NULL, HFILL }},
+    { &hf_krb_pac_claims_uncompressed_size, {
+            "Uncompressed Size", "kerberos.pac.claims.uncompressed_size", FT_UINT32, BASE_DEC,
+            NULL, 0, NULL, HFILL }},
+    { &hf_krb_pac_claims_reserved_type, {
+            "Reserved Type", "kerberos.pac.claims.reserved_type", FT_UINT16, BASE_DEC,
+            NULL, 0, NULL, HFILL }},
+    { &hf_krb_pac_claims_reserved_size, {
+            "Reserved Field Size", "kerberos.pac.claims.reserved_size", FT_UINT32, BASE_DEC,
+            NULL, 0, NULL, HFILL }},
+    { &hf_krb_pac_claims_set, {
+            "Claims Set", "kerberos.pac.claims.set", FT_BYTES, BASE_NONE,
+            NULL, 0, "CLAIMS_SET, as sent", HFILL }},
+    { &hf_krb_pac_claims_array_count, {
+            "Claims Array Count", "kerberos.pac.claims.array_count", FT_UINT32, BASE_DEC,
+            NULL, 0, NULL, HFILL }},
+    { &hf_krb_pac_claims_source_type, {
+            "Claims Source Type", "kerberos.pac.claims.source_type", FT_UINT16, BASE_DEC,
+            VALS(krb_pac_claims_source_vals), 0, NULL, HFILL }},
+    { &hf_krb_pac_claims_count, {
+            "Claims Count", "kerberos.pac.claims.count", FT_UINT32, BASE_DEC,
+            NULL, 0, NULL, HFILL }},
+    { &hf_krb_pac_claim_id, {
+            "Claim Id", "kerberos.pac.claim.id", FT_STRING, BASE_NONE,
+            NULL, 0, NULL, HFILL }},
+    { &hf_krb_pac_claim_type, {
+            "Claim Type", "kerberos.pac.claim.type", FT_UINT16, BASE_DEC,
+            VALS(krb_pac_claim_type_vals), 0, NULL, HFILL }},
+    { &hf_krb_pac_claim_value_count, {
+            "Value Count", "kerberos.pac.claim.value_count", FT_UINT32, BASE_DEC,
+            NULL, 0, NULL, HFILL }},
+    { &hf_krb_pac_claim_int64, {
+            "Value", "kerberos.pac.claim.int64", FT_INT64, BASE_DEC,
+            NULL, 0, NULL, HFILL }},
+    { &hf_krb_pac_claim_uint64, {
+            "Value", "kerberos.pac.claim.uint64", FT_UINT64, BASE_DEC,
+            NULL, 0, NULL, HFILL }},
+    { &hf_krb_pac_claim_string, {
+            "Value", "kerberos.pac.claim.string", FT_STRING, BASE_NONE,
+            NULL, 0, NULL, HFILL }},
+    { &hf_krb_pac_claim_boolean, {
+            "Value", "kerberos.pac.claim.boolean", FT_BOOLEAN, BASE_NONE,
+            NULL, 0, NULL, HFILL }},
     { &hf_krb_pa_supported_enctypes,
       { "SupportedEnctypes", "kerberos.supported_entypes",
         FT_UINT32, BASE_HEX, NULL, 0, NULL, HFILL }},
@@ -7739,7 +13269,23 @@ void proto_register_kerberos(void) {
     { &hf_krb_key_hidden_item,
       { "KeyHiddenItem", "krb5.key_hidden_item",
         FT_NONE, BASE_NONE, NULL, 0x0, NULL, HFILL }},
+    { &hf_krb_pkinit_layout,
+      { "PKINIT Layout", "kerberos.pkinit.layout",
+        FT_UINT32, BASE_DEC, VALS(krb_pkinit_layout_vals), 0x0,
+        "PA-DATA layout detected from the outer tags of the PA value", HFILL }},
 #ifdef HAVE_KERBEROS
+    { &hf_krb_decrypted_usage,
+      { "Key Usage", "kerberos.decrypted.usage",
+        FT_UINT32, BASE_DEC, NULL, 0x0,
+        "Key usage the exported plaintext was decrypted with", HFILL }},
+    { &hf_krb_decrypted_origin_frame,
+      { "Origin Frame", "kerberos.decrypted.origin_frame",
+        FT_UINT32, BASE_DEC, NULL, 0x0,
+        "Frame of the original capture holding the ciphertext", HFILL }},
+    { &hf_krb_decrypted_key_id,
+      { "Key Id", "kerberos.decrypted.key_id",
+        FT_STRING, BASE_NONE, NULL, 0x0,
+        "Id of the key the plaintext was decrypted with", HFILL }},
         { &hf_kerberos_KrbFastResponse,
            { "KrbFastResponse", "kerberos.KrbFastResponse_element",
             FT_NONE, BASE_NONE, NULL, 0, NULL, HFILL }},
@@ -8699,6 +14245,11 @@ void proto_register_kerberos(void) {
             &ett_krb_pac_s4u_delegation_info,
             &ett_krb_pac_upn_dns_info,
             &ett_krb_pac_device_info,
+            &ett_krb_pac_client_claims_info,
+            &ett_krb_pac_device_claims_info,
+            &ett_krb_pac_claims_set,
+            &ett_krb_pac_claims_array,
+            &ett_krb_pac_claim_entry,
             &ett_krb_pac_server_checksum,
             &ett_krb_pac_privsvr_checksum,
             &ett_krb_pac_client_info_type,
@@ -8706,6 +14257,7 @@ void proto_register_kerberos(void) {
             &ett_krb_ad_ap_options,
 #ifdef HAVE_KERBEROS
                 & ett_krb_pa_enc_ts_enc,
+            &ett_krb_decrypted,
             &ett_kerberos_KrbFastFinished,
             &ett_kerberos_KrbFastResponse,
         &ett_kerberos_KrbFastReq,
@@ -8797,6 +14349,11 @@ void proto_register_kerberos(void) {
             { &ei_kerberos_learnt_keytype, { "kerberos.learnt_keytype", PI_SECURITY, PI_CHAT, "Learnt keytype", EXPFILL }},
             { &ei_kerberos_address, { "kerberos.address.unknown", PI_UNDECODED, PI_WARN, "KRB Address: I don't know how to parse this type of address yet", EXPFILL }},
             { &ei_krb_gssapi_dlglen, { "kerberos.gssapi.dlglen.error", PI_MALFORMED, PI_ERROR, "DlgLen is not the same as number of bytes remaining", EXPFILL }},
+            { &ei_krb_pac_claims_decompress, { "kerberos.pac.claims.decompress_failed", PI_MALFORMED, PI_WARN, "Claims set does not decompress to its stated size", EXPFILL }},
+            { &ei_kerberos_breaker_tripped, { "kerberos.breaker.tripped", PI_PROTOCOL, PI_WARN, "Conversation switched to header-only dissection", EXPFILL }},
+            { &ei_kerberos_breaker_header_only, { "kerberos.breaker.header_only", PI_PROTOCOL, PI_NOTE, "Header only: this conversation keeps failing to dissect, no trial decryption", EXPFILL }},
+            { &ei_kerberos_breaker_resumed, { "kerberos.breaker.resumed", PI_PROTOCOL, PI_CHAT, "Well-formed message, full dissection resumed for this conversation", EXPFILL }},
+            { &ei_kerberos_sample_header_only, { "kerberos.sample.header_only", PI_PROTOCOL, PI_CHAT, "Header only: not in the sample", EXPFILL }},
     };
 
     expert_module_t* expert_krb;
@@ -8804,6 +14361,7 @@ void proto_register_kerberos(void) {
 
     proto_kerberos = proto_register_protocol("Kerberos", "KRB5", "kerberos");
     proto_register_field_array(proto_kerberos, hf, array_length(hf));
+    ber_schema_register(kerberos_schema_fields, array_length(kerberos_schema_fields));
     proto_register_subtree_array(ett, array_length(ett));
     expert_krb = expert_register_protocol(proto_kerberos);
     expert_register_field_array(expert_krb, ei, array_length(ei));
@@ -8815,6 +14373,74 @@ void proto_register_kerberos(void) {
         "Whether the Kerberos dissector should reassemble messages spanning multiple TCP segments."
         " To use this option, you must also enable \"Allow subdissectors to reassemble TCP streams\" in the TCP protocol settings.",
         &krb_desegment);
+    prefs_register_filename_preference(krb_module, "exchange_log",
+        "Exchange log file",
+        "Write one record per AS/TGS/AP exchange (client, server, realm, etypes, flags,"
+        " error, PA types, PKINIT certificate and PAC hashes) to this file in a"
+        " columnar, dictionary-encoded format. Empty disables it.",
+        &kerberos_log_filename, TRUE);
+    register_cleanup_routine(kerberos_log_cleanup);
+    prefs_register_bool_preference(krb_module, "live_mode",
+        "Bound state for long live captures",
+        "Evict learnt keys once their ticket has ended, time out unanswered exchanges"
+        " and do not set up per-request UDP conversations, so that memory stays flat"
+        " on captures that run for days. Eviction counts show in -z krb_mem,tree."
+        " Without those conversations, a UDP reply that a KDC sends from a port other"
+        " than 88 is no longer dissected as Kerberos; replies from port 88 are not"
+        " affected.",
+        &kerberos_live_mode);
+    prefs_register_uint_preference(krb_module, "live_state_timeout",
+        "Live mode state timeout (s)",
+        "How long live mode keeps an unanswered exchange, or a learnt key whose"
+        " ticket end time was not seen",
+        10, &kerberos_live_timeout);
+    prefs_register_uint_preference(krb_module, "live_max_keys",
+        "Live mode learnt key limit",
+        "Most learnt keys live mode keeps; past it, the oldest go until 90% are left",
+        10, &kerberos_live_max_keys);
+    prefs_register_uint_preference(krb_module, "breaker_threshold",
+        "Failures before header-only dissection",
+        "After this many messages in a row on a conversation that throw an exception"
+        " or leave trailing bytes, dissect only the message headers there, without"
+        " trial decryption, until a well-formed message turns up. Unregistered OIDs"
+        " and missing decryption keys do not count. 0 (the default) disables it.",
+        10, &kerberos_breaker_threshold);
+    prefs_register_enum_preference(krb_module, "sample_mode",
+        "Sampled full dissection",
+        "Dissect only a sample of the messages on the Kerberos ports in full (trial"
+        " decryption, PKINIT, PAC) and the rest down to message type, realm, error"
+        " code and etypes. -z krb_sample,tree counts the latter exactly and scales"
+        " what the sample found to estimated totals. With decryption on, AS-REP,"
+        " TGS-REQ, TGS-REP and AP-REP messages are always dissected in full, as they"
+        " carry the keys. Keys only found in other messages, such as application"
+        " AP-REQ subkeys, are learnt from the sample alone, which biases the"
+        " decryption estimates low.",
+        &kerberos_sample_mode, kerberos_sample_modes, FALSE);
+    prefs_register_uint_preference(krb_module, "sample_rate",
+        "Sample one message in",
+        "N for the one-in-N sampling mode",
+        10, &kerberos_sample_rate);
+    prefs_register_uint_preference(krb_module, "sample_principal_first",
+        "Messages per principal always kept",
+        "In the per-principal mode, the first N messages of each principal are"
+        " dissected in full and the i-th after them with probability N/i",
+        10, &kerberos_sample_principal_first);
+    prefs_register_bool_preference(krb_module, "sample_errors",
+        "Always dissect KRB-ERRORs in full",
+        "Leave KRB-ERROR messages out of the sampling",
+        &kerberos_sample_errors);
+    prefs_register_filename_preference(krb_module, "shard_plan",
+        "Shard plan file",
+        "Pre-pass for splitting a capture: read only the outer message structures,"
+        " without decryption, and write to this file which frames each shard of the"
+        " capture needs from the others (tickets, exchanges, connections) to decrypt"
+        " on its own. Empty disables it.",
+        &kerberos_shard_filename, TRUE);
+    register_cleanup_routine(kerberos_shard_cleanup);
+    prefs_register_uint_preference(krb_module, "shard_size",
+        "Frames per shard",
+        "Shard size the shard plan is made for",
+        10, &kerberos_shard_size);
 #ifdef HAVE_KERBEROS
     prefs_register_bool_preference(krb_module, "decrypt",
         "Try to decrypt Kerberos blobs",
@@ -8827,6 +14453,42 @@ void proto_register_kerberos(void) {
         "The keytab file containing all the secrets",
         &keytab_filename, FALSE);
 
+#ifdef HAVE_MIT_KERBEROS
+    prefs_register_directory_preference(krb_module, "cache_dir",
+        "First-pass cache directory",
+        "Directory for the per-capture decryption cache, which lets a capture"
+        " that was read before skip its trial decryptions. The cache names the"
+        " key that opened each ciphertext by a short hash, not by its value, and"
+        " is created readable by its owner only. Empty disables it.",
+        &kerberos_cache_dir);
+    register_cleanup_routine(kerberos_cache_cleanup);
+    register_cleanup_routine(kerberos_key_schedules_cleanup);
+    ber_mem_register("kerberos.key_schedules", kerberos_mem_key_schedules);
+    prefs_register_bool_preference(krb_module, "builtin_aes",
+        "Built-in AES trial decryption",
+        "Try AES keys (RFC 3962 and RFC 8009 enctypes) with a built-in decryptor"
+        " that keeps the derived keys per key and usage instead of calling the"
+        " Kerberos library for every attempt. The first attempt per key and usage"
+        " is checked against the library, and any disagreement switches the"
+        " built-in decryptor off. GSS-API wrap tokens still go through the library.",
+        &krb_builtin_aes);
+    register_cleanup_routine(kerberos_aes_keys_cleanup);
+    ber_mem_register("kerberos.aes_keys", kerberos_mem_aes_keys);
+    prefs_register_bool_preference(krb_module, "rc4_tag_check",
+        "Quick rejection of RC4 keys",
+        "Reject an arcfour-hmac key on trial when the first decrypted octet is not"
+        " the ASN.1 tag the key usage calls for, instead of decrypting and checking"
+        " the whole message. Keys are checked eight at a time, with their RC4 key"
+        " schedules interleaved. Turn off for peers that encode these parts differently.",
+        &krb_rc4_tag_check);
+    register_cleanup_routine(kerberos_rc4_keys_cleanup);
+    ber_mem_register("kerberos.rc4_keys", kerberos_mem_rc4_keys);
+#endif
+
+    register_dissector(KRB5_DECRYPTED_PROTO_NAME, dissect_kerberos_decrypted, proto_kerberos);
+    ws_mempbrk_compile(&kerberos_scan_pattern, "\x60" "NK");
+    exported_pdu_tap = register_export_pdu_tap("Kerberos decrypted");
+
 #if defined(HAVE_HEIMDAL_KERBEROS) || defined(HAVE_MIT_KERBEROS)
     wmem_register_callback(wmem_epan_scope(), enc_key_list_cb, NULL);
     kerberos_longterm_keys = wmem_map_new(wmem_epan_scope(),
@@ -8843,6 +14505,42 @@ void proto_register_kerberos(void) {
 #endif /* defined(HAVE_HEIMDAL_KERBEROS) || defined(HAVE_MIT_KERBEROS) */
 #endif /* HAVE_KERBEROS */
 
+    kerberos_pkinit_clients = wmem_map_new_autoreset(wmem_epan_scope(),
+        wmem_file_scope(), g_str_hash, g_str_equal);
+    kerberos_sample_principals = wmem_map_new_autoreset(wmem_epan_scope(),
+        wmem_file_scope(), g_str_hash, g_str_equal);
+    kerberos_breaker_pairs = wmem_map_new_autoreset(wmem_epan_scope(),
+        wmem_file_scope(), g_str_hash, g_str_equal);
+
+    register_init_routine(kerberos_init);
+    ber_mem_register("kerberos.udp_conversations", kerberos_mem_udp_conversations);
+    ber_mem_register("kerberos.breakers", kerberos_mem_breakers);
+    ber_mem_register("kerberos.shards", kerberos_mem_shards);
+    ber_mem_register("kerberos.sample_principals", kerberos_mem_sample_principals);
+    ber_mem_register("kerberos.pkinit_clients", kerberos_mem_pkinit_clients);
+#if defined(HAVE_HEIMDAL_KERBEROS) || defined(HAVE_MIT_KERBEROS)
+    ber_mem_register("kerberos.enc_key_list", kerberos_mem_enc_key_list);
+    ber_mem_register("kerberos.longterm_keys", kerberos_mem_longterm_keys);
+    ber_mem_register("kerberos.all_keys", kerberos_mem_all_keys);
+    ber_mem_register("kerberos.app_session_keys", kerberos_mem_app_session_keys);
+#endif /* defined(HAVE_HEIMDAL_KERBEROS) || defined(HAVE_MIT_KERBEROS) */
+#ifdef HAVE_MIT_KERBEROS
+    kerberos_keytype_generations = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    kerberos_missing_index = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+        (GDestroyNotify)g_hash_table_destroy);
+    register_shutdown_routine(kerberos_missing_index_shutdown);
+    ber_mem_register("kerberos.missing_index", kerberos_mem_missing_index);
+#endif /* HAVE_MIT_KERBEROS */
+    ber_mem_register("kerberos.claims", kerberos_mem_claims);
+    register_cleanup_routine(kerberos_claims_cleanup);
+    ber_mem_register("kerberos.live.evicted_keys", kerberos_mem_evicted_keys);
+    ber_mem_register("kerberos.live.evicted_exchanges", kerberos_mem_evicted_exchanges);
+    stats_tree_register("frame", "krb_mem", "Kerberos/Memory", 0,
+        krb_mem_stats_tree_packet, krb_mem_stats_tree_init, NULL);
+    kerberos_sample_tap = register_tap("kerberos_sample");
+    stats_tree_register("kerberos_sample", "krb_sample", "Kerberos/Sampled", 0,
+        krb_sample_stats_tree_packet, krb_sample_stats_tree_init, NULL);
+
 }
 static int wrap_dissect_gss_kerb(tvbuff_t* tvb, int offset, packet_info* pinfo,
     proto_tree* tree, dcerpc_info* di _U_, guint8* drep _U_)
@@ -8851,7 +14549,7 @@ static int wrap_dissect_gss_kerb(tvbuff_t* tvb, int offset, packet_info* pinfo,
 
     auth_tvb = tvb_new_subset_remaining(tvb, offset);
 
-    dissect_kerberos_main(auth_tvb, pinfo, tree, FALSE, NULL);
+    dissect_kerberos_gss_token(auth_tvb, pinfo, tree, NULL);
 
     return tvb_captured_length_remaining(tvb, offset);
 }
@@ -8904,6 +14602,10 @@ proto_reg_handoff_kerberos(void)
 
     dissector_add_uint_with_preference("udp.port", UDP_PORT_KERBEROS, kerberos_handle_udp);
     dissector_add_uint_with_preference("tcp.port", TCP_PORT_KERBEROS, kerberos_handle_tcp);
+    heur_dissector_add("tcp", dissect_kerberos_scan_heur, "Kerberos tokens in any TCP payload",
+        "kerberos_scan_tcp", proto_kerberos, HEURISTIC_DISABLE);
+    heur_dissector_add("udp", dissect_kerberos_scan_heur, "Kerberos tokens in any UDP payload",
+        "kerberos_scan_udp", proto_kerberos, HEURISTIC_DISABLE);
 
     register_dcerpc_auth_subdissector(DCE_C_AUTHN_LEVEL_CONNECT,
         DCE_C_RPC_AUTHN_PROTOCOL_GSS_KERBEROS,
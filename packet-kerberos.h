@@ -63,9 +63,27 @@ dissect_kerberos_Applications_pku2u(gboolean implicit_tag _U_, tvbuff_t* tvb _U_
 gboolean
 kerberos_is_win2k_pkinit(asn1_ctx_t *actx);
 
+/* PKINIT PA-DATA layout, detected from the outer tags of the PA value */
+typedef enum {
+    KERBEROS_PKINIT_LAYOUT_UNKNOWN = 0,
+    KERBEROS_PKINIT_LAYOUT_RFC4556 = 1,
+    KERBEROS_PKINIT_LAYOUT_WIN2K = 2,
+    KERBEROS_PKINIT_LAYOUT_PKU2U = 3
+} kerberos_pkinit_layout_t;
+
+kerberos_pkinit_layout_t
+kerberos_get_pkinit_layout(asn1_ctx_t *actx);
+
 gint
 dissect_kerberos_main(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, gboolean do_col_info, kerberos_callbacks *cb);
 
+/* For callers that already know tvb holds a Kerberos token (GSS-API,
+ * DCE/RPC auth verifiers): no APPLICATION tag check, no column updates,
+ * and no per-call allocation of the dissection state.
+ */
+gint
+dissect_kerberos_gss_token(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, kerberos_callbacks *cb);
+
 int
 dissect_krb5_Checksum(proto_tree *tree, tvbuff_t *tvb, int offset, asn1_ctx_t *actx _U_);
 
@@ -74,6 +92,7 @@ dissect_krb5_ctime(proto_tree *tree, tvbuff_t *tvb, int offset, asn1_ctx_t *actx
 
 int dissect_krb5_cname(proto_tree *tree, tvbuff_t *tvb, int offset, asn1_ctx_t *actx _U_);
 int dissect_krb5_realm(proto_tree *tree, tvbuff_t *tvb, int offset, asn1_ctx_t *actx _U_);
+int dissect_krb5_reply_key(proto_tree *tree, tvbuff_t *tvb, int offset, asn1_ctx_t *actx, int parent_hf_index, int hf_index);
 guint32 kerberos_output_keytype(void);
 
 guint get_krb_pdu_len(packet_info *, tvbuff_t *tvb, int offset, void *data _U_);
@@ -107,6 +126,7 @@ typedef struct _enc_key_t {
 	guint num_same;
 	struct _enc_key_t	*src1;
 	struct _enc_key_t	*src2;
+	time_t expires; /* live mode: ticket end time, 0 if unknown */
 } enc_key_t;
 extern enc_key_t *enc_key_list;
 extern wmem_map_t *kerberos_longterm_keys;
@@ -20,6 +20,7 @@
 #include "packet-dcerpc.h"
 #include "packet-gssapi.h"
 #include "packet-ber.h"
+#include "packet-ber-try.h"
 #include "oids.h"
 #include <stdio.h>
 #include "packet-kerberos.h"
@@ -304,24 +305,33 @@ dissect_negoex_exchange_message(tvbuff_t *tvb,
   gint32 tag;
   guint32 len1;
   offset += 2;
-  offset = get_ber_identifier(gss_tvb, offset, &appclass, &pc, &tag);
-  offset = get_ber_length(gss_tvb, offset, &len1, &ind_field);
-  if (!(appclass == BER_CLASS_APP && pc && tag == 0))
+  /* Anything that is not a well-formed PKU2U token is shown as bytes */
+  int ber_offset = try_get_ber_identifier(gss_tvb, offset, &appclass, &pc, &tag);
+  ber_offset = try_get_ber_length(gss_tvb, ber_offset, &len1, &ind_field);
+  if (ber_offset >= 0 && appclass == BER_CLASS_APP && pc && tag == 0)
+  {
+    // jump over OBJECT IDENTIFIER 1.3.6.1.5.2.7 as we dont need it
+    ber_offset = try_get_ber_tl(gss_tvb, ber_offset, &appclass, &pc, &tag, &len1);
+    if (ber_offset >= 0)
+      ber_offset += len1;
+
+    // jump over Any type as we dont need it
+    ber_offset = try_get_ber_tl(gss_tvb, ber_offset, &appclass, &pc, &tag, &len1);
+    if (ber_offset >= 0)
+      ber_offset += len1;
+  }
+  else
+  {
+    ber_offset = -1;
+  }
+  if (ber_offset < 0)
   {
     proto_tree_add_item(exchange_vector, hf_negoex_exchange, tvb,
       exchange_vector_offset, exchange_vector_count, ENC_NA);
   }
   else
   {
-    // jump over OBJECT IDENTIFIER 1.3.6.1.5.2.7 as we dont need it
-    offset = get_ber_identifier(gss_tvb, offset, &appclass, &pc, &tag);
-    offset = get_ber_length(gss_tvb, offset, &len1, &ind_field);
-    offset = offset + len1;
-
-    // jump over Any type as we dont need it
-    offset = get_ber_identifier(gss_tvb, offset, &appclass, &pc, &tag);
-    offset = get_ber_length(gss_tvb, offset, &len1, &ind_field);
-    offset = offset + len1;
+    offset = ber_offset;
 
     proto_tree* pku2u_tree = proto_tree_add_subtree_format(exchange_vector, tvb, offset, -1,
       ett_pku2u, NULL, "PKU2U");
@@ -349,7 +359,7 @@ dissect_negoex_nego_message(tvbuff_t *tvb,
                             proto_tree *tree,
                             guint32 start_off)
 {
-  volatile guint32 offset;
+  guint32 offset;
   guint32 authscheme_vector_offset;
   guint16 authscheme_vector_count;
   guint32 extension_vector_offset;
@@ -360,82 +370,77 @@ dissect_negoex_nego_message(tvbuff_t *tvb,
 
   offset = start_off;
 
-  TRY {
-    /* The Random field */
-    proto_tree_add_item(tree, hf_negoex_random, tvb, offset, 32, ENC_ASCII);
-    offset += 32;
-
-    /* Protocol version */
-    proto_tree_add_item(tree, hf_negoex_proto_version, tvb, offset, 8, ENC_LITTLE_ENDIAN);
-    offset += 8;
-
-    /* AuthScheme offset and count */
-    authscheme_vector_offset = tvb_get_letohl(tvb, offset);
-    authscheme_vector_count = tvb_get_letohs(tvb, offset + 4);
-
-    authscheme_vector = proto_tree_add_subtree_format(tree, tvb, offset, 8,
-                             ett_negoex_authscheme_vector, NULL, "AuthSchemes: %u at %u",
-                             authscheme_vector_count, authscheme_vector_offset);
-    proto_tree_add_item(authscheme_vector, hf_negoex_authscheme_vector_offset,
-                        tvb, offset, 4, ENC_LITTLE_ENDIAN);
-    offset += 4;
-
-    proto_tree_add_item(authscheme_vector, hf_negoex_authscheme_vector_count,
-                        tvb, offset, 2, ENC_LITTLE_ENDIAN);
-    offset += 2;
-
-    proto_tree_add_item(authscheme_vector, hf_negoex_authscheme_vector_pad,
-                        tvb, offset, 2, ENC_NA);
-    offset += 2;
-
-    /* Now, add the various items */
-    for (i = 0; i < authscheme_vector_count; i++) {
-      proto_tree_add_item(authscheme_vector, hf_negoex_authscheme, tvb,
-                          authscheme_vector_offset + i * 16, 16, ENC_LITTLE_ENDIAN);
-    }
+  /* The Random field */
+  proto_tree_add_item(tree, hf_negoex_random, tvb, offset, 32, ENC_ASCII);
+  offset += 32;
 
-    extension_vector_offset = tvb_get_letohl(tvb, offset);
-    extension_vector_count = tvb_get_letohs(tvb, offset + 4);
+  /* Protocol version */
+  proto_tree_add_item(tree, hf_negoex_proto_version, tvb, offset, 8, ENC_LITTLE_ENDIAN);
+  offset += 8;
 
-    extension_vector = proto_tree_add_subtree_format(tree, tvb, offset, 8,
-                                 ett_negoex_extension_vector, NULL, "Extensions: %u at %u",
-                                 extension_vector_count, extension_vector_count);
+  /* AuthScheme offset and count */
+  authscheme_vector_offset = tvb_get_letohl(tvb, offset);
+  authscheme_vector_count = tvb_get_letohs(tvb, offset + 4);
 
-    proto_tree_add_item(extension_vector, hf_negoex_extension_vector_offset,
-                        tvb, offset, 4, ENC_LITTLE_ENDIAN);
-    offset += 4;
+  authscheme_vector = proto_tree_add_subtree_format(tree, tvb, offset, 8,
+                           ett_negoex_authscheme_vector, NULL, "AuthSchemes: %u at %u",
+                           authscheme_vector_count, authscheme_vector_offset);
+  proto_tree_add_item(authscheme_vector, hf_negoex_authscheme_vector_offset,
+                      tvb, offset, 4, ENC_LITTLE_ENDIAN);
+  offset += 4;
 
-    proto_tree_add_item(extension_vector, hf_negoex_extension_vector_count,
-                        tvb, offset, 2, ENC_LITTLE_ENDIAN);
-    offset += 2;
+  proto_tree_add_item(authscheme_vector, hf_negoex_authscheme_vector_count,
+                      tvb, offset, 2, ENC_LITTLE_ENDIAN);
+  offset += 2;
 
-    proto_tree_add_item(extension_vector, hf_negoex_extension_vector_pad,
-                        tvb, offset, 2, ENC_NA);
-    offset += 2;
+  proto_tree_add_item(authscheme_vector, hf_negoex_authscheme_vector_pad,
+                      tvb, offset, 2, ENC_NA);
+  offset += 2;
 
-    for (i = 0; i < extension_vector_count; i++) {
-      guint32 byte_vector_offset, byte_vector_count;
-      proto_tree *bv_tree;
+  /* Now, add the various items */
+  for (i = 0; i < authscheme_vector_count; i++) {
+    proto_tree_add_item(authscheme_vector, hf_negoex_authscheme, tvb,
+                        authscheme_vector_offset + i * 16, 16, ENC_LITTLE_ENDIAN);
+  }
 
-      /*
-       * Dissect these things ... they consist of a byte vector, so we
-       * add a subtree and point to the relevant bytes
-       */
-      byte_vector_offset = tvb_get_letohl(tvb, offset);
-      byte_vector_count = tvb_get_letohs(tvb, offset + 4);
+  extension_vector_offset = tvb_get_letohl(tvb, offset);
+  extension_vector_count = tvb_get_letohs(tvb, offset + 4);
 
-      bv_tree = proto_tree_add_subtree_format(extension_vector, tvb,
-                                  extension_vector_offset + i * 8, 8,
-                                  ett_negoex_byte_vector, NULL, "Extension: %u bytes at %u",
-                                  byte_vector_count, byte_vector_offset);
+  extension_vector = proto_tree_add_subtree_format(tree, tvb, offset, 8,
+                               ett_negoex_extension_vector, NULL, "Extensions: %u at %u",
+                               extension_vector_count, extension_vector_count);
 
-      proto_tree_add_item(bv_tree, hf_negoex_extension, tvb,
-                          byte_vector_offset, byte_vector_count, ENC_NA);
-    }
+  proto_tree_add_item(extension_vector, hf_negoex_extension_vector_offset,
+                      tvb, offset, 4, ENC_LITTLE_ENDIAN);
+  offset += 4;
 
+  proto_tree_add_item(extension_vector, hf_negoex_extension_vector_count,
+                      tvb, offset, 2, ENC_LITTLE_ENDIAN);
+  offset += 2;
 
-  } ENDTRY;
+  proto_tree_add_item(extension_vector, hf_negoex_extension_vector_pad,
+                      tvb, offset, 2, ENC_NA);
+  offset += 2;
+
+  for (i = 0; i < extension_vector_count; i++) {
+    guint32 byte_vector_offset, byte_vector_count;
+    proto_tree *bv_tree;
+
+    /*
+     * Dissect these things ... they consist of a byte vector, so we
+     * add a subtree and point to the relevant bytes
+     */
+    byte_vector_offset = tvb_get_letohl(tvb, offset);
+    byte_vector_count = tvb_get_letohs(tvb, offset + 4);
 
+    bv_tree = proto_tree_add_subtree_format(extension_vector, tvb,
+                                extension_vector_offset + i * 8, 8,
+                                ett_negoex_byte_vector, NULL, "Extension: %u bytes at %u",
+                                byte_vector_count, byte_vector_offset);
+
+    proto_tree_add_item(bv_tree, hf_negoex_extension, tvb,
+                        byte_vector_offset, byte_vector_count, ENC_NA);
+  }
 }
 
 static int
@@ -444,7 +449,6 @@ dissect_negoex(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void* data _
   volatile guint32 offset;
   proto_tree * volatile negoex_tree;
   proto_item *tf;
-  volatile gboolean done;
   guint32 payload_len;
   guint32 message_len;
   guint32 message_type;
@@ -453,7 +457,6 @@ dissect_negoex(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void* data _
   offset = 0;
   negoex_tree = NULL;
   tf = NULL;
-  done = FALSE;
   payload_len = tvb_reported_length(tvb);
 
   /* Set up the initial NEGOEX payload */
@@ -467,16 +470,20 @@ dissect_negoex(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void* data _
    * However, the payload might not have been reassembled ...
    */
 
-  while (offset < payload_len && !done) {
-    proto_tree *negoex_msg_tree;
-    proto_tree *negoex_hdr_tree;
-    proto_item *msg;
-    tvbuff_t *msg_tvb;
-    guint32 start_offset;
+  /*
+   * One TRY for the whole loop: an exception ends the loop either way, so
+   * there is no need to set one up for every message.
+   */
+  TRY {
+    while (offset < payload_len) {
+      proto_tree *negoex_msg_tree;
+      proto_tree *negoex_hdr_tree;
+      proto_item *msg;
+      tvbuff_t *msg_tvb;
+      guint32 start_offset;
 
-    start_offset = offset;
+      start_offset = offset;
 
-    TRY {
      /* Message type, it is after the signature */
       message_type = tvb_get_letohl(tvb, offset + 8);
 
@@ -590,12 +597,10 @@ dissect_negoex(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void* data _
       /* We cannot branch out of the TRY block, but we can branch here */
     bad_message:
         ;
-
-    } CATCH_NONFATAL_ERRORS {
-      done = TRUE;
-      show_exception(tvb, pinfo, tree, EXCEPT_CODE, GET_MESSAGE);
-    } ENDTRY;
-  }
+    }
+  } CATCH_NONFATAL_ERRORS {
+    show_exception(tvb, pinfo, tree, EXCEPT_CODE, GET_MESSAGE);
+  } ENDTRY;
 
   return tvb_captured_length(tvb);
 }
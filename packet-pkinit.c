@@ -21,8 +21,16 @@
 
 #include <epan/packet.h>
 #include <epan/asn1.h>
+#include <epan/exceptions.h>
+#include <epan/oids.h>
+#include <epan/prefs.h>
+#include <epan/stats_tree.h>
+#include <epan/tap.h>
+#include <epan/to_str.h>
+#include <wsutil/wsgcrypt.h>
 
 #include "packet-ber.h"
+#include "packet-ber-profile.h"
 #include "packet-pkinit.h"
 #include "packet-cms.h"
 #include "packet-pkix1explicit.h"
@@ -39,15 +47,13 @@ void proto_reg_handoff_pkinit(void);
 /* Initialize the protocol and registered fields */
 static int proto_pkinit = -1;
 
-static int isWin2k = 0;
-static int isPku2u = -1;
-
 /*--- Included file: packet-pkinit-hf.c ---*/
 #line 1 "./asn1/pkinit/packet-pkinit-hf.c"
 static int hf_pkinit_pkAsRequest = -1;      /* PA-PK-AS-REQ */
 static int hf_pkinit_AuthPack_PDU = -1;           /* AuthPack */
 static int hf_pkinit_KRB5PrincipalName_PDU = -1;  /* KRB5PrincipalName */
 static int hf_pkinit_KDCDHKeyInfo_PDU = -1;       /* KDCDHKeyInfo */
+static int hf_pkinit_ReplyKeyPack_PDU = -1;       /* ReplyKeyPack */
 static int hf_pkinit_signedAuthPack = -1;         /* ContentInfo */
 static int hf_pkinit_trustedCertifiers = -1;      /* SEQUENCE_OF_TrustedCA */
 static int hf_pkinit_trustedCertifiers_item = -1;  /* TrustedCA */
@@ -79,9 +85,16 @@ static int hf_pkinit_trusted_certifiers = -1;     /* SEQUENCE_OF_TrustedCA */
 static int hf_pkinit_trusted_certifiers_item = -1;  /* TrustedCA */
 static int hf_pkinit_kdc_cert = -1;               /* OCTET_STRING */
 static int hf_pkinit_encryption_cert = -1;        /* OCTET_STRING */
+static int hf_pkinit_replyKey = -1;               /* EncryptionKey */
+static int hf_pkinit_asChecksum = -1;             /* Checksum */
 
 /*--- End of included file: packet-pkinit-hf.c ---*/
 #line 33 "./asn1/pkinit/packet-pkinit-template.c"
+static int hf_pkinit_response_in = -1;
+static int hf_pkinit_response_to = -1;
+static int hf_pkinit_time = -1;
+static int hf_pkinit_outcome = -1;
+static int hf_pkinit_dh_group = -1;
 
 /* Initialize the subtree pointers */
 
@@ -98,6 +111,7 @@ static gint ett_pkinit_PaPkAsRep = -1;
 static gint ett_pkinit_KDCDHKeyInfo = -1;
 static gint ett_pkinit_PKAuthenticator_Win2k = -1;
 static gint ett_pkinit_PA_PK_AS_REQ_Win2k = -1;
+static gint ett_pkinit_ReplyKeyPack = -1;
 
 /*--- End of included file: packet-pkinit-ett.c ---*/
 #line 36 "./asn1/pkinit/packet-pkinit-template.c"
@@ -105,8 +119,690 @@ static gint ett_pkinit_PA_PK_AS_REQ_Win2k = -1;
 static int dissect_KerberosV5Spec2_KerberosTime(gboolean implicit_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx, proto_tree* tree, int hf_index _U_);
 static int dissect_KerberosV5Spec2_Realm(gboolean implicit_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx, proto_tree* tree, int hf_index _U_);
 static int dissect_KerberosV5Spec2_PrincipalName(gboolean implicit_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx, proto_tree* tree, int hf_index _U_);
+static int dissect_KerberosV5Spec2_EncryptionKey(gboolean implicit_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx, proto_tree* tree, int hf_index);
+static int dissect_KerberosV5Spec2_Checksum(gboolean implicit_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx, proto_tree* tree, int hf_index _U_);
 static int dissect_pkinit_PKAuthenticator_Win2k(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_);
 
+/* PKINIT exchange correlation.
+ * An AS-REQ carrying PA-PK-AS-REQ opens an exchange keyed by the
+ * PKAuthenticator paNonce and the client address; the AS-REP (matched on
+ * the KDCDHKeyInfo nonce, or the client's latest open exchange for RSA
+ * key transport) or a KRB-ERROR to the client closes it. Closed exchanges
+ * leave the pending tables straight away, only the per-frame index that
+ * backs pkinit.response_in/response_to is kept for the file.
+ */
+#define PKINIT_OUTCOME_PENDING      0
+#define PKINIT_OUTCOME_AS_REP       1
+#define PKINIT_OUTCOME_KRB_ERROR    2
+#define PKINIT_OUTCOME_EVICTED      3
+
+static const value_string pkinit_outcome_vals[] = {
+    { PKINIT_OUTCOME_PENDING, "Pending" },
+    { PKINIT_OUTCOME_AS_REP, "AS-REP" },
+    { PKINIT_OUTCOME_KRB_ERROR, "KRB-ERROR" },
+    { PKINIT_OUTCOME_EVICTED, "Evicted" },
+    { 0, NULL }
+};
+
+typedef struct {
+    address client;
+    guint32 client_port;
+    address kdc;
+    guint32 kdc_port;
+    guint32 nonce;
+    gboolean has_nonce;
+    guint32 req_frame;
+    guint32 rep_frame;
+    nstime_t req_time;
+    nstime_t rep_time;
+    const char* client_cert;    /* SHA-256 of the first certificate */
+    const char* client_key;     /* e.g. "RSA-2048" */
+    const char* client_ca_key;  /* key of the CA that issued the first certificate */
+    const char* client_digest;  /* first SignedData digestAlgorithm */
+    const char* dh_group;       /* from clientPublicValue, e.g. "DH-2048" */
+    guint client_dh_nonce_len;
+    const char* cms_types;
+    const char* kdc_cert;
+    const char* kdc_key;
+    const char* kdc_digest;
+    guint32 dh_nonce;
+    gboolean has_dh_nonce;
+    guint outcome;
+    guint32 errorcode;
+    guint32 evict_frame;        /* request that pushed it out of the open exchanges */
+    wmem_list_frame_t* pending; /* in pkinit_pending_order while open */
+} pkinit_exchange_t;
+
+/* What the dissection of one PKINIT PA value found, before it is filed */
+typedef struct {
+    guint32 nonce;
+    gboolean has_nonce;
+    guint32 reply_nonce;
+    gboolean has_reply_nonce;
+    guint32 dh_nonce;
+    gboolean has_dh_nonce;
+    const char* dh_group;
+    guint client_dh_nonce_len;
+    const char* cms_types;
+    const char* cert;
+    const char* cert_key;
+    const char* ca_key;
+    const char* digest;
+} pkinit_packet_t;
+
+/* a certificate's SHA-256 as kept in an exchange: hex and terminator */
+#define PKINIT_CERT_HEX_LENGTH (HASH_SHA2_256_LENGTH * 2 + 1)
+
+static int pkinit_tap = -1;
+static guint pkinit_max_pending = 4096;
+static guint pkinit_max_exchanges = 65536;
+static guint pkinit_evicted = 0;
+
+static wmem_map_t* pkinit_pending = NULL;         /* "addr/nonce" -> pkinit_exchange_t */
+static wmem_map_t* pkinit_pending_pair = NULL;    /* "client:port>kdc:port" -> latest open pkinit_exchange_t */
+static wmem_map_t* pkinit_pending_client = NULL;  /* "addr" -> latest open pkinit_exchange_t */
+static wmem_map_t* pkinit_frames = NULL;          /* frame -> pkinit_exchange_t */
+static wmem_map_t* pkinit_evictions = NULL;       /* request frame -> pkinit_exchange_t it evicted */
+static wmem_list_t* pkinit_pending_order = NULL;  /* open exchanges, oldest first */
+static wmem_list_t* pkinit_exchange_order = NULL; /* every exchange in pkinit_frames, oldest first */
+static wmem_map_t* pkinit_strings = NULL;         /* key and algorithm descriptions, one copy each */
+
+static void
+pkinit_init(void)
+{
+    pkinit_pending = wmem_map_new(wmem_file_scope(), g_str_hash, g_str_equal);
+    pkinit_pending_pair = wmem_map_new(wmem_file_scope(), g_str_hash, g_str_equal);
+    pkinit_pending_client = wmem_map_new(wmem_file_scope(), g_str_hash, g_str_equal);
+    pkinit_frames = wmem_map_new(wmem_file_scope(), g_direct_hash, g_direct_equal);
+    pkinit_evictions = wmem_map_new(wmem_file_scope(), g_direct_hash, g_direct_equal);
+    pkinit_pending_order = wmem_list_new(wmem_file_scope());
+    pkinit_exchange_order = wmem_list_new(wmem_file_scope());
+    pkinit_strings = wmem_map_new(wmem_file_scope(), g_str_hash, g_str_equal);
+    pkinit_evicted = 0;
+}
+
+/* open exchanges: their three map entries and list frame; the exchanges
+ * themselves are counted under pkinit.frames */
+static void
+pkinit_mem_pending(guint* count, guint64* bytes)
+{
+    *count = wmem_list_count(pkinit_pending_order);
+    *bytes = (guint64)*count * (3 * BER_MEM_MAP_ENTRY + BER_MEM_LIST_FRAME);
+}
+
+/* the exchanges with a request or reply frame entry, and those entries */
+static void
+pkinit_mem_frames(guint* count, guint64* bytes)
+{
+    *count = wmem_list_count(pkinit_exchange_order);
+    *bytes = (guint64)*count * (sizeof(pkinit_exchange_t) + BER_MEM_LIST_FRAME + 2 * PKINIT_CERT_HEX_LENGTH) +
+        (guint64)wmem_map_size(pkinit_frames) * BER_MEM_MAP_ENTRY;
+}
+
+/* A file scope copy of a description, shared by every exchange with the same one */
+static const char*
+pkinit_intern(const char* str)
+{
+    char* interned;
+
+    if (str == NULL) {
+        return NULL;
+    }
+    interned = (char*)wmem_map_lookup(pkinit_strings, str);
+    if (interned == NULL) {
+        interned = wmem_strdup(wmem_file_scope(), str);
+        wmem_map_insert(pkinit_strings, interned, interned);
+    }
+    return interned;
+}
+
+/* wmem_map_insert() with a file scope copy of key, made only if the map
+ * does not hold the key already */
+static void
+pkinit_map_insert(wmem_map_t* map, const char* key, pkinit_exchange_t* exch)
+{
+    const void* orig_key;
+
+    if (wmem_map_lookup_extended(map, key, &orig_key, NULL)) {
+        wmem_map_insert(map, orig_key, exch);
+    } else {
+        wmem_map_insert(map, wmem_strdup(wmem_file_scope(), key), exch);
+    }
+}
+
+static pkinit_packet_t*
+pkinit_get_packet(packet_info* pinfo)
+{
+    pkinit_packet_t* pkt = (pkinit_packet_t*)p_get_proto_data(wmem_packet_scope(), pinfo, proto_pkinit, 0);
+
+    if (pkt == NULL) {
+        pkt = wmem_new0(wmem_packet_scope(), pkinit_packet_t);
+        p_add_proto_data(wmem_packet_scope(), pinfo, proto_pkinit, 0, pkt);
+    }
+    return pkt;
+}
+
+const char*
+pkinit_get_cert_fingerprint(packet_info* pinfo)
+{
+    pkinit_packet_t* pkt = (pkinit_packet_t*)p_get_proto_data(wmem_packet_scope(), pinfo, proto_pkinit, 0);
+
+    return pkt ? pkt->cert : NULL;
+}
+
+static char*
+pkinit_pending_key(const address* addr, guint32 nonce)
+{
+    return wmem_strdup_printf(wmem_packet_scope(), "%s/%u", address_to_str(wmem_packet_scope(), addr), nonce);
+}
+
+static char*
+pkinit_pair_key(const address* client, guint32 client_port, const address* kdc, guint32 kdc_port)
+{
+    return wmem_strdup_printf(wmem_packet_scope(), "%s:%u>%s:%u",
+        address_to_str(wmem_packet_scope(), client), client_port,
+        address_to_str(wmem_packet_scope(), kdc), kdc_port);
+}
+
+/* Take an exchange out of the pending maps, where they still point at
+ * it: a later request with the same key may have taken its place */
+static void
+pkinit_close_pending(pkinit_exchange_t* exch)
+{
+    char* addr_key;
+    char* pair_key;
+    char* nonce_key;
+
+    if (exch->pending == NULL) {
+        return;
+    }
+    addr_key = address_to_str(wmem_packet_scope(), &exch->client);
+    pair_key = pkinit_pair_key(&exch->client, exch->client_port, &exch->kdc, exch->kdc_port);
+    if (exch->has_nonce) {
+        nonce_key = pkinit_pending_key(&exch->client, exch->nonce);
+        if (wmem_map_lookup(pkinit_pending, nonce_key) == exch) {
+            wmem_map_remove(pkinit_pending, nonce_key);
+        }
+    }
+    if (wmem_map_lookup(pkinit_pending_pair, pair_key) == exch) {
+        wmem_map_remove(pkinit_pending_pair, pair_key);
+    }
+    if (wmem_map_lookup(pkinit_pending_client, addr_key) == exch) {
+        wmem_map_remove(pkinit_pending_client, addr_key);
+    }
+    wmem_list_remove_frame(pkinit_pending_order, exch->pending);
+    exch->pending = NULL;
+}
+
+/* Keep the open exchanges bounded; requests never answered age out, and
+ * are tapped on the frame that pushed them out */
+static void
+pkinit_evict_pending(packet_info* pinfo)
+{
+    wmem_list_frame_t* head;
+    pkinit_exchange_t* exch;
+
+    while (pkinit_max_pending && wmem_list_count(pkinit_pending_order) > pkinit_max_pending) {
+        head = wmem_list_head(pkinit_pending_order);
+        exch = (pkinit_exchange_t*)wmem_list_frame_data(head);
+        pkinit_close_pending(exch);
+        exch->outcome = PKINIT_OUTCOME_EVICTED;
+        exch->evict_frame = pinfo->num;
+        wmem_map_insert(pkinit_evictions, GUINT_TO_POINTER(pinfo->num), exch);
+        pkinit_evicted++;
+    }
+}
+
+/* Keep the exchanges behind pkinit_frames bounded too: the oldest are
+ * forgotten, and their frames show no exchange on later passes */
+static void
+pkinit_expire_exchanges(void)
+{
+    wmem_list_frame_t* head;
+    pkinit_exchange_t* exch;
+
+    while (pkinit_max_exchanges && wmem_list_count(pkinit_exchange_order) > pkinit_max_exchanges) {
+        head = wmem_list_head(pkinit_exchange_order);
+        exch = (pkinit_exchange_t*)wmem_list_frame_data(head);
+        wmem_list_remove_frame(pkinit_exchange_order, head);
+        if (exch->pending != NULL) {
+            pkinit_close_pending(exch);
+            pkinit_evicted++;
+        }
+        if (wmem_map_lookup(pkinit_frames, GUINT_TO_POINTER(exch->req_frame)) == exch) {
+            wmem_map_remove(pkinit_frames, GUINT_TO_POINTER(exch->req_frame));
+        }
+        if (exch->rep_frame && wmem_map_lookup(pkinit_frames, GUINT_TO_POINTER(exch->rep_frame)) == exch) {
+            wmem_map_remove(pkinit_frames, GUINT_TO_POINTER(exch->rep_frame));
+        }
+        if (exch->evict_frame && wmem_map_lookup(pkinit_evictions, GUINT_TO_POINTER(exch->evict_frame)) == exch) {
+            wmem_map_remove(pkinit_evictions, GUINT_TO_POINTER(exch->evict_frame));
+        }
+        free_address_wmem(wmem_file_scope(), &exch->client);
+        free_address_wmem(wmem_file_scope(), &exch->kdc);
+        if (exch->client_cert) {
+            wmem_free(wmem_file_scope(), (void*)exch->client_cert);
+        }
+        if (exch->kdc_cert) {
+            wmem_free(wmem_file_scope(), (void*)exch->kdc_cert);
+        }
+        wmem_free(wmem_file_scope(), exch);
+    }
+}
+
+static void
+pkinit_add_exchange_items(proto_tree* tree, tvbuff_t* tvb, packet_info* pinfo, pkinit_exchange_t* exch)
+{
+    proto_item* item;
+    nstime_t delta;
+
+    if (exch->req_frame == pinfo->num) {
+        if (exch->dh_group) {
+            item = proto_tree_add_string(tree, hf_pkinit_dh_group, tvb, 0, 0, exch->dh_group);
+            proto_item_set_generated(item);
+        }
+        if (exch->rep_frame) {
+            item = proto_tree_add_uint(tree, hf_pkinit_response_in, tvb, 0, 0, exch->rep_frame);
+            proto_item_set_generated(item);
+        }
+    }
+    else if (exch->rep_frame == pinfo->num) {
+        item = proto_tree_add_uint(tree, hf_pkinit_response_to, tvb, 0, 0, exch->req_frame);
+        proto_item_set_generated(item);
+        nstime_delta(&delta, &exch->rep_time, &exch->req_time);
+        item = proto_tree_add_time(tree, hf_pkinit_time, tvb, 0, 0, &delta);
+        proto_item_set_generated(item);
+        item = proto_tree_add_uint(tree, hf_pkinit_outcome, tvb, 0, 0, exch->outcome);
+        proto_item_set_generated(item);
+        tap_queue_packet(pkinit_tap, pinfo, exch);
+    }
+}
+
+static void
+pkinit_request_done(asn1_ctx_t* actx, proto_tree* tree, tvbuff_t* tvb)
+{
+    packet_info* pinfo = actx->pinfo;
+    pkinit_exchange_t* exch;
+    pkinit_packet_t* pkt;
+
+    if (!PINFO_FD_VISITED(pinfo)) {
+        pkt = pkinit_get_packet(pinfo);
+        exch = wmem_new0(wmem_file_scope(), pkinit_exchange_t);
+        copy_address_wmem(wmem_file_scope(), &exch->client, &pinfo->src);
+        exch->client_port = pinfo->srcport;
+        copy_address_wmem(wmem_file_scope(), &exch->kdc, &pinfo->dst);
+        exch->kdc_port = pinfo->destport;
+        exch->nonce = pkt->nonce;
+        exch->has_nonce = pkt->has_nonce;
+        exch->req_frame = pinfo->num;
+        exch->req_time = pinfo->abs_ts;
+        exch->client_cert = pkt->cert ? wmem_strdup(wmem_file_scope(), pkt->cert) : NULL;
+        exch->client_key = pkinit_intern(pkt->cert_key);
+        exch->client_ca_key = pkinit_intern(pkt->ca_key);
+        exch->client_digest = pkinit_intern(pkt->digest);
+        exch->dh_group = pkinit_intern(pkt->dh_group);
+        exch->client_dh_nonce_len = pkt->client_dh_nonce_len;
+        exch->cms_types = pkinit_intern(pkt->cms_types);
+        exch->outcome = PKINIT_OUTCOME_PENDING;
+
+        if (exch->has_nonce) {
+            pkinit_map_insert(pkinit_pending, pkinit_pending_key(&pinfo->src, exch->nonce), exch);
+        }
+        pkinit_map_insert(pkinit_pending_pair,
+            pkinit_pair_key(&pinfo->src, pinfo->srcport, &pinfo->dst, pinfo->destport), exch);
+        pkinit_map_insert(pkinit_pending_client, address_to_str(wmem_packet_scope(), &pinfo->src), exch);
+        wmem_map_insert(pkinit_frames, GUINT_TO_POINTER(pinfo->num), exch);
+        wmem_list_append(pkinit_pending_order, exch);
+        exch->pending = wmem_list_tail(pkinit_pending_order);
+        wmem_list_append(pkinit_exchange_order, exch);
+        pkinit_expire_exchanges();
+        pkinit_evict_pending(pinfo);
+    }
+
+    exch = (pkinit_exchange_t*)wmem_map_lookup(pkinit_frames, GUINT_TO_POINTER(pinfo->num));
+    if (exch) {
+        pkinit_add_exchange_items(tree, tvb, pinfo, exch);
+    }
+    exch = (pkinit_exchange_t*)wmem_map_lookup(pkinit_evictions, GUINT_TO_POINTER(pinfo->num));
+    if (exch) {
+        tap_queue_packet(pkinit_tap, pinfo, exch);
+    }
+}
+
+/*
+ * The open exchange a reply from the KDC answers. A reply that carries a
+ * nonce only matches a request with that nonce; one without matches the
+ * request sent from and to the same addresses and ports, and an AS-REP
+ * without a nonce falls back to the client's latest request (a reply
+ * from another KDC port, say). KRB-ERRORs carry no nonce and are only
+ * matched by ports: they answer plenty of requests that are not PKINIT.
+ */
+static pkinit_exchange_t*
+pkinit_find_pending(packet_info* pinfo, pkinit_packet_t* pkt, gboolean allow_fallback)
+{
+    pkinit_exchange_t* exch;
+
+    if (pkt && pkt->has_reply_nonce) {
+        return (pkinit_exchange_t*)wmem_map_lookup(pkinit_pending, pkinit_pending_key(&pinfo->dst, pkt->reply_nonce));
+    }
+    exch = (pkinit_exchange_t*)wmem_map_lookup(pkinit_pending_pair,
+        pkinit_pair_key(&pinfo->dst, pinfo->destport, &pinfo->src, pinfo->srcport));
+    if (exch == NULL && allow_fallback) {
+        exch = (pkinit_exchange_t*)wmem_map_lookup(pkinit_pending_client, address_to_str(wmem_packet_scope(), &pinfo->dst));
+    }
+    return exch;
+}
+
+static void
+pkinit_reply_done(asn1_ctx_t* actx, proto_tree* tree, tvbuff_t* tvb)
+{
+    packet_info* pinfo = actx->pinfo;
+    pkinit_exchange_t* exch;
+    pkinit_packet_t* pkt;
+
+    if (!PINFO_FD_VISITED(pinfo)) {
+        pkt = pkinit_get_packet(pinfo);
+        exch = pkinit_find_pending(pinfo, pkt, TRUE);
+        if (exch) {
+            exch->rep_frame = pinfo->num;
+            exch->rep_time = pinfo->abs_ts;
+            exch->kdc_cert = pkt->cert ? wmem_strdup(wmem_file_scope(), pkt->cert) : NULL;
+            exch->kdc_key = pkinit_intern(pkt->cert_key);
+            exch->kdc_digest = pkinit_intern(pkt->digest);
+            exch->dh_nonce = pkt->dh_nonce;
+            exch->has_dh_nonce = pkt->has_dh_nonce;
+            exch->outcome = PKINIT_OUTCOME_AS_REP;
+            pkinit_close_pending(exch);
+            wmem_map_insert(pkinit_frames, GUINT_TO_POINTER(pinfo->num), exch);
+        }
+    }
+
+    exch = (pkinit_exchange_t*)wmem_map_lookup(pkinit_frames, GUINT_TO_POINTER(pinfo->num));
+    if (exch) {
+        pkinit_add_exchange_items(tree, tvb, pinfo, exch);
+    }
+}
+
+void
+pkinit_exchange_krb_error(packet_info* pinfo, proto_tree* tree, tvbuff_t* tvb, guint32 errorcode)
+{
+    pkinit_exchange_t* exch;
+
+    if (pkinit_frames == NULL) {
+        return;
+    }
+
+    if (!PINFO_FD_VISITED(pinfo)) {
+        exch = pkinit_find_pending(pinfo, NULL, FALSE);
+        if (exch) {
+            exch->rep_frame = pinfo->num;
+            exch->rep_time = pinfo->abs_ts;
+            exch->outcome = PKINIT_OUTCOME_KRB_ERROR;
+            exch->errorcode = errorcode;
+            pkinit_close_pending(exch);
+            wmem_map_insert(pkinit_frames, GUINT_TO_POINTER(pinfo->num), exch);
+        }
+    }
+
+    exch = (pkinit_exchange_t*)wmem_map_lookup(pkinit_frames, GUINT_TO_POINTER(pinfo->num));
+    if (exch) {
+        pkinit_add_exchange_items(tree, tvb, pinfo, exch);
+    }
+}
+
+/* Structural walks over the PKINIT blobs for the exchange table. They
+ * read tags and lengths only and never touch the tree.
+ */
+static int
+pkinit_ber_enter(tvbuff_t* tvb, int offset, gint8* ber_class, gint32* tag, guint32* len)
+{
+    offset = get_ber_identifier(tvb, offset, ber_class, NULL, tag);
+    offset = get_ber_length(tvb, offset, len, NULL);
+
+    return offset;
+}
+
+static const char*
+pkinit_oid_name(tvbuff_t* tvb, int offset, guint32 len)
+{
+    const char* oid;
+    const char* name;
+
+    oid = oid_encoded2string(wmem_packet_scope(), tvb_get_ptr(tvb, offset, len), len);
+    name = oid_resolved_from_string(wmem_packet_scope(), oid);
+    return name ? name : oid;
+}
+
+/* Size in bits of the INTEGER at offset */
+static guint
+pkinit_integer_bits(tvbuff_t* tvb, int offset)
+{
+    gint8 ber_class;
+    gint32 tag;
+    guint32 len;
+
+    offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+    if (len && tvb_get_guint8(tvb, offset) == 0) {
+        len--;
+    }
+    return len * 8;
+}
+
+/* rsaEncryption, dhpublicnumber, id-ecPublicKey */
+static const guint8 pkinit_oid_rsa[] = { 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x01 };
+static const guint8 pkinit_oid_dh[] = { 0x2a, 0x86, 0x48, 0xce, 0x3e, 0x02, 0x01 };
+static const guint8 pkinit_oid_ec[] = { 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x02, 0x01 };
+
+/* Key type and size of a SubjectPublicKeyInfo: "RSA-2048", "DH-2048", "EC-secp384r1" */
+static const char*
+pkinit_describe_spki(tvbuff_t* tvb, int offset)
+{
+    int alg_end, oid_offset;
+    gint8 ber_class;
+    gint32 tag;
+    guint32 len, oid_len;
+
+    offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+    offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+    alg_end = offset + len;
+    oid_offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &oid_len);
+    offset = oid_offset + oid_len;
+
+    if (oid_len == sizeof(pkinit_oid_rsa) && tvb_memeql(tvb, oid_offset, pkinit_oid_rsa, oid_len) == 0) {
+        /* subjectPublicKey BIT STRING { RSAPublicKey { modulus, ... } } */
+        offset = pkinit_ber_enter(tvb, alg_end, &ber_class, &tag, &len) + 1;
+        offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+        return wmem_strdup_printf(wmem_packet_scope(), "RSA-%u", pkinit_integer_bits(tvb, offset));
+    }
+    if (oid_len == sizeof(pkinit_oid_dh) && tvb_memeql(tvb, oid_offset, pkinit_oid_dh, oid_len) == 0) {
+        /* DomainParameters { p, g, q, ... } */
+        offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+        return wmem_strdup_printf(wmem_packet_scope(), "DH-%u", pkinit_integer_bits(tvb, offset));
+    }
+    if (oid_len == sizeof(pkinit_oid_ec) && tvb_memeql(tvb, oid_offset, pkinit_oid_ec, oid_len) == 0) {
+        offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+        if (ber_class == BER_CLASS_UNI && tag == BER_UNI_TAG_OID) {
+            return wmem_strdup_printf(wmem_packet_scope(), "EC-%s", pkinit_oid_name(tvb, offset, len));
+        }
+        return "EC";
+    }
+    return pkinit_oid_name(tvb, oid_offset, oid_len);
+}
+
+/* Certificate { tbsCertificate { [0] version, serial, signature, issuer,
+ * validity, subject, subjectPublicKeyInfo ... } ... }
+ */
+static const char*
+pkinit_describe_certificate_key(tvbuff_t* tvb, int offset)
+{
+    gint8 ber_class;
+    gint32 tag;
+    guint32 len;
+    int i;
+
+    offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+    offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+    get_ber_identifier(tvb, offset, &ber_class, NULL, &tag);
+    if (ber_class == BER_CLASS_CON && tag == 0) {
+        offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+        offset += len;
+    }
+    for (i = 0; i < 5; i++) {
+        offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+        offset += len;
+    }
+    return pkinit_describe_spki(tvb, offset);
+}
+
+/* The issuer (field 2) or subject (field 4) Name of a Certificate; sets
+ * *tlv_len to its length with tag and length */
+static int
+pkinit_certificate_name(tvbuff_t* tvb, int offset, int field, guint32* tlv_len)
+{
+    gint8 ber_class;
+    gint32 tag;
+    guint32 len;
+    int i, start;
+
+    offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+    offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+    get_ber_identifier(tvb, offset, &ber_class, NULL, &tag);
+    if (ber_class == BER_CLASS_CON && tag == 0) {
+        offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+        offset += len;
+    }
+    for (i = 0; i < field; i++) {
+        offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+        offset += len;
+    }
+    start = offset;
+    offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+    *tlv_len = offset + len - start;
+    return start;
+}
+
+/* Certificate { tbsCertificate, signatureAlgorithm, ... }: the algorithm name */
+static const char*
+pkinit_describe_certificate_signature(tvbuff_t* tvb, int offset)
+{
+    gint8 ber_class;
+    gint32 tag;
+    guint32 len;
+
+    offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+    offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+    offset += len;
+    offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+    offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+    return pkinit_oid_name(tvb, offset, len);
+}
+
+/* The key that signed the certificate at cert_offset: that of its issuer
+ * among the other certificates of the set, which ends at set_end, or the
+ * certificate's signature algorithm if the issuer was not sent */
+static const char*
+pkinit_describe_issuer_key(tvbuff_t* tvb, int cert_offset, int set_end)
+{
+    gint8 ber_class;
+    gint32 tag;
+    guint32 len, issuer_len, subject_len;
+    int issuer, subject, offset, next;
+
+    issuer = pkinit_certificate_name(tvb, cert_offset, 2, &issuer_len);
+    offset = pkinit_ber_enter(tvb, cert_offset, &ber_class, &tag, &len);
+    offset += len;
+    while (offset < set_end) {
+        next = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+        next += len;
+        if (ber_class == BER_CLASS_UNI && tag == BER_UNI_TAG_SEQUENCE) {
+            subject = pkinit_certificate_name(tvb, offset, 4, &subject_len);
+            if (subject_len == issuer_len &&
+                tvb_memeql(tvb, subject, tvb_get_ptr(tvb, issuer, issuer_len), issuer_len) == 0) {
+                return pkinit_describe_certificate_key(tvb, offset);
+            }
+        }
+        offset = next;
+    }
+    return pkinit_describe_certificate_signature(tvb, cert_offset);
+}
+
+/* Names of a SEQUENCE OF AlgorithmIdentifier, comma separated */
+static const char*
+pkinit_describe_algorithms(tvbuff_t* tvb, int offset)
+{
+    wmem_strbuf_t* strbuf = wmem_strbuf_new(wmem_packet_scope(), "");
+    int end, next;
+    gint8 ber_class;
+    gint32 tag;
+    guint32 len;
+
+    TRY{
+        offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+        end = offset + len;
+        while (offset < end) {
+            offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+            next = offset + len;
+            offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+            wmem_strbuf_append_printf(strbuf, "%s%s", wmem_strbuf_get_len(strbuf) ? "," : "",
+                pkinit_oid_name(tvb, offset, len));
+            offset = next;
+        }
+    }
+    CATCH_BOUNDS_ERRORS{
+    }
+    ENDTRY;
+
+    return wmem_strbuf_get_str(strbuf);
+}
+
+/* Digest algorithm and first certificate of a ContentInfo/SignedData */
+static void
+pkinit_walk_signed_data(tvbuff_t* tvb, int offset, gboolean content_info, pkinit_packet_t* pkt)
+{
+    guint8 digest[HASH_SHA2_256_LENGTH];
+    int set_end, cert_offset, certs_end;
+    gint8 ber_class;
+    gint32 tag;
+    guint32 len;
+
+    TRY{
+        if (content_info) {
+            /* contentType, [0] content */
+            offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+            offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+            offset += len;
+            offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+        }
+        /* version, digestAlgorithms, encapContentInfo, [0] certificates */
+        offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+        offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+        offset += len;
+        offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+        set_end = offset + len;
+        if (len) {
+            offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+            offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+            pkt->digest = pkinit_oid_name(tvb, offset, len);
+        }
+        offset = pkinit_ber_enter(tvb, set_end, &ber_class, &tag, &len);
+        offset += len;
+        offset = pkinit_ber_enter(tvb, offset, &ber_class, &tag, &len);
+        if (ber_class == BER_CLASS_CON && tag == 0 && len) {
+            cert_offset = offset;
+            certs_end = offset + len;
+            offset = pkinit_ber_enter(tvb, cert_offset, &ber_class, &tag, &len);
+            len += offset - cert_offset;
+            gcry_md_hash_buffer(GCRY_MD_SHA256, digest, tvb_get_ptr(tvb, cert_offset, len), len);
+            pkt->cert = bytes_to_str(wmem_packet_scope(), digest, HASH_SHA2_256_LENGTH);
+            pkt->cert_key = pkinit_describe_certificate_key(tvb, cert_offset);
+            pkt->ca_key = pkinit_describe_issuer_key(tvb, cert_offset, certs_end);
+        }
+    }
+    CATCH_BOUNDS_ERRORS{
+    }
+    ENDTRY;
+}
+
 
 /*--- Included file: packet-pkinit-fn.c ---*/
 #line 1 "./asn1/pkinit/packet-pkinit-fn.c"
@@ -145,8 +841,75 @@ dissect_pkinit_SEQUENCE_OF_TrustedCA(gboolean implicit_tag _U_, tvbuff_t* tvb _U
     return offset;
 }
 
+// Mine
+/* Wrappers that note what the exchange table needs on the first pass */
+static int
+dissect_pkinit_signed_ContentInfo(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    if (!PINFO_FD_VISITED(actx->pinfo)) {
+        pkinit_walk_signed_data(tvb, offset, TRUE, pkinit_get_packet(actx->pinfo));
+    }
+    return dissect_cms_ContentInfo(implicit_tag, tvb, offset, actx, tree, hf_index);
+}
+
+static int
+dissect_pkinit_signed_SignedData(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    if (!PINFO_FD_VISITED(actx->pinfo)) {
+        pkinit_walk_signed_data(tvb, offset, FALSE, pkinit_get_packet(actx->pinfo));
+    }
+    return dissect_cms_SignedData(implicit_tag, tvb, offset, actx, tree, hf_index);
+}
+
+static int
+dissect_pkinit_paNonce(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    pkinit_packet_t* pkt = pkinit_get_packet(actx->pinfo);
+
+    offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
+        &pkt->nonce);
+    pkt->has_nonce = TRUE;
+
+    return offset;
+}
+
+static int
+dissect_pkinit_replyNonce(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    pkinit_packet_t* pkt = pkinit_get_packet(actx->pinfo);
+
+    offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
+        &pkt->reply_nonce);
+    pkt->has_reply_nonce = TRUE;
+
+    return offset;
+}
+
+static int
+dissect_pkinit_kdcDHNonce(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    pkinit_packet_t* pkt = pkinit_get_packet(actx->pinfo);
+
+    offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
+        &pkt->dh_nonce);
+    pkt->has_dh_nonce = TRUE;
+
+    return offset;
+}
+
+static int
+dissect_pkinit_clientPublicValue(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    pkinit_packet_t* pkt = pkinit_get_packet(actx->pinfo);
+
+    if (!PINFO_FD_VISITED(actx->pinfo)) {
+        TRY{
+            pkt->dh_group = pkinit_describe_spki(tvb, offset);
+        }
+        CATCH_BOUNDS_ERRORS{
+        }
+        ENDTRY;
+    }
+    return dissect_pkix1explicit_SubjectPublicKeyInfo(implicit_tag, tvb, offset, actx, tree, hf_index);
+}
+// End Mine
+
 static const ber_sequence_t PaPkAsReq_sequence[] = {
-  { &hf_pkinit_signedAuthPack, BER_CLASS_CON, 0, 0, dissect_cms_ContentInfo },
+  { &hf_pkinit_signedAuthPack, BER_CLASS_CON, 0, 0, dissect_pkinit_signed_ContentInfo },
   { &hf_pkinit_trustedCertifiers, BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_pkinit_SEQUENCE_OF_TrustedCA },
   { &hf_pkinit_kdcCert      , BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_cms_IssuerAndSerialNumber },
   { NULL, 0, 0, 0, NULL }
@@ -155,15 +918,15 @@ static const ber_sequence_t PaPkAsReq_sequence[] = {
 
 int
 dissect_pkinit_PaPkAsReq(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    isWin2k = 0;
     offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
         PaPkAsReq_sequence, hf_index, ett_pkinit_PaPkAsReq);
+    pkinit_request_done(actx, tree, tvb);
 
     return offset;
 }
 
 static const ber_sequence_t PaPkAsReq_pku2u_sequence[] = {
-  { &hf_pkinit_signedAuthPack, BER_CLASS_CON, 0, 0, dissect_cms_SignedData },
+  { &hf_pkinit_signedAuthPack, BER_CLASS_CON, 0, 0, dissect_pkinit_signed_SignedData },
   { &hf_pkinit_trustedCertifiers, BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_pkinit_SEQUENCE_OF_TrustedCA },
   { &hf_pkinit_kdcCert      , BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_cms_IssuerAndSerialNumber },
   { NULL, 0, 0, 0, NULL }
@@ -171,19 +934,22 @@ static const ber_sequence_t PaPkAsReq_pku2u_sequence[] = {
 
 int
 dissect_pkinit_PaPkAsReq_pku2u(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    isWin2k = 0;
-    isPku2u = 0;
-
     offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
         PaPkAsReq_pku2u_sequence, hf_index, ett_pkinit_PaPkAsReq);
+    pkinit_request_done(actx, tree, tvb);
 
     return offset;
 }
 
 static int
 dissect_pkinit_DHNonce(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    tvbuff_t* nonce_tvb = NULL;
+
     offset = dissect_ber_octet_string(implicit_tag, actx, tree, tvb, offset, hf_index,
-        NULL);
+        &nonce_tvb);
+    if (nonce_tvb) {
+        pkinit_get_packet(actx->pinfo)->client_dh_nonce_len = tvb_reported_length(nonce_tvb);
+    }
 
     return offset;
 }
@@ -222,15 +988,52 @@ dissect_pkinit_OCTET_STRING(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int of
 static const ber_sequence_t PKAuthenticator_sequence[] = {
   { &hf_pkinit_cusec        , BER_CLASS_CON, 0, 0, dissect_pkinit_INTEGER },
   { &hf_pkinit_ctime        , BER_CLASS_CON, 1, 0, dissect_KerberosV5Spec2_KerberosTime },
-  { &hf_pkinit_paNonce      , BER_CLASS_CON, 2, 0, dissect_pkinit_INTEGER_0_4294967295 },
+  { &hf_pkinit_paNonce      , BER_CLASS_CON, 2, 0, dissect_pkinit_paNonce },
   { &hf_pkinit_paChecksum   , BER_CLASS_CON, 3, BER_FLAGS_OPTIONAL, dissect_pkinit_OCTET_STRING },
   { NULL, 0, 0, 0, NULL }
 };
 
+/* The RFC 4556 PKAuthenticator opens with cusec [0] INTEGER, the Win2k
+ * one with kdcName [0] PrincipalName; fall back to the PA-DATA layout
+ * when the element is cut short.
+ */
+static gboolean
+pkinit_PKAuthenticator_is_win2k(tvbuff_t* tvb, int offset, asn1_ctx_t* actx)
+{
+    kerberos_pkinit_layout_t layout = KERBEROS_PKINIT_LAYOUT_UNKNOWN;
+    gint8 ber_class;
+    gint32 tag;
+
+    TRY{
+        offset = get_ber_identifier(tvb, offset, NULL, NULL, NULL);
+        offset = get_ber_length(tvb, offset, NULL, NULL);
+        offset = get_ber_identifier(tvb, offset, &ber_class, NULL, &tag);
+        offset = get_ber_length(tvb, offset, NULL, NULL);
+        if (ber_class == BER_CLASS_CON && tag == 0) {
+            get_ber_identifier(tvb, offset, &ber_class, NULL, &tag);
+            if (ber_class == BER_CLASS_UNI && tag == BER_UNI_TAG_SEQUENCE) {
+                layout = KERBEROS_PKINIT_LAYOUT_WIN2K;
+            }
+            else if (ber_class == BER_CLASS_UNI && tag == BER_UNI_TAG_INTEGER) {
+                layout = KERBEROS_PKINIT_LAYOUT_RFC4556;
+            }
+        }
+    }
+    CATCH_BOUNDS_ERRORS{
+        layout = KERBEROS_PKINIT_LAYOUT_UNKNOWN;
+    }
+    ENDTRY;
+
+    if (layout == KERBEROS_PKINIT_LAYOUT_UNKNOWN) {
+        return kerberos_is_win2k_pkinit(actx) || kerberos_get_pkinit_layout(actx) == KERBEROS_PKINIT_LAYOUT_WIN2K;
+    }
+    return layout == KERBEROS_PKINIT_LAYOUT_WIN2K;
+}
+
 static int
 dissect_pkinit_PKAuthenticator(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
 #line 17 "./asn1/pkinit/pkinit.cnf"
-    if (kerberos_is_win2k_pkinit(actx) || isWin2k == 1) {
+    if (pkinit_PKAuthenticator_is_win2k(tvb, offset, actx)) {
         return dissect_pkinit_PKAuthenticator_Win2k(implicit_tag, tvb, offset, actx, tree, hf_index);
     }
     offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
@@ -255,11 +1058,21 @@ dissect_pkinit_SEQUENCE_OF_AlgorithmIdentifier(gboolean implicit_tag _U_, tvbuff
     return offset;
 }
 
+// Mine
+static int
+dissect_pkinit_supportedCMSTypes(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    if (!PINFO_FD_VISITED(actx->pinfo)) {
+        pkinit_get_packet(actx->pinfo)->cms_types = pkinit_describe_algorithms(tvb, offset);
+    }
+    return dissect_pkinit_SEQUENCE_OF_AlgorithmIdentifier(implicit_tag, tvb, offset, actx, tree, hf_index);
+}
+// End Mine
+
 
 static const ber_sequence_t AuthPack_sequence[] = {
   { &hf_pkinit_pkAuthenticator, BER_CLASS_CON, 0, 0, dissect_pkinit_PKAuthenticator },
-  { &hf_pkinit_clientPublicValue, BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_pkix1explicit_SubjectPublicKeyInfo },
-  { &hf_pkinit_supportedCMSTypes, BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_pkinit_SEQUENCE_OF_AlgorithmIdentifier },
+  { &hf_pkinit_clientPublicValue, BER_CLASS_CON, 1, BER_FLAGS_OPTIONAL, dissect_pkinit_clientPublicValue },
+  { &hf_pkinit_supportedCMSTypes, BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_pkinit_supportedCMSTypes },
   { &hf_pkinit_clientDHNonce, BER_CLASS_CON, 3, BER_FLAGS_OPTIONAL, dissect_pkinit_DHNonce },
   { NULL, 0, 0, 0, NULL }
 };
@@ -295,7 +1108,7 @@ const value_string pkinit_PaPkAsRep_vals[] = {
 };
 
 static const ber_choice_t PaPkAsRep_choice[] = {
-  {   0, &hf_pkinit_dhSignedData , BER_CLASS_CON, 0, 0, dissect_cms_ContentInfo },
+  {   0, &hf_pkinit_dhSignedData , BER_CLASS_CON, 0, 0, dissect_pkinit_signed_ContentInfo },
   {   1, &hf_pkinit_encKeyPack   , BER_CLASS_CON, 1, 0, dissect_cms_ContentInfo },
   { 0, NULL, 0, 0, 0, NULL }
 };
@@ -311,20 +1124,20 @@ dissect_pkinit_PaPkAsRep(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offse
 
 // Mine
 static const ber_sequence_t PaPkAsRepConstructedType_sequence[] = {
-  { &hf_pkinit_dhSignedData, BER_CLASS_CON, 0, 0, dissect_cms_ContentInfo },
-  { &hf_pkinit_dhNonce      , BER_CLASS_CON, 1, 0, dissect_pkinit_INTEGER },
+  { &hf_pkinit_dhSignedData, BER_CLASS_CON, 0, 0, dissect_pkinit_signed_ContentInfo },
+  { &hf_pkinit_dhNonce      , BER_CLASS_CON, 1, 0, dissect_pkinit_kdcDHNonce },
   { NULL, 0, 0, 0, NULL }
 };
 
 static const ber_sequence_t PaPkAsRepConstructedType_pku2u_sequence[] = {
-  { &hf_pkinit_dhSignedData, BER_CLASS_CON, 0, 0, dissect_cms_SignedData },
-  { &hf_pkinit_dhNonce      , BER_CLASS_CON, 1, 0, dissect_pkinit_INTEGER },
+  { &hf_pkinit_dhSignedData, BER_CLASS_CON, 0, 0, dissect_pkinit_signed_SignedData },
+  { &hf_pkinit_dhNonce      , BER_CLASS_CON, 1, 0, dissect_pkinit_kdcDHNonce },
   { NULL, 0, 0, 0, NULL }
 };
 
 static int
 dissect_pkinit_PaPkAsRepConstructedTypeSequence(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    if (isPku2u == 0)
+    if (kerberos_get_pkinit_layout(actx) == KERBEROS_PKINIT_LAYOUT_PKU2U)
     {
         offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
             PaPkAsRepConstructedType_pku2u_sequence, hf_index, ett_pkinit_KDCDHKeyInfo);
@@ -346,20 +1159,20 @@ static const ber_choice_t PaPkAsRepConstructedType_choice[] = {
 
 int
 dissect_pkinit_PaPkAsRepConstructedType(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    isPku2u = -1;
     offset = dissect_ber_choice(actx, tree, tvb, offset,
         PaPkAsRepConstructedType_choice, hf_index, ett_pkinit_PaPkAsRep,
         NULL);
+    pkinit_reply_done(actx, tree, tvb);
 
     return offset;
 }
 
 int
 dissect_pkinit_PaPkAsRepConstructedType_pku2u(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    isPku2u = 0;
     offset = dissect_ber_choice(actx, tree, tvb, offset,
         PaPkAsRepConstructedType_choice, hf_index, ett_pkinit_PaPkAsRep,
         NULL);
+    pkinit_reply_done(actx, tree, tvb);
 
     return offset;
 }
@@ -377,7 +1190,7 @@ dissect_pkinit_BIT_STRING(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offs
 
 static const ber_sequence_t KDCDHKeyInfo_sequence[] = {
   { &hf_pkinit_subjectPublicKey, BER_CLASS_CON, 0, 0, dissect_pkinit_BIT_STRING },
-  { &hf_pkinit_dhNonce      , BER_CLASS_CON, 1, 0, dissect_pkinit_INTEGER },
+  { &hf_pkinit_dhNonce      , BER_CLASS_CON, 1, 0, dissect_pkinit_replyNonce },
   { &hf_pkinit_dhKeyExpiration, BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_KerberosV5Spec2_KerberosTime },
   { NULL, 0, 0, 0, NULL }
 };
@@ -391,22 +1204,28 @@ dissect_pkinit_KDCDHKeyInfo(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int of
 }
 
 
+static const ber_sequence_t ReplyKeyPack_sequence[] = {
+  { &hf_pkinit_replyKey     , BER_CLASS_CON, 0, 0, dissect_KerberosV5Spec2_EncryptionKey },
+  { &hf_pkinit_asChecksum   , BER_CLASS_CON, 1, 0, dissect_KerberosV5Spec2_Checksum },
+  { NULL, 0, 0, 0, NULL }
+};
 
 static int
-dissect_pkinit_INTEGER_M2147483648_2147483647(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    offset = dissect_ber_integer(implicit_tag, actx, tree, tvb, offset, hf_index,
-        NULL);
+dissect_pkinit_ReplyKeyPack(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
+    offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
+        ReplyKeyPack_sequence, hf_index, ett_pkinit_ReplyKeyPack);
 
     return offset;
 }
 
 
+
 static const ber_sequence_t PKAuthenticator_Win2k_sequence[] = {
   { &hf_pkinit_kdcName      , BER_CLASS_CON, 0, 0, dissect_KerberosV5Spec2_PrincipalName },
   { &hf_pkinit_kdcRealm     , BER_CLASS_CON, 1, 0, dissect_KerberosV5Spec2_Realm },
   { &hf_pkinit_cusecWin2k   , BER_CLASS_CON, 2, 0, dissect_pkinit_INTEGER_0_4294967295 },
   { &hf_pkinit_ctime        , BER_CLASS_CON, 3, 0, dissect_KerberosV5Spec2_KerberosTime },
-  { &hf_pkinit_paNonceWin2k , BER_CLASS_CON, 4, 0, dissect_pkinit_INTEGER_M2147483648_2147483647 },
+  { &hf_pkinit_paNonceWin2k , BER_CLASS_CON, 4, 0, dissect_pkinit_paNonce },
   { NULL, 0, 0, 0, NULL }
 };
 
@@ -420,7 +1239,7 @@ dissect_pkinit_PKAuthenticator_Win2k(gboolean implicit_tag _U_, tvbuff_t* tvb _U
 
 
 static const ber_sequence_t PA_PK_AS_REQ_Win2k_sequence[] = {
-  { &hf_pkinit_signed_auth_pack, BER_CLASS_CON, 0, 0, dissect_cms_ContentInfo },
+  { &hf_pkinit_signed_auth_pack, BER_CLASS_CON, 0, 0, dissect_pkinit_signed_ContentInfo },
   { &hf_pkinit_trusted_certifiers, BER_CLASS_CON, 2, BER_FLAGS_OPTIONAL, dissect_pkinit_SEQUENCE_OF_TrustedCA },
   { &hf_pkinit_kdc_cert     , BER_CLASS_CON, 3, BER_FLAGS_OPTIONAL | BER_FLAGS_IMPLTAG, dissect_pkinit_OCTET_STRING },
   { &hf_pkinit_encryption_cert, BER_CLASS_CON, 4, BER_FLAGS_OPTIONAL | BER_FLAGS_IMPLTAG, dissect_pkinit_OCTET_STRING },
@@ -429,9 +1248,9 @@ static const ber_sequence_t PA_PK_AS_REQ_Win2k_sequence[] = {
 
 int
 dissect_pkinit_PA_PK_AS_REQ_Win2k(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
-    isWin2k = 1;
     offset = dissect_ber_sequence(implicit_tag, actx, tree, tvb, offset,
         PA_PK_AS_REQ_Win2k_sequence, hf_index, ett_pkinit_PA_PK_AS_REQ_Win2k);
+    pkinit_request_done(actx, tree, tvb);
 
     return offset;
 }
@@ -441,6 +1260,7 @@ dissect_pkinit_PA_PK_AS_REQ_Win2k(gboolean implicit_tag _U_, tvbuff_t* tvb _U_,
 int
 dissect_pkinit_PA_PK_AS_REP_Win2k(gboolean implicit_tag _U_, tvbuff_t* tvb _U_, int offset _U_, asn1_ctx_t* actx _U_, proto_tree* tree _U_, int hf_index _U_) {
     offset = dissect_pkinit_PaPkAsRep(implicit_tag, tvb, offset, actx, tree, hf_index);
+    pkinit_reply_done(actx, tree, tvb);
 
     return offset;
 }
@@ -468,6 +1288,13 @@ static int dissect_KDCDHKeyInfo_PDU(tvbuff_t* tvb _U_, packet_info* pinfo _U_, p
     offset = dissect_pkinit_KDCDHKeyInfo(FALSE, tvb, offset, &asn1_ctx, tree, hf_pkinit_KDCDHKeyInfo_PDU);
     return offset;
 }
+static int dissect_ReplyKeyPack_PDU(tvbuff_t* tvb _U_, packet_info* pinfo _U_, proto_tree* tree _U_, void* data _U_) {
+    int offset = 0;
+    asn1_ctx_t asn1_ctx;
+    asn1_ctx_init(&asn1_ctx, ASN1_ENC_BER, TRUE, pinfo);
+    offset = dissect_pkinit_ReplyKeyPack(FALSE, tvb, offset, &asn1_ctx, tree, hf_pkinit_ReplyKeyPack_PDU);
+    return offset;
+}
 
 
 /*--- End of included file: packet-pkinit-fn.c ---*/
@@ -503,9 +1330,173 @@ dissect_KerberosV5Spec2_PrincipalName(gboolean implicit_tag _U_, tvbuff_t* tvb,
     return offset;
 }
 
+static int
+dissect_KerberosV5Spec2_EncryptionKey(gboolean implicit_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx, proto_tree* tree, int hf_index) {
+    offset = dissect_krb5_reply_key(tree, tvb, offset, actx, hf_pkinit_ReplyKeyPack_PDU, hf_index);
+    return offset;
+}
+
+static int
+dissect_KerberosV5Spec2_Checksum(gboolean implicit_tag _U_, tvbuff_t* tvb, int offset, asn1_ctx_t* actx, proto_tree* tree, int hf_index _U_) {
+    offset = dissect_krb5_Checksum(tree, tvb, offset, actx);
+    return offset;
+}
+
+/* -z pkinit_exchanges,tree */
+static int st_node_pkinit_outcome = -1;
+static int st_node_pkinit_latency = -1;
+static const gchar* st_str_pkinit_outcome = "Exchanges by outcome";
+static const gchar* st_str_pkinit_latency = "Latency by DH group (us)";
+
+static void
+pkinit_exchanges_stats_tree_init(stats_tree* st)
+{
+    st_node_pkinit_outcome = stats_tree_create_node(st, st_str_pkinit_outcome, 0, STAT_DT_INT, TRUE);
+    st_node_pkinit_latency = stats_tree_create_node(st, st_str_pkinit_latency, 0, STAT_DT_INT, TRUE);
+}
+
+static tap_packet_status
+pkinit_exchanges_stats_tree_packet(stats_tree* st, packet_info* pinfo _U_, epan_dissect_t* edt _U_, const void* p)
+{
+    const pkinit_exchange_t* exch = (const pkinit_exchange_t*)p;
+    nstime_t delta;
+
+    tick_stat_node(st, st_str_pkinit_outcome, 0, FALSE);
+    tick_stat_node(st, val_to_str_const(exch->outcome, pkinit_outcome_vals, "Unknown"), st_node_pkinit_outcome, FALSE);
+
+    if (exch->outcome == PKINIT_OUTCOME_EVICTED) {
+        return TAP_PACKET_REDRAW;
+    }
+
+    nstime_delta(&delta, &exch->rep_time, &exch->req_time);
+    tick_stat_node(st, st_str_pkinit_latency, 0, FALSE);
+    avg_stat_node_add_value_int(st, exch->dh_group ? exch->dh_group : "RSA key transport", st_node_pkinit_latency, FALSE,
+        (gint)(delta.secs * 1000000 + delta.nsecs / 1000));
+
+    return TAP_PACKET_REDRAW;
+}
+
+/* -z pkinit_cost,tree
+ * Public-key work a KDC spends per exchange, assuming one certificate
+ * chain link per side: verify the client signature with the client key
+ * and the client certificate with the key of the CA that issued it, sign
+ * the reply, and either run the DH agreement (keygen + shared secret) or
+ * encrypt the reply key to the client key. Exchanges that end in a
+ * KRB-ERROR, and requests evicted unanswered, cost the verification only;
+ * requests still open at the end of the capture are not counted. The
+ * operations per second are taken over the time since the first exchange.
+ */
+static int st_node_pkinit_cost_class = -1;
+static int st_node_pkinit_cost_ops = -1;
+static int st_node_pkinit_cost_rates = -1;
+static const gchar* st_str_pkinit_cost_class = "Exchanges by class (client key / KDC key / group / hash)";
+static const gchar* st_str_pkinit_cost_ops = "KDC public-key operations";
+static const gchar* st_str_pkinit_cost_rates = "KDC public-key operations per second";
+static GHashTable* pkinit_cost_counts = NULL;  /* operation node name -> count */
+static nstime_t pkinit_cost_first;
+
+static void
+pkinit_cost_stats_tree_init(stats_tree* st)
+{
+    st_node_pkinit_cost_class = stats_tree_create_node(st, st_str_pkinit_cost_class, 0, STAT_DT_INT, TRUE);
+    st_node_pkinit_cost_ops = stats_tree_create_node(st, st_str_pkinit_cost_ops, 0, STAT_DT_INT, TRUE);
+    st_node_pkinit_cost_rates = stats_tree_create_node(st, st_str_pkinit_cost_rates, 0, STAT_DT_INT, TRUE);
+    if (pkinit_cost_counts == NULL) {
+        pkinit_cost_counts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    }
+    else {
+        g_hash_table_remove_all(pkinit_cost_counts);
+    }
+    nstime_set_unset(&pkinit_cost_first);
+}
+
+static void
+pkinit_cost_stats_tree_cleanup(stats_tree* st _U_)
+{
+    if (pkinit_cost_counts) {
+        g_hash_table_destroy(pkinit_cost_counts);
+        pkinit_cost_counts = NULL;
+    }
+}
+
+static void
+pkinit_cost_tick_op(stats_tree* st, const char* op, const char* key, int count)
+{
+    const char* name = wmem_strdup_printf(wmem_packet_scope(), "%s %s", op, key ? key : "unknown key");
+    gpointer total;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        tick_stat_node(st, st_str_pkinit_cost_ops, 0, FALSE);
+        tick_stat_node(st, name, st_node_pkinit_cost_ops, FALSE);
+    }
+    total = g_hash_table_lookup(pkinit_cost_counts, name);
+    g_hash_table_insert(pkinit_cost_counts, g_strdup(name), GUINT_TO_POINTER(GPOINTER_TO_UINT(total) + count));
+}
+
+/* Every operation's count over the seconds since the first exchange */
+static void
+pkinit_cost_set_rates(stats_tree* st, packet_info* pinfo)
+{
+    GHashTableIter iter;
+    gpointer name, total;
+    nstime_t elapsed;
+    gint64 us;
+
+    if (nstime_is_unset(&pkinit_cost_first)) {
+        pkinit_cost_first = pinfo->abs_ts;
+    }
+    nstime_delta(&elapsed, &pinfo->abs_ts, &pkinit_cost_first);
+    us = (gint64)elapsed.secs * 1000000 + elapsed.nsecs / 1000;
+    if (us <= 0) {
+        return;
+    }
+    g_hash_table_iter_init(&iter, pkinit_cost_counts);
+    while (g_hash_table_iter_next(&iter, &name, &total)) {
+        set_int_stat_node(st, (const char*)name, st_node_pkinit_cost_rates, FALSE,
+            (gint)((gint64)GPOINTER_TO_UINT(total) * 1000000 / us));
+    }
+}
+
+static tap_packet_status
+pkinit_cost_stats_tree_packet(stats_tree* st, packet_info* pinfo, epan_dissect_t* edt _U_, const void* p)
+{
+    const pkinit_exchange_t* exch = (const pkinit_exchange_t*)p;
+    const char* group = exch->dh_group ? exch->dh_group : "RSA key transport";
+    const char* name;
+
+    name = wmem_strdup_printf(wmem_packet_scope(), "%s / %s / %s / %s",
+        exch->client_key ? exch->client_key : "-",
+        exch->kdc_key ? exch->kdc_key : "-",
+        group,
+        exch->client_digest ? exch->client_digest : "-");
+    tick_stat_node(st, st_str_pkinit_cost_class, 0, FALSE);
+    tick_stat_node(st, name, st_node_pkinit_cost_class, FALSE);
+
+    /* client signature, and the client certificate with its CA's key */
+    pkinit_cost_tick_op(st, "verify", exch->client_key, 1);
+    pkinit_cost_tick_op(st, "verify", exch->client_ca_key, 1);
+    if (exch->outcome != PKINIT_OUTCOME_AS_REP) {
+        pkinit_cost_set_rates(st, pinfo);
+        return TAP_PACKET_REDRAW;
+    }
+
+    pkinit_cost_tick_op(st, "sign", exch->kdc_key, 1);
+    if (exch->dh_group) {
+        pkinit_cost_tick_op(st, "keygen", exch->dh_group, 1);
+        pkinit_cost_tick_op(st, "agree", exch->dh_group, 1);
+    }
+    else {
+        pkinit_cost_tick_op(st, "encrypt", exch->client_key, 1);
+    }
+    pkinit_cost_set_rates(st, pinfo);
+
+    return TAP_PACKET_REDRAW;
+}
 
 /*--- proto_register_pkinit ----------------------------------------------*/
 void proto_register_pkinit(void) {
+    module_t* pkinit_module;
 
     /* List of fields */
     static hf_register_info hf[] = {
@@ -524,6 +1515,10 @@ void proto_register_pkinit(void) {
               { "KDCDHKeyInfo", "pkinit.KDCDHKeyInfo_element",
                 FT_NONE, BASE_NONE, NULL, 0,
                 NULL, HFILL }},
+            { &hf_pkinit_ReplyKeyPack_PDU,
+              { "ReplyKeyPack", "pkinit.ReplyKeyPack_element",
+                FT_NONE, BASE_NONE, NULL, 0,
+                NULL, HFILL }},
             { &hf_pkinit_signedAuthPack,
               { "signedAuthPack", "pkinit.signedAuthPack_element",
                 FT_NONE, BASE_NONE, NULL, 0,
@@ -648,9 +1643,37 @@ void proto_register_pkinit(void) {
               { "encryption-cert", "pkinit.encryption_cert",
                 FT_BYTES, BASE_NONE, NULL, 0,
                 "OCTET_STRING", HFILL }},
+            { &hf_pkinit_replyKey,
+              { "replyKey", "pkinit.replyKey_element",
+                FT_NONE, BASE_NONE, NULL, 0,
+                "EncryptionKey", HFILL }},
+            { &hf_pkinit_asChecksum,
+              { "asChecksum", "pkinit.asChecksum_element",
+                FT_NONE, BASE_NONE, NULL, 0,
+                "Checksum", HFILL }},
 
                 /*--- End of included file: packet-pkinit-hfarr.c ---*/
                 #line 81 "./asn1/pkinit/packet-pkinit-template.c"
+        { &hf_pkinit_response_in,
+          { "Response in", "pkinit.response_in",
+            FT_FRAMENUM, BASE_NONE, FRAMENUM_TYPE(FT_FRAMENUM_RESPONSE), 0,
+            "The reply to this PKINIT request is in this frame", HFILL }},
+        { &hf_pkinit_response_to,
+          { "Response to", "pkinit.response_to",
+            FT_FRAMENUM, BASE_NONE, FRAMENUM_TYPE(FT_FRAMENUM_REQUEST), 0,
+            "This is a reply to the PKINIT request in this frame", HFILL }},
+        { &hf_pkinit_time,
+          { "Time", "pkinit.time",
+            FT_RELATIVE_TIME, BASE_NONE, NULL, 0,
+            "The time between the PKINIT request and its reply", HFILL }},
+        { &hf_pkinit_outcome,
+          { "Outcome", "pkinit.outcome",
+            FT_UINT32, BASE_DEC, VALS(pkinit_outcome_vals), 0,
+            NULL, HFILL }},
+        { &hf_pkinit_dh_group,
+          { "DH group", "pkinit.dh_group",
+            FT_STRING, BASE_NONE, NULL, 0,
+            "Key agreement group offered in clientPublicValue", HFILL }},
     };
 
     /* List of subtrees */
@@ -669,6 +1692,7 @@ void proto_register_pkinit(void) {
             &ett_pkinit_KDCDHKeyInfo,
             &ett_pkinit_PKAuthenticator_Win2k,
             &ett_pkinit_PA_PK_AS_REQ_Win2k,
+            &ett_pkinit_ReplyKeyPack,
 
             /*--- End of included file: packet-pkinit-ettarr.c ---*/
             #line 86 "./asn1/pkinit/packet-pkinit-template.c"
@@ -681,6 +1705,22 @@ void proto_register_pkinit(void) {
     proto_register_field_array(proto_pkinit, hf, array_length(hf));
     proto_register_subtree_array(ett, array_length(ett));
 
+    pkinit_module = prefs_register_protocol(proto_pkinit, NULL);
+    prefs_register_uint_preference(pkinit_module, "max_pending",
+        "Maximum open PKINIT exchanges",
+        "Requests still waiting for a reply beyond this many are dropped, oldest first "
+        "(0 = no limit)",
+        10, &pkinit_max_pending);
+    prefs_register_uint_preference(pkinit_module, "max_exchanges",
+        "Maximum remembered PKINIT exchanges",
+        "Exchanges beyond this many are forgotten, oldest first, and their frames show"
+        " no exchange on later passes (0 = no limit)",
+        10, &pkinit_max_exchanges);
+
+    pkinit_tap = register_tap("pkinit");
+    register_init_routine(pkinit_init);
+    ber_mem_register("pkinit.pending", pkinit_mem_pending);
+    ber_mem_register("pkinit.frames", pkinit_mem_frames);
 }
 
 
@@ -691,9 +1731,15 @@ void proto_reg_handoff_pkinit(void) {
 #line 1 "./asn1/pkinit/packet-pkinit-dis-tab.c"
     register_ber_oid_dissector("1.3.6.1.5.2.3.1", dissect_AuthPack_PDU, proto_pkinit, "id-pkauthdata");
     register_ber_oid_dissector("1.3.6.1.5.2.3.2", dissect_KDCDHKeyInfo_PDU, proto_pkinit, "id-pkdhkeydata");
+    register_ber_oid_dissector("1.3.6.1.5.2.3.3", dissect_ReplyKeyPack_PDU, proto_pkinit, "id-pkrkeydata");
     register_ber_oid_dissector("1.3.6.1.5.2.2", dissect_KRB5PrincipalName_PDU, proto_pkinit, "id-pkinit-san");
 
 
     /*--- End of included file: packet-pkinit-dis-tab.c ---*/
 #line 101 "./asn1/pkinit/packet-pkinit-template.c"
+
+    stats_tree_register("pkinit", "pkinit_exchanges", "PKINIT/Exchanges", 0,
+        pkinit_exchanges_stats_tree_packet, pkinit_exchanges_stats_tree_init, NULL);
+    stats_tree_register("pkinit", "pkinit_cost", "PKINIT/KDC Cost Model", 0,
+        pkinit_cost_stats_tree_packet, pkinit_cost_stats_tree_init, pkinit_cost_stats_tree_cleanup);
 }
@@ -23,6 +23,12 @@
 int dissect_pkinit_PA_PK_AS_REQ(proto_tree* tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx _U_);
 int dissect_pkinit_PA_PK_AS_REP(proto_tree* tree, tvbuff_t* tvb, int offset, asn1_ctx_t* actx _U_);
 
+/* Close the client's open PKINIT exchange on a KRB-ERROR sent to it */
+void pkinit_exchange_krb_error(packet_info* pinfo, proto_tree* tree, tvbuff_t* tvb, guint32 errorcode);
+
+/* SHA-256 (hex) of the first certificate in this frame's PKINIT SignedData, or NULL */
+const char* pkinit_get_cert_fingerprint(packet_info* pinfo);
+
 
 /*--- Included file: packet-pkinit-exp.h ---*/
 #line 1 "./asn1/pkinit/packet-pkinit-exp.h"
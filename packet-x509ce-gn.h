@@ -0,0 +1,64 @@
+/* packet-x509ce-gn.h
+ * Tree-less GeneralNames decoder for X.509 Certificate Extensions
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef PACKET_X509CE_GN_H
+#define PACKET_X509CE_GN_H
+
+/* GeneralName CHOICE tags, plus the otherName forms we recognise */
+typedef enum {
+    X509CE_GN_OTHER = 0,
+    X509CE_GN_EMAIL = 1,
+    X509CE_GN_DNS = 2,
+    X509CE_GN_X400 = 3,
+    X509CE_GN_DIRECTORY = 4,
+    X509CE_GN_EDIPARTY = 5,
+    X509CE_GN_URI = 6,
+    X509CE_GN_IP = 7,
+    X509CE_GN_REGISTERED_ID = 8,
+    X509CE_GN_UPN = 9   /* otherName 1.3.6.1.4.1.311.20.2.3 */
+} x509ce_gn_type_t;
+
+/* One name. offset/length cover the value octets inside tvb (the
+ * UTF8String of a UPN, the Name of a directoryName); gn_offset/gn_length
+ * cover the contents of the GeneralName alternative itself.
+ */
+typedef struct {
+    x509ce_gn_type_t type;
+    int offset;
+    int length;
+    int gn_offset;
+    int gn_length;
+} x509ce_general_name_t;
+
+#define X509CE_GN_MAX 32
+
+typedef struct {
+    tvbuff_t* tvb;
+    int offset;             /* contents of the SEQUENCE OF */
+    int length;
+    guint count;
+    gboolean truncated;     /* more than X509CE_GN_MAX names, the rest are not in names[] */
+    x509ce_general_name_t names[X509CE_GN_MAX];
+} x509ce_general_names_t;
+
+/* Decode a GeneralNames SEQUENCE OF at offset without touching the tree;
+ * with implicit_tag the SEQUENCE OF header has already been taken off and
+ * the rest of tvb is its contents. Returns the offset after the SEQUENCE
+ * OF, or -1 if the encoding is not one the fast decoder handles
+ * (indefinite length, bad nesting).
+ */
+int x509ce_decode_general_names(tvbuff_t* tvb, int offset, gboolean implicit_tag, x509ce_general_names_t* names);
+
+/* All GeneralNames decoded while dissecting this packet, in order
+ * (a wmem_list_t of x509ce_general_names_t*), or NULL.
+ */
+wmem_list_t* x509ce_get_general_names(packet_info* pinfo);
+
+#endif  /* PACKET_X509CE_GN_H */
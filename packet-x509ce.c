@@ -25,6 +25,7 @@
 
 #include "packet-ber.h"
 #include "packet-x509ce.h"
+#include "packet-x509ce-gn.h"
 #include "packet-x509af.h"
 #include "packet-x509if.h"
 #include "packet-x509sat.h"
@@ -318,6 +319,110 @@ static gint ett_x509ce_ScramblerCapabilities = -1;
 /*--- End of included file: packet-x509ce-ett.c ---*/
 #line 43 "./asn1/x509ce/packet-x509ce-template.c"
 
+/* szOID_NT_PRINCIPAL_NAME, 1.3.6.1.4.1.311.20.2.3 */
+static const guint8 x509ce_upn_oid[] = { 0x2b, 0x06, 0x01, 0x04, 0x01, 0x82, 0x37, 0x14, 0x02, 0x03 };
+
+/* Narrow an otherName entry down to the UTF8String of a UPN */
+static void
+x509ce_decode_other_name(tvbuff_t* tvb, x509ce_general_name_t* entry)
+{
+    int offset = entry->gn_offset;
+    int end_offset = entry->gn_offset + entry->gn_length;
+    gint8 ber_class;
+    gboolean pc;
+    gint32 tag;
+    guint32 len;
+
+    offset = get_ber_identifier(tvb, offset, &ber_class, &pc, &tag);
+    offset = get_ber_length(tvb, offset, &len, NULL);
+    if (ber_class != BER_CLASS_UNI || tag != BER_UNI_TAG_OID || len != sizeof(x509ce_upn_oid)
+        || tvb_memeql(tvb, offset, x509ce_upn_oid, len) != 0)
+        return;
+    offset += len;
+
+    /* value [0] EXPLICIT UTF8String */
+    offset = get_ber_identifier(tvb, offset, &ber_class, &pc, &tag);
+    offset = get_ber_length(tvb, offset, &len, NULL);
+    if (ber_class != BER_CLASS_CON || tag != 0)
+        return;
+    offset = get_ber_identifier(tvb, offset, &ber_class, &pc, &tag);
+    offset = get_ber_length(tvb, offset, &len, NULL);
+    if (ber_class != BER_CLASS_UNI || tag != BER_UNI_TAG_UTF8String || offset + (int)len > end_offset)
+        return;
+
+    entry->type = X509CE_GN_UPN;
+    entry->offset = offset;
+    entry->length = len;
+}
+
+int
+x509ce_decode_general_names(tvbuff_t* tvb, int offset, gboolean implicit_tag, x509ce_general_names_t* names)
+{
+    x509ce_general_name_t* entry;
+    int end_offset, name_offset;
+    gint8 ber_class;
+    gboolean pc, ind;
+    gint32 tag;
+    guint32 len;
+
+    names->tvb = tvb;
+    names->count = 0;
+    names->truncated = FALSE;
+
+    if (implicit_tag) {
+        len = tvb_reported_length_remaining(tvb, offset);
+    } else {
+        offset = get_ber_identifier(tvb, offset, &ber_class, &pc, &tag);
+        offset = get_ber_length(tvb, offset, &len, &ind);
+        if (!pc || ind)
+            return -1;
+    }
+    names->offset = offset;
+    names->length = len;
+    end_offset = offset + len;
+
+    while (offset < end_offset) {
+        offset = get_ber_identifier(tvb, offset, &ber_class, &pc, &tag);
+        offset = get_ber_length(tvb, offset, &len, &ind);
+        if (ind || ber_class != BER_CLASS_CON || tag > X509CE_GN_REGISTERED_ID
+            || offset + (int)len > end_offset)
+            return -1;
+        name_offset = offset;
+        offset += len;
+
+        if (names->count == X509CE_GN_MAX) {
+            names->truncated = TRUE;
+            continue;
+        }
+        entry = &names->names[names->count++];
+        entry->type = (x509ce_gn_type_t)tag;
+        entry->offset = entry->gn_offset = name_offset;
+        entry->length = entry->gn_length = len;
+        if (tag == X509CE_GN_OTHER)
+            x509ce_decode_other_name(tvb, entry);
+    }
+
+    return end_offset;
+}
+
+wmem_list_t*
+x509ce_get_general_names(packet_info* pinfo)
+{
+    return (wmem_list_t*)p_get_proto_data(wmem_packet_scope(), pinfo, proto_x509ce, 0);
+}
+
+static void
+x509ce_add_general_names(packet_info* pinfo, x509ce_general_names_t* names)
+{
+    wmem_list_t* list = x509ce_get_general_names(pinfo);
+
+    if (!list) {
+        list = wmem_list_new(wmem_packet_scope());
+        p_add_proto_data(wmem_packet_scope(), pinfo, proto_x509ce, 0, list);
+    }
+    wmem_list_append(list, names);
+}
+
 /*--- Included file: packet-x509ce-fn.c ---*/
 #line 1 "./asn1/x509ce/packet-x509ce-fn.c"
 
@@ -479,8 +584,66 @@ static const ber_sequence_t GeneralNames_sequence_of[1] = {
   { &hf_x509ce_GeneralNames_item, BER_CLASS_ANY/*choice*/, -1/*choice*/, BER_FLAGS_NOOWNTAG|BER_FLAGS_NOTCHKTAG, dissect_x509ce_GeneralName },
 };
 
+/* The names of a GeneralNames, from the array x509ce_decode_general_names()
+ * filled in. Each one goes straight to its GeneralName_choice[] entry, as
+ * dissect_ber_choice() would call it. Without a tree only the alternatives
+ * with sub-dissectors (otherName OID callbacks, directoryName and the like)
+ * are called; strings, addresses and OIDs are skipped.
+ */
+static void
+x509ce_dissect_general_names(x509ce_general_names_t* names, asn1_ctx_t* actx, proto_tree* tree, int hf_index)
+{
+  const x509ce_general_name_t* entry;
+  const ber_choice_t* ch;
+  proto_item* item;
+  proto_tree* name_tree;
+  guint i;
+
+  if (tree && hf_index >= 0) {
+    if (proto_registrar_get_nth(hf_index)->type == FT_NONE) {
+      item = proto_tree_add_item(tree, hf_index, names->tvb, names->offset, names->length, ENC_BIG_ENDIAN);
+      proto_item_append_text(item, ":");
+    } else {
+      item = proto_tree_add_uint(tree, hf_index, names->tvb, names->offset, names->length, names->count);
+      proto_item_append_text(item, (names->count == 1) ? " item" : " items");
+    }
+    tree = proto_item_add_subtree(item, ett_x509ce_GeneralNames);
+  }
+
+  for (i = 0; i < names->count; i++) {
+    entry = &names->names[i];
+    /* GeneralName_choice[] is in tag order */
+    ch = &GeneralName_choice[(entry->type == X509CE_GN_UPN) ? X509CE_GN_OTHER : entry->type];
+    name_tree = NULL;
+    if (tree) {
+      item = proto_tree_add_uint(tree, hf_x509ce_GeneralNames_item, names->tvb, entry->gn_offset, entry->gn_length, ch->value);
+      name_tree = proto_item_add_subtree(item, ett_x509ce_GeneralName);
+    } else if (ch->value != X509CE_GN_OTHER && ch->value != X509CE_GN_X400 &&
+               ch->value != X509CE_GN_DIRECTORY && ch->value != X509CE_GN_EDIPARTY) {
+      continue;
+    }
+    ch->func(TRUE, tvb_new_subset_length(names->tvb, entry->gn_offset, entry->gn_length), 0,
+             actx, name_tree, *ch->p_id);
+  }
+}
+
 int
 dissect_x509ce_GeneralNames(gboolean implicit_tag _U_, tvbuff_t *tvb _U_, int offset _U_, asn1_ctx_t *actx _U_, proto_tree *tree _U_, int hf_index _U_) {
+  x509ce_general_names_t* names = wmem_new(wmem_packet_scope(), x509ce_general_names_t);
+  int end_offset;
+
+  /* The typed array is filled in for the taps and caches, and the tree
+   * and sub-dissectors are driven from it; only more names than it holds
+   * take the choice-by-choice walk. */
+  end_offset = x509ce_decode_general_names(tvb, offset, implicit_tag, names);
+  if (end_offset > 0) {
+    x509ce_add_general_names(actx->pinfo, names);
+    if (!names->truncated) {
+      x509ce_dissect_general_names(names, actx, tree, hf_index);
+      return end_offset;
+    }
+  }
+
   offset = dissect_ber_sequence_of(implicit_tag, actx, tree, tvb, offset,
                                       GeneralNames_sequence_of, hf_index, ett_x509ce_GeneralNames);
 
@@ -0,0 +1,75 @@
+#!/bin/bash
+#
+# ber-schema-bench.sh - time the BER table interpreter (ber.schema) against
+# the generated SEQUENCE/SEQUENCE OF code and check that both build the
+# same protocol tree.
+#
+# Usage: ber-schema-bench.sh [-n runs] [-t tshark] capture...
+#
+# Each capture is read with ber.schema off and on, without a tree (summary
+# lines only) and with the full tree (-V); the best of the runs is printed
+# in seconds, with the -V outputs compared. Extra tshark options, such as a
+# keytab for decryption, go in TSHARK_OPTS.
+#
+# Wireshark - Network traffic analyzer
+# By Gerald Combs <gerald@wireshark.org>
+# Copyright 1998 Gerald Combs
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+RUNS=5
+TSHARK=tshark
+
+while getopts "n:t:" opt; do
+    case $opt in
+        n) RUNS=$OPTARG ;;
+        t) TSHARK=$OPTARG ;;
+        *) echo "Usage: $0 [-n runs] [-t tshark] capture..." >&2; exit 2 ;;
+    esac
+done
+shift $((OPTIND - 1))
+if [ $# -eq 0 ]; then
+    echo "Usage: $0 [-n runs] [-t tshark] capture..." >&2
+    exit 2
+fi
+
+TMPDIR=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMPDIR"' EXIT
+
+# best wall time of $RUNS runs of tshark with the given options
+best_time() {
+    local best="" run start end t
+    for run in $(seq "$RUNS"); do
+        start=$(date +%s%N)
+        # shellcheck disable=SC2086
+        "$TSHARK" -n -o "ber.schema:$1" $TSHARK_OPTS -r "$2" $3 > /dev/null 2>&1 || return 1
+        end=$(date +%s%N)
+        t=$((end - start))
+        if [ -z "$best" ] || [ "$t" -lt "$best" ]; then
+            best=$t
+        fi
+    done
+    printf "%d.%03d" $((best / 1000000000)) $((best / 1000000 % 1000))
+}
+
+printf "%-32s %10s %10s %10s %10s  %s\n" "capture" "gen" "schema" "gen -V" "schema -V" "trees"
+status=0
+for capture in "$@"; do
+    gen=$(best_time FALSE "$capture" "") || { echo "$capture: $TSHARK failed" >&2; status=1; continue; }
+    schema=$(best_time TRUE "$capture" "")
+    gen_v=$(best_time FALSE "$capture" -V)
+    schema_v=$(best_time TRUE "$capture" -V)
+
+    # shellcheck disable=SC2086
+    "$TSHARK" -n -o ber.schema:FALSE $TSHARK_OPTS -r "$capture" -V > "$TMPDIR/gen" 2>&1
+    # shellcheck disable=SC2086
+    "$TSHARK" -n -o ber.schema:TRUE $TSHARK_OPTS -r "$capture" -V > "$TMPDIR/schema" 2>&1
+    if cmp -s "$TMPDIR/gen" "$TMPDIR/schema"; then
+        trees=same
+    else
+        trees="differ ($(diff "$TMPDIR/gen" "$TMPDIR/schema" | grep -c '^[<>]') lines)"
+        status=1
+    fi
+    printf "%-32s %10s %10s %10s %10s  %s\n" "$(basename "$capture")" "$gen" "$schema" "$gen_v" "$schema_v" "$trees"
+done
+exit $status